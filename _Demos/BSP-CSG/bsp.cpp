@@ -1321,7 +1321,7 @@ EPlaneSide Tree::PartitionNodeWithPlane(
 	}
 
 	const Node& node = m_nodes[ nodeId ];
-	const UINT16 iPlaneIndex = node.plane;
+	const PlaneID iPlaneIndex = node.plane;
 	const Vector4& nodePlane = m_planes[ iPlaneIndex ];
 
 	// partition the operand
@@ -1869,7 +1869,7 @@ static NodeID MergeSubtract( Tree & treeA, NodeID iNodeA, Tree & treeB, NodeID i
 	if( IS_INTERNAL( iNodeA ) )
 	{
 		Node& nodeA = treeA.m_nodes[ iNodeA ];
-		const UINT16 planeA = nodeA.plane;
+		const PlaneID planeA = nodeA.plane;
 		const Vector4& plane = treeA.m_planes[ planeA ];
 
 		// Clip this node's polygons with the other tree.
@@ -1928,7 +1928,7 @@ static NodeID MergeSubtract2( Tree & treeA, NodeID iNodeA, Tree & treeB, NodeID
 	if( IS_INTERNAL( iNodeA ) )
 	{
 		Node& nodeA = treeA.m_nodes[ iNodeA ];
-		const UINT16 planeA = nodeA.plane;
+		const PlaneID planeA = nodeA.plane;
 		const Vector4& plane = treeA.m_planes[ planeA ];
 
 		nodeA.faces = ClipFacesOutsideBrush( treeA, nodeA.faces, temp, 0 );
@@ -1962,7 +1962,6 @@ void Tree::Subtract2( Tree& other, const Tree& temp )
 {
 	NodeID rootId = MergeSubtract2( *this, 0, other, 0, temp );
 }
-
 void Tree::CopyFrom( const Tree& other )
 {
 	m_planes = other.m_planes;
@@ -2014,6 +2013,7 @@ void TriangulateFace(
 					  )
 {
 	const int numTriangles = face.vertices.Num() - 2;
+	mxASSERT( vertices.Num() + numTriangles * 3 <= MAX_UINT16 );
 
 	const Vertex& basePoint = face.vertices[ 0 ];
 #if 0
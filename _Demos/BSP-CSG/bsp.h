@@ -128,25 +128,39 @@ enum NODE_TYPE
 	EMPTY_LEAF = 2,	// An outcell leaf node ( representing empty space ).
 };
 
+// 1 - use 32-bit node/face/plane indices (for large levels), 0 - 16-bit indices (less memory)
+#ifndef BSP_USE_32BIT_IDS
+#define BSP_USE_32BIT_IDS	(1)
+#endif
+
+#if BSP_USE_32BIT_IDS
+typedef UINT32 NodeID;	// upper two bits describe the type of the node
+typedef UINT32 FaceID;
+typedef UINT32 PlaneID;
+#else
 typedef UINT16 NodeID;	// upper two bits describe the type of the node
 typedef UINT16 FaceID;
 typedef UINT16 PlaneID;
+#endif
 
+// the type of the node is stored in the upper two bits
+enum { NODE_TYPE_SHIFT = sizeof(NodeID) * BITS_IN_BYTE - 2 };
+enum { NODE_PAYLOAD_MASK = (1U << NODE_TYPE_SHIFT) - 1 };
 
 inline bool IS_LEAF( NodeID nodeID ) {
-	return (nodeID & (~0U<<14)) != 0;
+	return (nodeID >> NODE_TYPE_SHIFT) != 0;
 }
 inline bool IS_INTERNAL( NodeID nodeID ) {
-	return (nodeID & (~0U<<14)) == 0;
+	return (nodeID >> NODE_TYPE_SHIFT) == 0;
 }
 inline NodeID MAKE_LEAF( NODE_TYPE type ) {
-	return type<<14;
+	return NodeID(type) << NODE_TYPE_SHIFT;
 }
 inline NODE_TYPE GET_TYPE( NodeID nodeID ) {
-	return NODE_TYPE((nodeID >> 14) & 3);
+	return NODE_TYPE((nodeID >> NODE_TYPE_SHIFT) & 3);
 }
-inline UINT16 GET_PAYLOAD( NodeID nodeID ) {
-	return nodeID & ~(~0U<<14);
+inline NodeID GET_PAYLOAD( NodeID nodeID ) {
+	return nodeID & NODE_PAYLOAD_MASK;
 }
 inline bool IS_SOLID_LEAF( NodeID nodeID ) {
 	return GET_TYPE(nodeID) == SOLID_LEAF;
@@ -157,12 +171,12 @@ inline bool IS_EMPTY_LEAF( NodeID nodeID ) {
 
 
 
-enum { NIL_INDEX = (UINT16)~0 };
+enum { NIL_INDEX = (FaceID)~0 };
 
 //NOTE: lower 14 bits of a leaf index may contain additional information (e.g. material ID)
 struct Node : public CStruct
 {
-	UINT16	plane;	//2 Hyperplane of the node (index into array of planes).
+	PlaneID	plane;	//2 Hyperplane of the node (index into array of planes).
 	NodeID	front;	//2 Index of the right child (positive subspace, in front of plane).
 	NodeID	back;	//2 Index of the left child (negative subspace, behind the plane).
 	FaceID	faces;	//2 linked list of polygons lying on this node's plane
@@ -313,10 +327,15 @@ public:	// Internal functions:
 	FaceID AddPolygon( const Vertex* points, const int numPoints, FaceID * head );
 };
 
-enum { BSP_MAX_NODES = (1U<<14)-1 };
+enum { BSP_MAX_NODES = NODE_PAYLOAD_MASK };
 enum { BSP_MAX_DEPTH = 32 };	// size of temporary stack storage (we try to avoid recursion)
+#if BSP_USE_32BIT_IDS
+enum { BSP_MAX_PLANES = NODE_PAYLOAD_MASK };	// maximum allowed number of planes in a single tree
+enum { BSP_MAX_POLYS = NODE_PAYLOAD_MASK };
+#else
 enum { BSP_MAX_PLANES = MAX_UINT16-1 };	// maximum allowed number of planes in a single tree
 enum { BSP_MAX_POLYS = MAX_UINT16-1 };
+#endif
 
 /*
 -----------------------------------------------------------------------------
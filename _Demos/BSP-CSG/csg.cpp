@@ -2,226 +2,79 @@
 #include "csg.h"
 #include "render.h"	// packF4u()
 
-static ERet Build_BSP_Tree(
-						   const BSP::Vertex* vertices, int numVertices,
-						   const UINT16* indices, int numIndices,
-						   BSP::Tree &tree
-						   )
+BrushMesh::BrushMesh()
 {
-	BSP::TProcessTriangles< BSP::Vertex, UINT16 > enumerateMeshVertices(
-		vertices, numVertices, indices, numIndices
-	);
-	mxDO(tree.Build( &enumerateMeshVertices ));
-	return ALL_OK;
+	offset = Float3_Zero();
 }
-static ERet Build_BSP_Tree(
-						   const TArray< BSP::Vertex >& vertices,
-						   const TArray< UINT16 >& indices,
-						   BSP::Tree &tree
-						   )
+
+void BrushMesh::ProcessAllTriangles( ::ATriangleIndexCallback* callback )
 {
-	return Build_BSP_Tree(
-		vertices.ToPtr(), vertices.Num(),
-		indices.ToPtr(), indices.Num(),
-		tree
-	);
+	const int numTriangles = indices.Num() / 3;
+	for( int i = 0; i < numTriangles; i++ )
+	{
+		const UINT16 * tri = indices.ToPtr() + i*3;
+		::ATriangleIndexCallback::Vertex v[3];
+		for( int k = 0; k < 3; k++ )
+		{
+			const BSP::Vertex& src = vertices[ tri[k] ];
+			v[k].xyz = src.xyz + offset;
+			v[k].st = src.UV;
+		}
+		callback->ProcessTriangle( v[0], v[1], v[2] );
+	}
 }
 
 ERet CSG::Initialize()
 {
 	// Build a BSP tree for the destructible environment.
 	{
-		BSP::Vertex planeVertices[4] =
-		{
-			//          XYZ              |            N              | T |    U  |  V
-			BSP::Vertex( Float3_Set( -100.0f, 0.0f, -100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set(    0, 1.0f ) ),
-			BSP::Vertex( Float3_Set( -100.0f, 0.0f,  100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set(    0,    0 ) ),
-			BSP::Vertex( Float3_Set(  100.0f, 0.0f,  100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set( 1.0f,    0 ) ),
-			BSP::Vertex( Float3_Set(  100.0f, 0.0f, -100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set( 1.0f, 1.0f ) ),
-		};
+		BrushMesh	ground;
+		mxDO(ground.vertices.SetNum(4));
+		//                               XYZ              |            N              | T |    U  |  V
+		ground.vertices[0] = BSP::Vertex( Float3_Set( -100.0f, 0.0f, -100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set(    0, 1.0f ) );
+		ground.vertices[1] = BSP::Vertex( Float3_Set( -100.0f, 0.0f,  100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set(    0,    0 ) );
+		ground.vertices[2] = BSP::Vertex( Float3_Set(  100.0f, 0.0f,  100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set( 1.0f,    0 ) );
+		ground.vertices[3] = BSP::Vertex( Float3_Set(  100.0f, 0.0f, -100.0f ), packF4u( 0.0f, 1.0f, 0.0f ), 0,  Float2_Set( 1.0f, 1.0f ) );
 
 		const UINT16 planeIndices[6] = {
 			0, 1, 2, 0, 2, 3,
 		};
+		mxDO(ground.indices.Add( planeIndices, BX_COUNTOF(planeIndices) ));
 
-		// Calculate tangent frames (needed for normal mapping).
-		calcTangents(
-			planeVertices, BX_COUNTOF(planeVertices), BSP::Vertex::ms_decl,
-			planeIndices, BX_COUNTOF(planeIndices) );
-
-		Build_BSP_Tree(
-			planeVertices, BX_COUNTOF(planeVertices),
-			planeIndices, BX_COUNTOF(planeIndices),
-			worldTree
-		);
-
-		DBGOUT("\nWorld BSP tree:\n");
-		BSP::Debug::PrintTree(worldTree);
+		mxDO(worldTree.Build( &ground ));
 	}
 
-
-	// Build a BSP tree for the subtractive mesh.
-
-
 	// Create test models.
 	{
-		MakeBoxMesh( 10.0f, 50.0f, 10.0f, vertices, indices );
-		FlipWinding( vertices, indices );
-		Build_BSP_Tree( vertices, indices, operand );
-		DBGOUT("\nModel BSP tree:\n");
-		BSP::Debug::PrintTree(operand);
-
-		MakeBoxMesh( 10.0f, 10.0f, 10.0f, vertices, indices );
-		Build_BSP_Tree( vertices, indices, smallBox );
-
-		MakeBoxMesh( 70.0f, 200.0f, 70.0f, vertices, indices );
-		Build_BSP_Tree( vertices, indices, largeBox );
+		MakeBoxMesh( 10.0f, 50.0f, 10.0f, operand.vertices, operand.indices );
+		MakeBoxMesh( 10.0f, 10.0f, 10.0f, smallBox.vertices, smallBox.indices );
+		MakeBoxMesh( 70.0f, 200.0f, 70.0f, largeBox.vertices, largeBox.indices );
 	}
 
-
-	// Create render mesh.
-	dynamicVB = bgfx::createDynamicVertexBuffer( 1024, BSP::Vertex::ms_decl, BGFX_BUFFER_ALLOW_RESIZE );
-	dynamicIB = bgfx::createDynamicIndexBuffer( 1024, BGFX_BUFFER_ALLOW_RESIZE );
+	// Render meshes are created in UpdateRenderMesh().
 
 	return ALL_OK;
 }
 void CSG::Shutdown()
 {
-	bgfx::destroyDynamicIndexBuffer( dynamicIB );
-	bgfx::destroyDynamicVertexBuffer( dynamicVB );
+	this->DestroyRegions();
 }
 
 void CSG::RunTestCode()
 {
-//	DBGOUT("\nPolygons before CSG:\n");
-//	BSP::Debug::PrintFaceList(worldTree, worldTree.m_nodes[0].faces);
-#if 1
-	{
-		Float3 pos = Float3_Set(40,0,20);
-#if 1
-		//Subtract(
-		//	pos,
-		//	worldTree,
-		//	operand,
-		//	temporary1
-		//	);
-
-		//MakeBoxMesh( 50.0f, 10.0f, 50.0f, vertices, indices );
-		//Build_BSP_Tree( vertices, indices, worldTree );
-
-		BSP::Tree subtractiveModel;
-		MakeBoxMesh( 70.0f, 200.0f, 70.0f, vertices, indices );
-		//MakeBoxMesh( 20.0f, 50.0f, 10.0f, vertices, indices );
-		FlipWinding( vertices, indices );
-		Build_BSP_Tree( vertices, indices, subtractiveModel );
-
-		temporary1.CopyFrom( subtractiveModel );
-		temporary2.CopyFrom( subtractiveModel );
-		worldTree.Subtract2( temporary1, temporary2 );
-
-
-		//subtractiveModel.Translate(Float3_Set(10,0,10));
-		//temporary1.CopyFrom( subtractiveModel );
-		//temporary2.CopyFrom( subtractiveModel );
-		//worldTree.Subtract2( temporary1, temporary2 );
-
-
-#else
-		temporary1.CopyFrom( operand );
-		temporary1.Translate( pos );
-		//worldTree.CopyFrom( temporary1 );
-		worldTree.m_nodes[0].back = BSP::CopySubTree(worldTree, temporary1, 0);
-		BSP::Debug::PrintTree(worldTree);
-#endif
-	}
-#endif
-
-
-
-#if 1
-#if 1
-	this->UpdateRenderMesh( worldTree );
-#else
-	{
-		//temporary1.CopyFrom( largeBox );
-		worldTree.CopyFrom( largeBox );
-
-		Vector4 plane = { 1, 0, 0, 0 };
-		BSP::NodeID front, back;
-		worldTree.PartitionNodeWithPlane( plane, 0, &front, &back );
-
-		DBGOUT("\nFront side:\n");
-		BSP::Debug::PrintTree(worldTree, front);
-		DBGOUT("\nBack side:\n");
-		BSP::Debug::PrintTree(worldTree, back);
-
-		Generate_CPU_Mesh(
-			worldTree, front,
-			vertices, indices
-		);
-	}
-#endif
-#endif
-
-
-
-#if 0
-	{
-		BSP::FaceID clippedFaces = ClipFacesOutsideBrush(
-			worldTree, worldTree.m_nodes[0].faces,
-			operand, 0
-			);
-
-		BSP::Debug::PrintFaceList(worldTree, clippedFaces);
-		{
-			vertices.Empty();
-			indices.Empty();
-			TriangulateFaces(
-				worldTree, clippedFaces,
-				vertices, indices
-				);
-			UpdateRenderMesh( vertices.ToPtr(), vertices.Num(), indices.ToPtr(), indices.Num() );
-		}
-	}
-
-#if 0
-	DBGOUT("\nPolygons after CSG:\n");
-	BSP::Debug::PrintFaceList(worldTree, worldTree.m_nodes[0].faces);
-	// 12 -> 11 -> 10 -> 9 -> 8
-
-	//DbgRemoveFirstPoly( worldTree, 0 );
-	//DbgRemoveFirstPoly( worldTree, 0 );
-	//DbgRemoveFirstPoly( worldTree, 0 );
-	//BSP::Debug::PrintFaceList(worldTree, worldTree.m_nodes[0].faces);
-
-	{
-		vertices.Empty();
-		indices.Empty();
-		TriangulateFaces(
-			worldTree, worldTree.m_nodes[0].faces,
-			vertices, indices
-			);
-		UpdateRenderMesh( vertices.ToPtr(), vertices.Num(), indices.ToPtr(), indices.Num() );
-	}
-#endif
-#endif
+	Subtract( Float3_Zero(), largeBox );
+	this->UpdateRenderMesh();
 }
 
-void CSG::Subtract(
+ERet CSG::Subtract(
 				   const Float3& _position,
-				   BSP::Tree & _worldTree,
-				   const BSP::Tree& _mesh
+				   BrushMesh & _brush
 				   )
 {
-	temporary1.CopyFrom( _mesh );
-	temporary1.Translate( _position );
-
-	temporary2.CopyFrom( _mesh );
-	temporary2.Translate( _position );
-
-	_worldTree.Subtract2( temporary1, temporary2 );
-	//	DBGOUT("\nBSP tree after CSG:\n");
-	//	BSP::Debug::PrintTree(worldTree);
+	_brush.offset = _position;
+	// only the parts of the world touched by the brush are clipped
+	mxDO(worldTree.Subtract( &_brush, dirtyRegions ));
+	return ALL_OK;
 }
 
 void CSG::Shoot(
@@ -230,16 +83,17 @@ void CSG::Shoot(
 	BSP::RayCastResult &result
 )
 {
-	worldTree.CastRay( start, direction, result );
+	const float maxDistance = 1000.0f;
+	const Float3 end = start + direction * maxDistance;
+	float t;
+	result.hitAnything = worldTree.Intersect( start, end, t );
 	if( result.hitAnything )
 	{
+		result.position = start + direction * (maxDistance * t);
 		LogStream(LL_Info) << "Hit pos: " << result.position;
-		Subtract(
-			result.position,
-			worldTree,
-			operand
-		);
-		this->UpdateRenderMesh( worldTree );
+		// the carved regions are re-uploaded even if the tree ran out of space
+		Subtract( result.position, operand );
+		this->UpdateDirtyRegions();
 	}
 }
 
@@ -249,50 +103,140 @@ void CSG::Draw( Renderer & renderer )
 	//bx::mtxInverse(invView, view);
 	//bgfx::setUniform(renderer.u_inverseViewMat, invView);
 
-	bgfx::setVertexBuffer(dynamicVB);
-	bgfx::setIndexBuffer(dynamicIB);
+	for( UINT32 iRegion = 0; iRegion < regions.Num(); iRegion++ )
+	{
+		const RenderRegion& region = regions[ iRegion ];
+		if( !region.indices.Num() ) {
+			continue;
+		}
 
-	bgfx::setTexture(0, renderer.s_texColor,  renderer.colorMap);
-	bgfx::setTexture(1, renderer.s_texNormal, renderer.normalMap);
+		bgfx::setVertexBuffer(region.dynamicVB);
+		bgfx::setIndexBuffer(region.dynamicIB);
 
-	bgfx::setState(0
-		| BGFX_STATE_RGB_WRITE
-		| BGFX_STATE_ALPHA_WRITE
-		| BGFX_STATE_CULL_CCW
-		| BGFX_STATE_DEPTH_WRITE
-		| BGFX_STATE_DEPTH_TEST_LESS
-		| BGFX_STATE_MSAA
-		);
+		bgfx::setTexture(0, renderer.s_texColor,  renderer.colorMap);
+		bgfx::setTexture(1, renderer.s_texNormal, renderer.normalMap);
 
-	bgfx::submit(RENDER_PASS_GEOMETRY_ID, renderer.geomProgram);
+		bgfx::setState(0
+			| BGFX_STATE_RGB_WRITE
+			| BGFX_STATE_ALPHA_WRITE
+			| BGFX_STATE_CULL_CCW
+			| BGFX_STATE_DEPTH_WRITE
+			| BGFX_STATE_DEPTH_TEST_LESS
+			| BGFX_STATE_MSAA
+			);
+
+		bgfx::submit(RENDER_PASS_GEOMETRY_ID, renderer.geomProgram);
+	}
 }
 
-void CSG::UpdateRenderMesh(
-					  const BSP::Tree& tree,
-					  const BSP::NodeID root
-					  )
+void CSG::UpdateRenderMesh()
 {
-	tree.GenerateMesh( vertices, indices, root );
-	UpdateRenderMesh( vertices, indices );
+	// at most one region per node at 'regionDepth' plus the top region
+	TFrameArray< BspNodeID >	regionIds( gCore.frameHeap, (1u << dirtyRegions.regionDepth) + 1 );
+	worldTree.CollectRegions( dirtyRegions.regionDepth, regionIds );
+
+	for( UINT32 i = 0; i < regionIds.Num(); i++ )
+	{
+		RenderRegion & region = this->GetRegion( regionIds[i] );
+		this->UpdateRegionMesh( region );
+	}
+	dirtyRegions.Reset();
 }
 
-void CSG::UpdateRenderMesh(
-	const TArray< BSP::Vertex >& vertices,
-	const TArray< UINT16 >& indices
-)
+void CSG::UpdateDirtyRegions()
 {
-	this->UpdateRenderMesh( vertices.ToPtr(), vertices.Num(), indices.ToPtr(), indices.Num() );
+	for( UINT32 i = 0; i < dirtyRegions.regions.Num(); i++ )
+	{
+		RenderRegion & region = this->GetRegion( dirtyRegions.regions[i] );
+		this->UpdateRegionMesh( region );
+	}
+	dirtyRegions.Reset();
 }
 
-void CSG::UpdateRenderMesh(
-	const BSP::Vertex* vertices, int numVertices,
-	const UINT16* indices, int numIndices
-)
+// Converts the triangulated polygons into the vertex format of the renderer
+// (the tree stores only positions and texture coordinates).
+static void CalculateTangentFrames(
+								   const TArray< BspVertex >& _source,
+								   const TArray< UINT32 >& _indices,
+								   TArray< BSP::Vertex > &_vertices
+								   )
 {
-	const bgfx::Memory* vertexMemory = bgfx::copy( vertices, sizeof(vertices[0])*numVertices );
-	const bgfx::Memory* indexMemory = bgfx::copy( indices, sizeof(indices[0])*numIndices );
-	bgfx::updateDynamicVertexBuffer( dynamicVB, 0, vertexMemory );
-	bgfx::updateDynamicIndexBuffer( dynamicIB, 0, indexMemory );
+	_vertices.SetNum( _source.Num() );
+	for( UINT32 i = 0; i < _source.Num(); i++ )
+	{
+		_vertices[i] = BSP::Vertex( _source[i].xyz, 0, 0, Half2_To_Float2( _source[i].st ) );
+	}
+
+	// the polygons are planar, so all triangles of a polygon produce the same frame
+	const UINT32 numTriangles = _indices.Num() / 3;
+	for( UINT32 i = 0; i < numTriangles; i++ )
+	{
+		const UINT32 * tri = _indices.ToPtr() + i*3;
+		BSP::Vertex & a = _vertices[ tri[0] ];
+		BSP::Vertex & b = _vertices[ tri[1] ];
+		BSP::Vertex & c = _vertices[ tri[2] ];
+
+		const Float3 e1 = b.xyz - a.xyz;
+		const Float3 e2 = c.xyz - a.xyz;
+		const Float3 N = Float3_Normalized( Float3_Cross( e1, e2 ) );
+
+		const Float2 dUV1 = b.UV - a.UV;
+		const Float2 dUV2 = c.UV - a.UV;
+		const float det = dUV1.x * dUV2.y - dUV2.x * dUV1.y;
+
+		Float3 T = (fabsf( det ) > 1e-6f)
+			? (e1 * dUV2.y - e2 * dUV1.y) / det
+			: Float3_FindOrthogonalTo( N );
+		// Gram-Schmidt orthogonalize
+		T = T - N * Float3_Dot( N, T );
+		T = (Float3_LengthSquared( T ) > 1e-12f) ? Float3_Normalized( T ) : Float3_FindOrthogonalTo( N );
+
+		const UINT32 packedN = packF4u( N.x, N.y, N.z );
+		const UINT32 packedT = packF4u( T.x, T.y, T.z );
+		a.N = b.N = c.N = packedN;
+		a.T = b.T = c.T = packedT;
+	}
+}
+
+void CSG::UpdateRegionMesh( RenderRegion & region )
+{
+	if(mxFAILED( worldTree.GenerateRegionMesh( region.node, dirtyRegions.regionDepth, regionVertices, region.indices ) )) {
+		region.vertices.Empty();
+		region.indices.Empty();
+		return;
+	}
+	CalculateTangentFrames( regionVertices, region.indices, region.vertices );
+	if( !region.indices.Num() ) {
+		return;
+	}
+	const bgfx::Memory* vertexMemory = bgfx::copy( region.vertices.ToPtr(), sizeof(region.vertices[0]) * region.vertices.Num() );
+	const bgfx::Memory* indexMemory = bgfx::copy( region.indices.ToPtr(), sizeof(region.indices[0]) * region.indices.Num() );
+	bgfx::updateDynamicVertexBuffer( region.dynamicVB, 0, vertexMemory );
+	bgfx::updateDynamicIndexBuffer( region.dynamicIB, 0, indexMemory );
+}
+
+CSG::RenderRegion& CSG::GetRegion( BspNodeID node )
+{
+	for( UINT32 i = 0; i < regions.Num(); i++ ) {
+		if( regions[i].node == node ) {
+			return regions[i];
+		}
+	}
+	RenderRegion & newRegion = regions.Add();
+	newRegion.node = node;
+	newRegion.dynamicVB = bgfx::createDynamicVertexBuffer( 1024, BSP::Vertex::ms_decl, BGFX_BUFFER_ALLOW_RESIZE );
+	newRegion.dynamicIB = bgfx::createDynamicIndexBuffer( 1024, BGFX_BUFFER_ALLOW_RESIZE | BGFX_BUFFER_INDEX32 );
+	return newRegion;
+}
+
+void CSG::DestroyRegions()
+{
+	for( UINT32 i = 0; i < regions.Num(); i++ )
+	{
+		bgfx::destroyDynamicIndexBuffer( regions[i].dynamicIB );
+		bgfx::destroyDynamicVertexBuffer( regions[i].dynamicVB );
+	}
+	regions.Clear();
 }
 
 void CSG::MakeBoxMesh(
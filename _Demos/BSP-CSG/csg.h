@@ -2,31 +2,48 @@
 #pragma once
 
 #include "bsp.h"
+#include <Meshok/BSP.h>
 
 class Renderer;
 
+// A triangle mesh (e.g. a subtractive brush) translated by the given offset.
+struct BrushMesh : ::ATriangleMeshInterface
+{
+	TArray< BSP::Vertex >	vertices;
+	TArray< UINT16 >		indices;
+	Float3					offset;
+public:
+	BrushMesh();
+	virtual void ProcessAllTriangles( ::ATriangleIndexCallback* callback ) override;
+};
+
 struct CSG
 {
 	// The tree representing a destructible environment.
-	BSP::Tree	worldTree;
+	BspTree		worldTree;
 
-	// Subtractive CSG models for testing (they are 'inside-out' meshes).
-	BSP::Tree	operand;
-	BSP::Tree	smallBox;
-	BSP::Tree	largeBox;
-	BSP::Tree	rotatedBox;
+	// Subtractive CSG models for testing (closed meshes with outward-facing triangles).
+	BrushMesh	operand;
+	BrushMesh	smallBox;
+	BrushMesh	largeBox;
 
-	// Temporary storage for storing intermediate results of CSG calculations to reduce memory allocations.
-	BSP::Tree	temporary1;
-	BSP::Tree	temporary2;
+	// Geometry of a single region of the world tree (see BspDirtyRegions).
+	struct RenderRegion
+	{
+		BspNodeID				node;
+		TArray< BSP::Vertex >	vertices;	// kept for debug drawing
+		TArray< UINT32 >		indices;
+		// Dynamic GPU buffers for rendering.
+		bgfx::DynamicVertexBufferHandle dynamicVB;
+		bgfx::DynamicIndexBufferHandle dynamicIB;
+	};
+	TArray< RenderRegion >	regions;
 
-	// Buffers for storing generated geometry.
-	TArray< BSP::Vertex >	vertices;
-	TArray< UINT16 >		indices;
+	// Regions of the world tree modified since the last update of the render mesh.
+	BspDirtyRegions			dirtyRegions;
 
-	// Dynamic GPU buffers for rendering.
-	bgfx::DynamicVertexBufferHandle dynamicVB;
-	bgfx::DynamicIndexBufferHandle dynamicIB;
+	// Temporary storage for the triangulated polygons of a region.
+	TArray< BspVertex >		regionVertices;
 
 public:
 	ERet Initialize();
@@ -34,17 +51,10 @@ public:
 
 	void RunTestCode();
 
-	//void Subtract(
-	//	const Float3& _position,
-	//	BSP::Tree & _worldTree,
-	//	const BSP::Tree& _mesh,	// subtractive brush (template)
-	//	BSP::Tree & _temporary	// subtractive brush (instance)
-	//);
-
-	void Subtract(
+	// carves the brush placed at the given position out of the world tree
+	ERet Subtract(
 		const Float3& _position,
-		BSP::Tree & _worldTree,
-		const BSP::Tree& _mesh	// subtractive brush
+		BrushMesh & _brush
 	);
 
 	void Shoot(
@@ -55,18 +65,15 @@ public:
 
 	void Draw( Renderer & renderer );
 
-	void UpdateRenderMesh(
-		const BSP::Tree& tree,
-		const BSP::NodeID root = 0
-	);
-	void UpdateRenderMesh(
-		const BSP::Vertex* vertices, int numVertices,
-		const UINT16* indices, int numIndices
-	);
-	void UpdateRenderMesh(
-		const TArray< BSP::Vertex >& vertices,
-		const TArray< UINT16 >& indices
-	);
+	// Regenerates the geometry of all render regions.
+	void UpdateRenderMesh();
+
+	// Regenerates and re-uploads only the regions modified by CSG operations.
+	void UpdateDirtyRegions();
+
+	void UpdateRegionMesh( RenderRegion & region );
+	RenderRegion& GetRegion( BspNodeID node );
+	void DestroyRegions();
 
 	static void MakeBoxMesh(
 		float length, float height, float depth,
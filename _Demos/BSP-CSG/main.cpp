@@ -490,7 +490,6 @@ ERet MyEntryPoint()
 
 	csg.RunTestCode();
 //csg.UpdateRenderMesh(csg.worldTree);
-	BSP::Debug::PrintTree(csg.worldTree);
 //GeneratePolygons(csg.worldTree, 0, Float3_Zero(), csg.vertices, csg.indices);
 //csg.UpdateRenderMesh(csg.vertices, csg.indices);
 
@@ -791,14 +790,16 @@ ERet MyEntryPoint()
 
 		debugDraw.DrawAxes(100);
 
+		for( UINT32 iRegion = 0; iRegion < csg.regions.Num(); iRegion++ )
 		{
-			const int numTriangles = csg.indices.Num() / 3;
+			const CSG::RenderRegion& region = csg.regions[ iRegion ];
+			const int numTriangles = region.indices.Num() / 3;
 			for( int i = 0; i < numTriangles; i++ )
 			{
-				UINT16 * tri = csg.indices.ToPtr() + i*3;
-				const BSP::Vertex& a = csg.vertices[ tri[0] ];
-				const BSP::Vertex& b = csg.vertices[ tri[1] ];
-				const BSP::Vertex& c = csg.vertices[ tri[2] ];
+				const UINT32 * tri = region.indices.ToPtr() + i*3;
+				const BSP::Vertex& a = region.vertices[ tri[0] ];
+				const BSP::Vertex& b = region.vertices[ tri[1] ];
+				const BSP::Vertex& c = region.vertices[ tri[2] ];
 				debugDraw.DrawWireTriangle( a.xyz, b.xyz, c.xyz );
 			}			
 		}
@@ -826,8 +827,6 @@ ERet MyEntryPoint()
 
 				csg.Shoot( rayPos, rayDir, lastHit );
 
-		DBGOUT("\nBSP tree after CSG:\n");
-		BSP::Debug::PrintTree(csg.worldTree);
 
 //GeneratePolygons(csg.worldTree, 0, Float3_Zero(), csg.vertices, csg.indices);
 //csg.UpdateRenderMesh(csg.vertices, csg.indices);
@@ -871,6 +871,9 @@ ERet Renderer::EndFrame()
 	// process submitted rendering primitives.
 	bgfx::frame();
 
+	// the demo doesn't call llgl::NextFrame(), so the oldest frame is retired here
+	gCore.frameHeap.BeginFrame();
+
 	return ALL_OK;
 }
 
@@ -129,6 +129,7 @@ extern int mxAppMain();
 #include "Math/ptFloat16.h"
 #include "Math/ptFloat32.h"
 #include "Math/NewMath.h"
+#include "Math/SoAMath.h"
 #include "Math/Hashing/HashFunctions.h"
 
 // Input/Output system.
@@ -88,6 +88,96 @@ const bool Matrix_TryInverse( Float4x4 * m )
 UNDONE;
 return false;
 }
+#if MM_ENABLE_INTRINSICS
+
+// 2x2 sub-matrices are stored in vectors as (m00, m01, m10, m11)
+#define mmSHUFFLE2( a, b, x, y, z, w )	_mm_shuffle_ps( (a), (b), _MM_SHUFFLE( (w), (z), (y), (x) ) )
+#define mmSWIZZLE1( v, x )				_mm_shuffle_ps( (v), (v), _MM_SHUFFLE( (x), (x), (x), (x) ) )
+
+// 2x2 matrix multiply: A * B
+static inline __m128 Mat2Mul( __m128 a, __m128 b )
+{
+	return _mm_add_ps( _mm_mul_ps( a, mmSHUFFLE2( b, b, 0,3,0,3 ) ),
+		_mm_mul_ps( mmSHUFFLE2( a, a, 1,0,3,2 ), mmSHUFFLE2( b, b, 2,1,2,1 ) ) );
+}
+// 2x2 matrix adjugate multiply: adj(A) * B
+static inline __m128 Mat2AdjMul( __m128 a, __m128 b )
+{
+	return _mm_sub_ps( _mm_mul_ps( mmSHUFFLE2( a, a, 3,3,0,0 ), b ),
+		_mm_mul_ps( mmSHUFFLE2( a, a, 1,1,2,2 ), mmSHUFFLE2( b, b, 2,3,0,1 ) ) );
+}
+// 2x2 matrix multiply adjugate: A * adj(B)
+static inline __m128 Mat2MulAdj( __m128 a, __m128 b )
+{
+	return _mm_sub_ps( _mm_mul_ps( a, mmSHUFFLE2( b, b, 3,0,3,0 ) ),
+		_mm_mul_ps( mmSHUFFLE2( a, a, 1,0,3,2 ), mmSHUFFLE2( b, b, 2,1,2,1 ) ) );
+}
+
+// inverse of a general 4x4 matrix using 2x2 sub-matrices (blockwise inversion):
+// https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+//
+const Float4x4 Matrix_Inverse( const Float4x4& m )
+{
+	const __m128 r0 = SSE_Load( m.r0 );
+	const __m128 r1 = SSE_Load( m.r1 );
+	const __m128 r2 = SSE_Load( m.r2 );
+	const __m128 r3 = SSE_Load( m.r3 );
+
+	// the sub-matrices: | A B |
+	//                   | C D |
+	const __m128 A = _mm_movelh_ps( r0, r1 );
+	const __m128 B = _mm_movehl_ps( r1, r0 );
+	const __m128 C = _mm_movelh_ps( r2, r3 );
+	const __m128 D = _mm_movehl_ps( r3, r2 );
+
+	// the determinants of the sub-matrices: (|A|, |B|, |C|, |D|)
+	const __m128 detSub = _mm_sub_ps(
+		_mm_mul_ps( mmSHUFFLE2( r0, r2, 0,2,0,2 ), mmSHUFFLE2( r1, r3, 1,3,1,3 ) ),
+		_mm_mul_ps( mmSHUFFLE2( r0, r2, 1,3,1,3 ), mmSHUFFLE2( r1, r3, 0,2,0,2 ) )
+		);
+	const __m128 detA = mmSWIZZLE1( detSub, 0 );
+	const __m128 detB = mmSWIZZLE1( detSub, 1 );
+	const __m128 detC = mmSWIZZLE1( detSub, 2 );
+	const __m128 detD = mmSWIZZLE1( detSub, 3 );
+
+	const __m128 D_C = Mat2AdjMul( D, C );
+	const __m128 A_B = Mat2AdjMul( A, B );
+
+	// the sub-matrices of the adjugate matrix
+	__m128 X_ = _mm_sub_ps( _mm_mul_ps( detD, A ), Mat2Mul( B, D_C ) );
+	__m128 W_ = _mm_sub_ps( _mm_mul_ps( detA, D ), Mat2Mul( C, A_B ) );
+	__m128 Y_ = _mm_sub_ps( _mm_mul_ps( detB, C ), Mat2MulAdj( D, A_B ) );
+	__m128 Z_ = _mm_sub_ps( _mm_mul_ps( detC, B ), Mat2MulAdj( A, D_C ) );
+
+	// |M| = |A|*|D| + |B|*|C| - tr( adj(A)*B * adj(D)*C )
+	__m128 detM = _mm_add_ps( _mm_mul_ps( detA, detD ), _mm_mul_ps( detB, detC ) );
+	__m128 tr = _mm_mul_ps( A_B, mmSHUFFLE2( D_C, D_C, 0,2,1,3 ) );
+	tr = _mm_add_ps( tr, _mm_movehl_ps( tr, tr ) );
+	tr = _mm_add_ss( tr, mmSWIZZLE1( tr, 1 ) );
+	detM = _mm_sub_ps( detM, mmSWIZZLE1( tr, 0 ) );
+	mxASSERT(_mm_cvtss_f32( detM ) != 0);
+
+	const __m128 adjSignMask = _mm_setr_ps( 1.0f, -1.0f, -1.0f, 1.0f );
+	const __m128 rcpDetM = _mm_div_ps( adjSignMask, detM );
+
+	X_ = _mm_mul_ps( X_, rcpDetM );
+	Y_ = _mm_mul_ps( Y_, rcpDetM );
+	Z_ = _mm_mul_ps( Z_, rcpDetM );
+	W_ = _mm_mul_ps( W_, rcpDetM );
+
+	Float4x4 result;
+	_mm_store_ps( &result.r0.x, mmSHUFFLE2( X_, Y_, 3,1,3,1 ) );
+	_mm_store_ps( &result.r1.x, mmSHUFFLE2( X_, Y_, 2,0,2,0 ) );
+	_mm_store_ps( &result.r2.x, mmSHUFFLE2( Z_, W_, 3,1,3,1 ) );
+	_mm_store_ps( &result.r3.x, mmSHUFFLE2( Z_, W_, 2,0,2,0 ) );
+	return result;
+}
+
+#undef mmSHUFFLE2
+#undef mmSWIZZLE1
+
+#else
+
 // http://stackoverflow.com/a/9614511/4232223
 // based on Laplace Expansion Theorem: http://www.geometrictools.com/Documentation/LaplaceExpansionTheorem.pdf
 //
@@ -136,6 +226,8 @@ const Float4x4 Matrix_Inverse( const Float4x4& m )
 
 	return result;
 }
+
+#endif // MM_ENABLE_INTRINSICS
 // Builds a right-handed look-at (or view) matrix.
 // A view transformation matrix transforms world coordinates into the camera or view space.
 // Parameters:
@@ -612,6 +704,47 @@ const bool Matrix_Equal( const Float4x4& A, const Float4x4& B, const float epsil
 	return true;
 }
 
+void Matrix_TransformPoints( const Float4x4& m, const Vector4* points, UINT32 count, Vector4 *result )
+{
+	UINT32 i = 0;
+#if MM_ENABLE_AVX
+	// transform two points at a time, each 128-bit lane holds one point
+	const __m256 row0 = _mm256_broadcast_ps( reinterpret_cast< const __m128* >( &m.r0 ) );
+	const __m256 row1 = _mm256_broadcast_ps( reinterpret_cast< const __m128* >( &m.r1 ) );
+	const __m256 row2 = _mm256_broadcast_ps( reinterpret_cast< const __m128* >( &m.r2 ) );
+	const __m256 row3 = _mm256_broadcast_ps( reinterpret_cast< const __m128* >( &m.r3 ) );
+	for( ; i + 2 <= count; i += 2 )
+	{
+		const __m256 P = _mm256_loadu_ps( &points[i].x );
+		__m256 R = _mm256_mul_ps( row0, _mm256_permute_ps( P, _MM_SHUFFLE(0,0,0,0) ) );
+		R = _mm256_add_ps( R, _mm256_mul_ps( row1, _mm256_permute_ps( P, _MM_SHUFFLE(1,1,1,1) ) ) );
+		R = _mm256_add_ps( R, _mm256_mul_ps( row2, _mm256_permute_ps( P, _MM_SHUFFLE(2,2,2,2) ) ) );
+		R = _mm256_add_ps( R, row3 );
+		_mm256_storeu_ps( &result[i].x, R );
+	}
+#endif // MM_ENABLE_AVX
+#if MM_ENABLE_INTRINSICS
+	const __m128 r0 = SSE_Load( m.r0 );
+	const __m128 r1 = SSE_Load( m.r1 );
+	const __m128 r2 = SSE_Load( m.r2 );
+	const __m128 r3 = SSE_Load( m.r3 );
+	for( ; i < count; i++ )
+	{
+		const __m128 P = SSE_Load( points[i] );
+		__m128 R = _mm_mul_ps( r0, _mm_shuffle_ps( P, P, _MM_SHUFFLE(0,0,0,0) ) );
+		R = _mm_add_ps( R, _mm_mul_ps( r1, _mm_shuffle_ps( P, P, _MM_SHUFFLE(1,1,1,1) ) ) );
+		R = _mm_add_ps( R, _mm_mul_ps( r2, _mm_shuffle_ps( P, P, _MM_SHUFFLE(2,2,2,2) ) ) );
+		R = _mm_add_ps( R, r3 );
+		_mm_storeu_ps( &result[i].x, R );
+	}
+#else
+	for( ; i < count; i++ )
+	{
+		result[i] = Matrix_Transform3( m, points[i] );
+	}
+#endif // MM_ENABLE_INTRINSICS
+}
+
 // [ X, Y, Z, W ] => projection transform => homogeneous divide => [Px, Py, Pz, W ]
 const Float4 Matrix_Project( const Float4x4& m, const Float4& p )
 {
@@ -1089,6 +1222,16 @@ const Vector4 Quaternion_Inverse( Vector4Arg q )
 // Does not clamp t between 0 and 1.
 const Vector4 Quaternion_Slerp( Vector4Arg q0, Vector4Arg q1, float t )
 {
+#if MM_ENABLE_INTRINSICS
+	const __m128 Q0 = SSE_Load( q0 );
+	const __m128 Q1 = SSE_Load( q1 );
+	// Compute "cosine of angle between quaternions" using dot product
+	const __m128 dot = SSE_Dot4( Q0, Q1 );
+	// If cosTheta < 0, negate one quat to take the short way around the sphere (see below).
+	const __m128 negateMask = _mm_and_ps( _mm_cmplt_ps( dot, _mm_setzero_ps() ), SSE_Load( g_MMNegativeZero.v ) );
+	const __m128 start = _mm_xor_ps( Q0, negateMask );
+	const float cosTheta = _mm_cvtss_f32( _mm_xor_ps( dot, negateMask ) );
+#else
     Float4 start;
 	// Compute "cosine of angle between quaternions" using dot product
 	float cosTheta = Vector4_Dot( q0, q1 );
@@ -1102,6 +1245,7 @@ const Vector4 Quaternion_Slerp( Vector4Arg q0, Vector4Arg q1, float t )
     } else {
         start = q0;
     }
+#endif // MM_ENABLE_INTRINSICS
 	// Interpolation = A*[sin((1-Elapsed) * Angle)/sin(Angle)] + B * [sin (Elapsed * Angle) / sin(Angle)]
 	float scale0, scale1;
     if( cosTheta < mxSLERP_DELTA ) {
@@ -1119,7 +1263,11 @@ const Vector4 Quaternion_Slerp( Vector4Arg q0, Vector4Arg q1, float t )
         scale1 = t;
     }
 	// Interpolate and return new quaternion
+#if MM_ENABLE_INTRINSICS
+	return SSE_Store( _mm_add_ps( _mm_mul_ps( start, _mm_set1_ps( scale0 ) ), _mm_mul_ps( Q1, _mm_set1_ps( scale1 ) ) ) );
+#else
     return Vector4_Add( Vector4_Scale( start, scale0 ), Vector4_Scale( q1, scale1 ) );
+#endif // MM_ENABLE_INTRINSICS
 }
 // Constructs a quaternion from the Euler angles.
 const Vector4 Quaternion_RotationPitchRollYaw( float pitch, float roll, float yaw )
@@ -1172,6 +1320,115 @@ const Vector4 Quaternion_RotationNormal( Vector4Arg normalAxis, float angle )
 	return result;
 }
 
+// Extracts the frustum planes from the combined view-projection matrix (Gribb & Hartmann):
+// the clip space position is p * M, so the planes are combinations of the columns of M.
+void Frustum_ExtractPlanes( const Float4x4& viewProjection, Vector4 planes[6] )
+{
+	const Float4x4 columns = Matrix_Transpose( viewProjection );
+	planes[0] = Plane_Normalize( Vector4_Add( columns.r3, columns.r0 ) );		// left:	-w <= x
+	planes[1] = Plane_Normalize( Vector4_Subtract( columns.r3, columns.r0 ) );	// right:	x <= w
+	planes[2] = Plane_Normalize( Vector4_Add( columns.r3, columns.r1 ) );		// bottom:	-w <= y
+	planes[3] = Plane_Normalize( Vector4_Subtract( columns.r3, columns.r1 ) );	// top:		y <= w
+	planes[4] = Plane_Normalize( columns.r2 );									// near:	0 <= z
+	planes[5] = Plane_Normalize( Vector4_Subtract( columns.r3, columns.r2 ) );	// far:		z <= w
+}
+
+#if MM_ENABLE_INTRINSICS
+
+// the frustum planes in SoA layout: the components of planes 0-3 and 4-5 (the last two are duplicated)
+struct FrustumSoA
+{
+	__m128	x[2], y[2], z[2], w[2];
+};
+static inline void Frustum_LoadSoA( const Vector4 planes[6], FrustumSoA &soa )
+{
+	soa.x[0] = SSE_Load( planes[0] );
+	soa.y[0] = SSE_Load( planes[1] );
+	soa.z[0] = SSE_Load( planes[2] );
+	soa.w[0] = SSE_Load( planes[3] );
+	_MM_TRANSPOSE4_PS( soa.x[0], soa.y[0], soa.z[0], soa.w[0] );
+	soa.x[1] = SSE_Load( planes[4] );
+	soa.y[1] = SSE_Load( planes[5] );
+	soa.z[1] = soa.x[1];
+	soa.w[1] = soa.y[1];
+	_MM_TRANSPOSE4_PS( soa.x[1], soa.y[1], soa.z[1], soa.w[1] );
+}
+
+#endif // MM_ENABLE_INTRINSICS
+
+// Returns false if the sphere is completely outside the frustum (conservative test).
+const bool Frustum_IntersectsSphere( const Vector4 planes[6], Vector4Arg sphere )
+{
+#if MM_ENABLE_INTRINSICS
+	FrustumSoA	soa;
+	Frustum_LoadSoA( planes, soa );
+	const __m128 S = SSE_Load( sphere );
+	const __m128 cx = _mm_shuffle_ps( S, S, _MM_SHUFFLE(0,0,0,0) );
+	const __m128 cy = _mm_shuffle_ps( S, S, _MM_SHUFFLE(1,1,1,1) );
+	const __m128 cz = _mm_shuffle_ps( S, S, _MM_SHUFFLE(2,2,2,2) );
+	const __m128 negRadius = _mm_xor_ps( _mm_shuffle_ps( S, S, _MM_SHUFFLE(3,3,3,3) ), SSE_Load( g_MMNegativeZero.v ) );
+	for( int i = 0; i < 2; i++ )
+	{
+		__m128 distance = _mm_mul_ps( soa.x[i], cx );
+		distance = _mm_add_ps( distance, _mm_mul_ps( soa.y[i], cy ) );
+		distance = _mm_add_ps( distance, _mm_mul_ps( soa.z[i], cz ) );
+		distance = _mm_add_ps( distance, soa.w[i] );
+		// most culled objects are outside the side planes, which are tested first
+		if( _mm_movemask_ps( _mm_cmplt_ps( distance, negRadius ) ) ) {
+			return false;
+		}
+	}
+	return true;
+#else
+	for( int i = 0; i < 6; i++ )
+	{
+		if( Plane_DotCoord( planes[i], sphere ) < -sphere.w ) {
+			return false;
+		}
+	}
+	return true;
+#endif // MM_ENABLE_INTRINSICS
+}
+
+// Returns false if the axis-aligned box is completely outside the frustum (conservative test).
+const bool Frustum_IntersectsAABB( const Vector4 planes[6], Vector4Arg center, Vector4Arg extent )
+{
+#if MM_ENABLE_INTRINSICS
+	FrustumSoA	soa;
+	Frustum_LoadSoA( planes, soa );
+	const __m128 C = SSE_Load( center );
+	const __m128 E = SSE_Load( extent );
+	const __m128 absMask = SSE_Load( g_MMAbsMask.v );
+	for( int i = 0; i < 2; i++ )
+	{
+		// the distance from the plane to the center
+		__m128 distance = _mm_mul_ps( soa.x[i], _mm_shuffle_ps( C, C, _MM_SHUFFLE(0,0,0,0) ) );
+		distance = _mm_add_ps( distance, _mm_mul_ps( soa.y[i], _mm_shuffle_ps( C, C, _MM_SHUFFLE(1,1,1,1) ) ) );
+		distance = _mm_add_ps( distance, _mm_mul_ps( soa.z[i], _mm_shuffle_ps( C, C, _MM_SHUFFLE(2,2,2,2) ) ) );
+		distance = _mm_add_ps( distance, soa.w[i] );
+		// the projected radius of the box
+		__m128 radius = _mm_mul_ps( _mm_and_ps( soa.x[i], absMask ), _mm_shuffle_ps( E, E, _MM_SHUFFLE(0,0,0,0) ) );
+		radius = _mm_add_ps( radius, _mm_mul_ps( _mm_and_ps( soa.y[i], absMask ), _mm_shuffle_ps( E, E, _MM_SHUFFLE(1,1,1,1) ) ) );
+		radius = _mm_add_ps( radius, _mm_mul_ps( _mm_and_ps( soa.z[i], absMask ), _mm_shuffle_ps( E, E, _MM_SHUFFLE(2,2,2,2) ) ) );
+		if( _mm_movemask_ps( _mm_cmplt_ps( _mm_add_ps( distance, radius ), _mm_setzero_ps() ) ) ) {
+			return false;
+		}
+	}
+	return true;
+#else
+	for( int i = 0; i < 6; i++ )
+	{
+		const Vector4& plane = planes[i];
+		const float distance = Plane_DotCoord( plane, center );
+		const float radius = (Float_Abs( plane.x ) * extent.x) + (Float_Abs( plane.y ) * extent.y) + (Float_Abs( plane.z ) * extent.z);
+		if( distance + radius < 0.0f ) {
+			return false;
+		}
+	}
+	return true;
+#endif // MM_ENABLE_INTRINSICS
+}
+
 ATextStream & operator << ( ATextStream & log, const Float2& v )
 {
 	log.PrintF("(%.3f, %.3f)",v.x,v.y);
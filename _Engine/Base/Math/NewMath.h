@@ -7,7 +7,18 @@
 */
 #pragma once
 
-#define MM_ENABLE_INTRINSICS	(0)
+// use the SSE2 backend (NewMathSSE.inl) instead of the scalar one (NewMathFPU.inl);
+// both backends produce bit-identical results for basic vector and matrix operations
+// (the summation order is the same), see NewMath_VerifyBackend()
+#ifndef MM_ENABLE_INTRINSICS
+#define MM_ENABLE_INTRINSICS	(1)
+#endif
+
+// use AVX for batched transforms and SDF distance queries (requires VS2010 SP1 or later and /arch:AVX)
+#ifndef MM_ENABLE_AVX
+#define MM_ENABLE_AVX			(0)
+#endif
+
 #define MM_ENABLE_REFLECTION	(1)
 
 // overload [] and arithmetic operators for convenience
@@ -30,6 +41,9 @@ mmintrin.h - MMX instruction set. (Defines __m64.)
 #if defined(__SSE4_1__)
 #	include <smmintrin.h>
 #endif // defined(__SSE4_1__)
+#if MM_ENABLE_AVX
+#	include <immintrin.h>	// AVX, __m256
+#endif // MM_ENABLE_AVX
 
 /*
 =======================================================================
@@ -57,10 +71,8 @@ mmintrin.h - MMX instruction set. (Defines __m64.)
 #define mmCACHE_LINE_SIZE  64
 
 // Stolen from XMISNAN and XMISINF
-#if !MM_ENABLE_INTRINSICS
 #define mmIS_NAN(x)  ((*(UINT*)&(x) & 0x7F800000) == 0x7F800000 && (*(UINT*)&(x) & 0x7FFFFF) != 0)
 #define mmIS_INF(x)  ((*(UINT*)&(x) & 0x7FFFFFFF) == 0x7F800000)
-#endif
 
 /*
 =======================================================================
@@ -102,35 +114,25 @@ __declspec(align(32)) struct Float8
 	float	p, q, r, s;
 };
 
-#if MM_ENABLE_INTRINSICS
-
-	// Define 128-bit wide 16-byte aligned hardware register type.
-	typedef __m128				Vector4;
-
-	// Microsoft recommends passing the __m128 data type by reference to functions.
-	// This is the behavior of the XNA Math Library.
-	//typedef const __m128&		Vector4Arg;
-	// But Win32 VC++ does not support passing aligned objects by value,
-	// here is a bug-report at Microsoft saying so:
-	// http://connect.microsoft.com/VisualStudio/feedback/ViewFeedback.aspx?FeedbackID=334581
-	typedef const __m128		Vector4Arg;
+// Vectors are stored as Float4 with both backends, because the engine code accesses their components directly;
+// the SSE backend loads them into __m128 registers inside each function
+// (the compiler removes redundant loads and stores when the functions are inlined).
+// NOTE: Win32 VC++ does not support passing aligned objects by value,
+// here is a bug-report at Microsoft saying so:
+// http://connect.microsoft.com/VisualStudio/feedback/ViewFeedback.aspx?FeedbackID=334581
 
-#else
-
-	// Fall back to 128-bit wide 4D floating point vector type.
+	// 128-bit wide 4D floating point vector type.
 	typedef Float4				Vector4;
 
 	// the vector parameter type (for passing vectors to functions)
 	typedef const Float4 &		Vector4Arg;
 
-	// Fall back to 256-bit wide 4D floating point vector type.
+	// 256-bit wide 8D floating point vector type.
 	typedef Float8				Vector8;
 
 	// the vector parameter type (for passing vectors to functions)
 	typedef const Float8 &		Vector8Arg;
 
-#endif
-
 
 union Vector4i
 {
@@ -307,17 +309,8 @@ mxPREALIGN(16) struct Float4x4
 #endif
 };
 
-//@todo: specify passing by value or register depending on the platform
-#if MM_ENABLE_INTRINSICS
-
-	typedef const Float4x4 &	Float4x4Arg;
-
-#else
-
 	typedef const Float4x4 &	Float4x4Arg;
 
-#endif
-
 /*
 ----------------------------------------------------------------------
 	Packed matrix: the fourth row is (0,0,0,1),
@@ -609,6 +602,9 @@ const Float4	Matrix_Project( const Float4x4& m, const Float4& p );
 const bool		Matrix_Equal( const Float4x4& A, const Float4x4& B );
 const bool		Matrix_Equal( const Float4x4& A, const Float4x4& B, const float epsilon );
 
+// Transforms 3D points (W=1) by a 4x4 matrix (uses AVX if MM_ENABLE_AVX is set), 'result' can be equal to 'points'.
+void			Matrix_TransformPoints( const Float4x4& m, const Vector4* points, UINT32 count, Vector4 *result );
+
 const Float4x4	Matrix_RotationX( float angle );
 const Float4x4	Matrix_RotationY( float angle );
 const Float4x4	Matrix_RotationZ( float angle );
@@ -652,6 +648,18 @@ const Float3& Plane_GetNormal( const Float4& plane );
 const float Plane_PointDistance( const Float4& plane, const Float3& point );
 const bool Plane_ContainsPoint( const Float4& plane, const Float3& point, float epsilon );
 const Float4 Plane_Translate( const Float4& plane, const Float3& translation );
+const Vector4 Plane_Normalize( Vector4Arg plane );
+const float Plane_DotCoord( Vector4Arg plane, Vector4Arg point );	// point.w is treated as 1
+
+//=====================================================================
+//	FRUSTUM OPERATIONS
+//	The frustum is represented by six planes (N, d) with normals pointing inside:
+//	left, right, bottom, top, near, far.
+//=====================================================================
+
+void Frustum_ExtractPlanes( const Float4x4& viewProjection, Vector4 planes[6] );	// D3D clip space (0 <= z <= w)
+const bool Frustum_IntersectsSphere( const Vector4 planes[6], Vector4Arg sphere );	// sphere = (center, radius)
+const bool Frustum_IntersectsAABB( const Vector4 planes[6], Vector4Arg center, Vector4Arg extent );
 
 //=====================================================================
 //	COLOR OPERATIONS
@@ -896,6 +904,7 @@ mmGLOBALCONST Vector4i g_MMFlipW             = {0,0,0,0x80000000};
 mmGLOBALCONST Vector4i g_MMFlipYZ            = {0,0x80000000,0x80000000,0};
 mmGLOBALCONST Vector4i g_MMFlipZW            = {0,0,0x80000000,0x80000000};
 mmGLOBALCONST Vector4i g_MMFlipYW            = {0,0x80000000,0,0x80000000};
+mmGLOBALCONST Vector4i g_MMFlipXW            = {0x80000000,0,0,0x80000000};
 mmGLOBALCONST Vector4i g_MMMaskHenD3         = {0x7FF,0x7ff<<11,0x3FF<<22,0};
 mmGLOBALCONST Vector4i g_MMMaskDHen3         = {0x3FF,0x7ff<<10,0x7FF<<21,0};
 mmGLOBALCONST Vector4f g_MMAddUHenD3         = {0,0,32768.0f*65536.0f,0};
@@ -963,6 +972,20 @@ mxDECLARE_STRUCT(Half2);
 
 #endif // MM_ENABLE_REFLECTION
 
+/*
+=======================================================================
+	TESTING
+=======================================================================
+*/
+
+// Compares the results of the current backend (FPU or SSE, see MM_ENABLE_INTRINSICS)
+// with double-precision reference computations on random inputs,
+// fails if the error of any function exceeds 'maxUlps' units in the last place.
+ERet NewMath_VerifyBackend( UINT32 numSamples = 10000, UINT32 maxUlps = 16 );
+
+// Measures the speed of the most used operations and prints the results.
+void NewMath_Benchmark( UINT32 numIterations = 1000000 );
+
 /*
 =======================================================================
 	LOGGING
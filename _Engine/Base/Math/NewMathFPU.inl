@@ -1,273 +1,3 @@
-inline const Vector4 LoadFloat3( const Float3& v, float w )
-{
-	Vector4	result;
-	result.x = v.x;
-	result.y = v.y;
-	result.z = v.z;
-	result.w = w;
-	return result;
-}
-
-inline const Float2 Float2_Zero()
-{
-	Float2 result;
-	result.x = 0.0f;
-	result.y = 0.0f;
-	return result;
-}
-inline const Float2 Float2_Set( float x, float y )
-{
-	Float2 result;
-	result.x = x;
-	result.y = y;
-	return result;
-}
-inline const Float2 Float2_Scale( const Float2& v, float s )
-{
-	Float2 result;
-	result.x = v.x * s;
-	result.y = v.y * s;
-	return result;
-}
-inline const float Float2_Length( const Float2& v )
-{
-	return Float_Sqrt( Float2_Dot( v, v ) );
-}
-inline const float Float2_Dot( const Float2& a, const Float2& b )
-{
-	return (a.x * b.x) + (a.y * b.y);
-}
-// Linearly interpolates one vector to another.
-// Precise method which guarantees from = to when amount = 1.
-inline const Float2 Float2_Lerp( const Float2& from, const Float2& to, float amount )
-{
-	if( amount <= 0.0f ) {
-		return from;
-	} else if( amount >= 1.0f ) {
-		return to;
-	} else {
-		return Float2_Lerp01( from, to, amount );
-	}
-}
-inline const Float2 Float2_Lerp01( const Float2& from, const Float2& to, float amount )
-{
-	mxASSERT(amount >= 0.0f && amount <= 1.0f);
-	return from + ( to - from ) * amount;
-}
-
-inline const Float3 Float3_Zero()
-{
-	Float3 result;
-	result.x = 0.0f;
-	result.y = 0.0f;
-	result.z = 0.0f;
-	return result;
-}
-inline const Float3 Float3_Replicate( float value )
-{
-	Float3 result;
-	result.x = value;
-	result.y = value;
-	result.z = value;
-	return result;
-}
-inline const Float3 Float3_Set( float x, float y, float z )
-{
-	Float3 result;
-	result.x = x;
-	result.y = y;
-	result.z = z;
-	return result;
-}
-inline const Float3 Float3_Scale( const Float3& v, float s )
-{
-	Float3 result;
-	result.x = v.x * s;
-	result.y = v.y * s;
-	result.z = v.z * s;
-	return result;
-}
-inline const float Float3_LengthSquared( const Float3& v )
-{
-	return Float3_Dot( v, v );
-}
-inline const float Float3_Length( const Float3& v )
-{
-	return Float_Sqrt( Float3_LengthSquared( v ) );
-}
-inline const Float3 Float3_Normalized( const Float3& v )
-{
-	float length = Float3_LengthSquared( v );
-	// Prevent divide by zero.
-	if( length != 0.0f ) {
-		length = Float_InvSqrt( length );
-	}
-	return Float3_Scale( v, length );
-}
-inline const Float3 Float3_Abs( const Float3& x )
-{
-	Float3 result;
-	result.x = Float_Abs( x.x );
-	result.y = Float_Abs( x.y );
-	result.z = Float_Abs( x.z );
-	return result;
-}
-inline const Float3 Float3_Negate( const Float3& x )
-{
-	Float3 result;
-	result.x = -x.x;
-	result.y = -x.y;
-	result.z = -x.z;
-	return result;
-}
-inline const Float3 Float3_Reciprocal( const Float3& v )
-{
-	Float3 result = { Float_Rcp(v.x), Float_Rcp(v.y), Float_Rcp(v.z) };
-	return result;
-}
-inline const bool Float3_IsInfinite( const Float3& v )
-{
-	return mmIS_INF(v.x) || mmIS_INF(v.y) || mmIS_INF(v.z);
-}
-
-inline const Float3 Float3_Min( const Float3& a, const Float3& b )
-{
-	Float3 result;
-	result.x = minf( a.x, b.x );
-	result.y = minf( a.y, b.y );
-	result.z = minf( a.z, b.z );
-	return result;
-}
-inline const Float3 Float3_Max( const Float3& a, const Float3& b )
-{
-	Float3 result;
-	result.x = maxf( a.x, b.x );
-	result.y = maxf( a.y, b.y );
-	result.z = maxf( a.z, b.z );
-	return result;
-}
-inline const Float3 Float3_Add( const Float3& a, const Float3& b )
-{
-	Float3 result;
-	result.x = a.x + b.x;
-	result.y = a.y + b.y;
-	result.z = a.z + b.z;
-	return result;
-}
-inline const Float3 Float3_Subtract( const Float3& a, const Float3& b )
-{
-	Float3 result;
-	result.x = a.x - b.x;
-	result.y = a.y - b.y;
-	result.z = a.z - b.z;
-	return result;
-}
-inline const Float3 Float3_Multiply( const Float3& a, const Float3& b )
-{
-	Float3 result;
-	result.x = a.x * b.x;
-	result.y = a.y * b.y;
-	result.z = a.z * b.z;
-	return result;
-}
-// Returns the dot product (aka 'scalar product') of a and b.
-inline const float Float3_Dot( const Float3& a, const Float3& b )
-{
-	return (a.x * b.x) + (a.y * b.y) + (a.z * b.z);
-}
-// The direction of the cross product follows the right hand rule.
-//definition: http://www.euclideanspace.com/maths/algebra/vectors/vecAlgebra/cross/index.htm
-inline const Float3 Float3_Cross( const Float3& a, const Float3& b )
-{
-	Float3 result;
-	result.x = (a.y * b.z) - (a.z * b.y);
-	result.y = (a.z * b.x) - (a.x * b.z);
-	result.z = (a.x * b.y) - (a.y * b.x);
-	return result;
-}
-// Finds a vector orthogonal to the given one.
-// see: http://lolengine.net/blog/2013/09/21/picking-orthogonal-vector-combing-coconuts
-inline const Float3 Float3_FindOrthogonalTo( const Float3& v )
-{
-	// Always works if the input is non-zero.
-	// Doesn't require the input to be normalized.
-	// Doesn't normalize the output.
-	return Float_Abs(v.x) > Float_Abs(v.z) ?
-		Float3_Set(-v.y, v.x, 0.0f) : Float3_Set(0.0f, -v.z, v.y);
-}
-// Returns the component-wise result of x * a + y * (1.0 - a),
-// i.e., the linear blend of x and y using vector a.
-// NOTE:
-// The value for a is not restricted to the range [0, 1].
-inline const Float3 Float3_LerpFast( const Float3& x, const Float3& y, float a )
-{
-	float b = 1.0f - a;
-	Float3 result;
-	result.x = (x.x * a) + (y.x * b);
-	result.y = (x.y * a) + (y.y * b);
-	result.z = (x.z * a) + (y.z * b);
-	return result;
-}
-// Linearly interpolates one vector to another.
-// Precise method which guarantees from = to when amount = 1.
-inline const Float3 Float3_Lerp( const Float3& from, const Float3& to, float amount )
-{
-	if( amount <= 0.0f ) {
-		return from;
-	} else if( amount >= 1.0f ) {
-		return to;
-	} else {
-		return Float3_Lerp01( from, to, amount );
-	}
-}
-inline const Float3 Float3_Lerp01( const Float3& from, const Float3& to, float amount )
-{
-	mxASSERT(amount >= 0.0f && amount <= 1.0f);
-	return Float3_Add( from, Float3_Scale( Float3_Subtract(to, from), amount ) );
-}
-inline const bool Float3_IsNormalized( const Float3& v, float epsilon )
-{
-	return Float_Abs(Float3_Length(v) - 1.0f) < epsilon;
-}
-inline const bool Float3_AllGreaterOrEqual(  const Float3& xyz, float value )
-{
-	return xyz.x >= value && xyz.y >= value && xyz.z >= value;
-}
-
-inline const Float4 Float4_Zero()
-{
-	Float4 result = { 0.0f, 0.0f, 0.0f, 0.0f };
-	return result;
-}
-
-inline const Float4 Float4_Set( const Float3& xyz, float w )
-{
-	Float4 result;
-	result.x = xyz.x;
-	result.y = xyz.y;
-	result.z = xyz.z;
-	result.w = w;
-	return result;
-}
-inline const Float4 Float4_Set( float x, float y, float z, float w )
-{
-	Float4 result;
-	result.x = x;
-	result.y = y;
-	result.z = z;
-	result.w = w;
-	return result;
-}
-inline const Float4 Float4_Replicate( float value )
-{
-	Float4 result;
-	result.x = value;
-	result.y = value;
-	result.z = value;
-	result.w = value;
-	return result;
-}
-
 inline const Vector4 Vector4_Zero()
 {
 	Vector4 result;
@@ -659,3 +389,19 @@ inline const Float4x4 Matrix_Transpose( const Float4x4& m )
 	result.r3 = Vector4_Set( m.r0.w, m.r1.w, m.r2.w, m.r3.w );
 	return result;
 }
+
+// Normalizes the plane so that its normal has unit length.
+inline const Vector4 Plane_Normalize( Vector4Arg plane )
+{
+	float length = (plane.x * plane.x) + (plane.y * plane.y) + (plane.z * plane.z);
+	// Prevent divide by zero.
+	if( length > 0.0f ) {
+		length = 1.0f / sqrtf( length );
+	}
+	return Vector4_Scale( plane, length );
+}
+// Returns the signed distance from the (normalized) plane to the point.
+inline const float Plane_DotCoord( Vector4Arg plane, Vector4Arg point )
+{
+	return (plane.x * point.x) + (plane.y * point.y) + (plane.z * point.z) + plane.w;
+}
@@ -0,0 +1,591 @@
+/*
+=============================================================================
+	File:	NewMathTests.cpp
+	Desc:	Verification and benchmarking of the NewMath backends
+			and the SoA batch kernels.
+	Note:	Both backends define the same inline functions,
+			so they are checked against double-precision reference code
+			instead of each other.
+=============================================================================
+*/
+#include <Base/Base_PCH.h>
+#pragma hdrstop
+#include <Base/Base.h>
+
+namespace
+{
+
+// the same linear congruential generator as in mxRandom,
+// the sequence must be reproducible to compare runs with different backends
+struct TestRandom
+{
+	UINT32	seed;
+
+	TestRandom( UINT32 _seed ) : seed( _seed ) {}
+
+	float RandomFloat()	// [-1..+1]
+	{
+		seed = 69069 * seed + 1;
+		return ( seed >> 8 ) * ( 2.0f / float(1 << 24) ) - 1.0f;
+	}
+	const Vector4 RandomVector( float scale = 1.0f )
+	{
+		const float x = RandomFloat() * scale;
+		const float y = RandomFloat() * scale;
+		const float z = RandomFloat() * scale;
+		const float w = RandomFloat() * scale;
+		return Vector4_Set( x, y, z, w );
+	}
+	const Vector4 RandomQuaternion()
+	{
+		Vector4 q;
+		do {
+			q = RandomVector();
+		} while( Vector4_LengthSquared( q ) < 0.01f );
+		return Quaternion_Normalize( q );
+	}
+	// a well-conditioned affine transform
+	const Float4x4 RandomTransform()
+	{
+		const Float4x4 rotation = Matrix_FromQuaternion( RandomQuaternion() );
+		const Float4x4 scaling = Matrix_Scaling( 1.5f + RandomFloat(), 1.5f + RandomFloat(), 1.5f + RandomFloat() );
+		const Float4x4 translation = Matrix_Translation( RandomFloat() * 10, RandomFloat() * 10, RandomFloat() * 10 );
+		return Matrix_Multiply( Matrix_Multiply( scaling, rotation ), translation );
+	}
+};
+
+// accumulates the error of a single function in units in the last place
+struct ErrorStats
+{
+	const char *	name;
+	double			maxUlps;
+	double			sumUlps;
+	UINT32			numSamples;
+
+	ErrorStats( const char* _name ) : name( _name ), maxUlps( 0 ), sumUlps( 0 ), numSamples( 0 ) {}
+
+	// 'scale' is the magnitude of the computation (e.g. the sum of absolute products in a dot product),
+	// the error is measured relative to it, because the result itself may be close to zero after cancellation
+	void Add( float result, double reference, double scale )
+	{
+		const double ulp = largest( fabs( scale ), 1e-30 ) * FLT_EPSILON;
+		const double error = mmIS_NAN( result ) ? 1e30 : fabs( result - reference ) / ulp;
+		maxUlps = largest( maxUlps, error );
+		sumUlps += error;
+		numSamples++;
+	}
+	void Add( const Vector4& result, const double reference[4], double scale )
+	{
+		Add( result.x, reference[0], scale );
+		Add( result.y, reference[1], scale );
+		Add( result.z, reference[2], scale );
+		Add( result.w, reference[3], scale );
+	}
+	bool Report( UINT32 _maxUlps ) const
+	{
+		const bool passed = ( maxUlps <= _maxUlps );
+		ptPRINT("%-24s max: %8.2f ulp, avg: %6.3f ulp %s\n",
+			name, maxUlps, sumUlps / largest( numSamples, 1u ), passed ? "" : "<- FAILED");
+		return passed;
+	}
+};
+
+// the operator [] of Float4 depends on MM_OVERLOAD_OPERATORS
+double GetElement( const Float4x4& m, int row, int col )
+{
+	return (&m.r[row].x)[col];
+}
+
+void Reference_Transform( const Float4x4& m, const double p[4], double result[4], double *scale )
+{
+	*scale = 0;
+	for( int i = 0; i < 4; i++ )
+	{
+		const double x = p[0] * GetElement( m, 0, i );
+		const double y = p[1] * GetElement( m, 1, i );
+		const double z = p[2] * GetElement( m, 2, i );
+		const double w = p[3] * GetElement( m, 3, i );
+		result[i] = x + y + z + w;
+		*scale = largest( *scale, fabs( x ) + fabs( y ) + fabs( z ) + fabs( w ) );
+	}
+}
+
+void Reference_Quaternion_Multiply( const double a[4], const double b[4], double result[4] )
+{
+	// q = a * b, applies the rotation 'a' first (see Quaternion_Multiply())
+	result[0] = b[3] * a[0] + b[0] * a[3] + b[1] * a[2] - b[2] * a[1];
+	result[1] = b[3] * a[1] - b[0] * a[2] + b[1] * a[3] + b[2] * a[0];
+	result[2] = b[3] * a[2] + b[0] * a[1] - b[1] * a[0] + b[2] * a[3];
+	result[3] = b[3] * a[3] - b[0] * a[0] - b[1] * a[1] - b[2] * a[2];
+}
+
+void Reference_Slerp( const double a[4], const double b[4], double t, double result[4] )
+{
+	double cosOmega = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+	const double sign = ( cosOmega < 0 ) ? -1.0 : 1.0;
+	cosOmega *= sign;
+
+	double scale0, scale1;
+	if( cosOmega < mxSLERP_DELTA ) {
+		const double omega = acos( cosOmega );
+		const double sinOmega = sin( omega );
+		scale0 = sin( ( 1.0 - t ) * omega ) / sinOmega;
+		scale1 = sin( t * omega ) / sinOmega;
+	} else {
+		scale0 = 1.0 - t;
+		scale1 = t;
+	}
+	scale0 *= sign;	// the engine negates the start quaternion
+
+	for( int i = 0; i < 4; i++ ) {
+		result[i] = a[i] * scale0 + b[i] * scale1;
+	}
+}
+
+void ToDouble( const Vector4& v, double result[4] )
+{
+	result[0] = v.x;
+	result[1] = v.y;
+	result[2] = v.z;
+	result[3] = v.w;
+}
+
+}//namespace
+
+ERet NewMath_VerifyBackend( UINT32 numSamples, UINT32 maxUlps )
+{
+	chkRET_X_IF_NOT(numSamples > 0, ERR_INVALID_PARAMETER);
+
+	ErrorStats	dotStats("Vector4_Dot");
+	ErrorStats	crossStats("Vector4_Cross3");
+	ErrorStats	normalizeStats("Vector4_Normalized");
+	ErrorStats	transformStats("Matrix_Transform");
+	ErrorStats	transformPointsStats("Matrix_TransformPoints");
+	ErrorStats	multiplyStats("Matrix_Multiply");
+	ErrorStats	transposeStats("Matrix_Transpose");
+	ErrorStats	inverseStats("Matrix_Inverse");
+	ErrorStats	quatMultiplyStats("Quaternion_Multiply");
+	ErrorStats	slerpStats("Quaternion_Slerp");
+	ErrorStats	planeStats("Plane_DotCoord");
+	UINT32		numFrustumMismatches = 0;
+
+	TestRandom	random( 12345 );
+
+	const Float4x4 viewMatrix = Matrix_LookAt( Float3_Set( 1, 2, 3 ), Float3_Set( 0, 0, 20 ), Float3_Set( 0, 1, 0 ) );
+	const Float4x4 projectionMatrix = Matrix_PerspectiveD3D( DEG2RAD(60), 1.333f, 0.1f, 100.0f );
+	const Float4x4 viewProjectionMatrix = Matrix_Multiply( viewMatrix, projectionMatrix );
+	Vector4	frustumPlanes[6];
+	Frustum_ExtractPlanes( viewProjectionMatrix, frustumPlanes );
+
+	for( UINT32 iSample = 0; iSample < numSamples; iSample++ )
+	{
+		const Vector4 a = random.RandomVector( 10.0f );
+		const Vector4 b = random.RandomVector( 10.0f );
+		double da[4], db[4], reference[4];
+		ToDouble( a, da );
+		ToDouble( b, db );
+
+		// dot product
+		{
+			const double dot = da[0] * db[0] + da[1] * db[1] + da[2] * db[2] + da[3] * db[3];
+			const double scale = fabs( da[0] * db[0] ) + fabs( da[1] * db[1] ) + fabs( da[2] * db[2] ) + fabs( da[3] * db[3] );
+			dotStats.Add( Vector4_Dot( a, b ), dot, scale );
+		}
+		// cross product
+		{
+			reference[0] = da[1] * db[2] - da[2] * db[1];
+			reference[1] = da[2] * db[0] - da[0] * db[2];
+			reference[2] = da[0] * db[1] - da[1] * db[0];
+			const double scale = sqrt( ( da[0] * da[0] + da[1] * da[1] + da[2] * da[2] ) * ( db[0] * db[0] + db[1] * db[1] + db[2] * db[2] ) );
+			const Vector4 cross = Vector4_Cross3( a, b );
+			crossStats.Add( cross.x, reference[0], scale );
+			crossStats.Add( cross.y, reference[1], scale );
+			crossStats.Add( cross.z, reference[2], scale );
+		}
+		// normalization
+		{
+			const double length = sqrt( da[0] * da[0] + da[1] * da[1] + da[2] * da[2] + da[3] * da[3] );
+			if( length > 1e-3 )
+			{
+				for( int i = 0; i < 4; i++ ) {
+					reference[i] = da[i] / length;
+				}
+				normalizeStats.Add( Vector4_Normalized( a ), reference, 1.0 );
+			}
+		}
+
+		const Float4x4 m = random.RandomTransform();
+
+		// vector by matrix
+		{
+			const Vector4 p = Vector4_Set( a.x, a.y, a.z, 1.0f );
+			double dp[4], scale;
+			ToDouble( p, dp );
+			Reference_Transform( m, dp, reference, &scale );
+			transformStats.Add( Matrix_Transform( m, p ), reference, scale );
+
+			Vector4 points[3] = { p, p, p };
+			Matrix_TransformPoints( m, points, mxCOUNT_OF(points), points );
+			for( int i = 0; i < mxCOUNT_OF(points); i++ ) {
+				transformPointsStats.Add( points[i], reference, scale );
+			}
+		}
+		// matrix by matrix, transpose
+		{
+			const Float4x4 n = random.RandomTransform();
+			const Float4x4 product = Matrix_Multiply( m, n );
+			const Float4x4 transposed = Matrix_Transpose( m );
+			for( int row = 0; row < 4; row++ )
+			{
+				double dp[4], scale;
+				ToDouble( m.r[row], dp );
+				Reference_Transform( n, dp, reference, &scale );
+				multiplyStats.Add( product.r[row], reference, scale );
+
+				for( int col = 0; col < 4; col++ ) {
+					const double element = GetElement( m, col, row );
+					transposeStats.Add( (float)GetElement( transposed, row, col ), element, largest( fabs( element ), 1e-30 ) );
+				}
+			}
+		}
+		// inverse: M * M^-1 should be the identity matrix
+		{
+			const Float4x4 inverse = Matrix_Inverse( m );
+			for( int row = 0; row < 4; row++ )
+			{
+				double dp[4], scale;
+				ToDouble( m.r[row], dp );
+				Reference_Transform( inverse, dp, reference, &scale );
+				for( int col = 0; col < 4; col++ ) {
+					inverseStats.Add( (float)reference[col], (row == col) ? 1.0 : 0.0, scale );
+				}
+			}
+		}
+		// quaternions
+		{
+			const Vector4 qa = random.RandomQuaternion();
+			const Vector4 qb = random.RandomQuaternion();
+			double dqa[4], dqb[4];
+			ToDouble( qa, dqa );
+			ToDouble( qb, dqb );
+
+			Reference_Quaternion_Multiply( dqa, dqb, reference );
+			quatMultiplyStats.Add( Quaternion_Multiply( qa, qb ), reference, 1.0 );
+
+			const float t = random.RandomFloat() * 0.5f + 0.5f;
+			Reference_Slerp( dqa, dqb, t, reference );
+			slerpStats.Add( Quaternion_Slerp( qa, qb, t ), reference, 1.0 );
+		}
+		// planes and frustum culling
+		{
+			const Vector4 plane = Plane_Normalize( a );
+			double dp[4];
+			ToDouble( plane, dp );
+			const double distance = dp[0] * db[0] + dp[1] * db[1] + dp[2] * db[2] + dp[3];
+			const double scale = fabs( dp[0] * db[0] ) + fabs( dp[1] * db[1] ) + fabs( dp[2] * db[2] ) + fabs( dp[3] );
+			planeStats.Add( Plane_DotCoord( plane, b ), distance, scale );
+
+			const Vector4 sphere = Vector4_Set( a.x * 4, a.y * 4, a.z * 8, fabs( b.w ) );
+			bool intersects = true;
+			double minDistance = 1e30;
+			for( int i = 0; i < 6; i++ )
+			{
+				ToDouble( frustumPlanes[i], dp );
+				const double d = dp[0] * sphere.x + dp[1] * sphere.y + dp[2] * sphere.z + dp[3];
+				intersects &= ( d >= -sphere.w );
+				minDistance = smallest( minDistance, fabs( d + sphere.w ) );
+			}
+			// skip the spheres which touch the planes, the result depends on rounding
+			if( minDistance > 1e-3 )
+			{
+				const bool sphereResult = Frustum_IntersectsSphere( frustumPlanes, sphere );
+				const bool boxResult = Frustum_IntersectsAABB( frustumPlanes, sphere, Vector4_Zero() );
+				numFrustumMismatches += ( sphereResult != intersects );
+				numFrustumMismatches += ( boxResult != Frustum_IntersectsSphere( frustumPlanes, Vector4_Set( sphere.x, sphere.y, sphere.z, 0 ) ) );
+			}
+		}
+	}
+
+	ptPRINT("NewMath backend: %s, %u samples:\n", MM_ENABLE_INTRINSICS ? (MM_ENABLE_AVX ? "SSE+AVX" : "SSE") : "FPU", numSamples);
+
+	bool passed = true;
+	passed &= dotStats.Report( maxUlps );
+	passed &= crossStats.Report( maxUlps );
+	passed &= normalizeStats.Report( maxUlps );
+	passed &= transformStats.Report( maxUlps );
+	passed &= transformPointsStats.Report( maxUlps );
+	passed &= multiplyStats.Report( maxUlps );
+	passed &= transposeStats.Report( 0 );
+	passed &= inverseStats.Report( maxUlps );
+	passed &= quatMultiplyStats.Report( maxUlps );
+	passed &= slerpStats.Report( maxUlps );
+	passed &= planeStats.Report( maxUlps );
+
+	ptPRINT("Frustum culling: %u mismatches\n", numFrustumMismatches);
+	passed &= ( numFrustumMismatches == 0 );
+
+	if( !passed ) {
+		ptWARN("NewMath: the backend results exceed the error bound of %u ulp.\n", maxUlps);
+		return ERR_UNKNOWN_ERROR;
+	}
+	return ALL_OK;
+}
+
+void NewMath_Benchmark( UINT32 numIterations )
+{
+	enum { NUM_VECTORS = 1024 };	// fits into L1 cache
+
+	TestRandom	random( 54321 );
+
+	Vector4	vectors[ NUM_VECTORS ];
+	Vector4	results[ NUM_VECTORS ];
+	for( UINT32 i = 0; i < NUM_VECTORS; i++ ) {
+		vectors[i] = Vector4_Set( random.RandomFloat(), random.RandomFloat(), random.RandomFloat(), 1.0f );
+	}
+	enum { NUM_MATRICES = 16 };
+	Float4x4 matrices[ NUM_MATRICES ];
+	for( UINT32 i = 0; i < NUM_MATRICES; i++ ) {
+		matrices[i] = random.RandomTransform();
+	}
+	const Float4x4& m = matrices[0];
+
+	// the results are accumulated and printed so that the compiler cannot remove the loops
+	Vector4 sink = Vector4_Zero();
+	float sinkDot = 0;
+
+	ptPRINT("NewMath benchmark, %s backend, %u iterations:\n", MM_ENABLE_INTRINSICS ? (MM_ENABLE_AVX ? "SSE+AVX" : "SSE") : "FPU", numIterations);
+
+	UINT64 startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numIterations; i++ ) {
+		sinkDot += Vector4_Dot( vectors[ i % NUM_VECTORS ], vectors[ (i + 1) % NUM_VECTORS ] );
+	}
+	ptPRINT("Vector4_Dot:            %.3f ns\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / numIterations);
+
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numIterations; i++ ) {
+		sink = Vector4_Add( sink, Vector4_Normalized( vectors[ i % NUM_VECTORS ] ) );
+	}
+	ptPRINT("Vector4_Normalized:     %.3f ns\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / numIterations);
+
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numIterations; i++ ) {
+		sink = Vector4_Add( sink, Quaternion_Multiply( vectors[ i % NUM_VECTORS ], vectors[ (i + 1) % NUM_VECTORS ] ) );
+	}
+	ptPRINT("Quaternion_Multiply:    %.3f ns\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / numIterations);
+
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numIterations; i++ ) {
+		sink = Vector4_Add( sink, Matrix_Transform( m, vectors[ i % NUM_VECTORS ] ) );
+	}
+	ptPRINT("Matrix_Transform:       %.3f ns\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / numIterations);
+
+	const UINT32 numBatches = largest( numIterations / NUM_VECTORS, 1u );
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numBatches; i++ ) {
+		Matrix_TransformPoints( m, vectors, NUM_VECTORS, results );
+		sink = Vector4_Add( sink, results[ i % NUM_VECTORS ] );
+	}
+	ptPRINT("Matrix_TransformPoints: %.3f ns per point\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / (numBatches * NUM_VECTORS));
+
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numIterations; i++ ) {
+		const Float4x4 product = Matrix_Multiply( matrices[ i % NUM_MATRICES ], matrices[ (i + 1) % NUM_MATRICES ] );
+		sink = Vector4_Add( sink, product.r[ i % 4 ] );
+	}
+	ptPRINT("Matrix_Multiply:        %.3f ns\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / numIterations);
+
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numIterations; i++ ) {
+		const Float4x4 inverse = Matrix_Inverse( matrices[ i % NUM_MATRICES ] );
+		sink = Vector4_Add( sink, inverse.r[ i % 4 ] );
+	}
+	ptPRINT("Matrix_Inverse:         %.3f ns\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / numIterations);
+
+	Vector4	frustumPlanes[6];
+	Frustum_ExtractPlanes( Matrix_Multiply( m, Matrix_PerspectiveD3D( DEG2RAD(60), 1.333f, 0.1f, 100.0f ) ), frustumPlanes );
+	UINT32 numVisible = 0;
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numIterations; i++ ) {
+		numVisible += Frustum_IntersectsSphere( frustumPlanes, vectors[ i % NUM_VECTORS ] );
+	}
+	ptPRINT("Frustum_IntersectsSphere: %.3f ns\n", (mxGetTimeInMicroseconds() - startTime) * 1000.0 / numIterations);
+
+	ptPRINT("(checksum: %f %f %u)\n", Vector4_Dot( sink, sink ) + sinkDot, Vector4_Get_X( results[0] ), numVisible);
+}
+
+namespace
+{
+
+// the batch kernels must give the same results as the single-vector functions
+UINT32 CountMismatches( const TArray< Float3 >& results, const TArray< Float3 >& reference )
+{
+	UINT32 numMismatches = 0;
+	for( UINT32 i = 0; i < reference.Num(); i++ ) {
+		numMismatches += ( memcmp( &results[i], &reference[i], sizeof(Float3) ) != 0 );
+	}
+	return numMismatches;
+}
+
+void PrintThroughput( const char* name, UINT32 count, UINT64 microseconds )
+{
+	ptPRINT("%-28s %8.2f M/s (%.3f ms)\n", name, double(count) / largest( microseconds, 1 ), microseconds * 1e-3);
+}
+
+}//namespace
+
+ERet SoAMath_Benchmark( UINT32 numPoints, UINT32 numVolumes )
+{
+	chkRET_X_IF_NOT(numPoints > 0 && numVolumes > 0, ERR_INVALID_PARAMETER);
+
+	ptPRINT("SoA math benchmark, %s backend, %u points, %u bounding volumes (single thread):\n",
+		MM_ENABLE_INTRINSICS ? (MM_ENABLE_AVX ? "SSE+AVX" : "SSE") : "FPU", numPoints, numVolumes);
+
+	TestRandom	random( 777 );
+	const Float4x4 m = random.RandomTransform();
+
+	TArray< Float3 >	points;
+	TArray< Float3 >	reference;
+	TArray< Float3 >	results;
+	mxDO(points.SetNum( numPoints ));
+	mxDO(reference.SetNum( numPoints ));
+	mxDO(results.SetNum( numPoints ));
+	for( UINT32 i = 0; i < numPoints; i++ ) {
+		points[i] = Float3_Set( random.RandomFloat() * 100, random.RandomFloat() * 100, random.RandomFloat() * 100 );
+	}
+
+	UINT32 numMismatches = 0;
+
+	// points
+
+	UINT64 startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numPoints; i++ ) {
+		reference[i] = Matrix_TransformPoint( m, points[i] );
+	}
+	PrintThroughput( "Matrix_TransformPoint", numPoints, mxGetTimeInMicroseconds() - startTime );
+
+	startTime = mxGetTimeInMicroseconds();
+	Float3_TransformPoints( m, points.ToPtr(), numPoints, results.ToPtr() );
+	PrintThroughput( "Float3_TransformPoints", numPoints, mxGetTimeInMicroseconds() - startTime );
+	numMismatches += CountMismatches( results, reference );
+
+	{
+		TArray< SoA_Float3x4 >	packets;
+		startTime = mxGetTimeInMicroseconds();
+		mxDO(SoA_FromArray( points, packets ));
+		PrintThroughput( "SoA_Swizzle (x4)", numPoints, mxGetTimeInMicroseconds() - startTime );
+
+		startTime = mxGetTimeInMicroseconds();
+		SoA_TransformPoints( m, packets.ToPtr(), packets.Num(), packets.ToPtr() );
+		PrintThroughput( "SoA_TransformPoints (x4)", numPoints, mxGetTimeInMicroseconds() - startTime );
+
+		mxDO(SoA_ToArray( packets, numPoints, results ));
+		numMismatches += CountMismatches( results, reference );
+	}
+	{
+		TArray< SoA_Float3x8 >	packets;
+		mxDO(SoA_FromArray( points, packets ));
+
+		startTime = mxGetTimeInMicroseconds();
+		SoA_TransformPoints( m, packets.ToPtr(), packets.Num(), packets.ToPtr() );
+		PrintThroughput( "SoA_TransformPoints (x8)", numPoints, mxGetTimeInMicroseconds() - startTime );
+
+		mxDO(SoA_ToArray( packets, numPoints, results ));
+		numMismatches += CountMismatches( results, reference );
+	}
+
+	// normals
+
+	for( UINT32 i = 0; i < numPoints; i++ ) {
+		reference[i] = Matrix_TransformNormal( m, points[i] );
+	}
+
+	startTime = mxGetTimeInMicroseconds();
+	Float3_TransformNormals( m, points.ToPtr(), numPoints, results.ToPtr() );
+	PrintThroughput( "Float3_TransformNormals", numPoints, mxGetTimeInMicroseconds() - startTime );
+	numMismatches += CountMismatches( results, reference );
+
+	{
+		TArray< SoA_Float3x8 >	packets;
+		mxDO(SoA_FromArray( points, packets ));
+		SoA_TransformNormals( m, packets.ToPtr(), packets.Num(), packets.ToPtr() );
+		mxDO(SoA_ToArray( packets, numPoints, results ));
+		numMismatches += CountMismatches( results, reference );
+	}
+
+	// bounding volumes
+
+	Vector4	frustumPlanes[6];
+	{
+		const Float4x4 viewMatrix = Matrix_LookAt( Float3_Set( 0, 0, 0 ), Float3_Set( 0, 0, 1 ), Float3_Set( 0, 1, 0 ) );
+		const Float4x4 projectionMatrix = Matrix_PerspectiveD3D( DEG2RAD(60), 1.333f, 0.1f, 100.0f );
+		Frustum_ExtractPlanes( Matrix_Multiply( viewMatrix, projectionMatrix ), frustumPlanes );
+	}
+
+	TArray< Vector4 >		spheres;	// (center, radius), also used as boxes with extent = radius
+	TArray< SoA_Sphere4 >	spherePackets;
+	TArray< SoA_AABB4 >		boxPackets;
+	TArray< UINT32 >		visible;
+	TArray< UINT32 >		referenceVisible;
+	mxDO(spheres.SetNum( numVolumes ));
+	mxDO(spherePackets.SetNum( SoA_NumPackets4( numVolumes ) ));
+	mxDO(boxPackets.SetNum( SoA_NumPackets4( numVolumes ) ));
+	mxDO(visible.SetNum( numVolumes ));
+	mxDO(referenceVisible.SetNum( numVolumes ));
+
+	for( UINT32 i = 0; i < numVolumes; i++ )
+	{
+		const Float3 center = Float3_Set( random.RandomFloat() * 100, random.RandomFloat() * 100, random.RandomFloat() * 100 );
+		const float radius = 2.75f + random.RandomFloat() * 2.25f;
+		spheres[i] = Vector4_Set( center, radius );
+		SoA_SetSphere( spherePackets[ i / 4 ], i % 4, center, radius );
+		const Float3 extent = Float3_Replicate( radius );
+		SoA_SetAABB( boxPackets[ i / 4 ], i % 4, Float3_Subtract( center, extent ), Float3_Add( center, extent ) );
+	}
+
+	UINT32 numReferenceVisible = 0;
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numVolumes; i++ )
+	{
+		referenceVisible[ numReferenceVisible ] = i;
+		numReferenceVisible += Frustum_IntersectsSphere( frustumPlanes, spheres[i] );
+	}
+	PrintThroughput( "Frustum_IntersectsSphere", numVolumes, mxGetTimeInMicroseconds() - startTime );
+
+	startTime = mxGetTimeInMicroseconds();
+	UINT32 numVisible = Frustum_CullSpheres( frustumPlanes, spherePackets.ToPtr(), numVolumes, visible.ToPtr() );
+	PrintThroughput( "Frustum_CullSpheres", numVolumes, mxGetTimeInMicroseconds() - startTime );
+
+	numMismatches += ( numVisible != numReferenceVisible ) || memcmp( visible.ToPtr(), referenceVisible.ToPtr(), numVisible * sizeof(UINT32) );
+
+	// the boxes are built from the min/max points, so the reference uses the same centers and extents
+	numReferenceVisible = 0;
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numVolumes; i++ )
+	{
+		const SoA_AABB4& packet = boxPackets[ i / 4 ];
+		const UINT32 lane = i % 4;
+		const Vector4 center = Vector4_Set( packet.x[lane], packet.y[lane], packet.z[lane], 0.0f );
+		const Vector4 extent = Vector4_Set( packet.ex[lane], packet.ey[lane], packet.ez[lane], 0.0f );
+		referenceVisible[ numReferenceVisible ] = i;
+		numReferenceVisible += Frustum_IntersectsAABB( frustumPlanes, center, extent );
+	}
+	PrintThroughput( "Frustum_IntersectsAABB", numVolumes, mxGetTimeInMicroseconds() - startTime );
+
+	startTime = mxGetTimeInMicroseconds();
+	numVisible = Frustum_CullAABBs( frustumPlanes, boxPackets.ToPtr(), numVolumes, visible.ToPtr() );
+	PrintThroughput( "Frustum_CullAABBs", numVolumes, mxGetTimeInMicroseconds() - startTime );
+
+	numMismatches += ( numVisible != numReferenceVisible ) || memcmp( visible.ToPtr(), referenceVisible.ToPtr(), numVisible * sizeof(UINT32) );
+
+	ptPRINT("%u of %u bounding boxes are visible\n", numVisible, numVolumes);
+
+	if( numMismatches ) {
+		ptWARN("SoA math: %u results differ from the single-vector functions.\n", numMismatches);
+		return ERR_UNKNOWN_ERROR;
+	}
+	return ALL_OK;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,507 @@
+/*
+=============================================================================
+	File:	SoAMath.cpp
+	Desc:	Batch math kernels working on structure-of-arrays packets.
+=============================================================================
+*/
+#include <Base/Base_PCH.h>
+#pragma hdrstop
+#include <Base/Base.h>
+
+/*
+=======================================================================
+	AoS <-> SoA CONVERSION
+=======================================================================
+*/
+
+#if MM_ENABLE_INTRINSICS
+
+// loads 4 packed Float3's (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) and transposes them into X, Y, Z
+static inline void SSE_LoadFloat3x4( const Float3* v, __m128 &X, __m128 &Y, __m128 &Z )
+{
+	const float* p = &v->x;
+	const __m128 v0 = _mm_loadu_ps( p + 0 );
+	const __m128 v1 = _mm_loadu_ps( p + 4 );
+	const __m128 v2 = _mm_loadu_ps( p + 8 );
+	X = _mm_shuffle_ps( v0, _mm_shuffle_ps( v1, v2, _MM_SHUFFLE(1,1,2,2) ), _MM_SHUFFLE(2,0,3,0) );
+	Y = _mm_shuffle_ps( _mm_shuffle_ps( v0, v1, _MM_SHUFFLE(0,0,1,1) ), _mm_shuffle_ps( v1, v2, _MM_SHUFFLE(2,2,3,3) ), _MM_SHUFFLE(2,0,2,0) );
+	Z = _mm_shuffle_ps( _mm_shuffle_ps( v0, v1, _MM_SHUFFLE(1,1,2,2) ), _mm_shuffle_ps( v2, v2, _MM_SHUFFLE(3,3,0,0) ), _MM_SHUFFLE(2,0,2,0) );
+}
+// the reverse of SSE_LoadFloat3x4()
+static inline void SSE_StoreFloat3x4( __m128 X, __m128 Y, __m128 Z, Float3* v )
+{
+	float* p = &v->x;
+	const __m128 v0 = _mm_shuffle_ps( _mm_shuffle_ps( X, Y, _MM_SHUFFLE(0,0,0,0) ), _mm_shuffle_ps( Z, X, _MM_SHUFFLE(1,1,0,0) ), _MM_SHUFFLE(2,0,2,0) );
+	const __m128 v1 = _mm_shuffle_ps( _mm_shuffle_ps( Y, Z, _MM_SHUFFLE(1,1,1,1) ), _mm_shuffle_ps( X, Y, _MM_SHUFFLE(2,2,2,2) ), _MM_SHUFFLE(2,0,2,0) );
+	const __m128 v2 = _mm_shuffle_ps( _mm_shuffle_ps( Z, X, _MM_SHUFFLE(3,3,2,2) ), _mm_shuffle_ps( Y, Z, _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(2,0,2,0) );
+	_mm_storeu_ps( p + 0, v0 );
+	_mm_storeu_ps( p + 4, v1 );
+	_mm_storeu_ps( p + 8, v2 );
+}
+
+#endif // MM_ENABLE_INTRINSICS
+
+// WIDTH is the number of lanes in PACKET
+template< UINT32 WIDTH, class PACKET >
+static void SoA_SwizzleT( const Float3* vectors, UINT32 count, PACKET *packets )
+{
+	if( !count ) {
+		return;
+	}
+	const UINT32 numPackets = (count + WIDTH - 1) / WIDTH;
+	for( UINT32 iPacket = 0; iPacket < numPackets; iPacket++ )
+	{
+		PACKET & packet = packets[ iPacket ];
+		for( UINT32 lane = 0; lane < WIDTH; lane++ )
+		{
+			const UINT32 index = smallest( iPacket * WIDTH + lane, count - 1 );
+			packet.x[ lane ] = vectors[ index ].x;
+			packet.y[ lane ] = vectors[ index ].y;
+			packet.z[ lane ] = vectors[ index ].z;
+		}
+	}
+}
+
+template< UINT32 WIDTH, class PACKET >
+static void SoA_UnswizzleT( const PACKET* packets, UINT32 count, Float3 *vectors )
+{
+	for( UINT32 i = 0; i < count; i++ )
+	{
+		const PACKET& packet = packets[ i / WIDTH ];
+		const UINT32 lane = i % WIDTH;
+		vectors[i].x = packet.x[ lane ];
+		vectors[i].y = packet.y[ lane ];
+		vectors[i].z = packet.z[ lane ];
+	}
+}
+
+void SoA_Swizzle( const Float3* vectors, UINT32 count, SoA_Float3x4 *packets )
+{
+	UINT32 i = 0;
+#if MM_ENABLE_INTRINSICS
+	for( ; i + 4 <= count; i += 4 )
+	{
+		__m128 X, Y, Z;
+		SSE_LoadFloat3x4( vectors + i, X, Y, Z );
+		SoA_Float3x4 & packet = packets[ i / 4 ];
+		_mm_storeu_ps( packet.x, X );
+		_mm_storeu_ps( packet.y, Y );
+		_mm_storeu_ps( packet.z, Z );
+	}
+#endif // MM_ENABLE_INTRINSICS
+	SoA_SwizzleT< 4 >( vectors + i, count - i, packets + i / 4 );
+}
+void SoA_Swizzle( const Float3* vectors, UINT32 count, SoA_Float3x8 *packets )
+{
+	SoA_SwizzleT< 8 >( vectors, count, packets );
+}
+
+void SoA_Unswizzle( const SoA_Float3x4* packets, UINT32 count, Float3 *vectors )
+{
+	UINT32 i = 0;
+#if MM_ENABLE_INTRINSICS
+	for( ; i + 4 <= count; i += 4 )
+	{
+		const SoA_Float3x4& packet = packets[ i / 4 ];
+		SSE_StoreFloat3x4( _mm_loadu_ps( packet.x ), _mm_loadu_ps( packet.y ), _mm_loadu_ps( packet.z ), vectors + i );
+	}
+#endif // MM_ENABLE_INTRINSICS
+	SoA_UnswizzleT< 4 >( packets + i / 4, count - i, vectors + i );
+}
+void SoA_Unswizzle( const SoA_Float3x8* packets, UINT32 count, Float3 *vectors )
+{
+	SoA_UnswizzleT< 8 >( packets, count, vectors );
+}
+
+template< class PACKET >
+static ERet SoA_FromArrayT( const TArray< Float3 >& vectors, UINT32 width, TArray< PACKET > &packets )
+{
+	const UINT32 count = vectors.Num();
+	mxDO(packets.SetNum( (count + width - 1) / width ));
+	SoA_Swizzle( vectors.ToPtr(), count, packets.ToPtr() );
+	return ALL_OK;
+}
+template< class PACKET >
+static ERet SoA_ToArrayT( const TArray< PACKET >& packets, UINT32 width, UINT32 count, TArray< Float3 > &vectors )
+{
+	chkRET_X_IF_NOT(count <= packets.Num() * width, ERR_INVALID_PARAMETER);
+	mxDO(vectors.SetNum( count ));
+	SoA_Unswizzle( packets.ToPtr(), count, vectors.ToPtr() );
+	return ALL_OK;
+}
+
+ERet SoA_FromArray( const TArray< Float3 >& vectors, TArray< SoA_Float3x4 > &packets )
+{
+	return SoA_FromArrayT( vectors, 4, packets );
+}
+ERet SoA_FromArray( const TArray< Float3 >& vectors, TArray< SoA_Float3x8 > &packets )
+{
+	return SoA_FromArrayT( vectors, 8, packets );
+}
+ERet SoA_ToArray( const TArray< SoA_Float3x4 >& packets, UINT32 count, TArray< Float3 > &vectors )
+{
+	return SoA_ToArrayT( packets, 4, count, vectors );
+}
+ERet SoA_ToArray( const TArray< SoA_Float3x8 >& packets, UINT32 count, TArray< Float3 > &vectors )
+{
+	return SoA_ToArrayT( packets, 8, count, vectors );
+}
+
+void SoA_SetSphere( SoA_Sphere4 &packet, UINT32 lane, const Float3& center, float radius )
+{
+	mxASSERT(lane < 4);
+	packet.x[ lane ] = center.x;
+	packet.y[ lane ] = center.y;
+	packet.z[ lane ] = center.z;
+	packet.radius[ lane ] = radius;
+}
+void SoA_SetAABB( SoA_AABB4 &packet, UINT32 lane, const Float3& minPoint, const Float3& maxPoint )
+{
+	mxASSERT(lane < 4);
+	packet.x[ lane ] = (minPoint.x + maxPoint.x) * 0.5f;
+	packet.y[ lane ] = (minPoint.y + maxPoint.y) * 0.5f;
+	packet.z[ lane ] = (minPoint.z + maxPoint.z) * 0.5f;
+	packet.ex[ lane ] = (maxPoint.x - minPoint.x) * 0.5f;
+	packet.ey[ lane ] = (maxPoint.y - minPoint.y) * 0.5f;
+	packet.ez[ lane ] = (maxPoint.z - minPoint.z) * 0.5f;
+}
+
+/*
+=======================================================================
+	TRANSFORMS
+=======================================================================
+*/
+
+// the summation order is the same as in Matrix_TransformPoint() and Matrix_TransformNormal(),
+// so the results are bit-identical to them
+
+#if MM_ENABLE_INTRINSICS
+
+// the columns of the upper 4x3 part of the matrix, each element is replicated
+struct SSE_Matrix4x3
+{
+	__m128	m[4][3];
+
+	SSE_Matrix4x3( const Float4x4& _m )
+	{
+		for( int row = 0; row < 4; row++ )
+		{
+			m[row][0] = _mm_set1_ps( _m.r[row].x );
+			m[row][1] = _mm_set1_ps( _m.r[row].y );
+			m[row][2] = _mm_set1_ps( _m.r[row].z );
+		}
+	}
+	void TransformPoints( __m128 &X, __m128 &Y, __m128 &Z ) const
+	{
+		const __m128 x = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0][0], X ), _mm_mul_ps( m[1][0], Y ) ), _mm_mul_ps( m[2][0], Z ) ), m[3][0] );
+		const __m128 y = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0][1], X ), _mm_mul_ps( m[1][1], Y ) ), _mm_mul_ps( m[2][1], Z ) ), m[3][1] );
+		const __m128 z = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0][2], X ), _mm_mul_ps( m[1][2], Y ) ), _mm_mul_ps( m[2][2], Z ) ), m[3][2] );
+		X = x;	Y = y;	Z = z;
+	}
+	void TransformNormals( __m128 &X, __m128 &Y, __m128 &Z ) const
+	{
+		const __m128 x = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0][0], X ), _mm_mul_ps( m[1][0], Y ) ), _mm_mul_ps( m[2][0], Z ) );
+		const __m128 y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0][1], X ), _mm_mul_ps( m[1][1], Y ) ), _mm_mul_ps( m[2][1], Z ) );
+		const __m128 z = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0][2], X ), _mm_mul_ps( m[1][2], Y ) ), _mm_mul_ps( m[2][2], Z ) );
+		X = x;	Y = y;	Z = z;
+	}
+};
+
+// transforms 'numGroups' groups of 4 floats per component, the packets of 8 are processed as two groups
+template< bool POINTS >
+static void SSE_TransformSoA( const Float4x4& m, const float* source, float* destination, UINT32 numPackets, UINT32 width )
+{
+	const SSE_Matrix4x3	matrix( m );
+	const UINT32 stride = width * 3;	// floats per packet
+	for( UINT32 iPacket = 0; iPacket < numPackets; iPacket++ )
+	{
+		const float* src = source + iPacket * stride;
+		float* dst = destination + iPacket * stride;
+		for( UINT32 offset = 0; offset < width; offset += 4 )
+		{
+			__m128 X = _mm_loadu_ps( src + offset );
+			__m128 Y = _mm_loadu_ps( src + offset + width );
+			__m128 Z = _mm_loadu_ps( src + offset + width * 2 );
+			if( POINTS ) {
+				matrix.TransformPoints( X, Y, Z );
+			} else {
+				matrix.TransformNormals( X, Y, Z );
+			}
+			_mm_storeu_ps( dst + offset, X );
+			_mm_storeu_ps( dst + offset + width, Y );
+			_mm_storeu_ps( dst + offset + width * 2, Z );
+		}
+	}
+}
+
+#endif // MM_ENABLE_INTRINSICS
+
+template< UINT32 WIDTH, class PACKET >
+static void FPU_TransformPoints( const Float4x4& m, const PACKET* points, UINT32 numPackets, PACKET *result )
+{
+	for( UINT32 iPacket = 0; iPacket < numPackets; iPacket++ )
+	{
+		for( UINT32 lane = 0; lane < WIDTH; lane++ )
+		{
+			Float3 p;
+			p.x = points[ iPacket ].x[ lane ];
+			p.y = points[ iPacket ].y[ lane ];
+			p.z = points[ iPacket ].z[ lane ];
+			p = Matrix_TransformPoint( m, p );
+			result[ iPacket ].x[ lane ] = p.x;
+			result[ iPacket ].y[ lane ] = p.y;
+			result[ iPacket ].z[ lane ] = p.z;
+		}
+	}
+}
+template< UINT32 WIDTH, class PACKET >
+static void FPU_TransformNormals( const Float4x4& m, const PACKET* normals, UINT32 numPackets, PACKET *result )
+{
+	for( UINT32 iPacket = 0; iPacket < numPackets; iPacket++ )
+	{
+		for( UINT32 lane = 0; lane < WIDTH; lane++ )
+		{
+			Float3 n;
+			n.x = normals[ iPacket ].x[ lane ];
+			n.y = normals[ iPacket ].y[ lane ];
+			n.z = normals[ iPacket ].z[ lane ];
+			n = Matrix_TransformNormal( m, n );
+			result[ iPacket ].x[ lane ] = n.x;
+			result[ iPacket ].y[ lane ] = n.y;
+			result[ iPacket ].z[ lane ] = n.z;
+		}
+	}
+}
+
+void SoA_TransformPoints( const Float4x4& m, const SoA_Float3x4* points, UINT32 numPackets, SoA_Float3x4 *result )
+{
+#if MM_ENABLE_INTRINSICS
+	SSE_TransformSoA< true >( m, points->x, result->x, numPackets, 4 );
+#else
+	FPU_TransformPoints< 4 >( m, points, numPackets, result );
+#endif // MM_ENABLE_INTRINSICS
+}
+
+void SoA_TransformPoints( const Float4x4& m, const SoA_Float3x8* points, UINT32 numPackets, SoA_Float3x8 *result )
+{
+#if MM_ENABLE_AVX
+	const __m256 m00 = _mm256_set1_ps( m.r0.x ), m01 = _mm256_set1_ps( m.r0.y ), m02 = _mm256_set1_ps( m.r0.z );
+	const __m256 m10 = _mm256_set1_ps( m.r1.x ), m11 = _mm256_set1_ps( m.r1.y ), m12 = _mm256_set1_ps( m.r1.z );
+	const __m256 m20 = _mm256_set1_ps( m.r2.x ), m21 = _mm256_set1_ps( m.r2.y ), m22 = _mm256_set1_ps( m.r2.z );
+	const __m256 m30 = _mm256_set1_ps( m.r3.x ), m31 = _mm256_set1_ps( m.r3.y ), m32 = _mm256_set1_ps( m.r3.z );
+	for( UINT32 iPacket = 0; iPacket < numPackets; iPacket++ )
+	{
+		// the heap is only 16-byte aligned
+		const __m256 X = _mm256_loadu_ps( points[ iPacket ].x );
+		const __m256 Y = _mm256_loadu_ps( points[ iPacket ].y );
+		const __m256 Z = _mm256_loadu_ps( points[ iPacket ].z );
+		_mm256_storeu_ps( result[ iPacket ].x, _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m00, X ), _mm256_mul_ps( m10, Y ) ), _mm256_mul_ps( m20, Z ) ), m30 ) );
+		_mm256_storeu_ps( result[ iPacket ].y, _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m01, X ), _mm256_mul_ps( m11, Y ) ), _mm256_mul_ps( m21, Z ) ), m31 ) );
+		_mm256_storeu_ps( result[ iPacket ].z, _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m02, X ), _mm256_mul_ps( m12, Y ) ), _mm256_mul_ps( m22, Z ) ), m32 ) );
+	}
+#elif MM_ENABLE_INTRINSICS
+	SSE_TransformSoA< true >( m, points->x, result->x, numPackets, 8 );
+#else
+	FPU_TransformPoints< 8 >( m, points, numPackets, result );
+#endif
+}
+
+void SoA_TransformNormals( const Float4x4& m, const SoA_Float3x4* normals, UINT32 numPackets, SoA_Float3x4 *result )
+{
+#if MM_ENABLE_INTRINSICS
+	SSE_TransformSoA< false >( m, normals->x, result->x, numPackets, 4 );
+#else
+	FPU_TransformNormals< 4 >( m, normals, numPackets, result );
+#endif // MM_ENABLE_INTRINSICS
+}
+
+void SoA_TransformNormals( const Float4x4& m, const SoA_Float3x8* normals, UINT32 numPackets, SoA_Float3x8 *result )
+{
+#if MM_ENABLE_AVX
+	const __m256 m00 = _mm256_set1_ps( m.r0.x ), m01 = _mm256_set1_ps( m.r0.y ), m02 = _mm256_set1_ps( m.r0.z );
+	const __m256 m10 = _mm256_set1_ps( m.r1.x ), m11 = _mm256_set1_ps( m.r1.y ), m12 = _mm256_set1_ps( m.r1.z );
+	const __m256 m20 = _mm256_set1_ps( m.r2.x ), m21 = _mm256_set1_ps( m.r2.y ), m22 = _mm256_set1_ps( m.r2.z );
+	for( UINT32 iPacket = 0; iPacket < numPackets; iPacket++ )
+	{
+		const __m256 X = _mm256_loadu_ps( normals[ iPacket ].x );
+		const __m256 Y = _mm256_loadu_ps( normals[ iPacket ].y );
+		const __m256 Z = _mm256_loadu_ps( normals[ iPacket ].z );
+		_mm256_storeu_ps( result[ iPacket ].x, _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m00, X ), _mm256_mul_ps( m10, Y ) ), _mm256_mul_ps( m20, Z ) ) );
+		_mm256_storeu_ps( result[ iPacket ].y, _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m01, X ), _mm256_mul_ps( m11, Y ) ), _mm256_mul_ps( m21, Z ) ) );
+		_mm256_storeu_ps( result[ iPacket ].z, _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m02, X ), _mm256_mul_ps( m12, Y ) ), _mm256_mul_ps( m22, Z ) ) );
+	}
+#elif MM_ENABLE_INTRINSICS
+	SSE_TransformSoA< false >( m, normals->x, result->x, numPackets, 8 );
+#else
+	FPU_TransformNormals< 8 >( m, normals, numPackets, result );
+#endif
+}
+
+void Float3_TransformPoints( const Float4x4& m, const Float3* points, UINT32 count, Float3 *result )
+{
+	UINT32 i = 0;
+#if MM_ENABLE_INTRINSICS
+	const SSE_Matrix4x3	matrix( m );
+	for( ; i + 4 <= count; i += 4 )
+	{
+		__m128 X, Y, Z;
+		SSE_LoadFloat3x4( points + i, X, Y, Z );
+		matrix.TransformPoints( X, Y, Z );
+		SSE_StoreFloat3x4( X, Y, Z, result + i );
+	}
+#endif // MM_ENABLE_INTRINSICS
+	for( ; i < count; i++ )
+	{
+		result[i] = Matrix_TransformPoint( m, points[i] );
+	}
+}
+
+void Float3_TransformNormals( const Float4x4& m, const Float3* normals, UINT32 count, Float3 *result )
+{
+	UINT32 i = 0;
+#if MM_ENABLE_INTRINSICS
+	const SSE_Matrix4x3	matrix( m );
+	for( ; i + 4 <= count; i += 4 )
+	{
+		__m128 X, Y, Z;
+		SSE_LoadFloat3x4( normals + i, X, Y, Z );
+		matrix.TransformNormals( X, Y, Z );
+		SSE_StoreFloat3x4( X, Y, Z, result + i );
+	}
+#endif // MM_ENABLE_INTRINSICS
+	for( ; i < count; i++ )
+	{
+		result[i] = Matrix_TransformNormal( m, normals[i] );
+	}
+}
+
+/*
+=======================================================================
+	CULLING
+=======================================================================
+*/
+
+// the distances are computed as in Plane_DotCoord(): ((x * Nx + y * Ny) + z * Nz) + d
+
+#if MM_ENABLE_INTRINSICS
+
+// the frustum planes with each component replicated
+struct SSE_Frustum
+{
+	__m128	x[6], y[6], z[6], w[6];
+
+	SSE_Frustum( const Vector4 planes[6] )
+	{
+		for( int i = 0; i < 6; i++ )
+		{
+			const __m128 P = SSE_Load( planes[i] );
+			x[i] = _mm_shuffle_ps( P, P, _MM_SHUFFLE(0,0,0,0) );
+			y[i] = _mm_shuffle_ps( P, P, _MM_SHUFFLE(1,1,1,1) );
+			z[i] = _mm_shuffle_ps( P, P, _MM_SHUFFLE(2,2,2,2) );
+			w[i] = _mm_shuffle_ps( P, P, _MM_SHUFFLE(3,3,3,3) );
+		}
+	}
+	__m128 Distance( int i, __m128 X, __m128 Y, __m128 Z ) const
+	{
+		return _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( X, x[i] ), _mm_mul_ps( Y, y[i] ) ), _mm_mul_ps( Z, z[i] ) ), w[i] );
+	}
+};
+
+#endif // MM_ENABLE_INTRINSICS
+
+// appends the indices of the lanes with set bits in 'visibleMask', returns the new number of visible objects
+static inline UINT32 AppendVisible( int visibleMask, UINT32 baseIndex, UINT32 numLanes, UINT32 numVisible, UINT32 *visible )
+{
+	for( UINT32 lane = 0; lane < numLanes; lane++ )
+	{
+		visible[ numVisible ] = baseIndex + lane;
+		numVisible += (visibleMask >> lane) & 1;
+	}
+	return numVisible;
+}
+
+UINT32 Frustum_CullSpheres( const Vector4 planes[6], const SoA_Sphere4* spheres, UINT32 count, UINT32 *visible )
+{
+	UINT32 numVisible = 0;
+#if MM_ENABLE_INTRINSICS
+	const SSE_Frustum	frustum( planes );
+	const __m128 signMask = SSE_Load( g_MMNegativeZero.v );
+#endif // MM_ENABLE_INTRINSICS
+	for( UINT32 baseIndex = 0; baseIndex < count; baseIndex += 4 )
+	{
+		const SoA_Sphere4& packet = spheres[ baseIndex / 4 ];
+		const UINT32 numLanes = smallest( count - baseIndex, 4u );
+#if MM_ENABLE_INTRINSICS
+		const __m128 X = _mm_loadu_ps( packet.x );
+		const __m128 Y = _mm_loadu_ps( packet.y );
+		const __m128 Z = _mm_loadu_ps( packet.z );
+		const __m128 negRadius = _mm_xor_ps( _mm_loadu_ps( packet.radius ), signMask );
+		__m128 outside = _mm_cmplt_ps( frustum.Distance( 0, X, Y, Z ), negRadius );
+		for( int i = 1; i < 6; i++ ) {
+			outside = _mm_or_ps( outside, _mm_cmplt_ps( frustum.Distance( i, X, Y, Z ), negRadius ) );
+		}
+		const int visibleMask = ~_mm_movemask_ps( outside );
+#else
+		int visibleMask = 0;
+		for( UINT32 lane = 0; lane < numLanes; lane++ )
+		{
+			const Vector4 sphere = Vector4_Set( packet.x[lane], packet.y[lane], packet.z[lane], packet.radius[lane] );
+			visibleMask |= int(Frustum_IntersectsSphere( planes, sphere )) << lane;
+		}
+#endif // MM_ENABLE_INTRINSICS
+		numVisible = AppendVisible( visibleMask, baseIndex, numLanes, numVisible, visible );
+	}
+	return numVisible;
+}
+
+UINT32 Frustum_CullAABBs( const Vector4 planes[6], const SoA_AABB4* boxes, UINT32 count, UINT32 *visible )
+{
+	UINT32 numVisible = 0;
+#if MM_ENABLE_INTRINSICS
+	const SSE_Frustum	frustum( planes );
+	const __m128 absMask = SSE_Load( g_MMAbsMask.v );
+	__m128	absX[6], absY[6], absZ[6];
+	for( int i = 0; i < 6; i++ )
+	{
+		absX[i] = _mm_and_ps( frustum.x[i], absMask );
+		absY[i] = _mm_and_ps( frustum.y[i], absMask );
+		absZ[i] = _mm_and_ps( frustum.z[i], absMask );
+	}
+#endif // MM_ENABLE_INTRINSICS
+	for( UINT32 baseIndex = 0; baseIndex < count; baseIndex += 4 )
+	{
+		const SoA_AABB4& packet = boxes[ baseIndex / 4 ];
+		const UINT32 numLanes = smallest( count - baseIndex, 4u );
+#if MM_ENABLE_INTRINSICS
+		const __m128 X = _mm_loadu_ps( packet.x );
+		const __m128 Y = _mm_loadu_ps( packet.y );
+		const __m128 Z = _mm_loadu_ps( packet.z );
+		const __m128 EX = _mm_loadu_ps( packet.ex );
+		const __m128 EY = _mm_loadu_ps( packet.ey );
+		const __m128 EZ = _mm_loadu_ps( packet.ez );
+		__m128 outside = _mm_setzero_ps();
+		for( int i = 0; i < 6; i++ )
+		{
+			// the projected radius of the box, as in Frustum_IntersectsAABB()
+			const __m128 radius = _mm_add_ps( _mm_add_ps( _mm_mul_ps( absX[i], EX ), _mm_mul_ps( absY[i], EY ) ), _mm_mul_ps( absZ[i], EZ ) );
+			const __m128 distance = frustum.Distance( i, X, Y, Z );
+			outside = _mm_or_ps( outside, _mm_cmplt_ps( _mm_add_ps( distance, radius ), _mm_setzero_ps() ) );
+		}
+		const int visibleMask = ~_mm_movemask_ps( outside );
+#else
+		int visibleMask = 0;
+		for( UINT32 lane = 0; lane < numLanes; lane++ )
+		{
+			const Vector4 center = Vector4_Set( packet.x[lane], packet.y[lane], packet.z[lane], 0.0f );
+			const Vector4 extent = Vector4_Set( packet.ex[lane], packet.ey[lane], packet.ez[lane], 0.0f );
+			visibleMask |= int(Frustum_IntersectsAABB( planes, center, extent )) << lane;
+		}
+#endif // MM_ENABLE_INTRINSICS
+		numVisible = AppendVisible( visibleMask, baseIndex, numLanes, numVisible, visible );
+	}
+	return numVisible;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,125 @@
+/*
+=============================================================================
+	File:	SoAMath.h
+	Desc:	Batch math kernels working on structure-of-arrays packets:
+			transforms of point/normal arrays and frustum culling of bounding volumes.
+	Note:	The packets are named SoA_* to avoid clashing with the matrix types
+			(Float3x4 is a 3x4 matrix).
+=============================================================================
+*/
+#pragma once
+
+/*
+=======================================================================
+	PACKET TYPES
+=======================================================================
+*/
+
+// 4 3D vectors in SoA layout
+mxPREALIGN(16) struct SoA_Float3x4
+{
+	float	x[4];
+	float	y[4];
+	float	z[4];
+};
+
+// 8 3D vectors in SoA layout (the size of an AVX register)
+mxPREALIGN(32) struct SoA_Float3x8
+{
+	float	x[8];
+	float	y[8];
+	float	z[8];
+};
+
+// 4 bounding spheres
+mxPREALIGN(16) struct SoA_Sphere4
+{
+	float	x[4];	// center
+	float	y[4];
+	float	z[4];
+	float	radius[4];
+};
+
+// 4 axis-aligned bounding boxes
+mxPREALIGN(16) struct SoA_AABB4
+{
+	float	x[4];	// center
+	float	y[4];
+	float	z[4];
+	float	ex[4];	// extent (half size)
+	float	ey[4];
+	float	ez[4];
+};
+
+// the number of packets needed to hold the given number of vectors
+inline UINT32 SoA_NumPackets4( UINT32 count ) { return (count + 3) / 4; }
+inline UINT32 SoA_NumPackets8( UINT32 count ) { return (count + 7) / 8; }
+
+/*
+=======================================================================
+	AoS <-> SoA CONVERSION
+=======================================================================
+*/
+
+// The last packet is padded by replicating the last vector,
+// so that the kernels don't produce NaNs or denormals in the unused lanes.
+void SoA_Swizzle( const Float3* vectors, UINT32 count, SoA_Float3x4 *packets );
+void SoA_Swizzle( const Float3* vectors, UINT32 count, SoA_Float3x8 *packets );
+
+void SoA_Unswizzle( const SoA_Float3x4* packets, UINT32 count, Float3 *vectors );
+void SoA_Unswizzle( const SoA_Float3x8* packets, UINT32 count, Float3 *vectors );
+
+// interoperation with vertex arrays (e.g. TcTriMesh::positions)
+ERet SoA_FromArray( const TArray< Float3 >& vectors, TArray< SoA_Float3x4 > &packets );
+ERet SoA_FromArray( const TArray< Float3 >& vectors, TArray< SoA_Float3x8 > &packets );
+
+ERet SoA_ToArray( const TArray< SoA_Float3x4 >& packets, UINT32 count, TArray< Float3 > &vectors );
+ERet SoA_ToArray( const TArray< SoA_Float3x8 >& packets, UINT32 count, TArray< Float3 > &vectors );
+
+void SoA_SetSphere( SoA_Sphere4 &packet, UINT32 lane, const Float3& center, float radius );
+void SoA_SetAABB( SoA_AABB4 &packet, UINT32 lane, const Float3& minPoint, const Float3& maxPoint );
+
+/*
+=======================================================================
+	TRANSFORMS
+=======================================================================
+*/
+
+// Transforms points (W=1) by an affine matrix, 'result' can be equal to 'points'.
+void SoA_TransformPoints( const Float4x4& m, const SoA_Float3x4* points, UINT32 numPackets, SoA_Float3x4 *result );
+void SoA_TransformPoints( const Float4x4& m, const SoA_Float3x8* points, UINT32 numPackets, SoA_Float3x8 *result );	// uses AVX if MM_ENABLE_AVX is set
+
+// Transforms normals (W=0) by the upper 3x3 part of the matrix, the results are not normalized.
+// NOTE: use the inverse transpose of the matrix if it contains non-uniform scaling.
+void SoA_TransformNormals( const Float4x4& m, const SoA_Float3x4* normals, UINT32 numPackets, SoA_Float3x4 *result );
+void SoA_TransformNormals( const Float4x4& m, const SoA_Float3x8* normals, UINT32 numPackets, SoA_Float3x8 *result );
+
+// The same for vertex arrays in AoS layout: each group of 4 vectors is swizzled in registers.
+void Float3_TransformPoints( const Float4x4& m, const Float3* points, UINT32 count, Float3 *result );
+void Float3_TransformNormals( const Float4x4& m, const Float3* normals, UINT32 count, Float3 *result );
+
+/*
+=======================================================================
+	CULLING
+=======================================================================
+*/
+
+// Tests 'count' bounding volumes against the frustum planes (see Frustum_ExtractPlanes()),
+// writes the indices of the visible ones and returns their number ('visible' must have room for 'count' indices).
+// The results are the same as with Frustum_IntersectsSphere() and Frustum_IntersectsAABB().
+UINT32 Frustum_CullSpheres( const Vector4 planes[6], const SoA_Sphere4* spheres, UINT32 count, UINT32 *visible );
+UINT32 Frustum_CullAABBs( const Vector4 planes[6], const SoA_AABB4* boxes, UINT32 count, UINT32 *visible );
+
+/*
+=======================================================================
+	TESTING
+=======================================================================
+*/
+
+// Checks the batch kernels against the single-vector functions
+// and prints the single-threaded throughput.
+ERet SoAMath_Benchmark( UINT32 numPoints = 1<<20, UINT32 numVolumes = 100000 );
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,275 @@
+/*
+=============================================================================
+	File:	FrameAlloc.cpp
+	Desc:	Thread-safe linear allocator for transient per-frame memory.
+=============================================================================
+*/
+#include <Base/Base_PCH.h>
+#pragma hdrstop
+#include <Base/Base.h>
+
+#include <Base/Memory/Frame/FrameAlloc.h>
+
+namespace
+{
+	// threads get indices of sub-blocks on the first allocation,
+	// the indices of exited threads are reused (see FrameAllocator_ReleaseThreadSlot())
+	mxTHREAD_LOCAL UINT32	gs_threadSlot = 0;	// 0 - not assigned yet
+	UINT32					gs_numThreadSlots = 0;
+	UINT32					gs_freeThreadSlots[ FrameAllocator::MAX_THREADS ];
+	UINT32					gs_numFreeThreadSlots = 0;
+	AtomicInt				gs_threadSlotsLock = 0;
+
+	mxNO_INLINE UINT32 AssignThreadSlot()
+	{
+		UINT32 slot;
+		{
+			AtomicLock	lock( &gs_threadSlotsLock );
+			if( gs_numFreeThreadSlots ) {
+				slot = gs_freeThreadSlots[ --gs_numFreeThreadSlots ];
+			} else if( gs_numThreadSlots < FrameAllocator::MAX_THREADS ) {
+				slot = ++gs_numThreadSlots;
+			} else {
+				slot = FrameAllocator::MAX_THREADS + 1;	// no sub-blocks
+			}
+		}
+		gs_threadSlot = slot;
+		return slot;
+	}
+
+	inline UINT32 GetThreadSlot()
+	{
+		UINT32 slot = gs_threadSlot;
+		if( !slot ) {
+			slot = AssignThreadSlot();
+		}
+		return slot - 1;
+	}
+
+	inline char* AlignPointer( char* pointer, UINT32 alignment )
+	{
+		return (char*) AlignUp( (UINT_PTR)pointer, alignment );
+	}
+}//namespace
+
+void FrameAllocator_ReleaseThreadSlot()
+{
+	const UINT32 slot = gs_threadSlot;
+	gs_threadSlot = 0;
+	if( slot && slot <= FrameAllocator::MAX_THREADS )
+	{
+		AtomicLock	lock( &gs_threadSlotsLock );
+		gs_freeThreadSlots[ gs_numFreeThreadSlots++ ] = slot;
+	}
+}
+
+/*
+--------------------------------------------------------------
+	FrameAllocator
+--------------------------------------------------------------
+*/
+FrameAllocator::FrameAllocator()
+{
+	mxZERO_OUT(m_threadBlocks);
+	mxZERO_OUT(m_regions);
+	m_current = nil;
+	m_regionSize = 0;
+	m_numRegions = 0;
+	m_frameNumber = 0;
+	m_heap = HeapGeneric;
+	m_lastFrameBytes = 0;
+	m_highWaterMark = 0;
+	m_numOverflows = 0;
+	m_totalOverflowBytes = 0;
+}
+
+FrameAllocator::~FrameAllocator()
+{
+	mxASSERT2(!m_current, "FrameAllocator::Shutdown() was not called");
+}
+
+ERet FrameAllocator::Initialize( UINT32 regionSize, UINT32 numRegions, EMemHeap heap )
+{
+	mxASSERT(!m_current);
+	chkRET_X_IF_NOT(regionSize >= SUB_BLOCK_SIZE && regionSize <= F_GetMaxAllowedAllocationSize(), ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(numRegions >= 2 && numRegions <= MAX_REGIONS, ERR_INVALID_PARAMETER);
+
+	m_regionSize = regionSize;
+	m_numRegions = numRegions;
+	m_heap = heap;
+
+	for( UINT32 i = 0; i < numRegions; i++ )
+	{
+		Region & region = m_regions[i];
+		region.memory = static_cast< char* >( mxAllocX( heap, regionSize ) );
+		if( !region.memory ) {
+			this->Shutdown();
+			return ERR_OUT_OF_MEMORY;
+		}
+	}
+
+	// sub-blocks of the previous initialization would point into the freed regions
+	mxZERO_OUT(m_threadBlocks);
+	m_frameNumber = 0;
+	m_current = &m_regions[0];
+	this->BeginFrame();
+
+	return ALL_OK;
+}
+
+void FrameAllocator::Shutdown()
+{
+	for( UINT32 i = 0; i < m_numRegions; i++ )
+	{
+		Region & region = m_regions[i];
+		this->RetireRegion( region );
+		mxFreeX( m_heap, region.memory );
+		region.memory = nil;
+	}
+	mxZERO_OUT(m_threadBlocks);
+	m_current = nil;
+	m_numRegions = 0;
+}
+
+bool FrameAllocator::IsInitialized() const
+{
+	return m_current != nil;
+}
+
+void FrameAllocator::BeginFrame()
+{
+	mxASSERT2(m_current, "FrameAllocator is not initialized");
+
+	m_frameNumber++;
+
+	// the sub-blocks of all threads become stale because their frame number doesn't match
+	Region & region = m_regions[ m_frameNumber % m_numRegions ];
+	this->RetireRegion( region );
+	region.frameNumber = m_frameNumber;
+
+	m_current = &region;
+}
+
+void* FrameAllocator::Alloc( UINT32 size, UINT32 alignment )
+{
+	mxASSERT2(m_current, "FrameAllocator is not initialized");
+	mxASSERT(IsPowerOfTwo( alignment ));
+
+	// small allocations are made from the thread's sub-block
+	const UINT32 slot = GetThreadSlot();
+	if( slot < MAX_THREADS && size + alignment <= SUB_BLOCK_SIZE / 4 )
+	{
+		ThreadBlock & block = m_threadBlocks[ slot ];
+		if( block.frameNumber == m_frameNumber )
+		{
+			char* start = AlignPointer( block.current, alignment );
+			if( start + size <= block.end ) {
+				block.current = start + size;
+				return start;
+			}
+		}
+
+		char* subBlock = this->AllocFromRegion( SUB_BLOCK_SIZE, EFFICIENT_ALIGNMENT );
+		if( subBlock )
+		{
+			char* start = AlignPointer( subBlock, alignment );
+			block.current = start + size;
+			block.end = subBlock + SUB_BLOCK_SIZE;
+			block.frameNumber = m_frameNumber;
+			return start;
+		}
+	}
+
+	char* memory = this->AllocFromRegion( size, alignment );
+	if( memory ) {
+		return memory;
+	}
+	return this->AllocOverflow( size, alignment );
+}
+
+// thread-safe
+char* FrameAllocator::AllocFromRegion( UINT32 size, UINT32 alignment )
+{
+	Region & region = *m_current;
+	for(;;)
+	{
+		const UINT32 used = region.used;
+		char* start = AlignPointer( region.memory + used, alignment );
+		const UINT32 newUsed = (UINT32)( start - region.memory ) + size;
+		if( newUsed > m_regionSize || newUsed < used ) {
+			return nil;
+		}
+		if( AtomicCAS( &region.used, used, newUsed ) ) {
+			return start;
+		}
+	}
+}
+
+// thread-safe, the block is freed when the frame is retired
+char* FrameAllocator::AllocOverflow( UINT32 size, UINT32 alignment )
+{
+	Region & region = *m_current;
+
+	OverflowBlock* block = static_cast< OverflowBlock* >( mxAllocX( m_heap, sizeof(OverflowBlock) + alignment + size ) );
+	if( !block ) {
+		return nil;
+	}
+	block->size = size;
+
+	OverflowBlock* head;
+	do
+	{
+		head = region.overflows;
+		block->next = head;
+	}
+	while( AtomicCompareExchangePointer( (void* volatile*) &region.overflows, head, block ) != head );
+
+	if( AtomicAdd( region.overflowBytes, size ) == (int)size ) {
+		ptWARN("FrameAllocator: frame %u doesn't fit into %u bytes, using the heap.\n", region.frameNumber, m_regionSize);
+	}
+	AtomicIncrement( m_numOverflows );
+	AtomicAdd( m_totalOverflowBytes, size );
+
+	return AlignPointer( (char*)( block + 1 ), alignment );
+}
+
+void FrameAllocator::RetireRegion( Region & region )
+{
+	if( region.frameNumber )
+	{
+		const UINT32 frameBytes = region.used + region.overflowBytes;
+		m_lastFrameBytes = frameBytes;
+		m_highWaterMark = largest( m_highWaterMark, frameBytes );
+	}
+
+	OverflowBlock* block = region.overflows;
+	while( block )
+	{
+		OverflowBlock* next = block->next;
+		mxFreeX( m_heap, block );
+		block = next;
+	}
+
+	region.used = 0;
+	region.frameNumber = 0;
+	region.overflows = nil;
+	region.overflowBytes = 0;
+}
+
+void FrameAllocator::GetStats( FrameAllocatorStats &outStats ) const
+{
+	outStats.regionSize = m_regionSize;
+	outStats.numRegions = m_numRegions;
+	outStats.frameNumber = m_frameNumber;
+	outStats.lastFrameBytes = m_lastFrameBytes;
+	outStats.highWaterMark = m_highWaterMark;
+	if( m_current ) {
+		outStats.highWaterMark = largest( outStats.highWaterMark, UINT32(m_current->used + m_current->overflowBytes) );
+	}
+	outStats.numOverflows = m_numOverflows;
+	outStats.overflowBytes = m_totalOverflowBytes;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,151 @@
+/*
+=============================================================================
+	File:	FrameAlloc.h
+	Desc:	Thread-safe linear allocator for transient per-frame memory.
+	Note:	The memory is split into several regions, one for each frame in flight.
+			Allocations are made by bumping a pointer in the current region,
+			a region is reset as a whole when its frame is retired,
+			i.e. memory allocated in frame N stays valid until frame N + numFrames begins
+			(so that the render thread, the GPU or jobs can consume it).
+=============================================================================
+*/
+#pragma once
+
+//
+//	FrameAllocatorStats - telemetry for choosing the region size.
+//
+struct FrameAllocatorStats
+{
+	UINT32	regionSize;		// the capacity of each frame, in bytes
+	UINT32	numRegions;		// the max. number of frames in flight
+	UINT32	frameNumber;	// the number of started frames
+	UINT32	lastFrameBytes;	// the memory used by the last retired frame, in bytes
+	UINT32	highWaterMark;	// the max. memory used by a frame, in bytes (including overflows)
+	UINT32	numOverflows;	// the number of allocations which didn't fit and were made on the heap
+	UINT32	overflowBytes;
+};
+
+/*
+--------------------------------------------------------------
+	FrameAllocator
+
+	Alloc() can be called from any thread, each thread bumps a pointer
+	in its own sub-block taken from the current region (the region pointer is bumped atomically),
+	so there's no contention except when a thread needs a new sub-block.
+	BeginFrame() must not run concurrently with Alloc().
+	Allocations which don't fit into the region are made on the heap
+	and freed when the frame is retired (and reported in the stats).
+--------------------------------------------------------------
+*/
+class FrameAllocator : NonCopyable
+{
+public:
+	enum
+	{
+		MAX_REGIONS = 4,
+		MAX_THREADS = 32,	// threads with sub-blocks, the others allocate directly from the region
+		SUB_BLOCK_SIZE = 16*mxKILOBYTE,
+	};
+
+public:
+	FrameAllocator();
+	~FrameAllocator();
+
+	// allocates 'numRegions' regions of 'regionSize' bytes each from the given heap
+	ERet Initialize( UINT32 regionSize, UINT32 numRegions = 3, EMemHeap heap = HeapGeneric );
+	void Shutdown();
+
+	bool IsInitialized() const;
+
+	// Retires the oldest frame and starts a new one in its region,
+	// the caller must make sure that the oldest frame has been consumed.
+	void BeginFrame();
+
+	// never returns nil after Initialize() unless the system is out of memory
+	void* Alloc( UINT32 size, UINT32 alignment = EFFICIENT_ALIGNMENT );
+
+	template< typename TYPE >
+	inline TYPE* AllocMany( UINT32 count, UINT32 alignment = EFFICIENT_ALIGNMENT )
+	{
+		return static_cast< TYPE* >( this->Alloc( count * sizeof(TYPE), alignment ) );
+	}
+
+	void GetStats( FrameAllocatorStats &outStats ) const;
+
+private:
+	struct OverflowBlock
+	{
+		OverflowBlock *	next;
+		UINT32			size;
+	};
+
+	struct Region
+	{
+		char *			memory;
+		AtomicInt		used;	// bumped by sub-block and direct allocations
+		UINT32			frameNumber;	// of the frame using this region
+		OverflowBlock * volatile	overflows;	// heap blocks to free on retirement
+		AtomicInt		overflowBytes;
+	};
+
+	// written only by its thread, padded to avoid false sharing
+	struct ThreadBlock
+	{
+		char *	current;
+		char *	end;
+		UINT32	frameNumber;	// the sub-block is stale if it's from another frame
+		BYTE	_pad0[ mxCACHE_LINE_SIZE - sizeof(char*)*2 - sizeof(UINT32) ];
+	};
+
+	char* AllocFromRegion( UINT32 size, UINT32 alignment );
+	char* AllocOverflow( UINT32 size, UINT32 alignment );
+	void RetireRegion( Region & region );
+
+private:
+	ThreadBlock		m_threadBlocks[ MAX_THREADS ];
+	Region			m_regions[ MAX_REGIONS ];
+	Region *		m_current;
+	UINT32			m_regionSize;
+	UINT32			m_numRegions;
+	UINT32			m_frameNumber;
+	EMemHeap		m_heap;
+
+	// telemetry
+	UINT32			m_lastFrameBytes;
+	UINT32			m_highWaterMark;
+	AtomicInt		m_numOverflows;
+	AtomicInt		m_totalOverflowBytes;
+};
+
+// Lets other threads use the sub-blocks of the calling thread,
+// called automatically when threads created with the Thread class exit.
+void FrameAllocator_ReleaseThreadSlot();
+
+// Checks that the data survives the frames in flight and that the steady state doesn't touch the heaps,
+// and compares the throughput with the heap allocator.
+ERet FrameAllocator_Benchmark( UINT32 numThreads = 8, UINT32 numFrames = 100, UINT32 numAllocationsPerThread = 4096 );
+
+/*
+--------------------------------------------------------------
+	TFrameArray
+	a dynamic array with the storage allocated from the frame allocator,
+	it doesn't allocate heap memory unless it grows beyond 'maxCount'.
+--------------------------------------------------------------
+*/
+template< typename TYPE >
+class TFrameArray : public TArray< TYPE >
+{
+public:
+	TFrameArray( FrameAllocator & allocator, UINT32 maxCount )
+	{
+		TYPE* storage = allocator.AllocMany< TYPE >( maxCount, largest( (UINT32)mxALIGNMENT(TYPE), (UINT32)EFFICIENT_ALIGNMENT ) );
+		if( storage ) {
+			this->SetExternalStorage( storage, maxCount );
+		}
+	}
+	PREVENT_COPY( TFrameArray );
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -3,8 +3,7 @@
 	File:	Memory.cpp
 	Desc:	Memory management.
 	Note:	all functions have been made to allocate 16-byte aligned memory blocks.
-	ToDo:	use several memory heaps
-	(on Windows use heaps with low fragmentation feature turned on)
+			The engine heaps are implemented in ScalableHeap.cpp.
 =============================================================================
 */
 
@@ -28,6 +27,34 @@
 
 //-------------------------------------------------------------------------
 
+static const char* gs_memoryHeapNames[ HeapCount ] =
+{
+#define DECLARE_MEMORY_HEAP( name, description )	#name
+#include <Base/Memory/MemoryHeaps.inl>
+#undef DECLARE_MEMORY_HEAP
+};
+
+static const char* gs_memoryHeapDescriptions[ HeapCount ] =
+{
+#define DECLARE_MEMORY_HEAP( name, description )	description
+#include <Base/Memory/MemoryHeaps.inl>
+#undef DECLARE_MEMORY_HEAP
+};
+
+const char* mxGetMemoryHeapName( EMemHeap heap )
+{
+	mxASSERT(heap < HeapCount);
+	return gs_memoryHeapNames[ heap ];
+}
+
+const char* mxGetMemoryHeapDescription( EMemHeap heap )
+{
+	mxASSERT(heap < HeapCount);
+	return gs_memoryHeapDescriptions[ heap ];
+}
+
+//-------------------------------------------------------------------------
+
 size_t F_GetMaxAllowedAllocationSize()
 {
 	//return 128*1024*1024;	//128 Mb
@@ -100,10 +127,10 @@ static void WriteMemHeapStats( const mxMemoryStatistics& stats, ALog& log )
 	log.PrintF( LL_Info,
 		"\nAllocated now: %u bytes, allocated in total: %u bytes, total allocations: %u"
 		"\nDeallocated in total: %u bytes, total deallocations: %u"
-		"\nPeak memory usage: %u bytes"
+		"\nPeak memory usage: %u bytes, reserved now: %u bytes"
 		,stats.bytesAllocated ,stats.totalAllocated ,stats.totalNbAllocations
 		,stats.totalFreed ,stats.totalNbDeallocations
-		,stats.peakMemoryUsage
+		,stats.peakMemoryUsage ,stats.bytesReserved
 		);
 }
 
@@ -112,6 +139,20 @@ void mxMemoryStatistics::Dump( ALog& log )
 	WriteMemHeapStats( *this, log );
 }
 
+static void AccumulateStats( const mxMemoryStatistics& heapStats, mxMemoryStatistics &totalStats )
+{
+	totalStats.bytesAllocated += heapStats.bytesAllocated;
+	totalStats.totalAllocated += heapStats.totalAllocated;
+	totalStats.totalNbAllocations += heapStats.totalNbAllocations;
+	totalStats.peakMemoryUsage += heapStats.peakMemoryUsage;
+	totalStats.bytesReserved += heapStats.bytesReserved;
+
+	totalStats.totalNbReallocations += heapStats.totalNbReallocations;
+
+	totalStats.totalFreed += heapStats.totalFreed;
+	totalStats.totalNbDeallocations += heapStats.totalNbDeallocations;
+}
+
 /*
 ================================
 	F_GetGlobalMemoryStats
@@ -119,7 +160,14 @@ void mxMemoryStatistics::Dump( ALog& log )
 */
 void F_GetGlobalMemoryStats( mxMemoryStatistics &outStats )
 {
-	mxZERO_OUT(outStats);
+	outStats.Reset();
+
+	for( UINT iMemHeap = 0; iMemHeap < HeapCount; iMemHeap++ )
+	{
+		mxMemoryStatistics	heapStats;
+		F_GetMemoryHeapStats( (EMemHeap)iMemHeap, heapStats );
+		AccumulateStats( heapStats, outStats );
+	}
 }
 
 /*
@@ -129,34 +177,32 @@ void F_GetGlobalMemoryStats( mxMemoryStatistics &outStats )
 */
 void F_DumpGlobalMemoryStats( ALog& log )
 {
-	//CalendarTime	localTime( CalendarTime::GetCurrentLocalTime() );
-	//LocalString	timeOfDay;
-	//GetTimeOfDayString( timeOfDay, localTime.hour, localTime.minute, localTime.second );
-
-	//log.Logf( LL_Info, "\n\n[%s] Memory heap stats:\n", timeOfDay.ToPtr() );
+	log.PrintF( LL_Info, "\n\nMemory heap stats:\n" );
 
-	//mxMemoryStatistics	totalStats;
+	mxMemoryStatistics	totalStats;
 
-	//for( UINT iMemHeap = 0; iMemHeap < EMemHeap::HeapCount; iMemHeap++ )
-	//{
-	//	const mxMemoryStatistics& heapStats = g_memStats[ iMemHeap ];
+	for( UINT iMemHeap = 0; iMemHeap < HeapCount; iMemHeap++ )
+	{
+		mxMemoryStatistics	heapStats;
+		F_GetMemoryHeapStats( (EMemHeap)iMemHeap, heapStats );
 
-	//	log.Logf( LL_Info, "\n\n--- [%u] Memory heap: '%s' ----------", iMemHeap, mxGetMemoryHeapName( (EMemHeap)iMemHeap ) );
-	//	WriteMemHeapStats( heapStats, log );
+		if( !heapStats.totalNbAllocations && !heapStats.bytesReserved ) {
+			continue;
+		}
 
-	//	totalStats.bytesAllocated += heapStats.bytesAllocated;
-	//	totalStats.totalAllocated += heapStats.totalAllocated;
-	//	totalStats.totalNbAllocations += heapStats.totalNbAllocations;
-	//	totalStats.peakMemoryUsage += heapStats.peakMemoryUsage;
+		log.PrintF( LL_Info, "\n\n--- [%u] Memory heap: '%s' ----------", iMemHeap, mxGetMemoryHeapName( (EMemHeap)iMemHeap ) );
+		WriteMemHeapStats( heapStats, log );
 
-	//	totalStats.totalNbReallocations += heapStats.totalNbReallocations;
+		const size_t budget = F_GetMemoryHeapBudget( (EMemHeap)iMemHeap );
+		if( budget ) {
+			log.PrintF( LL_Info, "\nBudget: %u bytes", (UINT)budget );
+		}
 
-	//	totalStats.totalFreed += heapStats.totalFreed;
-	//	totalStats.totalNbDeallocations += heapStats.totalNbDeallocations;
-	//}
+		AccumulateStats( heapStats, totalStats );
+	}
 
-	//log.Logf( LL_Info, "\n--- Total ----------\n" );
-	//WriteMemHeapStats( totalStats, log );
+	log.PrintF( LL_Info, "\n--- Total ----------\n" );
+	WriteMemHeapStats( totalStats, log );
 }
 
 //-------------------------------------------------------------------------
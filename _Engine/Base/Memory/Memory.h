@@ -2,9 +2,8 @@
 =============================================================================
 	File:	Memory.h
 	Desc:	Memory management.
-	Note:	It's far from finished.
-	ToDo:	Memory limits and watchdogs, thread-safety,
-			allow users to define their own OutOfMemory handlers, etc.
+	Note:	Small blocks are allocated from per-thread caches of size-class slabs
+			(see ScalableHeap.cpp), each memory heap has its own slabs, statistics and budget.
 =============================================================================
 */
 #pragma once
@@ -19,6 +18,9 @@
 
 #define MX_ENABLE_DEBUG_HEAP	(1)
 
+// 1 - Compile in the allocation tracker (see Tracker/AllocationTracker.h), it's started at run time.
+#define MX_ENABLE_ALLOCATION_TRACKER	MX_DEVELOPER
+
 // 1 - Redirect the global 'new' and 'delete' to our memory manager.
 // this is dangerous, it may be better to define them on per-type basis or use special macros.
 #define MX_OVERRIDE_GLOBAL_NEWDELETE	(0)
@@ -32,6 +34,21 @@
 //		Declarations.
 //---------------------------------------------------------------------------
 
+//
+//	EMemHeap - engine memory heaps (for tracking memory usage by subsystems).
+//
+enum EMemHeap
+{
+#define DECLARE_MEMORY_HEAP( name, description )	name
+#include <Base/Memory/MemoryHeaps.inl>
+#undef DECLARE_MEMORY_HEAP
+
+	HeapCount
+};
+
+const char* mxGetMemoryHeapName( EMemHeap heap );
+const char* mxGetMemoryHeapDescription( EMemHeap heap );
+
 //
 //	mxMemoryStatistics - holds memory allocation information.
 //
@@ -44,6 +61,8 @@ struct mxMemoryStatistics
 
 	size_t	peakMemoryUsage;	// in bytes
 
+	size_t	bytesReserved;	// memory taken from the system (slabs and large blocks), in bytes
+
 	UINT	totalNbAllocations;	// incremented whenever allocation occurs
 	UINT	totalNbReallocations;// incremented whenever reallocation occurs
 	UINT	totalNbDeallocations;// incremented whenever deallocation occurs
@@ -62,6 +81,8 @@ public:
 
 		peakMemoryUsage = 0;
 
+		bytesReserved = 0;
+
 		totalNbAllocations = 0;
 		totalNbReallocations = 0;
 		totalNbDeallocations = 0;
@@ -84,9 +105,12 @@ public:
 	void Dump( ALog& log );
 };
 
-// reports memory statistics
+// reports memory statistics (summed over all heaps)
 void F_GetGlobalMemoryStats( mxMemoryStatistics &outStats );
 
+// NOTE: 'peakMemoryUsage' is the peak of reserved memory (it's tracked at the slab granularity).
+void F_GetMemoryHeapStats( EMemHeap heap, mxMemoryStatistics &outStats );
+
 // writes memory statistics, usage & leak info to the specified file
 void F_DumpGlobalMemoryStats( ALog& log );
 
@@ -101,12 +125,45 @@ size_t F_SysSizeOfMemoryBlock( const void* pointer );
 
 void F_MemDbg_ValidateHeap();	// debug mode only
 
+//
+//	Engine heap allocator.
+//
+//	Blocks up to 32 KiB are carved from size-class slabs owned by the calling thread (no locks),
+//	blocks freed by other threads are pushed onto lock-free lists of their slabs
+//	and picked up by the owner thread. Larger blocks are allocated with F_SysAlloc().
+//	All blocks are 16-byte aligned.
+//
+void* mxAllocX( EMemHeap heap, size_t numBytes );
+void mxFreeX( EMemHeap heap, const void* pointer );	// the heap is found by the pointer
+
+// returns the usable size of the memory block
+size_t mxGetAllocationSize( const void* pointer );
+
+// Limits the memory reserved by the heap, 0 - no limit (the default).
+void F_SetMemoryHeapBudget( EMemHeap heap, size_t maxBytes );
+size_t F_GetMemoryHeapBudget( EMemHeap heap );
+
+// Called when a heap exceeds its budget or the system is out of memory.
+// The handler can free some memory and return true to retry the allocation
+// (up to a few times), otherwise the allocation returns nil.
+typedef bool F_OutOfMemoryHandler( EMemHeap heap, size_t numBytes, void* userData );
+void F_SetOutOfMemoryHandler( F_OutOfMemoryHandler* handler, void* userData );
+
+// Returns empty slabs of the calling thread to the shared pool and lets other threads adopt its cache.
+// Called automatically when threads created with the Thread class exit,
+// other threads that use the heaps should call it before they exit.
+void F_ReleaseThreadHeapCache();
+
+// Checks the heap allocator and measures its throughput with the given number of threads
+// (including cross-thread frees) and the system allocator for comparison.
+ERet F_BenchmarkMemoryHeaps( UINT32 numThreads = 8, UINT32 numAllocationsPerThread = 1<<20 );
+
 //---------------------------------------------------------------------------
 //		Helper macros.
 //---------------------------------------------------------------------------
 
-#define mxAlloc( numBytes )					F_SysAlloc( (numBytes) )
-#define mxFree( pointer )					F_SysFree( (pointer) )
+#define mxAlloc( numBytes )					mxAllocX( HeapGeneric, (numBytes) )
+#define mxFree( pointer )					mxFreeX( HeapGeneric, (pointer) )
 
 #define mxMalloc16( numBytes )	mxAlloc( ALIGN16(numBytes) )
 #define mxFree16( pMemory )		mxFree( (pMemory) )
@@ -0,0 +1,541 @@
+/*
+=============================================================================
+	File:	MemoryTests.cpp
+	Desc:	Verification and benchmarking of the engine memory heaps,
+			the frame allocator and the allocation tracker.
+=============================================================================
+*/
+#include <Base/Base_PCH.h>
+#pragma hdrstop
+#include <Base/Base.h>
+
+#include <Base/Memory/Frame/FrameAlloc.h>
+#include <Base/Memory/Tracker/AllocationTracker.h>
+
+namespace
+{
+
+typedef void* F_Allocate( size_t numBytes );
+typedef void F_Deallocate( const void* pointer );
+
+void* HeapAllocate( size_t numBytes )		{ return mxAllocX( HeapTemp, numBytes ); }
+void HeapDeallocate( const void* pointer )	{ mxFreeX( HeapTemp, pointer ); }
+
+void* SystemAllocate( size_t numBytes )		{ return F_SysAlloc( numBytes ); }
+void SystemDeallocate( const void* pointer )	{ F_SysFree( pointer ); }
+
+enum
+{
+	MAX_BENCHMARK_THREADS = 64,
+	NUM_LIVE_BLOCKS = 1024,	// per thread
+	HANDOFF_QUEUE_SIZE = 1024,
+};
+
+// Passes blocks to the next thread which frees them.
+// A single-producer single-consumer ring buffer, relies on x86 memory ordering.
+struct HandoffQueue
+{
+	void * volatile	items[ HANDOFF_QUEUE_SIZE ];
+	volatile UINT32	head;	// written by the consumer
+	volatile UINT32	tail;	// written by the producer
+	volatile bool	producerFinished;
+};
+
+struct BenchmarkThread
+{
+	F_Allocate *	allocate;
+	F_Deallocate *	deallocate;
+	HandoffQueue *	incoming;
+	HandoffQueue *	outgoing;
+	UINT32			numAllocations;
+	UINT32			seed;
+	UINT32			numErrors;
+	Thread			thread;
+};
+
+// mostly small blocks, sometimes larger than the biggest size class
+size_t RandomBlockSize( UINT32 &seed )
+{
+	seed = 69069 * seed + 1;
+	const UINT32 random = seed >> 8;
+	if( (random & 63) == 0 ) {
+		return 4096 + (random >> 6) % (60*1024);
+	}
+	return 16 + (random >> 6) % 512;
+}
+
+// stores the size at both ends of the block to detect overlapping blocks
+void FillBlock( void* block, size_t size )
+{
+	UINT32* words = static_cast< UINT32* >( block );
+	words[0] = (UINT32) size;
+	words[1] = ~(UINT32) size;
+	static_cast< BYTE* >( block )[ size - 1 ] = (BYTE) size;
+}
+
+bool CheckBlock( const void* block )
+{
+	const UINT32* words = static_cast< const UINT32* >( block );
+	const size_t size = words[0];
+	return words[1] == ~(UINT32) size && static_cast< const BYTE* >( block )[ size - 1 ] == (BYTE) size;
+}
+
+void FreeBlock( BenchmarkThread* me, void* block )
+{
+	if( !CheckBlock( block ) ) {
+		me->numErrors++;
+	}
+	(*me->deallocate)( block );
+}
+
+bool PushBlock( HandoffQueue* queue, void* block )
+{
+	const UINT32 tail = queue->tail;
+	if( tail - queue->head == HANDOFF_QUEUE_SIZE ) {
+		return false;
+	}
+	queue->items[ tail % HANDOFF_QUEUE_SIZE ] = block;
+	queue->tail = tail + 1;
+	return true;
+}
+
+void FreeIncomingBlocks( BenchmarkThread* me )
+{
+	HandoffQueue* queue = me->incoming;
+	UINT32 head = queue->head;
+	const UINT32 tail = queue->tail;
+	while( head != tail ) {
+		FreeBlock( me, queue->items[ head % HANDOFF_QUEUE_SIZE ] );
+		head++;
+	}
+	queue->head = head;
+}
+
+UINT32 PASCAL BenchmarkThreadFunction( void* userPointer )
+{
+	BenchmarkThread* me = static_cast< BenchmarkThread* >( userPointer );
+
+	void* liveBlocks[ NUM_LIVE_BLOCKS ] = { nil };
+	UINT32 seed = me->seed;
+
+	for( UINT32 i = 0; i < me->numAllocations; i++ )
+	{
+		const size_t size = RandomBlockSize( seed );
+		void* block = (*me->allocate)( size );
+		if( !block || !IS_ALIGNED_BY( block, EFFICIENT_ALIGNMENT ) ) {
+			me->numErrors++;
+			continue;
+		}
+		FillBlock( block, size );
+
+		// every 4th block is freed by the next thread
+		if( (i & 3) != 0 || !PushBlock( me->outgoing, block ) )
+		{
+			void *& slot = liveBlocks[ (seed >> 4) % NUM_LIVE_BLOCKS ];
+			if( slot ) {
+				FreeBlock( me, slot );
+			}
+			slot = block;
+		}
+
+		FreeIncomingBlocks( me );
+	}
+	me->outgoing->producerFinished = true;
+
+	for( UINT32 i = 0; i < NUM_LIVE_BLOCKS; i++ ) {
+		if( liveBlocks[i] ) {
+			FreeBlock( me, liveBlocks[i] );
+		}
+	}
+	while( !me->incoming->producerFinished ) {
+		FreeIncomingBlocks( me );
+		YieldSoftwareThread();
+	}
+	FreeIncomingBlocks( me );
+
+	F_ReleaseThreadHeapCache();
+	return 0;
+}
+
+// returns the elapsed time in microseconds
+UINT64 RunBenchmarkThreads( F_Allocate* allocate, F_Deallocate* deallocate,
+						   UINT32 numThreads, UINT32 numAllocationsPerThread,
+						   HandoffQueue* queues, UINT32 &numErrors )
+{
+	BenchmarkThread	threads[ MAX_BENCHMARK_THREADS ];
+
+	memset( queues, 0, sizeof(queues[0]) * numThreads );
+
+	const UINT64 startTime = mxGetTimeInMicroseconds();
+
+	for( UINT32 i = 0; i < numThreads; i++ )
+	{
+		BenchmarkThread & thread = threads[i];
+		thread.allocate = allocate;
+		thread.deallocate = deallocate;
+		thread.incoming = &queues[ i ];
+		thread.outgoing = &queues[ (i + 1) % numThreads ];
+		thread.numAllocations = numAllocationsPerThread;
+		thread.seed = 12345 + i;
+		thread.numErrors = 0;
+
+		Thread::CInfo	cInfo;
+		cInfo.entryPoint = &BenchmarkThreadFunction;
+		cInfo.userPointer = &thread;
+		cInfo.debugName = "HeapBenchmark";
+		thread.thread.Initialize( cInfo );
+	}
+	for( UINT32 i = 0; i < numThreads; i++ )
+	{
+		threads[i].thread.Join();
+		threads[i].thread.Shutdown();
+		numErrors += threads[i].numErrors;
+	}
+
+	return mxGetTimeInMicroseconds() - startTime;
+}
+
+bool g_outOfMemoryHandlerCalled = false;
+
+bool RaiseBudgetOnOutOfMemory( EMemHeap heap, size_t numBytes, void* userData )
+{
+	g_outOfMemoryHandlerCalled = true;
+	F_SetMemoryHeapBudget( heap, 0 );
+	return true;
+}
+
+}//namespace
+
+ERet F_BenchmarkMemoryHeaps( UINT32 numThreads, UINT32 numAllocationsPerThread )
+{
+	chkRET_X_IF_NOT(numThreads > 0 && numThreads <= MAX_BENCHMARK_THREADS, ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(numAllocationsPerThread > 0, ERR_INVALID_PARAMETER);
+
+	HandoffQueue* queues = static_cast< HandoffQueue* >( mxAlloc( sizeof(HandoffQueue) * numThreads ) );
+	chkRET_X_IF_NIL(queues, ERR_OUT_OF_MEMORY);
+
+	mxMemoryStatistics	statsBefore;
+	F_GetMemoryHeapStats( HeapTemp, statsBefore );
+
+	ptPRINT("Memory heaps benchmark, %u allocations per thread (1/4 freed by another thread):\n", numAllocationsPerThread);
+
+	UINT32 numErrors = 0;
+	for( UINT32 threadCount = 1; ; threadCount = smallest( threadCount * 2, numThreads ) )
+	{
+		const UINT64 heapTime = RunBenchmarkThreads( &HeapAllocate, &HeapDeallocate, threadCount, numAllocationsPerThread, queues, numErrors );
+		const UINT64 systemTime = RunBenchmarkThreads( &SystemAllocate, &SystemDeallocate, threadCount, numAllocationsPerThread, queues, numErrors );
+		const double numAllocations = double(threadCount) * numAllocationsPerThread;
+
+		ptPRINT("%2u threads: heaps %.1f M/s, system %.1f M/s (allocations and frees per second)\n",
+			threadCount, numAllocations / largest( heapTime, 1ull ), numAllocations / largest( systemTime, 1ull ));
+
+		if( threadCount == numThreads ) {
+			break;
+		}
+	}
+
+	// all blocks have been freed
+	mxMemoryStatistics	statsAfter;
+	F_GetMemoryHeapStats( HeapTemp, statsAfter );
+	if( statsAfter.bytesAllocated != statsBefore.bytesAllocated
+		|| statsAfter.totalNbAllocations - statsBefore.totalNbAllocations != statsAfter.totalNbDeallocations - statsBefore.totalNbDeallocations )
+	{
+		ptWARN("Memory heaps: the statistics don't match (%u bytes leaked).\n", (UINT)(statsAfter.bytesAllocated - statsBefore.bytesAllocated));
+		numErrors++;
+	}
+
+	// the out-of-memory handler can lift the budget and retry the allocation
+	F_SetOutOfMemoryHandler( &RaiseBudgetOnOutOfMemory, nil );
+	F_SetMemoryHeapBudget( HeapTemp, statsAfter.bytesReserved + 1 );
+	void* block = mxAllocX( HeapTemp, 1024*1024 );
+	if( !block || !g_outOfMemoryHandlerCalled ) {
+		ptWARN("Memory heaps: the budget is not enforced.\n");
+		numErrors++;
+	}
+	mxFreeX( HeapTemp, block );
+	F_SetOutOfMemoryHandler( nil, nil );
+	F_SetMemoryHeapBudget( HeapTemp, 0 );
+
+	mxFree( queues );
+
+	if( numErrors ) {
+		ptWARN("Memory heaps: %u errors.\n", numErrors);
+		return ERR_UNKNOWN_ERROR;
+	}
+	return ALL_OK;
+}
+
+/*
+-----------------------------------------------------------------------------
+	FrameAllocator
+-----------------------------------------------------------------------------
+*/
+namespace
+{
+
+// the workers live across frames like the job threads and keep their sub-blocks
+struct FrameBenchmarkContext
+{
+	FrameAllocator *	allocator;	// nil - use the heap
+	void **				blocks;
+	UINT32				numAllocationsPerThread;
+	AtomicInt			frameToRun;	// -1 - quit
+	AtomicInt			numFinished;
+};
+
+struct FrameBenchmarkThread
+{
+	FrameBenchmarkContext *	context;
+	UINT32					index;
+	Thread					thread;
+};
+
+UINT32 PASCAL FrameBenchmarkThreadFunction( void* userPointer )
+{
+	FrameBenchmarkThread* me = static_cast< FrameBenchmarkThread* >( userPointer );
+	FrameBenchmarkContext* context = me->context;
+
+	int lastFrame = 0;
+	for(;;)
+	{
+		int frame;
+		while( (frame = context->frameToRun) == lastFrame ) {
+			YieldSoftwareThread();
+		}
+		if( frame < 0 ) {
+			break;
+		}
+		lastFrame = frame;
+
+		FrameAllocator* allocator = context->allocator;
+		void** blocks = context->blocks + me->index * context->numAllocationsPerThread;
+		UINT32 seed = frame * MAX_BENCHMARK_THREADS + me->index;
+
+		for( UINT32 i = 0; i < context->numAllocationsPerThread; i++ )
+		{
+			seed = 69069 * seed + 1;
+			const UINT32 size = 16 + (seed >> 8) % 240;
+			void* block = allocator ? allocator->Alloc( size ) : mxAllocX( HeapTemp, size );
+			FillBlock( block, size );
+			blocks[i] = block;
+		}
+
+		AtomicIncrement( context->numFinished );
+	}
+
+	F_ReleaseThreadHeapCache();
+	return 0;
+}
+
+// returns the time spent by the threads in microseconds
+UINT64 RunFrameBenchmark( FrameBenchmarkContext & context, UINT32 numThreads, UINT32 numFrames, UINT32 &numErrors )
+{
+	FrameBenchmarkThread	threads[ MAX_BENCHMARK_THREADS ];
+
+	enum { NUM_FRAMES_IN_FLIGHT = 3, FRAME_DATA_SIZE = 256 };
+
+	// the data of each frame must stay intact while the frame is in flight
+	const UINT32* frameData[ NUM_FRAMES_IN_FLIGHT ] = { nil };
+
+	FrameAllocator* allocator = context.allocator;
+
+	context.frameToRun = 0;
+	context.numFinished = 0;
+
+	for( UINT32 i = 0; i < numThreads; i++ )
+	{
+		FrameBenchmarkThread & thread = threads[i];
+		thread.context = &context;
+		thread.index = i;
+
+		Thread::CInfo	cInfo;
+		cInfo.entryPoint = &FrameBenchmarkThreadFunction;
+		cInfo.userPointer = &thread;
+		cInfo.debugName = "FrameBenchmark";
+		thread.thread.Initialize( cInfo );
+	}
+
+	UINT64 elapsedTime = 0;
+
+	for( UINT32 frame = 1; frame <= numFrames; frame++ )
+	{
+		if( allocator )
+		{
+			TFrameArray< UINT32 >	data( *allocator, FRAME_DATA_SIZE );
+			for( UINT32 i = 0; i < FRAME_DATA_SIZE; i++ ) {
+				data.Add( frame );
+			}
+			frameData[ frame % NUM_FRAMES_IN_FLIGHT ] = data.ToPtr();
+		}
+
+		const UINT64 startTime = mxGetTimeInMicroseconds();
+
+		context.numFinished = 0;
+		AtomicExchange( &context.frameToRun, frame );
+		while( context.numFinished != numThreads ) {
+			YieldSoftwareThread();
+		}
+
+		elapsedTime += mxGetTimeInMicroseconds() - startTime;
+
+		for( UINT32 i = 0; i < numThreads * context.numAllocationsPerThread; i++ )
+		{
+			if( !context.blocks[i] || !CheckBlock( context.blocks[i] ) ) {
+				numErrors++;
+			}
+			if( !allocator ) {
+				mxFreeX( HeapTemp, context.blocks[i] );
+			}
+		}
+
+		if( allocator )
+		{
+			for( UINT32 i = 0; i < NUM_FRAMES_IN_FLIGHT && i < frame; i++ ) {
+				const UINT32 expectedFrame = frame - i;
+				numErrors += ( frameData[ expectedFrame % NUM_FRAMES_IN_FLIGHT ][ FRAME_DATA_SIZE - 1 ] != expectedFrame );
+			}
+			allocator->BeginFrame();
+		}
+	}
+
+	AtomicExchange( &context.frameToRun, -1 );
+	for( UINT32 i = 0; i < numThreads; i++ )
+	{
+		threads[i].thread.Join();
+		threads[i].thread.Shutdown();
+	}
+
+	return elapsedTime;
+}
+
+}//namespace
+
+ERet FrameAllocator_Benchmark( UINT32 numThreads, UINT32 numFrames, UINT32 numAllocationsPerThread )
+{
+	chkRET_X_IF_NOT(numThreads > 0 && numThreads <= MAX_BENCHMARK_THREADS, ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(numFrames > 0 && numAllocationsPerThread > 0, ERR_INVALID_PARAMETER);
+
+	// the blocks are at most 256 bytes, plus the sub-blocks wasted at the end of a frame
+	const UINT32 regionSize = (UINT32) AlignUp( numThreads * numAllocationsPerThread * 256 + (numThreads + 1) * FrameAllocator::SUB_BLOCK_SIZE, mxMEBIBYTE );
+	chkRET_X_IF_NOT(regionSize <= F_GetMaxAllowedAllocationSize(), ERR_INVALID_PARAMETER);
+
+	mxMemoryStatistics	heapStatsBefore;
+	F_GetGlobalMemoryStats( heapStatsBefore );
+
+	FrameBenchmarkContext	context;
+	context.blocks = static_cast< void** >( mxAlloc( numThreads * numAllocationsPerThread * sizeof(void*) ) );
+	context.numAllocationsPerThread = numAllocationsPerThread;
+	chkRET_X_IF_NIL(context.blocks, ERR_OUT_OF_MEMORY);
+
+	FrameAllocator	allocator;
+	mxDO(allocator.Initialize( regionSize, 3, HeapTemp ));
+
+	ptPRINT("Frame allocator benchmark, %u frames, %u threads, %u allocations per thread:\n", numFrames, numThreads, numAllocationsPerThread);
+
+	UINT32 numErrors = 0;
+
+	mxMemoryStatistics	steadyStateBefore;
+	F_GetGlobalMemoryStats( steadyStateBefore );
+
+	context.allocator = &allocator;
+	const UINT64 frameTime = RunFrameBenchmark( context, numThreads, numFrames, numErrors );
+
+	mxMemoryStatistics	steadyStateAfter;
+	F_GetGlobalMemoryStats( steadyStateAfter );
+	if( steadyStateAfter.totalNbAllocations != steadyStateBefore.totalNbAllocations ) {
+		ptWARN("FrameAllocator: %u heap allocations in the steady state.\n", steadyStateAfter.totalNbAllocations - steadyStateBefore.totalNbAllocations);
+		numErrors++;
+	}
+
+	context.allocator = nil;
+	const UINT64 heapTime = RunFrameBenchmark( context, numThreads, numFrames, numErrors );
+
+	const double numAllocations = double(numFrames) * numThreads * numAllocationsPerThread;
+	ptPRINT("frame allocator: %.1f M allocations/s, heaps: %.1f M allocations/s\n",
+		numAllocations / largest( frameTime, 1ull ), numAllocations / largest( heapTime, 1ull ));
+
+	// the allocations that don't fit go to the heap and are freed on retirement
+	{
+		const UINT32 numOverflowBlocks = regionSize / 1024;
+		for( UINT32 i = 0; i < numOverflowBlocks; i++ ) {
+			void* block = allocator.Alloc( 2048 );
+			FillBlock( block, 2048 );
+			numErrors += !CheckBlock( block );
+		}
+		FrameAllocatorStats	stats;
+		allocator.GetStats( stats );
+		if( !stats.numOverflows || stats.highWaterMark < regionSize ) {
+			ptWARN("FrameAllocator: overflows are not reported.\n");
+			numErrors++;
+		}
+		ptPRINT("high-water mark: %u bytes, overflows: %u (%u bytes)\n", stats.highWaterMark, stats.numOverflows, stats.overflowBytes);
+	}
+
+	allocator.Shutdown();
+	mxFree( context.blocks );
+
+	mxMemoryStatistics	heapStatsAfter;
+	F_GetGlobalMemoryStats( heapStatsAfter );
+	if( heapStatsAfter.bytesAllocated != heapStatsBefore.bytesAllocated ) {
+		ptWARN("FrameAllocator: %u bytes leaked.\n", (UINT)(heapStatsAfter.bytesAllocated - heapStatsBefore.bytesAllocated));
+		numErrors++;
+	}
+
+	if( numErrors ) {
+		ptWARN("FrameAllocator: %u errors.\n", numErrors);
+		return ERR_UNKNOWN_ERROR;
+	}
+	return ALL_OK;
+}
+
+/*
+-----------------------------------------------------------------------------
+	AllocationTracker
+-----------------------------------------------------------------------------
+*/
+ERet F_BenchmarkAllocationTracker( const char* captureFileName, UINT32 numThreads, UINT32 numAllocationsPerThread )
+{
+	chkRET_X_IF_NOT(numThreads > 0 && numThreads <= MAX_BENCHMARK_THREADS, ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(numAllocationsPerThread > 0, ERR_INVALID_PARAMETER);
+
+	HandoffQueue* queues = static_cast< HandoffQueue* >( mxAlloc( sizeof(HandoffQueue) * numThreads ) );
+	chkRET_X_IF_NIL(queues, ERR_OUT_OF_MEMORY);
+
+	ptPRINT("Allocation tracker benchmark, %u threads, %u allocations per thread:\n", numThreads, numAllocationsPerThread);
+
+	UINT32 numErrors = 0;
+
+	const UINT64 heapTime = RunBenchmarkThreads( &HeapAllocate, &HeapDeallocate, numThreads, numAllocationsPerThread, queues, numErrors );
+
+	AllocationTrackerSettings	settings;
+	settings.captureFileName = captureFileName;
+	const ERet result = F_StartAllocationTracking( settings );
+	if( mxFAILED(result) ) {
+		mxFree( queues );
+		return result;
+	}
+	const UINT64 trackedTime = RunBenchmarkThreads( &HeapAllocate, &HeapDeallocate, numThreads, numAllocationsPerThread, queues, numErrors );
+	F_StopAllocationTracking();
+
+	mxFree( queues );
+
+	// each allocation and deallocation is an event
+	const double numEvents = 2.0 * numThreads * numAllocationsPerThread;
+	const double nanosecondsPerEvent = double( trackedTime > heapTime ? trackedTime - heapTime : 0 ) * 1000.0 / numEvents * numThreads;
+	ptPRINT("heaps: %.1f M/s, tracked: %.1f M/s (allocations and frees per second), %.0f ns per event\n",
+		numEvents / largest( heapTime, 1ull ), numEvents / largest( trackedTime, 1ull ), nanosecondsPerEvent);
+
+	// e.g. 10000 allocations per 16 ms frame
+	ptPRINT("the overhead is %.2f%% of the frame time at 10000 allocations per frame at 60 Hz\n",
+		nanosecondsPerEvent * 2.0 * 10000 / 16666666.0 * 100.0);
+
+	if( numErrors ) {
+		ptWARN("Allocation tracker: %u errors.\n", numErrors);
+		return ERR_UNKNOWN_ERROR;
+	}
+	return ALL_OK;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
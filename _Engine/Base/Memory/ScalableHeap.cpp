@@ -0,0 +1,852 @@
+/*
+=============================================================================
+	File:	ScalableHeap.cpp
+	Desc:	Thread-caching slab allocator behind the engine memory heaps.
+	Note:	Each thread owns a cache with lists of slabs for every heap and size class,
+			so the owner thread allocates and frees small blocks without any locks.
+			A block freed by another thread is pushed onto the lock-free list of its slab
+			and collected by the owner when it runs out of free blocks.
+			The shared lock is taken only to get/return whole slabs and thread caches,
+			i.e. once per tens or thousands of allocations, regardless of the number of threads.
+=============================================================================
+*/
+#include <Base/Base_PCH.h>
+#pragma hdrstop
+#include <Base/Base.h>
+
+#include <Base/Memory/Tracker/AllocationTracker.h>
+
+namespace
+{
+
+enum
+{
+	MIN_BLOCK_SIZE = 16,	// all blocks are 16-byte aligned
+	MAX_SMALL_BLOCK_SIZE = 32*mxKILOBYTE,	// larger blocks are allocated with F_SysAlloc()
+	NUM_SIZE_CLASSES = 40,
+
+	// slabs for blocks up to 4 KiB are as large as the allocation granularity of VirtualAlloc()
+	SLAB_GRANULARITY_SHIFT = 16,
+	SMALL_SLAB_SIZE = 64*mxKILOBYTE,
+	LARGE_SLAB_SIZE = 256*mxKILOBYTE,
+	MAX_BLOCK_SIZE_IN_SMALL_SLAB = 4*mxKILOBYTE,
+
+	// the owner's data and the data written by other threads are on separate cache lines
+	SLAB_OWNER_DATA_SIZE = 64,
+	SLAB_HEADER_SIZE = 128,
+
+	// empty slabs are kept for reuse, the rest are returned to the system
+	MAX_CACHED_SMALL_SLABS = 64,
+	MAX_CACHED_LARGE_SLABS = 16,
+
+	MAX_OUT_OF_MEMORY_HANDLER_CALLS = 3,
+
+	LARGE_BLOCK_MAGIC = 0x4C524745,	// 'LRGE'
+};
+
+// 16-byte steps up to 128 bytes, then 4 classes for each power of two
+static const UINT16 gs_sizeClasses[ NUM_SIZE_CLASSES ] =
+{
+	16,		32,		48,		64,		80,		96,		112,	128,
+	160,	192,	224,	256,
+	320,	384,	448,	512,
+	640,	768,	896,	1024,
+	1280,	1536,	1792,	2048,
+	2560,	3072,	3584,	4096,
+	5120,	6144,	7168,	8192,
+	10240,	12288,	14336,	16384,
+	20480,	24576,	28672,	32768,
+};
+
+// 0 < numBytes <= MAX_SMALL_BLOCK_SIZE
+static inline UINT32 SizeToClass( size_t numBytes )
+{
+	if( numBytes <= 128 ) {
+		return (UINT32)(numBytes - 1) >> 4;
+	}
+	const UINT32 size = (UINT32)numBytes - 1;
+	const UINT32 log2 = IntegerLog2( size );	// [7..14]
+	const UINT32 quarter = (size >> (log2 - 2)) & 3;
+	return 8 + (log2 - 7) * 4 + quarter;
+}
+
+struct Slab;
+struct ThreadCache;
+
+// marks the slab in the owner's list of full slabs (stored instead of the remote free list)
+static void * const FULL_SLAB_TAG = (void*) 1;
+
+struct SlabOwnerData
+{
+	Slab *			next;	// in the owner's list
+	Slab *			prev;
+	ThreadCache *	owner;
+	void *			freeList;	// blocks freed by the owner thread
+	char *			unused;	// the space that has never been allocated
+	UINT32			blockSize;
+	UINT32			numUsed;	// the number of allocated blocks, including the ones in the remote free list
+	UINT32			slabSize;
+	UINT16			heap;
+	UINT8			sizeClass;
+	bool			inFullList;
+};
+
+struct Slab : SlabOwnerData
+{
+	BYTE			_pad0[ SLAB_OWNER_DATA_SIZE - sizeof(SlabOwnerData) ];
+
+	// blocks freed by other threads, or FULL_SLAB_TAG
+	void * volatile	remoteFreeList;
+	// in the owner's list of full slabs which got blocks back
+	Slab *			nextReturned;
+};
+mxSTATIC_ASSERT(sizeof(Slab) <= SLAB_HEADER_SIZE);
+
+struct SlabList
+{
+	Slab *	partial;	// slabs with free blocks (or unknown), allocations are made from the first one
+	Slab *	full;
+};
+
+struct HeapCounters
+{
+	size_t	totalAllocated;
+	size_t	totalFreed;
+	UINT32	numAllocations;
+	UINT32	numDeallocations;
+};
+
+struct ThreadCacheOwnerData
+{
+	SlabList		bins[ HeapCount ][ NUM_SIZE_CLASSES ];
+	HeapCounters	counters[ HeapCount ];	// written only by the owner thread, summed by F_GetMemoryHeapStats()
+	ThreadCache *	next;	// in the list of all caches
+	ThreadCache *	nextOrphaned;
+};
+
+struct ThreadCache : ThreadCacheOwnerData
+{
+	BYTE			_pad0[ mxCACHE_LINE_SIZE ];
+	// full slabs which got blocks freed by other threads (pushed by those threads)
+	Slab * volatile	returnedSlabs;
+};
+
+struct LargeBlockHeader
+{
+	UINT64	size;	// requested size
+	UINT32	heap;
+	UINT32	magic;
+};
+mxSTATIC_ASSERT(sizeof(LargeBlockHeader) == MIN_BLOCK_SIZE);
+
+// the reserved memory is counted in KiB, so that the 32-bit counters can hold up to 2 TiB
+struct HeapInfo
+{
+	AtomicInt	reservedKiB;	// slabs and large blocks
+	AtomicInt	peakReservedKiB;
+	size_t		budget;	// 0 - unlimited
+	BYTE		_pad0[ mxCACHE_LINE_SIZE - sizeof(AtomicInt)*2 - sizeof(size_t) ];
+};
+
+// zero-initialized before any constructors are run, so the heaps can be used during static initialization
+struct HeapAllocatorData
+{
+	HeapInfo				heaps[ HeapCount ];
+
+	AtomicInt				lock;	// protects the data below
+	Slab *					emptySlabs[2];	// [0] - small slabs, [1] - large slabs
+	UINT32					numEmptySlabs[2];
+	ThreadCache *			caches;	// all thread caches
+	ThreadCache *			orphanedCaches;	// caches of exited threads waiting for adoption
+
+	F_OutOfMemoryHandler *	outOfMemoryHandler;
+	void *					outOfMemoryUserData;
+};
+static HeapAllocatorData	gs_heapData;
+
+static mxTHREAD_LOCAL ThreadCache *	gs_threadCache = nil;
+
+/*
+-----------------------------------------------------------------------------
+	The page map finds the slab of a memory block.
+	Slabs are aligned by 64 KiB, large blocks are not in the map.
+-----------------------------------------------------------------------------
+*/
+#if mxARCH_TYPE == mxARCH_32BIT
+
+static Slab *	gs_pageMap[ 1 << (32 - SLAB_GRANULARITY_SHIFT) ];
+
+static inline Slab* PageMap_Find( const void* pointer )
+{
+	return gs_pageMap[ (size_t)pointer >> SLAB_GRANULARITY_SHIFT ];
+}
+
+// must be called under the lock
+static bool PageMap_Set( const void* start, size_t size, Slab* slab )
+{
+	const size_t first = (size_t)start >> SLAB_GRANULARITY_SHIFT;
+	const size_t count = size >> SLAB_GRANULARITY_SHIFT;
+	for( size_t i = 0; i < count; i++ ) {
+		gs_pageMap[ first + i ] = slab;
+	}
+	return true;
+}
+
+#else
+
+// two-level map covering 48-bit addresses
+enum { PAGE_MAP_LEAF_BITS = 16, PAGE_MAP_ROOT_BITS = 48 - SLAB_GRANULARITY_SHIFT - PAGE_MAP_LEAF_BITS };
+
+static Slab **	gs_pageMap[ 1 << PAGE_MAP_ROOT_BITS ];
+
+static inline Slab* PageMap_Find( const void* pointer )
+{
+	const size_t index = (size_t)pointer >> SLAB_GRANULARITY_SHIFT;
+	Slab** leaf = gs_pageMap[ (index >> PAGE_MAP_LEAF_BITS) & ((1 << PAGE_MAP_ROOT_BITS) - 1) ];
+	return leaf ? leaf[ index & ((1 << PAGE_MAP_LEAF_BITS) - 1) ] : nil;
+}
+
+static void* OS_AllocatePages( size_t size );
+
+// must be called under the lock
+static bool PageMap_Set( const void* start, size_t size, Slab* slab )
+{
+	const size_t first = (size_t)start >> SLAB_GRANULARITY_SHIFT;
+	const size_t count = size >> SLAB_GRANULARITY_SHIFT;
+	for( size_t i = 0; i < count; i++ )
+	{
+		const size_t index = first + i;
+		Slab **& leaf = gs_pageMap[ index >> PAGE_MAP_LEAF_BITS ];
+		if( !leaf ) {
+			if( !slab ) {
+				continue;
+			}
+			leaf = (Slab**) OS_AllocatePages( sizeof(Slab*) << PAGE_MAP_LEAF_BITS );
+			if( !leaf ) {
+				return false;
+			}
+		}
+		leaf[ index & ((1 << PAGE_MAP_LEAF_BITS) - 1) ] = slab;
+	}
+	return true;
+}
+
+#endif
+
+// returns zero-filled memory aligned by 64 KiB
+static void* OS_AllocatePages( size_t size )
+{
+	return ::VirtualAlloc( nil, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE );
+}
+
+static void OS_FreePages( void* pointer )
+{
+	::VirtualFree( pointer, 0, MEM_RELEASE );
+}
+
+/*
+-----------------------------------------------------------------------------
+	Budgets and out-of-memory handling
+-----------------------------------------------------------------------------
+*/
+static bool CallOutOfMemoryHandler( EMemHeap heap, size_t numBytes, UINT attempt )
+{
+	F_OutOfMemoryHandler* handler = gs_heapData.outOfMemoryHandler;
+	return handler && attempt < MAX_OUT_OF_MEMORY_HANDLER_CALLS
+		&& (*handler)( heap, numBytes, gs_heapData.outOfMemoryUserData );
+}
+
+// rounds up, the same size is always converted to the same number of KiB
+static inline int SizeInKiB( size_t numBytes )
+{
+	return (int)( (numBytes + mxKIBIBYTE - 1) / mxKIBIBYTE );
+}
+
+static bool ReserveMemory( EMemHeap heap, size_t numBytes )
+{
+	HeapInfo & info = gs_heapData.heaps[ heap ];
+	const int numKiB = SizeInKiB( numBytes );
+	for( UINT attempt = 0; ; attempt++ )
+	{
+		const int reservedKiB = AtomicAdd( info.reservedKiB, numKiB );
+		if( !info.budget || (UINT64)(ULONG)reservedKiB * mxKIBIBYTE <= info.budget )
+		{
+			AtomicInt peak = info.peakReservedKiB;
+			while( (ULONG)reservedKiB > (ULONG)peak && !AtomicCAS( &info.peakReservedKiB, peak, reservedKiB ) ) {
+				peak = info.peakReservedKiB;
+			}
+			return true;
+		}
+		AtomicAdd( info.reservedKiB, -numKiB );
+
+		if( !CallOutOfMemoryHandler( heap, numBytes, attempt ) )
+		{
+			ptERROR("Memory heap '%s' exceeded its budget (%u bytes) when allocating %u bytes\n",
+				mxGetMemoryHeapName( heap ), (UINT)info.budget, (UINT)numBytes);
+			return false;
+		}
+	}
+}
+
+static void UnreserveMemory( EMemHeap heap, size_t numBytes )
+{
+	AtomicAdd( gs_heapData.heaps[ heap ].reservedKiB, -SizeInKiB( numBytes ) );
+}
+
+/*
+-----------------------------------------------------------------------------
+	Slabs
+-----------------------------------------------------------------------------
+*/
+static inline void List_Add( Slab *& head, Slab* slab )
+{
+	slab->prev = nil;
+	slab->next = head;
+	if( head ) {
+		head->prev = slab;
+	}
+	head = slab;
+}
+
+static inline void List_Remove( Slab *& head, Slab* slab )
+{
+	if( slab->prev ) {
+		slab->prev->next = slab->next;
+	} else {
+		head = slab->next;
+	}
+	if( slab->next ) {
+		slab->next->prev = slab->prev;
+	}
+	slab->next = nil;
+	slab->prev = nil;
+}
+
+static Slab* AcquireSlab( ThreadCache* cache, EMemHeap heap, UINT32 sizeClass )
+{
+	const UINT32 blockSize = gs_sizeClasses[ sizeClass ];
+	const UINT32 kind = (blockSize > MAX_BLOCK_SIZE_IN_SMALL_SLAB);
+	const UINT32 slabSize = kind ? LARGE_SLAB_SIZE : SMALL_SLAB_SIZE;
+
+	if( !ReserveMemory( heap, slabSize ) ) {
+		return nil;
+	}
+
+	Slab* slab = nil;
+	{
+		AtomicLock	lock( &gs_heapData.lock );
+		slab = gs_heapData.emptySlabs[ kind ];
+		if( slab ) {
+			gs_heapData.emptySlabs[ kind ] = slab->next;
+			gs_heapData.numEmptySlabs[ kind ]--;
+		}
+	}
+
+	for( UINT attempt = 0; !slab; attempt++ )
+	{
+		void* pages = OS_AllocatePages( slabSize );
+		if( pages )
+		{
+			AtomicLock	lock( &gs_heapData.lock );
+			if( PageMap_Set( pages, slabSize, (Slab*) pages ) ) {
+				slab = (Slab*) pages;
+				break;
+			}
+			PageMap_Set( pages, slabSize, nil );
+			OS_FreePages( pages );
+		}
+		if( !CallOutOfMemoryHandler( heap, slabSize, attempt ) )
+		{
+			UnreserveMemory( heap, slabSize );
+			ptERROR("Out of memory: failed to allocate %u bytes for heap '%s'\n",
+				slabSize, mxGetMemoryHeapName( heap ));
+			return nil;
+		}
+	}
+
+	slab->next = nil;
+	slab->prev = nil;
+	slab->owner = cache;
+	slab->freeList = nil;
+	slab->unused = (char*)slab + SLAB_HEADER_SIZE;
+	slab->blockSize = blockSize;
+	slab->numUsed = 0;
+	slab->slabSize = slabSize;
+	slab->heap = heap;
+	slab->sizeClass = sizeClass;
+	slab->inFullList = false;
+	slab->remoteFreeList = nil;
+	slab->nextReturned = nil;
+	return slab;
+}
+
+static void ReleaseSlab( Slab* slab )
+{
+	mxASSERT(slab->numUsed == 0 && !slab->inFullList);
+	UnreserveMemory( (EMemHeap)slab->heap, slab->slabSize );
+
+	const UINT32 kind = (slab->slabSize == LARGE_SLAB_SIZE);
+	const UINT32 maxCachedSlabs = kind ? MAX_CACHED_LARGE_SLABS : MAX_CACHED_SMALL_SLABS;
+	{
+		AtomicLock	lock( &gs_heapData.lock );
+		if( gs_heapData.numEmptySlabs[ kind ] < maxCachedSlabs )
+		{
+			slab->next = gs_heapData.emptySlabs[ kind ];
+			gs_heapData.emptySlabs[ kind ] = slab;
+			gs_heapData.numEmptySlabs[ kind ]++;
+			return;
+		}
+		PageMap_Set( slab, slab->slabSize, nil );
+	}
+	OS_FreePages( slab );
+}
+
+// moves the blocks freed by other threads to the slab's free list, returns true if there were any
+static bool CollectRemoteFrees( Slab* slab )
+{
+	mxASSERT(!slab->inFullList);
+	if( !slab->remoteFreeList ) {
+		return false;
+	}
+	void* block = AtomicExchangePointer( &slab->remoteFreeList, nil );
+	while( block )
+	{
+		void* next = *(void**) block;
+		*(void**) block = slab->freeList;
+		slab->freeList = block;
+		slab->numUsed--;
+		block = next;
+	}
+	return true;
+}
+
+// tries to move the exhausted slab to the list of full slabs,
+// returns false if other threads have freed some blocks in the meantime
+static bool MoveToFullList( SlabList& bin, Slab* slab )
+{
+	if( AtomicCompareExchangePointer( &slab->remoteFreeList, nil, FULL_SLAB_TAG ) != nil ) {
+		return false;
+	}
+	List_Remove( bin.partial, slab );
+	List_Add( bin.full, slab );
+	slab->inFullList = true;
+	return true;
+}
+
+static void MoveToPartialList( ThreadCache* cache, Slab* slab )
+{
+	SlabList & bin = cache->bins[ slab->heap ][ slab->sizeClass ];
+	List_Remove( bin.full, slab );
+	// put it after the first slab which is likely to be used right now
+	if( bin.partial ) {
+		slab->prev = bin.partial;
+		slab->next = bin.partial->next;
+		if( slab->next ) {
+			slab->next->prev = slab;
+		}
+		bin.partial->next = slab;
+	} else {
+		bin.partial = slab;
+	}
+	slab->inFullList = false;
+}
+
+// moves the full slabs which got blocks freed by other threads back to the partial lists
+static void CollectReturnedSlabs( ThreadCache* cache )
+{
+	if( !cache->returnedSlabs ) {
+		return;
+	}
+	Slab* slab = (Slab*) AtomicExchangePointer( (void* volatile*) &cache->returnedSlabs, nil );
+	while( slab )
+	{
+		Slab* next = slab->nextReturned;
+		MoveToPartialList( cache, slab );
+		slab = next;
+	}
+}
+
+static inline void* AllocateFromSlab( Slab* slab )
+{
+	void* block = slab->freeList;
+	if( block ) {
+		slab->freeList = *(void**) block;
+	}
+	else if( slab->unused + slab->blockSize <= (char*)slab + slab->slabSize ) {
+		block = slab->unused;
+		slab->unused += slab->blockSize;
+	}
+	else {
+		return nil;
+	}
+	slab->numUsed++;
+	return block;
+}
+
+static void* AllocateSlow( ThreadCache* cache, EMemHeap heap, UINT32 sizeClass )
+{
+	SlabList & bin = cache->bins[ heap ][ sizeClass ];
+
+	CollectReturnedSlabs( cache );
+
+	while( Slab* slab = bin.partial )
+	{
+		CollectRemoteFrees( slab );
+		void* block = AllocateFromSlab( slab );
+		if( block ) {
+			return block;
+		}
+		MoveToFullList( bin, slab );
+	}
+
+	Slab* slab = AcquireSlab( cache, heap, sizeClass );
+	if( !slab ) {
+		return nil;
+	}
+	List_Add( bin.partial, slab );
+	return AllocateFromSlab( slab );
+}
+
+static void FreeToOwnSlab( ThreadCache* cache, Slab* slab, void* block )
+{
+	*(void**) block = slab->freeList;
+	slab->freeList = block;
+	slab->numUsed--;
+
+	SlabList & bin = cache->bins[ slab->heap ][ slab->sizeClass ];
+
+	if( slab->inFullList )
+	{
+		// if another thread has already claimed the slab, it will be returned via CollectReturnedSlabs()
+		if( AtomicCompareExchangePointer( &slab->remoteFreeList, FULL_SLAB_TAG, nil ) == FULL_SLAB_TAG ) {
+			MoveToPartialList( cache, slab );
+		}
+		return;
+	}
+
+	// keep the last slab to avoid thrashing
+	if( slab->numUsed == 0 && (slab->prev || slab->next) ) {
+		List_Remove( bin.partial, slab );
+		ReleaseSlab( slab );
+	}
+}
+
+static void FreeToRemoteSlab( Slab* slab, void* block )
+{
+	// 'slab' stays alive until the block is pushed, because it's counted in 'numUsed'
+	bool claimedFullSlab;
+	void* head;
+	do
+	{
+		head = slab->remoteFreeList;
+		claimedFullSlab = (head == FULL_SLAB_TAG);
+		*(void**) block = claimedFullSlab ? nil : head;
+	}
+	while( AtomicCompareExchangePointer( &slab->remoteFreeList, head, block ) != head );
+
+	// the slab was in the owner's list of full slabs, tell the owner that it can be used again;
+	// the owner doesn't release the slab until it gets it from the list of returned slabs
+	if( claimedFullSlab )
+	{
+		ThreadCache* owner = slab->owner;
+		Slab* first;
+		do
+		{
+			first = owner->returnedSlabs;
+			slab->nextReturned = first;
+		}
+		while( AtomicCompareExchangePointer( (void* volatile*) &owner->returnedSlabs, first, slab ) != first );
+	}
+}
+
+/*
+-----------------------------------------------------------------------------
+	Thread caches
+-----------------------------------------------------------------------------
+*/
+// returns the empty slabs of the cache to the shared pool
+static void ReleaseEmptySlabs( ThreadCache* cache )
+{
+	CollectReturnedSlabs( cache );
+
+	for( UINT heap = 0; heap < HeapCount; heap++ )
+	{
+		for( UINT sizeClass = 0; sizeClass < NUM_SIZE_CLASSES; sizeClass++ )
+		{
+			SlabList & bin = cache->bins[ heap ][ sizeClass ];
+			Slab* slab = bin.partial;
+			while( slab )
+			{
+				Slab* next = slab->next;
+				CollectRemoteFrees( slab );
+				if( slab->numUsed == 0 ) {
+					List_Remove( bin.partial, slab );
+					ReleaseSlab( slab );
+				}
+				slab = next;
+			}
+		}
+	}
+}
+
+static ThreadCache* CreateThreadCache()
+{
+	ThreadCache* cache = nil;
+	{
+		AtomicLock	lock( &gs_heapData.lock );
+		cache = gs_heapData.orphanedCaches;
+		if( cache ) {
+			gs_heapData.orphanedCaches = cache->nextOrphaned;
+			cache->nextOrphaned = nil;
+		}
+	}
+	if( cache )
+	{
+		// the blocks freed by other threads since the previous owner exited
+		ReleaseEmptySlabs( cache );
+	}
+	else
+	{
+		// not from the heaps to avoid recursion, the memory is zero-filled
+		cache = (ThreadCache*) OS_AllocatePages( sizeof(ThreadCache) );
+		if( !cache ) {
+			ptERROR("Out of memory: failed to create a thread memory cache\n");
+			return nil;
+		}
+		AtomicLock	lock( &gs_heapData.lock );
+		cache->next = gs_heapData.caches;
+		gs_heapData.caches = cache;
+	}
+	gs_threadCache = cache;
+	return cache;
+}
+
+static inline ThreadCache* GetThreadCache()
+{
+	ThreadCache* cache = gs_threadCache;
+	return cache ? cache : CreateThreadCache();
+}
+
+/*
+-----------------------------------------------------------------------------
+	Large blocks
+-----------------------------------------------------------------------------
+*/
+static void* AllocateLargeBlock( ThreadCache* cache, EMemHeap heap, size_t numBytes )
+{
+	const size_t totalSize = numBytes + sizeof(LargeBlockHeader);
+	if( !ReserveMemory( heap, totalSize ) ) {
+		return nil;
+	}
+	LargeBlockHeader* header = (LargeBlockHeader*) F_SysAlloc( totalSize );
+	if( !header ) {
+		UnreserveMemory( heap, totalSize );
+		return nil;
+	}
+	header->size = numBytes;
+	header->heap = heap;
+	header->magic = LARGE_BLOCK_MAGIC;
+
+	HeapCounters & counters = cache->counters[ heap ];
+	counters.totalAllocated += numBytes;
+	counters.numAllocations++;
+
+	return header + 1;
+}
+
+static void FreeLargeBlock( ThreadCache* cache, const void* pointer )
+{
+	const LargeBlockHeader* header = (const LargeBlockHeader*) pointer - 1;
+	mxASSERT2(header->magic == LARGE_BLOCK_MAGIC, "the memory block was not allocated by mxAllocX()");
+
+	const EMemHeap heap = (EMemHeap) header->heap;
+	const size_t numBytes = (size_t) header->size;
+
+	if( cache )
+	{
+		HeapCounters & counters = cache->counters[ heap ];
+		counters.totalFreed += numBytes;
+		counters.numDeallocations++;
+	}
+
+	F_SysFree( header );
+	UnreserveMemory( heap, numBytes + sizeof(LargeBlockHeader) );
+}
+
+}//namespace
+
+/*
+-----------------------------------------------------------------------------
+	Public interface
+-----------------------------------------------------------------------------
+*/
+static void* AllocateBlock( EMemHeap heap, size_t numBytes )
+{
+	mxASSERT(heap < HeapCount);
+
+	ThreadCache* cache = GetThreadCache();
+	if( !cache ) {
+		return nil;
+	}
+	if( numBytes > MAX_SMALL_BLOCK_SIZE ) {
+		return AllocateLargeBlock( cache, heap, numBytes );
+	}
+
+	const UINT32 sizeClass = SizeToClass( numBytes ? numBytes : 1 );
+
+	Slab* slab = cache->bins[ heap ][ sizeClass ].partial;
+	void* block = slab ? AllocateFromSlab( slab ) : nil;
+	if( !block ) {
+		block = AllocateSlow( cache, heap, sizeClass );
+		if( !block ) {
+			return nil;
+		}
+	}
+
+	HeapCounters & counters = cache->counters[ heap ];
+	counters.totalAllocated += gs_sizeClasses[ sizeClass ];
+	counters.numAllocations++;
+
+	return block;
+}
+
+void* mxAllocX( EMemHeap heap, size_t numBytes )
+{
+	void* block = AllocateBlock( heap, numBytes );
+#if MX_ENABLE_ALLOCATION_TRACKER
+	if( g_allocationTrackingEnabled && block ) {
+		F_TrackAllocation( heap, block, numBytes );
+	}
+#endif // MX_ENABLE_ALLOCATION_TRACKER
+	return block;
+}
+
+void mxFreeX( EMemHeap heap, const void* pointer )
+{
+	(void)heap;
+
+	// deleting null pointer is valid in ANSI C++
+	if( !pointer ) {
+		return;
+	}
+
+#if MX_ENABLE_ALLOCATION_TRACKER
+	// recorded before the block can be reused by another thread
+	if( g_allocationTrackingEnabled ) {
+		F_TrackDeallocation( pointer );
+	}
+#endif // MX_ENABLE_ALLOCATION_TRACKER
+
+	ThreadCache* cache = GetThreadCache();
+
+	Slab* slab = PageMap_Find( pointer );
+	if( !slab ) {
+		FreeLargeBlock( cache, pointer );
+		return;
+	}
+
+	mxASSERT(((char*)pointer - ((char*)slab + SLAB_HEADER_SIZE)) % slab->blockSize == 0);
+
+	if( cache )
+	{
+		HeapCounters & counters = cache->counters[ slab->heap ];
+		counters.totalFreed += slab->blockSize;
+		counters.numDeallocations++;
+	}
+
+	if( slab->owner == cache ) {
+		FreeToOwnSlab( cache, slab, (void*) pointer );
+	} else {
+		FreeToRemoteSlab( slab, (void*) pointer );
+	}
+}
+
+size_t mxGetAllocationSize( const void* pointer )
+{
+	if( !pointer ) {
+		return 0;
+	}
+	const Slab* slab = PageMap_Find( pointer );
+	if( slab ) {
+		return slab->blockSize;
+	}
+	const LargeBlockHeader* header = (const LargeBlockHeader*) pointer - 1;
+	mxASSERT(header->magic == LARGE_BLOCK_MAGIC);
+	return (size_t) header->size;
+}
+
+void F_SetMemoryHeapBudget( EMemHeap heap, size_t maxBytes )
+{
+	mxASSERT(heap < HeapCount);
+	gs_heapData.heaps[ heap ].budget = maxBytes;
+}
+
+size_t F_GetMemoryHeapBudget( EMemHeap heap )
+{
+	mxASSERT(heap < HeapCount);
+	return gs_heapData.heaps[ heap ].budget;
+}
+
+void F_SetOutOfMemoryHandler( F_OutOfMemoryHandler* handler, void* userData )
+{
+	AtomicLock	lock( &gs_heapData.lock );
+	gs_heapData.outOfMemoryHandler = handler;
+	gs_heapData.outOfMemoryUserData = userData;
+}
+
+void F_GetMemoryHeapStats( EMemHeap heap, mxMemoryStatistics &outStats )
+{
+	mxASSERT(heap < HeapCount);
+	outStats.Reset();
+
+	{
+		AtomicLock	lock( &gs_heapData.lock );
+		for( const ThreadCache* cache = gs_heapData.caches; cache; cache = cache->next )
+		{
+			const HeapCounters& counters = cache->counters[ heap ];
+			outStats.totalAllocated += counters.totalAllocated;
+			outStats.totalFreed += counters.totalFreed;
+			outStats.totalNbAllocations += counters.numAllocations;
+			outStats.totalNbDeallocations += counters.numDeallocations;
+		}
+	}
+	outStats.bytesAllocated = outStats.totalAllocated - outStats.totalFreed;
+
+	const HeapInfo& info = gs_heapData.heaps[ heap ];
+	outStats.bytesReserved = (size_t)( (UINT64)(ULONG) info.reservedKiB * mxKIBIBYTE );
+	outStats.peakMemoryUsage = (size_t)( (UINT64)(ULONG) info.peakReservedKiB * mxKIBIBYTE );
+}
+
+void F_ReleaseThreadHeapCache()
+{
+#if MX_ENABLE_ALLOCATION_TRACKER
+	F_FlushThreadAllocationEvents();
+#endif // MX_ENABLE_ALLOCATION_TRACKER
+
+	ThreadCache* cache = gs_threadCache;
+	if( !cache ) {
+		return;
+	}
+
+	gs_threadCache = nil;
+
+	// the caches of exited threads might have got their blocks back since then
+	{
+		AtomicLock	lock( &gs_heapData.lock );
+		cache->nextOrphaned = gs_heapData.orphanedCaches;
+		gs_heapData.orphanedCaches = nil;
+	}
+	ThreadCache* last = cache;
+	for( ThreadCache* orphaned = cache; orphaned; orphaned = orphaned->nextOrphaned ) {
+		ReleaseEmptySlabs( orphaned );
+		last = orphaned;
+	}
+
+	AtomicLock	lock( &gs_heapData.lock );
+	last->nextOrphaned = gs_heapData.orphanedCaches;
+	gs_heapData.orphanedCaches = cache;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
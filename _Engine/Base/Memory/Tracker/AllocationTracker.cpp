@@ -0,0 +1,572 @@
+/*
+=============================================================================
+	File:	AllocationTracker.cpp
+	Desc:	Records the events of the engine heaps into a capture file.
+	Note:	The recording threads don't take any locks except when their buffer is full
+			or when they meet a new callstack, the file is written by a background thread.
+=============================================================================
+*/
+#include <Base/Base_PCH.h>
+#pragma hdrstop
+#include <Base/Base.h>
+
+#include <intrin.h>
+#include <TlHelp32.h>
+
+#include <Base/Memory/Tracker/AllocationTracker.h>
+
+#if MX_ENABLE_ALLOCATION_TRACKER
+
+AtomicInt	g_allocationTrackingEnabled = 0;
+
+namespace
+{
+
+enum
+{
+	EVENTS_PER_BUFFER = 2048,	// 64 KiB
+	CALLSTACK_CHUNK_SIZE = 64*mxKILOBYTE,
+
+	// the hashes of the recorded callstacks (open addressing, 0 - empty slot)
+	CALLSTACK_TABLE_SIZE = 1<<18,
+	MAX_CALLSTACK_PROBES = 64,
+
+	// FramesToSkip + FramesToCapture must be less than 63 on Windows XP
+	MAX_CALLSTACK_DEPTH = 48,
+	MAX_SKIPPED_FRAMES = 8,
+	INTERNAL_SKIPPED_FRAMES = 2,	// F_TrackAllocation() and mxAllocX()
+
+	MAX_MODULES = 256,
+	WRITER_SLEEP_MSEC = 10,
+};
+
+struct EventBuffer
+{
+	EventBuffer *			next;
+	AllocationEventsHeader	header;
+	AllocationEvent			events[ EVENTS_PER_BUFFER ];
+};
+
+// each thread which touches the heaps while tracking is enabled gets one, they are never freed
+struct ThreadState
+{
+	ThreadState *	next;	// in the list of all threads
+	EventBuffer *	buffer;	// the buffer being filled
+	AtomicInt		busy;	// 1 while the thread is recording an event
+	UINT32			threadId;
+};
+
+struct CallstackChunk
+{
+	CallstackChunk *	next;
+	size_t				used;	// keeps the data 8-byte aligned
+	BYTE				data[ CALLSTACK_CHUNK_SIZE ];
+};
+
+struct TrackerData
+{
+	UINT32				maxCallstackDepth;
+	UINT32				numSkippedFrames;
+	volatile UINT32		frameNumber;
+	UINT32				firstFrame;
+	AtomicInt *			callstackHashes;
+	AtomicInt			numLostEvents;
+	AtomicInt			numLostCallstacks;
+
+	// protects the lists below
+	AtomicInt			lock;
+	ThreadState *		threads;
+	EventBuffer *		freeBuffers;
+	EventBuffer *		fullBuffersHead;	// FIFO, so that the events of each thread are written in order
+	EventBuffer *		fullBuffersTail;
+	CallstackChunk *	callstacksHead;
+	CallstackChunk *	callstacksTail;	// the chunk being filled
+
+	// used by the writer thread
+	FileWriter			file;
+	Thread				writerThread;
+	volatile bool		stopWriter;
+	bool				writeFailed;
+
+	UINT64				startTicks;
+	UINT64				startTime;	// in microseconds
+};
+
+TrackerData					gs_tracker;
+mxTHREAD_LOCAL ThreadState*	gs_threadState = nil;
+
+ThreadState* RegisterThread()
+{
+	ThreadState* state = reinterpret_cast< ThreadState* >( F_SysAlloc( sizeof(ThreadState) ) );
+	if( !state ) {
+		return nil;
+	}
+	state->buffer = nil;
+	state->busy = 0;
+	state->threadId = ptGetCurrentThreadID();
+
+	{
+		AtomicLock	lock( &gs_tracker.lock );
+		state->next = gs_tracker.threads;
+		gs_tracker.threads = state;
+	}
+
+	gs_threadState = state;
+	return state;
+}
+
+// must be called under the lock
+void SubmitBuffer_NoLock( EventBuffer* buffer )
+{
+	buffer->next = nil;
+	if( gs_tracker.fullBuffersTail ) {
+		gs_tracker.fullBuffersTail->next = buffer;
+	} else {
+		gs_tracker.fullBuffersHead = buffer;
+	}
+	gs_tracker.fullBuffersTail = buffer;
+}
+
+// submits the full buffer of the thread and gives it an empty one
+EventBuffer* SwapBuffer( ThreadState* state )
+{
+	EventBuffer* buffer = nil;
+	{
+		AtomicLock	lock( &gs_tracker.lock );
+		if( state->buffer ) {
+			SubmitBuffer_NoLock( state->buffer );
+			state->buffer = nil;
+		}
+		buffer = gs_tracker.freeBuffers;
+		if( buffer ) {
+			gs_tracker.freeBuffers = buffer->next;
+		}
+	}
+	if( !buffer ) {
+		buffer = reinterpret_cast< EventBuffer* >( F_SysAlloc( sizeof(EventBuffer) ) );
+		if( !buffer ) {
+			return nil;
+		}
+	}
+	buffer->header.threadId = state->threadId;
+	buffer->header.numEvents = 0;
+	state->buffer = buffer;
+	return buffer;
+}
+
+// the first thread which meets a callstack adds it to the capture
+void RegisterCallstack( UINT32 hash, void* const* frames, UINT32 depth )
+{
+	const UINT32 mask = CALLSTACK_TABLE_SIZE - 1;
+	UINT32 index = hash & mask;
+	for( UINT32 probe = 0; probe < MAX_CALLSTACK_PROBES; probe++ )
+	{
+		AtomicInt & slot = gs_tracker.callstackHashes[ index ];
+		const UINT32 existing = (UINT32) slot;
+		if( existing == hash ) {
+			return;
+		}
+		if( !existing )
+		{
+			if( !AtomicCAS( &slot, 0, (int)hash ) ) {
+				probe--;	// re-check the slot taken by another thread
+				continue;
+			}
+
+			const UINT32 recordSize = sizeof(UINT32) * 2 + depth * sizeof(UINT64);
+
+			AtomicLock	lock( &gs_tracker.lock );
+
+			CallstackChunk* chunk = gs_tracker.callstacksTail;
+			if( !chunk || chunk->used + recordSize > CALLSTACK_CHUNK_SIZE )
+			{
+				chunk = reinterpret_cast< CallstackChunk* >( F_SysAlloc( sizeof(CallstackChunk) ) );
+				if( !chunk ) {
+					AtomicIncrement( gs_tracker.numLostCallstacks );
+					return;
+				}
+				chunk->next = nil;
+				chunk->used = 0;
+				if( gs_tracker.callstacksTail ) {
+					gs_tracker.callstacksTail->next = chunk;
+				} else {
+					gs_tracker.callstacksHead = chunk;
+				}
+				gs_tracker.callstacksTail = chunk;
+			}
+
+			UINT32* header = reinterpret_cast< UINT32* >( chunk->data + chunk->used );
+			header[0] = hash;
+			header[1] = depth;
+			UINT64* addresses = reinterpret_cast< UINT64* >( header + 2 );
+			for( UINT32 i = 0; i < depth; i++ ) {
+				addresses[i] = (UINT_PTR) frames[i];
+			}
+			chunk->used += recordSize;
+			return;
+		}
+		index = (index + 1) & mask;
+	}
+	AtomicIncrement( gs_tracker.numLostCallstacks );
+}
+
+// returns nil if the event cannot be recorded, must be called between BeginRecording() and EndRecording()
+mxFORCEINLINE AllocationEvent* AllocateEvent( ThreadState* state )
+{
+	EventBuffer* buffer = state->buffer;
+	if( !buffer || buffer->header.numEvents == EVENTS_PER_BUFFER )
+	{
+		buffer = SwapBuffer( state );
+		if( !buffer ) {
+			AtomicIncrement( gs_tracker.numLostEvents );
+			return nil;
+		}
+	}
+	return &buffer->events[ buffer->header.numEvents++ ];
+}
+
+// returns nil if tracking is disabled
+mxFORCEINLINE ThreadState* BeginRecording()
+{
+	ThreadState* state = gs_threadState;
+	if( !state ) {
+		state = RegisterThread();
+		if( !state ) {
+			AtomicIncrement( gs_tracker.numLostEvents );
+			return nil;
+		}
+	}
+	// the full barrier orders the write with the read of the flag,
+	// F_StopAllocationTracking() clears the flag and then waits for busy threads
+	AtomicExchange( &state->busy, 1 );
+	if( !g_allocationTrackingEnabled ) {
+		state->busy = 0;
+		return nil;
+	}
+	return state;
+}
+
+mxFORCEINLINE void EndRecording( ThreadState* state )
+{
+	_WriteBarrier();
+	state->busy = 0;
+}
+
+//---------------------------------------------------------------------------
+
+void WriteChunk( EAllocationChunkType type, const void* data, UINT32 size, const void* data2 = nil, UINT32 size2 = 0 )
+{
+	if( gs_tracker.writeFailed ) {
+		return;
+	}
+	AllocationChunkHeader	header;
+	header.type = type;
+	header.size = size + size2;
+	if( mxFAILED(gs_tracker.file.Write( &header, sizeof(header) ))
+		|| mxFAILED(gs_tracker.file.Write( data, size ))
+		|| (size2 && mxFAILED(gs_tracker.file.Write( data2, size2 ))) )
+	{
+		ptWARN("Failed to write the allocation capture, tracking stopped.\n");
+		gs_tracker.writeFailed = true;
+		AtomicExchange( &g_allocationTrackingEnabled, 0 );
+	}
+}
+
+void WriteModules()
+{
+	HANDLE snapshot = ::CreateToolhelp32Snapshot( TH32CS_SNAPMODULE, 0 );
+	if( snapshot == INVALID_HANDLE_VALUE ) {
+		return;
+	}
+
+	AllocationCaptureModule	modules[ MAX_MODULES ];
+	UINT32 numModules = 0;
+
+	MODULEENTRY32	entry;
+	entry.dwSize = sizeof(entry);
+	for( BOOL ok = ::Module32First( snapshot, &entry ); ok && numModules < MAX_MODULES; ok = ::Module32Next( snapshot, &entry ) )
+	{
+		AllocationCaptureModule & module = modules[ numModules++ ];
+		mxZERO_OUT(module);
+		module.baseAddress = (UINT_PTR) entry.modBaseAddr;
+		module.size = entry.modBaseSize;
+#ifdef UNICODE
+		::WideCharToMultiByte( CP_ACP, 0, entry.szExePath, -1, module.path, mxCOUNT_OF(module.path) - 1, nil, nil );
+#else
+		strncpy( module.path, entry.szExePath, mxCOUNT_OF(module.path) - 1 );
+#endif
+	}
+	::CloseHandle( snapshot );
+
+	WriteChunk( AllocationChunk_Modules, modules, numModules * sizeof(modules[0]) );
+}
+
+void WritePendingData()
+{
+	CallstackChunk* callstacks;
+	EventBuffer* buffers;
+	{
+		AtomicLock	lock( &gs_tracker.lock );
+		callstacks = gs_tracker.callstacksHead;
+		gs_tracker.callstacksHead = nil;
+		gs_tracker.callstacksTail = nil;
+		buffers = gs_tracker.fullBuffersHead;
+		gs_tracker.fullBuffersHead = nil;
+		gs_tracker.fullBuffersTail = nil;
+	}
+
+	// the callstacks go first, so that the report can resolve them when reading the events
+	while( callstacks )
+	{
+		CallstackChunk* next = callstacks->next;
+		WriteChunk( AllocationChunk_Callstacks, callstacks->data, (UINT32) callstacks->used );
+		F_SysFree( callstacks );
+		callstacks = next;
+	}
+
+	EventBuffer* lastBuffer = nil;
+	for( EventBuffer* buffer = buffers; buffer; buffer = buffer->next )
+	{
+		WriteChunk( AllocationChunk_Events, &buffer->header, sizeof(buffer->header),
+			buffer->events, buffer->header.numEvents * sizeof(buffer->events[0]) );
+		lastBuffer = buffer;
+	}
+
+	if( lastBuffer )
+	{
+		AtomicLock	lock( &gs_tracker.lock );
+		lastBuffer->next = gs_tracker.freeBuffers;
+		gs_tracker.freeBuffers = buffers;
+	}
+}
+
+UINT32 PASCAL WriterThreadFunction( void* )
+{
+	for(;;)
+	{
+		const bool stop = gs_tracker.stopWriter;
+		WritePendingData();
+		if( stop ) {
+			break;
+		}
+		mxSleepMilliseconds( WRITER_SLEEP_MSEC );
+	}
+	return 0;
+}
+
+}//namespace
+
+/*
+--------------------------------------------------------------
+	Recording
+--------------------------------------------------------------
+*/
+mxNO_INLINE void F_TrackAllocation( EMemHeap heap, const void* block, size_t numBytes )
+{
+	ThreadState* state = BeginRecording();
+	if( !state ) {
+		return;
+	}
+
+	void* frames[ MAX_CALLSTACK_DEPTH ];
+	const UINT32 depth = ::RtlCaptureStackBackTrace( INTERNAL_SKIPPED_FRAMES + gs_tracker.numSkippedFrames,
+		gs_tracker.maxCallstackDepth, frames, nil );
+
+	UINT32 callstack = MurmurHash32( frames, depth * sizeof(frames[0]) );
+	callstack = callstack ? callstack : 1;
+	RegisterCallstack( callstack, frames, depth );
+
+	AllocationEvent* event = AllocateEvent( state );
+	if( event )
+	{
+		event->address = (UINT_PTR) block;
+		event->timestamp = __rdtsc();
+		event->size = (UINT32) numBytes;
+		event->callstack = callstack;
+		event->frameNumber = gs_tracker.frameNumber;
+		event->heap = (UINT8) heap;
+		event->type = AllocationEvent_Alloc;
+		event->pad = 0;
+	}
+
+	EndRecording( state );
+}
+
+void F_TrackDeallocation( const void* block )
+{
+	ThreadState* state = BeginRecording();
+	if( !state ) {
+		return;
+	}
+
+	AllocationEvent* event = AllocateEvent( state );
+	if( event )
+	{
+		event->address = (UINT_PTR) block;
+		event->timestamp = __rdtsc();
+		event->size = 0;
+		event->callstack = 0;
+		event->frameNumber = gs_tracker.frameNumber;
+		event->heap = 0;
+		event->type = AllocationEvent_Free;
+		event->pad = 0;
+	}
+
+	EndRecording( state );
+}
+
+void F_FlushThreadAllocationEvents()
+{
+	ThreadState* state = gs_threadState;
+	if( !state ) {
+		return;
+	}
+	AtomicExchange( &state->busy, 1 );
+	if( g_allocationTrackingEnabled && state->buffer && state->buffer->header.numEvents )
+	{
+		AtomicLock	lock( &gs_tracker.lock );
+		SubmitBuffer_NoLock( state->buffer );
+		state->buffer = nil;
+	}
+	EndRecording( state );
+}
+
+/*
+--------------------------------------------------------------
+	Control
+--------------------------------------------------------------
+*/
+ERet F_StartAllocationTracking( const AllocationTrackerSettings& settings )
+{
+	chkRET_X_IF_NOT(!g_allocationTrackingEnabled && !gs_tracker.file.IsOpen(), ERR_INVALID_FUNCTION_CALL);
+	chkRET_X_IF_NIL(settings.captureFileName, ERR_NULL_POINTER_PASSED);
+	chkRET_X_IF_NOT(settings.maxCallstackDepth >= 1 && settings.maxCallstackDepth <= MAX_CALLSTACK_DEPTH, ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(settings.numSkippedFrames <= MAX_SKIPPED_FRAMES, ERR_INVALID_PARAMETER);
+
+	gs_tracker.callstackHashes = reinterpret_cast< AtomicInt* >( F_SysAlloc( CALLSTACK_TABLE_SIZE * sizeof(AtomicInt) ) );
+	chkRET_X_IF_NIL(gs_tracker.callstackHashes, ERR_OUT_OF_MEMORY);
+	memset( (void*) gs_tracker.callstackHashes, 0, CALLSTACK_TABLE_SIZE * sizeof(AtomicInt) );
+
+	const ERet result = gs_tracker.file.Open( settings.captureFileName );
+	if( mxFAILED(result) ) {
+		F_SysFree( (void*) gs_tracker.callstackHashes );
+		gs_tracker.callstackHashes = nil;
+		return result;
+	}
+
+	gs_tracker.maxCallstackDepth = settings.maxCallstackDepth;
+	gs_tracker.numSkippedFrames = settings.numSkippedFrames;
+	gs_tracker.numLostEvents = 0;
+	gs_tracker.numLostCallstacks = 0;
+	gs_tracker.writeFailed = false;
+	gs_tracker.stopWriter = false;
+
+	AllocationCaptureHeader	header;
+	header.fourCC = ALLOCATION_CAPTURE_FOURCC;
+	header.version = ALLOCATION_CAPTURE_VERSION;
+	header.pointerSize = sizeof(void*);
+	header.numHeaps = HeapCount;
+	gs_tracker.file.Write( &header, sizeof(header) );
+
+	for( UINT32 i = 0; i < HeapCount; i++ )
+	{
+		char	name[ ALLOCATION_CAPTURE_HEAP_NAME_LENGTH ] = { 0 };
+		strncpy( name, mxGetMemoryHeapName( (EMemHeap)i ), sizeof(name) - 1 );
+		gs_tracker.file.Write( name, sizeof(name) );
+	}
+
+	WriteModules();
+
+	Thread::CInfo	cInfo;
+	cInfo.entryPoint = &WriterThreadFunction;
+	cInfo.debugName = "AllocationTracker";
+	if( !gs_tracker.writerThread.Initialize( cInfo ) ) {
+		gs_tracker.file.Close();
+		F_SysFree( (void*) gs_tracker.callstackHashes );
+		gs_tracker.callstackHashes = nil;
+		return ERR_UNKNOWN_ERROR;
+	}
+
+	gs_tracker.startTicks = __rdtsc();
+	gs_tracker.startTime = mxGetTimeInMicroseconds();
+	gs_tracker.firstFrame = gs_tracker.frameNumber;
+
+	AtomicExchange( &g_allocationTrackingEnabled, 1 );
+
+	ptPRINT("Allocation tracking started, writing to '%s'.\n", settings.captureFileName);
+
+	return ALL_OK;
+}
+
+void F_StopAllocationTracking()
+{
+	if( !gs_tracker.file.IsOpen() ) {
+		return;
+	}
+
+	AtomicExchange( &g_allocationTrackingEnabled, 0 );
+
+	const UINT64 elapsedTicks = __rdtsc() - gs_tracker.startTicks;
+	const UINT64 elapsedTime = mxGetTimeInMicroseconds() - gs_tracker.startTime;
+
+	// wait for the threads which are recording events and take their buffers
+	ThreadState* threads;
+	{
+		AtomicLock	lock( &gs_tracker.lock );
+		threads = gs_tracker.threads;
+	}
+	for( ThreadState* state = threads; state; state = state->next )
+	{
+		while( state->busy ) {
+			YieldSoftwareThread();
+		}
+		AtomicLock	lock( &gs_tracker.lock );
+		if( state->buffer ) {
+			SubmitBuffer_NoLock( state->buffer );
+			state->buffer = nil;
+		}
+	}
+
+	gs_tracker.stopWriter = true;
+	gs_tracker.writerThread.Join();
+	gs_tracker.writerThread.Shutdown();
+
+	// the modules loaded after the start
+	WriteModules();
+
+	AllocationCaptureEnd	end;
+	end.ticksPerSecond = elapsedTime ? elapsedTicks * 1000000 / elapsedTime : 1;
+	end.firstFrame = gs_tracker.firstFrame;
+	end.lastFrame = gs_tracker.frameNumber;
+	end.numLostEvents = gs_tracker.numLostEvents;
+	end.numLostCallstacks = gs_tracker.numLostCallstacks;
+	WriteChunk( AllocationChunk_End, &end, sizeof(end) );
+
+	gs_tracker.file.Close();
+
+	while( gs_tracker.freeBuffers ) {
+		EventBuffer* next = gs_tracker.freeBuffers->next;
+		F_SysFree( gs_tracker.freeBuffers );
+		gs_tracker.freeBuffers = next;
+	}
+	F_SysFree( (void*) gs_tracker.callstackHashes );
+	gs_tracker.callstackHashes = nil;
+
+	ptPRINT("Allocation tracking stopped, %u events lost.\n", end.numLostEvents);
+}
+
+bool F_IsAllocationTrackingEnabled()
+{
+	return g_allocationTrackingEnabled != 0;
+}
+
+void F_AdvanceAllocationTrackerFrame()
+{
+	gs_tracker.frameNumber++;
+}
+
+#endif // MX_ENABLE_ALLOCATION_TRACKER
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
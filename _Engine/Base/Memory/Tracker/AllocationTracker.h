@@ -0,0 +1,146 @@
+/*
+=============================================================================
+	File:	AllocationTracker.h
+	Desc:	Records every allocation and deallocation of the engine heaps
+			into a capture file for the offline report tool (MemReport).
+	Note:	Each event gets the heap, size, thread, frame number, timestamp
+			and the hash of the callstack; each unique callstack is written once.
+			Events are appended to per-thread buffers without locks,
+			full buffers are written to the file by a background thread.
+			Aggregation (per call site, per frame, lifetimes) is done offline.
+=============================================================================
+*/
+#pragma once
+
+//
+//	AllocationTrackerSettings
+//
+struct AllocationTrackerSettings
+{
+	const char *	captureFileName;
+	UINT32			maxCallstackDepth;	// 1 - only the caller's address is recorded (the fastest)
+	UINT32			numSkippedFrames;	// the topmost frames of the callstack to drop (the heap functions)
+
+public:
+	AllocationTrackerSettings()
+	{
+		captureFileName = "memory.mtrk";
+		maxCallstackDepth = 12;
+		numSkippedFrames = 0;
+	}
+};
+
+#if MX_ENABLE_ALLOCATION_TRACKER
+
+// Starts recording the events into the capture file. Can be called at any time,
+// the blocks allocated before are reported as 'unknown' when they are freed.
+ERet F_StartAllocationTracking( const AllocationTrackerSettings& settings );
+
+// Writes the remaining events and closes the capture file.
+void F_StopAllocationTracking();
+
+bool F_IsAllocationTrackingEnabled();
+
+// Starts a new frame, each event is stamped with the current frame number.
+void F_AdvanceAllocationTrackerFrame();
+
+// called by the heap allocator
+extern AtomicInt	g_allocationTrackingEnabled;
+void F_TrackAllocation( EMemHeap heap, const void* block, size_t numBytes );
+void F_TrackDeallocation( const void* block );
+// submits the recorded events of the calling thread (e.g. before it exits)
+void F_FlushThreadAllocationEvents();
+
+#else
+
+inline ERet F_StartAllocationTracking( const AllocationTrackerSettings& ) { return ERR_UNSUPPORTED_FEATURE; }
+inline void F_StopAllocationTracking() {}
+inline bool F_IsAllocationTrackingEnabled() { return false; }
+inline void F_AdvanceAllocationTrackerFrame() {}
+
+#endif // MX_ENABLE_ALLOCATION_TRACKER
+
+// Measures the overhead of the tracker on the heap benchmark, the capture can be inspected with MemReport.
+ERet F_BenchmarkAllocationTracker( const char* captureFileName, UINT32 numThreads = 8, UINT32 numAllocationsPerThread = 1<<20 );
+
+//---------------------------------------------------------------------------
+//		Capture file format.
+//---------------------------------------------------------------------------
+
+// the file starts with the header followed by chunks
+struct AllocationCaptureHeader
+{
+	UINT32	fourCC;			// ALLOCATION_CAPTURE_FOURCC
+	UINT32	version;		// ALLOCATION_CAPTURE_VERSION
+	UINT32	pointerSize;	// of the captured process, in bytes
+	UINT32	numHeaps;		// the names of the heaps follow (ALLOCATION_CAPTURE_HEAP_NAME_LENGTH chars each)
+};
+
+enum
+{
+	ALLOCATION_CAPTURE_FOURCC = MCHAR4('M','T','R','K'),
+	ALLOCATION_CAPTURE_VERSION = 1,
+	ALLOCATION_CAPTURE_HEAP_NAME_LENGTH = 32,
+	ALLOCATION_CAPTURE_MODULE_PATH_LENGTH = 260,
+};
+
+enum EAllocationChunkType
+{
+	AllocationChunk_Modules,	// AllocationCaptureModule[]
+	AllocationChunk_Callstacks,	// { UINT32 hash; UINT32 depth; UINT64 frames[depth]; }...
+	AllocationChunk_Events,		// AllocationEventsHeader + AllocationEvent[]
+	AllocationChunk_End,		// AllocationCaptureEnd
+};
+
+struct AllocationChunkHeader
+{
+	UINT32	type;	// EAllocationChunkType
+	UINT32	size;	// of the data following the header, in bytes
+};
+
+// the modules loaded into the process (for resolving symbols)
+struct AllocationCaptureModule
+{
+	UINT64	baseAddress;
+	UINT32	size;
+	char	path[ ALLOCATION_CAPTURE_MODULE_PATH_LENGTH ];
+};
+
+enum EAllocationEventType
+{
+	AllocationEvent_Alloc,
+	AllocationEvent_Free,
+};
+
+// all events in a chunk come from a single thread and are sorted by time
+struct AllocationEventsHeader
+{
+	UINT32	threadId;
+	UINT32	numEvents;
+};
+
+struct AllocationEvent
+{
+	UINT64	address;
+	UINT64	timestamp;		// in CPU ticks
+	UINT32	size;			// the requested size, 0 for deallocations
+	UINT32	callstack;		// the hash of the callstack
+	UINT32	frameNumber;
+	UINT8	heap;			// EMemHeap, only for allocations
+	UINT8	type;			// EAllocationEventType
+	UINT16	pad;
+};
+mxSTATIC_ASSERT(sizeof(AllocationEvent) == 32);
+
+struct AllocationCaptureEnd
+{
+	UINT64	ticksPerSecond;	// measured over the capture
+	UINT32	firstFrame;
+	UINT32	lastFrame;
+	UINT32	numLostEvents;	// the events which couldn't be recorded (e.g. out of memory)
+	UINT32	numLostCallstacks;	// the callstacks which didn't fit into the table
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
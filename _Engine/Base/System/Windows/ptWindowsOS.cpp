@@ -7,6 +7,7 @@
 #include <Base/Base_PCH.h>
 #pragma hdrstop
 #include <Base/Base.h>
+#include <Base/Memory/Frame/FrameAlloc.h>	// FrameAllocator_ReleaseThreadSlot()
 
 #include <intrin.h>		// __cpuid
 #include <sys/timeb.h>	// for ftime()
@@ -1754,6 +1755,16 @@ bool AtomicCAS( AtomicInt* valuePtr, int oldValue, int newValue )
 	return ::InterlockedCompareExchange( valuePtr, newValue, oldValue ) == oldValue;
 }
 
+void* AtomicExchangePointer( void* volatile* dest, void* value )
+{
+	return ::InterlockedExchangePointer( dest, value );
+}
+
+void* AtomicCompareExchangePointer( void* volatile* dest, void* comparand, void* exchange )
+{
+	return ::InterlockedCompareExchangePointer( dest, exchange, comparand );
+}
+
 void AtomicIncrement( AtomicInt* value, int incAmount )
 {
 	AtomicInt count = *value;
@@ -2102,6 +2113,8 @@ ASSERT_SIZEOF(THREAD_ID, sizeof(DWORD));
 Thread::Thread()
 {
 	m_handle = NULL;
+	m_entryPoint = NULL;
+	m_userPointer = NULL;
 }
 
 Thread::~Thread()
@@ -2112,9 +2125,24 @@ Thread::~Thread()
 	}
 }
 
+// calls the thread function and releases the per-thread memory state when it returns
+// (the Thread object waits for the thread in Shutdown(), so it outlives the thread)
+static DWORD WINAPI ThreadEntryPoint( LPVOID lpParameter )
+{
+	const Thread* thread = static_cast< const Thread* >( lpParameter );
+	const UINT32 exitCode = (*thread->m_entryPoint)( thread->m_userPointer );
+	FrameAllocator_ReleaseThreadSlot();
+	F_ReleaseThreadHeapCache();
+	return exitCode;
+}
+
 bool Thread::Initialize( const CInfo& cInfo )
 {
 	mxASSERT( m_handle == NULL );
+	mxASSERT_PTR( cInfo.entryPoint );
+
+	m_entryPoint = cInfo.entryPoint;
+	m_userPointer = cInfo.userPointer;
 
 	DWORD	dwCreationFlags = 0;
 	if( cInfo.bCreateSuspended ) {
@@ -2127,8 +2155,8 @@ bool Thread::Initialize( const CInfo& cInfo )
 	m_handle = ::CreateThread(
 		NULL,										// default security attributes
 		cInfo.stackSize,							// use default stack size
-		(LPTHREAD_START_ROUTINE)cInfo.entryPoint,	// thread function
-		cInfo.userPointer,							// argument to thread function
+		&ThreadEntryPoint,							// thread function
+		this,										// argument to thread function
 		dwCreationFlags,							// creation flags
 		&threadID									// returns the thread identifier
 	);
@@ -467,6 +467,11 @@ int AtomicCompareExchange( AtomicInt* dest, int comparand, int exchange );
 //
 bool AtomicCAS( AtomicInt* valuePtr, int oldValue, int newValue );
 
+// The same for pointers (for building lock-free lists),
+// both functions return the previous value of 'dest'.
+void* AtomicExchangePointer( void* volatile* dest, void* value );
+void* AtomicCompareExchangePointer( void* volatile* dest, void* comparand, void* exchange );
+
 // Description:
 // Atomically increments a value.
 // Arguments:
@@ -668,7 +673,9 @@ enum { mxDEFAULT_THREAD_STACK_SIZE = 64 * 1024 };	// 64 KiB
 */
 struct Thread
 {
-	HANDLE	m_handle;	// OS thread handle
+	HANDLE					m_handle;	// OS thread handle
+	F_ThreadEntryPoint *	m_entryPoint;
+	void *					m_userPointer;
 
 public:
 	Thread();
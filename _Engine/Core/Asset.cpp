@@ -31,6 +31,8 @@
 #include <Core/Asset.h>
 #include <Core/ObjectModel.h>
 #include <Core/Serialization.h>
+#include <Core/JobSystem.h>
+#include <Core/SlowTasks.h>
 
 mxBEGIN_REFLECT_ENUM( AssetTypeT )
 #define DECLARE_ASSET_TYPE( name, class, file_extension, version, description )		mxREFLECT_ENUM_ITEM( name, AssetTypes::name ),
@@ -139,6 +141,15 @@ struct TEqualsTrait< AssetKey > {
 	AFilePackage
 --------------------------------------------------------------
 */
+void* AFilePackage::MapFile( Stream * stream )
+{
+	mxUNUSED(stream);
+	return NULL;
+}
+void AFilePackage::UnmapFile( void* mappedFile )
+{
+	mxUNUSED(mappedFile);
+}
 AFilePackage::~AFilePackage()
 {
 	mxASSERT(!Assets::IsPackageMounted(this));
@@ -199,6 +210,10 @@ namespace Assets
 		}
 		return AssetTypes::UNKNOWN;
 	}
+	UINT32 GetAssetTypeVersion( AssetTypeT type )
+	{
+		return gs_assetTypes[ type ].version;
+	}
 
 	struct AssetEntry
 	{
@@ -209,17 +224,74 @@ namespace Assets
 	// maps pairs (id,type) to asset instance pointers
 	typedef THashMap< AssetKey, AssetEntry >	AssetMap;
 
+	// the stages of an asynchronous clump load request
+	enum ERequestStage
+	{
+		Stage_Free = 0,	// the slot is not used
+		Stage_Queued,	// waiting for the I/O thread
+		Stage_Reading,	// the file is being read in the I/O thread
+		Stage_Decoding,	// the image is being fixed up on a worker thread
+		Stage_Completed,// waiting for finalization on the main thread
+	};
+
+	// asynchronous clump load request
+	struct LoadRequest
+	{
+		AssetID					assetId;
+		AFilePackage *			package;
+		AFilePackage::Stream	stream;
+		F_ClumpLoaded *			callback;
+		void *					userData;
+
+		void *		clumpBuffer;	// the clump image, allocated with Clump::Alloc() or in the mapped file
+		void *		fixups;			// the pointer and type fixup tables (temporary memory or in the mapped file)
+		void *		mappedFile;		// the view of the package file if the clump is loaded in place (see MapFile())
+		UINT32		payload;		// the size of the clump image
+		UINT32		fixupsSize;
+
+		UINT32		serialNumber;	// the upper bits of the request id, also used for FIFO order
+		UINT8		priority;		// ELoadPriority
+		UINT8		stage;			// ERequestStage
+		bool		fileIsOpen;
+		bool		clumpConstructed;
+		AtomicInt	cancelled;
+		ERet		result;
+
+		UINT64				timeStamp;	// when the current stage has been entered, in microseconds
+		LoadRequestStats	stats;
+	};
+
+	// request id = (serial number << REQUEST_INDEX_BITS) | slot index
+	enum { REQUEST_INDEX_BITS = 8 };
+	mxSTATIC_ASSERT( MAX_LOAD_REQUESTS == (1 << REQUEST_INDEX_BITS) );
+
 	struct AssetManagerData
 	{
 		AssetMap	assets;	// loaded assets for sharing asset instances
 
 		AFilePackage::Head	packages;	// linked list of mounted file packages
+
+		// asynchronous loading
+		LoadRequest		requests[ MAX_LOAD_REQUESTS ];
+		LoadRequest *	freeRequests[ MAX_LOAD_REQUESTS ];
+		UINT			numFreeRequests;
+		LoadRequest *	queuedRequests[ MAX_LOAD_REQUESTS ];	// sorted in the order of reading
+		UINT			numQueuedRequests;
+		LoadRequest *	completedRequests[ MAX_LOAD_REQUESTS ];
+		UINT			numCompletedRequests;
+		UINT32			nextSerialNumber;
+		SpinWait		requestsCS;	// serializes access to the above lists and request stages
+
+		Thread			loaderThread;	// the background I/O thread
+		Semaphore		loaderWakeUp;	// signalled for each queued request
+		AtomicInt		loaderExiting;
 	};
 	mxDECLARE_PRIVATE_DATA( AssetManagerData, gAssetManagerData );
 
 #define me	mxGET_PRIVATE_DATA( AssetManagerData, gAssetManagerData )
 
 	static UINT32 mxPASCAL ResourceLoaderThread( void* userData );
+	static void CancelAllRequests();
 
 	ERet Initialize()
 	{
@@ -227,6 +299,25 @@ namespace Assets
 
 		me.packages = NULL;
 
+		for( UINT i = 0; i < MAX_LOAD_REQUESTS; i++ ) {
+			me.requests[i].stage = Stage_Free;
+			me.freeRequests[i] = &me.requests[ MAX_LOAD_REQUESTS - 1 - i ];
+		}
+		me.numFreeRequests = MAX_LOAD_REQUESTS;
+		me.numQueuedRequests = 0;
+		me.numCompletedRequests = 0;
+		me.nextSerialNumber = 1;
+		me.requestsCS.Initialize();
+
+		chkRET_X_IF_NOT(me.loaderWakeUp.Initialize( 0, MAX_LOAD_REQUESTS + 1 ), ERR_UNKNOWN_ERROR);
+		me.loaderExiting = 0;
+
+		Thread::CInfo	cInfo;
+		cInfo.entryPoint = &ResourceLoaderThread;
+		cInfo.userPointer = NULL;
+		cInfo.debugName = "ResourceLoader";
+		chkRET_X_IF_NOT(me.loaderThread.Initialize( cInfo ), ERR_UNKNOWN_ERROR);
+
 		return ALL_OK;
 	}
 
@@ -234,6 +325,19 @@ namespace Assets
 	{
 		mxASSERT(me.packages == NULL); 
 
+		AtomicExchange( &me.loaderExiting, 1 );
+		me.loaderWakeUp.Signal();
+		me.loaderThread.Join();
+		me.loaderThread.Shutdown();
+
+		// wait for the decoding tasks
+		SlowTasks::WaitForAllTasks();
+
+		CancelAllRequests();
+
+		me.loaderWakeUp.Shutdown();
+		me.requestsCS.Shutdown();
+
 		mxSHUTDOWN_PRIVATE_DATA( gAssetManagerData );
 	}
 
@@ -386,6 +490,615 @@ namespace Assets
 		return ALL_OK;
 	}
 
+	//
+	// Asynchronous I/O
+	//
+
+	static UINT32 MicrosecondsSince( UINT64 _startTime )
+	{
+		return (UINT32) ( mxGetTimeInMicroseconds() - _startTime );
+	}
+
+	static LoadRequestId MakeRequestId( const LoadRequest& _request )
+	{
+		LoadRequestId requestId;
+		requestId.id = (_request.serialNumber << REQUEST_INDEX_BITS) | (UINT32)( &_request - me.requests );
+		return requestId;
+	}
+
+	// must be called under the lock
+	static LoadRequest* FindRequest( LoadRequestId _requestId )
+	{
+		if( _requestId.IsNull() ) {
+			return NULL;
+		}
+		LoadRequest& request = me.requests[ _requestId.id & (MAX_LOAD_REQUESTS-1) ];
+		if( request.stage == Stage_Free || request.serialNumber != (_requestId.id >> REQUEST_INDEX_BITS) ) {
+			return NULL;
+		}
+		return &request;
+	}
+
+	// returns true if _a should be read before _b
+	static bool ShouldBeReadBefore( const LoadRequest& _a, const LoadRequest& _b )
+	{
+		if( _a.priority != _b.priority ) {
+			return _a.priority > _b.priority;
+		}
+		// group reads by package and minimize seeking within each package
+		if( _a.package != _b.package ) {
+			return _a.package < _b.package;
+		}
+		if( _a.stream.sortKey != _b.stream.sortKey ) {
+			return _a.stream.sortKey < _b.stream.sortKey;
+		}
+		return _a.timeStamp < _b.timeStamp;
+	}
+
+	// must be called under the lock
+	static void AddToCompletedList( LoadRequest* _request )
+	{
+		mxASSERT(me.numCompletedRequests < MAX_LOAD_REQUESTS);
+		_request->stage = Stage_Completed;
+		_request->timeStamp = mxGetTimeInMicroseconds();
+		me.completedRequests[ me.numCompletedRequests++ ] = _request;
+	}
+
+	static void CompleteRequest( LoadRequest* _request )
+	{
+		SpinWait::Lock	scopedLock( me.requestsCS );
+		AddToCompletedList( _request );
+	}
+
+	ERet LoadClumpAsync(
+		const AssetID& _id,
+		F_ClumpLoaded* _callback,
+		void* _userData,
+		ELoadPriority _priority,
+		LoadRequestId *_requestId
+		)
+	{
+		chkRET_X_IF_NOT(AssetId_IsValid(_id), ERR_INVALID_PARAMETER);
+		chkRET_X_IF_NIL(_callback, ERR_NULL_POINTER_PASSED);
+
+		AFilePackage::Stream	stream;
+		AFilePackage* package = OpenFile( _id, &stream );
+		if( !package )
+		{
+			ptERROR("Failed to find clump '%s'.\n", AssetId_ToChars(_id));
+			return ERR_FAILED_TO_OPEN_FILE;	// file not found
+		}
+
+		LoadRequest* request = NULL;
+		{
+			SpinWait::Lock	scopedLock( me.requestsCS );
+
+			if( me.numFreeRequests )
+			{
+				request = me.freeRequests[ --me.numFreeRequests ];
+
+				request->assetId = _id;
+				request->package = package;
+				request->stream = stream;
+				request->callback = _callback;
+				request->userData = _userData;
+				request->clumpBuffer = NULL;
+				request->fixups = NULL;
+				request->mappedFile = NULL;
+				request->payload = 0;
+				request->fixupsSize = 0;
+				request->serialNumber = me.nextSerialNumber;
+				request->priority = _priority;
+				request->stage = Stage_Queued;
+				request->fileIsOpen = true;
+				request->clumpConstructed = false;
+				request->cancelled = 0;
+				request->result = ALL_OK;
+				request->timeStamp = mxGetTimeInMicroseconds();
+				mxZERO_OUT(request->stats);
+
+				// skip zero and the serial number which could produce the null id
+				me.nextSerialNumber = (me.nextSerialNumber + 1) & ((1u << (32 - REQUEST_INDEX_BITS)) - 1);
+				me.nextSerialNumber = largest( me.nextSerialNumber, 1u );
+				if( me.nextSerialNumber == (MAX_UINT32 >> REQUEST_INDEX_BITS) ) {
+					me.nextSerialNumber = 1;
+				}
+
+				// insertion sort - the queue is short
+				UINT position = me.numQueuedRequests;
+				while( position > 0 && ShouldBeReadBefore( *request, *me.queuedRequests[ position - 1 ] ) )
+				{
+					me.queuedRequests[ position ] = me.queuedRequests[ position - 1 ];
+					position--;
+				}
+				me.queuedRequests[ position ] = request;
+				me.numQueuedRequests++;
+			}
+		}
+
+		if( !request )
+		{
+			package->CloseFile( &stream );
+			ptERROR("Failed to load clump '%s': too many load requests.\n", AssetId_ToChars(_id));
+			return ERR_TOO_MANY_OBJECTS;
+		}
+
+		if( _requestId ) {
+			*_requestId = MakeRequestId( *request );
+		}
+
+		me.loaderWakeUp.Signal();
+
+		return ALL_OK;
+	}
+
+	ELoadStatus GetLoadStatus( LoadRequestId _requestId )
+	{
+		SpinWait::Lock	scopedLock( me.requestsCS );
+		const LoadRequest* request = FindRequest( _requestId );
+		if( !request ) {
+			return LoadStatus_Unloaded;
+		}
+		return request->cancelled ? LoadStatus_Cancelled : LoadStatus_Pending;
+	}
+
+	bool CancelLoadRequest( LoadRequestId _requestId )
+	{
+		SpinWait::Lock	scopedLock( me.requestsCS );
+
+		LoadRequest* request = FindRequest( _requestId );
+		if( !request ) {
+			return false;
+		}
+
+		AtomicExchange( &request->cancelled, 1 );
+
+		// the I/O thread and the decoding task check the flag themselves,
+		// queued requests are sent straight to finalization
+		if( request->stage == Stage_Queued )
+		{
+			for( UINT i = 0; i < me.numQueuedRequests; i++ )
+			{
+				if( me.queuedRequests[i] == request )
+				{
+					me.numQueuedRequests--;
+					for( UINT k = i; k < me.numQueuedRequests; k++ ) {
+						me.queuedRequests[k] = me.queuedRequests[k + 1];
+					}
+					break;
+				}
+			}
+			request->stats.queueWait = MicrosecondsSince( request->timeStamp );
+			AddToCompletedList( request );
+		}
+
+		return true;
+	}
+
+	UINT NumPendingRequests()
+	{
+		SpinWait::Lock	scopedLock( me.requestsCS );
+		return MAX_LOAD_REQUESTS - me.numFreeRequests;
+	}
+
+	// reads the given number of bytes in chunks of at most MAX_IO_READ_SIZE,
+	// so that cancelled requests don't block the I/O thread for too long
+	static ERet ReadInChunks( LoadRequest & _request, void *_buffer, UINT32 _size )
+	{
+		char* destination = static_cast< char* >( _buffer );
+		UINT32 bytesLeft = _size;
+		while( bytesLeft > 0 && !_request.cancelled )
+		{
+			const UINT32 chunkSize = smallest( bytesLeft, (UINT32)MAX_IO_READ_SIZE );
+			mxDO(_request.package->ReadFile( &_request.stream, destination, chunkSize ));
+			destination += chunkSize;
+			bytesLeft -= chunkSize;
+			_request.stats.bytesRead += chunkSize;
+		}
+		return ALL_OK;
+	}
+
+	// returns the image header if the clump file can be loaded in place from the package view
+	static const Serialization::ImageHeader* MapClumpFile( AFilePackage* _package, AFilePackage::Stream & _stream )
+	{
+		if( _stream.dataSize < sizeof(Serialization::ImageHeader) ) {
+			return NULL;
+		}
+		void* mappedFile = _package->MapFile( &_stream );
+		if( !mappedFile ) {
+			return NULL;
+		}
+		if( !IsAlignedBy( mxAddByteOffset( mappedFile, sizeof(Serialization::ImageHeader) ), EFFICIENT_ALIGNMENT ) ) {
+			_package->UnmapFile( mappedFile );
+			return NULL;
+		}
+		return static_cast< const Serialization::ImageHeader* >( mappedFile );
+	}
+
+	// [I/O thread] reads the clump image directly into the clump memory
+	// and the fixup tables into temporary memory
+	static ERet ReadClumpFile( LoadRequest & _request )
+	{
+		const Serialization::ImageHeader* mappedHeader = MapClumpFile( _request.package, _request.stream );
+		if( mappedHeader )
+		{
+			// no copying, the pages will be read in when the image is patched on a worker thread
+			_request.mappedFile = c_cast(void*) mappedHeader;
+
+			const UINT32 bytesLeft = _request.stream.dataSize - sizeof(*mappedHeader);
+			chkRET_X_IF_NOT(mappedHeader->payload <= bytesLeft, ERR_FAILED_TO_READ_FILE);
+
+			_request.payload = mappedHeader->payload;
+			_request.fixupsSize = bytesLeft - mappedHeader->payload;
+			_request.clumpBuffer = c_cast(void*) (mappedHeader + 1);
+			_request.fixups = mxAddByteOffset( _request.clumpBuffer, _request.payload );
+			_request.stats.bytesRead = _request.stream.dataSize;
+			return ALL_OK;
+		}
+
+		Serialization::ImageHeader	header;
+		chkRET_X_IF_NOT(_request.stream.dataSize >= sizeof(header), ERR_FAILED_TO_READ_FILE);
+		mxDO(_request.package->ReadFile( &_request.stream, &header, sizeof(header) ));
+		_request.stats.bytesRead += sizeof(header);
+
+		const UINT32 bytesLeft = _request.stream.dataSize - sizeof(header);
+		chkRET_X_IF_NOT(header.payload <= bytesLeft, ERR_FAILED_TO_READ_FILE);
+
+		_request.payload = header.payload;
+		_request.fixupsSize = bytesLeft - header.payload;
+
+		_request.clumpBuffer = Clump::Alloc( _request.payload );
+		chkRET_X_IF_NIL(_request.clumpBuffer, ERR_OUT_OF_MEMORY);
+		mxDO(ReadInChunks( _request, _request.clumpBuffer, _request.payload ));
+
+		if( _request.fixupsSize )
+		{
+			_request.fixups = mxAlloc( _request.fixupsSize );
+			chkRET_X_IF_NIL(_request.fixups, ERR_OUT_OF_MEMORY);
+			mxDO(ReadInChunks( _request, _request.fixups, _request.fixupsSize ));
+		}
+
+		return ALL_OK;
+	}
+
+	// [worker thread] relocates pointers inside the clump and loads its data
+	static void DecodeClumpTask( const SlowTaskCtx& _context )
+	{
+		LoadRequest* request = c_cast(LoadRequest*) (size_t) _context.data;
+
+		const UINT64 startTime = mxGetTimeInMicroseconds();
+
+		if( !request->cancelled )
+		{
+			MemoryReader	fixups( request->fixups, request->fixupsSize );
+			request->result = Serialization::FixupClumpImage( fixups, request->payload, request->clumpBuffer );
+			if( mxSUCCEDED(request->result) )
+			{
+				request->clumpConstructed = true;
+
+				// the clump releases the view when it's destroyed
+				if( request->mappedFile ) {
+					static_cast< Clump* >( request->clumpBuffer )->SetMappedFile( request->package, request->mappedFile );
+				}
+
+				LoadContext2	context;
+				context.o = request->clumpBuffer;
+				context.package = request->package;
+				context.stream = request->stream;
+				context.DbgSetName( AssetId_ToChars( request->assetId ) );
+
+				request->result = Clump::Load( context );
+			}
+		}
+
+		if( !request->mappedFile ) {
+			mxFree( request->fixups );
+		}
+		request->fixups = NULL;
+
+		request->stats.decodeTime = MicrosecondsSince( startTime );
+
+		CompleteRequest( request );
+	}
+
+	static UINT32 mxPASCAL ResourceLoaderThread( void* userData )
+	{
+		mxUNUSED(userData);
+		for(;;)
+		{
+			me.loaderWakeUp.Wait();
+			if( me.loaderExiting ) {
+				break;
+			}
+
+			LoadRequest* request = NULL;
+			{
+				SpinWait::Lock	scopedLock( me.requestsCS );
+				// cancelled requests have already been removed from the queue
+				if( me.numQueuedRequests )
+				{
+					request = me.queuedRequests[0];
+					me.numQueuedRequests--;
+					for( UINT i = 0; i < me.numQueuedRequests; i++ ) {
+						me.queuedRequests[i] = me.queuedRequests[i + 1];
+					}
+					request->stage = Stage_Reading;
+				}
+			}
+			if( !request ) {
+				continue;
+			}
+
+			request->stats.queueWait = MicrosecondsSince( request->timeStamp );
+
+			const UINT64 startTime = mxGetTimeInMicroseconds();
+
+			request->result = ReadClumpFile( *request );
+
+			request->package->CloseFile( &request->stream );
+			request->fileIsOpen = false;
+
+			request->stats.ioTime = MicrosecondsSince( startTime );
+
+			if( mxSUCCEDED(request->result) && !request->cancelled )
+			{
+				{
+					SpinWait::Lock	scopedLock( me.requestsCS );
+					request->stage = Stage_Decoding;
+				}
+				SlowTaskDesc	task;
+				task.callback = &DecodeClumpTask;
+				task.data = (size_t) request;
+				SlowTasks::AddTask( task );
+			}
+			else
+			{
+				CompleteRequest( request );
+			}
+		}
+		return 0;
+	}
+
+	// [main thread] brings the clump online, reports the result and releases the request
+	static void FinalizeRequest( LoadRequest* _request )
+	{
+		if( _request->fileIsOpen )
+		{
+			_request->package->CloseFile( &_request->stream );
+			_request->fileIsOpen = false;
+		}
+
+		// the decoding task frees the fixups, but it doesn't run for requests cancelled or failed during I/O
+		if( !_request->mappedFile ) {
+			mxFree( _request->fixups );
+		}
+		_request->fixups = NULL;
+
+		Clump* clump = NULL;
+		ELoadStatus status = LoadStatus_HadErrors;
+
+		if( _request->cancelled || mxFAILED(_request->result) )
+		{
+			if( _request->clumpConstructed ) {
+				Clump::Delete( static_cast< Clump* >( _request->clumpBuffer ) );
+			} else if( _request->mappedFile ) {
+				_request->package->UnmapFile( _request->mappedFile );
+			} else if( _request->clumpBuffer ) {
+				Clump::Free( _request->clumpBuffer );
+			}
+			if( _request->cancelled ) {
+				status = LoadStatus_Cancelled;
+			} else {
+				ptERROR("Failed to load clump '%s'.\n", AssetId_ToChars(_request->assetId));
+			}
+		}
+		else
+		{
+			LoadContext2	context;
+			context.o = _request->clumpBuffer;
+			context.package = _request->package;
+			context.stream = _request->stream;
+			context.DbgSetName( AssetId_ToChars( _request->assetId ) );
+
+			const UINT64 startTime = mxGetTimeInMicroseconds();
+			const ERet result = Clump::Online( context );
+			_request->stats.finalizeTime = MicrosecondsSince( startTime );
+
+			clump = static_cast< Clump* >( _request->clumpBuffer );
+			if( mxSUCCEDED(result) ) {
+				status = LoadStatus_Loaded;
+			} else {
+				ptERROR("Failed to bring clump '%s' online.\n", AssetId_ToChars(_request->assetId));
+			}
+
+			DBGOUT("Loaded clump '%s' (%u bytes): queue: %u us, I/O: %u us, decode: %u us, finalize: %u us.\n",
+				AssetId_ToChars(_request->assetId), _request->stats.bytesRead,
+				_request->stats.queueWait, _request->stats.ioTime,
+				_request->stats.decodeTime, _request->stats.finalizeTime);
+		}
+
+		// copy the results and release the slot before calling back,
+		// so that the callback can submit new requests
+		const LoadRequestId requestId = MakeRequestId( *_request );
+		const LoadRequestStats stats = _request->stats;
+		F_ClumpLoaded* callback = _request->callback;
+		void* userData = _request->userData;
+		{
+			SpinWait::Lock	scopedLock( me.requestsCS );
+			_request->stage = Stage_Free;
+			_request->assetId = AssetId_GetNull();
+			me.freeRequests[ me.numFreeRequests++ ] = _request;
+		}
+
+		(*callback)( requestId, status, clump, stats, userData );
+	}
+
+	// One may not want to process all the completed requests at once
+	// because this may cause a noticeable temporary slow down in the game's performance.
+	// So, this API could be called once per frame
+	// so that only a small number work items would be set to the device on each frame,
+	// thereby spreading the work load of binding resources to the device over several frames.
+	//
+	bool FinalizeCompletedRequests( UINT maxNumRequests, UINT maxMicroseconds )
+	{
+		mxASSERT_MAIN_THREAD;
+		const UINT64 startTime = mxGetTimeInMicroseconds();
+		UINT numFinalized = 0;
+		for(;;)
+		{
+			if( maxNumRequests && numFinalized >= maxNumRequests ) {
+				break;
+			}
+			if( maxMicroseconds && numFinalized && MicrosecondsSince( startTime ) >= maxMicroseconds ) {
+				break;
+			}
+
+			// pick the most important completed request
+			LoadRequest* request = NULL;
+			{
+				SpinWait::Lock	scopedLock( me.requestsCS );
+				if( !me.numCompletedRequests ) {
+					break;
+				}
+				UINT best = 0;
+				for( UINT i = 1; i < me.numCompletedRequests; i++ )
+				{
+					if( me.completedRequests[i]->priority > me.completedRequests[best]->priority ) {
+						best = i;
+					}
+				}
+				request = me.completedRequests[ best ];
+				me.numCompletedRequests--;
+				for( UINT i = best; i < me.numCompletedRequests; i++ ) {
+					me.completedRequests[i] = me.completedRequests[i + 1];
+				}
+			}
+
+			FinalizeRequest( request );
+			numFinalized++;
+		}
+		return NumPendingRequests() == 0;
+	}
+
+	// [main thread] must be called after the I/O thread has exited and all decoding tasks have finished
+	static void CancelAllRequests()
+	{
+		for( UINT i = 0; i < MAX_LOAD_REQUESTS; i++ )
+		{
+			LoadRequest& request = me.requests[i];
+			if( request.stage == Stage_Queued || request.stage == Stage_Completed ) {
+				AtomicExchange( &request.cancelled, 1 );
+			}
+		}
+		me.numQueuedRequests = 0;
+		me.numCompletedRequests = 0;
+		for( UINT i = 0; i < MAX_LOAD_REQUESTS; i++ )
+		{
+			LoadRequest& request = me.requests[i];
+			if( request.stage != Stage_Free ) {
+				FinalizeRequest( &request );
+			}
+		}
+	}
+
+	namespace
+	{
+		struct CancellationTestData
+		{
+			UINT32	numCallbacks;
+			UINT32	numCancelled;
+			UINT32	numErrors;
+		};
+		static void CancellationTestCallback( LoadRequestId _requestId, ELoadStatus _status, Clump* _clump, const LoadRequestStats& _stats, void* _userData )
+		{
+			mxUNUSED(_requestId);
+			mxUNUSED(_stats);
+			CancellationTestData& data = *static_cast< CancellationTestData* >( _userData );
+			data.numCallbacks++;
+			if( _status == LoadStatus_Cancelled && !_clump ) {
+				data.numCancelled++;
+			} else {
+				data.numErrors++;
+			}
+			if( _clump ) {
+				Clump::Delete( _clump );
+			}
+		}
+		// returns the stage of the request, or Stage_Free if it has been finalized
+		static UINT GetRequestStage( LoadRequestId _requestId )
+		{
+			SpinWait::Lock	scopedLock( me.requestsCS );
+			const LoadRequest* request = FindRequest( _requestId );
+			return request ? request->stage : Stage_Free;
+		}
+	}//namespace
+
+	ERet TestLoadCancellation( const AssetID& _clumpId, UINT32 _numRequests )
+	{
+		mxASSERT_MAIN_THREAD;
+		chkRET_X_IF_NOT(_numRequests > 0, ERR_INVALID_PARAMETER);
+		chkRET_X_IF_NOT(NumPendingRequests() == 0, ERR_INVALID_FUNCTION_CALL);
+
+		mxMemoryStatistics	heapStatsBefore;
+		F_GetGlobalMemoryStats( heapStatsBefore );
+
+		CancellationTestData	data;
+		mxZERO_OUT(data);
+
+		// the number of requests cancelled in each stage
+		UINT32 numCancelledInStage[ Stage_Completed + 1 ] = { 0 };
+
+		for( UINT32 i = 0; i < _numRequests; i++ )
+		{
+			LoadRequestId requestId;
+			mxDO(LoadClumpAsync( _clumpId, &CancellationTestCallback, &data, Load_Priority_Normal, &requestId ));
+
+			// cycle through the stages, the request may move past the wanted stage before it's cancelled
+			const UINT wantedStage = Stage_Queued + i % Stage_Completed;
+			const UINT64 startTime = mxGetTimeInMicroseconds();
+			UINT stage = GetRequestStage( requestId );
+			while( stage < wantedStage && MicrosecondsSince( startTime ) < 100000 ) {
+				stage = GetRequestStage( requestId );
+			}
+
+			if( !CancelLoadRequest( requestId ) ) {
+				ptWARN("Failed to cancel load request %u.\n", i);
+				data.numErrors++;
+			}
+			numCancelledInStage[ stage ]++;
+		}
+
+		const UINT64 startTime = mxGetTimeInMicroseconds();
+		while( !FinalizeCompletedRequests() )
+		{
+			if( MicrosecondsSince( startTime ) > 10000000 ) {
+				ptERROR("Load requests haven't completed in 10 seconds.\n");
+				return ERR_RUNTIME_ERROR;
+			}
+			mxSleepMilliseconds( 1 );
+		}
+
+		mxMemoryStatistics	heapStatsAfter;
+		F_GetGlobalMemoryStats( heapStatsAfter );
+
+		ptPRINT("Cancelled %u load requests of '%s': %u queued, %u reading, %u decoding, %u completed.\n",
+			_numRequests, AssetId_ToChars(_clumpId),
+			numCancelledInStage[ Stage_Queued ], numCancelledInStage[ Stage_Reading ],
+			numCancelledInStage[ Stage_Decoding ], numCancelledInStage[ Stage_Completed ]);
+
+		if( data.numCallbacks != _numRequests || data.numCancelled != _numRequests ) {
+			ptERROR("%u callbacks, %u cancelled requests, expected %u.\n", data.numCallbacks, data.numCancelled, _numRequests);
+			data.numErrors++;
+		}
+		if( heapStatsAfter.bytesAllocated != heapStatsBefore.bytesAllocated ) {
+			ptERROR("%d bytes leaked by cancelled load requests.\n", (int)(heapStatsAfter.bytesAllocated - heapStatsBefore.bytesAllocated));
+			data.numErrors++;
+		}
+
+		chkRET_X_IF_NOT(data.numErrors == 0, ERR_VALIDATION_FAILED);
+		return ALL_OK;
+	}
+
 #if 0
 	ERet DoLoad( const AssetKey& key, LoadContext2 & context )
 	{
@@ -946,13 +1659,32 @@ ERet LoadClump( const AssetID& id, Clump *& clump, void* userData )
 
 
 
-	Serialization::ImageHeader	header;
-	mxDO(context.Get(header));
+	void* buffer = NULL;
 
-	void* buffer = Clump::Alloc(header.payload);
-	chkRET_X_IF_NIL(buffer,ERR_OUT_OF_MEMORY);
+	const Serialization::ImageHeader* mappedHeader = Assets::MapClumpFile( context.package, context.stream );
+	if( mappedHeader )
+	{
+		// load the clump in place, without copying
+		Clump* mappedClump = NULL;
+		const ERet result = Serialization::LoadClumpInPlace( c_cast(void*) mappedHeader, context.stream.dataSize, mappedClump );
+		if( mxFAILED(result) ) {
+			context.package->UnmapFile( c_cast(void*) mappedHeader );
+			return result;
+		}
+		// the clump releases the view when it's destroyed
+		mappedClump->SetMappedFile( context.package, c_cast(void*) mappedHeader );
+		buffer = mappedClump;
+	}
+	else
+	{
+		Serialization::ImageHeader	header;
+		mxDO(context.Get(header));
+
+		buffer = Clump::Alloc(header.payload);
+		chkRET_X_IF_NIL(buffer,ERR_OUT_OF_MEMORY);
 
-	mxDO(Serialization::LoadClumpImage( context, header.payload, buffer ));
+		mxDO(Serialization::LoadClumpImage( context, header.payload, buffer ));
+	}
 
 	context.o = buffer;
 
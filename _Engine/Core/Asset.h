@@ -124,7 +124,7 @@ struct AFilePackage : public TSinglyLinkedList< AFilePackage >
 		UINT64	fileHandle;	// e.g. could be an OS file handle or offset within a PAK file
 		UINT32	dataSize;	// uncompressed size
 		UINT32	offset;		// current read offset
-		//UINT32	sortKey;	// for sorting by file offsets
+		UINT32	sortKey;	// for sorting reads by file offsets (e.g. offset within a PAK file), can be zero
 	public:
 		Stream();
 	};
@@ -141,6 +141,16 @@ struct AFilePackage : public TSinglyLinkedList< AFilePackage >
 
 	virtual size_t TellPosition( const Stream& stream ) const = 0;
 
+	// Returns a writable view of the whole file for loading in place
+	// or null if the package cannot map the file (e.g. if it's compressed).
+	// Writes to the view are private (copy-on-write) and never reach the file
+	// or other views of it. The view stays valid until it's passed to UnmapFile(),
+	// the file can be closed before that.
+	//[must be threadsafe]
+	virtual void* MapFile( Stream * stream );
+	//[must be threadsafe]
+	virtual void UnmapFile( void* mappedFile );
+
 	virtual ~AFilePackage();
 };
 
@@ -244,6 +254,8 @@ namespace Assets
 
 	AssetTypeT FindAssetTypeByExtension( const char* ext );
 	AssetTypeT FindAssetTypeByClassID( const TypeID classID );
+	// the format version of compiled assets of the given type, always increasing
+	UINT32 GetAssetTypeVersion( AssetTypeT type );
 
 	//
 	// Initialization/Shutdown
@@ -285,6 +297,68 @@ namespace Assets
 	ERet ReloadAssetsOfType( const AssetTypeT& type );	// thread-safe
 	ERet ReloadAllAssets();	// thread-safe
 
+	//
+	// Asynchronous I/O
+	//
+
+	// the max. number of clump load requests which can be in flight at the same time
+	enum { MAX_LOAD_REQUESTS = 256 };
+
+	// timings of a load request, in microseconds
+	struct LoadRequestStats
+	{
+		UINT32	queueWait;		// from submission until the I/O thread started reading the file
+		UINT32	ioTime;			// reading the file in the background I/O thread
+		UINT32	decodeTime;		// fixing up the image and F_LoadData on a worker thread
+		UINT32	finalizeTime;	// F_Finalize on the main thread
+		UINT32	bytesRead;
+	};
+
+	// called on the main thread from FinalizeCompletedRequests();
+	// _clump is null if the request has been cancelled or the clump could not be created,
+	// otherwise the clump belongs to the caller (even if its finalization failed)
+	// and must be destroyed with Clump::Delete()
+	typedef void F_ClumpLoaded(
+		LoadRequestId _requestId,
+		ELoadStatus _status,
+		Clump* _clump,
+		const LoadRequestStats& _stats,
+		void* _userData
+	);
+
+	// opens the file and queues the clump for loading:
+	// the file is read in the background I/O thread (higher priority and lower file offset first),
+	// the clump is decoded on a worker thread and brought online in FinalizeCompletedRequests()
+	ERet LoadClumpAsync(
+		const AssetID& _id,
+		F_ClumpLoaded* _callback,
+		void* _userData = nil,
+		ELoadPriority _priority = Load_Priority_Normal,
+		LoadRequestId *_requestId = nil
+	);
+
+	// returns LoadStatus_Unloaded if the request is unknown or has already been finalized
+	ELoadStatus GetLoadStatus( LoadRequestId _requestId );
+
+	// the request is dropped as soon as possible (at the latest before finalization),
+	// the callback receives LoadStatus_Cancelled;
+	// returns false if the request is unknown or has already been finalized
+	bool CancelLoadRequest( LoadRequestId _requestId );
+
+	// the number of submitted requests which haven't been finalized yet
+	UINT NumPendingRequests();
+
+	// this function must be called regularly (e.g. per frame)
+	// to complete any pending asset loading operations;
+	// the work can be limited by the number of requests and the time spent (0 = no limit);
+	// returns true if all requests have been processed & completed
+	bool FinalizeCompletedRequests( UINT maxNumRequests = 0, UINT maxMicroseconds = 0 );	//[main thread only]
+
+	// loads the clump many times and cancels each request in a different stage (queued, reading, decoding or completed),
+	// checks that all callbacks report cancellation and that no memory is leaked;
+	// must be called when there are no pending requests
+	ERet TestLoadCancellation( const AssetID& _clumpId, UINT32 _numRequests = 64 );	//[main thread only]
+
 #if 0
 	//
 	// Resource management
@@ -327,15 +401,6 @@ namespace Assets
 		const mxClass& type,
 		CStruct* assetInstance
 		);
-
-	//
-	// Asynchronous I/O
-	//
-
-	// this function must be called regularly (e.g. per frame)
-	// to complete any pending asset loading operations;
-	// returns true if all requests have been processed & completed
-	bool FinalizeCompletedRequests( UINT maxNumRequests = 0 );	//[main thread only]
 #endif
 }//namespace Assets
 
@@ -447,6 +512,7 @@ extern AssetID GetAssetIdFromFilePath( const char* filePath );
 
 //ERet GetAsset( void* o, const AssetKey& key, void* userData = nil );
 ERet LoadAsset( void* o, const AssetKey& key, Clump* clump );
+// synchronous version of Assets::LoadClumpAsync(), the clump must be destroyed with Clump::Delete()
 ERet LoadClump( const AssetID& id, Clump *& clump, void* userData = nil );
 
 template< class ASSET >
@@ -0,0 +1,306 @@
+/*
+=============================================================================
+	File:	AssetPackage.cpp
+	Desc:	Single-file archive of assets (PAK) for shipping builds.
+=============================================================================
+*/
+#include <Core/Core_PCH.h>
+#pragma hdrstop
+#include <Core/Core.h>
+#include <Core/AssetPackage.h>
+
+AssetPackage::AssetPackage()
+{
+	m_data = NULL;
+	m_header = NULL;
+	m_entries = NULL;
+	m_names = NULL;
+	m_fileHandle = INVALID_HANDLE_VALUE;
+	m_mappingHandle = NULL;
+
+	SYSTEM_INFO	systemInfo;
+	::GetSystemInfo( &systemInfo );
+	m_allocationGranularity = systemInfo.dwAllocationGranularity;
+	m_numMappedFiles = 0;
+
+	m_freeList = NULL;
+	for( int i = MAX_OPEN_FILES - 1; i >= 0; i-- ) {
+		m_openFiles[i].entry = NULL;
+		m_openFiles[i].nextFree = m_freeList;
+		m_freeList = &m_openFiles[i];
+	}
+	m_openFilesCS.Initialize();
+}
+
+AssetPackage::~AssetPackage()
+{
+	this->Close();
+	m_openFilesCS.Shutdown();
+}
+
+ERet AssetPackage::Open( const char* _fileName )
+{
+	chkRET_X_IF_NIL(_fileName, ERR_NULL_POINTER_PASSED);
+	mxASSERT(!this->IsOpen());
+
+	m_fileHandle = ::CreateFileA(
+		_fileName,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+		NULL
+	);
+	if( m_fileHandle == INVALID_HANDLE_VALUE ) {
+		ptERROR("Failed to open package '%s'.\n", _fileName);
+		return ERR_FAILED_TO_OPEN_FILE;
+	}
+
+	DWORD fileSizeHigh = 0;
+	const DWORD fileSize = ::GetFileSize( m_fileHandle, &fileSizeHigh );
+	if( fileSizeHigh || fileSize < sizeof(PakHeader) ) {
+		this->Close();
+		return ERR_FAILED_TO_READ_FILE;
+	}
+
+	// the mapping allows copy-on-write views, because clumps are patched when they are loaded in place
+	m_mappingHandle = ::CreateFileMappingA( m_fileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if( !m_mappingHandle ) {
+		this->Close();
+		return ERR_FAILED_TO_OPEN_FILE;
+	}
+
+	// the patched pages of copy-on-write views are private, so this view always sees the original data
+	m_data = (const BYTE*) ::MapViewOfFile( m_mappingHandle, FILE_MAP_READ, 0, 0, 0 );
+	if( !m_data ) {
+		this->Close();
+		return ERR_OUT_OF_MEMORY;	// not enough address space
+	}
+
+	// validate the header and the table of contents
+	const PakHeader* header = (const PakHeader*) m_data;
+	ERet result = ALL_OK;
+	if( header->fourCC != PAK_FOURCC ) {
+		result = ERR_FAILED_TO_PARSE_DATA;
+	} else if( header->version != PAK_VERSION ) {
+		result = ERR_UNSUPPORTED_VERSION;
+	} else if( header->totalSize != fileSize
+		|| header->numEntries > (fileSize - sizeof(PakHeader)) / sizeof(PakEntry)
+		|| header->namesOffset > fileSize
+		|| header->namesSize > fileSize - header->namesOffset
+		|| !header->namesSize
+		|| m_data[ header->namesOffset + header->namesSize - 1 ] != '\0' )
+	{
+		result = ERR_FAILED_TO_PARSE_DATA;
+	}
+	if( mxSUCCEDED(result) )
+	{
+		const PakEntry* entries = (const PakEntry*) (header + 1);
+		for( UINT32 i = 0; i < header->numEntries; i++ )
+		{
+			const PakEntry& entry = entries[i];
+			if( entry.offset > fileSize || entry.packedSize > fileSize - entry.offset || entry.name >= header->namesSize ) {
+				result = ERR_FAILED_TO_PARSE_DATA;
+				break;
+			}
+			if( !(entry.flags & PakEntry_Compressed) && entry.packedSize != entry.size ) {
+				result = ERR_FAILED_TO_PARSE_DATA;
+				break;
+			}
+		}
+	}
+	if( mxFAILED(result) ) {
+		ptERROR("'%s' is not a valid package.\n", _fileName);
+		this->Close();
+		return result;
+	}
+
+	m_header = header;
+	m_entries = (const PakEntry*) (header + 1);
+	m_names = (const char*) m_data + header->namesOffset;
+
+	DBGOUT("Opened package '%s': %u files, %u KiB.\n", _fileName, header->numEntries, fileSize / mxKIBIBYTE);
+
+	return ALL_OK;
+}
+
+void AssetPackage::Close()
+{
+	mxASSERT2(!Assets::IsPackageMounted(this), "unmount the package first");
+	mxASSERT2(!m_numMappedFiles, "destroy the clumps loaded in place first");
+
+	if( m_data ) {
+		::UnmapViewOfFile( m_data );
+		m_data = NULL;
+	}
+	if( m_mappingHandle ) {
+		::CloseHandle( m_mappingHandle );
+		m_mappingHandle = NULL;
+	}
+	if( m_fileHandle != INVALID_HANDLE_VALUE ) {
+		::CloseHandle( m_fileHandle );
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+	m_header = NULL;
+	m_entries = NULL;
+	m_names = NULL;
+}
+
+const PakEntry* AssetPackage::FindEntry( const AssetID& _fileId ) const
+{
+	if( !m_header || AssetId_IsNull(_fileId) ) {
+		return NULL;
+	}
+
+	const UINT32 hash = AssetId_GetHash32( _fileId );
+
+	// find the first entry with the given hash
+	UINT32 lo = 0;
+	UINT32 hi = m_header->numEntries;
+	while( lo < hi )
+	{
+		const UINT32 middle = (lo + hi) / 2;
+		if( m_entries[ middle ].hash < hash ) {
+			lo = middle + 1;
+		} else {
+			hi = middle;
+		}
+	}
+
+	// resolve collisions
+	const char* name = AssetId_ToChars( _fileId );
+	for( UINT32 i = lo; i < m_header->numEntries && m_entries[i].hash == hash; i++ )
+	{
+		if( !strcmp( m_names + m_entries[i].name, name ) ) {
+			return &m_entries[i];
+		}
+	}
+	return NULL;
+}
+
+ERet AssetPackage::OpenFile( const AssetID& fileId, Stream *stream )
+{
+	chkRET_X_IF_NIL(stream, ERR_NULL_POINTER_PASSED);
+
+	const PakEntry* entry = this->FindEntry( fileId );
+	if( !entry ) {
+		return ERR_OBJECT_NOT_FOUND;
+	}
+
+	OpenedFile* file = NULL;
+	{
+		SpinWait::Lock	scopedLock( m_openFilesCS );
+		file = m_freeList;
+		if( file ) {
+			m_freeList = file->nextFree;
+		}
+	}
+	if( !file ) {
+		ptERROR("Too many open files in package.\n");
+		return ERR_TOO_MANY_OBJECTS;
+	}
+
+	file->entry = entry;
+	if( entry->flags & PakEntry_Compressed )
+	{
+		const ERet result = file->decompressor.Initialize( m_data + entry->offset, entry->packedSize, entry->size );
+		if( mxFAILED(result) ) {
+			SpinWait::Lock	scopedLock( m_openFilesCS );
+			file->nextFree = m_freeList;
+			m_freeList = file;
+			return result;
+		}
+	}
+
+	stream->fileHandle = (UINT64) (size_t) file;
+	stream->dataSize = entry->size;
+	stream->offset = 0;
+	stream->sortKey = entry->offset;
+
+	return ALL_OK;
+}
+
+ERet AssetPackage::CloseFile( Stream * stream )
+{
+	chkRET_X_IF_NIL(stream, ERR_NULL_POINTER_PASSED);
+	OpenedFile* file = (OpenedFile*) (size_t) stream->fileHandle;
+	chkRET_X_IF_NIL(file, ERR_INVALID_PARAMETER);
+
+	file->decompressor.Shutdown();
+	file->entry = NULL;
+	{
+		SpinWait::Lock	scopedLock( m_openFilesCS );
+		file->nextFree = m_freeList;
+		m_freeList = file;
+	}
+	stream->fileHandle = 0;
+	return ALL_OK;
+}
+
+ERet AssetPackage::ReadFile( Stream * stream, void *buffer, UINT bytesToRead )
+{
+	chkRET_X_IF_NIL(stream, ERR_NULL_POINTER_PASSED);
+	chkRET_X_IF_NIL(buffer, ERR_NULL_POINTER_PASSED);
+
+	OpenedFile* file = (OpenedFile*) (size_t) stream->fileHandle;
+	chkRET_X_IF_NIL(file, ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(bytesToRead <= stream->dataSize - stream->offset, ERR_FAILED_TO_READ_FILE);
+
+	const PakEntry& entry = *file->entry;
+	if( entry.flags & PakEntry_Compressed )
+	{
+		// the stream can be copied, so its read offset is the authoritative one
+		mxDO(file->decompressor.Seek( stream->offset ));
+		mxDO(file->decompressor.Read( buffer, bytesToRead ));
+	}
+	else
+	{
+		memcpy( buffer, m_data + entry.offset + stream->offset, bytesToRead );
+	}
+	stream->offset += bytesToRead;
+
+	return ALL_OK;
+}
+
+size_t AssetPackage::TellPosition( const Stream& stream ) const
+{
+	return stream.offset;
+}
+
+void* AssetPackage::MapFile( Stream * stream )
+{
+	chkRET_NIL_IF_NIL(stream);
+	const OpenedFile* file = (const OpenedFile*) (size_t) stream->fileHandle;
+	chkRET_NIL_IF_NIL(file);
+
+	const PakEntry& entry = *file->entry;
+	if( entry.flags & PakEntry_Compressed ) {
+		return NULL;
+	}
+
+	// views must start at multiples of the allocation granularity
+	const UINT32 viewOffset = entry.offset & ~(m_allocationGranularity - 1);
+	const UINT32 viewSize = entry.offset + entry.size - viewOffset;
+	BYTE* view = (BYTE*) ::MapViewOfFile( m_mappingHandle, FILE_MAP_COPY, 0, viewOffset, viewSize );
+	if( !view ) {
+		return NULL;	// e.g. not enough address space, the file will be read instead
+	}
+	AtomicIncrement( m_numMappedFiles );
+	return view + (entry.offset - viewOffset);
+}
+
+void AssetPackage::UnmapFile( void* mappedFile )
+{
+	if( mappedFile )
+	{
+		// the view starts at the preceding multiple of the allocation granularity
+		void* view = (void*) ((size_t)mappedFile & ~(size_t)(m_allocationGranularity - 1));
+		::UnmapViewOfFile( view );
+		AtomicDecrement( m_numMappedFiles );
+	}
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
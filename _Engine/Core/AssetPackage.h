@@ -0,0 +1,126 @@
+/*
+=============================================================================
+	File:	AssetPackage.h
+	Desc:	Single-file archive of assets (PAK) for shipping builds.
+	The archive is memory-mapped, opening a file is a binary search
+	in the table of contents, reading is a memcpy (or decompression)
+	from the read-only view, so there are no OS file handles per asset.
+	Uncompressed clump images can be loaded in place from private
+	(copy-on-write) views, their payloads start on page boundaries.
+	Archives are built offline (see EditorSupport/AssetPackager.h).
+=============================================================================
+*/
+#pragma once
+
+#include <Core/Asset.h>
+#include <Core/Util/Compression.h>
+
+/*
+The layout of the archive:
+	PakHeader
+	PakEntry[ numEntries ]	- the table of contents, sorted by hash and name
+	the name table			- null-terminated asset names (for resolving hash collisions)
+	file data				- each file starts at a multiple of the alignment
+							(payloads of clump images start on page boundaries, if possible)
+*/
+enum { PAK_FOURCC = MCHAR4('P','A','K','1') };
+enum { PAK_VERSION = 1 };
+
+struct PakHeader
+{
+	UINT32	fourCC;		// PAK_FOURCC
+	UINT32	version;	// PAK_VERSION
+	UINT32	numEntries;
+	UINT32	namesOffset;// offset of the name table from the start of the archive
+	UINT32	namesSize;	// size of the name table, in bytes
+	UINT32	alignment;	// of file data, power of two
+	UINT32	totalSize;	// size of the archive, in bytes
+	UINT32	_pad;
+};
+mxSTATIC_ASSERT( sizeof(PakHeader) == 32 );
+
+enum EPakEntryFlags
+{
+	PakEntry_Compressed = BIT(0),	// the data is a compressed block stream (see Compression.h)
+};
+
+struct PakEntry
+{
+	UINT32	hash;		// AssetId_GetHash32()
+	UINT32	name;		// offset in the name table
+	UINT32	offset;		// offset of the data from the start of the archive
+	UINT32	size;		// uncompressed size
+	UINT32	packedSize;	// stored size
+	UINT32	flags;		// EPakEntryFlags
+};
+mxSTATIC_ASSERT( sizeof(PakEntry) == 24 );
+
+/*
+-----------------------------------------------------------------------------
+	AssetPackage
+	reads assets from a memory-mapped PAK file
+-----------------------------------------------------------------------------
+*/
+class AssetPackage : public AFilePackage
+{
+public:
+	AssetPackage();
+	~AssetPackage();
+
+	// maps the archive into memory and validates the table of contents
+	ERet Open( const char* _fileName );
+	void Close();
+
+	bool IsOpen() const { return m_data != NULL; }
+
+	// the number of files mapped with MapFile() which haven't been unmapped yet
+	UINT32 NumMappedFiles() const { return m_numMappedFiles; }
+
+	UINT32 NumFiles() const { return m_header ? m_header->numEntries : 0; }
+
+	// returns null if the archive doesn't contain the file
+	const PakEntry* FindEntry( const AssetID& _fileId ) const;
+
+	//@ AFilePackage
+	virtual ERet OpenFile( const AssetID& fileId, Stream *stream ) override;
+	virtual ERet CloseFile( Stream * stream ) override;
+	virtual ERet ReadFile( Stream * stream, void *buffer, UINT bytesToRead ) override;
+	virtual size_t TellPosition( const Stream& stream ) const override;
+	// maps a new copy-on-write view of the file on each call, so that patching it
+	// doesn't affect reads and other loads of the same file
+	virtual void* MapFile( Stream * stream ) override;
+	virtual void UnmapFile( void* mappedFile ) override;
+
+	// the max. number of files which can be open at the same time
+	// (the asynchronous loader keeps the files of all queued requests open)
+	enum { MAX_OPEN_FILES = Assets::MAX_LOAD_REQUESTS + 64 };
+
+private:
+	struct OpenedFile
+	{
+		const PakEntry *				entry;
+		Compression::BlockStreamReader	decompressor;	// used only if the file is compressed
+		OpenedFile *					nextFree;
+	};
+
+	const BYTE *		m_data;		// the read-only view of the whole archive
+	const PakHeader *	m_header;
+	const PakEntry *	m_entries;
+	const char *		m_names;
+
+	HANDLE				m_fileHandle;
+	HANDLE				m_mappingHandle;
+
+	UINT32				m_allocationGranularity;	// views of files start at multiples of it
+	AtomicInt			m_numMappedFiles;
+
+	OpenedFile			m_openFiles[ MAX_OPEN_FILES ];
+	OpenedFile *		m_freeList;
+	SpinWait			m_openFilesCS;
+
+	PREVENT_COPY(AssetPackage);
+};
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -22,6 +22,9 @@
 #include <Core/Input.h>
 #include <Core/bitsquid/memory.h>
 #include <Core/ObjectModel.h>
+#include <Core/JobSystem.h>
+#include <Core/SlowTasks.h>
+#include <Core/EntitySystem.h>
 
 bool AConfigFile::GetInteger( const char* _key, int &_value, int min, int max ) const
 {
@@ -121,6 +124,23 @@ ERet SetupCoreSubsystem()
 
 		//DBGOUT("Initializing Core...\n");
 
+		// Start recording allocations (opt-in, the capture is inspected with MemReport).
+		{
+			const char* captureFileName = gINI->GetString("AllocationCaptureFile", nil);
+			if( captureFileName && captureFileName[0] )
+			{
+				AllocationTrackerSettings	settings;
+				settings.captureFileName = captureFileName;
+				int callstackDepth = settings.maxCallstackDepth;
+				if( gINI->FindInteger("AllocationCallstackDepth", callstackDepth) ) {
+					settings.maxCallstackDepth = Clamp( callstackDepth, 1, 32 );
+				}
+				if( mxFAILED(F_StartAllocationTracking( settings )) ) {
+					ptWARN("Failed to start allocation tracking\n");
+				}
+			}
+		}
+
 		NameID::StaticInitialize();
 
 		gCore.startTime = STimeStamp::GetCurrent();
@@ -190,13 +210,23 @@ ERet SetupCoreSubsystem()
 
 		// Initialize parallel job manager.
 		{
-//			Async::CreationInfo	cInfo;
-
-//			Async::Initialize( cInfo );
+			int numWorkerThreads = 0;	// one per CPU core
+			gINI->GetInteger("NumWorkerThreads", numWorkerThreads, 0, JobSystem::MAX_THREADS-1);
+			mxDO(JobSystem::Initialize( numWorkerThreads ));
 		}
 
+		// Initialize scheduler for tasks spanning several frames (e.g. decoding streamed clumps).
+		mxDO(SlowTasks::Initialize());
+
 		foundation::memory_globals::init();
 
+		// Initialize entity-component system.
+		{
+			int maxEntities = 65536;
+			gINI->GetInteger("MaxEntities", maxEntities, 1024, MAX_ENTITIES);
+			mxDO(EntitySystem::Initialize( maxEntities ));
+		}
+
 		// Initialize frame allocator.
 		{
 			int frameMemorySizeMb = 16;
@@ -206,6 +236,15 @@ ERet SetupCoreSubsystem()
 			mxDO(gCore.frameAlloc.Initialize( frameMemory, frameMemorySizeBytes ));
 		}
 
+		// Initialize transient per-frame memory.
+		{
+			int frameHeapSizeMb = 4;
+			gINI->GetInteger("FrameHeapSizeMb", frameHeapSizeMb, 1, 32);
+			int numFramesInFlight = 3;
+			gINI->GetInteger("NumFramesInFlight", numFramesInFlight, 2, FrameAllocator::MAX_REGIONS);
+			mxDO(gCore.frameHeap.Initialize( frameHeapSizeMb * mxMEBIBYTE, numFramesInFlight, HeapTemp ));
+		}
+
 		// Initialize resource system.
 		mxDO(Assets::Initialize());
 
@@ -239,13 +278,24 @@ void ShutdownCoreSubsystem()
 			gCore.frameAlloc.Shutdown();
 		}
 
+		// Shutdown transient per-frame memory.
+		{
+			FrameAllocatorStats	frameHeapStats;
+			gCore.frameHeap.GetStats( frameHeapStats );
+			DEVOUT("Frame heap: %u bytes per frame, high-water mark: %u bytes, %u overflows\n",
+				frameHeapStats.regionSize, frameHeapStats.highWaterMark, frameHeapStats.numOverflows);
+			gCore.frameHeap.Shutdown();
+		}
+
+		EntitySystem::Shutdown();
+
 		foundation::memory_globals::shutdown();
 
-		//EntitySystem_Close();
+		SlowTasks::Shutdown();
 
 		// Shutdown parallel job manager.
 		{
-//			Async::Shutdown();
+			JobSystem::Shutdown();
 		}
 
 #if MX_EDITOR
@@ -258,6 +308,8 @@ void ShutdownCoreSubsystem()
 
 		NameID::StaticShutdown();
 
+		F_StopAllocationTracking();
+
 		mxShutdownBase();
 	}
 }
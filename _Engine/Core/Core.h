@@ -11,6 +11,8 @@
 #endif //MX_AUTOLINK
 
 #include <Base/Memory/Stack/StackAlloc.h>
+#include <Base/Memory/Frame/FrameAlloc.h>
+#include <Base/Memory/Tracker/AllocationTracker.h>
 
 class ConfigFile;
 class FileSystem;
@@ -109,6 +111,10 @@ struct SCoreGlobals : SingleInstance< SCoreGlobals >
 	// ultra-fast stack-like allocator for short-lived (scratch) per-frame memory on the main thread
 	StackAllocator	frameAlloc;
 
+	// thread-safe allocator for transient memory which must live until the frame is consumed
+	// by the render thread, the GPU or jobs; advanced by llgl::NextFrame()
+	FrameAllocator	frameHeap;
+
 	//String256	basePath;
 
 public:
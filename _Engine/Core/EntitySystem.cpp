@@ -1,12 +1,13 @@
 /*
 =============================================================================
-	File:	Core.cpp
-	Desc:	
+	File:	EntitySystem.cpp
+	Desc:	Entities and components stored in sparse sets.
 =============================================================================
 */
 #include <Core/Core_PCH.h>
 #pragma hdrstop
 #include <Core/Core.h>
+#include <Core/JobSystem.h>
 #include <Core/EntitySystem.h>
 
 mxDEFINE_CLASS(Entity);
@@ -59,7 +60,488 @@ const mxClass* EntityComponent::GetType() const
 
 namespace EntitySystem
 {
-	//
+
+enum
+{
+	ENTITY_INDEX_MASK = (1 << ENTITY_INDEX_BITS) - 1,
+	ENTITY_GENERATION_MASK = (1 << (32 - ENTITY_INDEX_BITS)) - 1,
+};
+mxSTATIC_ASSERT( MAX_ENTITIES <= ENTITY_INDEX_MASK );
+mxSTATIC_ASSERT( MAX_COMPONENT_TYPES <= sizeof(ComponentMask) * BITS_IN_BYTE );
+
+struct EntityRecord
+{
+	ComponentMask	components;	// the components the entity has
+	UINT16			generation;	// incremented when the entity is destroyed
+	UINT16			alive;
+};
+
+// the sparse set of components of the same type
+struct ComponentPool
+{
+	const mxClass *	type;
+	ObjectList *	components;	// the components, packed
+	BYTE *			data;		// the start of the component array
+	UINT32			stride;		// the distance between components, in bytes
+	HEntity *		owners;		// the entity of each component
+	UINT32 *		sparse;		// entity index -> component index (only valid if the entity has the component)
+};
+
+struct EntitySystemData
+{
+	TArray< EntityRecord >	entities;
+	TArray< UINT32 >		freeIndices;	// indices of destroyed entities for reuse
+	UINT32					maxEntities;	// the size of the sparse arrays, grows up to MAX_ENTITIES
+	UINT32					numEntities;	// the number of live entities
+
+	ComponentPool			pools[ MAX_COMPONENT_TYPES ];
+	UINT32					numPools;
+};
+mxDECLARE_PRIVATE_DATA( EntitySystemData, gEntitySystemData );
+
+#define me	mxGET_PRIVATE_DATA( EntitySystemData, gEntitySystemData )
+
+static bool gs_initialized = false;
+
+static inline UINT32 GetEntityIndex( HEntity _entity )
+{
+	return _entity.id & ENTITY_INDEX_MASK;
+}
+static inline UINT32 GetEntityGeneration( HEntity _entity )
+{
+	return _entity.id >> ENTITY_INDEX_BITS;
+}
+static inline HEntity MakeEntityHandle( UINT32 _index, UINT32 _generation )
+{
+	HEntity	handle;
+	handle.id = (_generation << ENTITY_INDEX_BITS) | _index;
+	return handle;
+}
+
+// returns NULL if the entity has been destroyed
+static EntityRecord* GetLiveRecord( HEntity _entity )
+{
+	const UINT32 index = GetEntityIndex( _entity );
+	if( _entity.IsValid() && index < me.entities.Num() )
+	{
+		EntityRecord& record = me.entities[ index ];
+		if( record.alive && record.generation == GetEntityGeneration( _entity ) ) {
+			return &record;
+		}
+	}
+	return NULL;
+}
+
+static ComponentPool* GetPool( HComponentType _type )
+{
+	if( _type.IsValid() && _type.id < me.numPools ) {
+		return &me.pools[ _type.id ];
+	}
+	return NULL;
+}
+
+static inline void* GetComponentAt( const ComponentPool& _pool, UINT32 _componentIndex )
+{
+	return _pool.data + _componentIndex * _pool.stride;
+}
+
+// doubles the number of entities which can be alive at the same time
+static ERet GrowEntityCapacity()
+{
+	chkRET_X_IF_NOT(me.maxEntities < MAX_ENTITIES, ERR_TOO_MANY_OBJECTS);
+
+	const UINT32 newMaxEntities = smallest( me.maxEntities * 2, (UINT32)MAX_ENTITIES );
+
+	// allocate all sparse arrays first so that the pools stay intact if we're out of memory
+	UINT32* newSparse[ MAX_COMPONENT_TYPES ];
+	for( UINT32 i = 0; i < me.numPools; i++ )
+	{
+		newSparse[i] = c_cast(UINT32*) mxAlloc( newMaxEntities * sizeof(UINT32) );
+		if( !newSparse[i] ) {
+			while( i-- ) {
+				mxFree( newSparse[i] );
+			}
+			return ERR_OUT_OF_MEMORY;
+		}
+	}
+
+	for( UINT32 i = 0; i < me.numPools; i++ )
+	{
+		ComponentPool& pool = me.pools[i];
+		memcpy( newSparse[i], pool.sparse, me.maxEntities * sizeof(UINT32) );
+		mxFree( pool.sparse );
+		pool.sparse = newSparse[i];
+	}
+
+	me.maxEntities = newMaxEntities;
+
+	return ALL_OK;
+}
+
+// doubles the capacity of the component pool, the components are moved in memory
+static ERet GrowComponentPool( ComponentPool& _pool )
+{
+	const UINT32 newCapacity = _pool.components->Capacity() * 2;
+
+	HEntity* newOwners = c_cast(HEntity*) mxAlloc( newCapacity * sizeof(HEntity) );
+	chkRET_X_IF_NIL(newOwners, ERR_OUT_OF_MEMORY);
+
+	const ERet result = _pool.components->Grow( newCapacity );
+	if( mxFAILED(result) ) {
+		mxFree( newOwners );
+		return result;
+	}
+
+	memcpy( newOwners, _pool.owners, _pool.components->Num() * sizeof(HEntity) );
+	mxFree( _pool.owners );
+	_pool.owners = newOwners;
+	_pool.data = c_cast(BYTE*) _pool.components->GetArrayPtr();
+
+	return ALL_OK;
+}
+
+ERet Initialize( UINT32 _maxEntities )
+{
+	mxASSERT_MAIN_THREAD;
+	mxASSERT(!gs_initialized);
+	chkRET_X_IF_NOT(_maxEntities > 0 && _maxEntities <= MAX_ENTITIES, ERR_INVALID_PARAMETER);
+
+	mxINITIALIZE_PRIVATE_DATA( gEntitySystemData );
+
+	me.maxEntities = _maxEntities;
+	me.numEntities = 0;
+	me.numPools = 0;
+
+	gs_initialized = true;
+
+	return ALL_OK;
+}
+
+void Shutdown()
+{
+	mxASSERT_MAIN_THREAD;
+	if( !gs_initialized ) {
+		return;
+	}
+
+	for( UINT32 i = 0; i < me.numPools; i++ )
+	{
+		ComponentPool& pool = me.pools[i];
+		pool.components->~ObjectList();	// destroys all components
+		mxFree( pool.components );
+		mxFree( pool.owners );
+		mxFree( pool.sparse );
+	}
+
+	mxSHUTDOWN_PRIVATE_DATA( gEntitySystemData );
+
+	gs_initialized = false;
+}
+
+ERet CreateEntity( HEntity &_entity )
+{
+	mxASSERT_MAIN_THREAD;
+	if( me.numEntities == me.maxEntities ) {
+		mxDO(GrowEntityCapacity());
+	}
+
+	UINT32 index;
+	if( me.freeIndices.Num() ) {
+		index = me.freeIndices.GetLast();
+		me.freeIndices.PopLast();
+	} else {
+		index = me.entities.Num();
+		EntityRecord& newRecord = me.entities.Add();
+		newRecord.generation = 0;
+	}
+
+	EntityRecord& record = me.entities[ index ];
+	record.components = 0;
+	record.alive = true;
+
+	me.numEntities++;
+
+	_entity = MakeEntityHandle( index, record.generation );
+
+	return ALL_OK;
+}
+
+void DestroyEntity( HEntity _entity )
+{
+	mxASSERT_MAIN_THREAD;
+	EntityRecord* record = GetLiveRecord( _entity );
+	if( !record ) {
+		return;
+	}
+
+	ComponentMask components = record->components;
+	while( components )
+	{
+		DWORD bitIndex;
+		_BitScanForward( &bitIndex, components );
+		HComponentType	type;
+		type.id = bitIndex;
+		RemoveComponent( _entity, type );
+		components &= components - 1;
+	}
+
+	record->alive = false;
+	record->generation = (record->generation + 1) & ENTITY_GENERATION_MASK;
+
+	me.freeIndices.Add( GetEntityIndex( _entity ) );
+	me.numEntities--;
+}
+
+bool IsAlive( HEntity _entity )
+{
+	return GetLiveRecord( _entity ) != NULL;
+}
+
+UINT32 NumEntities()
+{
+	return me.numEntities;
+}
+
+ERet RegisterComponentType( const mxClass& _type, UINT32 _capacity, HComponentType &_handle )
+{
+	mxASSERT_MAIN_THREAD;
+	chkRET_X_IF_NOT(FindComponentType( _type ).IsNull(), ERR_SUCH_OBJECT_ALREADY_EXISTS);
+	chkRET_X_IF_NOT(me.numPools < MAX_COMPONENT_TYPES, ERR_TOO_MANY_OBJECTS);
+	chkRET_X_IF_NOT(_type.IsConcrete(), ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(_capacity > 0, ERR_INVALID_PARAMETER);
+
+	void* listStorage = mxAlloc( sizeof(ObjectList) );
+	HEntity* owners = c_cast(HEntity*) mxAlloc( _capacity * sizeof(HEntity) );
+	UINT32* sparse = c_cast(UINT32*) mxAlloc( me.maxEntities * sizeof(UINT32) );
+	if( !listStorage || !owners || !sparse ) {
+		mxFree( listStorage );
+		mxFree( owners );
+		mxFree( sparse );
+		return ERR_OUT_OF_MEMORY;
+	}
+
+	ComponentPool& pool = me.pools[ me.numPools ];
+	pool.type = &_type;
+	pool.components = new(listStorage) ObjectList( _type, _capacity );
+	pool.data = c_cast(BYTE*) pool.components->GetArrayPtr();
+	pool.stride = pool.components->GetStride();
+	pool.owners = owners;
+	pool.sparse = sparse;
+
+	_handle.id = me.numPools++;
+
+	return ALL_OK;
+}
+
+HComponentType FindComponentType( const mxClass& _type )
+{
+	HComponentType	handle;
+	handle.SetNil();
+	for( UINT32 i = 0; i < me.numPools; i++ )
+	{
+		if( me.pools[i].type == &_type ) {
+			handle.id = i;
+			break;
+		}
+	}
+	return handle;
+}
+
+ComponentMask GetComponentMask( HComponentType _type )
+{
+	mxASSERT(GetPool( _type ));
+	return BIT( _type.id );
+}
+
+UINT32 NumComponents( HComponentType _type )
+{
+	const ComponentPool* pool = GetPool( _type );
+	return pool ? pool->components->Num() : 0;
+}
+
+ERet AddComponent( HEntity _entity, HComponentType _type, void *&_component )
+{
+	mxASSERT_MAIN_THREAD;
+	EntityRecord* record = GetLiveRecord( _entity );
+	ComponentPool* pool = GetPool( _type );
+	chkRET_X_IF_NOT(record && pool, ERR_INVALID_PARAMETER);
+
+	const ComponentMask bit = BIT( _type.id );
+	chkRET_X_IF_NOT(!(record->components & bit), ERR_SUCH_OBJECT_ALREADY_EXISTS);
+
+	if( pool->components->Num() == pool->components->Capacity() ) {
+		mxDO(GrowComponentPool( *pool ));
+	}
+
+	// the components are packed, so the new one goes to the end
+	const UINT32 componentIndex = pool->components->Num();
+	CStruct* component = pool->components->Allocate();
+	mxASSERT(component != NULL);
+	mxASSERT(component == GetComponentAt( *pool, componentIndex ));
+
+	pool->type->ConstructInPlace( component );
+	pool->owners[ componentIndex ] = _entity;
+	pool->sparse[ GetEntityIndex( _entity ) ] = componentIndex;
+	record->components |= bit;
+
+	_component = component;
+
+	return ALL_OK;
+}
+
+ERet RemoveComponent( HEntity _entity, HComponentType _type )
+{
+	mxASSERT_MAIN_THREAD;
+	EntityRecord* record = GetLiveRecord( _entity );
+	ComponentPool* pool = GetPool( _type );
+	chkRET_X_IF_NOT(record && pool, ERR_INVALID_PARAMETER);
+
+	const ComponentMask bit = BIT( _type.id );
+	chkRET_X_IF_NOT(record->components & bit, ERR_OBJECT_NOT_FOUND);
+
+	const UINT32 componentIndex = pool->sparse[ GetEntityIndex( _entity ) ];
+	const UINT32 lastIndex = pool->components->Num() - 1;
+
+	// the last component is moved into the hole
+	mxDO(pool->components->DeleteItemAndCompact( GetComponentAt( *pool, componentIndex ) ));
+
+	if( componentIndex != lastIndex )
+	{
+		const HEntity movedEntity = pool->owners[ lastIndex ];
+		pool->owners[ componentIndex ] = movedEntity;
+		pool->sparse[ GetEntityIndex( movedEntity ) ] = componentIndex;
+	}
+
+	record->components &= ~bit;
+
+	return ALL_OK;
+}
+
+void* GetComponent( HEntity _entity, HComponentType _type )
+{
+	const EntityRecord* record = GetLiveRecord( _entity );
+	const ComponentPool* pool = GetPool( _type );
+	if( record && pool && (record->components & BIT( _type.id )) ) {
+		return GetComponentAt( *pool, pool->sparse[ GetEntityIndex( _entity ) ] );
+	}
+	return NULL;
+}
+
+bool HasComponents( HEntity _entity, ComponentMask _mask )
+{
+	const EntityRecord* record = GetLiveRecord( _entity );
+	return record && (record->components & _mask) == _mask;
+}
+
+struct Query
+{
+	const ComponentPool *	pools[ MAX_QUERY_COMPONENTS ];
+	UINT32				numPools;
+	UINT32				driver;	// the pool with the least number of components
+	ComponentMask		mask;
+	UINT32				numComponents;	// in the driver pool
+	F_ProcessChunk *	callback;
+	void *				userData;
+};
+
+static ERet PrepareQuery( const HComponentType* _types, UINT32 _numTypes, F_ProcessChunk* _callback, void* _userData, Query &_query )
+{
+	chkRET_X_IF_NOT(_numTypes > 0 && _numTypes <= MAX_QUERY_COMPONENTS, ERR_INVALID_PARAMETER);
+
+	_query.numPools = _numTypes;
+	_query.driver = 0;
+	_query.mask = 0;
+	_query.callback = _callback;
+	_query.userData = _userData;
+
+	for( UINT32 i = 0; i < _numTypes; i++ )
+	{
+		const ComponentPool* pool = GetPool( _types[i] );
+		chkRET_X_IF_NIL(pool, ERR_INVALID_PARAMETER);
+		_query.pools[i] = pool;
+		_query.mask |= BIT( _types[i].id );
+		if( pool->components->Num() < _query.pools[ _query.driver ]->components->Num() ) {
+			_query.driver = i;
+		}
+	}
+
+	_query.numComponents = _query.pools[ _query.driver ]->components->Num();
+
+	return ALL_OK;
+}
+
+static void ProcessQueryChunk( const Query& _query, UINT _chunkIndex, UINT _slotIndex )
+{
+	HEntity		entities[ QUERY_CHUNK_SIZE ];
+	void *		components[ MAX_QUERY_COMPONENTS ][ QUERY_CHUNK_SIZE ];
+
+	const ComponentPool& driver = *_query.pools[ _query.driver ];
+	const UINT32 start = _chunkIndex * QUERY_CHUNK_SIZE;
+	const UINT32 end = smallest( start + QUERY_CHUNK_SIZE, _query.numComponents );
+
+	UINT32 count = 0;
+	for( UINT32 componentIndex = start; componentIndex < end; componentIndex++ )
+	{
+		const HEntity entity = driver.owners[ componentIndex ];
+		const UINT32 entityIndex = GetEntityIndex( entity );
+		if( (me.entities[ entityIndex ].components & _query.mask) != _query.mask ) {
+			continue;
+		}
+		entities[ count ] = entity;
+		for( UINT32 i = 0; i < _query.numPools; i++ )
+		{
+			const ComponentPool& pool = *_query.pools[i];
+			const UINT32 index = ( i == _query.driver ) ? componentIndex : pool.sparse[ entityIndex ];
+			components[i][ count ] = GetComponentAt( pool, index );
+		}
+		count++;
+	}
+
+	if( count > 0 )
+	{
+		QueryChunk	chunk;
+		chunk.entities = entities;
+		for( UINT32 i = 0; i < _query.numPools; i++ ) {
+			chunk.components[i] = components[i];
+		}
+		chunk.count = count;
+		(*_query.callback)( chunk, _slotIndex, _query.userData );
+	}
+}
+
+static void ProcessQueryChunkCallback( UINT _index, UINT _slotIndex, void* _userData )
+{
+	const Query& query = *static_cast< const Query* >( _userData );
+	ProcessQueryChunk( query, _index, _slotIndex );
+}
+
+ERet ForEach( const HComponentType* _types, UINT32 _numTypes, F_ProcessChunk* _callback, void* _userData )
+{
+	Query	query;
+	mxDO(PrepareQuery( _types, _numTypes, _callback, _userData, query ));
+
+	const UINT32 numChunks = (query.numComponents + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE;
+	for( UINT32 chunkIndex = 0; chunkIndex < numChunks; chunkIndex++ )
+	{
+		ProcessQueryChunk( query, chunkIndex, 0 );
+	}
+
+	return ALL_OK;
+}
+
+ERet ParallelForEach( const HComponentType* _types, UINT32 _numTypes, F_ProcessChunk* _callback, void* _userData )
+{
+	Query	query;
+	mxDO(PrepareQuery( _types, _numTypes, _callback, _userData, query ));
+
+	const UINT32 numChunks = (query.numComponents + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE;
+	if( numChunks > 0 ) {
+		JobSystem::ParallelFor( numChunks, &ProcessQueryChunkCallback, &query );
+	}
+
+	return ALL_OK;
+}
+
 }//namespace EntitySystem
 
 //--------------------------------------------------------------//
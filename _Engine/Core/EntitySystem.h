@@ -1,19 +1,31 @@
 /*
 =============================================================================
-	File:	Core.h
-	Desc:	
+	File:	EntitySystem.h
+	Desc:	Entities and components.
+	Components of each type are stored in a dense array (sparse set):
+	an entity index maps to the component index via a sparse array,
+	so adding, removing and finding components takes constant time,
+	and systems iterate over contiguous arrays of components.
+	References:
+	"ECS back and forth" [Michele Caini, 2019]
 =============================================================================
 */
 #pragma once
 
+#include <Core/ObjectModel.h>
+
 // Upper design limits
 enum {
-	MAX_ENTITIES = 16384
+	// limited by the number of index bits in HEntity
+	MAX_ENTITIES = (1 << 20) - 1
 };
 
 mxDECLARE_32BIT_HANDLE(HEntity);
 mxREFLECT_AS_BUILT_IN_INTEGER(HEntity);
 
+mxDECLARE_8BIT_HANDLE(HComponentType);
+
+// linked list of components, new code should use EntitySystem
 class Entity : public CStruct
 {
 	EntityComponent *	m_components;	// linked list of components
@@ -40,7 +52,88 @@ public:
 
 namespace EntitySystem
 {
-	//
+	enum
+	{
+		// the lower bits of HEntity store the entity index, the upper bits - the generation
+		ENTITY_INDEX_BITS = 20,
+		// the max. number of registered component types
+		MAX_COMPONENT_TYPES = 32,
+		// the max. number of component types in a query
+		MAX_QUERY_COMPONENTS = 8,
+		// the max. number of entities passed to the query callback at once
+		QUERY_CHUNK_SIZE = 256,
+	};
+
+	// each registered component type has its own bit
+	typedef UINT32 ComponentMask;
+
+	// _maxEntities - the initial number of entities which can be alive at the same time,
+	// it's doubled when exceeded (up to MAX_ENTITIES);
+	// called by the core on startup
+	ERet Initialize( UINT32 _maxEntities = 65536 );
+	// destroys all entities and components
+	void Shutdown();
+
+	// NOTE: entities and components can only be created and destroyed on the main thread.
+
+	ERet CreateEntity( HEntity &_entity );
+	// destroys all components of the entity
+	void DestroyEntity( HEntity _entity );
+	bool IsAlive( HEntity _entity );
+	UINT32 NumEntities();
+
+	// Components must be bitwise relocatable: they are moved in memory
+	// when other components of the same type are added or removed,
+	// so pointers to components should not be stored (store entity handles instead).
+	// _capacity - the initial number of components of this type, it's doubled when the pool is full
+	ERet RegisterComponentType( const mxClass& _type, UINT32 _capacity, HComponentType &_handle );
+	// returns a nil handle if the type has not been registered
+	HComponentType FindComponentType( const mxClass& _type );
+	ComponentMask GetComponentMask( HComponentType _type );
+	UINT32 NumComponents( HComponentType _type );
+
+	// creates a component with the default constructor
+	ERet AddComponent( HEntity _entity, HComponentType _type, void *&_component );
+	ERet RemoveComponent( HEntity _entity, HComponentType _type );
+	// returns NULL if the entity doesn't have the component
+	void* GetComponent( HEntity _entity, HComponentType _type );
+	// returns true if the entity has all components from the mask
+	bool HasComponents( HEntity _entity, ComponentMask _mask );
+
+	template< class COMPONENT >
+	ERet AddComponent( HEntity _entity, HComponentType _type, COMPONENT *&_component )
+	{
+		void* component = NULL;
+		mxDO(AddComponent( _entity, _type, component ));
+		_component = static_cast< COMPONENT* >( component );
+		return ALL_OK;
+	}
+	template< class COMPONENT >
+	COMPONENT* GetComponent( HEntity _entity, HComponentType _type )
+	{
+		return static_cast< COMPONENT* >( GetComponent( _entity, _type ) );
+	}
+
+	// a batch of entities having all of the queried components
+	struct QueryChunk
+	{
+		const HEntity *	entities;
+		// components[i][k] - the component of the i-th queried type of the k-th entity
+		void * const *	components[ MAX_QUERY_COMPONENTS ];
+		UINT32			count;
+	};
+
+	// _slotIndex - see JobSystem::ParallelFor()
+	typedef void F_ProcessChunk( const QueryChunk& _chunk, UINT _slotIndex, void* _userData );
+
+	// calls the callback for the entities which have all the given components;
+	// entities are visited in the order of the smallest component array
+	ERet ForEach( const HComponentType* _types, UINT32 _numTypes, F_ProcessChunk* _callback, void* _userData );
+
+	// the same as ForEach(), but the chunks are processed in parallel by the job system;
+	// entities and components must not be created or destroyed until it returns
+	ERet ParallelForEach( const HComponentType* _types, UINT32 _numTypes, F_ProcessChunk* _callback, void* _userData );
+
 }//namespace EntitySystem
 
 //--------------------------------------------------------------//
@@ -0,0 +1,647 @@
+/*
+=============================================================================
+	File:	JobSystem.cpp
+	Desc:	Job scheduler with work-stealing deques.
+=============================================================================
+*/
+#include <Core/Core_PCH.h>
+#pragma hdrstop
+#include <Core/Core.h>
+#include <Core/JobSystem.h>
+
+namespace JobSystem
+{
+
+struct Job
+{
+	F_JobFunction *	function;
+	void *			data;
+	UINT64			arg;
+	JobCounter *	counter;	// (optional) decremented when the job has finished
+	Job *			next;		// in the free list, the injection queue or the list of waiting jobs
+};
+
+/*
+-----------------------------------------------------------------------------
+	A fixed-size work-stealing deque (Chase-Lev).
+	Only the owner thread calls Push() and Pop(), any thread can call Steal().
+	Relies on x86 memory ordering: only the owner's Pop() needs a full barrier
+	(provided by the interlocked exchange).
+-----------------------------------------------------------------------------
+*/
+class WorkStealingQueue
+{
+	enum { CAPACITY = MAX_JOBS, MASK = CAPACITY - 1 };
+	mxSTATIC_ASSERT( (CAPACITY & MASK) == 0 );
+
+	Job * volatile	m_jobs[ CAPACITY ];
+	AtomicInt		m_bottom;	// the next free slot, only modified by the owner thread
+	char			m_pad[ 64 ];// keep 'top' in a different cache line
+	AtomicInt		m_top;		// the oldest job, incremented by thieves
+
+public:
+	WorkStealingQueue()
+	{
+		m_bottom = 0;
+		m_top = 0;
+	}
+
+	// returns false if the deque is full
+	bool Push( Job* _job )
+	{
+		const long b = m_bottom;
+		const long t = m_top;
+		if( b - t >= CAPACITY ) {
+			return false;
+		}
+		m_jobs[ b & MASK ] = _job;
+		_WriteBarrier();
+		m_bottom = b + 1;
+		return true;
+	}
+
+	Job* Pop()
+	{
+		const long b = m_bottom - 1;
+		AtomicExchange( &m_bottom, b );	// full memory barrier before reading 'top'
+		const long t = m_top;
+		if( t <= b )
+		{
+			Job* job = m_jobs[ b & MASK ];
+			if( t != b ) {
+				return job;	// there's still more than one job left
+			}
+			// this is the last job, race against thieves
+			if( !AtomicCAS( &m_top, t, t + 1 ) ) {
+				job = nil;	// lost the race
+			}
+			m_bottom = t + 1;
+			return job;
+		}
+		// the deque is empty
+		m_bottom = t;
+		return nil;
+	}
+
+	Job* Steal()
+	{
+		const long t = m_top;
+		_ReadWriteBarrier();
+		const long b = m_bottom;
+		if( t < b )
+		{
+			Job* job = m_jobs[ t & MASK ];
+			if( AtomicCAS( &m_top, t, t + 1 ) ) {
+				return job;
+			}
+		}
+		return nil;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_bottom <= m_top;
+	}
+};
+
+struct Continuation
+{
+	JobCounter *		counter;
+	F_Continuation *	callback;
+	void *				userData;
+};
+
+struct WorkerThreadData
+{
+	UINT	threadIndex;
+};
+
+struct JobSystemData
+{
+	WorkStealingQueue	queues[ MAX_THREADS ];	// [0] belongs to the main thread
+	Thread				threads[ MAX_THREADS ];	// [0] is not used
+	THREAD_ID			threadIDs[ MAX_THREADS ];
+	WorkerThreadData	workers[ MAX_THREADS ];
+	UINT				numThreads;
+
+	// job storage
+	Job					jobs[ MAX_JOBS ];
+	Job *				freeJobs;
+	SpinWait			freeJobsCS;
+
+	// jobs added from other threads (e.g. the asset loader or the OS callbacks)
+	Job *				injectedHead;
+	Job *				injectedTail;
+	SpinWait			injectedCS;
+
+	// protects JobCounter::waiting lists
+	SpinWait			dependenciesCS;
+
+	TArray< Continuation >	continuations;
+	SpinWait				continuationsCS;
+
+	// sleeping workers wait on the semaphore
+	Semaphore			wakeUp;
+	AtomicInt			numSleepingWorkers;
+
+	AtomicInt			exiting;
+};
+mxDECLARE_PRIVATE_DATA( JobSystemData, gJobSystemData );
+
+#define me	mxGET_PRIVATE_DATA( JobSystemData, gJobSystemData )
+
+static bool gs_initialized = false;
+
+// the number of unsuccessful attempts to find a job before a worker goes to sleep
+enum { NUM_SPINS_BEFORE_SLEEP = 64 };
+
+static Job* AllocateJob()
+{
+	SpinWait::Lock	scopedLock( me.freeJobsCS );
+	Job* job = me.freeJobs;
+	if( job ) {
+		me.freeJobs = job->next;
+	}
+	return job;
+}
+
+static void ReleaseJob( Job* _job )
+{
+	SpinWait::Lock	scopedLock( me.freeJobsCS );
+	_job->next = me.freeJobs;
+	me.freeJobs = _job;
+}
+
+static void WakeUpWorkers( UINT _count )
+{
+	// the interlocked operation is a full barrier: either the sleeping worker sees the new job,
+	// or we see the sleeping worker
+	const int numSleeping = AtomicAdd( me.numSleepingWorkers, 0 );
+	if( numSleeping > 0 ) {
+		me.wakeUp.Signal( smallest( (UINT)numSleeping, _count ) );
+	}
+}
+
+static void InjectJob( Job* _job )
+{
+	SpinWait::Lock	scopedLock( me.injectedCS );
+	_job->next = nil;
+	if( me.injectedTail ) {
+		me.injectedTail->next = _job;
+	} else {
+		me.injectedHead = _job;
+	}
+	me.injectedTail = _job;
+}
+
+static Job* TakeInjectedJob()
+{
+	if( !me.injectedHead ) {
+		return nil;	// early out without locking
+	}
+	SpinWait::Lock	scopedLock( me.injectedCS );
+	Job* job = me.injectedHead;
+	if( job ) {
+		me.injectedHead = job->next;
+		if( !me.injectedHead ) {
+			me.injectedTail = nil;
+		}
+	}
+	return job;
+}
+
+// puts the job into the deque of the calling thread
+static void PushReadyJob( Job* _job, const UINT _threadIndex )
+{
+	if( _threadIndex >= me.numThreads || !me.queues[ _threadIndex ].Push( _job ) ) {
+		InjectJob( _job );
+	}
+}
+
+static Job* FindJob( const UINT _threadIndex )
+{
+	Job* job = nil;
+
+	if( _threadIndex < me.numThreads ) {
+		job = me.queues[ _threadIndex ].Pop();
+		if( job ) {
+			return job;
+		}
+	}
+
+	job = TakeInjectedJob();
+	if( job ) {
+		return job;
+	}
+
+	// try to steal from the other threads, start with the next thread to spread the load
+	const UINT numThreads = me.numThreads;
+	const UINT firstVictim = (_threadIndex < numThreads) ? _threadIndex + 1 : 0;
+	for( UINT i = 0; i < numThreads; i++ )
+	{
+		const UINT victim = (firstVictim + i) % numThreads;
+		if( victim != _threadIndex ) {
+			job = me.queues[ victim ].Steal();
+			if( job ) {
+				return job;
+			}
+		}
+	}
+	return nil;
+}
+
+// decrements the counter and starts the jobs which were waiting for it to drop to zero
+static void DecrementCounter( JobCounter* _counter, const UINT _threadIndex )
+{
+	Job* released = nil;
+	{
+		// the waiting thread may destroy the counter as soon as it drops to zero,
+		// so the waiting list is detached before decrementing
+		SpinWait::Lock	scopedLock( me.dependenciesCS );
+		Job* waiting = _counter->waiting;
+		_counter->waiting = nil;
+		if( AtomicDecrement( _counter->pending ) == 0 ) {
+			released = waiting;
+		} else {
+			_counter->waiting = waiting;
+		}
+	}
+	UINT numReleased = 0;
+	while( released )
+	{
+		Job* next = released->next;
+		PushReadyJob( released, _threadIndex );
+		released = next;
+		numReleased++;
+	}
+	if( numReleased ) {
+		WakeUpWorkers( numReleased );
+	}
+}
+
+static void ExecuteJob( Job* _job, const UINT _threadIndex )
+{
+	(*_job->function)( _job->data, _job->arg, _threadIndex );
+
+	JobCounter* counter = _job->counter;
+	ReleaseJob( _job );
+
+	if( counter ) {
+		DecrementCounter( counter, _threadIndex );
+	}
+}
+
+static UINT32 PASCAL WorkerThreadFunction( void* _userPointer )
+{
+	const WorkerThreadData* worker = static_cast< const WorkerThreadData* >( _userPointer );
+	const UINT threadIndex = worker->threadIndex;
+
+	// must be set before this thread executes any jobs (see GetCurrentThreadIndex())
+	me.threadIDs[ threadIndex ] = ptGetCurrentThreadID();
+
+	UINT numFailedAttempts = 0;
+
+	while( !me.exiting )
+	{
+		Job* job = FindJob( threadIndex );
+		if( job )
+		{
+			ExecuteJob( job, threadIndex );
+			numFailedAttempts = 0;
+			continue;
+		}
+
+		if( ++numFailedAttempts < NUM_SPINS_BEFORE_SLEEP ) {
+			YieldSoftwareThread();
+			continue;
+		}
+
+		// go to sleep, but check for new jobs once again after announcing it
+		AtomicIncrement( me.numSleepingWorkers );
+		job = FindJob( threadIndex );
+		if( job ) {
+			AtomicDecrement( me.numSleepingWorkers );
+			ExecuteJob( job, threadIndex );
+			numFailedAttempts = 0;
+			continue;
+		}
+		if( !me.exiting ) {
+			me.wakeUp.Wait();
+		}
+		AtomicDecrement( me.numSleepingWorkers );
+		numFailedAttempts = 0;
+	}
+
+	return 0;
+}
+
+ERet Initialize( UINT _numWorkerThreads )
+{
+	mxASSERT(!gs_initialized);
+	mxINITIALIZE_PRIVATE_DATA( gJobSystemData );
+
+	if( !_numWorkerThreads ) {
+		_numWorkerThreads = largest( mxGetNumCpuCores(), 1u ) - 1;
+	}
+	if( !MX_MULTITHREADED ) {
+		_numWorkerThreads = 0;
+	}
+	me.numThreads = smallest( _numWorkerThreads + 1, (UINT)MAX_THREADS );
+
+	me.freeJobs = nil;
+	for( int i = MAX_JOBS - 1; i >= 0; i-- ) {
+		me.jobs[i].next = me.freeJobs;
+		me.freeJobs = &me.jobs[i];
+	}
+	me.freeJobsCS.Initialize();
+
+	me.injectedHead = nil;
+	me.injectedTail = nil;
+	me.injectedCS.Initialize();
+
+	me.dependenciesCS.Initialize();
+	me.continuationsCS.Initialize();
+
+	chkRET_X_IF_NOT(me.wakeUp.Initialize( 0, MAX_THREADS * MAX_JOBS ), ERR_UNKNOWN_ERROR);
+	me.numSleepingWorkers = 0;
+	me.exiting = 0;
+
+	for( UINT i = 0; i < MAX_THREADS; i++ ) {
+		me.threadIDs[i] = INVALID_THREAD_ID;
+	}
+	me.threadIDs[0] = ptGetCurrentThreadID();
+
+	// the job system is usable by the main thread from this point
+	gs_initialized = true;
+
+	for( UINT i = 1; i < me.numThreads; i++ )
+	{
+		me.workers[i].threadIndex = i;
+
+		Thread::CInfo	cInfo;
+		cInfo.entryPoint = &WorkerThreadFunction;
+		cInfo.userPointer = &me.workers[i];
+		cInfo.debugName = "JobWorker";
+
+		if( !me.threads[i].Initialize( cInfo ) ) {
+			ptWARN("JobSystem: failed to create worker thread %u\n", i);
+			me.numThreads = i;
+			break;
+		}
+	}
+
+	DBGOUT("JobSystem: %u threads\n", me.numThreads);
+
+	return ALL_OK;
+}
+
+void Shutdown()
+{
+	if( !gs_initialized ) {
+		return;
+	}
+
+	AtomicExchange( &me.exiting, 1 );
+	me.wakeUp.Signal( me.numThreads );
+
+	for( UINT i = 1; i < me.numThreads; i++ )
+	{
+		me.threads[i].Join();
+		me.threads[i].Shutdown();
+	}
+
+	gs_initialized = false;
+
+	me.continuations.Clear();
+	me.wakeUp.Shutdown();
+	me.continuationsCS.Shutdown();
+	me.dependenciesCS.Shutdown();
+	me.injectedCS.Shutdown();
+	me.freeJobsCS.Shutdown();
+
+	mxSHUTDOWN_PRIVATE_DATA( gJobSystemData );
+}
+
+bool IsInitialized()
+{
+	return gs_initialized;
+}
+
+UINT NumThreads()
+{
+	return gs_initialized ? me.numThreads : 1;
+}
+
+UINT GetCurrentThreadIndex()
+{
+	if( !gs_initialized ) {
+		return ~0;
+	}
+	const THREAD_ID currentThreadID = ptGetCurrentThreadID();
+	for( UINT i = 0; i < me.numThreads; i++ ) {
+		if( me.threadIDs[i] == currentThreadID ) {
+			return i;
+		}
+	}
+	return ~0;
+}
+
+void RunJobs( const JobDesc* _jobs, UINT _count, JobCounter* _counter, JobCounter* _dependency )
+{
+	if( _counter ) {
+		AtomicAdd( _counter->pending, _count );
+	}
+
+	if( !gs_initialized )
+	{
+		mxASSERT2( !_dependency || _dependency->IsDone(), "the dependency can never be satisfied" );
+		for( UINT i = 0; i < _count; i++ ) {
+			(*_jobs[i].function)( _jobs[i].data, _jobs[i].arg, ~0 );
+			if( _counter ) {
+				AtomicDecrement( _counter->pending );
+			}
+		}
+		return;
+	}
+
+	const UINT threadIndex = GetCurrentThreadIndex();
+
+	UINT numScheduled = 0;
+
+	for( UINT i = 0; i < _count; i++ )
+	{
+		Job* job = AllocateJob();
+		if( !job )
+		{
+			// out of job slots - execute the job right away
+			if( _dependency ) {
+				WaitForCounter( _dependency );
+			}
+			(*_jobs[i].function)( _jobs[i].data, _jobs[i].arg, threadIndex );
+			if( _counter ) {
+				DecrementCounter( _counter, threadIndex );
+			}
+			continue;
+		}
+
+		job->function = _jobs[i].function;
+		job->data = _jobs[i].data;
+		job->arg = _jobs[i].arg;
+		job->counter = _counter;
+		job->next = nil;
+
+		if( _dependency )
+		{
+			SpinWait::Lock	scopedLock( me.dependenciesCS );
+			if( _dependency->pending > 0 ) {
+				job->next = _dependency->waiting;
+				_dependency->waiting = job;
+				continue;
+			}
+		}
+
+		PushReadyJob( job, threadIndex );
+		numScheduled++;
+	}
+
+	if( numScheduled ) {
+		WakeUpWorkers( numScheduled );
+	}
+}
+
+void RunJob( const JobDesc& _job, JobCounter* _counter, JobCounter* _dependency )
+{
+	RunJobs( &_job, 1, _counter, _dependency );
+}
+
+void WaitForCounter( JobCounter* _counter )
+{
+	if( !gs_initialized ) {
+		mxASSERT(_counter->IsDone());
+		return;
+	}
+	const UINT threadIndex = GetCurrentThreadIndex();
+	while( _counter->pending > 0 )
+	{
+		Job* job = FindJob( threadIndex );
+		if( job ) {
+			ExecuteJob( job, threadIndex );
+		} else {
+			YieldSoftwareThread();
+		}
+	}
+}
+
+struct ParallelForData
+{
+	F_ParallelForCallback *	callback;
+	void *		userData;
+	UINT		count;
+	AtomicInt	nextIndex;	// the next work item to be processed
+	AtomicInt	nextSlot;
+};
+
+static void ProcessParallelForItems( ParallelForData& _data, UINT _slotIndex )
+{
+	for(;;)
+	{
+		const UINT index = AtomicIncrement( _data.nextIndex ) - 1;
+		if( index >= _data.count ) {
+			break;
+		}
+		(*_data.callback)( index, _slotIndex, _data.userData );
+	}
+}
+
+static void ParallelForJob( void* _data, UINT64 _arg, UINT _threadIndex )
+{
+	ParallelForData& data = *static_cast< ParallelForData* >( _data );
+	// slots are assigned when the jobs start, so a thread which runs this job
+	// while waiting inside another callback of the same loop gets a different slot
+	const UINT slotIndex = AtomicIncrement( data.nextSlot ) - 1;
+	ProcessParallelForItems( data, slotIndex );
+}
+
+void ParallelFor( UINT _count, F_ParallelForCallback* _callback, void* _userData, UINT _maxThreads )
+{
+	ParallelForData	data;
+	data.callback = _callback;
+	data.userData = _userData;
+	data.count = _count;
+	data.nextIndex = 0;
+	data.nextSlot = 1;	// the calling thread has slot 0
+
+	UINT numSlots = NumThreads();
+	if( _maxThreads ) {
+		numSlots = smallest( numSlots, _maxThreads );
+	}
+	numSlots = smallest( numSlots, _count );
+
+	JobCounter	counter;
+
+	if( numSlots > 1 )
+	{
+		JobDesc	jobs[ MAX_THREADS ];
+		for( UINT i = 0; i < numSlots - 1; i++ ) {
+			jobs[i].function = &ParallelForJob;
+			jobs[i].data = &data;
+			jobs[i].arg = 0;
+		}
+		RunJobs( jobs, numSlots - 1, &counter );
+	}
+
+	ProcessParallelForItems( data, 0 );
+
+	WaitForCounter( &counter );
+}
+
+void AddContinuation( JobCounter* _counter, F_Continuation* _callback, void* _userData )
+{
+	if( !gs_initialized ) {
+		mxASSERT(_counter->IsDone());
+		(*_callback)( _userData );
+		return;
+	}
+	SpinWait::Lock	scopedLock( me.continuationsCS );
+	Continuation & continuation = me.continuations.Add();
+	continuation.counter = _counter;
+	continuation.callback = _callback;
+	continuation.userData = _userData;
+}
+
+UINT ProcessContinuations()
+{
+	mxASSERT_MAIN_THREAD;
+	if( !gs_initialized ) {
+		return 0;
+	}
+
+	// collect the continuations which are ready, the callbacks may add new continuations
+	Continuation	ready[ 64 ];
+	UINT			numReady = 0;
+	{
+		SpinWait::Lock	scopedLock( me.continuationsCS );
+		UINT iWrite = 0;
+		for( UINT iRead = 0; iRead < me.continuations.Num(); iRead++ )
+		{
+			const Continuation& continuation = me.continuations[ iRead ];
+			if( continuation.counter->IsDone() && numReady < mxCOUNT_OF(ready) ) {
+				ready[ numReady++ ] = continuation;
+			} else {
+				me.continuations[ iWrite++ ] = continuation;
+			}
+		}
+		me.continuations.SetNum( iWrite );
+	}
+
+	for( UINT i = 0; i < numReady; i++ ) {
+		(*ready[i].callback)( ready[i].userData );
+	}
+	return numReady;
+}
+
+}//namespace JobSystem
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
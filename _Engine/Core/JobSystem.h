@@ -0,0 +1,98 @@
+/*
+=============================================================================
+	File:	JobSystem.h
+	Desc:	Job scheduler with one worker thread per CPU core.
+	Each thread owns a lock-free work-stealing deque: jobs are pushed to and
+	popped from the bottom by the owner thread (LIFO, cache-friendly),
+	idle threads steal from the top of other threads' deques (FIFO).
+	Threads that wait for jobs to complete execute other jobs in the meantime,
+	so jobs can spawn and wait for other jobs without deadlocking.
+	References:
+	"Dynamic Circular Work-Stealing Deque" [David Chase, Yossi Lev, 2005]
+	"Parallelizing the Naughty Dog Engine Using Fibers" [Christian Gyrling, GDC 2015]
+=============================================================================
+*/
+#pragma once
+
+namespace JobSystem
+{
+	struct Job;
+}
+
+// counts unfinished jobs; can be used to wait for a group of jobs ('wait-for-N')
+// and to make other jobs depend on the group
+struct JobCounter
+{
+	AtomicInt			pending;	// the number of unfinished jobs
+	JobSystem::Job *	waiting;	// jobs which will be started when 'pending' drops to zero
+public:
+	JobCounter()
+	{
+		pending = 0;
+		waiting = nil;
+	}
+	bool IsDone() const { return pending == 0; }
+	PREVENT_COPY(JobCounter);
+};
+
+// _threadIndex - see JobSystem::GetCurrentThreadIndex()
+typedef void F_JobFunction( void* _data, UINT64 _arg, UINT _threadIndex );
+
+struct JobDesc
+{
+	F_JobFunction *	function;
+	void *			data;
+	UINT64			arg;
+};
+
+namespace JobSystem
+{
+	enum { MAX_THREADS = 16 };	// including the main thread
+
+	// the max. number of jobs which can be in flight at the same time
+	enum { MAX_JOBS = 4096 };
+
+	// _numWorkerThreads = 0 means 'one per CPU core, except for the main thread';
+	// must be called from the main thread
+	ERet Initialize( UINT _numWorkerThreads = 0 );
+	// waits for all worker threads to finish their current jobs, unfinished jobs are discarded
+	void Shutdown();
+	bool IsInitialized();
+
+	// the number of threads executing jobs, including the main thread
+	UINT NumThreads();
+
+	// 0 - the main thread, [1..NumThreads()) - worker threads, ~0 - any other thread
+	UINT GetCurrentThreadIndex();
+
+	// schedules the jobs for execution;
+	// _counter (optional) is incremented by _count and decremented as the jobs finish;
+	// _dependency (optional) - the jobs start only after the counter drops to zero;
+	// if the job system is not initialized, the jobs are executed immediately on the calling thread
+	void RunJobs( const JobDesc* _jobs, UINT _count, JobCounter* _counter = nil, JobCounter* _dependency = nil );
+	void RunJob( const JobDesc& _job, JobCounter* _counter = nil, JobCounter* _dependency = nil );
+
+	// executes other jobs until the counter drops to zero
+	void WaitForCounter( JobCounter* _counter );
+
+	// calls the callback for each index in [0.._count) on the calling thread and worker threads;
+	// _slotIndex is in range [0..min(NumThreads(),_maxThreads)) and is unique among the callbacks running concurrently,
+	// so it can be used to index per-thread scratch data; _maxThreads = 0 means 'use all threads'
+	typedef void F_ParallelForCallback( UINT _index, UINT _slotIndex, void* _userData );
+	void ParallelFor( UINT _count, F_ParallelForCallback* _callback, void* _userData, UINT _maxThreads = 0 );
+
+	// the callback will be called on the main thread from ProcessContinuations()
+	// after the counter has dropped to zero; can be called from any thread
+	typedef void F_Continuation( void* _userData );
+	void AddContinuation( JobCounter* _counter, F_Continuation* _callback, void* _userData );
+
+	// runs the continuations whose counters have dropped to zero and returns their number;
+	// the application must call it from the main thread once per frame (DemoApp::Update() does it),
+	// otherwise the continuations never run
+	UINT ProcessContinuations();
+
+}//namespace JobSystem
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -6,9 +6,11 @@
 */
 #include <Core/Core_PCH.h>
 #pragma hdrstop
+#include <Base/Math/Hashing/HashFunctions.h>
 #include <Core/Core.h>
 
 #include <Core/Asset.h>
+#include <Core/JobSystem.h>
 #include <Core/ObjectModel.h>
 #include <Core/VectorMath.h>
 #include <Core/Serialization.h>
@@ -22,6 +24,45 @@ static inline UINT32 GetItemStride( const mxType& type )
 	return ALIGN16( type.m_size );
 }
 
+// returns the index of the lowest set bit, the word must be non-zero
+static inline UINT32 LowestBitSet64( UINT64 _word )
+{
+	DWORD index;
+	const UINT32 lowBits = (UINT32) _word;
+	if( lowBits ) {
+		_BitScanForward( &index, lowBits );
+		return index;
+	}
+	_BitScanForward( &index, (UINT32)(_word >> 32) );
+	return index + 32;
+}
+
+// returns the live bits of 64 objects starting at _wordIndex * 64
+static inline UINT64 GetLiveBits64( const UINT32* _bits, UINT32 _wordIndex )
+{
+	return UINT64(_bits[ _wordIndex*2 ]) | (UINT64(_bits[ _wordIndex*2 + 1 ]) << 32);
+}
+
+// resizes the mask to a multiple of 64 bits, keeps existing bits and clears the new ones
+static ERet ResizeLiveMask( BitArray & _mask, UINT32 _numBits )
+{
+	const UINT32 numDwords = BitsToUInts( (UINT32) AlignUp( _numBits, 64 ) );
+	UINT32* newBits = NULL;
+	if( numDwords )
+	{
+		newBits = c_cast(UINT32*) mxAlloc( numDwords * sizeof(UINT32) );
+		chkRET_X_IF_NIL(newBits, ERR_OUT_OF_MEMORY);
+
+		const UINT32 numKept = smallest( numDwords, _mask.GetSize() );
+		if( numKept ) {
+			memcpy( newBits, _mask.GetBits(), numKept * sizeof(UINT32) );
+		}
+		memset( newBits + numKept, 0, (numDwords - numKept) * sizeof(UINT32) );
+	}
+	_mask.SetData( newBits, numDwords );	// frees the old bits
+	return ALL_OK;
+}
+
 /*
 -----------------------------------------------------------------------------
 -----------------------------------------------------------------------------
@@ -63,6 +104,9 @@ ObjectList::ObjectList( const mxClass& type, UINT32 capacity )
 	// add all items to the free list
 	m_freeList.Initialize( allocatedBuffer, stride, capacity );
 
+	// if this fails, iterators will walk the free list
+	ResizeLiveMask( m_liveMask, capacity );
+
 	m_capacity = capacity;
 	m_count = 0;
 
@@ -93,6 +137,11 @@ bool ObjectList::HasAddress( const void* ptr ) const
 
 bool ObjectList::HasValidItem( const void* item ) const
 {
+	if( m_liveMask.GetBits() )
+	{
+		const UINT32 itemIndex = this->IndexOfContainedItem( item );
+		return itemIndex != INDEX_NONE && m_liveMask.IsSet( itemIndex );
+	}
 	return this->ContainsItem( item ) && !m_freeList.ItemInFreeList( item );
 }
 
@@ -108,7 +157,7 @@ UINT32 ObjectList::IndexOfContainedItem( const void* item ) const
 		const UINT32 itemSize = this->GetStride();
 		const UINT32 byteOffset = mxGetByteOffset32( m_freeList.m_start, item );
 		mxASSERT( byteOffset % itemSize == 0 );
-		return byteOffset % itemSize;
+		return byteOffset / itemSize;
 	}
 	return INDEX_NONE;
 }
@@ -124,6 +173,10 @@ ERet ObjectList::DeleteItem( void* item )
 
 	if(MX_DEBUG) { memset(item, mxDBG_UNINITIALIZED_MEMORY_TAG, this->GetStride()); }
 
+	if( m_liveMask.GetBits() ) {
+		m_liveMask.ClearBit( this->IndexOfContainedItem( item ) );
+	}
+
 	m_count--;
 
 	// insert the destroyed object into the free list
@@ -133,16 +186,88 @@ ERet ObjectList::DeleteItem( void* item )
 	return ALL_OK;
 }
 
+ERet ObjectList::DeleteItemAndCompact( void* item )
+{
+	chkRET_X_IF_NOT(this->HasValidItem( item ), ERR_OBJECT_NOT_FOUND);
+	mxASSERT(m_count > 0);
+
+	const UINT32 stride = this->GetStride();
+	void* lastItem = this->GetItemAtIndex( m_count - 1 );
+	// the items must be packed, otherwise the last slot may be dead
+	mxASSERT(m_freeList.m_firstFree == NULL || m_freeList.m_firstFree > lastItem);
+
+	m_type->DestroyInstance( item );
+
+	if( item != lastItem ) {
+		memcpy( item, lastItem, stride );
+	}
+
+	if(MX_DEBUG) { memset(lastItem, mxDBG_UNINITIALIZED_MEMORY_TAG, stride); }
+
+	if( m_liveMask.GetBits() ) {
+		m_liveMask.ClearBit( m_count - 1 );
+	}
+
+	m_count--;
+
+	// the last slot becomes the first free item
+	m_freeList.ReleaseSorted( lastItem );
+
+	return ALL_OK;
+}
+
 CStruct* ObjectList::Allocate()
 {
 	CStruct* newItem = c_cast(CStruct*) m_freeList.Allocate();
 	if( newItem != NULL ) {
+		if( m_liveMask.GetBits() ) {
+			m_liveMask.SetBit( this->IndexOfContainedItem( newItem ) );
+		}
 		m_count++;
 		return newItem;
 	}
 	return NULL;
 }
 
+ERet ObjectList::Grow( UINT32 newCapacity )
+{
+	chkRET_X_IF_NOT(newCapacity > m_capacity, ERR_INVALID_PARAMETER);
+	chkRET_X_IF_NOT(m_flags & ObjectList::CanFreeMemory, ERR_INVALID_FUNCTION_CALL);
+
+	const UINT32 stride = this->GetStride();
+	void* oldBuffer = m_freeList.GetBuffer();
+	// the items must be packed, otherwise dead slots would be copied
+	mxASSERT(m_freeList.m_firstFree == NULL || m_freeList.m_firstFree == mxAddByteOffset( oldBuffer, m_count * stride ));
+
+	// the live bits of the packed items stay the same
+	if( m_liveMask.GetBits() ) {
+		mxDO(ResizeLiveMask( m_liveMask, newCapacity ));
+	}
+
+	const size_t bufferSize = newCapacity * stride;
+	void* newBuffer = mxAlloc( bufferSize );
+	chkRET_X_IF_NIL(newBuffer, ERR_OUT_OF_MEMORY);
+	mxASSERT(IS_16_BYTE_ALIGNED(newBuffer));
+
+	if(MX_DEBUG)
+	{
+		memset(newBuffer, mxDBG_UNINITIALIZED_MEMORY_TAG, bufferSize);
+	}
+
+	if( m_count ) {
+		memcpy( newBuffer, oldBuffer, m_count * stride );
+	}
+	mxFree( oldBuffer );
+
+	// the slots after the live items are free
+	m_freeList.Initialize( newBuffer, stride, newCapacity );
+	m_freeList.m_firstFree = mxAddByteOffset( newBuffer, m_count * stride );
+
+	m_capacity = newCapacity;
+
+	return ALL_OK;
+}
+
 UINT32 ObjectList::Num() const
 {
 	return m_count;
@@ -183,6 +308,10 @@ void ObjectList::Empty()
 
 	// add all items to the free list
 	m_freeList.Initialize( m_freeList.GetBuffer(), this->GetStride(), m_capacity );
+
+	if( m_liveMask.GetBits() ) {
+		m_liveMask.ClearAll();
+	}
 }
 
 void ObjectList::Clear()
@@ -203,6 +332,7 @@ void ObjectList::Clear()
 		mxFree(allocatedBuffer);
 		m_freeList.Clear();
 	}
+	m_liveMask.SetData( NULL, 0 );
 	m_capacity = 0;
 
 	m_flags = 0;
@@ -264,6 +394,15 @@ bool ObjectList::IteratorBase::IsValid() const
 void ObjectList::IteratorBase::MoveToNext()
 {
 	mxASSERT(m_remaining > 0);
+	if( m_liveBits )
+	{
+		m_remaining--;
+		m_bits &= m_bits - 1;	// clear the lowest set bit
+		if( m_remaining ) {
+			this->SkipDeadObjects();
+		}
+		return;
+	}
 	// move to the next live object
 	while( m_remaining )
 	{
@@ -294,6 +433,25 @@ UINT32 ObjectList::IteratorBase::NumRemaining() const
 
 UINT32 ObjectList::IteratorBase::NumContiguousObjects() const
 {
+	if( m_liveBits )
+	{
+		// count the set bits starting from the current object
+		UINT32 index = mxGetByteOffset32( m_start, m_current ) / m_stride;
+		UINT32 count = 0;
+		while( count < m_remaining && (index / 64) < m_numWords )
+		{
+			const UINT32 bit = index % 64;
+			// the bits shifted in from above become ones
+			const UINT64 deadBits = ~(GetLiveBits64( m_liveBits, index / 64 ) >> bit);
+			const UINT32 run = deadBits ? LowestBitSet64( deadBits ) : 64;
+			count += run;
+			index += run;
+			if( run < 64 - bit ) {
+				break;	// hit a dead object
+			}
+		}
+		return smallest( count, m_remaining );
+	}
 	return ( m_current < m_nextFree ) ?
 		mxGetByteOffset32( m_current, m_nextFree ) / m_stride
 		:
@@ -308,6 +466,22 @@ void ObjectList::IteratorBase::Initialize( const ObjectList& objectList )
 	m_stride		= objectList.GetStride();
 	m_remaining		= objectList.m_count;
 
+	m_liveBits		= objectList.m_liveMask.GetBits();
+	m_bits			= 0;
+	m_wordIndex		= 0;
+	m_numWords		= objectList.m_liveMask.GetSize() / 2;
+	m_start			= m_current;
+
+	if( m_liveBits )
+	{
+		// scan the live bits 64 objects at a time
+		if( m_remaining ) {
+			m_bits = GetLiveBits64( m_liveBits, 0 );
+			this->SkipDeadObjects();
+		}
+		return;
+	}
+
 	// skip freelisted elements and move to the first valid object
 	while( m_remaining )
 	{
@@ -327,6 +501,11 @@ void ObjectList::IteratorBase::Reset()
 	m_nextFree	= NULL;
 	m_stride	= 0;
 	m_remaining	= 0;
+	m_liveBits	= NULL;
+	m_bits		= 0;
+	m_wordIndex	= 0;
+	m_numWords	= 0;
+	m_start		= NULL;
 }
 
 void* ObjectList::IteratorBase::ToVoidPtr() const
@@ -334,6 +513,659 @@ void* ObjectList::IteratorBase::ToVoidPtr() const
 	return m_current;
 }
 
+// moves to the lowest live bit, skips 64 dead objects at a time
+void ObjectList::IteratorBase::SkipDeadObjects()
+{
+	while( m_bits == 0 && ++m_wordIndex < m_numWords ) {
+		m_bits = GetLiveBits64( m_liveBits, m_wordIndex );
+	}
+	mxASSERT2(m_bits != 0, "the live mask doesn't match the number of objects");
+	if( m_bits ) {
+		const UINT32 index = m_wordIndex * 64 + LowestBitSet64( m_bits );
+		m_current = mxAddByteOffset( m_start, index * m_stride );
+	}
+}
+
+/*
+-----------------------------------------------------------------------------
+	ChunkedObjectList
+-----------------------------------------------------------------------------
+*/
+ChunkedObjectList::ChunkedObjectList( const mxClass& type )
+	: m_type( type )
+{
+	m_stride = GetItemStride( type );
+	m_count = 0;
+	m_firstFreeWord = 0;
+}
+
+ChunkedObjectList::~ChunkedObjectList()
+{
+	this->Clear();
+}
+
+const mxClass& ChunkedObjectList::GetType() const
+{
+	return m_type;
+}
+
+UINT32 ChunkedObjectList::GetStride() const
+{
+	return m_stride;
+}
+
+void* ChunkedObjectList::GetSlot( UINT32 _index ) const
+{
+	BYTE* chunk = m_chunks[ _index / OBJECTS_PER_CHUNK ];
+	return chunk + (_index % OBJECTS_PER_CHUNK) * m_stride;
+}
+
+ERet ChunkedObjectList::AddChunk()
+{
+	void* chunk = mxAlloc( OBJECTS_PER_CHUNK * m_stride );
+	chkRET_X_IF_NIL(chunk, ERR_OUT_OF_MEMORY);
+	chkALIGN(chunk);
+
+	if(MX_DEBUG)
+	{
+		memset(chunk, mxDBG_UNINITIALIZED_MEMORY_TAG, OBJECTS_PER_CHUNK * m_stride);
+	}
+
+	const ERet result = ResizeLiveMask( m_liveMask, (m_chunks.Num() + 1) * OBJECTS_PER_CHUNK );
+	if( mxFAILED(result) ) {
+		mxFree( chunk );
+		return result;
+	}
+
+	m_chunks.Add( c_cast(BYTE*) chunk );
+
+	return ALL_OK;
+}
+
+ERet ChunkedObjectList::Add( UINT32 &_index, void *&_object )
+{
+	// find the first word with a free slot
+	const UINT32 numWords = m_liveMask.GetSize() / 2;
+	UINT32 wordIndex = m_firstFreeWord;
+	while( wordIndex < numWords && GetLiveBits64( m_liveMask.GetBits(), wordIndex ) == ~UINT64(0) ) {
+		wordIndex++;
+	}
+	if( wordIndex == numWords ) {
+		mxDO(this->AddChunk());
+	}
+	m_firstFreeWord = wordIndex;
+
+	const UINT32 bitIndex = LowestBitSet64( ~GetLiveBits64( m_liveMask.GetBits(), wordIndex ) );
+	const UINT32 index = wordIndex * 64 + bitIndex;
+
+	void* o = this->GetSlot( index );
+	m_type.ConstructInPlace( o );
+
+	m_liveMask.SetBit( index );
+	m_count++;
+
+	_index = index;
+	_object = o;
+
+	return ALL_OK;
+}
+
+ERet ChunkedObjectList::Remove( UINT32 _index )
+{
+	chkRET_X_IF_NOT(this->IsLive( _index ), ERR_OBJECT_NOT_FOUND);
+
+	void* o = this->GetSlot( _index );
+	m_type.DestroyInstance( o );
+
+	if(MX_DEBUG) { memset(o, mxDBG_UNINITIALIZED_MEMORY_TAG, m_stride); }
+
+	m_liveMask.ClearBit( _index );
+	m_firstFreeWord = smallest( m_firstFreeWord, _index / 64 );
+	m_count--;
+
+	return ALL_OK;
+}
+
+void* ChunkedObjectList::Get( UINT32 _index ) const
+{
+	return this->IsLive( _index ) ? this->GetSlot( _index ) : NULL;
+}
+
+bool ChunkedObjectList::IsLive( UINT32 _index ) const
+{
+	return _index < this->Capacity() && m_liveMask.IsSet( _index );
+}
+
+UINT32 ChunkedObjectList::Num() const
+{
+	return m_count;
+}
+
+UINT32 ChunkedObjectList::Capacity() const
+{
+	return m_chunks.Num() * OBJECTS_PER_CHUNK;
+}
+
+ERet ChunkedObjectList::Compact( TArray< UINT32 > &_remap )
+{
+	const UINT32 capacity = this->Capacity();
+	mxDO(_remap.SetNum( capacity ));
+
+	for( UINT32 i = 0; i < capacity; i++ ) {
+		_remap[i] = this->IsLive( i ) ? i : INDEX_NONE_32;
+	}
+
+	// move the last live objects into the first holes
+	UINT32 hole = 0;
+	UINT32 last = capacity;
+	for(;;)
+	{
+		while( hole < capacity && this->IsLive( hole ) ) {
+			hole++;
+		}
+		while( last > 0 && !this->IsLive( last - 1 ) ) {
+			last--;
+		}
+		if( hole >= last ) {
+			break;
+		}
+		const UINT32 source = last - 1;
+		memcpy( this->GetSlot( hole ), this->GetSlot( source ), m_stride );
+
+		m_liveMask.SetBit( hole );
+		m_liveMask.ClearBit( source );
+		_remap[ source ] = hole;
+	}
+
+	// release the chunks which are no longer used
+	const UINT32 numUsedChunks = (m_count + OBJECTS_PER_CHUNK - 1) / OBJECTS_PER_CHUNK;
+	mxDO(ResizeLiveMask( m_liveMask, numUsedChunks * OBJECTS_PER_CHUNK ));
+	for( UINT32 i = numUsedChunks; i < m_chunks.Num(); i++ ) {
+		mxFree( m_chunks[i] );
+	}
+	mxDO(m_chunks.SetNum( numUsedChunks ));
+
+	m_firstFreeWord = m_count / 64;
+
+	return ALL_OK;
+}
+
+void ChunkedObjectList::Clear()
+{
+	Iterator	it( *this );
+	while( it.IsValid() )
+	{
+		m_type.DestroyInstance( it.ToVoidPtr() );
+		it.MoveToNext();
+	}
+	for( UINT32 i = 0; i < m_chunks.Num(); i++ ) {
+		mxFree( m_chunks[i] );
+	}
+	m_chunks.Clear();
+	m_liveMask.SetData( NULL, 0 );
+	m_count = 0;
+	m_firstFreeWord = 0;
+}
+
+ChunkedObjectList::Iterator::Iterator( const ChunkedObjectList& _list )
+	: m_list( _list )
+{
+	m_wordIndex = 0;
+	m_index = 0;
+	m_bits = _list.m_liveMask.GetSize() ? GetLiveBits64( _list.m_liveMask.GetBits(), 0 ) : 0;
+	this->SkipDeadObjects();
+}
+
+bool ChunkedObjectList::Iterator::IsValid() const
+{
+	return m_bits != 0;
+}
+
+void ChunkedObjectList::Iterator::MoveToNext()
+{
+	mxASSERT(this->IsValid());
+	m_bits &= m_bits - 1;	// clear the lowest set bit
+	this->SkipDeadObjects();
+}
+
+UINT32 ChunkedObjectList::Iterator::GetIndex() const
+{
+	return m_index;
+}
+
+void* ChunkedObjectList::Iterator::ToVoidPtr() const
+{
+	return m_list.GetSlot( m_index );
+}
+
+void ChunkedObjectList::Iterator::SkipDeadObjects()
+{
+	// skip 64 dead objects at a time
+	const UINT32 numWords = m_list.m_liveMask.GetSize() / 2;
+	while( m_bits == 0 && ++m_wordIndex < numWords ) {
+		m_bits = GetLiveBits64( m_list.m_liveMask.GetBits(), m_wordIndex );
+	}
+	if( m_bits ) {
+		m_index = m_wordIndex * 64 + LowestBitSet64( m_bits );
+	}
+}
+
+/*
+-----------------------------------------------------------------------------
+	ClumpIndex - hash tables for finding objects in a clump
+	by name, by hash and asset exports by asset id and by instance pointer.
+
+	The index is built lazily on the first lookup (or when the clump is brought online).
+	Objects allocated via the clump are queued and inserted on the next lookup
+	(their keys are usually set after allocation), deleted objects are removed immediately,
+	other modifications cause the index to be rebuilt on the next lookup.
+
+	Lookups can run on several threads at once: the first lookup after a modification
+	brings the index up to date under a spin lock, the following lookups don't lock.
+-----------------------------------------------------------------------------
+*/
+namespace
+{
+	// maps 32-bit keys to objects; collisions are resolved by linear probing
+	class ObjectHashTable
+	{
+	public:
+		struct Entry
+		{
+			UINT32			key;
+			void *			object;	// null if the slot is empty
+			const mxClass *	type;	// the class of the object
+		};
+
+	private:
+		Entry *	m_entries;
+		UINT32	m_capacity;	// always a power of two
+		UINT32	m_count;	// the number of used slots
+
+	public:
+		ObjectHashTable()
+		{
+			m_entries = NULL;
+			m_capacity = 0;
+			m_count = 0;
+		}
+		~ObjectHashTable()
+		{
+			this->Clear();
+		}
+
+		UINT32 Num() const
+		{
+			return m_count;
+		}
+
+		// releases allocated memory
+		void Clear()
+		{
+			mxFree( m_entries );
+			m_entries = NULL;
+			m_capacity = 0;
+			m_count = 0;
+		}
+
+		// doesn't release allocated memory
+		void Empty()
+		{
+			for( UINT32 i = 0; i < m_capacity; i++ ) {
+				m_entries[i].object = NULL;
+			}
+			m_count = 0;
+		}
+
+		ERet Insert( UINT32 _key, void* _object, const mxClass* _type )
+		{
+			mxASSERT_PTR(_object);
+			// keep the load factor under 50% so that probe sequences stay short
+			if( (m_count + 1) * 2 > m_capacity ) {
+				mxDO(this->Resize( m_capacity ? m_capacity * 2 : MIN_CAPACITY ));
+			}
+			const UINT32 mask = m_capacity - 1;
+			UINT32 slot = MurmurHash3( _key ) & mask;
+			while( m_entries[ slot ].object ) {
+				slot = (slot + 1) & mask;
+			}
+			Entry & entry = m_entries[ slot ];
+			entry.key = _key;
+			entry.object = _object;
+			entry.type = _type;
+			m_count++;
+			return ALL_OK;
+		}
+
+		// _key - the current key of the object; if the object has been inserted with another key
+		// (e.g. it has been renamed since), the whole table is searched;
+		// returns false if the object was not found
+		bool Remove( UINT32 _key, const void* _object )
+		{
+			if( !m_count ) {
+				return false;
+			}
+			const UINT32 mask = m_capacity - 1;
+			UINT32 slot = MurmurHash3( _key ) & mask;
+			while( m_entries[ slot ].object != _object )
+			{
+				if( !m_entries[ slot ].object ) {
+					return this->RemoveObject( _object );
+				}
+				slot = (slot + 1) & mask;
+			}
+			this->RemoveAt( slot );
+			return true;
+		}
+
+		// the position where the search for the given key begins
+		UINT32 GetStartPosition( UINT32 _key ) const
+		{
+			return m_capacity ? (MurmurHash3( _key ) & (m_capacity - 1)) : 0;
+		}
+
+		// returns the next entry with the given key and advances the position, or NULL if there are no more entries
+		const Entry* FindNext( UINT32 _key, UINT32 &_position ) const
+		{
+			if( !m_count ) {
+				return NULL;
+			}
+			const UINT32 mask = m_capacity - 1;
+			for(;;)
+			{
+				const Entry& entry = m_entries[ _position ];
+				if( !entry.object ) {
+					return NULL;
+				}
+				_position = (_position + 1) & mask;
+				if( entry.key == _key ) {
+					return &entry;
+				}
+			}
+		}
+
+	private:
+		enum { MIN_CAPACITY = 64 };
+
+		// finds the object by its address, the stored key may be stale
+		bool RemoveObject( const void* _object )
+		{
+			for( UINT32 slot = 0; slot < m_capacity; slot++ )
+			{
+				if( m_entries[ slot ].object == _object ) {
+					this->RemoveAt( slot );
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void RemoveAt( UINT32 _slot )
+		{
+			const UINT32 mask = m_capacity - 1;
+			UINT32 hole = _slot;
+			// backward shift deletion (no tombstones): move the following entries of the cluster
+			// into the hole unless the hole lies before their home slots
+			UINT32 next = (hole + 1) & mask;
+			while( m_entries[ next ].object )
+			{
+				const UINT32 home = MurmurHash3( m_entries[ next ].key ) & mask;
+				if( ((next - home) & mask) >= ((next - hole) & mask) )
+				{
+					m_entries[ hole ] = m_entries[ next ];
+					hole = next;
+				}
+				next = (next + 1) & mask;
+			}
+			m_entries[ hole ].object = NULL;
+			m_count--;
+		}
+
+		ERet Resize( UINT32 _newCapacity )
+		{
+			Entry* newEntries = static_cast< Entry* >( mxAlloc( _newCapacity * sizeof(Entry) ) );
+			chkRET_X_IF_NIL(newEntries, ERR_OUT_OF_MEMORY);
+			for( UINT32 i = 0; i < _newCapacity; i++ ) {
+				newEntries[i].object = NULL;
+			}
+			const UINT32 mask = _newCapacity - 1;
+			for( UINT32 i = 0; i < m_capacity; i++ )
+			{
+				const Entry& entry = m_entries[i];
+				if( entry.object )
+				{
+					UINT32 slot = MurmurHash3( entry.key ) & mask;
+					while( newEntries[ slot ].object ) {
+						slot = (slot + 1) & mask;
+					}
+					newEntries[ slot ] = entry;
+				}
+			}
+			mxFree( m_entries );
+			m_entries = newEntries;
+			m_capacity = _newCapacity;
+			return ALL_OK;
+		}
+
+		PREVENT_COPY(ObjectHashTable);
+	};
+
+	// byte offsets of the reflected key fields, -1 if the class doesn't have them
+	struct ClassKeyFields
+	{
+		const mxClass *	type;
+		INT32			nameOffset;	// 'name' of type String
+		INT32			hashOffset;	// 'hash' of type UINT32
+		bool			isAssetExport;
+	};
+
+	struct PendingObject
+	{
+		void *			object;
+		const mxClass *	type;
+	};
+
+	static void FindKeyFields( const mxClass& _type, ClassKeyFields &_keys )
+	{
+		const mxClass* parent = _type.GetParent();
+		if( parent ) {
+			FindKeyFields( *parent, _keys );
+		}
+		const mxClassLayout& layout = _type.GetLayout();
+		for( UINT fieldIndex = 0; fieldIndex < layout.numFields; fieldIndex++ )
+		{
+			const mxField& field = layout.fields[ fieldIndex ];
+			if( field.type.m_kind == ETypeKind::Type_String && !strcmp( field.name, "name" ) ) {
+				_keys.nameOffset = field.offset;
+			}
+			if( field.type.m_kind == ETypeKind::Type_Integer && field.type.m_size == sizeof(UINT32) && !strcmp( field.name, "hash" ) ) {
+				_keys.hashOffset = field.offset;
+			}
+		}
+	}
+
+	static void GetKeyFields( const mxClass& _type, ClassKeyFields &_keys )
+	{
+		_keys.type = &_type;
+		_keys.nameOffset = -1;
+		_keys.hashOffset = -1;
+		_keys.isAssetExport = _type.IsDerivedFrom( AssetExport::MetaClass() );
+		FindKeyFields( _type, _keys );
+	}
+
+	static inline UINT32 GetNameHash( const void* _object, INT32 _nameOffset )
+	{
+		const String& name = *static_cast< const String* >( mxAddByteOffset( _object, _nameOffset ) );
+		return FNV32_StringHash( name.c_str() );
+	}
+	static inline UINT32 GetPointerHash( const void* _pointer )
+	{
+		return (UINT32) size_t(_pointer);
+	}
+}//namespace
+
+struct ClumpIndex
+{
+	ObjectHashTable	byName;		// objects by hashes of their names
+	ObjectHashTable	byHash;		// objects by their 'hash' fields
+	ObjectHashTable	byAssetId;	// asset exports by hashes of asset ids
+	ObjectHashTable	byInstance;	// asset exports by asset instance pointers
+
+	TArray< ClassKeyFields >	classes;	// cached offsets of key fields
+	TArray< PendingObject >		pending;	// allocated, but not yet indexed objects
+
+	bool			needsRebuild;	// the whole clump must be indexed again
+	volatile bool	upToDate;		// if true, readers can use the index without locking
+
+public:
+	ClumpIndex()
+	{
+		needsRebuild = true;
+		upToDate = false;
+	}
+
+	const ClassKeyFields& GetClassKeys( const mxClass& _type )
+	{
+		for( UINT32 i = 0; i < classes.Num(); i++ )
+		{
+			if( classes[i].type == &_type ) {
+				return classes[i];
+			}
+		}
+		ClassKeyFields & newKeys = classes.Add();
+		GetKeyFields( _type, newKeys );
+		return newKeys;
+	}
+
+	ERet Insert( void* _object, const mxClass& _type )
+	{
+		const ClassKeyFields& keys = this->GetClassKeys( _type );
+		if( keys.nameOffset >= 0 ) {
+			mxDO(byName.Insert( GetNameHash( _object, keys.nameOffset ), _object, &_type ));
+		}
+		if( keys.hashOffset >= 0 ) {
+			const UINT32 hash = *static_cast< const UINT32* >( mxAddByteOffset( _object, keys.hashOffset ) );
+			mxDO(byHash.Insert( hash, _object, &_type ));
+		}
+		if( keys.isAssetExport ) {
+			const AssetExport* assetExport = static_cast< const AssetExport* >( _object );
+			mxDO(byAssetId.Insert( AssetId_GetHash32( assetExport->id ), _object, &_type ));
+			mxDO(byInstance.Insert( GetPointerHash( assetExport->o ), _object, &_type ));
+		}
+		return ALL_OK;
+	}
+
+	void Remove( void* _object, const mxClass& _type )
+	{
+		const ClassKeyFields& keys = this->GetClassKeys( _type );
+		if( keys.nameOffset >= 0 ) {
+			byName.Remove( GetNameHash( _object, keys.nameOffset ), _object );
+		}
+		if( keys.hashOffset >= 0 ) {
+			const UINT32 hash = *static_cast< const UINT32* >( mxAddByteOffset( _object, keys.hashOffset ) );
+			byHash.Remove( hash, _object );
+		}
+		if( keys.isAssetExport ) {
+			const AssetExport* assetExport = static_cast< const AssetExport* >( _object );
+			byAssetId.Remove( AssetId_GetHash32( assetExport->id ), _object );
+			byInstance.Remove( GetPointerHash( assetExport->o ), _object );
+		}
+	}
+
+	// the whole clump will be indexed again on the next lookup
+	void Invalidate()
+	{
+		needsRebuild = true;
+		upToDate = false;
+		pending.Empty();
+	}
+
+	ERet Update( const Clump& _clump )
+	{
+		if( needsRebuild )
+		{
+			byName.Empty();
+			byHash.Empty();
+			byAssetId.Empty();
+			byInstance.Empty();
+			pending.Empty();
+
+			ObjectList* current = _clump.GetObjectLists();
+			while(PtrToBool( current ))
+			{
+				const mxClass& type = current->GetType();
+				ObjectList::IteratorBase	it( *current );
+				while( it.IsValid() )
+				{
+					mxDO(this->Insert( it.ToVoidPtr(), type ));
+					it.MoveToNext();
+				}
+				current = current->_next;
+			}
+			needsRebuild = false;
+		}
+		else
+		{
+			for( UINT32 i = 0; i < pending.Num(); i++ ) {
+				mxDO(this->Insert( pending[i].object, *pending[i].type ));
+			}
+			pending.Empty();
+		}
+		return ALL_OK;
+	}
+
+	PREVENT_COPY(ClumpIndex);
+};
+
+// guards building and updating of clump indices
+static AtomicInt gs_clumpIndexLock = 0;
+
+// returns NULL if failed to build the index
+static const ClumpIndex* GetUpToDateIndex( const Clump& _clump )
+{
+	ClumpIndex* index = _clump.m_index;
+	if( index && index->upToDate ) {
+		return index;
+	}
+
+	AtomicLock	scopedLock( &gs_clumpIndexLock );
+
+	index = _clump.m_index;
+	if( !index )
+	{
+		void* storage = mxAlloc( sizeof(ClumpIndex) );
+		chkRET_NIL_IF_NIL(storage);
+		index = new(storage) ClumpIndex();
+		_clump.m_index = index;
+	}
+	if( !index->upToDate )
+	{
+		if( mxFAILED(index->Update( _clump )) ) {
+			ptWARN("Failed to build the clump index\n");
+			index->Invalidate();
+			return NULL;
+		}
+		// make sure the hash tables are written before other threads can see the flag
+		_WriteBarrier();
+		index->upToDate = true;
+	}
+	return index;
+}
+
+static AssetExport* LinearFindAssetExportByPointer( const Clump& clump, const void* assetInstance )
+{
+	TObjectIterator< AssetExport >	it( clump );
+	while( it.IsValid() )
+	{
+		AssetExport& assetExport = it.Value();
+		if( assetExport.o == assetInstance ) {
+			return &assetExport;
+		}
+		it.MoveToNext();
+	}
+	return NULL;
+}
+
 /*
 -----------------------------------------------------------------------------
 -----------------------------------------------------------------------------
@@ -350,6 +1182,9 @@ Clump::Clump()
 {
 	m_objectLists = NULL;
 	m_objectListsStorage.Initialize( sizeof(ObjectList), 16 );
+	m_index = NULL;
+	m_package = NULL;
+	m_mappedFile = NULL;
 	//m_referenceCount = 0;
 	//m_flags = 0;
 }
@@ -357,6 +1192,7 @@ Clump::Clump()
 Clump::~Clump()
 {
 	this->Clear();
+	this->DestroyIndex();
 }
 
 //CStruct* Clump::Allocate( const mxClass& type, UINT32 count )
@@ -404,6 +1240,14 @@ CStruct* Clump::Allocate( const mxClass& type, UINT32 granularity )
 				CStruct* newItem = current->Allocate();
 				if(PtrToBool( newItem ))
 				{
+					// the object will be indexed on the next lookup, when its keys are initialized
+					if( m_index && !m_index->needsRebuild )
+					{
+						PendingObject & pendingObject = m_index->pending.Add();
+						pendingObject.object = newItem;
+						pendingObject.type = &type;
+						m_index->upToDate = false;
+					}
 					return newItem;
 				}
 			}
@@ -445,6 +1289,15 @@ ERet Clump::DeleteOne( const mxClass& type, void* o )
 		if( current->HasValidItem( o ) )
 		{
 			mxASSERT(current->GetType().IsDerivedFrom( type ));
+			if( m_index && !m_index->needsRebuild )
+			{
+				if( m_index->pending.Num() ) {
+					// the object may be in the pending list
+					m_index->Invalidate();
+				} else {
+					m_index->Remove( o, current->GetType() );
+				}
+			}
 			return current->DeleteItem( o );
 		}
 		current = current->_next;
@@ -455,6 +1308,8 @@ ERet Clump::DeleteOne( const mxClass& type, void* o )
 
 void Clump::DeleteAll( const mxClass& type )
 {
+	this->InvalidateIndex();
+
 	ObjectList* current = m_objectLists;
 	while(PtrToBool( current ))
 	{
@@ -472,6 +1327,8 @@ void Clump::DeleteAll( const mxClass& type )
 
 void Clump::RemoveAll( const mxClass& type )
 {
+	this->InvalidateIndex();
+
 	ObjectListIterator it( *this, type );
 	while( it.IsValid() )
 	{
@@ -506,12 +1363,15 @@ ObjectList* Clump::CreateObjectList( const mxClass& type, UINT32 capacity )
 	chkRET_NIL_IF_NIL(storage);
 	ObjectList* objectList = new (storage) ObjectList( type, capacity );
 	objectList->PrependSelfToList( &m_objectLists );
+	// objects can be allocated from the new list directly, bypassing the clump
+	this->InvalidateIndex();
 	return objectList;
 }
 
 void Clump::Clear()
 {
 	this->UnloadAssets();
+	this->InvalidateIndex();
 
 	ObjectList* current = m_objectLists;
 	while(PtrToBool( current ))
@@ -528,6 +1388,7 @@ void Clump::Clear()
 void Clump::Empty()
 {
 	this->UnloadAssets();
+	this->InvalidateIndex();
 
 	ObjectList* current = m_objectLists;
 	while(PtrToBool( current ))
@@ -552,6 +1413,28 @@ bool Clump::IsEmpty() const
 	return m_objectLists == NULL;
 }
 
+ERet Clump::BuildIndex() const
+{
+	chkRET_X_IF_NIL(GetUpToDateIndex( *this ), ERR_OUT_OF_MEMORY);
+	return ALL_OK;
+}
+
+void Clump::InvalidateIndex() const
+{
+	if( m_index ) {
+		m_index->Invalidate();
+	}
+}
+
+void Clump::DestroyIndex()
+{
+	if( m_index ) {
+		m_index->~ClumpIndex();
+		mxFree( m_index );
+		m_index = NULL;
+	}
+}
+
 void Clump::IterateObjects( Reflection::AVisitor* visitor, void* userData ) const
 {
 	ObjectList* current = m_objectLists;
@@ -793,6 +1676,7 @@ ERet Clump::Load( Assets::LoadContext2 & context )
 ERet Clump::Online( Assets::LoadContext2 & context )
 {
 	Clump* clump = static_cast< Clump* >( context.o );
+	mxDO(clump->BuildIndex());
 	mxDO(clump->LoadAssets2());
 	return ALL_OK;
 }
@@ -802,7 +1686,7 @@ void Clump::Offline( Assets::LoadContext2 & context )
 }
 void Clump::Destruct( Assets::LoadContext2 & context )
 {
-	Clump::Free(context.o);
+	Clump::Delete( static_cast< Clump* >( context.o ) );
 }
 void* Clump::Alloc( UINT32 size )
 {
@@ -812,6 +1696,29 @@ void Clump::Free( void* pointer )
 {
 	mxFree(pointer);
 }
+void Clump::SetMappedFile( AFilePackage* package, void* mappedFile )
+{
+	mxASSERT_PTR(package);
+	m_package = package;
+	m_mappedFile = mappedFile;
+}
+void Clump::Delete( Clump* clump )
+{
+	if( clump )
+	{
+		AFilePackage* package = clump->m_package;
+		void* mappedFile = clump->m_mappedFile;
+
+		clump->~Clump();
+
+		if( mappedFile ) {
+			// the clump memory belongs to the view
+			package->UnmapFile( mappedFile );
+		} else {
+			Clump::Free( clump );
+		}
+	}
+}
 
 /*
 -----------------------------------------------------------------------------
@@ -875,18 +1782,193 @@ ObjectList* FindFirstObjectListOfType( const Clump& clump, const mxClass& type )
 
 AssetExport* FindAssetExportByPointer( const Clump& clump, const void* assetInstance )
 {
-	TObjectIterator< AssetExport >	it( clump );
-	while( it.IsValid() )
+	const ClumpIndex* index = GetUpToDateIndex( clump );
+	if( !index ) {
+		return LinearFindAssetExportByPointer( clump, assetInstance );
+	}
+	const UINT32 key = GetPointerHash( assetInstance );
+	UINT32 position = index->byInstance.GetStartPosition( key );
+	while( const ObjectHashTable::Entry* entry = index->byInstance.FindNext( key, position ) )
 	{
-		AssetExport& assetExport = it.Value();
-		if( assetExport.o == assetInstance ) {
-			return &assetExport;
+		AssetExport* assetExport = static_cast< AssetExport* >( entry->object );
+		if( assetExport->o == assetInstance ) {
+			return assetExport;
 		}
-		it.MoveToNext();
 	}
 	return NULL;
 }
 
+AssetExport* FindAssetExport( const Clump& _clump, const AssetKey& _key )
+{
+	const ClumpIndex* index = GetUpToDateIndex( _clump );
+	if( !index )
+	{
+		TObjectIterator< AssetExport >	it( _clump );
+		while( it.IsValid() )
+		{
+			AssetExport& assetExport = it.Value();
+			if( assetExport.type == _key.type && AssetIds_AreEqual( assetExport.id, _key.id ) ) {
+				return &assetExport;
+			}
+			it.MoveToNext();
+		}
+		return NULL;
+	}
+	const UINT32 key = AssetId_GetHash32( _key.id );
+	UINT32 position = index->byAssetId.GetStartPosition( key );
+	while( const ObjectHashTable::Entry* entry = index->byAssetId.FindNext( key, position ) )
+	{
+		AssetExport* assetExport = static_cast< AssetExport* >( entry->object );
+		if( assetExport->type == _key.type && AssetIds_AreEqual( assetExport->id, _key.id ) ) {
+			return assetExport;
+		}
+	}
+	return NULL;
+}
+
+bool FindObjectByName( const Clump& _clump, const mxClass& _type, const char* _name, void *&_o )
+{
+	_o = NULL;
+	ClassKeyFields	keys;
+	GetKeyFields( _type, keys );
+	if( keys.nameOffset < 0 ) {
+		return false;
+	}
+	const ClumpIndex* index = GetUpToDateIndex( _clump );
+	if( !index ) {
+		return false;
+	}
+	const UINT32 key = FNV32_StringHash( _name );
+	UINT32 position = index->byName.GetStartPosition( key );
+	while( const ObjectHashTable::Entry* entry = index->byName.FindNext( key, position ) )
+	{
+		if( entry->type->IsDerivedFrom( _type ) )
+		{
+			const String& name = *static_cast< const String* >( mxAddByteOffset( entry->object, keys.nameOffset ) );
+			if( Str::EqualS( name, _name ) ) {
+				_o = entry->object;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+bool FindObjectByHash( const Clump& _clump, const mxClass& _type, const UINT32 _hash, void *&_o )
+{
+	_o = NULL;
+	ClassKeyFields	keys;
+	GetKeyFields( _type, keys );
+	if( keys.hashOffset < 0 ) {
+		return false;
+	}
+	const ClumpIndex* index = GetUpToDateIndex( _clump );
+	if( !index ) {
+		return false;
+	}
+	UINT32 position = index->byHash.GetStartPosition( _hash );
+	while( const ObjectHashTable::Entry* entry = index->byHash.FindNext( _hash, position ) )
+	{
+		if( entry->type->IsDerivedFrom( _type ) )
+		{
+			const UINT32 hash = *static_cast< const UINT32* >( mxAddByteOffset( entry->object, keys.hashOffset ) );
+			if( hash == _hash ) {
+				_o = entry->object;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+namespace
+{
+	struct ParallelLookupData
+	{
+		const Clump *			clump;
+		AssetExport * const *	exports;
+		AtomicInt				numFailed;
+	};
+	static void ParallelLookupCallback( UINT _index, UINT _slotIndex, void* _userData )
+	{
+		ParallelLookupData& data = *static_cast< ParallelLookupData* >( _userData );
+		const AssetExport* assetExport = data.exports[ _index ];
+		if( FindAssetExportByPointer( *data.clump, assetExport->o ) != assetExport
+			|| FindAssetExport( *data.clump, *assetExport ) != assetExport )
+		{
+			AtomicIncrement( data.numFailed );
+		}
+	}
+}//namespace
+
+ERet BenchmarkClumpIndex( UINT32 _numObjects )
+{
+	chkRET_X_IF_NOT(_numObjects > 0, ERR_INVALID_PARAMETER);
+
+	Clump	clump;
+	TArray< AssetExport* >	exports;
+	mxDO(exports.SetNum( _numObjects ));
+
+	for( UINT32 i = 0; i < _numObjects; i++ )
+	{
+		AssetExport* assetExport;
+		mxDO(clump.New( assetExport, _numObjects ));
+
+		String64	name;
+		Str::SPrintF( name, "asset_%u", i );
+		assetExport->id = MakeAssetID( name.c_str() );
+		assetExport->type = AssetTypes::MESH;
+		assetExport->o = assetExport;	// any unique address will do
+		exports[i] = assetExport;
+	}
+
+	// the linear search is too slow to look up every object
+	const UINT32 numLinearLookups = smallest( _numObjects, 1000u );
+	const UINT32 linearStep = _numObjects / numLinearLookups;
+	UINT32 numFailed = 0;
+
+	UINT64 startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numLinearLookups; i++ )
+	{
+		const AssetExport* assetExport = exports[ i * linearStep ];
+		numFailed += (LinearFindAssetExportByPointer( clump, assetExport->o ) != assetExport);
+	}
+	const UINT64 linearTime = mxGetTimeInMicroseconds() - startTime;
+
+	startTime = mxGetTimeInMicroseconds();
+	mxDO(clump.BuildIndex());
+	const UINT64 buildTime = mxGetTimeInMicroseconds() - startTime;
+
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < _numObjects; i++ )
+	{
+		const AssetExport* assetExport = exports[i];
+		numFailed += (FindAssetExportByPointer( clump, assetExport->o ) != assetExport);
+		numFailed += (FindAssetExport( clump, *assetExport ) != assetExport);
+	}
+	const UINT64 indexedTime = mxGetTimeInMicroseconds() - startTime;
+
+	ParallelLookupData	parallelLookup;
+	parallelLookup.clump = &clump;
+	parallelLookup.exports = exports.ToPtr();
+	parallelLookup.numFailed = 0;
+
+	startTime = mxGetTimeInMicroseconds();
+	JobSystem::ParallelFor( _numObjects, &ParallelLookupCallback, &parallelLookup );
+	const UINT64 parallelTime = mxGetTimeInMicroseconds() - startTime;
+
+	numFailed += parallelLookup.numFailed;
+
+	DBGOUT("Clump index: %u asset exports, built in %u us.\n", _numObjects, (UINT32)buildTime);
+	DBGOUT("Linear search by pointer: %.3f us per lookup (%u lookups).\n",
+		double(linearTime) / numLinearLookups, numLinearLookups);
+	DBGOUT("Indexed search by pointer and id: %.3f us per lookup pair (%u lookups), %.3f us on %u threads.\n",
+		double(indexedTime) / _numObjects, _numObjects, double(parallelTime) / _numObjects, JobSystem::NumThreads());
+
+	chkRET_X_IF_NOT(numFailed == 0, ERR_OBJECT_NOT_FOUND);
+	return ALL_OK;
+}
+
 void DBG_DumpFields( const void* _memory, const mxType& _type, ATextStream &_log )
 {
 	switch( _type.m_kind )
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <Base/Memory/FreeList/FreeList.h>
+#include <Base/Template/Containers/BitSet/BitArray.h>
 
 #include <Core/Core.h>
 #include <Core/Asset.h>
@@ -27,10 +28,13 @@
 	doesn't support polymorphic types.
 
 	Implementation:
-		Once created, an object list cannot be resized.
+		Once created, an object list cannot be resized (except with Grow()).
 		Dead (deleted) objects are kept in a free list sorted by objects' addresses.
 	We sacrifice element contiguity in favor of stability; references and iterators
 	to a given element remain valid as long as the element is not erased.
+		Lists created at run time also keep one 'live' bit per object,
+	so that iterators skip 64 dead objects at a time (see ChunkedObjectList).
+	Lists loaded from memory images don't have live bits and walk the free list.
 -----------------------------------------------------------------------------
 */
 struct ObjectList : public CStruct, public TSinglyLinkedList< ObjectList >
@@ -43,6 +47,8 @@ struct ObjectList : public CStruct, public TSinglyLinkedList< ObjectList >
 	UINT32	m_capacity;	// maximum number of objects that can be stored in this list
 	UINT32	m_flags;
 
+	BitArray	m_liveMask;	// one bit per slot, set if the object is live (not serialized, empty in loaded images)
+
 	enum Flags
 	{
 		CanFreeMemory = BIT(0),
@@ -70,9 +76,17 @@ public:
 	// destroys the object and adds it to the free list
 	ERet DeleteItem( void* item );
 
+	// destroys the object and moves the last object into its place (bitwise copy);
+	// keeps live objects packed in [0..Num()) if they are only deleted with this function
+	ERet DeleteItemAndCompact( void* item );
+
 	// tries to allocate a new item, doesn't call a constructor
 	CStruct* Allocate();
 
+	// reallocates the buffer and moves live objects into it (bitwise copy);
+	// live objects must be packed (see DeleteItemAndCompact()), pointers to them become invalid
+	ERet Grow( UINT32 newCapacity );
+
 	// returns the number of valid objects
 	UINT32 Num() const;
 
@@ -107,6 +121,13 @@ public:
 		UINT32	m_stride;		// byte distance between objects, in bytes
 		UINT32	m_remaining;	// number of remaining (live) objects to iterate over
 
+		// live bits of the list (if it has them)
+		const UINT32 *	m_liveBits;	// NULL if the free list is used
+		UINT64	m_bits;			// remaining live bits of the current 64-bit word
+		UINT32	m_wordIndex;	// index of the current 64-bit word
+		UINT32	m_numWords;		// number of 64-bit words in the live mask
+		void *	m_start;		// pointer to the first slot
+
 	public:
 		IteratorBase();
 		IteratorBase( const ObjectList& objectList );
@@ -133,7 +154,9 @@ public:
 			return *this->ToPtr< CLASS >();
 		}
 
-	private:PREVENT_COPY(IteratorBase);
+	private:
+		void SkipDeadObjects();
+		PREVENT_COPY(IteratorBase);
 	};
 
 private:
@@ -161,6 +184,100 @@ public:
 	}
 };
 
+/*
+-----------------------------------------------------------------------------
+	ChunkedObjectList stores objects of a certain type in fixed-size chunks
+	and keeps one 'live' bit per object instead of a free list.
+
+	Iteration scans the live bits 64 objects at a time,
+	so dead objects cost almost nothing to skip.
+	The list grows by adding new chunks, existing objects are never moved
+	(indices and pointers remain valid) until Compact() is called.
+-----------------------------------------------------------------------------
+*/
+class ChunkedObjectList
+{
+public:
+	enum { OBJECTS_PER_CHUNK = 256 };	// must be a multiple of 64
+
+public:
+	ChunkedObjectList( const mxClass& type );
+	~ChunkedObjectList();
+
+	const mxClass& GetType() const;
+	UINT32 GetStride() const;
+
+	// allocates storage and calls the default constructor;
+	// reuses the first dead slot or adds a new chunk
+	ERet Add( UINT32 &_index, void *&_object );
+
+	// destroys the object, its slot can be reused
+	ERet Remove( UINT32 _index );
+
+	// returns NULL if there's no live object with the given index
+	void* Get( UINT32 _index ) const;
+
+	bool IsLive( UINT32 _index ) const;
+
+	// returns the number of live objects
+	UINT32 Num() const;
+
+	// returns the number of allocated slots
+	UINT32 Capacity() const;
+
+	// moves objects from the end into the holes (bitwise copy) and releases unused chunks;
+	// _remap[ oldIndex ] receives the new index of each live object (INDEX_NONE_32 for dead slots)
+	ERet Compact( TArray< UINT32 > &_remap );
+
+	// destroys all live objects and frees allocated memory
+	void Clear();
+
+public:
+	// iterates over live objects in the order of increasing indices
+	class Iterator
+	{
+		const ChunkedObjectList &	m_list;
+		UINT64	m_bits;			// remaining live bits of the current word
+		UINT32	m_wordIndex;	// index of the current 64-bit word in the live mask
+		UINT32	m_index;		// index of the current object
+
+	public:
+		Iterator( const ChunkedObjectList& _list );
+
+		bool IsValid() const;
+		void MoveToNext();
+
+		UINT32 GetIndex() const;
+		void* ToVoidPtr() const;
+
+		template< class CLASS >
+		inline CLASS* ToPtr() const
+		{
+			return static_cast< CLASS* >( this->ToVoidPtr() );
+		}
+
+	private:
+		void SkipDeadObjects();
+		PREVENT_COPY(Iterator);
+	};
+
+private:
+	void* GetSlot( UINT32 _index ) const;
+	ERet AddChunk();
+
+private:
+	const mxClass &		m_type;
+	TArray< BYTE* >		m_chunks;	// memory blocks of OBJECTS_PER_CHUNK objects
+	BitArray			m_liveMask;	// one bit per slot, set if the object is live
+	UINT32				m_stride;
+	UINT32				m_count;	// number of live objects
+	UINT32				m_firstFreeWord;	// all slots in the preceding 64-bit words are taken
+
+	PREVENT_COPY(ChunkedObjectList);
+};
+
+struct ClumpIndex;
+
 /*
 -----------------------------------------------------------------------------
 	A 'Clump' groups together related objects.
@@ -175,6 +292,9 @@ struct Clump : public CStruct, public TDoublyLinkedList< Clump >//, public Refer
 {
 	ObjectList::Head	m_objectLists;	// head of the linked list of object lists
 	FreeListAllocator	m_objectListsStorage;	// used for recycling object lists
+	mutable ClumpIndex *	m_index;	// hash tables for fast lookups, built lazily (not serialized)
+	AFilePackage *		m_package;		// the package of the mapped file (not serialized)
+	void *				m_mappedFile;	// the package view holding the clump, if it's been loaded in place (not serialized)
 	//UINT32				m_referenceCount;
 	//UINT32				m_flags;
 
@@ -213,6 +333,14 @@ public:
 	void IterateObjects( Reflection::AVisitor* visitor, void* userData ) const;
 	void IterateObjects( Reflection::AVisitor2* visitor, void* userData ) const;
 
+	// builds hash tables for finding objects by name, by hash and asset exports by id and by pointer;
+	// the index is also built on the first lookup and updated when objects are allocated/deleted via the clump.
+	// NOTE: objects allocated directly from object lists and objects whose keys have been changed
+	// after they were looked up are not seen by lookups until InvalidateIndex() is called
+	// (they can still be deleted via the clump).
+	ERet BuildIndex() const;
+	void InvalidateIndex() const;
+
 public:
 	// creates a new object (may reuse existing free-listed items)
 	mxOBSOLETE
@@ -320,8 +448,16 @@ public:
 	static void* Alloc( UINT32 size );
 	static void Free( void* pointer );
 
+	// the clump lives in the view returned by AFilePackage::MapFile(), the view is unmapped by Delete()
+	void SetMappedFile( AFilePackage* package, void* mappedFile );
+	bool IsLoadedInPlace() const { return m_mappedFile != NULL; }
+
+	// destroys the loaded clump and frees its memory (or releases the mapped file if it's been loaded in place)
+	static void Delete( Clump* clump );
+
 private:
 	void UnloadAssets();
+	void DestroyIndex();
 };
 
 //
@@ -352,7 +488,19 @@ struct ClumpList
 };
 
 ObjectList* FindFirstObjectListOfType( const Clump& clump, const mxClass& type );
+
+// Indexed lookups can be called from several threads at once,
+// but not concurrently with functions modifying the clump.
+
 AssetExport* FindAssetExportByPointer( const Clump& clump, const void* assetInstance );
+AssetExport* FindAssetExport( const Clump& _clump, const AssetKey& _key );
+
+// return false if the index cannot be used (e.g. the type doesn't have a reflected 'name' or 'hash' field)
+bool FindObjectByName( const Clump& _clump, const mxClass& _type, const char* _name, void *&_o );
+bool FindObjectByHash( const Clump& _clump, const mxClass& _type, const UINT32 _hash, void *&_o );
+
+// compares linear and indexed lookups of asset exports in a clump
+ERet BenchmarkClumpIndex( UINT32 _numObjects = 100000 );
 
 template< class CLASS >
 CLASS* FindSingleInstance( const Clump& _clump )
@@ -415,6 +563,11 @@ ERet GetSingleInstance( const Clump& _clump, CLASS **_o )
 template< class TYPE >	// where TYPE has member 'name' of type 'String'
 TYPE* FindByName( const Clump& _clump, const char* _name )
 {
+	void* found = NULL;
+	if( FindObjectByName( _clump, TYPE::MetaClass(), _name, found ) ) {
+		return static_cast< TYPE* >( found );
+	}
+	// the name is not reflected - fall back to linear search
 	TObjectIterator< TYPE >	it( _clump );
 	while( it.IsValid() )
 	{
@@ -429,6 +582,11 @@ TYPE* FindByName( const Clump& _clump, const char* _name )
 template< class TYPE >	// where TYPE has member 'hash' of type 'UINT32'
 TYPE* FindByHash( const Clump& _clump, const UINT32 _hash )
 {
+	void* found = NULL;
+	if( FindObjectByHash( _clump, TYPE::MetaClass(), _hash, found ) ) {
+		return static_cast< TYPE* >( found );
+	}
+	// the hash is not reflected - fall back to linear search
 	TObjectIterator< TYPE >	it( _clump );
 	while( it.IsValid() )
 	{
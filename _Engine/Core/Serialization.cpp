@@ -15,7 +15,9 @@
 */
 #include <Core/Core_PCH.h>
 #pragma hdrstop
+#include <Base/Math/Hashing/HashFunctions.h>
 #include <Base/Util/FourCC.h>
+#include <Base/Util/Sorting.h>
 #include <Core/Asset.h>
 #include <Core/Serialization.h>
 #include <Core/Util/ScopedTimer.h>
@@ -47,6 +49,26 @@ namespace Serialization
 
 	enum { OBJECT_BLOB_ALIGNMENT = 16 };
 
+	// The relocation tables start with this header.
+	// (Images saved by older versions start with the number of pointer fixups
+	// and must be visited with reflection after loading.)
+	struct RelocationHeader
+	{
+		UINT32	fourCC;	// RELOCATION_FOURCC
+		UINT32	flags;	// ERelocationFlags
+	};
+	static const UINT32 RELOCATION_FOURCC = MCHAR4('R','E','L','C');
+
+	enum ERelocationFlags
+	{
+		// dynamic arrays, strings and object lists in the image are already marked as not owning their memory
+		Reloc_MemoryOwnershipBaked = BIT(0),
+		// pointers in the image hold offsets of their targets,
+		// the pointer table is a sorted list of delta-encoded pointer offsets
+		Reloc_PointerOffsetsInImage = BIT(1),
+	};
+	enum { CURRENT_RELOCATION_FLAGS = Reloc_MemoryOwnershipBaked|Reloc_PointerOffsetsInImage };
+
 	//
 	// Memory image serialization and in-place loading
 	// NOTE: all pointer offsets are relative to start of object data
@@ -72,6 +94,25 @@ namespace Serialization
 	{
 		SClassId *	o;
 	};
+	// a resolved pointer fixup
+	struct SRelocation
+	{
+		UINT32	pointerOffset;	// file offset of the pointer
+		UINT32	targetOffset;	// file offset of the memory it points at
+	};
+	struct CompareRelocations
+	{
+		bool operator () ( const SRelocation& _a, const SRelocation& _b ) const
+		{
+			return _a.pointerOffset < _b.pointerOffset;
+		}
+	};
+	// an array or a string that must not free its memory after loading
+	struct SMemoryOwner
+	{
+		const void *	address;	// memory address of the array or the string
+		const mxArray *	arrayType;	// null for strings
+	};
 
 	static inline bool ContainsAddress( const SChunk& chunk, const void* pointer )
 	{
@@ -108,6 +149,8 @@ namespace Serialization
 		TArray< SPointer > 	pointers;	// pointers to be patched after loading; they can only point inside the above memory blocks
 		TArray< STypeInfo > typeFixups;	// references to type IDs (serialized as TypeGUIDs)
 		TArray< AssetID* > 	assetIdFixups;
+		TArray< SMemoryOwner >	memoryOwners;	// arrays and strings which will point into the loaded image
+		TArray< const ObjectList* >	objectLists;	// object lists whose storage is in the image
 	public:
 		const SChunk* FindChunk( const void* _memory ) const
 		{
@@ -178,48 +221,153 @@ namespace Serialization
 			offset = AlignUp(offset,OBJECT_BLOB_ALIGNMENT);
 			return offset;
 		}
-		UINT32 WriteChunksAndFixUpTables( AStreamWriter &_stream )
+		// Resolves file offsets of all pointers and their targets, sorts them by pointer offsets and removes duplicates.
+		ERet ResolvePointers( TArray< SRelocation > &_relocations ) const
 		{
-			// Write all memory blocks to file.
-			UINT32 bytesWritten = 0;	//<= not including size of blob header
+			mxDO(_relocations.SetNum( pointers.Num() ));
+			for( UINT32 i = 0; i < pointers.Num(); i++ )
+			{
+				const SPointer& pointer = pointers[ i ];
+				SRelocation & relocation = _relocations[ i ];
+				relocation.pointerOffset = GetFileOffset( pointer.address, chunks );
+				relocation.targetOffset = GetFileOffset( pointer.target, chunks );
+				chkRET_X_IF_NOT(relocation.pointerOffset != NULL_POINTER_OFFSET, ERR_INVALID_PARAMETER);
+				chkRET_X_IF_NOT(relocation.targetOffset != NULL_POINTER_OFFSET, ERR_INVALID_PARAMETER);
+				DBG_MSG("WRITE: Pointer '%s': %u -> %u", pointer.name, relocation.pointerOffset, relocation.targetOffset);
+			}
+			if( _relocations.Num() > 1 )
+			{
+				CompareRelocations	predicate;
+				NxQuickSort< SRelocation, CompareRelocations >( _relocations.ToPtr(), _relocations.ToPtr() + _relocations.Num() - 1, predicate );
+
+				// the same pointer can be visited several times
+				UINT32 numUnique = 1;
+				for( UINT32 i = 1; i < _relocations.Num(); i++ )
+				{
+					if( _relocations[i].pointerOffset != _relocations[ numUnique - 1 ].pointerOffset ) {
+						_relocations[ numUnique++ ] = _relocations[i];
+					} else {
+						mxASSERT(_relocations[i].targetOffset == _relocations[ numUnique - 1 ].targetOffset);
+					}
+				}
+				mxDO(_relocations.SetNum( numUnique ));
+			}
+			return ALL_OK;
+		}
+		// Copies all memory blocks into a contiguous image, stores target offsets in pointers
+		// and marks arrays, strings and object lists in it as not owning their memory,
+		// so that the loader doesn't need to visit them with reflection.
+		// Images in the legacy format are written as they are in memory (without live masks of object lists).
+		ERet BuildImage( UINT32 _imageSize, const TArray< SRelocation >& _relocations, bool _legacyFormat, TArray< BYTE > &_image ) const
+		{
+			mxDO(_image.SetNum( _imageSize ));
+
+			// Fill the padding between memory blocks.
+			UINT32* paddingWords = c_cast(UINT32*) _image.ToPtr();
+			for( UINT32 i = 0; i < _imageSize / sizeof(UINT32); i++ ) {
+				paddingWords[i] = PADDING_VALUE;
+			}
+
 			for( UINT32 iChunk = 0; iChunk < chunks.Num(); iChunk++ )
 			{
 				const SChunk & chunk = chunks[ iChunk ];
-				const UINT32 currentOffset = bytesWritten;
-				const UINT32 alignedOffset = chunk.offset;
-				//mxASSERT2(IsAlignedBy(alignedOffset, chunk.alignment), "data must start at aligned offset");
-				const UINT32 sizeOfPadding = alignedOffset - currentOffset;
-				if( sizeOfPadding > 0 ) {
-					Write_N_bytes( _stream, PADDING_VALUE, sizeOfPadding );
+				mxASSERT(chunk.offset + chunk.size <= _imageSize);
+				memcpy( _image.ToPtr() + chunk.offset, chunk.data, chunk.size );
+			}
+
+			// live masks of object lists are runtime data, lists in images walk their free lists
+			for( UINT32 i = 0; i < objectLists.Num(); i++ )
+			{
+				const UINT32 offset = GetFileOffset( objectLists[ i ], chunks );
+				chkRET_X_IF_NOT(offset != NULL_POINTER_OFFSET, ERR_INVALID_PARAMETER);
+				ObjectList* objectListInImage = c_cast(ObjectList*) (_image.ToPtr() + offset);
+				objectListInImage->m_liveMask.mBits = NULL;
+				objectListInImage->m_liveMask.mSize = 0;
+			}
+
+			if( _legacyFormat ) {
+				return ALL_OK;
+			}
+
+			for( UINT32 i = 0; i < _relocations.Num(); i++ )
+			{
+				const SRelocation& relocation = _relocations[ i ];
+				chkRET_X_IF_NOT(relocation.pointerOffset + sizeof(void*) <= _imageSize, ERR_INVALID_PARAMETER);
+				*c_cast(size_t*) (_image.ToPtr() + relocation.pointerOffset) = relocation.targetOffset;
+			}
+
+			for( UINT32 i = 0; i < memoryOwners.Num(); i++ )
+			{
+				const SMemoryOwner& owner = memoryOwners[ i ];
+				const UINT32 offset = GetFileOffset( owner.address, chunks );
+				chkRET_X_IF_NOT(offset != NULL_POINTER_OFFSET, ERR_INVALID_PARAMETER);
+				void* ownerInImage = _image.ToPtr() + offset;
+				if( owner.arrayType ) {
+					owner.arrayType->SetDontFreeMemory( ownerInImage );
+				} else {
+					static_cast< String* >( ownerInImage )->DoNotFreeMemory();
 				}
-				_stream.Write( chunk.data, chunk.size );
-				bytesWritten += (chunk.size + sizeOfPadding);
 			}
 
+			for( UINT32 i = 0; i < objectLists.Num(); i++ )
+			{
+				const UINT32 offset = GetFileOffset( objectLists[ i ], chunks );
+				chkRET_X_IF_NOT(offset != NULL_POINTER_OFFSET, ERR_INVALID_PARAMETER);
+				ObjectList* objectListInImage = c_cast(ObjectList*) (_image.ToPtr() + offset);
+				objectListInImage->m_flags &= ~ObjectList::CanFreeMemory;
+			}
+
+			return ALL_OK;
+		}
+		// the legacy format (without the relocation header) is only used for benchmarking
+		ERet WriteChunksAndFixUpTables( AStreamWriter &_stream, UINT32 _imageSize, bool _legacyFormat = false )
+		{
+			TArray< SRelocation >	relocations;
+			mxDO(ResolvePointers( relocations ));
+
+			// Write all memory blocks to file.
+			UINT32 bytesWritten = 0;	//<= not including size of blob header
 			{
-				const UINT32 currentOffset = bytesWritten;
-				const UINT32 alignedOffset = AlignUp( currentOffset, OBJECT_BLOB_ALIGNMENT );
-				const UINT32 sizeOfPadding = alignedOffset - currentOffset;
-				Write_N_bytes( _stream, PADDING_VALUE, sizeOfPadding );
-				bytesWritten = alignedOffset;
+				TArray< BYTE >	image;
+				mxDO(BuildImage( _imageSize, relocations, _legacyFormat, image ));
+				mxDO(_stream.Write( image.ToPtr(), image.Num() ));
+				bytesWritten = image.Num();
 			}
 
 			// Relocation data begin starts right after serialized object data.
 			const UINT32 relocationTableOffset = bytesWritten;
 
 			// Append pointer patch tables.
-			const UINT32 numPointerFixups = pointers.Num();
-			_stream << numPointerFixups;
-			for( UINT32 i = 0; i < numPointerFixups; i++ )
+			const UINT32 numPointerFixups = relocations.Num();
+			if( _legacyFormat )
 			{
-				const SPointer& pointer = pointers[ i ];
-				const UINT32 pointerOffset = GetFileOffset( pointer.address, chunks );
-				const UINT32 targetOffset = GetFileOffset( pointer.target, chunks );
-				_stream << pointerOffset;
-				_stream << targetOffset;
-				DBG_MSG("WRITE: Pointer '%s': %u -> %u", pointer.name, pointerOffset, targetOffset);
+				_stream << numPointerFixups;
+				for( UINT32 i = 0; i < numPointerFixups; i++ )
+				{
+					_stream << relocations[i].pointerOffset;
+					_stream << relocations[i].targetOffset;
+				}
+				bytesWritten += sizeof(UINT32) + numPointerFixups * (sizeof(UINT32) * 2);
+			}
+			else
+			{
+				RelocationHeader	relocationHeader;
+				relocationHeader.fourCC = RELOCATION_FOURCC;
+				relocationHeader.flags = CURRENT_RELOCATION_FLAGS;
+				mxDO(_stream.Put( relocationHeader ));
+
+				TArray< BYTE >	encodedOffsets;
+				mxDO(EncodePointerOffsets( relocations, encodedOffsets ));
+				const UINT32 encodedSize = encodedOffsets.Num();
+				const UINT32 alignedSize = TAlignUp< 4 >( encodedSize );	// keep the following tables aligned
+
+				_stream << numPointerFixups;
+				_stream << encodedSize;
+				mxDO(_stream.Write( encodedOffsets.ToPtr(), encodedSize ));
+				Write_N_bytes( _stream, 0, alignedSize - encodedSize );
+
+				bytesWritten += sizeof(relocationHeader) + sizeof(UINT32) * 2 + alignedSize;
 			}
-			bytesWritten += numPointerFixups * (sizeof(UINT32) * 2);
 
 			const UINT32 numTypeFixups = typeFixups.Num();
 			_stream << numTypeFixups;
@@ -256,7 +404,26 @@ namespace Serialization
 			DBG_MSG("WRITE: %u chunks, %u pointers, %u typeIDs, %u assetIDs at %u (totalsize=%u,tablesize=%u)",
 				chunks.Num(),pointers.Num(),typeFixups.Num(),assetIdFixups.Num(),relocationTableOffset,bytesWritten,bytesWritten-relocationTableOffset);
 
-			return relocationTableOffset;
+			return ALL_OK;
+		}
+		// pointer offsets are stored as differences between consecutive offsets, 7 bits per byte,
+		// the high bit is set if more bytes follow (one byte for most pointers)
+		static ERet EncodePointerOffsets( const TArray< SRelocation >& _relocations, TArray< BYTE > &_encoded )
+		{
+			mxDO(_encoded.Reserve( _relocations.Num() + 16 ));
+			UINT32 previousOffset = 0;
+			for( UINT32 i = 0; i < _relocations.Num(); i++ )
+			{
+				UINT32 delta = _relocations[i].pointerOffset - previousOffset;
+				previousOffset = _relocations[i].pointerOffset;
+				while( delta >= 0x80 )
+				{
+					_encoded.Add( BYTE(delta | 0x80) );
+					delta >>= 7;
+				}
+				_encoded.Add( BYTE(delta) );
+			}
+			return ALL_OK;
 		}
 	public:
 		typedef Reflection::AVisitor Super;
@@ -298,6 +465,10 @@ namespace Serialization
 					this->AddChunk( arrayBase, capacity * itemType.m_size, itemType.m_align, _context );
 				}
 			}
+			SMemoryOwner & newOwner = memoryOwners.Add();
+			newOwner.address = _array;
+			newOwner.arrayType = &_type;
+
 			const bool bIterateOverElements = !Type_Is_Bitwise_Serializable( _type.m_itemType.m_kind );
 			return bIterateOverElements;
 		}
@@ -308,6 +479,9 @@ namespace Serialization
 				this->AddChunk( _string.ToPtr(), _string.Length()+1, String::ALIGNMENT, _context );
 				this->AddPointer( _string.GetBufferAddress(), _string.ToPtr(), _context );
 			}
+			SMemoryOwner & newOwner = memoryOwners.Add();
+			newOwner.address = &_string;
+			newOwner.arrayType = NULL;
 		}
 		virtual void Visit_AssetId( AssetID & _assetId, const Context& _context )
 		{
@@ -343,27 +517,99 @@ namespace Serialization
 			_type.GetTypeName(), header.classId, alignedDataSize, sizeof(header) + alignedDataSize);
 
 		// Write all memory blocks and relocation tables.
-		lip.WriteChunksAndFixUpTables( _stream );
+		mxDO(lip.WriteChunksAndFixUpTables( _stream, alignedDataSize ));
 
 		return ALL_OK;
 	}
 
-	static ERet ReadAndApplyFixups( AStreamReader& _reader, void* _objectBuffer, UINT32 _bufferSize )
+	// Patches all pointers in one linear pass over the image:
+	// each pointer holds the offset of its target, the base address is added to it.
+	static ERet ApplyPointerRelocations( void* _objectBuffer, UINT32 _bufferSize, const BYTE* _encodedOffsets, UINT32 _encodedSize, UINT32 _numPointers )
+	{
+		chkRET_X_IF_NOT(_bufferSize >= sizeof(void*), ERR_FAILED_TO_PARSE_DATA);
+
+		char* const base = static_cast< char* >( _objectBuffer );
+		const size_t baseAddress = (size_t) base;
+		const UINT32 maxPointerOffset = _bufferSize - sizeof(void*);
+
+		const BYTE* current = _encodedOffsets;
+		const BYTE* const end = _encodedOffsets + _encodedSize;
+
+		UINT32 pointerOffset = 0;
+		for( UINT32 i = 0; i < _numPointers; i++ )
+		{
+			chkRET_X_IF_NOT(current < end, ERR_FAILED_TO_PARSE_DATA);
+			UINT32 delta = *current++;
+			if( delta & 0x80 )
+			{
+				// rare: long distance between pointers
+				delta &= 0x7F;
+				UINT32 shift = 7;
+				BYTE nextByte;
+				do
+				{
+					chkRET_X_IF_NOT(current < end && shift < 32, ERR_FAILED_TO_PARSE_DATA);
+					nextByte = *current++;
+					delta |= UINT32(nextByte & 0x7F) << shift;
+					shift += 7;
+				}
+				while( nextByte & 0x80 );
+			}
+
+			chkRET_X_IF_NOT(delta <= maxPointerOffset - pointerOffset, ERR_FAILED_TO_PARSE_DATA);
+			pointerOffset += delta;
+
+			size_t* pointer = c_cast(size_t*) (base + pointerOffset);
+			chkRET_X_IF_NOT(*pointer < _bufferSize, ERR_FAILED_TO_PARSE_DATA);
+			*pointer += baseAddress;
+		}
+		return ALL_OK;
+	}
+
+	// returns ERelocationFlags in '_flags'
+	static ERet ReadAndApplyFixups( AStreamReader& _reader, void* _objectBuffer, UINT32 _bufferSize, UINT32 &_flags )
 	{
 		// Load and apply fixup tables.
-		// Relocate pointers.
 		UINT32 numPointerFixups;
-		_reader.Get(numPointerFixups);
-		for( UINT32 i = 0; i < numPointerFixups; i++ )
+		mxDO(_reader.Get(numPointerFixups));
+
+		_flags = 0;
+		if( numPointerFixups == RELOCATION_FOURCC )
 		{
-			UINT32 pointerOffset;
-			UINT32 targetOffset;
-			mxDO(_reader.Get(pointerOffset));
-			mxDO(_reader.Get(targetOffset));
+			mxDO(_reader.Get(_flags));
+			mxDO(_reader.Get(numPointerFixups));
+		}
 
-			void* pointerAddress = mxAddByteOffset( _objectBuffer, pointerOffset );
-			void* targetAddress = mxAddByteOffset( _objectBuffer, targetOffset );
-			*((void**)pointerAddress) = targetAddress;
+		// Relocate pointers.
+		if( _flags & Reloc_PointerOffsetsInImage )
+		{
+			UINT32 encodedSize;
+			mxDO(_reader.Get(encodedSize));
+			if( numPointerFixups )
+			{
+				TArray< BYTE >	encodedOffsets;
+				mxDO(encodedOffsets.SetNum( TAlignUp< 4 >( encodedSize ) ));
+				mxDO(_reader.Read( encodedOffsets.ToPtr(), encodedOffsets.Num() ));
+				mxDO(ApplyPointerRelocations( _objectBuffer, _bufferSize, encodedOffsets.ToPtr(), encodedSize, numPointerFixups ));
+			}
+			else
+			{
+				chkRET_X_IF_NOT(encodedSize == 0, ERR_FAILED_TO_PARSE_DATA);
+			}
+		}
+		else
+		{
+			for( UINT32 i = 0; i < numPointerFixups; i++ )
+			{
+				UINT32 pointerOffset;
+				UINT32 targetOffset;
+				mxDO(_reader.Get(pointerOffset));
+				mxDO(_reader.Get(targetOffset));
+
+				void* pointerAddress = mxAddByteOffset( _objectBuffer, pointerOffset );
+				void* targetAddress = mxAddByteOffset( _objectBuffer, targetOffset );
+				*((void**)pointerAddress) = targetAddress;
+			}
 		}
 		// Fixup type ids.
 		UINT32 numTypeFixups;
@@ -394,13 +640,21 @@ namespace Serialization
 		return ALL_OK;
 	}
 
-	static ERet ReadAndApplyFixups( void* objectBuffer, UINT32 objectDataSize, void* fixupTables, UINT32 tableDataSize )
+	static ERet ReadAndApplyFixups( void* objectBuffer, UINT32 objectDataSize, void* fixupTables, UINT32 tableDataSize, UINT32 &_flags )
 	{
 		MemoryReader	stream( fixupTables, tableDataSize );
-		mxDO(ReadAndApplyFixups( stream, objectBuffer, objectDataSize ));
+		mxDO(ReadAndApplyFixups( stream, objectBuffer, objectDataSize, _flags ));
 		return ALL_OK;
 	}
 
+	// images saved by older versions don't know that their arrays and strings don't own memory
+	static void MarkMemoryIfNeeded( void* _objectData, const mxClass& _type, UINT32 _relocationFlags )
+	{
+		if( !(_relocationFlags & Reloc_MemoryOwnershipBaked) ) {
+			Reflection::MarkMemoryAsExternallyAllocated( _objectData, _type );
+		}
+	}
+
 	template< class HEADER >
 	static ERet ValidatePlatformAndType( const HEADER& header, const mxClass& type )
 	{
@@ -435,8 +689,9 @@ namespace Serialization
 		mxDO(stream.Read(buffer.ToPtr(), header.payload));
 
 		header.payload = AlignUp( header.payload, OBJECT_BLOB_ALIGNMENT );
-		mxDO(ReadAndApplyFixups( stream, buffer.ToPtr(), buffer.Num() ));
-		Reflection::MarkMemoryAsExternallyAllocated( buffer.ToPtr(), type );
+		UINT32 relocationFlags = 0;
+		mxDO(ReadAndApplyFixups( stream, buffer.ToPtr(), buffer.Num(), relocationFlags ));
+		MarkMemoryIfNeeded( buffer.ToPtr(), type, relocationFlags );
 
 		return ALL_OK;
 	}
@@ -453,8 +708,9 @@ namespace Serialization
 		void* fixupsData = mxAddByteOffset(objectData, header.payload);
 		UINT32 tableSize = length - sizeof(ImageHeader) - header.payload;
 
-		mxDO(ReadAndApplyFixups(objectData, header.payload, fixupsData, tableSize));
-		Reflection::MarkMemoryAsExternallyAllocated( objectData, type );
+		UINT32 relocationFlags = 0;
+		mxDO(ReadAndApplyFixups(objectData, header.payload, fixupsData, tableSize, relocationFlags));
+		MarkMemoryIfNeeded( objectData, type, relocationFlags );
 
 		o = objectData;
 
@@ -471,8 +727,9 @@ namespace Serialization
 		mxDO(ValidateSizeAndAlignment(header, type, buffer, length));
 
 		mxDO(stream.Read( buffer, header.payload ));
-		mxDO(ReadAndApplyFixups( stream, buffer, header.payload ));
-		Reflection::MarkMemoryAsExternallyAllocated( buffer, type );
+		UINT32 relocationFlags = 0;
+		mxDO(ReadAndApplyFixups( stream, buffer, header.payload, relocationFlags ));
+		MarkMemoryIfNeeded( buffer, type, relocationFlags );
 
 		return ALL_OK;
 	}
@@ -480,95 +737,592 @@ namespace Serialization
 	//
 	// Binary serialization
 	//
+	// The file starts with the schemas of all stored types followed by the object data.
+	// Each value is written in the order of the fields in its schema,
+	// dense structs made only of POD fields are written as raw memory.
+	// On loading, the stored fields are matched against the current fields by name hash:
+	// fields which are no longer present or have changed their type are skipped,
+	// new fields keep their default values,
+	// and values whose layout hasn't changed are read with a single memcpy.
+	//
 
-	ERet SaveBinary( const void* o, const mxClass& _type, AStreamWriter &stream )
+	// The schema table starts with this header.
+	struct SchemaHeader
 	{
-		BinaryHeader	header;
+		UINT32	numTypes;	// number of type records
+		UINT32	numFields;	// number of field records
+	};
+	// describes a stored type
+	struct STypeRecord
+	{
+		UINT32	nameHash;	// TypeID for classes, hash of the type name otherwise
+		UINT32	size;		// size of the type, in bytes
+		UINT8	kind;		// ETypeKind
+		UINT8	flags;		// ETypeRecordFlags
+		UINT16	numFields;	// classes: number of fields, including inherited ones
+		UINT32	first;		// classes: index of the first field record, arrays: index of the item type
+	};
+	ASSERT_SIZEOF(STypeRecord, 16);
+	// describes a field of a stored class
+	struct SFieldRecord
+	{
+		UINT32	nameHash;	// hash of the field name
+		UINT32	offset;		// byte offset of the field in the class
+		UINT32	type;		// index of the type record
+	};
+	enum ETypeRecordFlags
+	{
+		// the value is stored as a raw copy of its memory
+		Schema_Bitwise = BIT(0),
+	};
+
+	static const UINT32 SCHEMA_FOURCC = MCHAR4('S','C','H','M');
+	static const UINT32 NO_TYPE_INDEX = ~0UL;
+
+	// collects the fields of the class and its parents (in this order)
+	static void CollectFields( const mxClass& _type, TArray< const mxField* > &_fields )
+	{
+		const mxClass* parent = _type.GetParent();
+		if( parent ) {
+			CollectFields( *parent, _fields );
+		}
+		const mxClassLayout& layout = _type.GetLayout();
+		for( UINT fieldIndex = 0; fieldIndex < layout.numFields; fieldIndex++ )
 		{
-			header.session = PtSessionInfo::CURRENT;
-			header.classId = _type.GetTypeID();
+			_fields.Add( &layout.fields[ fieldIndex ] );
 		}
-		mxDO(stream.Put(header));
+	}
 
+	static ERet SkipBytes( AStreamReader& _stream, UINT32 _size )
+	{
+		char	buffer[256];
+		while( _size > 0 )
+		{
+			const UINT32 chunkSize = smallest( _size, (UINT32)sizeof(buffer) );
+			mxDO(_stream.Read( buffer, chunkSize ));
+			_size -= chunkSize;
+		}
+		return ALL_OK;
+	}
 
-		class BinarySerializer : public Reflection::Visitor3< AStreamWriter& > {
-		public:
-			BinarySerializer()
-			{}
-			virtual ERet Visit_Field( void * _memory, const mxField& _field, const Context3& _context, AStreamWriter &_stream )
+	class SchemaWriter
+	{
+		TArray< const mxType* >	m_types;	// current types, parallel to m_records
+		TArray< STypeRecord >	m_records;
+		TArray< SFieldRecord >	m_fields;
+		TArray< const mxField* >	m_fieldInfo;	// current fields, parallel to m_fields
+
+	public:
+		// returns the index of the type record
+		UINT32 AddType( const mxType& _type )
+		{
+			for( UINT32 i = 0; i < m_types.Num(); i++ )
 			{
-#if DEBUG_SERIALIZATION
-				String256 tmp;
-				Str::SPrintF(tmp,"[FIELD: %s (%s)]",_field.name,_field.type.GetTypeName());
-				mxDO(tmp.SaveToStream(_stream));
-#endif
-				mxDO(this->Visit( _memory, _field.type, _context, _stream ));
-				return ALL_OK;
+				if( m_types[i] == &_type ) {
+					return i;
+				}
 			}
-			virtual ERet Visit_Array( void * _array, const mxArray& _type, const Context3& _context, AStreamWriter &_stream ) override
+
+			const UINT32 typeIndex = m_types.Num();
+			m_types.Add( &_type );
+
+			STypeRecord& record = m_records.Add();
+			record.nameHash = FNV32_StringHash( _type.GetTypeName() );
+			record.size = _type.m_size;
+			record.kind = _type.m_kind;
+			record.flags = Type_Is_Bitwise_Serializable( _type.m_kind ) ? Schema_Bitwise : 0;
+			record.numFields = 0;
+			record.first = NO_TYPE_INDEX;
+
+			if( _type.m_kind == Type_Class )
 			{
-#if DEBUG_SERIALIZATION
-				String256 tmp;
-				Str::SPrintF(tmp,"[ARRAY: %s (%u items, %u bytes)]",_type.GetTypeName(),_type.Generic_Get_Count( _array ),_type.CalculateDataSize(_array));
-				mxDO(tmp.SaveToStream(_stream));
-#endif
+				const mxClass& classType = _type.UpCast< mxClass >();
 
-				const UINT32 arrayCount = _type.Generic_Get_Count( _array );
-				mxDO(_stream.Put( arrayCount ));
+				TArray< const mxField* >	fields;
+				CollectFields( classType, fields );
+				mxASSERT( fields.Num() <= MAX_UINT16 );
 
-				const mxType& itemType = _type.m_itemType;
-				const UINT32 itemStride = itemType.m_size;
-				void* arrayBase = _type.Generic_Get_Data( _array );
+				const UINT32 firstField = m_fields.Num();
+				m_fields.SetNum( firstField + fields.Num() );
+				m_fieldInfo.SetNum( firstField + fields.Num() );
 
-				const bool isPOD = Type_Is_Bitwise_Serializable( itemType.m_kind );
-				if( isPOD ) {
-					mxDO(_stream.Write( arrayBase, arrayCount * itemStride ));
-				} else {
-					mxDO(Reflection::Visit_Array_Elements< AStreamWriter& >( arrayBase, arrayCount, itemType, _context, *this, _stream ));
+				// the struct can be stored as raw memory if its fields cover it without gaps
+				bool isBitwise = true;
+				UINT32 totalSize = 0;
+
+				for( UINT32 i = 0; i < fields.Num(); i++ )
+				{
+					const mxField& field = *fields[i];
+					// NOTE: may add new records, don't hold references across this call
+					const UINT32 fieldType = this->AddType( field.type );
+
+					SFieldRecord& fieldRecord = m_fields[ firstField + i ];
+					fieldRecord.nameHash = FNV32_StringHash( field.name );
+					fieldRecord.offset = field.offset;
+					fieldRecord.type = fieldType;
+					m_fieldInfo[ firstField + i ] = &field;
+
+					isBitwise &= ( m_records[ fieldType ].flags & Schema_Bitwise ) != 0;
+					totalSize += field.type.m_size;
 				}
 
-				return ALL_OK;
+				STypeRecord& classRecord = m_records[ typeIndex ];
+				classRecord.nameHash = classType.GetTypeID();
+				classRecord.numFields = fields.Num();
+				classRecord.first = firstField;
+				if( isBitwise && fields.Num() && totalSize == classType.m_size ) {
+					classRecord.flags |= Schema_Bitwise;
+				}
 			}
-			virtual ERet Visit_POD( void * _memory, const mxType& type, const Context3& _context, AStreamWriter &_stream ) override
+			else if( _type.m_kind == Type_Array )
 			{
-				mxDO(_stream.Write( _memory, type.m_size ));
+				const mxArray& arrayType = _type.UpCast< mxArray >();
+				const UINT32 itemType = this->AddType( arrayType.m_itemType );
+				m_records[ typeIndex ].first = itemType;
+			}
+
+			return typeIndex;
+		}
+
+		ERet WriteSchema( AStreamWriter &_stream ) const
+		{
+			SchemaHeader	header;
+			header.numTypes = m_records.Num();
+			header.numFields = m_fields.Num();
+			mxDO(_stream.Put( header ));
+			mxDO(_stream.Write( m_records.ToPtr(), m_records.GetDataSize() ));
+			mxDO(_stream.Write( m_fields.ToPtr(), m_fields.GetDataSize() ));
+			return ALL_OK;
+		}
+
+		ERet WriteValue( const void* _memory, UINT32 _typeIndex, AStreamWriter &_stream ) const
+		{
+			const STypeRecord& record = m_records[ _typeIndex ];
+			const mxType& type = *m_types[ _typeIndex ];
+
+			if( record.flags & Schema_Bitwise ) {
+				mxDO(_stream.Write( _memory, record.size ));
 				return ALL_OK;
 			}
-			virtual ERet Visit_String( String * _string, const Context3& _context, AStreamWriter &_stream ) override
+
+			switch( type.m_kind )
 			{
-				mxDO(_string->SaveToStream( _stream ));
-				return ALL_OK;
+			case Type_Class :
+				for( UINT32 i = 0; i < record.numFields; i++ )
+				{
+					const UINT32 fieldIndex = record.first + i;
+					const void* fieldMemory = mxAddByteOffset( _memory, m_fieldInfo[ fieldIndex ]->offset );
+					mxDO(this->WriteValue( fieldMemory, m_fields[ fieldIndex ].type, _stream ));
+				}
+				break;
+
+			case Type_Array :
+				{
+					const mxArray& arrayType = type.UpCast< mxArray >();
+					const UINT32 arrayCount = arrayType.Generic_Get_Count( _memory );
+					mxDO(_stream.Put( arrayCount ));
+
+					const void* arrayBase = arrayType.Generic_Get_Data( _memory );
+					const UINT32 itemStride = arrayType.m_itemType.m_size;
+
+					if( m_records[ record.first ].flags & Schema_Bitwise ) {
+						mxDO(_stream.Write( arrayBase, arrayCount * itemStride ));
+					} else {
+						for( UINT32 i = 0; i < arrayCount; i++ ) {
+							mxDO(this->WriteValue( mxAddByteOffset( arrayBase, i * itemStride ), record.first, _stream ));
+						}
+					}
+				}
+				break;
+
+			case Type_String :
+				mxDO(static_cast< const String* >( _memory )->SaveToStream( _stream ));
+				break;
+
+			case Type_ClassId :
+				{
+					const SClassId* classId = static_cast< const SClassId* >( _memory );
+					const TypeID typeId = ( classId->type != NULL ) ? classId->type->GetTypeID() : mxNULL_TYPE_ID;
+					mxDO(_stream.Put( typeId ));
+				}
+				break;
+
+			case Type_AssetId :
+				mxDO(WriteAssetID( *static_cast< const AssetID* >( _memory ), _stream ));
+				break;
+
+			case Type_Pointer :
+				return ERR_NOT_IMPLEMENTED;
+
+			default:
+				// user pointers and blobs are not serialized
+				break;
 			}
-			virtual ERet Visit_TypeId( SClassId * _pointer, const Context3& _context, AStreamWriter &_stream ) override
+
+			return ALL_OK;
+		}
+	};
+
+	class SchemaReader
+	{
+		TArray< STypeRecord >	m_records;
+		TArray< SFieldRecord >	m_fields;
+
+		// maps a stored class onto the current class
+		struct SClassMapping
+		{
+			UINT32			storedType;	// index of the type record
+			const mxClass *	currentType;
+			UINT32			firstField;	// index into m_fieldMappings (one entry per stored field)
+			bool			identical;	// can be read with a single memcpy
+		};
+		// the current field which receives the value of a stored field
+		struct SFieldMapping
+		{
+			const mxType *	type;	// NULL if the stored field should be skipped
+			UINT32			offset;
+		};
+		TArray< SClassMapping >	m_mappings;
+		TArray< SFieldMapping >	m_fieldMappings;
+
+	public:
+		ERet ReadSchema( AStreamReader& _stream )
+		{
+			SchemaHeader	header;
+			mxDO(_stream.Get( header ));
+			mxDO(m_records.SetNum( header.numTypes ));
+			mxDO(m_fields.SetNum( header.numFields ));
+			mxDO(_stream.Read( m_records.ToPtr(), m_records.GetDataSize() ));
+			mxDO(_stream.Read( m_fields.ToPtr(), m_fields.GetDataSize() ));
+
+			// validate indices so that we don't have to check them when reading values
+			for( UINT32 i = 0; i < m_records.Num(); i++ )
 			{
-				const TypeID typeId = ( _pointer->type != NULL ) ? _pointer->type->GetTypeID() : mxNULL_TYPE_ID;
-				mxDO(_stream.Put( typeId ));
-				return ALL_OK;
+				const STypeRecord& record = m_records[i];
+				if( record.kind == Type_Class ) {
+					chkRET_X_IF_NOT(record.first + record.numFields <= m_fields.Num(), ERR_INVALID_PARAMETER);
+				}
+				if( record.kind == Type_Array ) {
+					chkRET_X_IF_NOT(record.first < m_records.Num(), ERR_INVALID_PARAMETER);
+				}
 			}
-			virtual ERet Visit_AssetId( AssetID * _assetId, const Context3& _context, AStreamWriter &_stream ) override
+			for( UINT32 i = 0; i < m_fields.Num(); i++ )
 			{
-				mxDO(WriteAssetID( *_assetId, _stream ));
+				chkRET_X_IF_NOT(m_fields[i].type < m_records.Num(), ERR_INVALID_PARAMETER);
+			}
+			return ALL_OK;
+		}
+
+		UINT32 NumTypes() const
+		{
+			return m_records.Num();
+		}
+		const STypeRecord& GetType( UINT32 _typeIndex ) const
+		{
+			return m_records[ _typeIndex ];
+		}
+
+		ERet ReadValue( void* _memory, const mxType& _type, UINT32 _typeIndex, AStreamReader& _stream )
+		{
+			const STypeRecord& record = m_records[ _typeIndex ];
+
+			bool identical = false;
+			mxDO(this->IsIdentical( _typeIndex, _type, identical ));
+			if( identical ) {
+				mxDO(_stream.Read( _memory, record.size ));
 				return ALL_OK;
 			}
-			virtual ERet Visit_Pointer( void * _pointer, const mxPointerType& _type, const Context3& _context, AStreamWriter &_stream ) override
+
+			switch( _type.m_kind )
+			{
+			case Type_Class :
+				{
+					const mxClass& classType = _type.UpCast< mxClass >();
+					UINT32 mappingIndex;
+					mxDO(this->GetMapping( _typeIndex, classType, mappingIndex ));
+					const UINT32 firstMapping = m_mappings[ mappingIndex ].firstField;
+
+					if( record.flags & Schema_Bitwise )
+					{
+						// the struct was saved as raw memory and its layout has changed
+						BYTE			localBuffer[256];
+						TArray< BYTE >	heapBuffer;
+						BYTE* storedData = localBuffer;
+						if( record.size > sizeof(localBuffer) ) {
+							mxDO(heapBuffer.SetNum( record.size ));
+							storedData = heapBuffer.ToPtr();
+						}
+						mxDO(_stream.Read( storedData, record.size ));
+
+						for( UINT32 i = 0; i < record.numFields; i++ )
+						{
+							const SFieldRecord& storedField = m_fields[ record.first + i ];
+							const SFieldMapping mapping = m_fieldMappings[ firstMapping + i ];
+							const UINT32 storedSize = m_records[ storedField.type ].size;
+							if( mapping.type && storedField.offset + storedSize <= record.size )
+							{
+								MemoryReader	fieldReader( storedData + storedField.offset, storedSize );
+								mxDO(this->ReadValue( mxAddByteOffset( _memory, mapping.offset ), *mapping.type, storedField.type, fieldReader ));
+							}
+						}
+					}
+					else
+					{
+						for( UINT32 i = 0; i < record.numFields; i++ )
+						{
+							const SFieldRecord& storedField = m_fields[ record.first + i ];
+							const SFieldMapping mapping = m_fieldMappings[ firstMapping + i ];
+							if( mapping.type ) {
+								mxDO(this->ReadValue( mxAddByteOffset( _memory, mapping.offset ), *mapping.type, storedField.type, _stream ));
+							} else {
+								mxDO(this->SkipValue( storedField.type, _stream ));
+							}
+						}
+					}
+				}
+				break;
+
+			case Type_Array :
+				{
+					const mxArray& arrayType = _type.UpCast< mxArray >();
+					const mxType& itemType = arrayType.m_itemType;
+
+					UINT32 arrayCount = 0;
+					mxDO(_stream.Get( arrayCount ));
+					chkRET_X_IF_NOT(arrayCount < Reflection::MAX_ARRAY_ELEMENTS, ERR_INVALID_PARAMETER);
+
+					mxDO(arrayType.Generic_Set_Count( _memory, arrayCount ));
+					void* arrayBase = arrayType.Generic_Get_Data( _memory );
+					const UINT32 itemStride = itemType.m_size;
+
+					bool identicalItems = false;
+					mxDO(this->IsIdentical( record.first, itemType, identicalItems ));
+					if( identicalItems ) {
+						mxDO(_stream.Read( arrayBase, arrayCount * itemStride ));
+					} else {
+						for( UINT32 i = 0; i < arrayCount; i++ ) {
+							mxDO(this->ReadValue( mxAddByteOffset( arrayBase, i * itemStride ), itemType, record.first, _stream ));
+						}
+					}
+				}
+				break;
+
+			case Type_String :
+				mxDO(static_cast< String* >( _memory )->LoadFromStream( _stream ));
+				break;
+
+			case Type_ClassId :
+				{
+					TypeID typeId;
+					mxDO(_stream.Get( typeId ));
+					SClassId* classId = static_cast< SClassId* >( _memory );
+					if( typeId != mxNULL_TYPE_ID ) {
+						classId->type = TypeRegistry::Get().FindClassByGuid( typeId );
+						if( !classId->type ) {
+							ptWARN("No class with id=%d", typeId);
+							return ERR_OBJECT_NOT_FOUND;
+						}
+					}
+				}
+				break;
+
+			case Type_AssetId :
+				mxDO(ReadAssetID( _stream, static_cast< AssetID* >( _memory ) ));
+				break;
+
+			case Type_Pointer :
+				return ERR_NOT_IMPLEMENTED;
+
+			case Type_UserData :
+			case Type_Blob :
+				break;
+
+			default:
+				// POD values of a different size or kind
+				return ERR_OBJECT_OF_WRONG_TYPE;
+			}
+
+			return ALL_OK;
+		}
+
+		ERet SkipValue( UINT32 _typeIndex, AStreamReader& _stream ) const
+		{
+			const STypeRecord& record = m_records[ _typeIndex ];
+
+			if( record.flags & Schema_Bitwise ) {
+				return SkipBytes( _stream, record.size );
+			}
+
+			switch( record.kind )
 			{
+			case Type_Class :
+				for( UINT32 i = 0; i < record.numFields; i++ ) {
+					mxDO(this->SkipValue( m_fields[ record.first + i ].type, _stream ));
+				}
+				break;
+
+			case Type_Array :
+				{
+					UINT32 arrayCount = 0;
+					mxDO(_stream.Get( arrayCount ));
+					chkRET_X_IF_NOT(arrayCount < Reflection::MAX_ARRAY_ELEMENTS, ERR_INVALID_PARAMETER);
+
+					const STypeRecord& itemRecord = m_records[ record.first ];
+					if( itemRecord.flags & Schema_Bitwise ) {
+						mxDO(SkipBytes( _stream, arrayCount * itemRecord.size ));
+					} else {
+						for( UINT32 i = 0; i < arrayCount; i++ ) {
+							mxDO(this->SkipValue( record.first, _stream ));
+						}
+					}
+				}
+				break;
+
+			case Type_String :
+				{
+					UINT32 length = 0;
+					mxDO(_stream.Get( length ));
+					mxDO(SkipBytes( _stream, length ));
+				}
+				break;
+
+			case Type_ClassId :
+				mxDO(SkipBytes( _stream, sizeof(TypeID) ));
+				break;
+
+			case Type_AssetId :
+				{
+					AssetID	assetId;
+					mxDO(ReadAssetID( _stream, &assetId ));
+				}
+				break;
+
+			case Type_Pointer :
 				return ERR_NOT_IMPLEMENTED;
+
+			default:
+				break;
 			}
-		};
 
-		BinarySerializer	serializer;
-		mxDO(serializer.Visit( const_cast< void* >(o), _type, stream ));
+			return ALL_OK;
+		}
 
-		return ALL_OK;
-	}
+	private:
+		// returns true if the stored value can be copied into the current type as is
+		ERet IsIdentical( UINT32 _typeIndex, const mxType& _type, bool &_identical )
+		{
+			const STypeRecord& record = m_records[ _typeIndex ];
+			_identical = false;
 
-	ERet LoadBinary( AStreamReader& stream, const mxClass& _type, void *o )
-	{
-		BinaryHeader	header;
-		mxDO(stream.Get(header));
+			if( record.kind != _type.m_kind || record.size != _type.m_size || !( record.flags & Schema_Bitwise ) ) {
+				return ALL_OK;
+			}
+			if( _type.m_kind == Type_Class ) {
+				UINT32 mappingIndex;
+				mxDO(this->GetMapping( _typeIndex, _type.UpCast< mxClass >(), mappingIndex ));
+				_identical = m_mappings[ mappingIndex ].identical;
+			} else {
+				_identical = Type_Is_Bitwise_Serializable( _type.m_kind );
+			}
+			return ALL_OK;
+		}
 
-		mxDO(ValidatePlatformAndType(header, _type));
+		// returns true if the stored value can be loaded into the current type
+		bool IsCompatible( UINT32 _typeIndex, const mxType& _type ) const
+		{
+			const STypeRecord& record = m_records[ _typeIndex ];
+			if( record.kind != _type.m_kind ) {
+				return false;
+			}
+			if( Type_Is_Bitwise_Serializable( _type.m_kind ) ) {
+				return record.size == _type.m_size;
+			}
+			if( _type.m_kind == Type_Array ) {
+				return this->IsCompatible( record.first, _type.UpCast< mxArray >().m_itemType );
+			}
+			return true;
+		}
+
+		ERet GetMapping( UINT32 _typeIndex, const mxClass& _type, UINT32 &_mappingIndex )
+		{
+			for( UINT32 i = 0; i < m_mappings.Num(); i++ )
+			{
+				const SClassMapping& mapping = m_mappings[i];
+				if( mapping.storedType == _typeIndex && mapping.currentType == &_type ) {
+					_mappingIndex = i;
+					return ALL_OK;
+				}
+			}
+
+			const STypeRecord& record = m_records[ _typeIndex ];
+			chkRET_X_IF_NOT(record.kind == Type_Class, ERR_OBJECT_OF_WRONG_TYPE);
+
+			TArray< const mxField* >	currentFields;
+			CollectFields( _type, currentFields );
+
+			TArray< UINT32 >	currentHashes;
+			mxDO(currentHashes.SetNum( currentFields.Num() ));
+			for( UINT32 i = 0; i < currentFields.Num(); i++ ) {
+				currentHashes[i] = FNV32_StringHash( currentFields[i]->name );
+			}
+
+			const UINT32 firstMapping = m_fieldMappings.Num();
+			mxDO(m_fieldMappings.SetNum( firstMapping + record.numFields ));
+
+			UINT32 numMapped = 0;
+			for( UINT32 i = 0; i < record.numFields; i++ )
+			{
+				const SFieldRecord& storedField = m_fields[ record.first + i ];
+				SFieldMapping& fieldMapping = m_fieldMappings[ firstMapping + i ];
+				fieldMapping.type = NULL;
+				fieldMapping.offset = 0;
+
+				for( UINT32 k = 0; k < currentFields.Num(); k++ )
+				{
+					if( currentHashes[k] == storedField.nameHash )
+					{
+						const mxField& field = *currentFields[k];
+						if( this->IsCompatible( storedField.type, field.type ) ) {
+							fieldMapping.type = &field.type;
+							fieldMapping.offset = field.offset;
+							numMapped++;
+						} else {
+							ptWARN("'%s::%s' has changed its type and will not be loaded", _type.GetTypeName(), field.name);
+						}
+						break;
+					}
+				}
+			}
 
+			// the stored struct can be copied as is if all fields are at the same places
+			bool identical = ( record.flags & Schema_Bitwise )
+				&& record.size == _type.m_size
+				&& numMapped == record.numFields
+				&& numMapped == currentFields.Num();
+
+			for( UINT32 i = 0; i < record.numFields && identical; i++ )
+			{
+				const SFieldRecord& storedField = m_fields[ record.first + i ];
+				const SFieldMapping fieldMapping = m_fieldMappings[ firstMapping + i ];
+				bool identicalField = false;
+				// NOTE: may add new mappings, don't hold references across this call
+				mxDO(this->IsIdentical( storedField.type, *fieldMapping.type, identicalField ));
+				identical = identicalField && fieldMapping.offset == storedField.offset;
+			}
+
+			_mappingIndex = m_mappings.Num();
+			SClassMapping& mapping = m_mappings.Add();
+			mapping.storedType = _typeIndex;
+			mapping.currentType = &_type;
+			mapping.firstField = firstMapping;
+			mapping.identical = identical;
+
+			return ALL_OK;
+		}
+	};
+
+	static ERet LoadLegacyBinary( AStreamReader& stream, const mxClass& _type, void *o )
+	{
 		// Read object data and allocate memory for everything
 
 		class BinaryDeserializer : public Reflection::Visitor3< AStreamReader& > {
@@ -649,6 +1403,45 @@ namespace Serialization
 		return ALL_OK;
 	}
 
+	ERet SaveBinary( const void* o, const mxClass& _type, AStreamWriter &stream )
+	{
+		BinaryHeader	header;
+		{
+			header.session = PtSessionInfo::CURRENT;
+			header.classId = _type.GetTypeID();
+			header.format = SCHEMA_FOURCC;
+		}
+		mxDO(stream.Put(header));
+
+		SchemaWriter	schema;
+		const UINT32 rootType = schema.AddType( _type );
+		mxDO(schema.WriteSchema( stream ));
+		mxDO(schema.WriteValue( o, rootType, stream ));
+
+		return ALL_OK;
+	}
+
+	ERet LoadBinary( AStreamReader& stream, const mxClass& _type, void *o )
+	{
+		BinaryHeader	header;
+		mxDO(stream.Get(header));
+
+		mxDO(ValidatePlatformAndType(header, _type));
+
+		// files saved by older versions don't have schemas and must match the current layout
+		if( header.format != SCHEMA_FOURCC ) {
+			return LoadLegacyBinary( stream, _type, o );
+		}
+
+		SchemaReader	schema;
+		mxDO(schema.ReadSchema( stream ));
+		chkRET_X_IF_NOT(schema.NumTypes() > 0, ERR_INVALID_PARAMETER);
+		// the root type is always written first
+		mxDO(schema.ReadValue( o, _type, 0, stream ));
+
+		return ALL_OK;
+	}
+
 	ERet SaveBinaryToFile( const void* o, const mxClass& type, const char* file )
 	{
 		FileWriter	stream( file, FileWrite_NoErrors );
@@ -666,7 +1459,107 @@ namespace Serialization
 		return LoadBinary(reader, type, o);
 	}
 
-	ERet SaveClumpImage( const Clump& _clump, AStreamWriter &_stream )
+	ERet SaveClumpBinary( const Clump& _clump, AStreamWriter &_stream )
+	{
+		BinaryHeader	header;
+		{
+			header.session = PtSessionInfo::CURRENT;
+			header.classId = mxCLASS_OF(_clump).GetTypeID();
+			header.format = SCHEMA_FOURCC;
+		}
+		mxDO(_stream.Put( header ));
+
+		// the schemas of all object types are written before the objects
+		SchemaWriter	schema;
+		UINT32 numObjectLists = 0;
+
+		ObjectList::Head currentList = _clump.GetObjectLists();
+		while( currentList != NULL )
+		{
+			if( currentList->Num() > 0 ) {
+				schema.AddType( currentList->GetType() );
+				numObjectLists++;
+			}
+			currentList = currentList->_next;
+		}
+
+		mxDO(schema.WriteSchema( _stream ));
+		mxDO(_stream.Put( numObjectLists ));
+
+		currentList = _clump.GetObjectLists();
+		while( currentList != NULL )
+		{
+			const UINT32 objectCount = currentList->Num();
+			if( objectCount > 0 )
+			{
+				const UINT32 typeIndex = schema.AddType( currentList->GetType() );
+				mxDO(_stream.Put( typeIndex ));
+				mxDO(_stream.Put( objectCount ));
+
+				ObjectList::IteratorBase it( *currentList );
+				while( it.IsValid() )
+				{
+					mxDO(schema.WriteValue( it.ToVoidPtr(), typeIndex, _stream ));
+					it.MoveToNext();
+				}
+			}
+			currentList = currentList->_next;
+		}
+
+		return ALL_OK;
+	}
+
+	ERet LoadClumpBinary( AStreamReader& _stream, Clump& _clump )
+	{
+		BinaryHeader	header;
+		mxDO(_stream.Get( header ));
+		mxDO(ValidatePlatformAndType( header, mxCLASS_OF(_clump) ));
+		chkRET_X_IF_NOT(header.format == SCHEMA_FOURCC, ERR_OBJECT_OF_WRONG_TYPE);
+
+		SchemaReader	schema;
+		mxDO(schema.ReadSchema( _stream ));
+
+		UINT32 numObjectLists = 0;
+		mxDO(_stream.Get( numObjectLists ));
+
+		for( UINT32 listIndex = 0; listIndex < numObjectLists; listIndex++ )
+		{
+			UINT32 typeIndex = 0;
+			UINT32 objectCount = 0;
+			mxDO(_stream.Get( typeIndex ));
+			mxDO(_stream.Get( objectCount ));
+			chkRET_X_IF_NOT(typeIndex < schema.NumTypes(), ERR_INVALID_PARAMETER);
+
+			const STypeRecord& record = schema.GetType( typeIndex );
+			chkRET_X_IF_NOT(record.kind == Type_Class, ERR_OBJECT_OF_WRONG_TYPE);
+
+			// objects of removed classes are skipped
+			const mxClass* objectType = TypeRegistry::Get().FindClassByGuid( record.nameHash );
+			if( !objectType || !objectType->IsConcrete() )
+			{
+				ptWARN("Skipping %u objects of unknown class (id=%d)", objectCount, record.nameHash);
+				for( UINT32 i = 0; i < objectCount; i++ ) {
+					mxDO(schema.SkipValue( typeIndex, _stream ));
+				}
+				continue;
+			}
+
+			ObjectList* objectList = _clump.CreateObjectList( *objectType, objectCount );
+			chkRET_X_IF_NIL(objectList, ERR_OUT_OF_MEMORY);
+
+			for( UINT32 i = 0; i < objectCount; i++ )
+			{
+				CStruct* o = objectList->Allocate();
+				chkRET_X_IF_NIL(o, ERR_OUT_OF_MEMORY);
+				objectType->ConstructInPlace( o );
+				mxDO(schema.ReadValue( o, *objectType, typeIndex, _stream ));
+			}
+		}
+
+		return ALL_OK;
+	}
+
+	static ERet SaveClumpImage( const Clump& _clump, AStreamWriter &_stream, bool _legacyFormat )
 	{
 		LIPInfoGatherer	lip;
 
@@ -694,6 +1587,7 @@ namespace Serialization
 			objectListCtx.userName = objectType.GetTypeName();
 
 			lip.AddChunk( currentList, sizeof(ObjectList), EFFICIENT_ALIGNMENT, objectListCtx );
+			lip.objectLists.Add( currentList );
 
 			Reflection::Walker2::Visit( c_cast(void*)currentList, mxCLASS_OF(*currentList), &lip, objectListCtx );
 
@@ -730,26 +1624,127 @@ namespace Serialization
 			"Clump", header.classId, alignedDataSize, sizeof(header) + alignedDataSize);
 
 		// Write all memory blocks and relocation tables.
-		lip.WriteChunksAndFixUpTables( _stream );
+		mxDO(lip.WriteChunksAndFixUpTables( _stream, alignedDataSize, _legacyFormat ));
 
 		return ALL_OK;
 	}
 
+	ERet SaveClumpImage( const Clump& _clump, AStreamWriter &_stream )
+	{
+		return SaveClumpImage( _clump, _stream, false );
+	}
+
 	ERet LoadClumpImage( AStreamReader& _stream, UINT32 _payload, void *_buffer )
 	{
 		mxDO(_stream.Read( _buffer, _payload ));
+		mxDO(FixupClumpImage( _stream, _payload, _buffer ));
+		return ALL_OK;
+	}
 
+	ERet FixupClumpImage( AStreamReader& _fixups, UINT32 _payload, void *_buffer )
+	{
+		// The constructor resets the head of the object lists, which holds the relocated offset.
+		const ObjectList::Head objectLists = static_cast< Clump* >( _buffer )->m_objectLists;
 		Clump* clump = new(_buffer) Clump();
+		clump->m_objectLists = objectLists;
 
 		// Patch the clump after loading.
 
-		mxDO(ReadAndApplyFixups( _stream, _buffer, _payload ));
+		UINT32 relocationFlags = 0;
+		mxDO(ReadAndApplyFixups( _fixups, _buffer, _payload, relocationFlags ));
 
 		new(&clump->m_objectListsStorage)FreeListAllocator();
 		clump->m_objectListsStorage.Initialize( sizeof(ObjectList), 16 );
 
-		TellNotToFreeMemory		markMemoryAsExternallyAllocated;
-		clump->IterateObjects( &markMemoryAsExternallyAllocated, NULL );
+		if( !(relocationFlags & Reloc_MemoryOwnershipBaked) )
+		{
+			TellNotToFreeMemory		markMemoryAsExternallyAllocated;
+			clump->IterateObjects( &markMemoryAsExternallyAllocated, NULL );
+		}
+
+		return ALL_OK;
+	}
+
+	ERet LoadClumpInPlace( void *_image, UINT32 _imageSize, Clump *&_clump )
+	{
+		chkRET_X_IF_NIL(_image, ERR_NULL_POINTER_PASSED);
+		chkRET_X_IF_NOT(_imageSize >= sizeof(ImageHeader), ERR_FAILED_TO_PARSE_DATA);
+
+		const ImageHeader& header = *static_cast< const ImageHeader* >( _image );
+		mxDO(ValidatePlatformAndType( header, Clump::MetaClass() ));
+		chkRET_X_IF_NOT(header.payload >= sizeof(Clump), ERR_FAILED_TO_PARSE_DATA);
+		chkRET_X_IF_NOT(header.payload <= _imageSize - sizeof(ImageHeader), ERR_FAILED_TO_PARSE_DATA);
+
+		void* payload = mxAddByteOffset( _image, sizeof(ImageHeader) );
+		chkRET_X_IF_NOT(IsAlignedBy( payload, EFFICIENT_ALIGNMENT ), ERR_INVALID_ALIGNMENT);
+
+		const UINT32 tableSize = _imageSize - sizeof(ImageHeader) - header.payload;
+		MemoryReader	fixups( mxAddByteOffset( payload, header.payload ), tableSize );
+		mxDO(FixupClumpImage( fixups, header.payload, payload ));
+
+		_clump = static_cast< Clump* >( payload );
+		return ALL_OK;
+	}
+
+	// copies the payload into a new buffer and measures the time of patching it
+	static ERet MeasureClumpFixups( const ByteArrayT& _image, UINT32 _numIterations, UINT64 &_microseconds )
+	{
+		const ImageHeader& header = *c_cast(const ImageHeader*) _image.ToPtr();
+		const void* payload = _image.ToPtr() + sizeof(ImageHeader);
+		const void* fixupTables = mxAddByteOffset( payload, header.payload );
+		const UINT32 tableSize = _image.Num() - sizeof(ImageHeader) - header.payload;
+
+		void* buffer = Clump::Alloc( header.payload );
+		chkRET_X_IF_NIL(buffer, ERR_OUT_OF_MEMORY);
+
+		ERet result = ALL_OK;
+		_microseconds = 0;
+		for( UINT32 i = 0; i < _numIterations && mxSUCCEDED(result); i++ )
+		{
+			memcpy( buffer, payload, header.payload );
+			MemoryReader	fixups( fixupTables, tableSize );
+
+			const UINT64 startTime = mxGetTimeInMicroseconds();
+			result = FixupClumpImage( fixups, header.payload, buffer );
+			_microseconds += mxGetTimeInMicroseconds() - startTime;
+
+			if( mxSUCCEDED(result) ) {
+				static_cast< Clump* >( buffer )->~Clump();
+			}
+		}
+
+		Clump::Free( buffer );
+		return result;
+	}
+
+	ERet BenchmarkClumpImage( const Clump& _clump, UINT32 _numIterations )
+	{
+		chkRET_X_IF_NOT(_numIterations > 0, ERR_INVALID_PARAMETER);
+
+		ByteArrayT	currentImage;
+		ByteArrayT	legacyImage;
+		{
+			ByteArrayWriter	writer( currentImage );
+			mxDO(SaveClumpImage( _clump, writer, false ));
+		}
+		{
+			ByteArrayWriter	writer( legacyImage );
+			mxDO(SaveClumpImage( _clump, writer, true ));
+		}
+
+		UINT64 currentTime = 0;
+		UINT64 legacyTime = 0;
+		mxDO(MeasureClumpFixups( currentImage, _numIterations, currentTime ));
+		mxDO(MeasureClumpFixups( legacyImage, _numIterations, legacyTime ));
+
+		const ImageHeader& header = *c_cast(const ImageHeader*) currentImage.ToPtr();
+		const UINT32 currentTables = currentImage.Num() - sizeof(ImageHeader) - header.payload;
+		const UINT32 legacyTables = legacyImage.Num() - sizeof(ImageHeader) - header.payload;
+
+		DBGOUT("Clump image: %u bytes, relocation tables: %u bytes (legacy: %u bytes).\n",
+			header.payload, currentTables, legacyTables);
+		DBGOUT("Fixups: %u us (legacy with reflection walk: %u us), average of %u runs.\n",
+			(UINT32)(currentTime / _numIterations), (UINT32)(legacyTime / _numIterations), _numIterations);
 
 		return ALL_OK;
 	}
@@ -25,7 +25,7 @@ namespace Serialization
 	{
 		PtSessionInfo	session;	// 8 platform/engine info
 		TypeID			classId;	// 4 type of stored object
-		UINT32			_unused;	// 4 padding to align data to 16 bytes
+		UINT32			format;		// 4 MCHAR4('S','C','H','M') if type schemas are stored
 	};
 	ASSERT_SIZEOF(BinaryHeader, 16);
 #pragma pack (pop)
@@ -73,7 +73,9 @@ namespace Serialization
 	//
 	// Automatic binary serialization (via reflection):
 	// serializes to a compact binary format.
-	// NOTE: only internal pointers to objects (structs or classes) are supported.
+	// The type schemas are stored in the file, so the data can be loaded
+	// after fields have been added, removed or reordered.
+	// NOTE: pointers are not supported.
 	//
 
 	ERet SaveBinary( const void* o, const mxClass& _type, AStreamWriter &stream );
@@ -89,7 +91,22 @@ namespace Serialization
 
 	ERet SaveClumpImage( const Clump& _clump, AStreamWriter &_stream );
 	ERet LoadClumpImage( AStreamReader& _stream, UINT32 _payload, void *_buffer );
-
+	// constructs the clump in the buffer which already holds the payload
+	// and patches it with the fixup tables read from the stream (used by the asynchronous loader)
+	ERet FixupClumpImage( AStreamReader& _fixups, UINT32 _payload, void *_buffer );
+	// patches the clump image in place, without copying (e.g. in a copy-on-write view of a package file);
+	// the image starts with an ImageHeader, the payload must be aligned to EFFICIENT_ALIGNMENT;
+	// the returned clump lives in the image memory and must not be freed with Clump::Free()
+	// (see Clump::SetMappedFile() and Clump::Delete())
+	ERet LoadClumpInPlace( void *_image, UINT32 _imageSize, Clump *&_clump );
+
+	// saves the clump with the current relocation tables and in the legacy format
+	// (pointer/target pairs and the reflection walk after loading)
+	// and prints the average time of patching the loaded images
+	ERet BenchmarkClumpImage( const Clump& _clump, UINT32 _numIterations = 16 );
+
+	// saves live objects of all object lists in the schema-versioned binary format;
+	// objects of classes which no longer exist are skipped on loading
 	ERet SaveClumpBinary( const Clump& _clump, AStreamWriter &_stream );
 	ERet LoadClumpBinary( AStreamReader& _stream, Clump& _clump );
 
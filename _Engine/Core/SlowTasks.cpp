@@ -9,113 +9,60 @@
 #pragma hdrstop
 #include <Core/Core.h>
 #include <Core/SlowTasks.h>
-#include <Core/bitsquid/queue.h>
+#include <Core/JobSystem.h>
 
 namespace SlowTasks
 {
 
-namespace bitsquid = foundation;
-
-struct QueuedTask
-{
-	SlowTaskExec *	callback;
-	UINT64			data;
-};
-
+// slow tasks are executed by the job system's worker threads
 struct SlowTasksManager
 {
-	bitsquid::Queue< QueuedTask >	pendingTasks;	// pending tasks
-	SpinWait	pendingTasksCS;	// for serializing access to the pending tasks queue
-
-	bitsquid::Queue< QueuedTask >	completedTasks;	// executed tasks
-	SpinWait	completedTasksCS;
-
-	Thread	thread9;
-
-	bool	exiting;
-
-public:
-	SlowTasksManager()
-		: pendingTasks( bitsquid::memory_globals::default_allocator() )
-		, completedTasks( bitsquid::memory_globals::default_allocator() )
-	{}
+	JobCounter	pendingTasks;	// the number of scheduled or running tasks
 };
 mxDECLARE_PRIVATE_DATA( SlowTasksManager, gSlowTasksManager );
 
 #define me	mxGET_PRIVATE_DATA( SlowTasksManager, gSlowTasksManager )
 
-static UINT32 ThreadFunction( void* _taskMgr );
-
 ERet Initialize()
 {
 	mxINITIALIZE_PRIVATE_DATA( gSlowTasksManager );
-
-	me.pendingTasksCS.Initialize();
-	me.completedTasksCS.Initialize();
-
 	return ALL_OK;
 }
 
 void Shutdown()
 {
-	//me.pendingTasks.Empty();
-	//me.completedTasks.Empty();
-
-	me.pendingTasksCS.Shutdown();
-	me.completedTasksCS.Shutdown();
+	// finish the pending tasks, they may reference data owned by the caller
+	WaitForAllTasks();
 
 	mxSHUTDOWN_PRIVATE_DATA( gSlowTasksManager );
 }
 
-void AddTask( const SlowTaskDesc& desc )
+static void ExecuteSlowTask( void* _callback, UINT64 _data, UINT _threadIndex )
 {
-	SpinWait::Lock	scopedLock( me.pendingTasksCS );
-
-	QueuedTask	newTask;
-	newTask.callback = desc.callback;
-	newTask.data = desc.data;
+	SlowTaskExec* callback = (SlowTaskExec*) _callback;
 
-	bitsquid::queue::push_back( me.pendingTasks, newTask );
+	SlowTaskCtx	context;
+	context.data = _data;
+	(*callback)( context );
 }
 
-UINT32 NumPendingTasks()
+void AddTask( const SlowTaskDesc& desc )
 {
-	SpinWait::Lock	scopedLock( me.pendingTasksCS );
-	return bitsquid::queue::size( me.pendingTasks );
+	JobDesc	job;
+	job.function = &ExecuteSlowTask;
+	job.data = (void*) desc.callback;
+	job.arg = desc.data;
+	JobSystem::RunJob( job, &me.pendingTasks );
 }
 
-void AddCompletedTask( const QueuedTask& task )
+UINT32 NumPendingTasks()
 {
-	SpinWait::Lock	scopedLock( me.completedTasksCS );
-	bitsquid::queue::push_back( me.completedTasks, task );
+	return me.pendingTasks.pending;
 }
 
-static UINT32 ThreadFunction( void* _taskMgr )
+void WaitForAllTasks()
 {
-	SlowTasksManager* taskMgr = static_cast< SlowTasksManager* >(_taskMgr);
-
-	while( !taskMgr->exiting )
-	{
-		me.pendingTasksCS.Enter();
-		if( !bitsquid::queue::size( me.pendingTasks ) )
-		{
-			me.pendingTasksCS.Leave();
-			continue;
-		}
-		QueuedTask* task = bitsquid::queue::begin_front(me.pendingTasks);
-		me.pendingTasksCS.Leave();
-
-		SlowTaskCtx	context;
-		context.data = task->data;
-		(*task->callback)( context );
-
-		AddCompletedTask( *task );
-
-		me.pendingTasksCS.Enter();
-		bitsquid::queue::pop_front(me.pendingTasks);
-		me.pendingTasksCS.Leave();
-	}
-	return 0;
+	JobSystem::WaitForCounter( &me.pendingTasks );
 }
 
 }//namespace SlowTasks
@@ -29,6 +29,9 @@ void Shutdown();
 void AddTask( const SlowTaskDesc& desc );
 UINT32 NumPendingTasks();
 
+// executes other jobs until all scheduled tasks have finished
+void WaitForAllTasks();
+
 }//namespace SlowTasks
 
 //--------------------------------------------------------------//
@@ -1221,6 +1221,99 @@ int Preprocessor::GetDefinesNestingLevel() const
 	return depth;
 }
 
+/*
+-----------------------------------------------------------------------------
+	PP_CollectIncludes
+-----------------------------------------------------------------------------
+*/
+static inline const char* SkipSpacesAndTabs( const char* p, const char* end )
+{
+	while( p < end && (*p == ' ' || *p == '\t') ) {
+		p++;
+	}
+	return p;
+}
+
+static bool ContainsString( const StringListT& strings, const char* str )
+{
+	for( UINT32 i = 0; i < strings.Num(); i++ )
+	{
+		if( Str::EqualS( strings[i], str ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static ERet CollectIncludesRecursive( const char* text, UINT32 size, AFileInclude* fileInclude, StringListT &includedFiles )
+{
+	const char* p = text;
+	const char* end = text + size;
+	while( p < end )
+	{
+		// look for '#include "file"' or '#include <file>' at the start of the line
+		p = SkipSpacesAndTabs( p, end );
+		if( p < end && *p == '#' )
+		{
+			p = SkipSpacesAndTabs( p + 1, end );
+			if( end - p > 7 && !strncmp( p, "include", 7 ) )
+			{
+				p = SkipSpacesAndTabs( p + 7, end );
+				if( p < end && (*p == '"' || *p == '<') )
+				{
+					const char closingChar = (*p == '"') ? '"' : '>';
+					const char* start = ++p;
+					while( p < end && *p != closingChar && *p != '\n' ) {
+						p++;
+					}
+					if( p < end && *p == closingChar )
+					{
+						String256	includedFileName;
+						Str::CopyS( includedFileName, start, int(p - start) );
+
+						char* includedFileData = NULL;
+						UINT32 includedFileSize = 0;
+						if( fileInclude->OpenFile( includedFileName.c_str(), &includedFileData, &includedFileSize ) )
+						{
+							const char* includedFilePath = fileInclude->CurrentFilePath();
+							ERet result = ALL_OK;
+							// each file is scanned only once (this also breaks #include cycles)
+							if( !ContainsString( includedFiles, includedFilePath ) )
+							{
+								Str::CopyS( includedFiles.Add(), includedFilePath );
+								result = CollectIncludesRecursive( includedFileData, includedFileSize, fileInclude, includedFiles );
+							}
+							fileInclude->CloseFile( includedFileData );
+							mxDO(result);
+						}
+					}
+				}
+			}
+		}
+		// move to the next line
+		while( p < end && *p != '\n' ) {
+			p++;
+		}
+		p++;
+	}
+	return ALL_OK;
+}
+
+ERet PP_CollectIncludes( const char* fileName, AFileInclude* fileInclude, StringListT &includedFiles )
+{
+	chkRET_X_IF_NIL(fileName, ERR_NULL_POINTER_PASSED);
+	chkRET_X_IF_NIL(fileInclude, ERR_NULL_POINTER_PASSED);
+
+	char* fileData = NULL;
+	UINT32 fileSize = 0;
+	if( !fileInclude->OpenFile( fileName, &fileData, &fileSize ) ) {
+		return ERR_FILE_OR_PATH_NOT_FOUND;
+	}
+	const ERet result = CollectIncludesRecursive( fileData, fileSize, fileInclude, includedFiles );
+	fileInclude->CloseFile( fileData );
+	return result;
+}
+
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
@@ -220,6 +220,16 @@ private:
 	PPOptions					m_options;	//
 };
 
+/*
+-----------------------------------------------------------------------------
+	Finds the files #included by the given file (recursively), e.g. for dependency tracking.
+	Conditional compilation directives are not evaluated, so all #includes are reported;
+	files which cannot be opened are skipped (they may be in inactive #if branches).
+	The file names are taken from AFileInclude::CurrentFilePath().
+-----------------------------------------------------------------------------
+*/
+ERet PP_CollectIncludes( const char* fileName, AFileInclude* fileInclude, StringListT &includedFiles );
+
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
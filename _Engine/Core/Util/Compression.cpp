@@ -0,0 +1,387 @@
+/*
+=============================================================================
+	File:	Compression.cpp
+	Desc:	Fast LZ77 compression for asset packages.
+=============================================================================
+*/
+#include <Core/Core_PCH.h>
+#pragma hdrstop
+#include <Core/Core.h>
+#include <Core/Util/Compression.h>
+
+namespace Compression
+{
+	enum
+	{
+		MIN_MATCH = 4,		// the shortest match which can be encoded
+		LAST_LITERALS = 5,	// the last bytes of a block are always literals
+		MATCH_LIMIT = 12,	// the last match must start at least this many bytes before the end of the block
+		MAX_OFFSET = 65535,
+		HASH_BITS = 12,
+		RUN_MASK = 15,		// the 4-bit length field is extended with more bytes when saturated
+	};
+
+	static mxFORCEINLINE UINT32 Read32( const BYTE* _p )
+	{
+		UINT32 value;
+		memcpy( &value, _p, sizeof(value) );
+		return value;
+	}
+
+	static mxFORCEINLINE UINT32 HashSequence( UINT32 _sequence )
+	{
+		// Knuth's multiplicative hash
+		return (_sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// writes the length exceeding the 4-bit token field
+	static BYTE* WriteLength( BYTE* _op, UINT32 _length )
+	{
+		while( _length >= 255 ) {
+			*_op++ = 255;
+			_length -= 255;
+		}
+		*_op++ = (BYTE) _length;
+		return _op;
+	}
+
+	// the max. number of bytes occupied by a sequence with the given number of literals
+	static mxFORCEINLINE UINT32 MaxSequenceSize( UINT32 _numLiterals, UINT32 _matchLength )
+	{
+		return 1 + (_numLiterals / 255 + 1) + _numLiterals + 2 + (_matchLength / 255 + 1);
+	}
+
+	UINT32 LZ_CompressBound( UINT32 _sourceSize )
+	{
+		return _sourceSize + _sourceSize / 255 + 16;
+	}
+
+	UINT32 LZ_CompressBlock(
+		const void* _source, UINT32 _sourceSize,
+		void *_destination, UINT32 _destinationCapacity
+		)
+	{
+		const BYTE* const source = static_cast< const BYTE* >( _source );
+		const BYTE* const sourceEnd = source + _sourceSize;
+		BYTE* const destination = static_cast< BYTE* >( _destination );
+		BYTE* const destinationEnd = destination + _destinationCapacity;
+
+		const BYTE* ip = source;		// input pointer
+		const BYTE* anchor = source;	// the start of pending literals
+		BYTE* op = destination;			// output pointer
+
+		if( _sourceSize >= MATCH_LIMIT )
+		{
+			const BYTE* const searchLimit = sourceEnd - MATCH_LIMIT;
+			const BYTE* const matchLimit = sourceEnd - LAST_LITERALS;
+
+			// positions of the last occurrences of 4-byte sequences
+			UINT32	hashTable[ 1 << HASH_BITS ];
+			mxZERO_OUT(hashTable);
+
+			while( ip < searchLimit )
+			{
+				const UINT32 sequence = Read32( ip );
+				const UINT32 hash = HashSequence( sequence );
+				const BYTE* candidate = source + hashTable[ hash ];
+				hashTable[ hash ] = (UINT32)( ip - source );
+
+				if( candidate >= ip || ip - candidate > MAX_OFFSET || Read32( candidate ) != sequence )
+				{
+					// skip faster over incompressible data
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				// extend the match backwards
+				while( ip > anchor && candidate > source && ip[-1] == candidate[-1] ) {
+					ip--;
+					candidate--;
+				}
+				// extend the match forwards
+				const BYTE* matchEnd = ip + MIN_MATCH;
+				const BYTE* reference = candidate + MIN_MATCH;
+				while( matchEnd < matchLimit && *matchEnd == *reference ) {
+					matchEnd++;
+					reference++;
+				}
+
+				const UINT32 numLiterals = (UINT32)( ip - anchor );
+				const UINT32 matchLength = (UINT32)( matchEnd - ip ) - MIN_MATCH;
+
+				if( (UINT32)( destinationEnd - op ) < MaxSequenceSize( numLiterals, matchLength ) ) {
+					return 0;
+				}
+
+				// emit the sequence
+				BYTE* token = op++;
+				*token = (BYTE)( smallest( numLiterals, (UINT32)RUN_MASK ) << 4 );
+				if( numLiterals >= RUN_MASK ) {
+					op = WriteLength( op, numLiterals - RUN_MASK );
+				}
+				memcpy( op, anchor, numLiterals );
+				op += numLiterals;
+
+				const UINT32 offset = (UINT32)( ip - candidate );
+				*op++ = (BYTE)( offset & 0xFF );
+				*op++ = (BYTE)( offset >> 8 );
+
+				*token |= (BYTE) smallest( matchLength, (UINT32)RUN_MASK );
+				if( matchLength >= RUN_MASK ) {
+					op = WriteLength( op, matchLength - RUN_MASK );
+				}
+
+				ip = matchEnd;
+				anchor = ip;
+
+				// remember a position inside the match to find more matches later
+				if( ip < searchLimit ) {
+					hashTable[ HashSequence( Read32( ip - 2 ) ) ] = (UINT32)( ip - 2 - source );
+				}
+			}
+		}
+
+		// the last literals
+		const UINT32 numLiterals = (UINT32)( sourceEnd - anchor );
+		if( (UINT32)( destinationEnd - op ) < MaxSequenceSize( numLiterals, 0 ) ) {
+			return 0;
+		}
+		*op++ = (BYTE)( smallest( numLiterals, (UINT32)RUN_MASK ) << 4 );
+		if( numLiterals >= RUN_MASK ) {
+			op = WriteLength( op, numLiterals - RUN_MASK );
+		}
+		memcpy( op, anchor, numLiterals );
+		op += numLiterals;
+
+		return (UINT32)( op - destination );
+	}
+
+	// reads the extended length, returns false if the input ended prematurely
+	static mxFORCEINLINE bool ReadLength( const BYTE *& _ip, const BYTE* _inputEnd, UINT32 &_length )
+	{
+		UINT32 byte;
+		do
+		{
+			if( _ip >= _inputEnd ) {
+				return false;
+			}
+			byte = *_ip++;
+			_length += byte;
+		}
+		while( byte == 255 );
+		return true;
+	}
+
+	ERet LZ_DecompressBlock(
+		const void* _source, UINT32 _sourceSize,
+		void *_destination, UINT32 _destinationSize
+		)
+	{
+		const BYTE* ip = static_cast< const BYTE* >( _source );
+		const BYTE* const inputEnd = ip + _sourceSize;
+		BYTE* const destination = static_cast< BYTE* >( _destination );
+		BYTE* const outputEnd = destination + _destinationSize;
+		BYTE* op = destination;
+
+		for(;;)
+		{
+			chkRET_X_IF_NOT(ip < inputEnd, ERR_FAILED_TO_PARSE_DATA);
+			const UINT32 token = *ip++;
+
+			// copy literals
+			UINT32 numLiterals = token >> 4;
+			if( numLiterals == RUN_MASK ) {
+				chkRET_X_IF_NOT(ReadLength( ip, inputEnd, numLiterals ), ERR_FAILED_TO_PARSE_DATA);
+			}
+			chkRET_X_IF_NOT(numLiterals <= (UINT32)( inputEnd - ip ), ERR_FAILED_TO_PARSE_DATA);
+			chkRET_X_IF_NOT(numLiterals <= (UINT32)( outputEnd - op ), ERR_FAILED_TO_PARSE_DATA);
+			memcpy( op, ip, numLiterals );
+			ip += numLiterals;
+			op += numLiterals;
+
+			// the last sequence has no match
+			if( ip == inputEnd ) {
+				break;
+			}
+
+			// copy the match
+			chkRET_X_IF_NOT(inputEnd - ip >= 2, ERR_FAILED_TO_PARSE_DATA);
+			const UINT32 offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			chkRET_X_IF_NOT(offset > 0 && offset <= (UINT32)( op - destination ), ERR_FAILED_TO_PARSE_DATA);
+
+			UINT32 matchLength = token & RUN_MASK;
+			if( matchLength == RUN_MASK ) {
+				chkRET_X_IF_NOT(ReadLength( ip, inputEnd, matchLength ), ERR_FAILED_TO_PARSE_DATA);
+			}
+			matchLength += MIN_MATCH;
+			chkRET_X_IF_NOT(matchLength <= (UINT32)( outputEnd - op ), ERR_FAILED_TO_PARSE_DATA);
+
+			const BYTE* match = op - offset;
+			if( offset >= matchLength ) {
+				memcpy( op, match, matchLength );
+				op += matchLength;
+			} else {
+				// overlapping copy (repeating pattern)
+				for( UINT32 i = 0; i < matchLength; i++ ) {
+					*op++ = *match++;
+				}
+			}
+		}
+
+		chkRET_X_IF_NOT(op == outputEnd, ERR_FAILED_TO_PARSE_DATA);
+		return ALL_OK;
+	}
+
+	UINT32 NumBlocks( UINT32 _uncompressedSize )
+	{
+		return (_uncompressedSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+	ERet CompressBlockStream( const void* _source, UINT32 _sourceSize, TArray< BYTE > &_stream )
+	{
+		const BYTE* source = static_cast< const BYTE* >( _source );
+		const UINT32 numBlocks = NumBlocks( _sourceSize );
+		const UINT32 tableSize = (numBlocks + 1) * sizeof(UINT32);
+
+		const UINT32 streamStart = _stream.Num();
+		mxDO(_stream.SetNum( streamStart + tableSize ));
+
+		// worst case: every block is stored uncompressed
+		mxDO(_stream.Reserve( streamStart + tableSize + _sourceSize ));
+
+		UINT32 streamSize = tableSize;
+		for( UINT32 iBlock = 0; iBlock < numBlocks; iBlock++ )
+		{
+			const UINT32 blockStart = iBlock * BLOCK_SIZE;
+			const UINT32 blockSize = smallest( _sourceSize - blockStart, (UINT32)BLOCK_SIZE );
+
+			((UINT32*)( _stream.ToPtr() + streamStart ))[ iBlock ] = streamSize;
+
+			mxDO(_stream.SetNum( streamStart + streamSize + blockSize ));
+			BYTE* blockData = _stream.ToPtr() + streamStart + streamSize;
+
+			// keep the block only if it became smaller, otherwise store it uncompressed
+			UINT32 compressedSize = LZ_CompressBlock( source + blockStart, blockSize, blockData, blockSize - 1 );
+			if( !compressedSize ) {
+				memcpy( blockData, source + blockStart, blockSize );
+				compressedSize = blockSize;
+			}
+			streamSize += compressedSize;
+			mxDO(_stream.SetNum( streamStart + streamSize ));
+		}
+		((UINT32*)( _stream.ToPtr() + streamStart ))[ numBlocks ] = streamSize;
+
+		return ALL_OK;
+	}
+
+	/*
+	-----------------------------------------------------------------------------
+		BlockStreamReader
+	-----------------------------------------------------------------------------
+	*/
+	BlockStreamReader::BlockStreamReader()
+	{
+		m_stream = NULL;
+		m_streamSize = 0;
+		m_uncompressedSize = 0;
+		m_position = 0;
+		m_cachedBlock = ~0;
+		m_blockBuffer = NULL;
+	}
+
+	BlockStreamReader::~BlockStreamReader()
+	{
+		this->Shutdown();
+	}
+
+	ERet BlockStreamReader::Initialize( const void* _stream, UINT32 _streamSize, UINT32 _uncompressedSize )
+	{
+		const UINT32 tableSize = (NumBlocks( _uncompressedSize ) + 1) * sizeof(UINT32);
+		chkRET_X_IF_NOT(_streamSize >= tableSize, ERR_FAILED_TO_PARSE_DATA);
+
+		m_stream = static_cast< const BYTE* >( _stream );
+		m_streamSize = _streamSize;
+		m_uncompressedSize = _uncompressedSize;
+		m_position = 0;
+		m_cachedBlock = ~0;
+		return ALL_OK;
+	}
+
+	void BlockStreamReader::Shutdown()
+	{
+		if( m_blockBuffer ) {
+			mxFree( m_blockBuffer );
+			m_blockBuffer = NULL;
+		}
+		m_stream = NULL;
+		m_cachedBlock = ~0;
+	}
+
+	ERet BlockStreamReader::DecompressBlock( UINT32 _blockIndex, void *_destination ) const
+	{
+		const UINT32* blockOffsets = reinterpret_cast< const UINT32* >( m_stream );
+		const UINT32 start = blockOffsets[ _blockIndex ];
+		const UINT32 end = blockOffsets[ _blockIndex + 1 ];
+		chkRET_X_IF_NOT(start <= end && end <= m_streamSize, ERR_FAILED_TO_PARSE_DATA);
+
+		const UINT32 blockSize = smallest( m_uncompressedSize - _blockIndex * BLOCK_SIZE, (UINT32)BLOCK_SIZE );
+		const UINT32 packedSize = end - start;
+		if( packedSize == blockSize ) {
+			memcpy( _destination, m_stream + start, blockSize );	// stored uncompressed
+			return ALL_OK;
+		}
+		return LZ_DecompressBlock( m_stream + start, packedSize, _destination, blockSize );
+	}
+
+	ERet BlockStreamReader::Read( void *_buffer, UINT32 _size )
+	{
+		chkRET_X_IF_NOT(_size <= m_uncompressedSize - m_position, ERR_FAILED_TO_READ_FILE);
+
+		BYTE* destination = static_cast< BYTE* >( _buffer );
+		while( _size > 0 )
+		{
+			const UINT32 blockIndex = m_position / BLOCK_SIZE;
+			const UINT32 offsetInBlock = m_position % BLOCK_SIZE;
+			const UINT32 blockSize = smallest( m_uncompressedSize - blockIndex * BLOCK_SIZE, (UINT32)BLOCK_SIZE );
+			const UINT32 bytesToCopy = smallest( blockSize - offsetInBlock, _size );
+
+			if( offsetInBlock == 0 && bytesToCopy == blockSize && blockIndex != m_cachedBlock )
+			{
+				// the whole block is needed - decompress straight into the output buffer
+				mxDO(DecompressBlock( blockIndex, destination ));
+			}
+			else
+			{
+				if( blockIndex != m_cachedBlock )
+				{
+					if( !m_blockBuffer ) {
+						m_blockBuffer = (BYTE*) mxAlloc( BLOCK_SIZE );
+						chkRET_X_IF_NIL(m_blockBuffer, ERR_OUT_OF_MEMORY);
+					}
+					m_cachedBlock = ~0;
+					mxDO(DecompressBlock( blockIndex, m_blockBuffer ));
+					m_cachedBlock = blockIndex;
+				}
+				memcpy( destination, m_blockBuffer + offsetInBlock, bytesToCopy );
+			}
+
+			destination += bytesToCopy;
+			m_position += bytesToCopy;
+			_size -= bytesToCopy;
+		}
+		return ALL_OK;
+	}
+
+	ERet BlockStreamReader::Seek( UINT32 _position )
+	{
+		chkRET_X_IF_NOT(_position <= m_uncompressedSize, ERR_FAILED_TO_SEEK_FILE);
+		m_position = _position;
+		return ALL_OK;
+	}
+
+}//namespace Compression
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,81 @@
+/*
+=============================================================================
+	File:	Compression.h
+	Desc:	Fast LZ77 compression for asset packages.
+	The block format is LZ4-style: byte-aligned sequences of
+	(token, literals, 16-bit match offset, match length),
+	which decompress at memory speed with very little code.
+	Large files are split into independent blocks,
+	so that they can be decompressed in a streaming fashion (with bounded memory)
+	and read from any position.
+	References:
+	"LZ4 Block Format Description" [Yann Collet]
+	https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+=============================================================================
+*/
+#pragma once
+
+namespace Compression
+{
+	// returns the max. size of the compressed data in the worst case (for allocating the output buffer)
+	UINT32 LZ_CompressBound( UINT32 _sourceSize );
+
+	// returns the size of the compressed data or 0 if the output buffer was too small
+	UINT32 LZ_CompressBlock(
+		const void* _source, UINT32 _sourceSize,
+		void *_destination, UINT32 _destinationCapacity
+	);
+
+	// _destinationSize must be equal to the size of the original data;
+	// the input is validated, so corrupted data never causes out-of-bounds accesses
+	ERet LZ_DecompressBlock(
+		const void* _source, UINT32 _sourceSize,
+		void *_destination, UINT32 _destinationSize
+	);
+
+	//
+	// Block streams: the data is split into blocks of BLOCK_SIZE bytes, each block is compressed independently.
+	// The stream starts with the table of (numBlocks + 1) block offsets (relative to the start of the stream),
+	// a block which didn't compress is stored as is (its size is equal to the size of the uncompressed block).
+	//
+	enum { BLOCK_SIZE = 64 * mxKIBIBYTE };
+
+	UINT32 NumBlocks( UINT32 _uncompressedSize );
+
+	// appends the compressed stream to the given array
+	ERet CompressBlockStream( const void* _source, UINT32 _sourceSize, TArray< BYTE > &_stream );
+
+	// reads the compressed block stream sequentially or from any position;
+	// keeps the last decompressed block so that small reads are cheap
+	class BlockStreamReader
+	{
+		const BYTE *	m_stream;	// compressed block stream
+		UINT32			m_streamSize;
+		UINT32			m_uncompressedSize;
+		UINT32			m_position;		// current read position in the uncompressed data
+		UINT32			m_cachedBlock;	// the index of the block in the buffer, ~0 if none
+		BYTE *			m_blockBuffer;	// BLOCK_SIZE bytes, allocated on demand
+
+	public:
+		BlockStreamReader();
+		~BlockStreamReader();
+
+		ERet Initialize( const void* _stream, UINT32 _streamSize, UINT32 _uncompressedSize );
+		void Shutdown();
+
+		ERet Read( void *_buffer, UINT32 _size );
+		ERet Seek( UINT32 _position );
+
+		UINT32 Tell() const { return m_position; }
+		UINT32 GetSize() const { return m_uncompressedSize; }
+
+	private:
+		ERet DecompressBlock( UINT32 _blockIndex, void *_destination ) const;
+		PREVENT_COPY(BlockStreamReader);
+	};
+
+}//namespace Compression
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
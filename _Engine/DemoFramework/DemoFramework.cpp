@@ -3,6 +3,7 @@
 #include <Driver/Driver.h>
 #include <Graphics/Device.h>
 #include <Graphics/Utils.h>
+#include <Core/JobSystem.h>
 #include <EffectCompiler2/Effect_Compiler.h>
 #include <DemoFramework/DemoFramework.h>
 
@@ -265,6 +266,12 @@ void DemoApp::Update(const double deltaSeconds)
 
 	AssetHotReloader callback;
 	m_AssetFolder.ProcessChangedAssets(&callback);
+
+	// run the main-thread callbacks of finished jobs
+	JobSystem::ProcessContinuations();
+
+	// bring streamed-in clumps online, but spend at most 2 milliseconds per frame
+	Assets::FinalizeCompletedRequests( 0, 2000 );
 }
 // Input bindings
 void DemoApp::attack1( GameActionID action, EInputState status, float value )
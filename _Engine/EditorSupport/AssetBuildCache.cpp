@@ -0,0 +1,821 @@
+#include "EditorSupport_PCH.h"
+#pragma hdrstop
+#include <Base/Math/Hashing/HashFunctions.h>
+#include <Base/Util/FourCC.h>
+#include <Base/Util/PathUtils.h>
+#include <Base/Util/Sorting.h>
+#include <Core/JobSystem.h>
+#include <Core/Text/Preprocessor.h>
+#include <EditorSupport/AssetBuildCache.h>
+
+namespace AssetBuildCache
+{
+	Rule::Rule()
+	{
+		sourceExtension = NULL;
+		outputExtension = NULL;
+		assetType = AssetTypes::UNKNOWN;
+		settings = "";
+		includePaths = NULL;
+		implicitDependency = NULL;
+		build = NULL;
+		userData = NULL;
+	}
+
+	Settings::Settings()
+	{
+		sourceFolder = NULL;
+		outputFolder = NULL;
+		cacheFile = NULL;
+		maxThreads = 0;
+		forceRebuild = false;
+	}
+
+	Stats::Stats()
+	{
+		mxZERO_OUT(*this);
+	}
+
+	void Stats::Print() const
+	{
+		DBGOUT("Assets: %u total, %u up-to-date, %u built, %u failed; %u files hashed; checked in %u ms, built in %u ms.\n",
+			numAssets, numUpToDate, numBuilt, numFailed, numFilesHashed, checkTime, buildTime);
+	}
+
+	namespace
+	{
+		enum
+		{
+			CACHE_FOURCC = MCHAR4('A','B','L','D'),
+			CACHE_VERSION = 1,
+		};
+
+		// the state of a source file or a dependency
+		struct FileState
+		{
+			UINT64	size;
+			UINT64	timeStamp;		// last write time
+			UINT64	contentHash;	// MurmurHash64() of the file contents
+		};
+
+		// the layout of the cache file:
+		// CacheHeader, CachedFile[numFiles], CachedAsset[numAssets], UINT32[numDependencies], char[stringsSize]
+		struct CacheHeader
+		{
+			UINT32	fourCC;
+			UINT32	version;
+			UINT32	numFiles;
+			UINT32	numAssets;
+			UINT32	numDependencies;
+			UINT32	stringsSize;
+		};
+		struct CachedFile
+		{
+			FileState	state;
+			UINT32		path;	// offset in the string table
+			UINT32		_pad;
+		};
+		struct CachedAsset
+		{
+			UINT64	buildKey;
+			UINT32	sourceFile;			// index of the source file
+			UINT32	firstDependency;	// index of the first dependency in the dependency array
+			UINT32	numDependencies;
+			UINT32	_pad;
+		};
+
+		static bool GetFileSizeAndTime( const char* _path, UINT64 &_size, UINT64 &_timeStamp )
+		{
+			FileReader	file;
+			if( mxFAILED(file.Open( _path, FileRead_NoErrors )) ) {
+				return false;
+			}
+			const FileTimeT lastWriteTime = file.GetTimeStamp();
+			_size = file.GetSize();
+			_timeStamp = ((UINT64)lastWriteTime.time.dwHighDateTime << 32) | lastWriteTime.time.dwLowDateTime;
+			return true;
+		}
+
+		static ERet LoadFile( const char* _fileName, TArray< BYTE > &_data )
+		{
+			FileReader	file;
+			mxDO(file.Open( _fileName, FileRead_NoErrors ));
+			const size_t fileSize = file.GetSize();
+			chkRET_X_IF_NOT(fileSize < MAX_UINT32, ERR_BUFFER_TOO_SMALL);
+			mxDO(_data.SetNum( fileSize ));
+			if( fileSize ) {
+				mxDO(file.Read( _data.ToPtr(), fileSize ));
+			}
+			return ALL_OK;
+		}
+
+		static inline UINT64 CombineHashes( UINT64 _hash, UINT64 _value )
+		{
+			const UINT64 values[2] = { _hash, _value };
+			return MurmurHash64( values, sizeof(values) );
+		}
+
+		// the build key of the asset is a hash of the build settings,
+		// the version of the asset type and the contents of all input files
+		static UINT64 ComputeBuildKey( const Rule& _rule, const FileState* _inputs, UINT32 _numInputs )
+		{
+			UINT64 key = MurmurHash64( _rule.settings, strlen( _rule.settings ), Assets::GetAssetTypeVersion( _rule.assetType ) );
+			key = CombineHashes( key, MurmurHash64( _rule.outputExtension, strlen( _rule.outputExtension ) ) );
+			for( UINT32 i = 0; i < _numInputs; i++ ) {
+				key = CombineHashes( key, _inputs[i].contentHash );
+			}
+			return key;
+		}
+
+		// removes "./" and "folder/../" from the normalized path, so that each file has a single name
+		static void CollapseRelativeSegments( String &_path )
+		{
+			char* s = _path.ToPtr();
+			const UINT32 length = _path.Length();
+			UINT32 written = 0;
+			UINT32 i = 0;
+			while( i < length )
+			{
+				UINT32 end = i;
+				while( end < length && s[end] != '/' ) {
+					end++;
+				}
+				const UINT32 segmentLength = end - i;
+				const bool hasSlash = (end < length);
+				if( hasSlash && segmentLength == 1 && s[i] == '.' )
+				{
+					// skip "./"
+				}
+				else if( hasSlash && segmentLength == 2 && s[i] == '.' && s[i+1] == '.' && written > 0 )
+				{
+					// find the previous segment (written always ends with a slash here)
+					UINT32 previous = written - 1;
+					while( previous > 0 && s[previous - 1] != '/' ) {
+						previous--;
+					}
+					const UINT32 previousLength = written - 1 - previous;
+					const bool canCollapse = previousLength > 0
+						&& !(previousLength == 2 && s[previous] == '.' && s[previous+1] == '.')
+						&& s[written - 2] != ':';	// don't remove drive letters
+					if( canCollapse ) {
+						written = previous;
+					} else {
+						memmove( s + written, s + i, segmentLength + 1 );
+						written += segmentLength + 1;
+					}
+				}
+				else
+				{
+					const UINT32 count = segmentLength + (hasSlash ? 1 : 0);
+					memmove( s + written, s + i, count );
+					written += count;
+				}
+				i = end + 1;
+			}
+			_path.CapLength( written );
+		}
+
+		// resolves #includes relative to the including file and then in the search paths
+		class IncludeResolver : public AFileInclude
+		{
+			const StringListT &	m_searchPaths;
+			StringListT			m_openedFiles;	// stack of full paths
+			String256			m_candidate;
+
+		public:
+			IncludeResolver( const StringListT& _searchPaths )
+				: m_searchPaths( _searchPaths )
+			{}
+
+			virtual bool OpenFile( const char* fileName, char **fileData, UINT32 *fileSize ) override
+			{
+				if( !m_openedFiles.Num() )
+				{
+					Str::CopyS( m_candidate, fileName );
+					return this->TryOpen( fileData, fileSize );
+				}
+				Str::Copy( m_candidate, m_openedFiles.GetLast() );
+				Str::StripFileName( m_candidate );
+				Str::AppendS( m_candidate, fileName );
+				if( this->TryOpen( fileData, fileSize ) ) {
+					return true;
+				}
+				for( UINT32 i = 0; i < m_searchPaths.Num(); i++ )
+				{
+					Str::Copy( m_candidate, m_searchPaths[i] );
+					Str::AppendS( m_candidate, fileName );
+					if( this->TryOpen( fileData, fileSize ) ) {
+						return true;
+					}
+				}
+				return false;
+			}
+			virtual void CloseFile( char* fileData ) override
+			{
+				Util_DeleteString( fileData );
+				m_openedFiles.PopLast();
+			}
+			virtual const char* CurrentFilePath() const override
+			{
+				return m_openedFiles.Num() ? m_openedFiles.GetLast().c_str() : "";
+			}
+
+		private:
+			bool TryOpen( char **fileData, UINT32 *fileSize )
+			{
+				Str::FixBackSlashes( m_candidate );
+				CollapseRelativeSegments( m_candidate );
+				if( mxSUCCEDED(Util_LoadFileToString( m_candidate.c_str(), fileData, fileSize )) ) {
+					Str::Copy( m_openedFiles.Add(), m_candidate );
+					return true;
+				}
+				return false;
+			}
+		};
+
+		static void SplitSearchPaths( const char* _paths, StringListT &_searchPaths )
+		{
+			const char* p = _paths;
+			while( p && *p )
+			{
+				const char* end = p;
+				while( *end && *end != ';' ) {
+					end++;
+				}
+				if( end > p )
+				{
+					String & path = _searchPaths.Add();
+					Str::CopyS( path, p, int(end - p) );
+					Str::NormalizePath( path );
+				}
+				p = *end ? end + 1 : end;
+			}
+		}
+
+		struct CompareStrings
+		{
+			bool operator () ( const String& _a, const String& _b ) const
+			{
+				return strcmp( _a.c_str(), _b.c_str() ) < 0;
+			}
+		};
+
+		struct FileRecord
+		{
+			String		path;
+			FileState	state;
+			bool		checked;	// the state has been checked during this build
+		};
+		struct AssetRecord
+		{
+			UINT64	buildKey;
+			UINT32	firstDependency;	// in BuildCache::m_dependencies
+			UINT32	numDependencies;
+			bool	seen;	// the source file exists (records of deleted sources are not saved)
+		};
+
+		class BuildCache
+		{
+			TArray< FileRecord >		m_files;
+			THashMap< String, UINT32 >	m_fileIndices;	// file path -> index in m_files
+			THashMap< UINT32, AssetRecord >	m_assets;	// index of the source file -> asset
+			TArray< UINT32 >			m_dependencies;	// indices of files
+
+		public:
+			AtomicInt	numFilesHashed;
+
+		public:
+			BuildCache()
+			{
+				numFilesHashed = 0;
+			}
+
+			void Clear()
+			{
+				m_files.Empty();
+				m_fileIndices.Empty();
+				m_assets.Empty();
+				m_dependencies.Empty();
+			}
+
+			ERet Load( const char* _fileName )
+			{
+				TArray< BYTE >	data;
+				if( mxFAILED(LoadFile( _fileName, data )) ) {
+					return ALL_OK;	// the first build
+				}
+				chkRET_X_IF_NOT(data.Num() >= sizeof(CacheHeader), ERR_FAILED_TO_PARSE_DATA);
+				const CacheHeader& header = *c_cast(const CacheHeader*) data.ToPtr();
+				if( header.fourCC != CACHE_FOURCC || header.version != CACHE_VERSION ) {
+					ptWARN("Ignoring '%s': unknown format.\n", _fileName);
+					return ALL_OK;
+				}
+				const UINT64 expectedSize = sizeof(CacheHeader)
+					+ (UINT64)header.numFiles * sizeof(CachedFile)
+					+ (UINT64)header.numAssets * sizeof(CachedAsset)
+					+ (UINT64)header.numDependencies * sizeof(UINT32)
+					+ header.stringsSize;
+				chkRET_X_IF_NOT(data.Num() == expectedSize && header.stringsSize > 0, ERR_FAILED_TO_PARSE_DATA);
+
+				const CachedFile* files = c_cast(const CachedFile*) (data.ToPtr() + sizeof(CacheHeader));
+				const CachedAsset* assets = c_cast(const CachedAsset*) (files + header.numFiles);
+				const UINT32* dependencies = c_cast(const UINT32*) (assets + header.numAssets);
+				const char* strings = c_cast(const char*) (dependencies + header.numDependencies);
+				chkRET_X_IF_NOT(strings[ header.stringsSize - 1 ] == '\0', ERR_FAILED_TO_PARSE_DATA);
+
+				for( UINT32 i = 0; i < header.numFiles; i++ )
+				{
+					chkRET_X_IF_NOT(files[i].path < header.stringsSize, ERR_FAILED_TO_PARSE_DATA);
+					const UINT32 fileIndex = this->AddFile( strings + files[i].path );
+					m_files[ fileIndex ].state = files[i].state;
+				}
+				mxDO(m_dependencies.SetNum( header.numDependencies ));
+				for( UINT32 i = 0; i < header.numDependencies; i++ )
+				{
+					chkRET_X_IF_NOT(dependencies[i] < header.numFiles, ERR_FAILED_TO_PARSE_DATA);
+					m_dependencies[i] = dependencies[i];
+				}
+				for( UINT32 i = 0; i < header.numAssets; i++ )
+				{
+					const CachedAsset& asset = assets[i];
+					chkRET_X_IF_NOT(asset.sourceFile < header.numFiles, ERR_FAILED_TO_PARSE_DATA);
+					chkRET_X_IF_NOT((UINT64)asset.firstDependency + asset.numDependencies <= header.numDependencies, ERR_FAILED_TO_PARSE_DATA);
+					AssetRecord	record;
+					record.buildKey = asset.buildKey;
+					record.firstDependency = asset.firstDependency;
+					record.numDependencies = asset.numDependencies;
+					record.seen = false;
+					m_assets.Set( asset.sourceFile, record );
+				}
+				return ALL_OK;
+			}
+
+			// saves the assets whose sources were found during this build
+			ERet Save( const char* _fileName ) const
+			{
+				TArray< CachedFile >	files;
+				TArray< CachedAsset >	assets;
+				TArray< UINT32 >		dependencies;
+				TArray< char >			strings;
+
+				// only the files used by the saved assets are written
+				TArray< UINT32 >	remap;
+				mxDO(remap.SetNum( m_files.Num() ));
+				for( UINT32 i = 0; i < remap.Num(); i++ ) {
+					remap[i] = ~0u;
+				}
+
+				for( UINT32 fileIndex = 0; fileIndex < m_files.Num(); fileIndex++ )
+				{
+					const AssetRecord* record = m_assets.Find( fileIndex );
+					if( !record || !record->seen ) {
+						continue;
+					}
+					CachedAsset & asset = assets.Add();
+					asset.buildKey = record->buildKey;
+					asset.sourceFile = SaveFile( fileIndex, remap, files, strings );
+					asset.firstDependency = dependencies.Num();
+					asset.numDependencies = record->numDependencies;
+					asset._pad = 0;
+					for( UINT32 i = 0; i < record->numDependencies; i++ ) {
+						const UINT32 dependency = m_dependencies[ record->firstDependency + i ];
+						dependencies.Add( SaveFile( dependency, remap, files, strings ) );
+					}
+				}
+				if( !strings.Num() ) {
+					strings.Add( '\0' );
+				}
+
+				CacheHeader	header;
+				header.fourCC = CACHE_FOURCC;
+				header.version = CACHE_VERSION;
+				header.numFiles = files.Num();
+				header.numAssets = assets.Num();
+				header.numDependencies = dependencies.Num();
+				header.stringsSize = strings.Num();
+
+				FileWriter	writer;
+				mxDO(writer.Open( _fileName ));
+				mxDO(writer.Put( header ));
+				mxDO(writer.Write( files.ToPtr(), files.GetDataSize() ));
+				mxDO(writer.Write( assets.ToPtr(), assets.GetDataSize() ));
+				mxDO(writer.Write( dependencies.ToPtr(), dependencies.GetDataSize() ));
+				mxDO(writer.Write( strings.ToPtr(), strings.GetDataSize() ));
+				return ALL_OK;
+			}
+
+			UINT32 AddFile( const char* _path )
+			{
+				String256	key;
+				Str::CopyS( key, _path );
+				const UINT32* existing = m_fileIndices.Find( key );
+				if( existing ) {
+					return *existing;
+				}
+				const UINT32 newIndex = m_files.Num();
+				FileRecord & newFile = m_files.Add();
+				Str::Copy( newFile.path, key );
+				mxZERO_OUT( newFile.state );
+				newFile.checked = false;
+				m_fileIndices.Set( newFile.path, newIndex );
+				return newIndex;
+			}
+
+			// returns NULL if the file is not in the cache (can be called from any thread during the build)
+			const FileRecord* FindFile( const char* _path ) const
+			{
+				String256	key;
+				Str::CopyS( key, _path );
+				const UINT32* existing = m_fileIndices.Find( key );
+				return existing ? &m_files[ *existing ] : NULL;
+			}
+
+			// updates the state of the file, hashes its contents only if it has changed;
+			// returns false if the file doesn't exist
+			bool CheckFile( UINT32 _fileIndex )
+			{
+				FileRecord & file = m_files[ _fileIndex ];
+				if( !file.checked )
+				{
+					FileState	newState;
+					if( !this->GetFileState( file.path.c_str(), &file.state, newState ) ) {
+						return false;
+					}
+					file.state = newState;
+					file.checked = true;
+				}
+				return true;
+			}
+
+			// hashes the file if it's not in the cache or has been changed (thread-safe)
+			bool GetFileState( const char* _path, const FileState* _cached, FileState &_state )
+			{
+				if( !GetFileSizeAndTime( _path, _state.size, _state.timeStamp ) ) {
+					return false;
+				}
+				if( _cached && _cached->size == _state.size && _cached->timeStamp == _state.timeStamp ) {
+					_state.contentHash = _cached->contentHash;
+					return true;
+				}
+				TArray< BYTE >	data;
+				if( mxFAILED(LoadFile( _path, data )) ) {
+					return false;
+				}
+				_state.contentHash = MurmurHash64( data.ToPtr(), data.Num() );
+				AtomicIncrement( numFilesHashed );
+				return true;
+			}
+
+			// returns true if the asset doesn't need to be rebuilt
+			bool IsUpToDate( UINT32 _sourceFile, const Rule& _rule, const char* _outputFile )
+			{
+				AssetRecord* record = m_assets.Find( _sourceFile );
+				if( !record ) {
+					return false;
+				}
+				record->seen = true;
+
+				if( !OS::IO::FileExists( _outputFile ) ) {
+					return false;
+				}
+
+				TArray< FileState >	inputs;
+				if( mxFAILED(inputs.SetNum( record->numDependencies + 1 )) ) {
+					return false;	// out of memory, rebuild the asset
+				}
+				if( !this->CheckFile( _sourceFile ) ) {
+					return false;
+				}
+				inputs[0] = m_files[ _sourceFile ].state;
+				for( UINT32 i = 0; i < record->numDependencies; i++ )
+				{
+					const UINT32 dependency = m_dependencies[ record->firstDependency + i ];
+					if( !this->CheckFile( dependency ) ) {
+						return false;	// the file has been deleted
+					}
+					inputs[ i + 1 ] = m_files[ dependency ].state;
+				}
+				return ComputeBuildKey( _rule, inputs.ToPtr(), inputs.Num() ) == record->buildKey;
+			}
+
+			void UpdateAsset( UINT32 _sourceFile, UINT64 _buildKey, const StringListT& _inputs, const FileState* _states )
+			{
+				AssetRecord	record;
+				record.buildKey = _buildKey;
+				record.firstDependency = m_dependencies.Num();
+				record.numDependencies = _inputs.Num() - 1;
+				record.seen = true;
+
+				for( UINT32 i = 0; i < _inputs.Num(); i++ )
+				{
+					const UINT32 fileIndex = (i == 0) ? _sourceFile : this->AddFile( _inputs[i].c_str() );
+					m_files[ fileIndex ].state = _states[i];
+					m_files[ fileIndex ].checked = true;
+					if( i > 0 ) {
+						m_dependencies.Add( fileIndex );
+					}
+				}
+				m_assets.Set( _sourceFile, record );
+			}
+
+			void RemoveAsset( UINT32 _sourceFile )
+			{
+				m_assets.Remove( _sourceFile );
+			}
+
+		private:
+			UINT32 SaveFile( UINT32 _fileIndex, TArray< UINT32 > &_remap, TArray< CachedFile > &_files, TArray< char > &_strings ) const
+			{
+				if( _remap[ _fileIndex ] == ~0u )
+				{
+					const FileRecord& file = m_files[ _fileIndex ];
+					_remap[ _fileIndex ] = _files.Num();
+
+					CachedFile & cachedFile = _files.Add();
+					cachedFile.state = file.state;
+					cachedFile.path = _strings.Num();
+					cachedFile._pad = 0;
+
+					const UINT32 length = file.path.Length() + 1;
+					_strings.SetNum( _strings.Num() + length );
+					memcpy( _strings.ToPtr() + cachedFile.path, file.path.c_str(), length );
+				}
+				return _remap[ _fileIndex ];
+			}
+		};
+
+		struct AssetJob
+		{
+			const Rule *	rule;
+			UINT32			sourceFile;	// index in the build cache
+			String256		sourcePath;
+			String256		outputPath;
+
+			// filled on the worker thread:
+			StringListT			inputs;		// the source file and the sorted dependencies
+			TArray< FileState >	states;		// the states of the inputs before the build
+			UINT64				buildKey;
+			bool				succeeded;
+		};
+
+		// collects the source files matching the rules
+		struct SourceCollector : ADirectoryWalker
+		{
+			const Rule *	rules;
+			UINT32			numRules;
+			StringListT		paths;
+			TArray< UINT32 >	ruleIndices;
+
+		public:
+			virtual bool Found_File( const SFindFileInfo& _file ) override
+			{
+				for( UINT32 i = 0; i < numRules; i++ )
+				{
+					const Rule& rule = rules[i];
+					if( Str::HasExtensionS( _file.fileNameOnly.c_str(), rule.sourceExtension )
+						&& !(rule.implicitDependency && !stricmp( _file.fileNameOnly.c_str(), rule.implicitDependency )) )
+					{
+						String & path = paths.Add();
+						Str::Copy( path, _file.fullFileName );
+						Str::FixBackSlashes( path );
+						ruleIndices.Add( i );
+						break;
+					}
+				}
+				return false;
+			}
+		};
+
+		struct ParallelBuildData
+		{
+			BuildCache *	cache;
+			AssetJob *		jobs;
+			const UINT32 *	dirtyJobs;
+		};
+
+		static ERet BuildAsset( BuildCache& _cache, AssetJob &_job )
+		{
+			const Rule& rule = *_job.rule;
+
+			// find the dependencies before building, so that changes made during the build are not missed
+			StringListT	dependencies;
+			if( rule.includePaths )
+			{
+				StringListT	searchPaths;
+				SplitSearchPaths( rule.includePaths, searchPaths );
+				IncludeResolver	resolver( searchPaths );
+				mxDO(PP_CollectIncludes( _job.sourcePath.c_str(), &resolver, dependencies ));
+			}
+			if( rule.implicitDependency )
+			{
+				String256	path;
+				Str::Copy( path, _job.sourcePath );
+				Str::StripFileName( path );
+				Str::AppendS( path, rule.implicitDependency );
+				CollapseRelativeSegments( path );
+				bool alreadyIncluded = false;
+				for( UINT32 i = 0; i < dependencies.Num(); i++ ) {
+					alreadyIncluded |= Str::EqualS( dependencies[i], path.c_str() );
+				}
+				if( !alreadyIncluded && OS::IO::FileExists( path.c_str() ) ) {
+					Str::Copy( dependencies.Add(), path );
+				}
+			}
+			if( dependencies.Num() > 1 ) {
+				CompareStrings	predicate;
+				NxQuickSort< String, CompareStrings >( dependencies.ToPtr(), dependencies.ToPtr() + dependencies.Num() - 1, predicate );
+			}
+
+			Str::Copy( _job.inputs.Add(), _job.sourcePath );
+			for( UINT32 i = 0; i < dependencies.Num(); i++ ) {
+				Str::Copy( _job.inputs.Add(), dependencies[i] );
+			}
+
+			mxDO(_job.states.SetNum( _job.inputs.Num() ));
+			for( UINT32 i = 0; i < _job.inputs.Num(); i++ )
+			{
+				const FileRecord* cached = _cache.FindFile( _job.inputs[i].c_str() );
+				if( !_cache.GetFileState( _job.inputs[i].c_str(), cached ? &cached->state : NULL, _job.states[i] ) ) {
+					ptWARN("Failed to read '%s'.\n", _job.inputs[i].c_str());
+					return ERR_FAILED_TO_READ_FILE;
+				}
+			}
+			_job.buildKey = ComputeBuildKey( rule, _job.states.ToPtr(), _job.states.Num() );
+
+			BuildJob	buildJob;
+			buildJob.rule = &rule;
+			buildJob.sourceFile = _job.sourcePath.c_str();
+			buildJob.outputFile = _job.outputPath.c_str();
+			mxDO(rule.build( buildJob ));
+
+			return ALL_OK;
+		}
+
+		static void BuildAssetCallback( UINT _index, UINT _slotIndex, void* _userData )
+		{
+			ParallelBuildData& data = *static_cast< ParallelBuildData* >( _userData );
+			AssetJob& job = data.jobs[ data.dirtyJobs[ _index ] ];
+			job.succeeded = mxSUCCEDED(BuildAsset( *data.cache, job ));
+			if( !job.succeeded ) {
+				ptWARN("Failed to build '%s'.\n", job.sourcePath.c_str());
+			}
+		}
+	}//namespace
+
+	ERet Build( const Settings& _settings, const Rule* _rules, UINT32 _numRules, Stats *_stats )
+	{
+		chkRET_X_IF_NIL(_settings.sourceFolder, ERR_NULL_POINTER_PASSED);
+		chkRET_X_IF_NIL(_settings.outputFolder, ERR_NULL_POINTER_PASSED);
+		chkRET_X_IF_NIL(_rules, ERR_NULL_POINTER_PASSED);
+		for( UINT32 i = 0; i < _numRules; i++ ) {
+			chkRET_X_IF_NOT(_rules[i].sourceExtension && _rules[i].outputExtension && _rules[i].settings && _rules[i].build, ERR_INVALID_PARAMETER);
+		}
+
+		const UINT32 startTime = mxGetTimeInMilliseconds();
+
+		String256	outputFolder;
+		Str::CopyS( outputFolder, _settings.outputFolder );
+		Str::NormalizePath( outputFolder );
+
+		String256	cacheFile;
+		if( _settings.cacheFile ) {
+			Str::CopyS( cacheFile, _settings.cacheFile );
+		} else {
+			Str::Copy( cacheFile, outputFolder );
+			Str::AppendS( cacheFile, "assets.cache" );
+		}
+
+		BuildCache	cache;
+		if( !_settings.forceRebuild && mxFAILED(cache.Load( cacheFile.c_str() )) ) {
+			ptWARN("The build cache '%s' is corrupted, rebuilding all assets.\n", cacheFile.c_str());
+			cache.Clear();
+		}
+
+		SourceCollector	collector;
+		collector.rules = _rules;
+		collector.numRules = _numRules;
+		{
+			String256	sourceFolder;
+			Str::CopyS( sourceFolder, _settings.sourceFolder );
+			Str::NormalizePath( sourceFolder );
+			chkRET_X_IF_NOT(OS::IO::PathExists( sourceFolder.c_str() ), ERR_FILE_OR_PATH_NOT_FOUND);
+			Win32_ProcessFilesInDirectory( sourceFolder.c_str(), &collector, true );
+		}
+		const UINT32 numAssets = collector.paths.Num();
+
+		// find the assets which must be rebuilt
+		TArray< AssetJob >	jobs;
+		mxDO(jobs.SetNum( numAssets ));
+		TArray< UINT32 >	dirtyJobs;
+
+		// all outputs are written into the same folder, so sources with the same name in different folders would overwrite each other
+		THashMap< String, UINT32 >	outputIndices;	// output path -> index of the job
+
+		for( UINT32 i = 0; i < numAssets; i++ )
+		{
+			AssetJob & job = jobs[i];
+			job.rule = &_rules[ collector.ruleIndices[i] ];
+			job.sourceFile = cache.AddFile( collector.paths[i].c_str() );
+			job.buildKey = 0;
+			job.succeeded = false;
+			Str::Copy( job.sourcePath, collector.paths[i] );
+
+			Str::Copy( job.outputPath, outputFolder );
+			Str::AppendS( job.outputPath, Str::GetFileName( job.sourcePath.c_str() ) );
+			Str::SetFileExtension( job.outputPath, job.rule->outputExtension );
+
+			const UINT32* existing = outputIndices.Find( job.outputPath );
+			if( existing ) {
+				ptERROR("'%s' and '%s' are built into the same file '%s'.\n",
+					jobs[ *existing ].sourcePath.c_str(), job.sourcePath.c_str(), job.outputPath.c_str());
+				return ERR_NAME_ALREADY_TAKEN;
+			}
+			outputIndices.Set( job.outputPath, i );
+
+			if( _settings.forceRebuild || !cache.IsUpToDate( job.sourceFile, *job.rule, job.outputPath.c_str() ) ) {
+				dirtyJobs.Add( i );
+			}
+		}
+
+		const UINT32 checkTime = mxGetTimeInMilliseconds() - startTime;
+
+		// build the dirty assets in parallel
+		if( dirtyJobs.Num() )
+		{
+			ParallelBuildData	data;
+			data.cache = &cache;
+			data.jobs = jobs.ToPtr();
+			data.dirtyJobs = dirtyJobs.ToPtr();
+			JobSystem::ParallelFor( dirtyJobs.Num(), &BuildAssetCallback, &data, _settings.maxThreads );
+		}
+
+		UINT32 numFailed = 0;
+		for( UINT32 i = 0; i < dirtyJobs.Num(); i++ )
+		{
+			const AssetJob& job = jobs[ dirtyJobs[i] ];
+			if( job.succeeded ) {
+				cache.UpdateAsset( job.sourceFile, job.buildKey, job.inputs, job.states.ToPtr() );
+			} else {
+				cache.RemoveAsset( job.sourceFile );
+				numFailed++;
+			}
+		}
+
+		mxDO(cache.Save( cacheFile.c_str() ));
+
+		Stats	stats;
+		stats.numAssets = numAssets;
+		stats.numUpToDate = numAssets - dirtyJobs.Num();
+		stats.numBuilt = dirtyJobs.Num() - numFailed;
+		stats.numFailed = numFailed;
+		stats.numFilesHashed = cache.numFilesHashed;
+		stats.checkTime = checkTime;
+		stats.buildTime = mxGetTimeInMilliseconds() - startTime - checkTime;
+		stats.Print();
+
+		if( _stats ) {
+			*_stats = stats;
+		}
+		return numFailed ? ERR_COMPILATION_FAILED : ALL_OK;
+	}
+
+	ERet RunCommand( const char* _commandLine )
+	{
+		chkRET_X_IF_NIL(_commandLine, ERR_NULL_POINTER_PASSED);
+
+		// CreateProcess() may modify the command line
+		TArray< char >	commandLine;
+		mxDO(commandLine.SetNum( strlen( _commandLine ) + 1 ));
+		strcpy( commandLine.ToPtr(), _commandLine );
+
+		STARTUPINFOA	startupInfo;
+		mxZERO_OUT(startupInfo);
+		startupInfo.cb = sizeof(startupInfo);
+
+		PROCESS_INFORMATION	processInfo;
+		mxZERO_OUT(processInfo);
+
+		if( !::CreateProcessA( NULL, commandLine.ToPtr(), NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &processInfo ) ) {
+			ptWARN("Failed to run '%s' (error %u).\n", _commandLine, ::GetLastError());
+			return ERR_FILE_OR_PATH_NOT_FOUND;
+		}
+
+		::WaitForSingleObject( processInfo.hProcess, INFINITE );
+
+		DWORD exitCode = 0;
+		::GetExitCodeProcess( processInfo.hProcess, &exitCode );
+		::CloseHandle( processInfo.hThread );
+		::CloseHandle( processInfo.hProcess );
+
+		if( exitCode != 0 ) {
+			ptWARN("'%s' failed with exit code %u.\n", _commandLine, exitCode);
+			return ERR_COMPILATION_FAILED;
+		}
+		return ALL_OK;
+	}
+
+}//namespace AssetBuildCache
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
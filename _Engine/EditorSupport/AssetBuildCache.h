@@ -0,0 +1,83 @@
+/*
+=============================================================================
+	File:	AssetBuildCache.h
+	Desc:	Incremental asset build with a content-addressed cache.
+	Each asset is rebuilt only if its build key has changed, the key is a hash of
+	the contents of the source file and its dependencies (e.g. #included files),
+	the build settings and the asset type version (see Assets::GetAssetTypeVersion()).
+	Contents of files are hashed only if their sizes or time stamps have changed,
+	so a build without changes only checks the time stamps.
+=============================================================================
+*/
+#pragma once
+
+#include <Core/Asset.h>
+
+namespace AssetBuildCache
+{
+	struct Rule;
+
+	// describes a single asset to build
+	struct BuildJob
+	{
+		const Rule *	rule;
+		const char *	sourceFile;
+		const char *	outputFile;
+	};
+
+	// builds the output file from the source file; called on worker threads
+	typedef ERet F_BuildAsset( const BuildJob& _job );
+
+	// describes how to build assets from source files with the given extension
+	struct Rule
+	{
+		const char *	sourceExtension;	// e.g. "sc"
+		const char *	outputExtension;	// e.g. "bin"
+		AssetTypeT		assetType;			// the version of this type is a part of the build key
+		const char *	settings;			// e.g. command line options; changing them rebuilds all assets of this rule
+		const char *	includePaths;		// semicolon-separated folders for finding #included files, NULL if not needed
+		const char *	implicitDependency;	// optional: name of a file in the source folder all sources depend on (it's not built)
+		F_BuildAsset *	build;
+		void *			userData;
+	public:
+		Rule();
+	};
+
+	struct Settings
+	{
+		const char *	sourceFolder;	// searched recursively
+		const char *	outputFolder;	// output files are named after source files without path
+		const char *	cacheFile;		// NULL means "<output folder>/assets.cache"
+		UINT32			maxThreads;		// the max. number of assets built at the same time, 0 - use all threads of the job system
+		bool			forceRebuild;	// ignore the cache
+	public:
+		Settings();
+	};
+
+	struct Stats
+	{
+		UINT32	numAssets;
+		UINT32	numUpToDate;
+		UINT32	numBuilt;
+		UINT32	numFailed;
+		UINT32	numFilesHashed;	// files whose contents had to be hashed
+		UINT32	checkTime;		// time of finding dirty assets, in milliseconds
+		UINT32	buildTime;		// time of building dirty assets, in milliseconds
+	public:
+		Stats();
+		void Print() const;
+	};
+
+	// builds the dirty assets in parallel (see JobSystem::ParallelFor()) and updates the cache;
+	// returns ERR_COMPILATION_FAILED if some assets failed to build (they will be rebuilt next time)
+	// or ERR_NAME_ALREADY_TAKEN (before building anything) if two source files have the same name
+	ERet Build( const Settings& _settings, const Rule* _rules, UINT32 _numRules, Stats *_stats = nil );
+
+	// runs the command line and waits for the process to exit; fails if the exit code is not zero
+	ERet RunCommand( const char* _commandLine );
+
+}//namespace AssetBuildCache
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,405 @@
+#include "EditorSupport_PCH.h"
+#pragma hdrstop
+#include <Base/Util/PathUtils.h>
+#include <Base/Util/Sorting.h>
+#include <Core/Util/Compression.h>
+#include <Core/Serialization.h>
+#include <EditorSupport/DevAssetFolder.h>
+#include <EditorSupport/AssetPackager.h>
+
+namespace AssetPackager
+{
+	Settings::Settings()
+	{
+		alignment = 16;
+		minSizeToCompress = 1024;
+		minSavingsPercent = 10;
+		compress = true;
+		recurseSubfolders = true;
+		pageAlignImages = true;
+	}
+
+	Stats::Stats()
+	{
+		mxZERO_OUT(*this);
+	}
+
+	void Stats::Print() const
+	{
+		DBGOUT("Package: %u files (%u compressed), %u KiB -> %u KiB, built in %u ms.\n",
+			numFiles, numCompressed,
+			(UINT32)(uncompressedSize / mxKIBIBYTE), (UINT32)(packageSize / mxKIBIBYTE),
+			buildTime);
+	}
+
+	namespace
+	{
+		struct SourceFile
+		{
+			UINT32	name;	// offset of the file name in the string buffer
+			UINT32	path;	// offset of the full file name in the string buffer
+			UINT32	hash;	// AssetId_GetHash32()
+			UINT32	order;	// the index of the file in the order of enumeration
+		};
+
+		// collects the files in the asset folder
+		struct FileCollector : ADirectoryWalker
+		{
+			TArray< SourceFile >	files;
+			TArray< char >			strings;
+
+		public:
+			const char* GetName( const SourceFile& _file ) const { return strings.ToPtr() + _file.name; }
+			const char* GetPath( const SourceFile& _file ) const { return strings.ToPtr() + _file.path; }
+
+			virtual bool Found_File( const SFindFileInfo& _file ) override
+			{
+				SourceFile& newFile = files.Add();
+				newFile.name = AddString( _file.fileNameOnly.c_str() );
+				newFile.path = AddString( _file.fullFileName.c_str() );
+				newFile.hash = AssetId_GetHash32( MakeAssetID( _file.fileNameOnly.c_str() ) );
+				newFile.order = files.Num() - 1;
+				return false;
+			}
+
+		private:
+			UINT32 AddString( const char* _string )
+			{
+				const UINT32 offset = strings.Num();
+				const UINT32 length = strlen( _string ) + 1;
+				strings.SetNum( offset + length );
+				memcpy( strings.ToPtr() + offset, _string, length );
+				return offset;
+			}
+		};
+
+		// the order of the table of contents
+		struct CompareByHashAndName
+		{
+			const FileCollector &	collector;
+		public:
+			CompareByHashAndName( const FileCollector& _collector ) : collector( _collector ) {}
+			bool operator () ( const SourceFile& _a, const SourceFile& _b ) const
+			{
+				if( _a.hash != _b.hash ) {
+					return _a.hash < _b.hash;
+				}
+				return strcmp( collector.GetName( _a ), collector.GetName( _b ) ) < 0;
+			}
+		};
+
+		static ERet CollectFiles( const char* _folder, bool _recurseSubfolders, String256 &_path, FileCollector &_collector )
+		{
+			Str::CopyS( _path, _folder );
+			Str::NormalizePath( _path );
+			chkRET_X_IF_NOT(OS::IO::PathExists( _path.c_str() ), ERR_FILE_OR_PATH_NOT_FOUND);
+			Win32_ProcessFilesInDirectory( _path.c_str(), &_collector, _recurseSubfolders );
+			return ALL_OK;
+		}
+
+		static ERet LoadFile( const char* _fileName, TArray< BYTE > &_data )
+		{
+			FileReader	file;
+			mxDO(file.Open( _fileName ));
+			const size_t fileSize = file.GetSize();
+			chkRET_X_IF_NOT(fileSize < MAX_UINT32, ERR_BUFFER_TOO_SMALL);
+			mxDO(_data.SetNum( fileSize ));
+			if( fileSize ) {
+				mxDO(file.Read( _data.ToPtr(), fileSize ));
+			}
+			return ALL_OK;
+		}
+
+		// clump images are loaded in place from the package view (see Serialization::LoadClumpInPlace())
+		static bool IsClumpImage( const TArray< BYTE >& _data )
+		{
+			if( _data.Num() < sizeof(Serialization::ImageHeader) ) {
+				return false;
+			}
+			const Serialization::ImageHeader* header = c_cast(const Serialization::ImageHeader*) _data.ToPtr();
+			return header->classId == Clump::MetaClass().GetTypeID()
+				&& header->payload <= _data.Num() - sizeof(Serialization::ImageHeader);
+		}
+
+		static ERet WritePadding( FileWriter &_writer, UINT32 _size )
+		{
+			static const BYTE zeros[ 4096 ] = { 0 };
+			while( _size > 0 )
+			{
+				const UINT32 chunkSize = smallest( _size, (UINT32)sizeof(zeros) );
+				mxDO(_writer.Write( zeros, chunkSize ));
+				_size -= chunkSize;
+			}
+			return ALL_OK;
+		}
+	}//namespace
+
+	ERet BuildPackage(
+		const char* _sourceFolder,
+		const char* _packageFile,
+		const Settings& _settings,
+		Stats *_stats
+		)
+	{
+		chkRET_X_IF_NIL(_sourceFolder, ERR_NULL_POINTER_PASSED);
+		chkRET_X_IF_NIL(_packageFile, ERR_NULL_POINTER_PASSED);
+		chkRET_X_IF_NOT(IsPowerOfTwo( _settings.alignment ), ERR_INVALID_PARAMETER);
+
+		const UINT64 startTime = mxGetTimeInMilliseconds();
+
+		String256		path;
+		FileCollector	collector;
+		mxDO(CollectFiles( _sourceFolder, _settings.recurseSubfolders, path, collector ));
+
+		// build the table of contents
+		TArray< SourceFile >	files;
+		{
+			TArray< SourceFile >& sorted = collector.files;
+			if( sorted.Num() > 1 ) {
+				CompareByHashAndName	predicate( collector );
+				NxQuickSort< SourceFile, CompareByHashAndName >( sorted.ToPtr(), sorted.ToPtr() + sorted.Num() - 1, predicate );
+			}
+			mxDO(files.Reserve( sorted.Num() ));
+			for( UINT32 i = 0; i < sorted.Num(); i++ )
+			{
+				if( i > 0 && sorted[i].hash == sorted[i-1].hash
+					&& !strcmp( collector.GetName( sorted[i] ), collector.GetName( sorted[i-1] ) ) )
+				{
+					ptWARN("Skipping '%s': a file with the same name has already been added.\n", collector.GetPath( sorted[i] ));
+					continue;
+				}
+				files.Add( sorted[i] );
+			}
+		}
+		const UINT32 numFiles = files.Num();
+
+		TArray< PakEntry >	entries;
+		mxDO(entries.SetNum( numFiles ));
+
+		TArray< char >		names;
+		for( UINT32 i = 0; i < numFiles; i++ )
+		{
+			const char* name = collector.GetName( files[i] );
+			const UINT32 length = strlen( name ) + 1;
+
+			PakEntry& entry = entries[i];
+			mxZERO_OUT(entry);
+			entry.hash = files[i].hash;
+			entry.name = names.Num();
+
+			mxDO(names.SetNum( names.Num() + length ));
+			memcpy( names.ToPtr() + entry.name, name, length );
+		}
+		if( !names.Num() ) {
+			names.Add( '\0' );	// the name table is never empty
+		}
+
+		// write the file data in the order of enumeration (files in the same folder are often loaded together)
+		TArray< UINT32 >	writeOrder;
+		mxDO(writeOrder.SetNum( numFiles ));
+		{
+			UINT32 index = 0;
+			// files[] is sorted by hash, their 'order' fields are the original enumeration indices
+			TArray< UINT32 >	tocIndexByOrder;
+			mxDO(tocIndexByOrder.SetNum( collector.files.Num() ));
+			for( UINT32 i = 0; i < tocIndexByOrder.Num(); i++ ) {
+				tocIndexByOrder[i] = ~0;
+			}
+			for( UINT32 i = 0; i < numFiles; i++ ) {
+				tocIndexByOrder[ files[i].order ] = i;
+			}
+			for( UINT32 i = 0; i < tocIndexByOrder.Num(); i++ ) {
+				if( tocIndexByOrder[i] != ~0 ) {
+					writeOrder[ index++ ] = tocIndexByOrder[i];
+				}
+			}
+			mxASSERT(index == numFiles);
+		}
+
+		PakHeader	header;
+		mxZERO_OUT(header);
+		header.fourCC = PAK_FOURCC;
+		header.version = PAK_VERSION;
+		header.numEntries = numFiles;
+		header.namesOffset = sizeof(PakHeader) + numFiles * sizeof(PakEntry);
+		header.namesSize = names.Num();
+		header.alignment = _settings.alignment;
+
+		FileWriter	writer;
+		mxDO(writer.Open( _packageFile ));
+
+		// the header and the table of contents are written again at the end
+		mxDO(writer.Write( &header, sizeof(header) ));
+		mxDO(writer.Write( entries.ToPtr(), entries.Num() * sizeof(PakEntry) ));
+		mxDO(writer.Write( names.ToPtr(), names.Num() ));
+
+		UINT64 currentOffset = header.namesOffset + header.namesSize;
+
+		Stats	stats;
+		stats.numFiles = numFiles;
+
+		TArray< BYTE >		fileData;
+		TArray< BYTE >		compressedData;
+
+		for( UINT32 i = 0; i < numFiles; i++ )
+		{
+			const SourceFile& file = files[ writeOrder[i] ];
+			PakEntry& entry = entries[ writeOrder[i] ];
+
+			mxDO(LoadFile( collector.GetPath( file ), fileData ));
+
+			const UINT32 fileSize = fileData.Num();
+			const void* dataToWrite = fileData.ToPtr();
+			UINT32 sizeToWrite = fileSize;
+
+			entry.size = fileSize;
+			entry.flags = 0;
+
+			const bool isClumpImage = _settings.pageAlignImages && IsClumpImage( fileData );
+
+			if( _settings.compress && fileSize >= _settings.minSizeToCompress && !isClumpImage )
+			{
+				compressedData.Empty();
+				mxDO(Compression::CompressBlockStream( fileData.ToPtr(), fileSize, compressedData ));
+				const UINT64 maxPackedSize = (UINT64)fileSize * (100 - _settings.minSavingsPercent) / 100;
+				if( compressedData.Num() <= maxPackedSize )
+				{
+					dataToWrite = compressedData.ToPtr();
+					sizeToWrite = compressedData.Num();
+					entry.flags |= PakEntry_Compressed;
+					stats.numCompressed++;
+				}
+			}
+
+			UINT64 alignedOffset = (currentOffset + (_settings.alignment - 1)) & ~(UINT64)(_settings.alignment - 1);
+			if( isClumpImage && _settings.alignment <= sizeof(Serialization::ImageHeader) )
+			{
+				// start the payload on a page boundary, so that patching the clump copies only its own pages
+				const UINT64 payloadOffset = (currentOffset + sizeof(Serialization::ImageHeader) + (OS_PAGE_SIZE - 1)) & ~(UINT64)(OS_PAGE_SIZE - 1);
+				alignedOffset = payloadOffset - sizeof(Serialization::ImageHeader);
+			}
+			mxDO(WritePadding( writer, (UINT32)( alignedOffset - currentOffset ) ));
+			if( sizeToWrite ) {
+				mxDO(writer.Write( dataToWrite, sizeToWrite ));
+			}
+
+			entry.offset = (UINT32) alignedOffset;
+			entry.packedSize = sizeToWrite;
+
+			currentOffset = alignedOffset + sizeToWrite;
+			if( currentOffset > MAX_UINT32 ) {
+				ptERROR("The package is too big (the limit is 4 GiB).\n");
+				return ERR_BUFFER_TOO_SMALL;
+			}
+
+			stats.uncompressedSize += fileSize;
+		}
+
+		header.totalSize = (UINT32) currentOffset;
+
+		writer.Seek( 0 );
+		mxDO(writer.Write( &header, sizeof(header) ));
+		mxDO(writer.Write( entries.ToPtr(), entries.Num() * sizeof(PakEntry) ));
+		writer.Close();
+
+		stats.packageSize = currentOffset;
+		stats.buildTime = (UINT32)( mxGetTimeInMilliseconds() - startTime );
+
+		DBGOUT("Built package '%s' from '%s'.\n", _packageFile, path.c_str());
+		stats.Print();
+
+		if( _stats ) {
+			*_stats = stats;
+		}
+		return ALL_OK;
+	}
+
+	namespace
+	{
+		// reads every file into memory, returns the number of bytes read
+		static ERet ReadAllFiles( AFilePackage* _package, const FileCollector& _files, TArray< BYTE > &_buffer, UINT64 &_bytesRead )
+		{
+			_bytesRead = 0;
+			for( UINT32 i = 0; i < _files.files.Num(); i++ )
+			{
+				AFilePackage::Stream	stream;
+				if( mxFAILED(_package->OpenFile( MakeAssetID( _files.GetName( _files.files[i] ) ), &stream )) ) {
+					continue;	// e.g. duplicate names
+				}
+				ERet result = _buffer.SetNum( stream.dataSize );
+				if( mxSUCCEDED(result) && stream.dataSize ) {
+					result = _package->ReadFile( &stream, _buffer.ToPtr(), stream.dataSize );
+				}
+				_package->CloseFile( &stream );
+				mxDO(result);
+				_bytesRead += stream.dataSize;
+			}
+			return ALL_OK;
+		}
+
+		static float MegabytesPerSecond( UINT64 _bytes, UINT64 _microseconds )
+		{
+			return _microseconds ? (float)_bytes / (float)_microseconds : 0.0f;
+		}
+	}//namespace
+
+	ERet BenchmarkPackage( const char* _sourceFolder, const char* _packageFile )
+	{
+		String256		path;
+		FileCollector	collector;
+		mxDO(CollectFiles( _sourceFolder, true, path, collector ));
+
+		TArray< BYTE >	buffer;
+
+		// the first pass only brings the files into the OS file cache,
+		// so that both readers are measured under the same conditions
+		for( int pass = 0; pass < 2; pass++ )
+		{
+			UINT64 folderBytes = 0;
+			UINT64 folderTime = 0;
+			{
+				DevAssetFolder	folder;
+				mxDO(folder.Initialize());
+				mxDO(folder.Mount( path.c_str() ));
+
+				const UINT64 startTime = mxGetTimeInMicroseconds();
+				const ERet result = ReadAllFiles( &folder, collector, buffer, folderBytes );
+				folderTime = mxGetTimeInMicroseconds() - startTime;
+
+				folder.Unmount();
+				folder.Shutdown();
+				mxDO(result);
+			}
+
+			UINT64 packageBytes = 0;
+			UINT64 packageTime = 0;
+			{
+				AssetPackage	package;
+
+				const UINT64 startTime = mxGetTimeInMicroseconds();
+				mxDO(package.Open( _packageFile ));
+				const ERet result = ReadAllFiles( &package, collector, buffer, packageBytes );
+				packageTime = mxGetTimeInMicroseconds() - startTime;
+
+				package.Close();
+				mxDO(result);
+			}
+
+			if( !pass ) {
+				continue;
+			}
+
+			ptPRINT("DevAssetFolder: %u files, %u KiB in %u ms (%.1f MB/s); AssetPackage: %u KiB in %u ms (%.1f MB/s)\n",
+				collector.files.Num(),
+				(UINT32)(folderBytes / mxKIBIBYTE), (UINT32)(folderTime / 1000), MegabytesPerSecond( folderBytes, folderTime ),
+				(UINT32)(packageBytes / mxKIBIBYTE), (UINT32)(packageTime / 1000), MegabytesPerSecond( packageBytes, packageTime ));
+		}
+
+		return ALL_OK;
+	}
+
+}//namespace AssetPackager
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,56 @@
+/*
+=============================================================================
+	File:	AssetPackager.h
+	Desc:	Offline tool for building asset packages (PAK files, see Core/AssetPackage.h).
+=============================================================================
+*/
+#pragma once
+
+#include <Core/AssetPackage.h>
+
+namespace AssetPackager
+{
+	struct Settings
+	{
+		UINT32	alignment;			// of file data (power of two), e.g. 16 for SIMD data or 4096 for page-aligned files
+		UINT32	minSizeToCompress;	// smaller files are always stored uncompressed
+		UINT32	minSavingsPercent;	// compressed files are stored only if they became at least this much smaller
+		bool	compress;
+		bool	recurseSubfolders;
+		bool	pageAlignImages;	// store clump images uncompressed with page-aligned payloads for loading in place
+	public:
+		Settings();
+	};
+
+	struct Stats
+	{
+		UINT32	numFiles;
+		UINT32	numCompressed;
+		UINT64	uncompressedSize;	// total size of all files
+		UINT64	packageSize;		// size of the archive
+		UINT32	buildTime;			// in milliseconds
+	public:
+		Stats();
+		void Print() const;
+	};
+
+	// packs all files in the folder into a single archive;
+	// files are identified by their names without path (as in DevAssetFolder),
+	// so the names must be unique across subfolders
+	ERet BuildPackage(
+		const char* _sourceFolder,
+		const char* _packageFile,
+		const Settings& _settings = Settings(),
+		Stats *_stats = nil
+	);
+
+	// reads every file of the package through DevAssetFolder and AssetPackage and prints the timings;
+	// all files are read once before measuring, so this compares the overhead of opening, reading
+	// and decompressing files from the OS file cache, not the speed of the disk
+	ERet BenchmarkPackage( const char* _sourceFolder, const char* _packageFile );
+
+}//namespace AssetPackager
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
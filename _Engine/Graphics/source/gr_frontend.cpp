@@ -488,6 +488,11 @@ DBGOUT("sizeof(DrawCall) = %u\n", sizeof(DrawCall));
 
 		++tr.frameCount;
 
+		// retire the oldest frame in flight
+		gCore.frameHeap.BeginFrame();
+
+		F_AdvanceAllocationTrackerFrame();
+
 		return ALL_OK;
 	}
 
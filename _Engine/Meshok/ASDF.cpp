@@ -4,6 +4,11 @@
 #include <Meshok/Meshok.h>
 #include <Meshok/ASDF.h>
 #include <Meshok/Octree.h>
+#include <Meshok/BVH.h>
+#include <Meshok/Morton.h>
+#include <Meshok/Parallel.h>
+#include <Meshok/SphereTracing.h>
+#include <Base/Util/Sorting.h>
 
 namespace ASDF
 {
@@ -15,98 +20,543 @@ Options::Options()
 	max_depth = ~0;
 	min_subdiv = 0;
 	error_threshold = 0;
+	multithreaded = true;
 }
 
-static NodeID CreateLeaf(
-						 Octree & tree,
-						 const OctCubeF& _bounds,
-						 const UINT32 _treeLevel,
-						 const AVolume* _volume,
-						 PerfStats &stats
-						 )
+PerfStats::PerfStats()
 {
-	const NodeID leafIndex = tree.m_leaves.Alloc();
-	Leaf& leaf = tree.m_leaves[ leafIndex ];
+	mxZERO_OUT( *this );
+}
+void PerfStats::Print() const
+{
+	DBGOUT( "\n=== ASDF statistics ========\n" );
+	DBGOUT( "Nodes: %u, leaves: %u (%u bytes)\n", numNodes, numLeaves, (UINT32)( numNodes * sizeof(Node) + numLeaves * sizeof(Leaf) ) );
+	DBGOUT( "Evaluations: %u, subtrees: %u\n", numEvaluations, numSubtrees );
+	if( buildTime ) {
+		DBGOUT( "Build time: %u usec (%.1f evaluations/sec)\n", buildTime, numEvaluations * 1e6 / buildTime );
+	}
+	if( queryTime ) {
+		DBGOUT( "Queries: %u in %u usec (%.1f queries/sec)\n", numQueries, queryTime, numQueries * 1e6 / queryTime );
+	}
+	if( batchQueryTime ) {
+		DBGOUT( "Batched queries: %u in %u usec (%.1f queries/sec)\n", numQueries, batchQueryTime, numQueries * 1e6 / batchQueryTime );
+	}
+	DBGOUT( "==== End ====================\n" );
+}
 
-	Float3 corners[8];
-	OCT_GetCorners( _bounds, corners );
+/*
+-----------------------------------------------------------------------------
+	Octree construction.
 
-	for( int i = 0; i < 8; i++ )
+	Each node is evaluated on a 3x3x3 lattice spanning its cube:
+	the 8 corners are inherited from the parent, the remaining 19 points
+	(edge, face and cell midpoints) are evaluated in a single batch.
+	The lattice decides whether the node must be subdivided and
+	provides the corner values of all eight children.
+-----------------------------------------------------------------------------
+*/
+
+// lattice point index: z*9 + y*3 + x, x,y,z in [0..2]
+static inline int LatticeIndex( int x, int y, int z ) {
+	return z * 9 + y * 3 + x;
+}
+// the lattice index of the corner of the given child octant
+static inline int ChildCornerToLattice( int _child, int _corner )
+{
+	const int x = ((_child & CHILD_MASK_X) ? 1 : 0) + ((_corner & CHILD_MASK_X) ? 1 : 0);
+	const int y = ((_child & CHILD_MASK_Y) ? 1 : 0) + ((_corner & CHILD_MASK_Y) ? 1 : 0);
+	const int z = ((_child & CHILD_MASK_Z) ? 1 : 0) + ((_corner & CHILD_MASK_Z) ? 1 : 0);
+	return LatticeIndex( x, y, z );
+}
+
+// the lattice index of the node's corner
+static inline int CornerToLattice( int _corner )
+{
+	return ChildCornerToLattice( _corner, _corner );
+}
+
+static inline bool IsLatticeCorner( int x, int y, int z ) {
+	return (x != 1) && (y != 1) && (z != 1);
+}
+
+// evaluates the 19 non-corner lattice points and copies the corner values
+static void EvaluateLattice(
+							const OctCubeF& _bounds,
+							const float _corners[8],
+							const AVolume* _volume,
+							float _lattice[27]
+							)
+{
+	Float3	points[19];
+	int		indices[19];
+	int		numPoints = 0;
+
+	for( int z = 0; z < 3; z++ ) {
+		for( int y = 0; y < 3; y++ ) {
+			for( int x = 0; x < 3; x++ ) {
+				if( IsLatticeCorner( x, y, z ) ) {
+					continue;
+				}
+				points[ numPoints ] = Float3_Set(
+					_bounds.x + (x - 1) * _bounds.radius,
+					_bounds.y + (y - 1) * _bounds.radius,
+					_bounds.z + (z - 1) * _bounds.radius
+				);
+				indices[ numPoints ] = LatticeIndex( x, y, z );
+				numPoints++;
+			}
+		}
+	}
+	mxASSERT( numPoints == mxCOUNT_OF(points) );
+
+	float	distances[19];
+	_volume->GetDistancesAt( points, distances, numPoints );
+
+	for( int i = 0; i < numPoints; i++ ) {
+		_lattice[ indices[i] ] = distances[i];
+	}
+	for( int i = 0; i < 8; i++ ) {
+		_lattice[ CornerToLattice( i ) ] = _corners[i];
+	}
+}
+
+// returns the max. difference between the trilinear approximation and the sampled values
+static float CalculateInterpolationError( const float _lattice[27] )
+{
+	const float* c[2][2][2];	// [z][y][x]
+	for( int i = 0; i < 8; i++ ) {
+		c[(i>>2)&1][(i>>1)&1][i&1] = &_lattice[ CornerToLattice( i ) ];
+	}
+
+	float maxError = 0.0f;
+	for( int z = 0; z < 3; z++ ) {
+		for( int y = 0; y < 3; y++ ) {
+			for( int x = 0; x < 3; x++ ) {
+				if( IsLatticeCorner( x, y, z ) ) {
+					continue;
+				}
+				const float u = x * 0.5f, v = y * 0.5f, w = z * 0.5f;
+				const float approx =
+					(1-w) * ( (1-v) * ((1-u) * *c[0][0][0] + u * *c[0][0][1]) + v * ((1-u) * *c[0][1][0] + u * *c[0][1][1]) ) +
+					w     * ( (1-v) * ((1-u) * *c[1][0][0] + u * *c[1][0][1]) + v * ((1-u) * *c[1][1][0] + u * *c[1][1][1]) );
+				maxError = Max( maxError, Float_Abs( approx - _lattice[ LatticeIndex( x, y, z ) ] ) );
+			}
+		}
+	}
+	return maxError;
+}
+
+// nodes and leaves of a subtree in depth-first order
+struct Subtree
+{
+	TArray< Node >	nodes;
+	TArray< Leaf >	leaves;
+	NodeID			root;
+	UINT32			numEvaluations;
+	bool			failed;	// out of memory
+public:
+	Subtree()
 	{
-		leaf.d[i] = _volume->GetDistanceAt(corners[i]);
+		root = NIL_NODE;
+		numEvaluations = 0;
+		failed = false;
+	}
+};
+
+static inline bool IsLeafByDepth( const OctCubeF& _bounds, const UINT32 _treeLevel, const Options& options )
+{
+	return (_treeLevel >= (UINT32)options.max_depth)
+		|| (_bounds.radius <= options.min_subdiv);
+}
+
+// decides whether the node must be subdivided; evaluates the lattice if needed
+static bool NeedsSubdivision(
+							 const OctCubeF& _bounds,
+							 const UINT32 _treeLevel,
+							 const float _corners[8],
+							 const AVolume* _volume,
+							 const Options& options,
+							 float _lattice[27],
+							 UINT32 &_numEvaluations
+							 )
+{
+	if( IsLeafByDepth( _bounds, _treeLevel, options ) ) {
+		return false;
+	}
+	EvaluateLattice( _bounds, _corners, _volume, _lattice );
+	_numEvaluations += 19;
+
+	if( options.error_threshold > 0.0f && CalculateInterpolationError( _lattice ) <= options.error_threshold ) {
+		return false;
+	}
+	return true;
+}
+
+static NodeID CreateLeaf( Subtree & tree, const float _corners[8] )
+{
+	Leaf* leaf = tree.leaves.AddManyUninitialized( 1 );
+	if( !leaf ) {
+		tree.failed = true;
+		return NIL_NODE;
+	}
+	for( int i = 0; i < 8; i++ ) {
+		leaf->d[i] = _corners[i];
 	}
+	return MAKE_LEAF_ID( tree.leaves.Num() - 1 );
+}
 
-	return MAKE_LEAF_ID(leafIndex);
+// allocates a new internal node (its children must be created after it to preserve depth-first order)
+static NodeID CreateNode( Subtree & tree )
+{
+	Node* node = tree.nodes.AddManyUninitialized( 1 );
+	if( !node ) {
+		tree.failed = true;
+		return NIL_NODE;
+	}
+	for( int i = 0; i < 8; i++ ) {
+		node->kids[i] = NIL_NODE;
+	}
+	return tree.nodes.Num() - 1;
 }
 
 static NodeID BuildTreeRecursive(
-								 Octree & tree,
+								 Subtree & tree,
 								 const OctCubeF& _bounds,
 								 const UINT32 _treeLevel,
+								 const float _corners[8],
 								 const AVolume* _volume,
-								 const Options& options,
-								 PerfStats &stats
-								 )
-{
-	const bool isLeaf = (_treeLevel >= options.max_depth)
-				|| (_bounds.radius <= options.min_subdiv);
+								 const Options& options
+								 );
 
-	if( isLeaf )
+static NodeID BuildChildren(
+							Subtree & tree,
+							const OctCubeF& _bounds,
+							const UINT32 _treeLevel,
+							const float _lattice[27],
+							const AVolume* _volume,
+							const Options& options
+							)
+{
+	const NodeID nodeID = CreateNode( tree );
+	if( nodeID == NIL_NODE ) {
+		return NIL_NODE;
+	}
+	for( int i = 0; i < 8; i++ )
 	{
-		return CreateLeaf( tree, _bounds, _treeLevel, _volume, stats );
+		float childCorners[8];
+		for( int j = 0; j < 8; j++ ) {
+			childCorners[j] = _lattice[ ChildCornerToLattice( i, j ) ];
+		}
+		const NodeID childID = BuildTreeRecursive( tree, GetChildOctant( _bounds, i ), _treeLevel + 1, childCorners, _volume, options );
+		tree.nodes[ nodeID ].kids[i] = childID;
 	}
-	else
+	return nodeID;
+}
+
+static NodeID BuildTreeRecursive(
+								 Subtree & tree,
+								 const OctCubeF& _bounds,
+								 const UINT32 _treeLevel,
+								 const float _corners[8],
+								 const AVolume* _volume,
+								 const Options& options
+								 )
+{
+	float lattice[27];
+	if( !NeedsSubdivision( _bounds, _treeLevel, _corners, _volume, options, lattice, tree.numEvaluations ) )
 	{
-		OctCubeF octants[8];
-		GetChildOctants(_bounds,octants);
-		const UINT32 nextLevel = _treeLevel + 1;
+		return CreateLeaf( tree, _corners );
+	}
+	return BuildChildren( tree, _bounds, _treeLevel, lattice, _volume, options );
+}
 
-		NodeID nodeID = tree.m_nodes.Alloc();
-		for( int i = 0; i < 8; i++ )
-		{
-			NodeID childID = BuildTreeRecursive( tree, octants[i], nextLevel, _volume, options, stats );
-			Node& node = tree.m_nodes[ nodeID ];
-			node.kids[i] = childID;
+// a node in the upper levels of the tree, which are built breadth-first on the main thread
+struct TopNode
+{
+	INT32	kids[8];	// >= 0: index of a top node, < 0: -(task index + 1)
+};
+
+// a subtree which is built by a worker thread
+struct BuildTask
+{
+	OctCubeF	bounds;
+	UINT32		level;
+	float		corners[8];
+	INT32		parent;		// index of the parent top node or -1 if this is the root
+	INT32		childIndex;	// in the parent node
+	bool		isLeaf;		// already known to be a leaf
+};
+
+struct BuildContext
+{
+	const AVolume *		volume;
+	const Options *		options;
+	TArray< BuildTask >	tasks;
+	TArray< Subtree >	subtrees;	// one per task
+};
+
+static void BuildSubtree( UINT _taskIndex, UINT _threadIndex, void* _userData )
+{
+	BuildContext & context = *static_cast< BuildContext* >( _userData );
+	const BuildTask& task = context.tasks[ _taskIndex ];
+	Subtree & result = context.subtrees[ _taskIndex ];
+
+	if( task.isLeaf ) {
+		result.root = CreateLeaf( result, task.corners );
+	} else {
+		result.root = BuildTreeRecursive( result, task.bounds, task.level, task.corners, context.volume, *context.options );
+	}
+}
+
+// appends the nodes and leaves of the subtree, returns the relocated root
+static NodeID AppendSubtree( Octree & _tree, const Subtree& _subtree )
+{
+	const UINT32 nodeOffset = _tree.m_nodes.Num();
+	const UINT32 leafOffset = _tree.m_leaves.Num();
+
+	if( mxFAILED(_tree.m_leaves.Add( _subtree.leaves.ToPtr(), _subtree.leaves.Num() )) ) {
+		return NIL_NODE;
+	}
+	Node* nodes = _tree.m_nodes.AddManyUninitialized( _subtree.nodes.Num() );
+	if( _subtree.nodes.Num() && !nodes ) {
+		return NIL_NODE;
+	}
+
+	struct Util {
+		static NodeID Relocate( NodeID id, UINT32 nodeOffset, UINT32 leafOffset ) {
+			if( id == NIL_NODE ) {
+				return NIL_NODE;
+			}
+			return IS_LEAF_ID( id ) ? MAKE_LEAF_ID( GET_ID( id ) + leafOffset ) : id + nodeOffset;
 		}
+	};
 
-		//// collapse empty nodes
-		//if( IsBadNode( m_nodes[ nodeID ] ) )
-		//{
-		//	stats.numBadNodes++;
-		//	m_nodes.Free( nodeID );
-		//	nodeID = NIL_NODE;
-		//}
-		//else
-		//{
-		//	stats.numInternalNodes++;
-		//}		
+	for( UINT32 iNode = 0; iNode < _subtree.nodes.Num(); iNode++ )
+	{
+		for( int i = 0; i < 8; i++ ) {
+			nodes[ iNode ].kids[i] = Util::Relocate( _subtree.nodes[ iNode ].kids[i], nodeOffset, leafOffset );
+		}
+	}
+	return Util::Relocate( _subtree.root, nodeOffset, leafOffset );
+}
 
-		return nodeID;
+// merges top nodes and subtrees into flat arrays in depth-first order
+static NodeID FlattenTopNodes_R( Octree & _tree, const TArray< TopNode >& _topNodes, INT32 _topIndex, const BuildContext& _context )
+{
+	const NodeID nodeID = _tree.m_nodes.Num();
+	if( !_tree.m_nodes.AddManyUninitialized( 1 ) ) {
+		return NIL_NODE;
 	}
+	for( int i = 0; i < 8; i++ )
+	{
+		const INT32 kid = _topNodes[ _topIndex ].kids[i];
+		const NodeID childID = ( kid >= 0 )
+			? FlattenTopNodes_R( _tree, _topNodes, kid, _context )
+			: AppendSubtree( _tree, _context.subtrees[ -kid - 1 ] );
+		_tree.m_nodes[ nodeID ].kids[i] = childID;
+	}
+	return nodeID;
 }
+
+#if MX_DEBUG
+// checks that leaves are sorted by the Morton codes of their min corners
+static void ValidateMortonOrder_R( const Octree& _tree, NodeID _nodeID, UINT32 _x, UINT32 _y, UINT32 _z, UINT32 _size, UINT64 &_lastCode )
+{
+	if( _nodeID == NIL_NODE ) {
+		return;
+	}
+	if( IS_LEAF_ID( _nodeID ) )
+	{
+		const UINT64 code = mortonEncode_magicbits( _x, _y, _z );
+		mxASSERT( _lastCode == ~0ULL || code > _lastCode );
+		_lastCode = code;
+		return;
+	}
+	const UINT32 half = _size / 2;
+	const Node& node = _tree.m_nodes[ _nodeID ];
+	for( int i = 0; i < 8; i++ )
+	{
+		mxASSERT( IS_LEAF_ID( node.kids[i] ) || node.kids[i] > _nodeID );	// children are stored after parents
+		ValidateMortonOrder_R( _tree, node.kids[i],
+			_x + ((i & CHILD_MASK_X) ? half : 0),
+			_y + ((i & CHILD_MASK_Y) ? half : 0),
+			_z + ((i & CHILD_MASK_Z) ? half : 0),
+			half, _lastCode );
+	}
+}
+#endif
+
 Octree::Octree()
 {
+	m_root = NIL_NODE;
 }
 Octree::~Octree()
 {
-	m_nodes.Empty();
-	m_leaves.Empty();
+	this->Clear();
+}
+void Octree::Clear()
+{
+	m_nodes.Clear();
+	m_leaves.Clear();
+	m_root = NIL_NODE;
 }
-ERet Octree::Build( AVolume* _volume, const Options& _options )
+ERet Octree::Build( AVolume* _volume, const Options& _options, PerfStats *_stats )
 {
+	const UINT64 startTime = mxGetTimeInMicroseconds();
+
+	this->Clear();
+
+	Options	options = _options;
+	if( options.max_depth < 0 || options.max_depth > MAX_OCTREE_DEPTH ) {
+		options.max_depth = MAX_OCTREE_DEPTH;
+	}
+
 	OctCubeF worldBounds;
 	worldBounds.x = 0;
 	worldBounds.y = 0;
 	worldBounds.z = 0;
-	worldBounds.radius = _options.radius;
+	worldBounds.radius = options.radius;
+
+	BuildContext	context;
+	context.volume = _volume;
+	context.options = &options;
+
+	UINT32 numEvaluations = 0;
+
+	// the root task
+	{
+		Float3 corners[8];
+		OCT_GetCorners( worldBounds, corners );
+
+		BuildTask & root = context.tasks.Add();
+		root.bounds = worldBounds;
+		root.level = 0;
+		_volume->GetDistancesAt( corners, root.corners, 8 );
+		root.parent = -1;
+		root.childIndex = 0;
+		root.isLeaf = false;
+		numEvaluations += 8;
+	}
+
+	// build the top levels breadth-first until there's enough work for all threads
+	TArray< TopNode >	topNodes;
+	const UINT32 numThreads = options.multithreaded ? Meshok::ParallelFor_GetMaxThreads() : 1;
+	const UINT32 minTasks = (numThreads > 1) ? numThreads * 8 : 1;
+
+	while( context.tasks.Num() < minTasks )
+	{
+		TArray< BuildTask >	nextLevel;
+		bool expanded = false;
+
+		for( UINT32 iTask = 0; iTask < context.tasks.Num(); iTask++ )
+		{
+			BuildTask & task = context.tasks[ iTask ];
+			float lattice[27];
+			if( task.isLeaf || !NeedsSubdivision( task.bounds, task.level, task.corners, _volume, options, lattice, numEvaluations ) )
+			{
+				task.isLeaf = true;
+				mxDO(nextLevel.Add( &task, 1 ));
+				continue;
+			}
 
-	PerfStats	stats;
+			// turn the task into a top node and create tasks for its children
+			const INT32 topIndex = topNodes.Num();
+			TopNode & topNode = topNodes.Add();
+			for( int i = 0; i < 8; i++ ) {
+				topNode.kids[i] = 0;
+			}
+			if( task.parent >= 0 ) {
+				topNodes[ task.parent ].kids[ task.childIndex ] = topIndex;
+			}
+
+			for( int i = 0; i < 8; i++ )
+			{
+				BuildTask & child = nextLevel.Add();
+				child.bounds = GetChildOctant( task.bounds, i );
+				child.level = task.level + 1;
+				for( int j = 0; j < 8; j++ ) {
+					child.corners[j] = lattice[ ChildCornerToLattice( i, j ) ];
+				}
+				child.parent = topIndex;
+				child.childIndex = i;
+				child.isLeaf = false;
+			}
+			expanded = true;
+		}
+
+		context.tasks = nextLevel;
+
+		if( !expanded ) {
+			break;
+		}
+	}
+
+	// link top nodes to the tasks
+	for( UINT32 iTask = 0; iTask < context.tasks.Num(); iTask++ )
+	{
+		const BuildTask& task = context.tasks[ iTask ];
+		if( task.parent >= 0 ) {
+			topNodes[ task.parent ].kids[ task.childIndex ] = -(INT32)iTask - 1;
+		}
+	}
+
+	// build the subtrees in parallel
+	mxDO(context.subtrees.SetNum( context.tasks.Num() ));
+	Meshok::ParallelFor( context.tasks.Num(), &BuildSubtree, &context, numThreads );
+
+	for( UINT32 iTask = 0; iTask < context.tasks.Num(); iTask++ )
+	{
+		const Subtree& subtree = context.subtrees[ iTask ];
+		if( subtree.failed ) {
+			this->Clear();
+			return ERR_OUT_OF_MEMORY;
+		}
+		numEvaluations += subtree.numEvaluations;
+	}
+
+	// merge everything into contiguous arrays in Morton order
+	if( topNodes.Num() ) {
+		m_root = FlattenTopNodes_R( *this, topNodes, 0, context );
+	} else {
+		m_root = AppendSubtree( *this, context.subtrees[0] );
+	}
+
+	mxDEBUG_CODE(
+		UINT64 lastCode = ~0ULL;
+		ValidateMortonOrder_R( *this, m_root, 0, 0, 0, 1U << MAX_OCTREE_DEPTH, lastCode );
+	);
+
+	if( _stats )
+	{
+		_stats->numNodes = m_nodes.Num();
+		_stats->numLeaves = m_leaves.Num();
+		_stats->numEvaluations = numEvaluations;
+		_stats->numSubtrees = context.tasks.Num();
+		_stats->buildTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+	}
 
-	NodeID rootNodeID = BuildTreeRecursive( *this, worldBounds, 0, _volume, _options, stats );
-	
 	return ALL_OK;
 }
 
+ERet Octree::Build( ATriangleMeshInterface* triangleMesh, const Options& _options, PerfStats *_stats )
+{
+	TriangleBVH	bvh;
+	mxDO(bvh.Build( triangleMesh ));
+
+	// the octree is centered at the origin and must enclose the whole mesh
+	AABB24	bounds;
+	bvh.GetBounds( bounds );
+	const Float3 extent = Float3_Max( Float3_Abs( bounds.min_point ), Float3_Abs( bounds.max_point ) );
+
+	Options	options = _options;
+	options.radius = largest( largest( extent.x, extent.y ), extent.z ) * 1.01f;
+
+	MeshSDF	volume;
+	volume.bvh = &bvh;
+
+	return this->Build( &volume, options, _stats );
+}
+
 Volume::Volume()
 {
 	radius = 1.0f;
@@ -243,51 +693,348 @@ float InterpolateTrilinear(
 
 }
 
-float Volume::GetDistanceAt( const Float3& _position ) const
+/*
+-----------------------------------------------------------------------------
+	Point queries.
+-----------------------------------------------------------------------------
+*/
+namespace
 {
-	OctCubeF bounds;
-	bounds.x = 0;
-	bounds.y = 0;
-	bounds.z = 0;
-	bounds.radius = radius;
+	enum { MAX_COORD = (1 << MAX_OCTREE_DEPTH) - 1 };
+
+	// maps the cube [-radius..+radius] onto the integer lattice at the max. tree depth
+	struct QueryGrid
+	{
+		float	offset;		// radius
+		float	scale;		// lattice cells per unit
+		float	cellSize;	// 1 / scale
+	public:
+		QueryGrid( float _radius )
+		{
+			offset = _radius;
+			scale = (MAX_COORD + 1) / (_radius * 2.0f);
+			cellSize = (_radius * 2.0f) / (MAX_COORD + 1);
+		}
+		// points outside the root cube are clamped to the border leaves (and extrapolated)
+		mxFORCEINLINE UINT32 Quantize( float _x ) const
+		{
+			return (UINT32) Clamp( (_x + offset) * scale, 0.0f, (float)MAX_COORD );
+		}
+		mxFORCEINLINE UINT64 MortonCode( const Float3& _position ) const
+		{
+			return mortonEncode_magicbits( Quantize( _position.x ), Quantize( _position.y ), Quantize( _position.z ) );
+		}
+	};
+
+	// the path from the root to the last visited leaf, reused by consecutive queries
+	struct QueryPath
+	{
+		NodeID	nodes[ MAX_OCTREE_DEPTH + 1 ];	// [0] = root
+		UINT32	depth;	// depth of the last visited leaf
+		UINT64	code;	// Morton code of the last query point
+	public:
+		QueryPath( NodeID _root )
+		{
+			nodes[0] = _root;
+			depth = 0;
+			code = 0;
+		}
+	};
+
+	// returns the leaf (or NIL_NODE) containing the point with the given Morton code
+	mxFORCEINLINE NodeID FindLeaf( const Octree& _tree, QueryPath & _path, const UINT64 _code )
+	{
+		// the number of top levels which are the same for both points
+		const UINT64 diff = _code ^ _path.code;
+		const UINT32 numSharedLevels = diff ? (MAX_OCTREE_DEPTH - 1) - (UINT32)IntegerLog2( diff ) / 3 : MAX_OCTREE_DEPTH;
+
+		UINT32 depth = smallest( numSharedLevels, _path.depth );
+		NodeID nodeID = _path.nodes[ depth ];
+
+		while( !IS_LEAF_ID( nodeID ) )
+		{
+			const int childIndex = (int)( _code >> ((MAX_OCTREE_DEPTH - 1 - depth) * 3) ) & 7;
+			nodeID = _tree.m_nodes[ nodeID ].kids[ childIndex ];
+			_path.nodes[ ++depth ] = nodeID;
+		}
+
+		_path.depth = depth;
+		_path.code = _code;
+		return nodeID;
+	}
+
+	// interpolates the leaf corner values and computes the gradient of the interpolant
+	mxFORCEINLINE void InterpolateLeaf(
+		const Leaf& _leaf,
+		const Float3& _position,
+		const UINT32 _depth,
+		const QueryGrid& _grid,
+		AVolume::Sample &_sample
+		)
+	{
+		// the min corner and the size of the leaf
+		const UINT32 shift = MAX_OCTREE_DEPTH - _depth;
+		const float leafSize = (float)(1U << shift) * _grid.cellSize;
+		const float invLeafSize = 1.0f / leafSize;
+
+		const float u = ( _position.x + _grid.offset - (float)( (_grid.Quantize( _position.x ) >> shift) << shift ) * _grid.cellSize ) * invLeafSize;
+		const float v = ( _position.y + _grid.offset - (float)( (_grid.Quantize( _position.y ) >> shift) << shift ) * _grid.cellSize ) * invLeafSize;
+		const float w = ( _position.z + _grid.offset - (float)( (_grid.Quantize( _position.z ) >> shift) << shift ) * _grid.cellSize ) * invLeafSize;
+		const float u1 = 1.0f - u;
+		const float v1 = 1.0f - v;
+
+		// corners in the same order as in OCT_GetCorners(): X changes fastest
+		const __m128 lo = _mm_loadu_ps( _leaf.d + 0 );	// z = 0: d000 d100 d010 d110
+		const __m128 hi = _mm_loadu_ps( _leaf.d + 4 );	// z = 1: d001 d101 d011 d111
+		const __m128 dz = _mm_sub_ps( hi, lo );
+		const __m128 c = _mm_add_ps( lo, _mm_mul_ps( dz, _mm_set1_ps( w ) ) );	// lerp along Z
+
+		const __m128 weightsXY = _mm_setr_ps( u1 * v1, u * v1, u1 * v, u * v );
+
+		__m128 r0 = _mm_mul_ps( c, weightsXY );							// -> f
+		__m128 r1 = _mm_mul_ps( c, _mm_setr_ps( -v1, v1, -v, v ) );		// -> df/du
+		__m128 r2 = _mm_mul_ps( c, _mm_setr_ps( -u1, -u, u1, u ) );		// -> df/dv
+		__m128 r3 = _mm_mul_ps( dz, weightsXY );						// -> df/dw
+		_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+		const __m128 sums = _mm_add_ps( _mm_add_ps( r0, r1 ), _mm_add_ps( r2, r3 ) );
+
+		float result[4];
+		_mm_storeu_ps( result, sums );
+
+		_sample.distance = result[0];
+		_sample.normal = Float3_Set( result[1] * invLeafSize, result[2] * invLeafSize, result[3] * invLeafSize );
+	}
+
+	mxFORCEINLINE void SampleOutside( AVolume::Sample &_sample )
+	{
+		_sample.distance = 1.0f;
+		_sample.normal = Float3_Zero();
+	}
+
+	struct PointKey
+	{
+		UINT64	code;	// Morton code of the point
+		UINT32	index;	// index of the point in the input array
+	};
+	struct PointKeyLess
+	{
+		inline bool operator () ( const PointKey& a, const PointKey& b ) const
+		{
+			return a.code < b.code;
+		}
+	};
 
-	NodeID nodeID = 0;
+	// points are sorted in batches of this size (temporary buffers live on the stack)
+	enum { QUERY_BATCH_SIZE = 1024 };
 
-	while( !IS_LEAF_ID( nodeID ) )
+	// calls _output( index, sample ) for each point in Morton order
+	template< class OUTPUT >
+	void SamplePoints( const Volume& _volume, const Float3* _positions, UINT _count, OUTPUT & _output )
 	{
-		// get the index of the child octant containing the point
-		int childIndex =
-			((_position.x >= bounds.x) ? CHILD_MASK_X : 0)|
-			((_position.y >= bounds.y) ? CHILD_MASK_Y : 0)|
-			((_position.z >= bounds.z) ? CHILD_MASK_Z : 0);
+		const Octree& tree = *_volume.tree;
+		const QueryGrid grid( _volume.radius );
+		QueryPath path( tree.m_root );
+
+		PointKey	keys[ QUERY_BATCH_SIZE ];
+		PointKeyLess	less;
+
+		for( UINT start = 0; start < _count; start += QUERY_BATCH_SIZE )
+		{
+			const UINT batchSize = smallest( _count - start, (UINT)QUERY_BATCH_SIZE );
+			for( UINT i = 0; i < batchSize; i++ )
+			{
+				keys[i].code = grid.MortonCode( _positions[ start + i ] );
+				keys[i].index = start + i;
+			}
+			if( batchSize > 1 ) {
+				NxQuickSort< PointKey, PointKeyLess >( keys, keys + batchSize - 1, less );
+			}
 
-		bounds = GetChildOctant( bounds, childIndex );
+			for( UINT i = 0; i < batchSize; i++ )
+			{
+				const UINT32 pointIndex = keys[i].index;
+				const NodeID leafID = FindLeaf( tree, path, keys[i].code );
 
-		const Node& node = tree->m_nodes[ nodeID ];
-		nodeID = node.kids[ childIndex ];
+				AVolume::Sample	sample;
+				if( leafID != NIL_NODE ) {
+					InterpolateLeaf( tree.m_leaves[ GET_ID( leafID ) ], _positions[ pointIndex ], path.depth, grid, sample );
+				} else {
+					SampleOutside( sample );
+				}
+				_output( pointIndex, sample );
+			}
+		}
 	}
-	if( nodeID != NIL_NODE )
+
+	struct StoreDistances
+	{
+		float *	distances;
+		inline void operator () ( UINT32 _index, const AVolume::Sample& _sample ) {
+			distances[ _index ] = _sample.distance;
+		}
+	};
+	struct StoreSamples
 	{
-		mxASSERT(IS_LEAF_ID(nodeID));
-		const Leaf& leaf = tree->m_leaves[ GET_ID(nodeID) ];
+		AVolume::Sample *	samples;
+		inline void operator () ( UINT32 _index, const AVolume::Sample& _sample ) {
+			samples[ _index ].distance = _sample.distance;
+			samples[ _index ].normal = Float3_Normalized( _sample.normal );
+		}
+	};
 
-		AABB24 aabb;
-		OctBoundsToAABB( bounds, aabb );
+	// a single query doesn't need sorting
+	inline AVolume::Sample SamplePoint( const Volume& _volume, const Float3& _position )
+	{
+		const Octree& tree = *_volume.tree;
+		const QueryGrid grid( _volume.radius );
+		QueryPath path( tree.m_root );
 
-		float dminx = Float_Abs( _position.x - aabb.min_point.x );
-		float dminy = Float_Abs( _position.y - aabb.min_point.y );
-		float dminz = Float_Abs( _position.z - aabb.min_point.z );
-		float dmaxx = Float_Abs( _position.x - aabb.max_point.x );
-		float dmaxy = Float_Abs( _position.z - aabb.max_point.z );
-		float dmaxz = Float_Abs( _position.y - aabb.max_point.y );
+		AVolume::Sample	sample;
+		const NodeID leafID = FindLeaf( tree, path, grid.MortonCode( _position ) );
+		if( leafID != NIL_NODE ) {
+			InterpolateLeaf( tree.m_leaves[ GET_ID( leafID ) ], _position, path.depth, grid, sample );
+		} else {
+			SampleOutside( sample );
+		}
+		return sample;
+	}
+}//namespace
 
-		mxASSERT(AABB_ContainsPoint( aabb, _position, 1e-3f ));
+float Volume::GetDistanceAt( const Float3& _position ) const
+{
+	return SamplePoint( *this, _position ).distance;
+}
+void Volume::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	StoreDistances	output;
+	output.distances = _distances;
+	SamplePoints( *this, _positions, _count, output );
+}
+Float3 Volume::GetNormalAt( const Float3& _position ) const
+{
+	return Float3_Normalized( SamplePoint( *this, _position ).normal );
+}
+AVolume::Sample Volume::SampleAt( const Float3& _position ) const
+{
+	Sample	result = SamplePoint( *this, _position );
+	result.normal = Float3_Normalized( result.normal );
+	return result;
+}
+void Volume::GetSamplesAt( const Float3* _positions, Sample *_samples, UINT _count ) const
+{
+	StoreSamples	output;
+	output.samples = _samples;
+	SamplePoints( *this, _positions, _count, output );
+}
+bool Volume::IntersectsLine( const Float3& start, const Float3& end, Float3 &point, Float3 &normal ) const
+{
+	SphereTracing::Options	options;
+	options.bounds = this;
+	return SphereTracing::IntersectsLine( this, start, end, point, normal, options );
+}
+void Volume::GetEmptySpaceSkips( const Float3* _positions, const Float3* _directions, float _margin, float *_skips, UINT _count ) const
+{
+	const Octree& tree = *this->tree;
+	const QueryGrid grid( radius );
+	QueryPath path( tree.m_root );
+
+	for( UINT i = 0; i < _count; i++ )
+	{
+		const Float3& position = _positions[i];
+		const Float3& direction = _directions[i];
+
+		_skips[i] = 0.0f;
+
+		// the leaves only bound the space inside the root cube
+		if( Float_Abs( position.x ) >= radius || Float_Abs( position.y ) >= radius || Float_Abs( position.z ) >= radius ) {
+			continue;
+		}
+
+		// consecutive rays of a packet usually share most of the path
+		const NodeID leafID = FindLeaf( tree, path, grid.MortonCode( position ) );
+		if( leafID == NIL_NODE ) {
+			continue;
+		}
+
+		const Leaf& leaf = tree.m_leaves[ GET_ID( leafID ) ];
+		float minDistance = leaf.d[0];
+		for( int k = 1; k < 8; k++ ) {
+			minDistance = smallest( minDistance, leaf.d[k] );
+		}
+		// the trilinear interpolant is bounded by the corner values
+		if( minDistance <= _margin ) {
+			continue;
+		}
+
+		const UINT32 shift = MAX_OCTREE_DEPTH - path.depth;
+		const float leafSize = (float)(1U << shift) * grid.cellSize;
+
+		float exitDistance = BIG_NUMBER;
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			const float p = (&position.x)[ axis ];
+			const float d = (&direction.x)[ axis ];
+			if( Float_Abs( d ) < 1e-6f ) {
+				continue;
+			}
+			const float leafMin = (float)( (grid.Quantize( p ) >> shift) << shift ) * grid.cellSize - grid.offset;
+			const float plane = (d > 0.0f) ? leafMin + leafSize : leafMin;
+			exitDistance = smallest( exitDistance, (plane - p) / d );
+		}
 
-		float result = InterpolateTrilinear(_position, aabb.min_point, aabb.max_point, leaf.d);
-		return result;
+		// step slightly over the boundary to land in the next leaf
+		_skips[i] = Max( exitDistance, 0.0f ) + grid.cellSize;
 	}
+}
+
+void MeasureQueryThroughput( const Volume& _volume, UINT32 _numQueries, PerfStats & _stats )
+{
+	enum { BATCH_SIZE = 1024 };
+	Float3	points[ BATCH_SIZE ];
+	float	distances[ BATCH_SIZE ];
+
+	UINT32	seed = 12345;	// fixed seed for reproducible results
+	float	checksum = 0.0f;	// prevents the compiler from removing the queries
+	float	batchChecksum = 0.0f;
+	UINT64	elapsedTime = 0;
+	UINT64	batchElapsedTime = 0;
+
+	UINT32 numQueries = 0;
+	while( numQueries < _numQueries )
+	{
+		const UINT32 batchSize = smallest( _numQueries - numQueries, (UINT32)BATCH_SIZE );
+		for( UINT32 i = 0; i < batchSize; i++ )
+		{
+			float xyz[3];
+			for( int k = 0; k < 3; k++ ) {
+				seed = seed * 1664525 + 1013904223;
+				xyz[k] = ( (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f ) * _volume.radius * 0.999f;
+			}
+			points[i] = Float3_Set( xyz[0], xyz[1], xyz[2] );
+		}
+
+		const UINT64 startTime = mxGetTimeInMicroseconds();
+		for( UINT32 i = 0; i < batchSize; i++ ) {
+			checksum += _volume.GetDistanceAt( points[i] );
+		}
+		elapsedTime += mxGetTimeInMicroseconds() - startTime;
+
+		const UINT64 batchStartTime = mxGetTimeInMicroseconds();
+		_volume.GetDistancesAt( points, distances, batchSize );
+		batchElapsedTime += mxGetTimeInMicroseconds() - batchStartTime;
+		for( UINT32 i = 0; i < batchSize; i++ ) {
+			batchChecksum += distances[i];
+		}
+
+		numQueries += batchSize;
+	}
+
+	_stats.numQueries = numQueries;
+	_stats.queryTime = (UINT32) elapsedTime;
+	_stats.batchQueryTime = (UINT32) batchElapsedTime;
 
-	return 1.0f;
+	DBGOUT( "ASDF: %u queries in %u usec, batched: %u usec (checksums: %f, %f)\n",
+		numQueries, _stats.queryTime, _stats.batchQueryTime, checksum, batchChecksum );
 }
 
 }//namespace ASDF
@@ -1,24 +1,41 @@
 // Adaptively Sampled Distance Field.
 #pragma once
 
-#include <Base/Memory/FreeList/TPool.h>
 #include <Meshok/SDF.h>
 
 namespace ASDF
 {
+	// the max. supported depth of the tree (limited by 64-bit Morton codes)
+	enum { MAX_OCTREE_DEPTH = 20 };
+
 	struct Options
 	{
 		//AABB24	bounds;
 		float	radius;
-		int		max_depth;
+		int		max_depth;	// negative = MAX_OCTREE_DEPTH
 		float	min_subdiv;
+		// a node is not subdivided if trilinear interpolation of its corner values
+		// approximates the distance field at the node's edge, face and cell midpoints with this precision
+		// (0 = always subdivide down to 'max_depth' or 'min_subdiv')
 		float	error_threshold;
+		// build subtrees on worker threads
+		bool	multithreaded;
 	public:
 		Options();
 	};
 	struct PerfStats
 	{
-
+		UINT32	numNodes;		// internal nodes
+		UINT32	numLeaves;
+		UINT32	numEvaluations;	// distance function evaluations
+		UINT32	numSubtrees;	// subtrees built by worker threads
+		UINT32	buildTime;		// in microseconds
+		UINT32	numQueries;		// see MeasureQueryThroughput()
+		UINT32	queryTime;		// in microseconds, one GetDistanceAt() per point
+		UINT32	batchQueryTime;	// in microseconds, the same points passed to GetDistancesAt()
+	public:
+		PerfStats();
+		void Print() const;
 	};
 
 	//NOTE: upper bit = is_leaf flag
@@ -45,20 +62,31 @@ namespace ASDF
 		NodeID	kids[8];
 	};
 
+	// Nodes and leaves are stored in flat arrays in depth-first order with children visited in octant order,
+	// i.e. sorted by their Morton (Z-order) codes, so that descending the tree walks forward in memory.
 	struct Octree : public CStruct
 	{
-		TPool< Node >	m_nodes;
-		TPool< Leaf >	m_leaves;
+		TArray< Node >	m_nodes;	// internal nodes
+		TArray< Leaf >	m_leaves;
+		NodeID			m_root;		// the first node or leaf; NIL_NODE if the tree is empty
 	public:
 		mxDECLARE_CLASS(Octree, CStruct);
 		mxDECLARE_REFLECTION;
 		Octree();
 		~Octree();
-		ERet Build( ATriangleMeshInterface* triangleMesh );
-		ERet Build( AVolume* _volume, const Options& _options );
+		// converts the triangle mesh into a distance field (the mesh must be closed);
+		// the octree's radius is computed from the mesh bounds ('_options.radius' is ignored)
+		ERet Build( ATriangleMeshInterface* triangleMesh, const Options& _options, PerfStats *_stats = nil );
+		// the top levels are built breadth-first, then subtrees are built on worker threads
+		ERet Build( AVolume* _volume, const Options& _options, PerfStats *_stats = nil );
+		void Clear();
 		PREVENT_COPY(Octree);
 	};
 
+	// Distances are interpolated trilinearly from the corners of the leaf containing the point,
+	// gradients are the analytic derivatives of the same interpolant (no extra tree descents).
+	// Batched queries sort the points along the Morton curve and restart each descent
+	// from the deepest node shared with the previous point.
 	struct Volume : AVolume
 	{
 		TPtr< Octree >	tree;
@@ -66,8 +94,27 @@ namespace ASDF
 	public:
 		Volume();
 		virtual float GetDistanceAt( const Float3& _position ) const override;
+		virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
+		virtual Float3 GetNormalAt( const Float3& _position ) const override;
+		virtual Sample SampleAt( const Float3& _position ) const override;
+		virtual void GetSamplesAt( const Float3* _positions, Sample *_samples, UINT _count ) const override;
+		// sphere traces the octree (see SphereTracing.h)
+		virtual bool IntersectsLine(
+			const Float3& start, const Float3& end,
+			Float3 &point, Float3 &normal
+			) const override;
+
+		// For each ray, returns the distance to the point where the ray leaves the leaf containing the ray's position,
+		// if the leaf cannot contain the surface (i.e. all its corner distances are greater than _margin), otherwise 0.
+		void GetEmptySpaceSkips(
+			const Float3* _positions, const Float3* _directions, float _margin,
+			float *_skips, UINT _count
+			) const;
 	};
 
+	// measures the time of random point queries inside the volume's bounds
+	void MeasureQueryThroughput( const Volume& _volume, UINT32 _numQueries, PerfStats & _stats );
+
 }//namespace ASDF
 
 //--------------------------------------------------------------//
@@ -10,6 +10,7 @@
 #pragma hdrstop
 #include <Meshok/Meshok.h>
 #include <Meshok/BSP.h>
+#include <Meshok/Parallel.h>
 
 using namespace BSP;
 
@@ -30,7 +31,23 @@ void BspStats::Reset()
 {
 	mxZERO_OUT( *this );
 }
-void BspStats::Print( UINT32 elapsedTimeMSec )
+void BspStats::AddLeaf( UINT32 depth )
+{
+	m_depthHistogram[ smallest( depth, MAX_DEPTH_BINS-1 ) ]++;
+	m_maxDepth = largest( m_maxDepth, depth );
+}
+void BspStats::Add( const BspStats& other )
+{
+	m_numSplits += other.m_numSplits;
+	m_numSolidLeaves += other.m_numSolidLeaves;
+	m_numEmptyLeaves += other.m_numEmptyLeaves;
+	for( UINT32 i = 0; i < MAX_DEPTH_BINS; i++ ) {
+		m_depthHistogram[i] += other.m_depthHistogram[i];
+	}
+	m_maxDepth = largest( m_maxDepth, other.m_maxDepth );
+	m_numSubtrees += other.m_numSubtrees;
+}
+void BspStats::Print() const
 {
 	DBGOUT( "=== BSP statistics ========"			);
 	DBGOUT( "Num. Polys(Begin): %u", m_polysBefore	 );
@@ -40,9 +57,15 @@ void BspStats::Print( UINT32 elapsedTimeMSec )
 	DBGOUT( "Num. Inner Nodes:  %u", m_numInternalNodes );
 	DBGOUT( "Num. Solid Leaves: %u", m_numSolidLeaves	 );
 	DBGOUT( "Num. Empty Leaves: %u", m_numEmptyLeaves	 );
-	//DBGOUT( "Tree Depth:        %u", depth			 );
+	DBGOUT( "Tree Depth:        %u", m_maxDepth			 );
+	for( UINT32 i = 0; i < MAX_DEPTH_BINS; i++ ) {
+		if( m_depthHistogram[i] ) {
+			DBGOUT( "  leaves at depth %u: %u", i, m_depthHistogram[i] );
+		}
+	}
+	DBGOUT( "Num. Subtrees:     %u", m_numSubtrees );
 	DBGOUT( "Memory used:		%u KiB", m_bytesAllocated / 1024 );
-	DBGOUT( "Time elapsed:      %u msec", elapsedTimeMSec		);
+	DBGOUT( "Time elapsed:      %u msec", m_buildTimeMSec		);
 	DBGOUT( "==== End ===================="			 );
 }
 
@@ -79,6 +102,7 @@ mxBEGIN_REFLECTION(BspTree)
 mxEND_REFLECTION;
 BspTree::BspTree()
 {
+	m_numUnusedPolys = 0;
 }
 
 enum {
@@ -590,7 +614,7 @@ BspPolyID FindBestSplitterIndex( const BspTree& tree, const BspPolyID polygons,
 #define	NORMAL_EPSILON		0.00001f
 #define	DIST_EPSILON		0.01f
 
-static UINT32 GetPlaneIndex(
+static BspPlaneID GetPlaneIndex(
 				   BspTree & tree, const Vector4& plane,
 				   const float normalEps = NORMAL_EPSILON,
 				   const float distEps = DIST_EPSILON
@@ -613,8 +637,8 @@ static UINT32 GetPlaneIndex(
 		}
 	}
 
-	const UINT32 newPlaneIndex = numExistingPlanes;
-	mxASSERT( newPlaneIndex <= BSP_MAX_PLANES );
+	const BspPlaneID newPlaneIndex = numExistingPlanes;
+	mxASSERT( newPlaneIndex < BSP_MAX_PLANES );
 
 	tree.m_planes.Add( normalizedPlane );
 
@@ -638,6 +662,7 @@ static BspPolyID AddPolygon( const BspPoly& poly, BspTree & tree, BspPolyID * he
 	const UINT32 newPolyIndex = tree.m_polys.Num();
 	mxASSERT( newPolyIndex <= BSP_MAX_POLYS );
 	BspPoly &newPoly = tree.m_polys.Add();
+	newPoly.vertices.Clear();	// the slot can be left from a removed polygon
 	newPoly.vertices.SetExternalStorage( newPoly.buffer, mxCOUNT_OF(newPoly.buffer) );
 	newPoly.vertices = poly.vertices;
 	newPoly.next = *head;
@@ -657,30 +682,22 @@ static int CalculatePolygonCount( const BspTree& tree, BspPolyID iPoly )
 	return result;
 }
 
+// partitions the polygons with the plane of the splitter polygon;
 // returns index of the splitting plane
 //
-static UINT32 PartitionPolygons(
+static BspPlaneID PartitionPolygons(
 					   BspTree & tree,
 					   const int nodeIndex,
 					   BspStats &stats,
 					   const BspPolyID polygons,
+					   const BspPolyID bestSplitter,
 					   BspPolyID *frontPolys,
 					   BspPolyID *backPolys,
-					   const FLOAT epsilon = 0.13f
+					   const FLOAT epsilon
 					   )
 {
-	// select the best partitioner
-	SplittingCriteria	settings;
-	// we don't need polygons for collision detection
-	settings.splitCost = 0;
-	settings.balanceVsCuts = 1;
-	settings.planeEpsilon = 0.1f;
-
-	const BspPolyID bestSplitter = FindBestSplitterIndex( tree, polygons, settings );
 	const Vector4 splittingPlane = PlaneFromPolygon( tree.m_polys[ bestSplitter ] );
 
-	BspNode& splittingNode = tree.m_nodes[ nodeIndex ];
-
 	int front = 0, back = 0, split = 0, coplanar = 0;
 
 	// partition the list
@@ -728,6 +745,7 @@ static UINT32 PartitionPolygons(
 			else
 			{
 				mxASSERT( side == PLANESIDE_ON );
+				BspNode& splittingNode = tree.m_nodes[ nodeIndex ];
 				polygon.next = splittingNode.polys;
 				splittingNode.polys = iPoly;
 				coplanar++;
@@ -737,55 +755,558 @@ static UINT32 PartitionPolygons(
 		iPoly = iNextPoly;
 	}
 
+	// the splitter lies on the node's plane too (the polygons are triangulated by GenerateMesh())
+	{
+		BspNode& splittingNode = tree.m_nodes[ nodeIndex ];
+		tree.m_polys[ bestSplitter ].next = splittingNode.polys;
+		splittingNode.polys = bestSplitter;
+		coplanar++;
+	}
+
 	//LogStream(LL_Debug) << "front: " << front << ", back: " << back << ", split: " << split << ", on: " << coplanar;
 
 	return GetPlaneIndex( tree, splittingPlane );
 }
 
-// returns index of new node
-//
-static BspNodeID BuildTree_R( BspTree & tree, const UINT16 polygons, BspStats &stats )
+/*
+-----------------------------------------------------------------------------
+	Binned splitter selection.
+
+	Polygon planes are binned by orientation and distance and only one plane
+	from each bin is considered. Each candidate is scored with a surface area
+	heuristic: the number of polygons on each side is weighted by the area
+	of their bounding box, split polygons are counted on both sides.
+-----------------------------------------------------------------------------
+*/
+namespace
 {
-	mxASSERT( polygons != BSP_NONE );
+	enum { MAX_BUILD_THREADS = 16 };
 
-	// allocate a new internal node
-	const BspNodeID iNewNode = NewNode( tree );
+	// normal components are quantized to 3 values -> 27 orientations
+	enum { NUM_DIRECTION_BINS = 27 };
+	enum { NUM_DISTANCE_BINS = 16 };
 
-	// partition the list
-	BspPolyID	frontPolys = BSP_NONE;
-	BspPolyID	backPolys = BSP_NONE;
-	const UINT32 splitPlane = PartitionPolygons( tree, iNewNode, stats, polygons, &frontPolys, &backPolys );
+	// the polygons of a node converted for fast (SIMD) plane tests
+	struct PolygonSoup
+	{
+		TArray< BspPolyID >	ids;
+		TArray< Vector4 >	planes;
+		TArray< UINT32 >	firstVertex;	// [numPolys + 1]
+		TArray< Float3 >	polyMins;		// polygon bounds
+		TArray< Float3 >	polyMaxs;
+		TArray< float >		xs, ys, zs;		// vertex positions, padded to a multiple of 4
+		Float3				boundsMin;
+		Float3				boundsMax;
+	public:
+		ERet Build( const BspTree& tree, const BspPolyID polygons )
+		{
+			ids.Empty();
+			planes.Empty();
+			firstVertex.Empty();
+			polyMins.Empty();
+			polyMaxs.Empty();
+			xs.Empty();
+			ys.Empty();
+			zs.Empty();
+			boundsMin = Float3_Replicate( +BIG_NUMBER );
+			boundsMax = Float3_Replicate( -BIG_NUMBER );
+
+			for( BspPolyID iPoly = polygons; iPoly != BSP_NONE; iPoly = tree.m_polys[ iPoly ].next )
+			{
+				const BspPoly& polygon = tree.m_polys[ iPoly ];
+				ids.Add( iPoly );
+				planes.Add( PlaneFromPolygon( polygon ) );
+				firstVertex.Add( xs.Num() );
+
+				Float3 polyMin = Float3_Replicate( +BIG_NUMBER );
+				Float3 polyMax = Float3_Replicate( -BIG_NUMBER );
+				for( UINT32 iVertex = 0; iVertex < polygon.vertices.Num(); iVertex++ )
+				{
+					const Float3& xyz = polygon.vertices[ iVertex ].xyz;
+					xs.Add( xyz.x );
+					ys.Add( xyz.y );
+					zs.Add( xyz.z );
+					polyMin = Float3_Min( polyMin, xyz );
+					polyMax = Float3_Max( polyMax, xyz );
+				}
+				polyMins.Add( polyMin );
+				polyMaxs.Add( polyMax );
+				boundsMin = Float3_Min( boundsMin, polyMin );
+				boundsMax = Float3_Max( boundsMax, polyMax );
+			}
+			firstVertex.Add( xs.Num() );
 
-	tree.m_nodes[ iNewNode ].plane = splitPlane;
+			// pad to a multiple of 4 for SIMD
+			while( xs.Num() % 4 ) {
+				xs.Add( 0.0f );
+				ys.Add( 0.0f );
+				zs.Add( 0.0f );
+			}
+			return ALL_OK;
+		}
+		UINT32 NumPolys() const { return ids.Num(); }
+	};
 
-	// recursively process children
-	if( frontPolys != BSP_NONE )
+	static inline float BoundsArea( const Float3& _min, const Float3& _max )
 	{
-		tree.m_nodes[ iNewNode ].front = BuildTree_R( tree, frontPolys, stats );
+		if( _min.x > _max.x ) {
+			return 0.0f;	// empty
+		}
+		const Float3 size = _max - _min;
+		return 2.0f * ( size.x * size.y + size.y * size.z + size.z * size.x );
 	}
-	else
+
+	// computes the cost of splitting the polygons with the plane (the less the better);
+	// _distances - scratch memory for signed vertex distances
+	static ERet EvaluateSplitter(
+		const PolygonSoup& _soup,
+		const Vector4& _plane,
+		const BspTree::Settings& _settings,
+		TArray< float > & _distances,
+		float &_cost
+		)
 	{
-		tree.m_nodes[ iNewNode ].front = BSP_EMPTY_LEAF;
-		stats.m_numEmptyLeaves++;
+		const UINT32 numVertices = _soup.xs.Num();
+		mxDO(_distances.SetNum( numVertices ));
+		float * distances = _distances.ToPtr();
+
+		// classify all vertices, four at a time
+		{
+			const __m128 nx = _mm_set1_ps( _plane.x );
+			const __m128 ny = _mm_set1_ps( _plane.y );
+			const __m128 nz = _mm_set1_ps( _plane.z );
+			const __m128 nw = _mm_set1_ps( _plane.w );
+			const float* xs = _soup.xs.ToPtr();
+			const float* ys = _soup.ys.ToPtr();
+			const float* zs = _soup.zs.ToPtr();
+			for( UINT32 i = 0; i < numVertices; i += 4 )
+			{
+				const __m128 d = _mm_add_ps(
+					_mm_add_ps( _mm_mul_ps( _mm_loadu_ps( xs + i ), nx ), _mm_mul_ps( _mm_loadu_ps( ys + i ), ny ) ),
+					_mm_add_ps( _mm_mul_ps( _mm_loadu_ps( zs + i ), nz ), nw )
+				);
+				_mm_storeu_ps( distances + i, d );
+			}
+		}
+
+		const float epsilon = _settings.planeEpsilon;
+
+		UINT32	numFront = 0, numBack = 0, numSplit = 0;
+		Float3	frontMin = Float3_Replicate( +BIG_NUMBER ), frontMax = Float3_Replicate( -BIG_NUMBER );
+		Float3	backMin = Float3_Replicate( +BIG_NUMBER ), backMax = Float3_Replicate( -BIG_NUMBER );
+
+		const UINT32 numPolys = _soup.NumPolys();
+		for( UINT32 iPoly = 0; iPoly < numPolys; iPoly++ )
+		{
+			float minDist = +BIG_NUMBER;
+			float maxDist = -BIG_NUMBER;
+			for( UINT32 i = _soup.firstVertex[ iPoly ]; i < _soup.firstVertex[ iPoly + 1 ]; i++ ) {
+				minDist = smallest( minDist, distances[i] );
+				maxDist = largest( maxDist, distances[i] );
+			}
+
+			const bool inFront = (minDist >= -epsilon);
+			const bool inBack = (maxDist <= +epsilon);
+			if( inFront && inBack ) {
+				continue;	// coplanar
+			}
+			if( !inBack ) {
+				numFront++;
+				frontMin = Float3_Min( frontMin, _soup.polyMins[ iPoly ] );
+				frontMax = Float3_Max( frontMax, _soup.polyMaxs[ iPoly ] );
+			}
+			if( !inFront ) {
+				numBack++;
+				backMin = Float3_Min( backMin, _soup.polyMins[ iPoly ] );
+				backMax = Float3_Max( backMax, _soup.polyMaxs[ iPoly ] );
+			}
+			numSplit += ( !inFront && !inBack );
+		}
+
+		// the cost is the expected number of polygons visited by a query reaching the node:
+		// the polygons on each side are weighted by the probability of hitting their bounds (area ratio);
+		// split polygons are counted on both sides and, in addition, each of them costs 'splitCost' visits
+		// (i.e. it's weighted by the probability 1, as if every query reaching the node visited it)
+		const float parentArea = largest( BoundsArea( _soup.boundsMin, _soup.boundsMax ), 1e-6f );
+		const float frontVisits = BoundsArea( frontMin, frontMax ) / parentArea * numFront;
+		const float backVisits = BoundsArea( backMin, backMax ) / parentArea * numBack;
+		float cost = frontVisits + backVisits + numSplit * _settings.splitCost;
+
+		if( CalculatePlaneType( _plane ) < PLANETYPE_TRUEAXIAL ) {
+			cost *= 0.8f;	// axial is better
+		}
+		_cost = cost;
+		return ALL_OK;
 	}
 
-	if( backPolys != BSP_NONE )
+	static inline int QuantizeNormalComponent( float _value )
 	{
-		tree.m_nodes[ iNewNode ].back = BuildTree_R( tree, backPolys, stats );
+		return (_value < -0.5f) ? 0 : (_value > 0.5f) ? 2 : 1;
 	}
-	else
+
+	// selects indices of representative polygon planes
+	static void SelectCandidatePlanes( const PolygonSoup& _soup, const UINT32 _maxCandidates, TArray< UINT32 > &_candidates )
+	{
+		_candidates.Empty();
+
+		const UINT32 numPolys = _soup.NumPolys();
+		if( numPolys <= _maxCandidates )
+		{
+			for( UINT32 iPoly = 0; iPoly < numPolys; iPoly++ ) {
+				_candidates.Add( iPoly );
+			}
+			return;
+		}
+
+		INT32	bins[ NUM_DIRECTION_BINS * NUM_DISTANCE_BINS ];
+		for( int i = 0; i < mxCOUNT_OF(bins); i++ ) {
+			bins[i] = -1;
+		}
+
+		const Float3 center = (_soup.boundsMin + _soup.boundsMax) * 0.5f;
+		const float radius = largest( Float3_Length( _soup.boundsMax - _soup.boundsMin ) * 0.5f, 1e-4f );
+
+		for( UINT32 iPoly = 0; iPoly < numPolys; iPoly++ )
+		{
+			const Vector4& plane = _soup.planes[ iPoly ];
+			const int directionBin = QuantizeNormalComponent( plane.x )
+				+ QuantizeNormalComponent( plane.y ) * 3
+				+ QuantizeNormalComponent( plane.z ) * 9;
+			const float distance = Plane_PointDistance( plane, center );
+			const int distanceBin = Clamp( (int)( ( distance / radius * 0.5f + 0.5f ) * NUM_DISTANCE_BINS ), 0, NUM_DISTANCE_BINS - 1 );
+			INT32 & bin = bins[ directionBin * NUM_DISTANCE_BINS + distanceBin ];
+			if( bin < 0 ) {
+				bin = iPoly;
+			}
+		}
+
+		TArray< UINT32 >	occupied;
+		for( int i = 0; i < mxCOUNT_OF(bins); i++ ) {
+			if( bins[i] >= 0 ) {
+				occupied.Add( bins[i] );
+			}
+		}
+
+		// take evenly spaced bins if there are too many
+		const UINT32 numCandidates = smallest( occupied.Num(), _maxCandidates );
+		for( UINT32 i = 0; i < numCandidates; i++ ) {
+			_candidates.Add( occupied[ i * occupied.Num() / numCandidates ] );
+		}
+	}
+
+	struct ParallelEvaluationData
+	{
+		const PolygonSoup *			soup;
+		const TArray< UINT32 > *	candidates;
+		const BspTree::Settings *	settings;
+		float *						costs;
+		TArray< float >				distances[ MAX_BUILD_THREADS ];
+		ERet						result;	// set if any task has failed
+	};
+
+	void EvaluateCandidateTask( UINT _index, UINT _threadIndex, void* _userData )
+	{
+		ParallelEvaluationData & data = *static_cast< ParallelEvaluationData* >( _userData );
+		mxASSERT( _threadIndex < MAX_BUILD_THREADS );
+		const UINT32 iPoly = (*data.candidates)[ _index ];
+		const ERet result = EvaluateSplitter( *data.soup, data.soup->planes[ iPoly ], *data.settings, data.distances[ _threadIndex ], data.costs[ _index ] );
+		if( mxFAILED(result) ) {
+			data.result = result;
+		}
+	}
+
+	// a subtree which will be built on a worker thread
+	struct SubtreeTask
+	{
+		BspPolyID	polygons;	// linked list in the main tree
+		BspNodeID	parent;		// node in the main tree
+		UINT16		isFront;	// 1 if this is the front child of the parent
+		UINT32		depth;
+	};
+
+	struct BuildContext
+	{
+		const BspTree::Settings &	settings;
+		BspStats &					stats;
+		// only set on the main thread while the top levels are built
+		TArray< SubtreeTask > *		tasks;
+		// scratch memory
+		PolygonSoup					soup;
+		TArray< UINT32 >			candidates;
+		TArray< float >				costs;
+		TArray< float >				distances;
+	public:
+		BuildContext( const BspTree::Settings& _settings, BspStats & _stats )
+			: settings( _settings ), stats( _stats )
+		{
+			tasks = nil;
+		}
+	};
+
+	static ERet FindBestSplitterBinned( BuildContext & context, const BspTree& tree, const BspPolyID polygons, BspPolyID *bestSplitter )
+	{
+		PolygonSoup & soup = context.soup;
+		mxDO(soup.Build( tree, polygons ));
+		SelectCandidatePlanes( soup, context.settings.maxCandidates, context.candidates );
+
+		const UINT32 numCandidates = context.candidates.Num();
+		mxDO(context.costs.SetNum( numCandidates ));
+
+		// evaluate candidates of large nodes in parallel (only while the top levels are built)
+		if( context.tasks && soup.NumPolys() >= context.settings.minPolysPerTask && numCandidates > 1 )
+		{
+			ParallelEvaluationData	data;
+			data.soup = &soup;
+			data.candidates = &context.candidates;
+			data.settings = &context.settings;
+			data.costs = context.costs.ToPtr();
+			data.result = ALL_OK;
+			Meshok::ParallelFor( numCandidates, &EvaluateCandidateTask, &data, MAX_BUILD_THREADS );
+			mxDO(data.result);
+		}
+		else
+		{
+			for( UINT32 i = 0; i < numCandidates; i++ ) {
+				const UINT32 iPoly = context.candidates[i];
+				mxDO(EvaluateSplitter( soup, soup.planes[ iPoly ], context.settings, context.distances, context.costs[i] ));
+			}
+		}
+
+		UINT32 bestCandidate = 0;
+		for( UINT32 i = 1; i < numCandidates; i++ ) {
+			if( context.costs[i] < context.costs[ bestCandidate ] ) {
+				bestCandidate = i;
+			}
+		}
+		*bestSplitter = soup.ids[ context.candidates[ bestCandidate ] ];
+		return ALL_OK;
+	}
+
+	static ERet FindBestSplitter( BuildContext & context, const BspTree& tree, const BspPolyID polygons, BspPolyID *bestSplitter )
+	{
+		if( context.settings.builder == BspTree::Settings::Builder_Binned ) {
+			return FindBestSplitterBinned( context, tree, polygons, bestSplitter );
+		}
+		SplittingCriteria	criteria;
+		// we don't need polygons for collision detection
+		criteria.splitCost = 0;
+		criteria.balanceVsCuts = 1;
+		criteria.planeEpsilon = context.settings.planeEpsilon;
+		*bestSplitter = FindBestSplitterIndex( tree, polygons, criteria );
+		return ALL_OK;
+	}
+
+	static ERet BuildTree_R( BuildContext & context, BspTree & tree, const BspPolyID polygons, const UINT32 depth, BspNodeID *newNode );
+
+	// builds a child subtree or defers it to a worker thread (then the child is set after the subtree has been built)
+	static ERet BuildChild( BuildContext & context, BspTree & tree, const BspPolyID polygons, const BspNodeID parent, const bool isFront, const UINT32 depth, BspNodeID *child )
+	{
+		if( context.tasks && CalculatePolygonCount( tree, polygons ) < (int)context.settings.minPolysPerTask )
+		{
+			SubtreeTask & task = context.tasks->Add();
+			task.polygons = polygons;
+			task.parent = parent;
+			task.isFront = isFront;
+			task.depth = depth;
+			*child = BSP_NONE;
+			return ALL_OK;
+		}
+		return BuildTree_R( context, tree, polygons, depth, child );
+	}
+
+	// creates a new node and returns its index
+	//
+	static ERet BuildTree_R( BuildContext & context, BspTree & tree, const BspPolyID polygons, const UINT32 depth, BspNodeID *newNode )
+	{
+		mxASSERT( polygons != BSP_NONE );
+
+		// allocate a new internal node
+		const BspNodeID iNewNode = NewNode( tree );
+		tree.m_nodes[ iNewNode ].polys = BSP_NONE;
+		*newNode = iNewNode;
+
+		BspPolyID bestSplitter;
+		mxDO(FindBestSplitter( context, tree, polygons, &bestSplitter ));
+
+		// partition the list
+		BspPolyID	frontPolys = BSP_NONE;
+		BspPolyID	backPolys = BSP_NONE;
+		const BspPlaneID splitPlane = PartitionPolygons( tree, iNewNode, context.stats, polygons, bestSplitter, &frontPolys, &backPolys, context.settings.planeEpsilon );
+
+		tree.m_nodes[ iNewNode ].plane = splitPlane;
+
+		// recursively process children
+		if( frontPolys != BSP_NONE )
+		{
+			BspNodeID front;
+			mxDO(BuildChild( context, tree, frontPolys, iNewNode, true, depth + 1, &front ));
+			tree.m_nodes[ iNewNode ].front = front;
+		}
+		else
+		{
+			tree.m_nodes[ iNewNode ].front = BSP_EMPTY_LEAF;
+			context.stats.m_numEmptyLeaves++;
+			context.stats.AddLeaf( depth + 1 );
+		}
+
+		if( backPolys != BSP_NONE )
+		{
+			BspNodeID back;
+			mxDO(BuildChild( context, tree, backPolys, iNewNode, false, depth + 1, &back ));
+			tree.m_nodes[ iNewNode ].back = back;
+		}
+		else
+		{
+			tree.m_nodes[ iNewNode ].back = BSP_SOLID_LEAF;
+			context.stats.m_numSolidLeaves++;
+			context.stats.AddLeaf( depth + 1 );
+		}
+
+		return ALL_OK;
+	}
+
+	struct ParallelBuildData
+	{
+		const BspTree *				tree;
+		const BspTree::Settings *	settings;
+		const SubtreeTask *			tasks;
+		BspTree *					subtrees;
+		BspStats *					stats;
+		ERet *						results;
+	};
+
+	void BuildSubtreeTask( UINT _index, UINT _threadIndex, void* _userData )
+	{
+		ParallelBuildData & data = *static_cast< ParallelBuildData* >( _userData );
+		const SubtreeTask& task = data.tasks[ _index ];
+		BspTree & subtree = data.subtrees[ _index ];
+
+		// copy the polygons from the main tree (it's not modified until all tasks have finished)
+		BspPolyID polygons = BSP_NONE;
+		for( BspPolyID iPoly = task.polygons; iPoly != BSP_NONE; iPoly = data.tree->m_polys[ iPoly ].next ) {
+			AddPolygon( data.tree->m_polys[ iPoly ], subtree, &polygons );
+		}
+
+		BuildContext	context( *data.settings, data.stats[ _index ] );
+		BspNodeID		root;
+		data.results[ _index ] = BuildTree_R( context, subtree, polygons, task.depth, &root );
+	}
+
+	static inline BspNodeID RelocateChild( BspNodeID _child, UINT32 _nodeOffset )
+	{
+		const int child = (INT32)_child;
+		return (child >= 0) ? BspNodeID( child + _nodeOffset ) : _child;
+	}
+
+	// appends the nodes of the subtree and the polygons lying on their planes, returns the new root index;
+	// returns ERR_TOO_MANY_OBJECTS if the tree would exceed BSP_MAX_NODES, BSP_MAX_PLANES or BSP_MAX_POLYS
+	static ERet AppendSubtree( BspTree & tree, const BspTree& subtree, BspNodeID *root )
+	{
+		const UINT32 nodeOffset = tree.m_nodes.Num();
+		chkRET_X_IF_NOT( nodeOffset + subtree.m_nodes.Num() <= BSP_MAX_NODES, ERR_TOO_MANY_OBJECTS );
+		chkRET_X_IF_NOT( tree.m_planes.Num() + subtree.m_planes.Num() <= BSP_MAX_PLANES, ERR_TOO_MANY_OBJECTS );
+		chkRET_X_IF_NOT( tree.m_polys.Num() + subtree.m_polys.Num() <= BSP_MAX_POLYS, ERR_TOO_MANY_OBJECTS );
+
+		for( UINT32 iNode = 0; iNode < subtree.m_nodes.Num(); iNode++ )
+		{
+			const BspNode& source = subtree.m_nodes[ iNode ];
+			const BspNodeID iNewNode = NewNode( tree );
+			BspNode & newNode = tree.m_nodes[ iNewNode ];
+			newNode.plane = GetPlaneIndex( tree, subtree.m_planes[ source.plane ] );
+			newNode.front = RelocateChild( source.front, nodeOffset );
+			newNode.back = RelocateChild( source.back, nodeOffset );
+			newNode.polys = BSP_NONE;
+			for( BspPolyID iPoly = source.polys; iPoly != BSP_NONE; iPoly = subtree.m_polys[ iPoly ].next ) {
+				AddPolygon( subtree.m_polys[ iPoly ], tree, &newNode.polys );
+			}
+		}
+		*root = nodeOffset;	// the root is the first node of the subtree
+		return ALL_OK;
+	}
+
+	// leaves only the polygons referenced by the nodes: the polygons of deferred subtrees
+	// have been copied into the subtrees and back, and split polygons are replaced by their pieces
+	static ERet RemoveUnusedPolygons( BspTree & tree )
+	{
+		BspTree	compacted;	// only its polygon array is used
+		mxDO(compacted.m_polys.Reserve( tree.m_polys.Num() ));
+
+		for( UINT32 iNode = 0; iNode < tree.m_nodes.Num(); iNode++ )
+		{
+			BspNode & node = tree.m_nodes[ iNode ];
+			BspPolyID polys = BSP_NONE;
+			for( BspPolyID iPoly = node.polys; iPoly != BSP_NONE; iPoly = tree.m_polys[ iPoly ].next ) {
+				AddPolygon( tree.m_polys[ iPoly ], compacted, &polys );
+			}
+			node.polys = polys;
+		}
+
+		tree.m_polys = compacted.m_polys;
+		return ALL_OK;
+	}
+
+	static ERet BuildSubtreesInParallel( BspTree & tree, const BspTree::Settings& settings, const TArray< SubtreeTask >& tasks, BspStats &stats )
 	{
-		tree.m_nodes[ iNewNode ].back = BSP_SOLID_LEAF;
-		stats.m_numSolidLeaves++;
+		const UINT32 numTasks = tasks.Num();
+
+		TArray< BspTree >	subtrees;
+		TArray< BspStats >	subtreeStats;
+		TArray< ERet >		results;
+		mxDO(subtrees.SetNum( numTasks ));
+		mxDO(subtreeStats.SetNum( numTasks ));
+		mxDO(results.SetNum( numTasks ));
+
+		ParallelBuildData	data;
+		data.tree = &tree;
+		data.settings = &settings;
+		data.tasks = tasks.ToPtr();
+		data.subtrees = subtrees.ToPtr();
+		data.stats = subtreeStats.ToPtr();
+		data.results = results.ToPtr();
+
+		Meshok::ParallelFor( numTasks, &BuildSubtreeTask, &data, MAX_BUILD_THREADS );
+
+		for( UINT32 iTask = 0; iTask < numTasks; iTask++ )
+		{
+			mxDO(results[ iTask ]);
+
+			const SubtreeTask& task = tasks[ iTask ];
+			BspNodeID root;
+			mxDO(AppendSubtree( tree, subtrees[ iTask ], &root ));
+			if( task.isFront ) {
+				tree.m_nodes[ task.parent ].front = root;
+			} else {
+				tree.m_nodes[ task.parent ].back = root;
+			}
+			stats.Add( subtreeStats[ iTask ] );
+		}
+		stats.m_numSubtrees += numTasks;
+
+		// the polygons of the tasks are no longer referenced
+		mxDO(RemoveUnusedPolygons( tree ));
+		return ALL_OK;
 	}
+}//namespace
 
-	return iNewNode;
+BspTree::Settings::Settings()
+{
+	builder = Builder_Binned;
+	maxCandidates = 32;
+	splitCost = 1.0f;
+	planeEpsilon = 0.1f;
+	multithreaded = true;
+	minPolysPerTask = 256;
 }
 
-ERet BspTree::Build( ATriangleMeshInterface* triangleMesh )
+ERet BspTree::Build( ATriangleMeshInterface* triangleMesh, const Settings& settings, BspStats *_stats )
 {
 	const UINT32 startTimeMSec = mxGetTimeInMilliseconds();
 
+	m_nodes.Empty();
+	m_planes.Empty();
+	m_polys.Empty();
+	m_numUnusedPolys = 0;
+
 	struct CollectTriangles : ATriangleIndexCallback
 	{
 		BspTree &	m_tree;
@@ -822,7 +1343,21 @@ ERet BspTree::Build( ATriangleMeshInterface* triangleMesh )
 	BspStats	stats;
 	stats.m_polysBefore = m_polys.Num();
 
-	BuildTree_R( *this, 0, stats );
+	// build the top levels, smaller subtrees are deferred to worker threads
+	TArray< SubtreeTask >	tasks;
+	{
+		BuildContext	context( settings, stats );
+		if( settings.multithreaded && Meshok::ParallelFor_GetMaxThreads() > 1
+			&& stats.m_polysBefore >= settings.minPolysPerTask )
+		{
+			context.tasks = &tasks;
+		}
+		BspNodeID root;
+		mxDO(BuildTree_R( context, *this, 0, 0, &root ));
+	}
+	if( tasks.Num() ) {
+		mxDO(BuildSubtreesInParallel( *this, settings, tasks, stats ));
+	}
 
 	stats.m_polysAfter = m_polys.Num();
 
@@ -833,9 +1368,13 @@ ERet BspTree::Build( ATriangleMeshInterface* triangleMesh )
 	stats.m_numInternalNodes = m_nodes.Num();
 	stats.m_numPlanes = m_planes.Num();
 	stats.m_bytesAllocated = this->BytesAllocated();
+	stats.m_buildTimeMSec = mxGetTimeInMilliseconds() - startTimeMSec;
+
+	stats.Print();
 
-	const UINT32 currentTimeMSec = mxGetTimeInMilliseconds();
-	stats.Print(currentTimeMSec - startTimeMSec);
+	if( _stats ) {
+		*_stats = stats;
+	}
 
 	return ALL_OK;
 }
@@ -851,7 +1390,7 @@ bool BspTree::PointInSolid( const Float3& point, float epsilon ) const
 		const Vector4& plane = m_planes[ node.plane ];
 		const EPlaneSide side = CalculatePlaneSide( plane, point, epsilon );
 		// Go down the appropriate side
-		nodeIndex = (side == PLANESIDE_FRONT) ? (INT16)node.front : (INT16)node.back;
+		nodeIndex = (side == PLANESIDE_FRONT) ? (INT32)node.front : (INT32)node.back;
 	}
 	return nodeIndex == BSP_SOLID_LEAF;
 }
@@ -868,12 +1407,12 @@ float BspTree::DistanceToPoint( const Float3& point, float epsilon ) const
 		const Vector4& plane = m_planes[ node.plane ];
 		distance = Plane_PointDistance( plane, point );
 		const int nearIndex = (distance >= 0.f);	// child of Node for half-space containing the origin of Ray: 1 - front, 0 - back
-		const int sides[2] = { (INT16)node.back, (INT16)node.front };
+		const int sides[2] = { (INT32)node.back, (INT32)node.front };
 		// Go down the appropriate side
 		if( distance > +epsilon ) {
-			nodeIndex = (INT16)node.front;
+			nodeIndex = (INT32)node.front;
 		} else if( distance < -epsilon ) {
-			nodeIndex = (INT16)node.back;
+			nodeIndex = (INT32)node.back;
 		} else {
 			nodeIndex = sides[ nearIndex ];
 		}
@@ -963,10 +1502,10 @@ float BspTree::CastRay( const Float3& start, const Float3& direction ) const
 		const float d2 = Plane_PointDistance( plane, end );
 		// see which sides we need to consider
 		if( d1 >= +epsilon && d2 >= +epsilon ) {
-			nodeIndex = (INT16)node.front;
+			nodeIndex = (INT32)node.front;
 		}
 		else if( d1 < -epsilon && d2 < -epsilon ) {
-			nodeIndex = (INT16)node.back;
+			nodeIndex = (INT32)node.back;
 		}
 		else {
 			// Straddling
@@ -1046,10 +1585,10 @@ bool Intersect_R( const Tree& tree, int nodeID, const Float3& start, const Float
 	const float d2 = Plane_PointDistance( plane, end );
 	// see which sides we need to consider
 	if( d1 >= +epsilon && d2 >= +epsilon ) {
-		nodeID = (INT16)node.front;
+		nodeID = (INT32)node.front;
 	}
 	else if( d1 < -epsilon && d2 < -epsilon ) {
-		nodeID = (INT16)node.back;
+		nodeID = (INT32)node.back;
 	}
 	else {
 		// Straddling
@@ -1084,10 +1623,10 @@ bool Intersect_R( const Tree& tree, int nodeID, const Float3& start, const Float
 		t = smallest( t, fraction );
 
 		const Float3 mid = start + (end - start) * fraction;
-		if(Intersect_R( tree, (INT16)node.front, start, mid, t )) {
+		if(Intersect_R( tree, (INT32)node.front, start, mid, t )) {
 			return true;
 		}
-		if(Intersect_R( tree, (INT16)node.back, mid, end, t )) {
+		if(Intersect_R( tree, (INT32)node.back, mid, end, t )) {
 			return true;
 		}
 		return false;
@@ -1142,9 +1681,1082 @@ int RayIntersect(BSPNode *node, Point p, Vector d, float tmin, float tmax, float
 }
 #endif
 
-void BspTree::Subtract( ATriangleMeshInterface* _mesh )
+/*
+-----------------------------------------------------------------------------
+	Segment intersection (shared by the editable and frozen trees).
+	Child ids are ints: >= 0 - internal node, BSP_EMPTY_LEAF or BSP_SOLID_LEAF.
+-----------------------------------------------------------------------------
+*/
+namespace BSP
+{
+	struct EditableTreeAccess
+	{
+		const BspTree &	tree;
+	public:
+		EditableTreeAccess( const BspTree& _tree ) : tree( _tree ) {}
+		mxFORCEINLINE float Distance( int nodeIndex, const Float3& point ) const {
+			return Plane_PointDistance( tree.m_planes[ tree.m_nodes[ nodeIndex ].plane ], point );
+		}
+		mxFORCEINLINE float Dot( int nodeIndex, const Float3& direction ) const {
+			return Float3_Dot( Vector4_As_Float3( tree.m_planes[ tree.m_nodes[ nodeIndex ].plane ] ), direction );
+		}
+		mxFORCEINLINE int Front( int nodeIndex ) const { return (INT32)tree.m_nodes[ nodeIndex ].front; }
+		mxFORCEINLINE int Back( int nodeIndex ) const { return (INT32)tree.m_nodes[ nodeIndex ].back; }
+	};
+
+	static inline int FrozenChildToInt( UINT32 childType, UINT32 nodeIndex )
+	{
+		return (childType == FROZEN_CHILD_NODE) ? (int)nodeIndex
+			: (childType == FROZEN_CHILD_SOLID) ? BSP_SOLID_LEAF : BSP_EMPTY_LEAF;
+	}
+
+	struct FrozenTreeAccess
+	{
+		const BspFrozenTree &	tree;
+	public:
+		FrozenTreeAccess( const BspFrozenTree& _tree ) : tree( _tree ) {}
+		mxFORCEINLINE float Distance( int nodeIndex, const Float3& point ) const {
+			const float* plane = tree.m_nodes[ nodeIndex ].plane;
+			return plane[0] * point.x + plane[1] * point.y + plane[2] * point.z + plane[3];
+		}
+		mxFORCEINLINE float Dot( int nodeIndex, const Float3& direction ) const {
+			const float* plane = tree.m_nodes[ nodeIndex ].plane;
+			return plane[0] * direction.x + plane[1] * direction.y + plane[2] * direction.z;
+		}
+		mxFORCEINLINE int Front( int nodeIndex ) const {
+			return FrozenChildToInt( tree.m_nodes[ nodeIndex ].children & 3, nodeIndex + 1 );
+		}
+		mxFORCEINLINE int Back( int nodeIndex ) const {
+			const UINT32 children = tree.m_nodes[ nodeIndex ].children;
+			return FrozenChildToInt( (children >> 2) & 3, children >> 4 );
+		}
+	};
+
+	// returns the parameter of the first point in solid space on the segment [start + dir * t0, start + dir * t1]
+	template< class TREE >
+	static bool IntersectSegment_R( const TREE& tree, int nodeIndex, const Float3& start, const Float3& dir, float t0, float t1, float &tHit )
+	{
+		if( nodeIndex < 0 )
+		{
+			if( nodeIndex == BSP_SOLID_LEAF ) {
+				tHit = t0;
+				return true;
+			}
+			return false;
+		}
+		const float distance = tree.Distance( nodeIndex, start );
+		const float denom = tree.Dot( nodeIndex, dir );
+		const float d0 = distance + denom * t0;
+		const float d1 = distance + denom * t1;
+
+		if( d0 >= 0.0f && d1 >= 0.0f ) {
+			return IntersectSegment_R( tree, tree.Front( nodeIndex ), start, dir, t0, t1, tHit );
+		}
+		if( d0 < 0.0f && d1 < 0.0f ) {
+			return IntersectSegment_R( tree, tree.Back( nodeIndex ), start, dir, t0, t1, tHit );
+		}
+
+		// straddling: visit the near side first
+		const float tSplit = Clamp( -distance / denom, t0, t1 );
+		const int nearChild = (d0 >= 0.0f) ? tree.Front( nodeIndex ) : tree.Back( nodeIndex );
+		const int farChild = (d0 >= 0.0f) ? tree.Back( nodeIndex ) : tree.Front( nodeIndex );
+		if( IntersectSegment_R( tree, nearChild, start, dir, t0, tSplit, tHit ) ) {
+			return true;
+		}
+		return IntersectSegment_R( tree, farChild, start, dir, tSplit, t1, tHit );
+	}
+}//namespace BSP
+
+bool BspTree::Intersect( const Float3& start, const Float3& end, float &t ) const
+{
+	if( !m_nodes.Num() ) {
+		return false;
+	}
+	return IntersectSegment_R( EditableTreeAccess( *this ), BSP_ROOT_NODE, start, end - start, 0.0f, 1.0f, t );
+}
+
+/*
+-----------------------------------------------------------------------------
+	BspFrozenTree
+-----------------------------------------------------------------------------
+*/
+BspFrozenTree::BspFrozenTree()
+{
+	m_rootLeaf = BSP_EMPTY_LEAF;
+	m_maxDepth = 0;
+}
+
+namespace BSP
+{
+	static UINT32 LeafToFrozenChild( int nodeIndex )
+	{
+		mxASSERT( nodeIndex == BSP_EMPTY_LEAF || nodeIndex == BSP_SOLID_LEAF );
+		return (nodeIndex == BSP_SOLID_LEAF) ? FROZEN_CHILD_SOLID : FROZEN_CHILD_EMPTY;
+	}
+
+	// appends the subtree in depth-first order (front child first), returns false if out of memory
+	static bool FreezeSubtree_R( const BspTree& _source, int _nodeIndex, UINT32 _depth, BspFrozenTree & _frozen )
+	{
+		mxASSERT( _nodeIndex >= 0 );
+		_frozen.m_maxDepth = Max( _frozen.m_maxDepth, _depth );
+
+		const UINT32 frozenIndex = _frozen.m_nodes.Num();
+		if( frozenIndex >= FROZEN_MAX_NODES || !_frozen.m_nodes.AddManyUninitialized( 1 ) ) {
+			return false;
+		}
+
+		const BspNode& node = _source.m_nodes[ _nodeIndex ];
+		const Vector4& plane = _source.m_planes[ node.plane ];
+		const int front = (INT32)node.front;
+		const int back = (INT32)node.back;
+
+		BspFrozenNode & frozenNode = _frozen.m_nodes[ frozenIndex ];
+		frozenNode.plane[0] = plane.x;
+		frozenNode.plane[1] = plane.y;
+		frozenNode.plane[2] = plane.z;
+		frozenNode.plane[3] = plane.w;
+
+		UINT32 frontType = FROZEN_CHILD_NODE;
+		if( front >= 0 ) {
+			if( !FreezeSubtree_R( _source, front, _depth + 1, _frozen ) ) {
+				return false;
+			}
+		} else {
+			frontType = LeafToFrozenChild( front );
+		}
+
+		UINT32 backType = FROZEN_CHILD_NODE;
+		UINT32 backIndex = 0;
+		if( back >= 0 ) {
+			backIndex = _frozen.m_nodes.Num();
+			if( !FreezeSubtree_R( _source, back, _depth + 1, _frozen ) ) {
+				return false;
+			}
+		} else {
+			backType = LeafToFrozenChild( back );
+		}
+
+		// the array could have been reallocated
+		_frozen.m_nodes[ frozenIndex ].children = frontType | (backType << 2) | (backIndex << 4);
+		return true;
+	}
+}//namespace BSP
+
+ERet BspFrozenTree::Build( const BspTree& _source )
+{
+	m_nodes.Empty();
+	m_maxDepth = 0;
+	m_rootLeaf = BSP_EMPTY_LEAF;
+
+	if( !_source.m_nodes.Num() ) {
+		return ALL_OK;
+	}
+	mxDO(m_nodes.Reserve( _source.m_nodes.Num() ));
+
+	if( !FreezeSubtree_R( _source, BSP_ROOT_NODE, 0, *this ) ) {
+		m_nodes.Empty();
+		return ERR_OUT_OF_MEMORY;
+	}
+	return ALL_OK;
+}
+
+bool BspFrozenTree::PointInSolid( const Float3& point, float epsilon ) const
+{
+	if( !m_nodes.Num() ) {
+		return m_rootLeaf == BSP_SOLID_LEAF;
+	}
+	const BspFrozenNode* nodes = m_nodes.ToPtr();
+	UINT32 nodeIndex = 0;
+	for(;;)
+	{
+		const BspFrozenNode& node = nodes[ nodeIndex ];
+		const float distance = node.plane[0] * point.x + node.plane[1] * point.y + node.plane[2] * point.z + node.plane[3];
+		const UINT32 children = node.children;
+		if( distance > epsilon )
+		{
+			const UINT32 childType = children & 3;
+			if( childType != FROZEN_CHILD_NODE ) {
+				return childType == FROZEN_CHILD_SOLID;
+			}
+			nodeIndex++;
+		}
+		else
+		{
+			const UINT32 childType = (children >> 2) & 3;
+			if( childType != FROZEN_CHILD_NODE ) {
+				return childType == FROZEN_CHILD_SOLID;
+			}
+			nodeIndex = children >> 4;
+		}
+	}
+}
+
+float BspFrozenTree::DistanceToPoint( const Float3& point, float epsilon ) const
 {
-UNDONE;
+	const FrozenTreeAccess tree( *this );
+	int nodeIndex = m_nodes.Num() ? 0 : m_rootLeaf;
+	float distance = 0.f;
+	while( nodeIndex >= 0 )
+	{
+		distance = tree.Distance( nodeIndex, point );
+		if( distance > +epsilon ) {
+			nodeIndex = tree.Front( nodeIndex );
+		} else if( distance < -epsilon ) {
+			nodeIndex = tree.Back( nodeIndex );
+		} else {
+			nodeIndex = (distance >= 0.f) ? tree.Front( nodeIndex ) : tree.Back( nodeIndex );
+		}
+	}
+	return distance;
+}
+
+void BspFrozenTree::PointsInSolid( const Float3* _points, UINT8 *_results, UINT _count, float epsilon ) const
+{
+	if( !m_nodes.Num() )
+	{
+		for( UINT i = 0; i < _count; i++ ) {
+			_results[i] = (m_rootLeaf == BSP_SOLID_LEAF);
+		}
+		return;
+	}
+
+	const BspFrozenNode* nodes = m_nodes.ToPtr();
+	const __m128 vEpsilon = _mm_set1_ps( epsilon );
+
+	for( UINT start = 0; start < _count; start += 4 )
+	{
+		const UINT numPoints = smallest( _count - start, 4U );
+
+		// unused lanes repeat the first point
+		const Float3* p = _points + start;
+		const __m128 px = _mm_setr_ps( p[0].x, p[(numPoints > 1) ? 1 : 0].x, p[(numPoints > 2) ? 2 : 0].x, p[(numPoints > 3) ? 3 : 0].x );
+		const __m128 py = _mm_setr_ps( p[0].y, p[(numPoints > 1) ? 1 : 0].y, p[(numPoints > 2) ? 2 : 0].y, p[(numPoints > 3) ? 3 : 0].y );
+		const __m128 pz = _mm_setr_ps( p[0].z, p[(numPoints > 1) ? 1 : 0].z, p[(numPoints > 2) ? 2 : 0].z, p[(numPoints > 3) ? 3 : 0].z );
+
+		UINT32	nodeIndices[4] = { 0, 0, 0, 0 };
+		UINT8	inSolid[4] = { 0, 0, 0, 0 };
+		int		activeMask = (1 << numPoints) - 1;
+
+		while( activeMask )
+		{
+			// load the planes of the current nodes of all lanes (finished lanes reload their last node)
+			__m128 r0 = _mm_loadu_ps( nodes[ nodeIndices[0] ].plane );
+			__m128 r1 = _mm_loadu_ps( nodes[ nodeIndices[1] ].plane );
+			__m128 r2 = _mm_loadu_ps( nodes[ nodeIndices[2] ].plane );
+			__m128 r3 = _mm_loadu_ps( nodes[ nodeIndices[3] ].plane );
+			_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+
+			const __m128 distances = _mm_add_ps(
+				_mm_add_ps( _mm_mul_ps( r0, px ), _mm_mul_ps( r1, py ) ),
+				_mm_add_ps( _mm_mul_ps( r2, pz ), r3 )
+			);
+			const int frontMask = _mm_movemask_ps( _mm_cmpgt_ps( distances, vEpsilon ) );
+
+			for( UINT i = 0; i < 4; i++ )
+			{
+				if( !(activeMask & BIT(i)) ) {
+					continue;
+				}
+				const UINT32 children = nodes[ nodeIndices[i] ].children;
+				const bool front = (frontMask & BIT(i)) != 0;
+				const UINT32 childType = front ? (children & 3) : ((children >> 2) & 3);
+				if( childType != FROZEN_CHILD_NODE )
+				{
+					inSolid[i] = (childType == FROZEN_CHILD_SOLID);
+					activeMask &= ~BIT(i);
+					continue;
+				}
+				nodeIndices[i] = front ? nodeIndices[i] + 1 : (children >> 4);
+			}
+		}
+
+		for( UINT i = 0; i < numPoints; i++ ) {
+			_results[ start + i ] = inSolid[i];
+		}
+	}
+}
+
+bool BspFrozenTree::Intersect( const Float3& start, const Float3& end, float &t ) const
+{
+	if( !m_nodes.Num() )
+	{
+		t = 0.0f;
+		return m_rootLeaf == BSP_SOLID_LEAF;
+	}
+	return IntersectSegment_R( FrozenTreeAccess( *this ), BSP_ROOT_NODE, start, end - start, 0.0f, 1.0f, t );
+}
+
+float BspFrozenTree::CastRay( const Float3& start, const Float3& direction ) const
+{
+	const float maxDistance = 1e4f;
+	float t;
+	if( this->Intersect( start, start + direction * maxDistance, t ) ) {
+		return t * maxDistance * Float3_Length( direction );
+	}
+	return -1.0f;
+}
+
+size_t BspFrozenTree::BytesAllocated() const
+{
+	return m_nodes.GetAllocatedMemory();
+}
+
+/*
+-----------------------------------------------------------------------------
+	Query benchmark
+-----------------------------------------------------------------------------
+*/
+namespace BSP
+{
+
+void RunQueryBenchmark( const BspTree& _tree, UINT32 _numPoints )
+{
+	BspFrozenTree	frozen;
+	if( mxFAILED(frozen.Build( _tree )) ) {
+		ptWARN( "Failed to freeze the BSP tree\n" );
+		return;
+	}
+
+	// the bounds of the tree's geometry
+	Float3 boundsMin = Float3_Replicate( +BIG_NUMBER );
+	Float3 boundsMax = Float3_Replicate( -BIG_NUMBER );
+	for( UINT32 iPoly = 0; iPoly < _tree.m_polys.Num(); iPoly++ )
+	{
+		const BspPoly& poly = _tree.m_polys[ iPoly ];
+		for( UINT32 iVertex = 0; iVertex < poly.vertices.Num(); iVertex++ ) {
+			boundsMin = Float3_Min( boundsMin, poly.vertices[ iVertex ].xyz );
+			boundsMax = Float3_Max( boundsMax, poly.vertices[ iVertex ].xyz );
+		}
+	}
+	if( !_tree.m_polys.Num() ) {
+		boundsMin = Float3_Replicate( -1.0f );
+		boundsMax = Float3_Replicate( +1.0f );
+	}
+
+	TArray< Float3 >	points;
+	TArray< UINT8 >		results;
+	if( mxFAILED(points.SetNum( _numPoints )) || mxFAILED(results.SetNum( _numPoints )) ) {
+		return;
+	}
+
+	UINT32 seed = 12345;	// fixed seed for reproducible results
+	for( UINT32 i = 0; i < _numPoints; i++ )
+	{
+		float xyz[3];
+		for( int k = 0; k < 3; k++ ) {
+			seed = seed * 1664525 + 1013904223;
+			const float f = (seed >> 8) * (1.0f / 16777216.0f);
+			xyz[k] = boundsMin[k] + (boundsMax[k] - boundsMin[k]) * f;
+		}
+		points[i] = Float3_Set( xyz[0], xyz[1], xyz[2] );
+	}
+
+	const float epsilon = 1e-4f;
+
+	UINT32 numSolidEditable = 0;
+	UINT64 startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < _numPoints; i++ ) {
+		numSolidEditable += _tree.PointInSolid( points[i], epsilon );
+	}
+	const UINT32 editableTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+
+	UINT32 numSolidFrozen = 0;
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < _numPoints; i++ ) {
+		numSolidFrozen += frozen.PointInSolid( points[i], epsilon );
+	}
+	const UINT32 frozenTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+
+	startTime = mxGetTimeInMicroseconds();
+	frozen.PointsInSolid( points.ToPtr(), results.ToPtr(), _numPoints, epsilon );
+	const UINT32 batchedTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+
+	UINT32 numMismatches = 0;
+	for( UINT32 i = 0; i < _numPoints; i++ ) {
+		numMismatches += ( (results[i] != 0) != _tree.PointInSolid( points[i], epsilon ) );
+	}
+
+	// rays between pairs of random points
+	const UINT32 numRays = _numPoints / 2;
+	UINT32 numHitsEditable = 0, numHitsFrozen = 0;
+	float t;
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numRays; i++ ) {
+		numHitsEditable += _tree.Intersect( points[i*2], points[i*2+1], t );
+	}
+	const UINT32 editableRayTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+
+	startTime = mxGetTimeInMicroseconds();
+	for( UINT32 i = 0; i < numRays; i++ ) {
+		numHitsFrozen += frozen.Intersect( points[i*2], points[i*2+1], t );
+	}
+	const UINT32 frozenRayTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+
+	ptPRINT( "=== BSP query benchmark (%u points) ===\n", _numPoints );
+	ptPRINT( "Editable: %u nodes, %u planes, %u bytes\n", _tree.m_nodes.Num(), _tree.m_planes.Num(),
+		(UINT32)( _tree.m_nodes.GetAllocatedMemory() + _tree.m_planes.GetAllocatedMemory() ) );
+	ptPRINT( "Frozen:   %u nodes, depth %u, %u bytes\n", frozen.m_nodes.Num(), frozen.m_maxDepth, (UINT32)frozen.BytesAllocated() );
+	ptPRINT( "PointInSolid: editable %u usec, frozen %u usec, frozen batched %u usec (%u/%u solid, %u mismatches)\n",
+		editableTime, frozenTime, batchedTime, numSolidEditable, numSolidFrozen, numMismatches );
+	ptPRINT( "Intersect (%u segments): editable %u usec, frozen %u usec (%u/%u hits)\n",
+		numRays, editableRayTime, frozenRayTime, numHitsEditable, numHitsFrozen );
+}
+
+}//namespace BSP
+
+/*
+-----------------------------------------------------------------------------
+	BspDirtyRegions
+-----------------------------------------------------------------------------
+*/
+BspDirtyRegions::BspDirtyRegions()
+{
+	regionDepth = 4;
+	this->Reset();
+}
+void BspDirtyRegions::Reset()
+{
+	regions.Empty();
+	m_numVisitedNodes = 0;
+	m_numSkippedNodes = 0;
+	m_numClippedPolys = 0;
+}
+void BspDirtyRegions::Add( BspNodeID region )
+{
+	if( !this->Contains( region ) ) {
+		regions.Add( region );
+	}
+}
+bool BspDirtyRegions::Contains( BspNodeID region ) const
+{
+	for( UINT32 i = 0; i < regions.Num(); i++ ) {
+		if( regions[i] == region ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+-----------------------------------------------------------------------------
+	Incremental CSG.
+
+	A - B is computed by pushing the brush tree B down the tree A.
+	B is built from the inverted brush mesh (the space outside the brush is solid),
+	at each node of A it's partitioned with the node's plane
+	and the solid leaves of A are replaced with the resulting pieces of B.
+	The cells of A which get a solid piece of B (i.e. lie outside the brush) are not visited
+	and only the polygons of A overlapping the bounds of the brush are clipped.
+-----------------------------------------------------------------------------
+*/
+namespace
+{
+	// reverses the winding of the triangles, so that the space inside the mesh is empty
+	struct InvertedTriangleMesh : ATriangleMeshInterface
+	{
+		struct FlipTriangles : ATriangleIndexCallback
+		{
+			ATriangleIndexCallback *	m_callback;
+			FlipTriangles( ATriangleIndexCallback* callback ) : m_callback( callback )
+			{}
+			virtual void ProcessTriangle( const Vertex& a, const Vertex& b, const Vertex& c ) override
+			{
+				m_callback->ProcessTriangle( a, c, b );
+			}
+		};
+		ATriangleMeshInterface *	m_mesh;
+	public:
+		InvertedTriangleMesh( ATriangleMeshInterface* mesh ) : m_mesh( mesh )
+		{}
+		virtual void ProcessAllTriangles( ATriangleIndexCallback* callback ) override
+		{
+			FlipTriangles	flipped( callback );
+			m_mesh->ProcessAllTriangles( &flipped );
+		}
+	};
+
+	struct IncrementalCSG
+	{
+		BspTree &			tree;	// the tree being modified
+		BspTree &			brush;	// the inverted brush, the pieces of its subtrees are appended to it
+		Float3				brushMin;	// the bounds of the brush, expanded by the plane epsilon
+		Float3				brushMax;
+		BspNodeID			brushExterior;	// the leaf of the brush which contains the space outside its bounds
+		float				epsilon;
+		UINT32				regionDepth;
+		BspDirtyRegions &	dirty;
+	public:
+		IncrementalCSG( BspTree & _tree, BspTree & _brush, BspDirtyRegions & _dirty )
+			: tree( _tree ), brush( _brush ), dirty( _dirty )
+		{}
+	};
+
+	// the trees grow at run time, so the limits are checked in release builds too
+
+	static ERet NewNodeChecked( BspTree & tree, BspNodeID *newNode )
+	{
+		if( tree.m_nodes.Num() >= BSP_MAX_NODES ) {
+			return ERR_TOO_MANY_OBJECTS;
+		}
+		mxDO(tree.m_nodes.Reserve( tree.m_nodes.Num() + 1 ));
+		*newNode = NewNode( tree );
+		return ALL_OK;
+	}
+
+	// the polygon must not be stored in the same tree (the array can be reallocated)
+	static ERet AddPolygonChecked( const BspPoly& poly, BspTree & tree, BspPolyID * head )
+	{
+		if( tree.m_polys.Num() >= BSP_MAX_POLYS ) {
+			return ERR_TOO_MANY_OBJECTS;
+		}
+		mxDO(tree.m_polys.Reserve( tree.m_polys.Num() + 1 ));
+		AddPolygon( poly, tree, head );
+		return ALL_OK;
+	}
+
+	// fails if the tree is full, even if the plane already exists
+	static ERet GetPlaneIndexChecked( BspTree & tree, const Vector4& plane, BspPlaneID *planeIndex )
+	{
+		if( tree.m_planes.Num() >= BSP_MAX_PLANES ) {
+			return ERR_TOO_MANY_OBJECTS;
+		}
+		mxDO(tree.m_planes.Reserve( tree.m_planes.Num() + 1 ));
+		*planeIndex = GetPlaneIndex( tree, plane );
+		return ALL_OK;
+	}
+
+	static bool PolygonOverlapsBounds( const BspPoly& polygon, const Float3& boundsMin, const Float3& boundsMax )
+	{
+		Float3 polyMin = polygon.vertices[0].xyz;
+		Float3 polyMax = polyMin;
+		for( UINT32 iVertex = 1; iVertex < polygon.vertices.Num(); iVertex++ )
+		{
+			polyMin = Float3_Min( polyMin, polygon.vertices[ iVertex ].xyz );
+			polyMax = Float3_Max( polyMax, polygon.vertices[ iVertex ].xyz );
+		}
+		return polyMin.x <= boundsMax.x && polyMax.x >= boundsMin.x
+			&& polyMin.y <= boundsMax.y && polyMax.y >= boundsMin.y
+			&& polyMin.z <= boundsMax.z && polyMax.z >= boundsMin.z;
+	}
+
+	// returns PLANESIDE_CROSS if the box intersects the plane
+	static EPlaneSide ClassifyBounds( const Vector4& plane, const Float3& boundsMin, const Float3& boundsMax )
+	{
+		const Float3 center = ( boundsMin + boundsMax ) * 0.5f;
+		const Float3 extent = ( boundsMax - boundsMin ) * 0.5f;
+		const Float3& N = Plane_GetNormal( plane );
+		const float radius = fabs( N.x ) * extent.x + fabs( N.y ) * extent.y + fabs( N.z ) * extent.z;
+		const float distance = Plane_PointDistance( plane, center );
+		if( distance > radius ) {
+			return PLANESIDE_FRONT;
+		}
+		if( distance < -radius ) {
+			return PLANESIDE_BACK;
+		}
+		return PLANESIDE_CROSS;
+	}
+
+	// keeps the parts of the polygons lying outside the brush (in its solid leaves), the other parts are removed
+	static ERet ClipPolygonsOutsideBrush_R( IncrementalCSG & csg, const BspPolyID polygons, const int brushNode, BspPolyID *kept )
+	{
+		BspTree & tree = csg.tree;
+
+		if( brushNode < 0 )
+		{
+			BspPolyID iPoly = polygons;
+			while( iPoly != BSP_NONE )
+			{
+				BspPoly & polygon = tree.m_polys[ iPoly ];
+				const BspPolyID iNextPoly = polygon.next;
+				if( brushNode == BSP_SOLID_LEAF ) {
+					polygon.next = *kept;
+					*kept = iPoly;
+				} else {
+					tree.m_numUnusedPolys++;
+				}
+				iPoly = iNextPoly;
+			}
+			return ALL_OK;
+		}
+
+		const BspNode& node = csg.brush.m_nodes[ brushNode ];
+		const Vector4 plane = csg.brush.m_planes[ node.plane ];
+		const int brushFront = (INT32)node.front;
+		const int brushBack = (INT32)node.back;
+
+		BspPolyID	frontPolys = BSP_NONE;
+		BspPolyID	backPolys = BSP_NONE;
+
+		BspPolyID iPoly = polygons;
+		while( iPoly != BSP_NONE )
+		{
+			const BspPolyID iNextPoly = tree.m_polys[ iPoly ].next;
+
+			BspVertex	buffer1[64];
+			BspVertex	buffer2[64];
+
+			BspPoly		frontPoly;
+			BspPoly		backPoly;
+			frontPoly.vertices.SetExternalStorage( buffer1, mxCOUNT_OF(buffer1) );
+			backPoly.vertices.SetExternalStorage( buffer2, mxCOUNT_OF(buffer2) );
+
+			EPlaneSide side = SplitConvexPolygonByPlane( tree.m_polys[ iPoly ], frontPoly, backPoly, plane, csg.epsilon );
+
+			if( side == PLANESIDE_ON )
+			{
+				const Vector4 polygonPlane = PlaneFromPolygon( tree.m_polys[ iPoly ] );
+				const float dot = Float3_Dot( Plane_GetNormal( polygonPlane ), Plane_GetNormal( plane ) );
+				if( Abs( dot ) > 0.5f ) {
+					// the polygon lies on the plane of the brush (the planes of the inverted brush face inwards):
+					// the part on the brush surface is either replaced with the brush polygon
+					// (see PartitionBrushWithPlane()) or separates two cells which become empty
+					side = PLANESIDE_FRONT;
+				} else {
+					// a sliver thinner than the epsilon
+					const float distance = Plane_PointDistance( plane, GetPolygonCenter( tree.m_polys[ iPoly ] ) );
+					side = ( distance > 0.0f ) ? PLANESIDE_FRONT : PLANESIDE_BACK;
+				}
+			}
+
+			if( side == PLANESIDE_CROSS )
+			{
+				mxDO(AddPolygonChecked( frontPoly, tree, &frontPolys ));
+				mxDO(AddPolygonChecked( backPoly, tree, &backPolys ));
+				tree.m_numUnusedPolys++;
+			}
+			else if( side == PLANESIDE_FRONT )
+			{
+				tree.m_polys[ iPoly ].next = frontPolys;
+				frontPolys = iPoly;
+			}
+			else
+			{
+				tree.m_polys[ iPoly ].next = backPolys;
+				backPolys = iPoly;
+			}
+
+			iPoly = iNextPoly;
+		}
+
+		if( frontPolys != BSP_NONE ) {
+			mxDO(ClipPolygonsOutsideBrush_R( csg, frontPolys, brushFront, kept ));
+		}
+		if( backPolys != BSP_NONE ) {
+			mxDO(ClipPolygonsOutsideBrush_R( csg, backPolys, brushBack, kept ));
+		}
+		return ALL_OK;
+	}
+
+	// clips only the polygons of the node which overlap the brush
+	static ERet ClipNodePolys( IncrementalCSG & csg, const BspNodeID nodeIndex, UINT32 *numClippedPolys )
+	{
+		BspTree & tree = csg.tree;
+
+		BspPolyID	overlapping = BSP_NONE;
+		BspPolyID	untouched = BSP_NONE;
+		UINT32		numOverlapping = 0;
+
+		BspPolyID iPoly = tree.m_nodes[ nodeIndex ].polys;
+		while( iPoly != BSP_NONE )
+		{
+			BspPoly & polygon = tree.m_polys[ iPoly ];
+			const BspPolyID iNextPoly = polygon.next;
+			if( PolygonOverlapsBounds( polygon, csg.brushMin, csg.brushMax ) ) {
+				polygon.next = overlapping;
+				overlapping = iPoly;
+				numOverlapping++;
+			} else {
+				polygon.next = untouched;
+				untouched = iPoly;
+			}
+			iPoly = iNextPoly;
+		}
+
+		// the node stays valid if clipping fails
+		tree.m_nodes[ nodeIndex ].polys = untouched;
+
+		if( overlapping != BSP_NONE )
+		{
+			BspPolyID polys = untouched;
+			mxDO(ClipPolygonsOutsideBrush_R( csg, overlapping, BSP_ROOT_NODE, &polys ));
+			tree.m_nodes[ nodeIndex ].polys = polys;
+		}
+
+		*numClippedPolys = numOverlapping;
+		return ALL_OK;
+	}
+
+	// splits the brush subtree with the plane; new nodes are appended to the brush, existing nodes are not modified
+	static ERet PartitionBrushWithPlane( IncrementalCSG & csg, const Vector4& plane, const BspNodeID nodeId, BspNodeID *front, BspNodeID *back )
+	{
+		BspTree & brush = csg.brush;
+
+		const int nodeIndex = (INT32)nodeId;
+		if( nodeIndex < 0 ) {
+			*front = nodeId;
+			*back = nodeId;
+			return ALL_OK;
+		}
+
+		// copy, the array can be reallocated
+		const BspPlaneID	nodePlaneIndex = brush.m_nodes[ nodeIndex ].plane;
+		const BspNodeID	nodeFront = brush.m_nodes[ nodeIndex ].front;
+		const BspNodeID	nodeBack = brush.m_nodes[ nodeIndex ].back;
+		const BspPolyID	nodePolys = brush.m_nodes[ nodeIndex ].polys;
+		const Vector4	nodePlane = brush.m_planes[ nodePlaneIndex ];
+
+		// the planes coincide: the polygons of the node go with its back child,
+		// to the side where the space behind them is (the front child goes to the other side)
+		const bool sameFacing = Planes_Equal( plane, nodePlane, NORMAL_EPSILON, DIST_EPSILON );
+		if( sameFacing || Planes_Equal( plane, Vector4_Negate( nodePlane ), NORMAL_EPSILON, DIST_EPSILON ) )
+		{
+			BspNodeID backPiece;
+			mxDO(NewNodeChecked( brush, &backPiece ));
+			brush.m_nodes[ backPiece ].plane = nodePlaneIndex;
+			brush.m_nodes[ backPiece ].polys = nodePolys;
+			brush.m_nodes[ backPiece ].front = BSP_EMPTY_LEAF;	// the piece has no volume in front of the plane
+			brush.m_nodes[ backPiece ].back = nodeBack;
+
+			*front = sameFacing ? nodeFront : backPiece;
+			*back = sameFacing ? backPiece : nodeFront;
+			return ALL_OK;
+		}
+
+		// partition the polygons of the node
+		BspPolyID	frontPolys = BSP_NONE;
+		BspPolyID	backPolys = BSP_NONE;
+
+		for( BspPolyID iPoly = nodePolys; iPoly != BSP_NONE; iPoly = brush.m_polys[ iPoly ].next )
+		{
+			BspVertex	buffer1[64];
+			BspVertex	buffer2[64];
+
+			BspPoly		frontPoly;
+			BspPoly		backPoly;
+			frontPoly.vertices.SetExternalStorage( buffer1, mxCOUNT_OF(buffer1) );
+			backPoly.vertices.SetExternalStorage( buffer2, mxCOUNT_OF(buffer2) );
+
+			const EPlaneSide side = SplitConvexPolygonByPlane( brush.m_polys[ iPoly ], frontPoly, backPoly, plane, csg.epsilon );
+
+			if( side == PLANESIDE_CROSS ) {
+				mxDO(AddPolygonChecked( frontPoly, brush, &frontPolys ));
+				mxDO(AddPolygonChecked( backPoly, brush, &backPolys ));
+			} else if( side == PLANESIDE_BACK ) {
+				backPoly.vertices = brush.m_polys[ iPoly ].vertices;
+				mxDO(AddPolygonChecked( backPoly, brush, &backPolys ));
+			} else {
+				frontPoly.vertices = brush.m_polys[ iPoly ].vertices;
+				mxDO(AddPolygonChecked( frontPoly, brush, &frontPolys ));
+			}
+		}
+
+		// split both children of the node
+		BspNodeID newFront, newBack;
+		mxDO(NewNodeChecked( brush, &newFront ));
+		mxDO(NewNodeChecked( brush, &newBack ));
+
+		brush.m_nodes[ newFront ].plane = nodePlaneIndex;
+		brush.m_nodes[ newFront ].polys = frontPolys;
+
+		brush.m_nodes[ newBack ].plane = nodePlaneIndex;
+		brush.m_nodes[ newBack ].polys = backPolys;
+
+		BspNodeID frontOfFront, backOfFront;
+		BspNodeID frontOfBack, backOfBack;
+		mxDO(PartitionBrushWithPlane( csg, plane, nodeFront, &frontOfFront, &backOfFront ));
+		mxDO(PartitionBrushWithPlane( csg, plane, nodeBack, &frontOfBack, &backOfBack ));
+
+		brush.m_nodes[ newFront ].front = frontOfFront;
+		brush.m_nodes[ newFront ].back = frontOfBack;
+
+		brush.m_nodes[ newBack ].front = backOfFront;
+		brush.m_nodes[ newBack ].back = backOfBack;
+
+		*front = newFront;
+		*back = newBack;
+		return ALL_OK;
+	}
+
+	// copies the piece of the brush into the tree, the new subtree is linked only if it has been copied completely
+	static ERet CopyBrushPiece_R( IncrementalCSG & csg, const BspNodeID pieceId, BspNodeID *newNode )
+	{
+		const int pieceIndex = (INT32)pieceId;
+		if( pieceIndex < 0 ) {
+			*newNode = pieceId;
+			return ALL_OK;
+		}
+
+		BspTree & tree = csg.tree;
+		const BspNode& piece = csg.brush.m_nodes[ pieceIndex ];
+
+		BspPlaneID planeIndex;
+		mxDO(GetPlaneIndexChecked( tree, csg.brush.m_planes[ piece.plane ], &planeIndex ));
+
+		BspNodeID iNewNode;
+		mxDO(NewNodeChecked( tree, &iNewNode ));
+		tree.m_nodes[ iNewNode ].plane = planeIndex;
+		tree.m_nodes[ iNewNode ].polys = BSP_NONE;
+
+		// the polygons lying in the plane of the node
+		BspPolyID polys = BSP_NONE;
+		for( BspPolyID iPoly = piece.polys; iPoly != BSP_NONE; iPoly = csg.brush.m_polys[ iPoly ].next ) {
+			mxDO(AddPolygonChecked( csg.brush.m_polys[ iPoly ], tree, &polys ));
+		}
+		tree.m_nodes[ iNewNode ].polys = polys;
+
+		BspNodeID front, back;
+		mxDO(CopyBrushPiece_R( csg, piece.front, &front ));
+		mxDO(CopyBrushPiece_R( csg, piece.back, &back ));
+		tree.m_nodes[ iNewNode ].front = front;
+		tree.m_nodes[ iNewNode ].back = back;
+
+		*newNode = iNewNode;
+		return ALL_OK;
+	}
+
+	// adds the regions rooted in the new subtree
+	static void AddNewRegions_R( IncrementalCSG & csg, const BspNodeID nodeId, const UINT32 depth )
+	{
+		const int nodeIndex = (INT32)nodeId;
+		if( nodeIndex >= 0 )
+		{
+			if( depth == csg.regionDepth ) {
+				csg.dirty.Add( nodeId );
+				return;
+			}
+			const BspNode& node = csg.tree.m_nodes[ nodeIndex ];
+			AddNewRegions_R( csg, node.front, depth + 1 );
+			AddNewRegions_R( csg, node.back, depth + 1 );
+		}
+	}
+
+	// computes A - B, visiting only the cells of A which overlap the brush
+	static ERet MergeSubtract_R(
+		IncrementalCSG & csg,
+		const BspNodeID nodeA, const BspNodeID nodeB,
+		const UINT32 depth, BspNodeID region,
+		BspNodeID *newNodeA
+		)
+	{
+		*newNodeA = nodeA;
+
+		// A and solid space = A
+		if( (INT32)nodeB == BSP_SOLID_LEAF ) {
+			csg.dirty.m_numSkippedNodes++;
+			return ALL_OK;
+		}
+
+		const int nodeIndexA = (INT32)nodeA;
+		if( nodeIndexA >= 0 )
+		{
+			csg.dirty.m_numVisitedNodes++;
+			if( depth == csg.regionDepth ) {
+				region = nodeA;
+			}
+
+			UINT32 numClippedPolys;
+			mxDO(ClipNodePolys( csg, nodeA, &numClippedPolys ));
+			if( numClippedPolys ) {
+				csg.dirty.m_numClippedPolys += numClippedPolys;
+				csg.dirty.Add( region );
+			}
+
+			const BspNodeID nodeA_front = csg.tree.m_nodes[ nodeIndexA ].front;
+			const BspNodeID nodeA_back = csg.tree.m_nodes[ nodeIndexA ].back;
+			const Vector4 plane = csg.tree.m_planes[ csg.tree.m_nodes[ nodeIndexA ].plane ];
+
+			// don't partition the brush if it lies on one side of the plane
+			BspNodeID nodeB_front, nodeB_back;
+			const EPlaneSide side = ClassifyBounds( plane, csg.brushMin, csg.brushMax );
+			if( side == PLANESIDE_FRONT ) {
+				nodeB_front = nodeB;
+				nodeB_back = csg.brushExterior;
+			} else if( side == PLANESIDE_BACK ) {
+				nodeB_front = csg.brushExterior;
+				nodeB_back = nodeB;
+			} else {
+				mxDO(PartitionBrushWithPlane( csg, plane, nodeB, &nodeB_front, &nodeB_back ));
+			}
+
+			BspNodeID newFront, newBack;
+			mxDO(MergeSubtract_R( csg, nodeA_front, nodeB_front, depth + 1, region, &newFront ));
+			csg.tree.m_nodes[ nodeIndexA ].front = newFront;
+			mxDO(MergeSubtract_R( csg, nodeA_back, nodeB_back, depth + 1, region, &newBack ));
+			csg.tree.m_nodes[ nodeIndexA ].back = newBack;
+		}
+		else if( nodeIndexA == BSP_SOLID_LEAF )
+		{
+			// the solid cell is replaced with the piece of the brush
+			BspNodeID newNode;
+			mxDO(CopyBrushPiece_R( csg, nodeB, &newNode ));
+			if( depth < csg.regionDepth ) {
+				csg.dirty.Add( BSP_TOP_REGION );
+			}
+			if( depth <= csg.regionDepth ) {
+				AddNewRegions_R( csg, newNode, depth );
+			} else {
+				csg.dirty.Add( region );
+			}
+			*newNodeA = newNode;
+		}
+		// empty space - do nothing
+		return ALL_OK;
+	}
+}//namespace
+
+ERet BspTree::Subtract( ATriangleMeshInterface* _mesh, BspDirtyRegions & dirty, const Settings& settings )
+{
+	if( !m_nodes.Num() ) {
+		return ALL_OK;	// nothing to carve
+	}
+
+	// the brush is small, it's built on this thread
+	Settings	brushSettings( settings );
+	brushSettings.multithreaded = false;
+
+	InvertedTriangleMesh	invertedMesh( _mesh );
+	BspTree		brush;
+	mxDO(brush.Build( &invertedMesh, brushSettings ));
+
+	IncrementalCSG	csg( *this, brush, dirty );
+
+	csg.brushMin = Float3_Replicate( +BIG_NUMBER );
+	csg.brushMax = Float3_Replicate( -BIG_NUMBER );
+	for( UINT32 iPoly = 0; iPoly < brush.m_polys.Num(); iPoly++ )
+	{
+		const BspPoly& poly = brush.m_polys[ iPoly ];
+		for( UINT32 iVertex = 0; iVertex < poly.vertices.Num(); iVertex++ )
+		{
+			csg.brushMin = Float3_Min( csg.brushMin, poly.vertices[ iVertex ].xyz );
+			csg.brushMax = Float3_Max( csg.brushMax, poly.vertices[ iVertex ].xyz );
+		}
+	}
+	const Float3 margin = Float3_Replicate( settings.planeEpsilon );
+	csg.brushMin -= margin;
+	csg.brushMax += margin;
+
+	// any point outside the bounds of the brush
+	const Float3 exteriorPoint = csg.brushMax + margin;
+	csg.brushExterior = brush.PointInSolid( exteriorPoint, 0.0f ) ? BSP_SOLID_LEAF : BSP_EMPTY_LEAF;
+
+	csg.epsilon = settings.planeEpsilon;
+	csg.regionDepth = largest( dirty.regionDepth, 1U );
+
+	BspNodeID root;
+	const ERet result = MergeSubtract_R( csg, BSP_ROOT_NODE, BSP_ROOT_NODE, 0, BSP_TOP_REGION, &root );
+	mxASSERT( root == BSP_ROOT_NODE );
+
+	// release the memory of the removed polygons (the ids of the nodes don't change)
+	if( m_numUnusedPolys > m_polys.Num() / 2 )
+	{
+		mxDO(RemoveUnusedPolygons( *this ));
+		m_numUnusedPolys = 0;
+	}
+
+	if( mxFAILED( result ) ) {
+		ptWARN("BSP: the brush has been carved only partially: %s\n", EReturnCode_To_Chars( result ));
+	}
+	return result;
+}
+
+namespace
+{
+	// the polygons are convex, they are triangulated as fans
+	static ERet TriangulatePolygons( const BspTree& tree, const BspPolyID polygons, TArray< BspVertex > &vertices, TArray< UINT32 > &indices )
+	{
+		for( BspPolyID iPoly = polygons; iPoly != BSP_NONE; iPoly = tree.m_polys[ iPoly ].next )
+		{
+			const BspPoly& polygon = tree.m_polys[ iPoly ];
+			const UINT32 numPolyVertices = polygon.vertices.Num();
+			if( numPolyVertices < 3 ) {
+				continue;
+			}
+
+			const UINT32 firstVertex = vertices.Num();
+			BspVertex* newVertices = vertices.AddManyUninitialized( numPolyVertices );
+			UINT32* newIndices = indices.AddManyUninitialized( (numPolyVertices - 2) * 3 );
+			chkRET_X_IF_NOT( newVertices && newIndices, ERR_OUT_OF_MEMORY );
+
+			for( UINT32 iVertex = 0; iVertex < numPolyVertices; iVertex++ ) {
+				newVertices[ iVertex ] = polygon.vertices[ iVertex ];
+			}
+			for( UINT32 iVertex = 2; iVertex < numPolyVertices; iVertex++ ) {
+				*newIndices++ = firstVertex;
+				*newIndices++ = firstVertex + iVertex - 1;
+				*newIndices++ = firstVertex + iVertex;
+			}
+		}
+		return ALL_OK;
+	}
+
+	// triangulates the nodes above 'maxDepth'
+	static ERet TriangulateSubtree_R( const BspTree& tree, const BspNodeID nodeId, const UINT32 depth, const UINT32 maxDepth, TArray< BspVertex > &vertices, TArray< UINT32 > &indices )
+	{
+		const int nodeIndex = (INT32)nodeId;
+		if( nodeIndex >= 0 && depth < maxDepth )
+		{
+			const BspNode& node = tree.m_nodes[ nodeIndex ];
+			mxDO(TriangulatePolygons( tree, node.polys, vertices, indices ));
+			mxDO(TriangulateSubtree_R( tree, node.front, depth + 1, maxDepth, vertices, indices ));
+			mxDO(TriangulateSubtree_R( tree, node.back, depth + 1, maxDepth, vertices, indices ));
+		}
+		return ALL_OK;
+	}
+
+	static void CollectRegions_R( const BspTree& tree, const BspNodeID nodeId, const UINT32 depth, const UINT32 regionDepth, TArray< BspNodeID > &regions )
+	{
+		const int nodeIndex = (INT32)nodeId;
+		if( nodeIndex >= 0 )
+		{
+			if( depth == regionDepth ) {
+				regions.Add( nodeId );
+				return;
+			}
+			const BspNode& node = tree.m_nodes[ nodeIndex ];
+			CollectRegions_R( tree, node.front, depth + 1, regionDepth, regions );
+			CollectRegions_R( tree, node.back, depth + 1, regionDepth, regions );
+		}
+	}
+}//namespace
+
+void BspTree::CollectRegions( UINT32 regionDepth, TArray< BspNodeID > &regions ) const
+{
+	regions.Empty();
+	regions.Add( BSP_TOP_REGION );
+	if( m_nodes.Num() ) {
+		CollectRegions_R( *this, BSP_ROOT_NODE, 0, largest( regionDepth, 1U ), regions );
+	}
+}
+
+ERet BspTree::GenerateRegionMesh(
+	const BspNodeID region,
+	const UINT32 regionDepth,
+	TArray< BspVertex > &vertices,
+	TArray< UINT32 > &indices
+	) const
+{
+	vertices.Empty();
+	indices.Empty();
+	if( !m_nodes.Num() ) {
+		return ALL_OK;
+	}
+	if( region == BSP_TOP_REGION ) {
+		return TriangulateSubtree_R( *this, BSP_ROOT_NODE, 0, largest( regionDepth, 1U ), vertices, indices );
+	}
+	return TriangulateSubtree_R( *this, region, 0, MAX_UINT32, vertices, indices );
+}
+
+ERet BspTree::GenerateMesh(
+	TArray< BspVertex > &vertices,
+	TArray< UINT32 > &indices
+	) const
+{
+	vertices.Empty();
+	indices.Empty();
+	if( !m_nodes.Num() ) {
+		return ALL_OK;
+	}
+	return TriangulateSubtree_R( *this, BSP_ROOT_NODE, 0, MAX_UINT32, vertices, indices );
 }
 
 namespace BSP
@@ -3,17 +3,19 @@
 #include <Meshok/Meshok.h>
 #include <Meshok/SDF.h>
 
-typedef UINT16 BspNodeID;
-typedef UINT16 BspPolyID;
+// 32-bit ids, so that large levels can be carved with CSG (see BspTree::Subtract())
+typedef UINT32 BspNodeID;
+typedef UINT32 BspPolyID;
+typedef UINT32 BspPlaneID;
 
-enum { BSP_NONE = (UINT16)~0 };
+enum { BSP_NONE = (UINT32)~0 };
 
 struct BspNode : public CStruct
 {
-	UINT16		plane;	//2 Hyperplane of the node (index into array of planes).
-	BspNodeID	front;	//2 Index of the right child (positive subspace, in front of plane).
-	BspNodeID	back;	//2 Index of the left child (negative subspace, behind the plane).
-	BspPolyID	polys;	//2 linked list of polygons lying on this node's plane
+	BspPlaneID	plane;	//4 Hyperplane of the node (index into array of planes).
+	BspNodeID	front;	//4 Index of the right child (positive subspace, in front of plane).
+	BspNodeID	back;	//4 Index of the left child (negative subspace, behind the plane).
+	BspPolyID	polys;	//4 linked list of polygons lying on this node's plane
 public:
 	mxDECLARE_CLASS(BspNode,CStruct);
 	mxDECLARE_REFLECTION;
@@ -49,14 +51,52 @@ public:
 
 	UINT32		m_numInternalNodes;
 	UINT32		m_numPlanes;
-	//UINT32		depth;
 	UINT32		m_numSolidLeaves, m_numEmptyLeaves;
 
+	// the number of leaves at each depth (the last bin also counts deeper leaves)
+	enum { MAX_DEPTH_BINS = 64 };
+	UINT32		m_depthHistogram[ MAX_DEPTH_BINS ];
+	UINT32		m_maxDepth;
+
+	UINT32		m_numSubtrees;	// subtrees built on worker threads
 	UINT32		m_bytesAllocated;
+	UINT32		m_buildTimeMSec;
 public:
 	BspStats();
 	void Reset();
-	void Print( UINT32 elapsedTimeMSec );
+	void AddLeaf( UINT32 depth );
+	// accumulates stats of subtrees built in parallel
+	void Add( const BspStats& other );
+	void Print() const;
+};
+
+/*
+-----------------------------------------------------------------------------
+	Render regions for incremental CSG.
+
+	The tree is split into regions which are triangulated and uploaded separately:
+	the top region holds the polygons of all nodes above 'regionDepth'
+	and each internal node at 'regionDepth' roots a region with its whole subtree.
+	CSG never removes or moves existing nodes (new nodes are appended),
+	so region ids stay valid and the renderer can keep a vertex buffer per region.
+-----------------------------------------------------------------------------
+*/
+enum { BSP_TOP_REGION = 0 };	// the region of the root node
+
+struct BspDirtyRegions
+{
+	TArray< BspNodeID >	regions;	// regions whose geometry must be regenerated
+	UINT32				regionDepth;// must be > 0
+
+	// stats for the last operations
+	UINT32		m_numVisitedNodes;
+	UINT32		m_numSkippedNodes;	// subtrees outside the brush
+	UINT32		m_numClippedPolys;	// polygons overlapping the brush
+public:
+	BspDirtyRegions();
+	void Reset();	// doesn't change 'regionDepth'
+	void Add( BspNodeID region );
+	bool Contains( BspNodeID region ) const;
 };
 
 /*
@@ -81,6 +121,7 @@ struct BspTree : public CStruct
 	TArray< BspNode >	m_nodes;	// tree nodes (0 = root index)
 	TArray< Vector4 >	m_planes;	// plane equations (16 bytes per plane)
 	TArray< BspPoly >	m_polys;
+	UINT32				m_numUnusedPolys;	// polygons removed or split by CSG, not referenced by nodes
 	//TArray< NodeData >	m_nodeData;
 public:
 	mxDECLARE_CLASS(BspTree,CStruct);
@@ -89,10 +130,40 @@ public:
 
 	struct Settings
 	{
-		//
+		enum EBuilder
+		{
+			// tries each polygon as a splitter (O(n^2) per node), see SplittingCriteria
+			Builder_Exhaustive,
+			// bins the polygon planes by orientation and distance and evaluates
+			// only a few representative planes with the surface area heuristic
+			Builder_Binned,
+		};
+		EBuilder	builder;
+
+		// (binned builder) the max. number of candidate planes evaluated at each node
+		UINT32		maxCandidates;
+
+		// (binned builder) the penalty for splitting a polygon, in the units of the surface area heuristic
+		// (the expected number of polygons visited by a query), 1 = as if each query visited one more polygon
+		float		splitCost;
+
+		// slack value for testing polygons wrt candidate planes
+		float		planeEpsilon;
+
+		// build independent subtrees (and evaluate candidate planes of large nodes) on worker threads
+		bool		multithreaded;
+
+		// nodes with fewer polygons are built by a single thread
+		UINT32		minPolysPerTask;
+	public:
+		Settings();
 	};
 
-	ERet Build( ATriangleMeshInterface* triangleMesh );
+	ERet Build(
+		ATriangleMeshInterface* triangleMesh,
+		const Settings& settings = Settings(),
+		BspStats *stats = nil
+	);
 
 	bool PointInSolid( const Float3& point, float epsilon ) const;
 
@@ -105,9 +176,33 @@ public:
 
 	size_t BytesAllocated() const;
 
-	void Subtract( ATriangleMeshInterface* _mesh );
-
-	void GenerateMesh();
+	// Carves the closed mesh out of solid space (A = A - B).
+	// Only the subtrees whose cells overlap the brush are visited, only the polygons overlapping the brush are clipped
+	// and the modified render regions are appended to 'dirty'.
+	// Returns ERR_TOO_MANY_OBJECTS if the tree would exceed BSP_MAX_NODES or BSP_MAX_PLANES,
+	// the tree stays valid then, but the brush may have been carved only partially.
+	ERet Subtract(
+		ATriangleMeshInterface* _mesh,
+		BspDirtyRegions & dirty,
+		const Settings& settings = Settings()
+	);
+
+	// collects the ids of all render regions (see BspDirtyRegions)
+	void CollectRegions( UINT32 regionDepth, TArray< BspNodeID > &regions ) const;
+
+	// triangulates the polygons of a single render region
+	ERet GenerateRegionMesh(
+		const BspNodeID region,
+		const UINT32 regionDepth,
+		TArray< BspVertex > &vertices,
+		TArray< UINT32 > &indices
+	) const;
+
+	// triangulates all polygons of the tree
+	ERet GenerateMesh(
+		TArray< BspVertex > &vertices,
+		TArray< UINT32 > &indices
+	) const;
 };
 
 // Special node ids.
@@ -119,6 +214,52 @@ enum {
 	BSP_SOLID_LEAF = -3,	// An incell leaf node ( representing solid space ).
 };
 
+/*
+-----------------------------------------------------------------------------
+	Frozen (read-only) BSP tree optimized for queries.
+
+	Pointerless layout: nodes are stored in depth-first order with
+	the front child immediately following its parent,
+	so only the index of the back child is stored.
+	Planes are stored inside nodes and leaves are implicit
+	(their types are encoded in the parent), so traversal touches
+	only a single contiguous array (20 bytes per node).
+-----------------------------------------------------------------------------
+*/
+struct BspFrozenNode
+{
+	float	plane[4];	// plane equation (normal, distance)
+	UINT32	children;	// [0..1] - front child type, [2..3] - back child type, [4..31] - back child index
+};
+
+struct BspFrozenTree
+{
+	TArray< BspFrozenNode >	m_nodes;	// 0 = root index
+	int						m_rootLeaf;	// BSP_EMPTY_LEAF or BSP_SOLID_LEAF if the tree has no nodes
+	UINT32					m_maxDepth;
+public:
+	BspFrozenTree();
+
+	ERet Build( const BspTree& _source );
+
+	bool PointInSolid( const Float3& point, float epsilon ) const;
+
+	// returns > 0, if outside
+	float DistanceToPoint( const Float3& point, float epsilon ) const;
+
+	// classifies four points at a time, interleaving independent traversals;
+	// writes 1 for points in solid space and 0 otherwise
+	void PointsInSolid( const Float3* _points, UINT8 *_results, UINT _count, float epsilon ) const;
+
+	// finds the first intersection of the segment with solid space, t - fraction in [0..1]
+	bool Intersect( const Float3& start, const Float3& end, float &t ) const;
+
+	// returns the distance to the first solid leaf along the ray, or -1 if nothing was hit
+	float CastRay( const Float3& start, const Float3& direction ) const;
+
+	size_t BytesAllocated() const;
+};
+
 namespace BSP
 {
 
@@ -127,10 +268,23 @@ inline bool IsInternalNode( int nodeIndex )
 	return nodeIndex > BSP_EMPTY_LEAF;
 }
 
-enum { BSP_MAX_NODES = MAX_UINT16-2 };	//-3 to account for BSP_SOLID_LEAF and BSP_EMPTY_LEAF
+// child types of frozen nodes
+enum EFrozenChild
+{
+	FROZEN_CHILD_NODE = 0,
+	FROZEN_CHILD_EMPTY = 1,
+	FROZEN_CHILD_SOLID = 2,
+};
+enum { FROZEN_MAX_NODES = (1U << 28) - 1 };
+
+// compares queries on the editable tree and its frozen version
+// with random points inside the bounds of the tree's polygons
+void RunQueryBenchmark( const BspTree& _tree, UINT32 _numPoints = 1<<16 );
+
+enum { BSP_MAX_NODES = (1<<23) };	// the ids are 32-bit, the limit is the max. capacity of TArray
 enum { BSP_MAX_DEPTH = 32 };	// size of temporary stack storage (we try to avoid recursion)
-enum { BSP_MAX_PLANES = MAX_UINT16-1 };	// maximum allowed number of planes in a single tree
-enum { BSP_MAX_POLYS = MAX_UINT16-1 };
+enum { BSP_MAX_PLANES = (1<<23) };	// maximum allowed number of planes in a single tree, the limit is the max. capacity of TArray
+enum { BSP_MAX_POLYS = (1<<23) };
 
 /*
 -----------------------------------------------------------------------------
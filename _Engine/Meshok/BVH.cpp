@@ -0,0 +1,633 @@
+// Bounding volume hierarchy over mesh triangles.
+#include "stdafx.h"
+#pragma hdrstop
+#include <Meshok/Meshok.h>
+#include <Meshok/BVH.h>
+#include <Meshok/Octree.h>	// ClosestPointOnTriangle()
+#include <Meshok/Parallel.h>
+
+BvhStats::BvhStats()
+{
+	mxZERO_OUT( *this );
+}
+void BvhStats::Print() const
+{
+	DBGOUT( "BVH: %u triangles, %u nodes, %u leaves, max depth: %u, built in %u usec\n",
+		numTriangles, numNodes, numLeaves, maxDepth, buildTime );
+}
+
+TriangleBVH::Settings::Settings()
+{
+	maxTrianglesPerLeaf = 4;
+	numBins = 16;
+}
+
+TriangleBVH::TriangleBVH()
+{
+}
+
+void TriangleBVH::Clear()
+{
+	m_nodes.Clear();
+	m_triangles.Clear();
+}
+
+/*
+-----------------------------------------------------------------------------
+	Construction.
+
+	The centroids of the triangles are binned along the longest axis
+	of the node's centroid bounds and the split between the bins
+	with the lowest surface area cost is chosen.
+-----------------------------------------------------------------------------
+*/
+namespace
+{
+	struct BuildPrimitive
+	{
+		Float3	aabbMin;
+		Float3	aabbMax;
+		Float3	centroid;
+	};
+
+	struct BuildContext
+	{
+		const TriangleBVH::Settings *	settings;
+		TArray< BuildPrimitive >		primitives;
+		TArray< UINT32 >				indices;	// primitive indices, partitioned in place
+		BvhStats *						stats;
+	};
+
+	// see MAX_TRAVERSAL_STACK
+	enum { MAX_SAH_DEPTH = 64 };
+
+	struct BuildBin
+	{
+		AABB24	bounds;
+		UINT32	count;
+	};
+
+	static inline float HalfArea( const AABB24& _bounds )
+	{
+		const Float3 size = _bounds.max_point - _bounds.min_point;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	static UINT32 BuildNode_R( BuildContext & _context, TriangleBVH & _tree, const UINT32 _first, const UINT32 _count, const UINT32 _depth )
+	{
+		const BuildPrimitive* primitives = _context.primitives.ToPtr();
+		UINT32 * indices = _context.indices.ToPtr();
+
+		AABB24	bounds;
+		AABB24	centroidBounds;
+		AABB24_Clear( &bounds );
+		AABB24_Clear( &centroidBounds );
+		for( UINT32 i = _first; i < _first + _count; i++ )
+		{
+			const BuildPrimitive& primitive = primitives[ indices[i] ];
+			bounds.min_point = Float3_Min( bounds.min_point, primitive.aabbMin );
+			bounds.max_point = Float3_Max( bounds.max_point, primitive.aabbMax );
+			AABB24_AddPoint( &centroidBounds, primitive.centroid );
+		}
+
+		const UINT32 nodeIndex = _tree.m_nodes.Num();
+		{
+			BvhNode & node = _tree.m_nodes.Add();
+			node.aabbMin = bounds.min_point;
+			node.aabbMax = bounds.max_point;
+			node.start = _first;
+			node.count = _count;
+		}
+
+		_context.stats->maxDepth = largest( _context.stats->maxDepth, _depth );
+
+		if( _count <= _context.settings->maxTrianglesPerLeaf ) {
+			_context.stats->numLeaves++;
+			return nodeIndex;
+		}
+
+		// find the longest axis of the centroid bounds
+		const Float3 centroidExtent = centroidBounds.max_point - centroidBounds.min_point;
+		int axis = 0;
+		if( centroidExtent.y > centroidExtent[axis] ) { axis = 1; }
+		if( centroidExtent.z > centroidExtent[axis] ) { axis = 2; }
+
+		UINT32 numLeft = _count / 2;	// fall back to the median split
+
+		// median splits below this depth keep the tree depth within the traversal stack size
+		if( centroidExtent[axis] > 1e-6f && _depth < MAX_SAH_DEPTH )
+		{
+			const UINT32 numBins = Clamp< UINT32 >( _context.settings->numBins, 2, TriangleBVH::MAX_BINS );
+
+			BuildBin	bins[ TriangleBVH::MAX_BINS ];
+			for( UINT32 iBin = 0; iBin < numBins; iBin++ ) {
+				AABB24_Clear( &bins[iBin].bounds );
+				bins[iBin].count = 0;
+			}
+
+			const float binMin = centroidBounds.min_point[axis];
+			const float binScale = numBins * (1.0f - 1e-4f) / centroidExtent[axis];
+
+			for( UINT32 i = _first; i < _first + _count; i++ )
+			{
+				const BuildPrimitive& primitive = primitives[ indices[i] ];
+				const UINT32 iBin = smallest( (UINT32)( (primitive.centroid[axis] - binMin) * binScale ), numBins - 1 );
+				bins[iBin].bounds.min_point = Float3_Min( bins[iBin].bounds.min_point, primitive.aabbMin );
+				bins[iBin].bounds.max_point = Float3_Max( bins[iBin].bounds.max_point, primitive.aabbMax );
+				bins[iBin].count++;
+			}
+
+			// sweep from the right to get the cost of the right side of each split
+			float	rightCosts[ TriangleBVH::MAX_BINS ];
+			{
+				AABB24	rightBounds;
+				AABB24_Clear( &rightBounds );
+				UINT32	rightCount = 0;
+				for( UINT32 iBin = numBins - 1; iBin > 0; iBin-- )
+				{
+					AABB24_AddAABB( &rightBounds, bins[iBin].bounds );
+					rightCount += bins[iBin].count;
+					rightCosts[iBin] = rightCount ? HalfArea( rightBounds ) * rightCount : 0.0f;
+				}
+			}
+
+			// sweep from the left and find the cheapest split (the split is between iBin-1 and iBin)
+			float	bestCost = BIG_NUMBER;
+			UINT32	bestSplit = 0;
+			{
+				AABB24	leftBounds;
+				AABB24_Clear( &leftBounds );
+				UINT32	leftCount = 0;
+				for( UINT32 iBin = 1; iBin < numBins; iBin++ )
+				{
+					AABB24_AddAABB( &leftBounds, bins[iBin-1].bounds );
+					leftCount += bins[iBin-1].count;
+					const float cost = (leftCount ? HalfArea( leftBounds ) * leftCount : 0.0f) + rightCosts[iBin];
+					if( leftCount && leftCount < _count && cost < bestCost ) {
+						bestCost = cost;
+						bestSplit = iBin;
+					}
+				}
+			}
+
+			if( bestSplit )
+			{
+				// partition the primitives
+				UINT32 i = _first;
+				UINT32 j = _first + _count;
+				while( i < j )
+				{
+					const BuildPrimitive& primitive = primitives[ indices[i] ];
+					const UINT32 iBin = smallest( (UINT32)( (primitive.centroid[axis] - binMin) * binScale ), numBins - 1 );
+					if( iBin < bestSplit ) {
+						i++;
+					} else {
+						TSwap( indices[i], indices[j-1] );
+						j--;
+					}
+				}
+				numLeft = i - _first;
+			}
+		}
+
+		if( numLeft == 0 || numLeft == _count ) {
+			numLeft = _count / 2;
+		}
+
+		// the left child immediately follows its parent
+		BuildNode_R( _context, _tree, _first, numLeft, _depth + 1 );
+		const UINT32 rightChild = BuildNode_R( _context, _tree, _first + numLeft, _count - numLeft, _depth + 1 );
+
+		BvhNode & node = _tree.m_nodes[ nodeIndex ];
+		node.start = rightChild;
+		node.count = 0;
+
+		return nodeIndex;
+	}
+}//namespace
+
+ERet TriangleBVH::Build( ATriangleMeshInterface* _mesh, const Settings& _settings, BvhStats *_stats )
+{
+	const UINT64 startTime = mxGetTimeInMicroseconds();
+
+	this->Clear();
+
+	struct CollectTriangles : ATriangleIndexCallback
+	{
+		TArray< BvhTriangle > &	m_triangles;
+		CollectTriangles( TArray< BvhTriangle > & _triangles ) : m_triangles( _triangles )
+		{}
+		virtual void ProcessTriangle( const Vertex& a, const Vertex& b, const Vertex& c ) override
+		{
+			BvhTriangle & triangle = m_triangles.Add();
+			triangle.v[0] = a.xyz;
+			triangle.v[1] = b.xyz;
+			triangle.v[2] = c.xyz;
+		}
+	};
+
+	TArray< BvhTriangle >	triangles;
+	CollectTriangles	callback( triangles );
+	_mesh->ProcessAllTriangles( &callback );
+
+	const UINT32 numTriangles = triangles.Num();
+	chkRET_X_IF_NOT(numTriangles > 0, ERR_INVALID_PARAMETER);
+
+	BvhStats	stats;
+	stats.numTriangles = numTriangles;
+
+	BuildContext	context;
+	context.settings = &_settings;
+	context.stats = &stats;
+	mxDO(context.primitives.SetNum( numTriangles ));
+	mxDO(context.indices.SetNum( numTriangles ));
+
+	for( UINT32 i = 0; i < numTriangles; i++ )
+	{
+		const BvhTriangle& triangle = triangles[i];
+		BuildPrimitive & primitive = context.primitives[i];
+		primitive.aabbMin = Float3_Min( Float3_Min( triangle.v[0], triangle.v[1] ), triangle.v[2] );
+		primitive.aabbMax = Float3_Max( Float3_Max( triangle.v[0], triangle.v[1] ), triangle.v[2] );
+		primitive.centroid = (triangle.v[0] + triangle.v[1] + triangle.v[2]) * (1.0f / 3.0f);
+		context.indices[i] = i;
+	}
+
+	// a binary tree with N leaves has 2N-1 nodes
+	mxDO(m_nodes.Reserve( (numTriangles / largest( _settings.maxTrianglesPerLeaf / 2, 1u )) * 2 + 1 ));
+
+	BuildNode_R( context, *this, 0, numTriangles, 0 );
+
+	// store the triangles in leaf order
+	mxDO(m_triangles.SetNum( numTriangles ));
+	for( UINT32 i = 0; i < numTriangles; i++ ) {
+		m_triangles[i] = triangles[ context.indices[i] ];
+	}
+
+	m_nodes.Shrink();
+
+	stats.numNodes = m_nodes.Num();
+	stats.buildTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+
+	if( _stats ) {
+		*_stats = stats;
+	}
+
+	return ALL_OK;
+}
+
+void TriangleBVH::GetBounds( AABB24 &_bounds ) const
+{
+	if( m_nodes.Num() ) {
+		_bounds.min_point = m_nodes[0].aabbMin;
+		_bounds.max_point = m_nodes[0].aabbMax;
+	} else {
+		AABB24_Clear( &_bounds );
+	}
+}
+
+size_t TriangleBVH::BytesAllocated() const
+{
+	return m_nodes.GetAllocatedMemory() + m_triangles.GetAllocatedMemory();
+}
+
+/*
+-----------------------------------------------------------------------------
+	Queries.
+
+	Box tests use SSE: the node's bounds are loaded directly from the node,
+	the fourth lanes (which hold the node's indices) are ignored.
+-----------------------------------------------------------------------------
+*/
+namespace
+{
+	// SAH splits are used up to MAX_SAH_DEPTH, deeper nodes are split at the median (at most 32 more levels)
+	enum { MAX_TRAVERSAL_STACK = 128 };
+
+	// returns the squared distance from the point to the node's bounding box (0 if inside)
+	static mxFORCEINLINE float BoxDistanceSquared( const BvhNode& _node, const __m128 _point )
+	{
+		const __m128 aabbMin = _mm_loadu_ps( &_node.aabbMin.x );
+		const __m128 aabbMax = _mm_loadu_ps( &_node.aabbMax.x );
+		const __m128 d = _mm_max_ps( _mm_max_ps( _mm_sub_ps( aabbMin, _point ), _mm_sub_ps( _point, aabbMax ) ), _mm_setzero_ps() );
+		const __m128 d2 = _mm_mul_ps( d, d );
+		const __m128 y = _mm_shuffle_ps( d2, d2, _MM_SHUFFLE(1,1,1,1) );
+		const __m128 z = _mm_shuffle_ps( d2, d2, _MM_SHUFFLE(2,2,2,2) );
+		return _mm_cvtss_f32( _mm_add_ss( _mm_add_ss( d2, y ), z ) );
+	}
+
+	// returns true if the ray (starting at the origin) intersects the node's bounding box
+	static mxFORCEINLINE bool RayIntersectsBox( const BvhNode& _node, const __m128 _origin, const __m128 _invDir )
+	{
+		const __m128 aabbMin = _mm_loadu_ps( &_node.aabbMin.x );
+		const __m128 aabbMax = _mm_loadu_ps( &_node.aabbMax.x );
+		const __m128 t0 = _mm_mul_ps( _mm_sub_ps( aabbMin, _origin ), _invDir );
+		const __m128 t1 = _mm_mul_ps( _mm_sub_ps( aabbMax, _origin ), _invDir );
+		const __m128 tMin = _mm_min_ps( t0, t1 );
+		const __m128 tMax = _mm_max_ps( t0, t1 );
+		// tNear = max( tMin.x, tMin.y, tMin.z, 0 ), tFar = min( tMax.x, tMax.y, tMax.z )
+		const __m128 tNear = _mm_max_ss( _mm_max_ss( _mm_max_ss( tMin, _mm_shuffle_ps( tMin, tMin, _MM_SHUFFLE(1,1,1,1) ) ), _mm_shuffle_ps( tMin, tMin, _MM_SHUFFLE(2,2,2,2) ) ), _mm_setzero_ps() );
+		const __m128 tFar = _mm_min_ss( _mm_min_ss( tMax, _mm_shuffle_ps( tMax, tMax, _MM_SHUFFLE(1,1,1,1) ) ), _mm_shuffle_ps( tMax, tMax, _MM_SHUFFLE(2,2,2,2) ) );
+		return _mm_comile_ss( tNear, tFar ) != 0;
+	}
+
+	static inline __m128 LoadFloat3( const Float3& _v )
+	{
+		return _mm_setr_ps( _v.x, _v.y, _v.z, 0.0f );
+	}
+
+	// Moller-Trumbore ray-triangle test, returns true if the ray crosses the triangle in front of the origin
+	static inline bool RayIntersectsTriangle( const Float3& _origin, const Float3& _direction, const BvhTriangle& _triangle )
+	{
+		const Float3 edge1 = _triangle.v[1] - _triangle.v[0];
+		const Float3 edge2 = _triangle.v[2] - _triangle.v[0];
+		const Float3 p = Float3_Cross( _direction, edge2 );
+		const float det = Float3_Dot( edge1, p );
+		if( fabsf( det ) < 1e-12f ) {
+			return false;	// the ray is parallel to the triangle
+		}
+		const float invDet = 1.0f / det;
+		const Float3 s = _origin - _triangle.v[0];
+		const float u = Float3_Dot( s, p ) * invDet;
+		if( u < 0.0f || u > 1.0f ) {
+			return false;
+		}
+		const Float3 q = Float3_Cross( s, edge1 );
+		const float v = Float3_Dot( _direction, q ) * invDet;
+		if( v < 0.0f || u + v > 1.0f ) {
+			return false;
+		}
+		const float t = Float3_Dot( edge2, q ) * invDet;
+		return t > 0.0f;
+	}
+}//namespace
+
+float TriangleBVH::ClosestPoint( const Float3& _position, float _maxDistance, Float3 *_closestPoint, UINT32 *_triangleIndex ) const
+{
+	if( !m_nodes.Num() ) {
+		return _maxDistance;
+	}
+
+	const BvhNode* nodes = m_nodes.ToPtr();
+	const BvhTriangle* triangles = m_triangles.ToPtr();
+	const __m128 point = LoadFloat3( _position );
+
+	float	bestDistanceSquared = _maxDistance * _maxDistance;
+	Float3	bestPoint = _position;
+	UINT32	bestTriangle = ~0;
+
+	// node indices and distances to their boxes
+	UINT32	stack[ MAX_TRAVERSAL_STACK ];
+	float	stackDistances[ MAX_TRAVERSAL_STACK ];
+	UINT32	stackTop = 0;
+
+	stack[0] = 0;
+	stackDistances[0] = BoxDistanceSquared( nodes[0], point );
+	stackTop = 1;
+
+	while( stackTop )
+	{
+		stackTop--;
+		if( stackDistances[ stackTop ] >= bestDistanceSquared ) {
+			continue;
+		}
+		const BvhNode& node = nodes[ stack[ stackTop ] ];
+
+		if( node.IsLeaf() )
+		{
+			for( UINT32 i = node.start; i < node.start + node.count; i++ )
+			{
+				const Float3 closest = ClosestPointOnTriangle( triangles[i].v, _position );
+				const float distanceSquared = Float3_LengthSquared( closest - _position );
+				if( distanceSquared < bestDistanceSquared ) {
+					bestDistanceSquared = distanceSquared;
+					bestPoint = closest;
+					bestTriangle = i;
+				}
+			}
+			continue;
+		}
+
+		const UINT32 left = stack[ stackTop ] + 1;
+		const UINT32 right = node.start;
+		const float leftDistance = BoxDistanceSquared( nodes[ left ], point );
+		const float rightDistance = BoxDistanceSquared( nodes[ right ], point );
+
+		mxASSERT( stackTop + 2 <= MAX_TRAVERSAL_STACK );
+
+		// push the farther child first so that the closer one is visited first
+		const bool leftIsCloser = (leftDistance <= rightDistance);
+		const UINT32 nearChild = leftIsCloser ? left : right;
+		const UINT32 farChild = leftIsCloser ? right : left;
+		const float nearDistance = leftIsCloser ? leftDistance : rightDistance;
+		const float farDistance = leftIsCloser ? rightDistance : leftDistance;
+
+		if( farDistance < bestDistanceSquared ) {
+			stack[ stackTop ] = farChild;
+			stackDistances[ stackTop ] = farDistance;
+			stackTop++;
+		}
+		if( nearDistance < bestDistanceSquared ) {
+			stack[ stackTop ] = nearChild;
+			stackDistances[ stackTop ] = nearDistance;
+			stackTop++;
+		}
+	}
+
+	if( bestTriangle == ~0 ) {
+		return _maxDistance;
+	}
+	if( _closestPoint ) {
+		*_closestPoint = bestPoint;
+	}
+	if( _triangleIndex ) {
+		*_triangleIndex = bestTriangle;
+	}
+	return sqrtf( bestDistanceSquared );
+}
+
+UINT32 TriangleBVH::CountIntersections( const Float3& _origin, const Float3& _direction ) const
+{
+	if( !m_nodes.Num() ) {
+		return 0;
+	}
+
+	const BvhNode* nodes = m_nodes.ToPtr();
+	const BvhTriangle* triangles = m_triangles.ToPtr();
+	const __m128 origin = LoadFloat3( _origin );
+	const __m128 invDir = _mm_div_ps( _mm_set1_ps( 1.0f ), LoadFloat3( _direction ) );
+
+	UINT32	numHits = 0;
+
+	UINT32	stack[ MAX_TRAVERSAL_STACK ];
+	UINT32	stackTop = 0;
+	stack[ stackTop++ ] = 0;
+
+	while( stackTop )
+	{
+		const UINT32 nodeIndex = stack[ --stackTop ];
+		const BvhNode& node = nodes[ nodeIndex ];
+
+		if( !RayIntersectsBox( node, origin, invDir ) ) {
+			continue;
+		}
+
+		if( node.IsLeaf() )
+		{
+			for( UINT32 i = node.start; i < node.start + node.count; i++ ) {
+				numHits += RayIntersectsTriangle( _origin, _direction, triangles[i] );
+			}
+			continue;
+		}
+
+		mxASSERT( stackTop + 2 <= MAX_TRAVERSAL_STACK );
+		stack[ stackTop++ ] = node.start;
+		stack[ stackTop++ ] = nodeIndex + 1;
+	}
+
+	return numHits;
+}
+
+bool TriangleBVH::PointInside( const Float3& _position ) const
+{
+	// the directions are not axis-aligned to avoid grazing axis-aligned faces and edges
+	static const Float3 directions[3] = {
+		{ 0.577350f, 0.577350f, 0.577350f },
+		{ -0.801784f, 0.267261f, 0.534522f },
+		{ 0.267261f, -0.534522f, -0.801784f },
+	};
+	int votes = 0;
+	for( int i = 0; i < mxCOUNT_OF(directions); i++ ) {
+		votes += (this->CountIntersections( _position, directions[i] ) & 1);
+	}
+	return votes >= 2;
+}
+
+MeshSDF::MeshSDF()
+{
+	bvh = nil;
+}
+
+float MeshSDF::GetDistanceAt( const Float3& _position ) const
+{
+	const float distance = bvh->ClosestPoint( _position, BIG_NUMBER );
+	return bvh->PointInside( _position ) ? -distance : distance;
+}
+
+void MeshSDF::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	Float3	previousPosition;
+	float	previousDistance = BIG_NUMBER;
+
+	for( UINT i = 0; i < _count; i++ )
+	{
+		const Float3& position = _positions[i];
+
+		// the closest point of the previous position is at most this far
+		float maxDistance = BIG_NUMBER;
+		if( i > 0 ) {
+			const float bound = previousDistance + Float3_Length( position - previousPosition );
+			maxDistance = bound * 1.001f + 1e-5f;
+		}
+
+		const float distance = bvh->ClosestPoint( position, maxDistance );
+
+		_distances[i] = bvh->PointInside( position ) ? -distance : distance;
+
+		previousPosition = position;
+		previousDistance = distance;
+	}
+}
+
+namespace Meshok
+{
+	struct BakeGridData
+	{
+		const MeshSDF *	sdf;
+		Float3			origin;		// the center of the first cell
+		Float3			cellSize;
+		UINT32			sizeX, sizeY;
+		float *			distances;
+	};
+
+	// computes a single slice (XY plane) of the grid
+	static void BakeGridSlice( UINT _z, UINT _threadIndex, void* _userData )
+	{
+		const BakeGridData& data = *static_cast< const BakeGridData* >( _userData );
+
+		Float3	positions[ AVolume::MAX_BATCH_SIZE ];
+
+		for( UINT32 y = 0; y < data.sizeY; y++ )
+		{
+			float * row = data.distances + (_z * data.sizeY + y) * data.sizeX;
+
+			for( UINT32 x0 = 0; x0 < data.sizeX; x0 += AVolume::MAX_BATCH_SIZE )
+			{
+				const UINT32 count = smallest( data.sizeX - x0, (UINT32)AVolume::MAX_BATCH_SIZE );
+				for( UINT32 i = 0; i < count; i++ ) {
+					positions[i] = data.origin + Float3_Set(
+						data.cellSize.x * (x0 + i),
+						data.cellSize.y * y,
+						data.cellSize.z * _z
+					);
+				}
+				data.sdf->GetDistancesAt( positions, row + x0, count );
+			}
+		}
+	}
+
+	ERet BakeDistanceGrid(
+		const TriangleBVH& _bvh,
+		const AABB24& _bounds,
+		const UINT32 _sizeX, const UINT32 _sizeY, const UINT32 _sizeZ,
+		float *_distances
+		)
+	{
+		chkRET_X_IF_NOT(_sizeX && _sizeY && _sizeZ, ERR_INVALID_PARAMETER);
+		chkRET_X_IF_NOT(!_bvh.IsEmpty(), ERR_INVALID_PARAMETER);
+
+		MeshSDF	sdf;
+		sdf.bvh = &_bvh;
+
+		const Float3 size = _bounds.max_point - _bounds.min_point;
+
+		BakeGridData	data;
+		data.sdf = &sdf;
+		data.cellSize = Float3_Set( size.x / _sizeX, size.y / _sizeY, size.z / _sizeZ );
+		data.origin = _bounds.min_point + data.cellSize * 0.5f;
+		data.sizeX = _sizeX;
+		data.sizeY = _sizeY;
+		data.distances = _distances;
+
+		Meshok::ParallelFor( _sizeZ, &BakeGridSlice, &data );
+
+		return ALL_OK;
+	}
+
+	ERet BakeDistanceGrid(
+		const TcMeshData& _mesh,
+		const UINT32 _sizeX, const UINT32 _sizeY, const UINT32 _sizeZ,
+		const float _margin,
+		AABB24 &_bounds,
+		TArray< float > &_distances,
+		BvhStats *_stats
+		)
+	{
+		ProcessMeshDataTriangles	triangles( _mesh );
+
+		TriangleBVH	bvh;
+		mxDO(bvh.Build( &triangles, TriangleBVH::Settings(), _stats ));
+
+		bvh.GetBounds( _bounds );
+		_bounds.min_point -= Float3_Replicate( _margin );
+		_bounds.max_point += Float3_Replicate( _margin );
+
+		mxDO(_distances.SetNum( _sizeX * _sizeY * _sizeZ ));
+		mxDO(BakeDistanceGrid( bvh, _bounds, _sizeX, _sizeY, _sizeZ, _distances.ToPtr() ));
+
+		return ALL_OK;
+	}
+}//namespace Meshok
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,134 @@
+/*
+=============================================================================
+	File:	BVH.h
+	Desc:	Bounding volume hierarchy over mesh triangles
+	for closest point and inside/outside queries (e.g. for converting meshes into distance fields).
+	The tree is built with the (binned) surface area heuristic and stored
+	in a flat array in depth-first order: the left child immediately follows its parent.
+	References:
+	"On fast Construction of SAH-based Bounding Volume Hierarchies" [Ingo Wald, 2007]
+=============================================================================
+*/
+#pragma once
+
+#include <Meshok/Meshok.h>
+#include <Meshok/SDF.h>
+
+struct BvhNode
+{
+	Float3	aabbMin;
+	UINT32	start;	// internal node: index of the right child, leaf: index of the first triangle
+	Float3	aabbMax;
+	UINT32	count;	// number of triangles in the leaf, 0 if this is an internal node
+public:
+	bool IsLeaf() const { return count != 0; }
+};
+mxSTATIC_ASSERT( sizeof(BvhNode) == 32 );
+
+struct BvhTriangle
+{
+	Float3	v[3];
+};
+
+struct BvhStats
+{
+	UINT32	numNodes;
+	UINT32	numLeaves;
+	UINT32	numTriangles;
+	UINT32	maxDepth;
+	UINT32	buildTime;	// in microseconds
+public:
+	BvhStats();
+	void Print() const;
+};
+
+struct TriangleBVH
+{
+	TArray< BvhNode >		m_nodes;	// m_nodes[0] is the root
+	TArray< BvhTriangle >	m_triangles;// sorted so that each leaf references a contiguous range
+
+public:
+	struct Settings
+	{
+		UINT32	maxTrianglesPerLeaf;
+		UINT32	numBins;	// the number of SAH bins per node (<= MAX_BINS)
+	public:
+		Settings();
+	};
+	enum { MAX_BINS = 32 };
+
+	TriangleBVH();
+
+	// doesn't print anything, the statistics are returned in _stats (see BvhStats::Print())
+	ERet Build(
+		ATriangleMeshInterface* _mesh,
+		const Settings& _settings = Settings(),
+		BvhStats *_stats = nil
+	);
+
+	void Clear();
+
+	bool IsEmpty() const { return m_nodes.Num() == 0; }
+
+	// returns the bounds of the whole mesh
+	void GetBounds( AABB24 &_bounds ) const;
+
+	// returns the (unsigned) distance to the closest point on the mesh,
+	// or _maxDistance if no triangle is closer than _maxDistance
+	float ClosestPoint(
+		const Float3& _position,
+		float _maxDistance,
+		Float3 *_closestPoint = nil,
+		UINT32 *_triangleIndex = nil
+	) const;
+
+	// returns the number of triangles crossed by the ray
+	UINT32 CountIntersections( const Float3& _origin, const Float3& _direction ) const;
+
+	// ray parity test: the point is inside the (closed) mesh if rays from the point cross the surface an odd number of times;
+	// three rays are cast and the majority wins to be more robust against small holes and rays grazing edges
+	bool PointInside( const Float3& _position ) const;
+
+	size_t BytesAllocated() const;
+
+	PREVENT_COPY(TriangleBVH);
+};
+
+// signed distance to a closed triangle mesh (negative inside)
+struct MeshSDF : AVolume
+{
+	TPtr< const TriangleBVH >	bvh;
+public:
+	MeshSDF();
+	virtual float GetDistanceAt( const Float3& _position ) const override;
+	// the distance to the previous point bounds the search for the next point,
+	// so coherent batches (e.g. grid rows) are much faster than random points
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
+};
+
+namespace Meshok
+{
+	// samples the signed distance to the mesh at the centers of the grid cells on all CPU cores;
+	// _distances - _sizeX * _sizeY * _sizeZ floats, X changes fastest
+	ERet BakeDistanceGrid(
+		const TriangleBVH& _bvh,
+		const AABB24& _bounds,
+		const UINT32 _sizeX, const UINT32 _sizeY, const UINT32 _sizeZ,
+		float *_distances
+	);
+
+	// converts the mesh into a dense distance grid covering its bounds (plus the given margin);
+	// _stats - optional statistics of the BVH built over the mesh
+	ERet BakeDistanceGrid(
+		const TcMeshData& _mesh,
+		const UINT32 _sizeX, const UINT32 _sizeY, const UINT32 _sizeZ,
+		const float _margin,
+		AABB24 &_bounds,
+		TArray< float > &_distances,
+		BvhStats *_stats = nil
+	);
+}//namespace Meshok
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,623 @@
+/*
+=============================================================================
+	File:	DualContouring.cpp
+	Desc:	Adaptive dual contouring over ASDF octrees.
+=============================================================================
+*/
+#include "stdafx.h"
+#pragma hdrstop
+#include <Meshok/Meshok.h>
+#include <Meshok/Octree.h>
+#include <Meshok/DualContouring.h>
+#include <Meshok/marching_cubes.h>
+
+namespace DualContouring
+{
+
+using namespace ASDF;
+
+Options::Options()
+{
+	svdThreshold = 0.1f;
+	clampVertices = true;
+}
+
+DC_Stats::DC_Stats()
+{
+	mxZERO_OUT( *this );
+}
+void DC_Stats::Print( UINT32 elapsedTimeMSec )
+{
+	DBGOUT( "\n=== Dual Contouring statistics ========\n" );
+	DBGOUT( "Leaves: %u, cells with vertices: %u (%u clamped)\n", m_numLeaves, m_numVertices, m_numClampedVertices );
+	DBGOUT( "Quads: %u, triangles: %u\n", m_numQuads, m_numPolygons );
+	DBGOUT( "Contouring: %u usec, total time: %u msec\n", m_elapsedTime, elapsedTimeMSec );
+	DBGOUT( "==== End ====================\n" );
+}
+
+//=====================================================================
+//	QUADRATIC ERROR FUNCTION
+//=====================================================================
+
+// computes eigenvalues and eigenvectors (columns of V) of a symmetric 3x3 matrix using Jacobi rotations
+static void SymmetricEigen3x3( const float _A[3][3], float _eigenvalues[3], float V[3][3] )
+{
+	float a[3][3];
+	for( int i = 0; i < 3; i++ ) {
+		for( int j = 0; j < 3; j++ ) {
+			a[i][j] = _A[i][j];
+			V[i][j] = (i == j) ? 1.0f : 0.0f;
+		}
+	}
+
+	static const int pairs[3][2] = { {0,1}, {0,2}, {1,2} };
+
+	for( int sweep = 0; sweep < 8; sweep++ )
+	{
+		const float offDiagonal = a[0][1]*a[0][1] + a[0][2]*a[0][2] + a[1][2]*a[1][2];
+		if( offDiagonal < 1e-12f ) {
+			break;
+		}
+		for( int iPair = 0; iPair < 3; iPair++ )
+		{
+			const int p = pairs[iPair][0];
+			const int q = pairs[iPair][1];
+			if( fabsf( a[p][q] ) < 1e-12f ) {
+				continue;
+			}
+			const float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+			const float t = ((theta >= 0.0f) ? 1.0f : -1.0f) / (fabsf(theta) + sqrtf(theta*theta + 1.0f));
+			const float c = 1.0f / sqrtf(t*t + 1.0f);
+			const float s = t * c;
+			// A' = J^T * A * J
+			for( int k = 0; k < 3; k++ ) {
+				const float akp = a[k][p], akq = a[k][q];
+				a[k][p] = c * akp - s * akq;
+				a[k][q] = s * akp + c * akq;
+			}
+			for( int k = 0; k < 3; k++ ) {
+				const float apk = a[p][k], aqk = a[q][k];
+				a[p][k] = c * apk - s * aqk;
+				a[q][k] = s * apk + c * aqk;
+			}
+			// V' = V * J
+			for( int k = 0; k < 3; k++ ) {
+				const float vkp = V[k][p], vkq = V[k][q];
+				V[k][p] = c * vkp - s * vkq;
+				V[k][q] = s * vkp + c * vkq;
+			}
+		}
+	}
+
+	_eigenvalues[0] = a[0][0];
+	_eigenvalues[1] = a[1][1];
+	_eigenvalues[2] = a[2][2];
+}
+
+// accumulates the squared distances to the tangent planes at edge intersection points
+struct QEF
+{
+	float	ATA[3][3];	// sum of n * n^T
+	Float3	ATb;		// sum of n * dot(n, p)
+	Float3	massPoint;	// sum of the intersection points
+	int		numPoints;
+public:
+	QEF()
+	{
+		mxZERO_OUT( *this );
+	}
+	void Add( const Float3& _point, const Float3& _normal )
+	{
+		const float n[3] = { _normal.x, _normal.y, _normal.z };
+		for( int i = 0; i < 3; i++ ) {
+			for( int j = 0; j < 3; j++ ) {
+				ATA[i][j] += n[i] * n[j];
+			}
+		}
+		ATb += _normal * Float3_Dot( _normal, _point );
+		massPoint += _point;
+		numPoints++;
+	}
+	// minimizes the error using the pseudo-inverse (small eigenvalues are truncated),
+	// the solution is biased towards the mass point
+	Float3 Solve( float _svdThreshold ) const
+	{
+		mxASSERT( numPoints > 0 );
+		const Float3 center = massPoint / (float)numPoints;
+
+		// solve ATA * y = ATb - ATA * center, x = center + y
+		float r[3];
+		for( int i = 0; i < 3; i++ ) {
+			r[i] = ATb[i] - (ATA[i][0] * center.x + ATA[i][1] * center.y + ATA[i][2] * center.z);
+		}
+
+		float	eigenvalues[3];
+		float	V[3][3];
+		SymmetricEigen3x3( ATA, eigenvalues, V );
+
+		const float maxEigenvalue = Max( Max( fabsf(eigenvalues[0]), fabsf(eigenvalues[1]) ), fabsf(eigenvalues[2]) );
+		const float minEigenvalue = maxEigenvalue * _svdThreshold;
+
+		// y = V * inverse(D) * V^T * r
+		Float3 y = Float3_Zero();
+		for( int k = 0; k < 3; k++ )
+		{
+			if( fabsf( eigenvalues[k] ) <= minEigenvalue || eigenvalues[k] == 0.0f ) {
+				continue;
+			}
+			const float projection = (V[0][k] * r[0] + V[1][k] * r[1] + V[2][k] * r[2]) / eigenvalues[k];
+			y.x += V[0][k] * projection;
+			y.y += V[1][k] * projection;
+			y.z += V[2][k] * projection;
+		}
+		return center + y;
+	}
+};
+
+//=====================================================================
+//	OCTREE TRAVERSAL
+//=====================================================================
+
+// octree node with its bounds
+struct DC_Cell
+{
+	NodeID		id;
+	OctCubeF	bounds;
+};
+
+struct DC_Context
+{
+	const Octree *	tree;
+	const AVolume *	surface;
+	Options			options;
+	TArray< INT32 >	leafVertex;	// vertex index for each leaf or -1
+	TArray< DrawVertex >	vertices;
+	TArray< UINT32 >		indices;
+	DC_Stats		stats;
+};
+
+static inline bool DC_IsLeaf( const DC_Cell& _cell ) {
+	return IS_LEAF_ID( _cell.id );
+}
+// leaves are treated as their own children, so that cells of different sizes can be processed uniformly
+static inline DC_Cell DC_GetChild( const DC_Context& _context, const DC_Cell& _cell, int _childIndex )
+{
+	if( DC_IsLeaf( _cell ) ) {
+		return _cell;
+	}
+	const Node& node = _context.tree->m_nodes[ _cell.id ];
+	DC_Cell	child;
+	child.id = node.kids[ _childIndex ];
+	child.bounds = GetChildOctant( _cell.bounds, _childIndex );
+	return child;
+}
+static inline INT32 DC_GetVertex( const DC_Context& _context, const DC_Cell& _cell )
+{
+	mxASSERT( DC_IsLeaf( _cell ) );
+	return ( _cell.id == NIL_NODE ) ? -1 : _context.leafVertex[ GET_ID( _cell.id ) ];
+}
+
+// gradient of the trilinear interpolant at the given point of the leaf
+static Float3 DC_LeafGradient( const Leaf& _leaf, const OctCubeF& _bounds, const Float3& _point )
+{
+	const float size = _bounds.radius * 2.0f;
+	const float u = Clamp( (_point.x - (_bounds.x - _bounds.radius)) / size, 0.0f, 1.0f );
+	const float v = Clamp( (_point.y - (_bounds.y - _bounds.radius)) / size, 0.0f, 1.0f );
+	const float w = Clamp( (_point.z - (_bounds.z - _bounds.radius)) / size, 0.0f, 1.0f );
+	const float* d = _leaf.d;
+	Float3 g;
+	g.x = (1-v)*(1-w)*(d[1]-d[0]) + v*(1-w)*(d[3]-d[2]) + (1-v)*w*(d[5]-d[4]) + v*w*(d[7]-d[6]);
+	g.y = (1-u)*(1-w)*(d[2]-d[0]) + u*(1-w)*(d[3]-d[1]) + (1-u)*w*(d[6]-d[4]) + u*w*(d[7]-d[5]);
+	g.z = (1-u)*(1-v)*(d[4]-d[0]) + u*(1-v)*(d[5]-d[1]) + (1-u)*v*(d[6]-d[2]) + u*v*(d[7]-d[3]);
+	return g / size;
+}
+
+// places a vertex in each leaf which contains the surface
+static void DC_CreateVertices_R( DC_Context & _context, const DC_Cell& _cell )
+{
+	if( !DC_IsLeaf( _cell ) )
+	{
+		for( int i = 0; i < 8; i++ ) {
+			DC_CreateVertices_R( _context, DC_GetChild( _context, _cell, i ) );
+		}
+		return;
+	}
+	if( _cell.id == NIL_NODE ) {
+		return;
+	}
+
+	_context.stats.m_numLeaves++;
+
+	const UINT32 leafIndex = GET_ID( _cell.id );
+	const Leaf& leaf = _context.tree->m_leaves[ leafIndex ];
+
+	int signs = 0;
+	for( int i = 0; i < 8; i++ ) {
+		if( AVolume::IsSolid( leaf.d[i] ) ) {
+			signs |= (1 << i);
+		}
+	}
+	if( signs == 0 || signs == 0xFF ) {
+		return;	// the cell doesn't contain the surface
+	}
+
+	Float3 corners[8];
+	OCT_GetCorners( _cell.bounds, corners );
+
+	// find intersection points on the 12 edges
+	QEF		qef;
+	Float3	averageNormal = Float3_Zero();
+	for( int i = 0; i < 8; i++ )
+	{
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			if( i & BIT(axis) ) {
+				continue;
+			}
+			const int j = i | BIT(axis);
+			const bool solid0 = (signs & (1 << i)) != 0;
+			const bool solid1 = (signs & (1 << j)) != 0;
+			if( solid0 == solid1 ) {
+				continue;
+			}
+			const float d0 = leaf.d[i];
+			const float d1 = leaf.d[j];
+			const float t = d0 / (d0 - d1);
+			const Float3 point = corners[i] + (corners[j] - corners[i]) * t;
+			const Float3 normal = _context.surface
+				? _context.surface->GetNormalAt( point )
+				: Float3_Normalized( DC_LeafGradient( leaf, _cell.bounds, point ) );
+			qef.Add( point, normal );
+			averageNormal += normal;
+		}
+	}
+
+	Float3 position = qef.Solve( _context.options.svdThreshold );
+
+	if( _context.options.clampVertices )
+	{
+		AABB24 aabb;
+		OctBoundsToAABB( _cell.bounds, aabb );
+		if( !AABB_ContainsPoint( aabb, position ) )
+		{
+			// the solution is outside the cell - fall back to the mass point
+			position = qef.massPoint / (float)qef.numPoints;
+			_context.stats.m_numClampedVertices++;
+		}
+	}
+
+	const Float3 normal = _context.surface
+		? _context.surface->GetNormalAt( position )
+		: Float3_Normalized( averageNormal );
+
+	DrawVertex	vertex;
+	mxZERO_OUT( vertex );
+	vertex.xyz = position;
+	vertex.N = PackNormal( normal );
+
+	_context.leafVertex[ leafIndex ] = _context.vertices.Num();
+	_context.vertices.Add( vertex );
+}
+
+// Edge enumeration: an edge parallel to the axis 'e' is shared by four cells,
+// which are indexed by (bp | bq << 1), where p = (e+1)%3, q = (e+2)%3
+// and bp/bq = 0 if the cell lies on the negative side of the edge along p/q.
+
+// processes a minimal edge shared by four leaves and emits a quad
+static void DC_ProcessEdge( DC_Context & _context, const DC_Cell (&_cells)[4], int e )
+{
+	const int p = (e + 1) % 3;
+	const int q = (e + 2) % 3;
+
+	// the edge is taken from the smallest cell (it's a subset of edges of larger cells)
+	int minCell = -1;
+	float minRadius = BIG_NUMBER;
+	INT32 vertices[4];
+	for( int k = 0; k < 4; k++ )
+	{
+		vertices[k] = DC_GetVertex( _context, _cells[k] );
+		if( vertices[k] < 0 ) {
+			return;
+		}
+		if( _cells[k].bounds.radius < minRadius ) {
+			minRadius = _cells[k].bounds.radius;
+			minCell = k;
+		}
+	}
+
+	const int bp = minCell & 1;
+	const int bq = (minCell >> 1) & 1;
+	const int c0 = ((1 - bp) << p) | ((1 - bq) << q);
+	const int c1 = c0 | (1 << e);
+	const Leaf& leaf = _context.tree->m_leaves[ GET_ID( _cells[ minCell ].id ) ];
+	const bool solid0 = AVolume::IsSolid( leaf.d[c0] );
+	const bool solid1 = AVolume::IsSolid( leaf.d[c1] );
+	if( solid0 == solid1 ) {
+		return;
+	}
+
+	// (0,1,3,2) goes counter-clockwise when viewed from the positive end of the edge;
+	// front faces are counter-clockwise when viewed from outside (the same winding as MarchingCubes)
+	int quad[4];
+	if( solid0 ) {
+		// the surface faces towards +e
+		quad[0] = vertices[0]; quad[1] = vertices[1]; quad[2] = vertices[3]; quad[3] = vertices[2];
+	} else {
+		quad[0] = vertices[0]; quad[1] = vertices[2]; quad[2] = vertices[3]; quad[3] = vertices[1];
+	}
+
+	_context.stats.m_numQuads++;
+
+	// skip degenerate triangles (a large cell can occupy several slots around the edge)
+	const int triangles[2][3] = { { quad[0], quad[1], quad[2] }, { quad[0], quad[2], quad[3] } };
+	for( int i = 0; i < 2; i++ )
+	{
+		const int* t = triangles[i];
+		if( t[0] != t[1] && t[1] != t[2] && t[2] != t[0] ) {
+			_context.indices.Add( t[0] );
+			_context.indices.Add( t[1] );
+			_context.indices.Add( t[2] );
+		}
+	}
+}
+
+static void DC_EdgeProc_R( DC_Context & _context, const DC_Cell (&_cells)[4], int e )
+{
+	if( DC_IsLeaf( _cells[0] ) && DC_IsLeaf( _cells[1] ) && DC_IsLeaf( _cells[2] ) && DC_IsLeaf( _cells[3] ) )
+	{
+		DC_ProcessEdge( _context, _cells, e );
+		return;
+	}
+
+	const int p = (e + 1) % 3;
+	const int q = (e + 2) % 3;
+
+	// split the edge in two halves
+	for( int be = 0; be < 2; be++ )
+	{
+		DC_Cell	subCells[4];
+		for( int k = 0; k < 4; k++ )
+		{
+			const int bp = k & 1;
+			const int bq = (k >> 1) & 1;
+			const int childIndex = (be << e) | ((1 - bp) << p) | ((1 - bq) << q);
+			subCells[k] = DC_GetChild( _context, _cells[k], childIndex );
+		}
+		DC_EdgeProc_R( _context, subCells, e );
+	}
+}
+
+// processes the face between two cells, _cells[0] lies on the negative side along the axis 'a'
+static void DC_FaceProc_R( DC_Context & _context, const DC_Cell (&_cells)[2], int a )
+{
+	if( DC_IsLeaf( _cells[0] ) && DC_IsLeaf( _cells[1] ) ) {
+		return;
+	}
+
+	const int u = (a + 1) % 3;
+	const int v = (a + 2) % 3;
+
+	// four sub-faces
+	for( int bu = 0; bu < 2; bu++ )
+	{
+		for( int bv = 0; bv < 2; bv++ )
+		{
+			DC_Cell	subCells[2];
+			subCells[0] = DC_GetChild( _context, _cells[0], (1 << a) | (bu << u) | (bv << v) );
+			subCells[1] = DC_GetChild( _context, _cells[1], (bu << u) | (bv << v) );
+			DC_FaceProc_R( _context, subCells, a );
+		}
+	}
+
+	// four edges lying in the face plane: two parallel to each of the other axes
+	const int edgeAxes[2] = { u, v };
+	for( int iEdgeAxis = 0; iEdgeAxis < 2; iEdgeAxis++ )
+	{
+		const int e = edgeAxes[ iEdgeAxis ];
+		const int w = (e == u) ? v : u;	// the remaining axis
+		const int p = (e + 1) % 3;
+		const int q = (e + 2) % 3;
+		for( int be = 0; be < 2; be++ )
+		{
+			DC_Cell	edgeCells[4];
+			for( int k = 0; k < 4; k++ )
+			{
+				int b[3];
+				b[p] = k & 1;
+				b[q] = (k >> 1) & 1;
+				// b[a] selects the node (the face lies on the boundary of both nodes),
+				// b[w] selects the child (the edge passes through the middle of the face)
+				const int node = b[a];
+				const int childIndex = (be << e) | ((1 - b[a]) << a) | (b[w] << w);
+				edgeCells[k] = DC_GetChild( _context, _cells[ node ], childIndex );
+			}
+			DC_EdgeProc_R( _context, edgeCells, e );
+		}
+	}
+}
+
+static void DC_CellProc_R( DC_Context & _context, const DC_Cell& _cell )
+{
+	if( DC_IsLeaf( _cell ) ) {
+		return;
+	}
+
+	DC_Cell	children[8];
+	for( int i = 0; i < 8; i++ )
+	{
+		children[i] = DC_GetChild( _context, _cell, i );
+		DC_CellProc_R( _context, children[i] );
+	}
+
+	for( int a = 0; a < 3; a++ )
+	{
+		// four internal faces perpendicular to the axis 'a'
+		for( int i = 0; i < 8; i++ )
+		{
+			if( i & BIT(a) ) {
+				continue;
+			}
+			const DC_Cell faceCells[2] = { children[i], children[ i | BIT(a) ] };
+			DC_FaceProc_R( _context, faceCells, a );
+		}
+
+		// two internal edges parallel to the axis 'a'
+		const int p = (a + 1) % 3;
+		const int q = (a + 2) % 3;
+		for( int be = 0; be < 2; be++ )
+		{
+			DC_Cell	edgeCells[4];
+			for( int k = 0; k < 4; k++ )
+			{
+				const int bp = k & 1;
+				const int bq = (k >> 1) & 1;
+				edgeCells[k] = children[ (be << a) | (bp << p) | (bq << q) ];
+			}
+			DC_EdgeProc_R( _context, edgeCells, a );
+		}
+	}
+}
+
+ERet Contour(
+	const ASDF::Octree& _tree, float _radius,
+	const AVolume* _surface,
+	AMeshBuilder& _mesh,
+	const Options& _options,
+	DC_Stats* _stats
+	)
+{
+	const UINT64 startTime = mxGetTimeInMicroseconds();
+
+	DC_Context	context;
+	context.tree = &_tree;
+	context.surface = _surface;
+	context.options = _options;
+
+	const UINT32 numLeaves = _tree.m_leaves.Num();
+	if( !numLeaves || _tree.m_root == NIL_NODE ) {
+		return ALL_OK;
+	}
+	mxDO(context.leafVertex.SetNum( numLeaves ));
+	memset( context.leafVertex.ToPtr(), -1, numLeaves * sizeof(INT32) );
+
+	DC_Cell	root;
+	root.id = _tree.m_root;
+	root.bounds.x = 0;
+	root.bounds.y = 0;
+	root.bounds.z = 0;
+	root.bounds.radius = _radius;
+
+	DC_CreateVertices_R( context, root );
+	DC_CellProc_R( context, root );
+
+	TArray< int >	remap;
+	mxDO(remap.SetNum( context.vertices.Num() ));
+	for( UINT32 i = 0; i < context.vertices.Num(); i++ ) {
+		remap[i] = _mesh.AddVertex( context.vertices[i] );
+	}
+	for( UINT32 i = 0; i < context.indices.Num(); i += 3 ) {
+		_mesh.AddTriangle( remap[ context.indices[i] ], remap[ context.indices[i+1] ], remap[ context.indices[i+2] ] );
+	}
+
+	context.stats.m_numVertices = context.vertices.Num();
+	context.stats.m_numPolygons = context.indices.Num() / 3;
+	context.stats.m_elapsedTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+	if( _stats ) {
+		*_stats = context.stats;
+	}
+	return ALL_OK;
+}
+
+//=====================================================================
+//	BENCHMARK
+//=====================================================================
+
+// doesn't store anything, only counts primitives
+struct CountingMeshBuilder : AMeshBuilder
+{
+	int	numVertices;
+	int	numTriangles;
+public:
+	CountingMeshBuilder() { numVertices = numTriangles = 0; }
+	virtual ERet Begin() override { numVertices = numTriangles = 0; return ALL_OK; }
+	virtual int AddVertex( const DrawVertex& vertex ) override { return numVertices++; }
+	virtual int AddTriangle( int v1, int v2, int v3 ) override { return numTriangles++; }
+	virtual ERet End( int &verts, int &tris ) override { verts = numVertices; tris = numTriangles; return ALL_OK; }
+};
+
+static ERet BenchmarkVolume( const char* _name, AVolume* _volume, float _radius, int _maxDepth )
+{
+	// marching cubes at the finest octree resolution
+	const int gridSize = 1 << _maxDepth;
+	const Float3 aabbMin = Float3_Replicate( -_radius );
+	const Float3 aabbMax = Float3_Replicate( +_radius );
+
+	CountingMeshBuilder	mcMesh;
+	MarchingCubes::MC_Stats	mcStats;
+	const UINT64 mcStartTime = mxGetTimeInMicroseconds();
+	MarchingCubes::Triangulate( _volume, aabbMin, aabbMax, gridSize, gridSize, gridSize, mcMesh, &mcStats );
+	const UINT64 mcTime = mxGetTimeInMicroseconds() - mcStartTime;
+
+	// dual contouring, including the octree construction
+	ASDF::Options	asdfOptions;
+	asdfOptions.radius = _radius;
+	asdfOptions.max_depth = _maxDepth;
+
+	ASDF::Octree	octree;
+	ASDF::PerfStats	asdfStats;
+	mxDO(octree.Build( _volume, asdfOptions, &asdfStats ));
+	const UINT32 buildTime = asdfStats.buildTime;
+
+	CountingMeshBuilder	dcMesh;
+	DC_Stats	dcStats;
+	mxDO(Contour( octree, _radius, _volume, dcMesh, Options(), &dcStats ));
+
+	ptPRINT( "%s (%d^3): MC: %u tris, %u verts, %u usec | DC: %u tris, %u verts, %u usec (+ %u usec octree build)\n",
+		_name, gridSize,
+		mcStats.m_numPolygons, mcStats.m_numVertices, (UINT32)mcTime,
+		dcStats.m_numPolygons, dcStats.m_numVertices, dcStats.m_elapsedTime, buildTime
+		);
+
+	octree.Clear();
+
+	return ALL_OK;
+}
+
+ERet RunBenchmark( int _maxDepth )
+{
+	const float radius = 2.0f;
+
+	SphereSDF	sphere;
+	sphere.radius = 1.0f;
+
+	AxisAlignedBoxSDF	box;
+	box.size = Float3_Replicate( 0.7f );
+
+	TorusSDF	torus;
+	torus.T = Float2_Set( 1.0f, 0.3f );
+
+	HalfSpaceSDF	halfSpace;
+	halfSpace.plane = Float4_Set( 0.0f, 0.0f, 1.0f, 0.1f );
+
+	CSGSubtraction	boxMinusSphere;
+	SphereSDF		smallSphere;
+	smallSphere.radius = 0.9f;
+	boxMinusSphere.opA = &box;
+	boxMinusSphere.opB = &smallSphere;
+
+	ptPRINT( "\n=== Dual Contouring vs Marching Cubes ========\n" );
+	mxDO(BenchmarkVolume( "Sphere", &sphere, radius, _maxDepth ));
+	mxDO(BenchmarkVolume( "Box", &box, radius, _maxDepth ));
+	mxDO(BenchmarkVolume( "Torus", &torus, radius, _maxDepth ));
+	mxDO(BenchmarkVolume( "HalfSpace", &halfSpace, radius, _maxDepth ));
+	mxDO(BenchmarkVolume( "Box - Sphere", &boxMinusSphere, radius, _maxDepth ));
+	ptPRINT( "==== End ====================\n" );
+
+	return ALL_OK;
+}
+
+}//namespace DualContouring
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
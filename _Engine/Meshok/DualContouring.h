@@ -0,0 +1,66 @@
+/*
+=============================================================================
+	File:	DualContouring.h
+	Desc:	Adaptive dual contouring over ASDF octrees.
+	Places one QEF-minimizing vertex inside each leaf cell that contains
+	the surface and connects the vertices of cells sharing a sign-changing
+	edge with quads. Reproduces sharp features and produces far fewer
+	triangles than marching cubes at the same resolution.
+	References:
+	"Dual Contouring of Hermite Data" [Ju, Losasso, Schaefer, Warren, 2002]
+	NOTE: Octree3 (VoxelEngine.h) is not supported, because its builder is disabled.
+=============================================================================
+*/
+#pragma once
+
+#include <Meshok/Meshok.h>
+#include <Meshok/SDF.h>
+#include <Meshok/ASDF.h>
+
+namespace DualContouring
+{
+	struct Options
+	{
+		// eigenvalues of the QEF matrix smaller than (threshold * largest eigenvalue) are truncated
+		// (0 - always use the exact solution, 1 - always use the mass point)
+		float	svdThreshold;
+		// if true, vertices are clamped to the bounds of their cells
+		bool	clampVertices;
+	public:
+		Options();
+	};
+
+	class DC_Stats {
+	public:
+		UINT32		m_numLeaves;	// number of visited leaf cells
+		UINT32		m_numVertices;	// number of cells containing the surface
+		UINT32		m_numQuads;		// number of generated quads
+		UINT32		m_numPolygons;	// number of resulting triangles
+		UINT32		m_numClampedVertices;	// QEF solutions which were outside their cells
+		UINT32		m_elapsedTime;	// in microseconds
+	public:
+		DC_Stats();
+		void Print( UINT32 elapsedTimeMSec );
+	};
+
+	// extracts the surface from the given octree;
+	// _radius - the half size of the octree's root cube (see ASDF::Options),
+	// _surface - (optional) the source volume used for computing exact normals,
+	// if nil, normals are derived from the trilinear interpolant inside each leaf.
+	ERet Contour(
+		const ASDF::Octree& _tree, float _radius,
+		const AVolume* _surface,
+		AMeshBuilder& _mesh,
+		const Options& _options = Options(),
+		DC_Stats* _stats = nil
+	);
+
+	// builds ASDF octrees for the primitives in SDF.h and compares
+	// triangle counts and build times with MarchingCubes::Triangulate() at the same resolution
+	ERet RunBenchmark( int _maxDepth = 6 );
+
+}//namespace DualContouring
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -389,9 +389,13 @@ public:
 				a.xyz = mesh.positions[tri[0]];
 				b.xyz = mesh.positions[tri[1]];
 				c.xyz = mesh.positions[tri[2]];
-				a.st = mesh.texCoords[tri[0]];
-				b.st = mesh.texCoords[tri[1]];
-				c.st = mesh.texCoords[tri[2]];
+				if( mesh.texCoords.Num() ) {
+					a.st = mesh.texCoords[tri[0]];
+					b.st = mesh.texCoords[tri[1]];
+					c.st = mesh.texCoords[tri[2]];
+				} else {
+					a.st = b.st = c.st = Float2_Zero();
+				}
 				callback->ProcessTriangle( a, b, c );
 			}
 		}
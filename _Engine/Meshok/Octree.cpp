@@ -235,12 +235,6 @@ Float3 ClosestPointOnTriangle( const Float3 triangle[3], const Float3& sourcePos
     return triangle[0] + edge0 * s + edge1 * t;
 }
 
-float MeshSDF::GetDistanceAt( const Float3& _position ) const
-{
-UNDONE;
-return 0;
-}
-
 //--------------------------------------------------------------//
 //				End Of File.									//
 //--------------------------------------------------------------//
@@ -255,13 +255,7 @@ public:
 	ERet Build( ATriangleMeshInterface* triangleMesh );
 };
 
-struct MeshSDF : AVolume
-{
-	TPtr< MeshOctree >	tree;
-public:
-	virtual float GetDistanceAt( const Float3& _position ) const override;
-};
-
+// see MeshSDF in BVH.h
 Float3 ClosestPointOnTriangle( const Float3 triangle[3], const Float3& sourcePosition );
 
 //--------------------------------------------------------------//
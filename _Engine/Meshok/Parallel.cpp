@@ -0,0 +1,121 @@
+/*
+=============================================================================
+	File:	Parallel.cpp
+	Desc:	Simple fork-join helpers.
+			Uses the job system if it has been initialized (see Core/JobSystem.h),
+			otherwise spawns temporary threads.
+=============================================================================
+*/
+#include "stdafx.h"
+#pragma hdrstop
+#include <Meshok/Meshok.h>
+#include <Meshok/Parallel.h>
+#include <Core/JobSystem.h>
+
+namespace Meshok
+{
+
+enum { MAX_PARALLEL_THREADS = 16 };
+
+struct ParallelForContext
+{
+	F_ParallelForCallback *	callback;
+	void *		userData;
+	UINT		count;
+	AtomicInt	nextIndex;	// the next work item to be processed
+};
+
+struct ParallelForWorker
+{
+	ParallelForContext *	context;
+	UINT					threadIndex;
+};
+
+static void ProcessWorkItems( ParallelForContext& _context, UINT _threadIndex )
+{
+	for(;;)
+	{
+		const UINT index = AtomicIncrement( _context.nextIndex ) - 1;
+		if( index >= _context.count ) {
+			break;
+		}
+		(*_context.callback)( index, _threadIndex, _context.userData );
+	}
+}
+
+static UINT32 PASCAL ParallelForThreadFunction( void* _userPointer )
+{
+	ParallelForWorker* worker = static_cast< ParallelForWorker* >( _userPointer );
+	ProcessWorkItems( *worker->context, worker->threadIndex );
+	return 0;
+}
+
+UINT ParallelFor_GetMaxThreads()
+{
+	if( JobSystem::IsInitialized() ) {
+		return smallest( JobSystem::NumThreads(), (UINT)MAX_PARALLEL_THREADS );
+	}
+	return Clamp< UINT >( mxGetNumCpuCores(), 1, MAX_PARALLEL_THREADS );
+}
+
+void ParallelFor( UINT _count, F_ParallelForCallback* _callback, void* _userData, UINT _maxThreads )
+{
+	// run on the job system's worker threads (the calling thread also executes other jobs while waiting,
+	// so ParallelFor() can be called from inside jobs and other ParallelFor() callbacks)
+	if( JobSystem::IsInitialized() )
+	{
+		const UINT maxThreads = _maxThreads ? smallest( _maxThreads, (UINT)MAX_PARALLEL_THREADS ) : MAX_PARALLEL_THREADS;
+		JobSystem::ParallelFor( _count, _callback, _userData, maxThreads );
+		return;
+	}
+
+	// otherwise, create helper threads
+	ParallelForContext	context;
+	context.callback = _callback;
+	context.userData = _userData;
+	context.count = _count;
+	context.nextIndex = 0;
+
+	UINT numThreads = ParallelFor_GetMaxThreads();
+	if( _maxThreads ) {
+		numThreads = smallest( numThreads, _maxThreads );
+	}
+	numThreads = smallest( numThreads, _count );
+
+	// the calling thread has index 0, helper threads start with 1
+	Thread				threads[ MAX_PARALLEL_THREADS ];
+	ParallelForWorker	workers[ MAX_PARALLEL_THREADS ];
+	UINT				numStartedThreads = 0;
+
+	for( UINT i = 1; i < numThreads; i++ )
+	{
+		ParallelForWorker& worker = workers[ numStartedThreads ];
+		worker.context = &context;
+		worker.threadIndex = i;
+
+		Thread::CInfo	cInfo;
+		cInfo.entryPoint = &ParallelForThreadFunction;
+		cInfo.userPointer = &worker;
+		cInfo.debugName = "ParallelFor";
+
+		if( !threads[ numStartedThreads ].Initialize( cInfo ) ) {
+			ptWARN("ParallelFor: failed to create a helper thread\n");
+			break;
+		}
+		numStartedThreads++;
+	}
+
+	ProcessWorkItems( context, 0 );
+
+	for( UINT i = 0; i < numStartedThreads; i++ )
+	{
+		threads[i].Join();
+		threads[i].Shutdown();
+	}
+}
+
+}//namespace Meshok
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,28 @@
+/*
+=============================================================================
+	File:	Parallel.h
+	Desc:	Simple fork-join helpers for splitting mesh processing
+			(contouring, tree building, baking) across CPU cores.
+=============================================================================
+*/
+#pragma once
+
+namespace Meshok
+{
+	// processes a single work item;
+	// _threadIndex is in range [0..ParallelFor_GetMaxThreads()) and can be used to index per-thread scratch data
+	typedef void F_ParallelForCallback( UINT _index, UINT _threadIndex, void* _userData );
+
+	// the max. number of threads used by ParallelFor (including the calling thread)
+	UINT ParallelFor_GetMaxThreads();
+
+	// calls the callback for each index in [0.._count) on the calling thread and helper threads;
+	// work items are handed out dynamically, the function returns when all items have been processed;
+	// _maxThreads = 0 means 'use all CPU cores'
+	void ParallelFor( UINT _count, F_ParallelForCallback* _callback, void* _userData, UINT _maxThreads = 0 );
+
+}//namespace Meshok
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -4,9 +4,29 @@
 #include <Meshok/Meshok.h>
 #include <Meshok/VoxelEngine.h>
 
+void AVolume::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	for( UINT i = 0; i < _count; i++ )
+	{
+		_distances[i] = this->GetDistanceAt( _positions[i] );
+	}
+}
 Float3 AVolume::GetNormalAt( const Float3& _position ) const
 {
-	return EstimateNormal( *this, _position.x, _position.y, _position.z );
+	// central differences, all six samples are taken with a single batched call
+	const float D = 1e-3f;
+	Float3	points[6];
+	points[0] = _position + Float3_Set(D, 0.f, 0.f);
+	points[1] = _position - Float3_Set(D, 0.f, 0.f);
+	points[2] = _position + Float3_Set(0.f, D, 0.f);
+	points[3] = _position - Float3_Set(0.f, D, 0.f);
+	points[4] = _position + Float3_Set(0.f, 0.f, D);
+	points[5] = _position - Float3_Set(0.f, 0.f, D);
+	float	d[6];
+	this->GetDistancesAt( points, d, mxCOUNT_OF(points) );
+	const Float3 N = Float3_Normalized( Float3_Set( d[0] - d[1], d[2] - d[3], d[4] - d[5] ) );
+	mxASSERT(Float3_IsNormalized(N));
+	return N;
 }
 AVolume::Sample AVolume::SampleAt( const Float3& _position ) const
 {
@@ -15,6 +35,13 @@ AVolume::Sample AVolume::SampleAt( const Float3& _position ) const
 	result.distance = this->GetDistanceAt(_position);
 	return result;
 }
+void AVolume::GetSamplesAt( const Float3* _positions, Sample *_samples, UINT _count ) const
+{
+	for( UINT i = 0; i < _count; i++ )
+	{
+		_samples[i] = this->SampleAt( _positions[i] );
+	}
+}
 
 // see: Numerical Methods for Ray Tracing Implicitly Defined Surfaces
 // http://graphics.williams.edu/courses/cs371/f14/reading/implicit.pdf
@@ -320,6 +347,371 @@ AVolume::Sample CSGUnion::SampleAt( const Float3& _position ) const
 	}
 }
 
+//=====================================================================
+//	BATCHED DISTANCE QUERIES (SSE: 4 points at a time, AVX: 8 points)
+//=====================================================================
+
+mxSTATIC_ASSERT(sizeof(Float3) == sizeof(float) * 3);
+
+// loads four tightly packed Float3's and transposes them into SoA form
+static mxFORCEINLINE void Float3x4_LoadSoA( const Float3* _points, __m128 &x_, __m128 &y_, __m128 &z_ )
+{
+	const float* f = &_points[0].x;
+	const __m128 a = _mm_loadu_ps( f + 0 );	// x0 y0 z0 x1
+	const __m128 b = _mm_loadu_ps( f + 4 );	// y1 z1 x2 y2
+	const __m128 c = _mm_loadu_ps( f + 8 );	// z2 x3 y3 z3
+	const __m128 xt = _mm_shuffle_ps( b, c, _MM_SHUFFLE(1,1,2,2) );	// x2 x2 x3 x3
+	const __m128 yt0 = _mm_shuffle_ps( a, b, _MM_SHUFFLE(0,0,1,1) );	// y0 y0 y1 y1
+	const __m128 yt1 = _mm_shuffle_ps( b, c, _MM_SHUFFLE(2,2,3,3) );	// y2 y2 y3 y3
+	const __m128 zt = _mm_shuffle_ps( a, b, _MM_SHUFFLE(1,1,2,2) );	// z0 z0 z1 z1
+	x_ = _mm_shuffle_ps( a, xt, _MM_SHUFFLE(2,0,3,0) );
+	y_ = _mm_shuffle_ps( yt0, yt1, _MM_SHUFFLE(2,0,2,0) );
+	z_ = _mm_shuffle_ps( zt, c, _MM_SHUFFLE(3,0,2,0) );
+}
+// transposes SoA data back and stores four tightly packed Float3's
+static mxFORCEINLINE void Float3x4_StoreAoS( __m128 x, __m128 y, __m128 z, Float3 *_points )
+{
+	float* f = &_points[0].x;
+	__m128 w = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS( x, y, z, w );
+	// overlapping unaligned stores, the fourth component is overwritten by the next point
+	_mm_storeu_ps( f + 0, x );
+	_mm_storeu_ps( f + 3, y );
+	_mm_storeu_ps( f + 6, z );
+	_mm_storel_pi( (__m64*) (f + 9), w );
+	_mm_store_ss( f + 11, _mm_movehl_ps( w, w ) );
+}
+static mxFORCEINLINE __m128 V4_Length3( __m128 x, __m128 y, __m128 z )
+{
+	return _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_mul_ps( z, z ) ) );
+}
+static mxFORCEINLINE __m128 V4_Abs( __m128 x )
+{
+	return _mm_andnot_ps( _mm_set1_ps( -0.0f ), x );
+}
+
+#if MM_ENABLE_AVX
+// loads eight tightly packed Float3's, each 128-bit lane gets four points
+static mxFORCEINLINE void Float3x8_LoadSoA( const Float3* _points, __m256 &x_, __m256 &y_, __m256 &z_ )
+{
+	__m128 x0, y0, z0;
+	__m128 x1, y1, z1;
+	Float3x4_LoadSoA( _points + 0, x0, y0, z0 );
+	Float3x4_LoadSoA( _points + 4, x1, y1, z1 );
+	x_ = _mm256_insertf128_ps( _mm256_castps128_ps256( x0 ), x1, 1 );
+	y_ = _mm256_insertf128_ps( _mm256_castps128_ps256( y0 ), y1, 1 );
+	z_ = _mm256_insertf128_ps( _mm256_castps128_ps256( z0 ), z1, 1 );
+}
+static mxFORCEINLINE void Float3x8_StoreAoS( __m256 x, __m256 y, __m256 z, Float3 *_points )
+{
+	Float3x4_StoreAoS( _mm256_castps256_ps128( x ), _mm256_castps256_ps128( y ), _mm256_castps256_ps128( z ), _points + 0 );
+	Float3x4_StoreAoS( _mm256_extractf128_ps( x, 1 ), _mm256_extractf128_ps( y, 1 ), _mm256_extractf128_ps( z, 1 ), _points + 4 );
+}
+static mxFORCEINLINE __m256 V8_Length3( __m256 x, __m256 y, __m256 z )
+{
+	return _mm256_sqrt_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, x ), _mm256_mul_ps( y, y ) ), _mm256_mul_ps( z, z ) ) );
+}
+static mxFORCEINLINE __m256 V8_Abs( __m256 x )
+{
+	return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), x );
+}
+#endif // MM_ENABLE_AVX
+
+void SphereSDF::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	const __m128 cx = _mm_set1_ps( center.x );
+	const __m128 cy = _mm_set1_ps( center.y );
+	const __m128 cz = _mm_set1_ps( center.z );
+	const __m128 r = _mm_set1_ps( radius );
+	UINT i = 0;
+#if MM_ENABLE_AVX
+	{
+		const __m256 cx8 = _mm256_set1_ps( center.x );
+		const __m256 cy8 = _mm256_set1_ps( center.y );
+		const __m256 cz8 = _mm256_set1_ps( center.z );
+		const __m256 r8 = _mm256_set1_ps( radius );
+		for( ; i + 8 <= _count; i += 8 )
+		{
+			__m256 x, y, z;
+			Float3x8_LoadSoA( _positions + i, x, y, z );
+			const __m256 l = V8_Length3( _mm256_sub_ps( x, cx8 ), _mm256_sub_ps( y, cy8 ), _mm256_sub_ps( z, cz8 ) );
+			_mm256_storeu_ps( _distances + i, _mm256_sub_ps( l, r8 ) );
+		}
+	}
+#endif // MM_ENABLE_AVX
+	for( ; i + 4 <= _count; i += 4 )
+	{
+		__m128 x, y, z;
+		Float3x4_LoadSoA( _positions + i, x, y, z );
+		const __m128 l = V4_Length3( _mm_sub_ps( x, cx ), _mm_sub_ps( y, cy ), _mm_sub_ps( z, cz ) );
+		_mm_storeu_ps( _distances + i, _mm_sub_ps( l, r ) );
+	}
+	for( ; i < _count; i++ )
+	{
+		_distances[i] = SphereSDF::GetDistanceAt( _positions[i] );
+	}
+}
+
+void HalfSpaceSDF::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	const __m128 nx = _mm_set1_ps( plane.x );
+	const __m128 ny = _mm_set1_ps( plane.y );
+	const __m128 nz = _mm_set1_ps( plane.z );
+	const __m128 nw = _mm_set1_ps( plane.w );
+	UINT i = 0;
+#if MM_ENABLE_AVX
+	{
+		const __m256 nx8 = _mm256_set1_ps( plane.x );
+		const __m256 ny8 = _mm256_set1_ps( plane.y );
+		const __m256 nz8 = _mm256_set1_ps( plane.z );
+		const __m256 nw8 = _mm256_set1_ps( plane.w );
+		for( ; i + 8 <= _count; i += 8 )
+		{
+			__m256 x, y, z;
+			Float3x8_LoadSoA( _positions + i, x, y, z );
+			const __m256 d = _mm256_add_ps(
+				_mm256_add_ps( _mm256_mul_ps( x, nx8 ), _mm256_mul_ps( y, ny8 ) ),
+				_mm256_add_ps( _mm256_mul_ps( z, nz8 ), nw8 )
+			);
+			_mm256_storeu_ps( _distances + i, d );
+		}
+	}
+#endif // MM_ENABLE_AVX
+	for( ; i + 4 <= _count; i += 4 )
+	{
+		__m128 x, y, z;
+		Float3x4_LoadSoA( _positions + i, x, y, z );
+		const __m128 d = _mm_add_ps(
+			_mm_add_ps( _mm_mul_ps( x, nx ), _mm_mul_ps( y, ny ) ),
+			_mm_add_ps( _mm_mul_ps( z, nz ), nw )
+		);
+		_mm_storeu_ps( _distances + i, d );
+	}
+	for( ; i < _count; i++ )
+	{
+		_distances[i] = HalfSpaceSDF::GetDistanceAt( _positions[i] );
+	}
+}
+
+void AxisAlignedBoxSDF::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	const __m128 sx = _mm_set1_ps( size.x );
+	const __m128 sy = _mm_set1_ps( size.y );
+	const __m128 sz = _mm_set1_ps( size.z );
+	const __m128 zero = _mm_setzero_ps();
+	UINT i = 0;
+#if MM_ENABLE_AVX
+	{
+		const __m256 sx8 = _mm256_set1_ps( size.x );
+		const __m256 sy8 = _mm256_set1_ps( size.y );
+		const __m256 sz8 = _mm256_set1_ps( size.z );
+		const __m256 zero8 = _mm256_setzero_ps();
+		for( ; i + 8 <= _count; i += 8 )
+		{
+			__m256 x, y, z;
+			Float3x8_LoadSoA( _positions + i, x, y, z );
+			const __m256 qx = _mm256_max_ps( _mm256_sub_ps( V8_Abs( x ), sx8 ), zero8 );
+			const __m256 qy = _mm256_max_ps( _mm256_sub_ps( V8_Abs( y ), sy8 ), zero8 );
+			const __m256 qz = _mm256_max_ps( _mm256_sub_ps( V8_Abs( z ), sz8 ), zero8 );
+			_mm256_storeu_ps( _distances + i, V8_Length3( qx, qy, qz ) );
+		}
+	}
+#endif // MM_ENABLE_AVX
+	for( ; i + 4 <= _count; i += 4 )
+	{
+		__m128 x, y, z;
+		Float3x4_LoadSoA( _positions + i, x, y, z );
+		const __m128 qx = _mm_max_ps( _mm_sub_ps( V4_Abs( x ), sx ), zero );
+		const __m128 qy = _mm_max_ps( _mm_sub_ps( V4_Abs( y ), sy ), zero );
+		const __m128 qz = _mm_max_ps( _mm_sub_ps( V4_Abs( z ), sz ), zero );
+		_mm_storeu_ps( _distances + i, V4_Length3( qx, qy, qz ) );
+	}
+	for( ; i < _count; i++ )
+	{
+		_distances[i] = AxisAlignedBoxSDF::GetDistanceAt( _positions[i] );
+	}
+}
+
+void TorusSDF::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	const __m128 cx = _mm_set1_ps( center.x );
+	const __m128 cz = _mm_set1_ps( center.z );
+	const __m128 tx = _mm_set1_ps( T.x );
+	const __m128 ty = _mm_set1_ps( T.y );
+	UINT i = 0;
+#if MM_ENABLE_AVX
+	{
+		const __m256 cx8 = _mm256_set1_ps( center.x );
+		const __m256 cz8 = _mm256_set1_ps( center.z );
+		const __m256 tx8 = _mm256_set1_ps( T.x );
+		const __m256 ty8 = _mm256_set1_ps( T.y );
+		for( ; i + 8 <= _count; i += 8 )
+		{
+			__m256 x, y, z;
+			Float3x8_LoadSoA( _positions + i, x, y, z );
+			const __m256 lx = _mm256_sub_ps( x, cx8 );
+			const __m256 lz = _mm256_sub_ps( z, cz8 );
+			const __m256 qx = _mm256_sub_ps( _mm256_sqrt_ps( _mm256_add_ps( _mm256_mul_ps( lx, lx ), _mm256_mul_ps( lz, lz ) ) ), tx8 );
+			const __m256 l = _mm256_sqrt_ps( _mm256_add_ps( _mm256_mul_ps( qx, qx ), _mm256_mul_ps( y, y ) ) );
+			_mm256_storeu_ps( _distances + i, _mm256_sub_ps( l, ty8 ) );
+		}
+	}
+#endif // MM_ENABLE_AVX
+	for( ; i + 4 <= _count; i += 4 )
+	{
+		__m128 x, y, z;
+		Float3x4_LoadSoA( _positions + i, x, y, z );
+		const __m128 lx = _mm_sub_ps( x, cx );
+		const __m128 lz = _mm_sub_ps( z, cz );
+		const __m128 qx = _mm_sub_ps( _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( lx, lx ), _mm_mul_ps( lz, lz ) ) ), tx );
+		// NOTE: must match GetDistanceAt(), which uses the untransformed Y coordinate
+		const __m128 l = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( qx, qx ), _mm_mul_ps( y, y ) ) );
+		_mm_storeu_ps( _distances + i, _mm_sub_ps( l, ty ) );
+	}
+	for( ; i < _count; i++ )
+	{
+		_distances[i] = TorusSDF::GetDistanceAt( _positions[i] );
+	}
+}
+
+void TransformSDF::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	const __m128 m00 = _mm_set1_ps( xform.r0.x ), m01 = _mm_set1_ps( xform.r0.y ), m02 = _mm_set1_ps( xform.r0.z );
+	const __m128 m10 = _mm_set1_ps( xform.r1.x ), m11 = _mm_set1_ps( xform.r1.y ), m12 = _mm_set1_ps( xform.r1.z );
+	const __m128 m20 = _mm_set1_ps( xform.r2.x ), m21 = _mm_set1_ps( xform.r2.y ), m22 = _mm_set1_ps( xform.r2.z );
+	const __m128 m30 = _mm_set1_ps( xform.r3.x ), m31 = _mm_set1_ps( xform.r3.y ), m32 = _mm_set1_ps( xform.r3.z );
+#if MM_ENABLE_AVX
+	const __m256 m00_8 = _mm256_set1_ps( xform.r0.x ), m01_8 = _mm256_set1_ps( xform.r0.y ), m02_8 = _mm256_set1_ps( xform.r0.z );
+	const __m256 m10_8 = _mm256_set1_ps( xform.r1.x ), m11_8 = _mm256_set1_ps( xform.r1.y ), m12_8 = _mm256_set1_ps( xform.r1.z );
+	const __m256 m20_8 = _mm256_set1_ps( xform.r2.x ), m21_8 = _mm256_set1_ps( xform.r2.y ), m22_8 = _mm256_set1_ps( xform.r2.z );
+	const __m256 m30_8 = _mm256_set1_ps( xform.r3.x ), m31_8 = _mm256_set1_ps( xform.r3.y ), m32_8 = _mm256_set1_ps( xform.r3.z );
+#endif // MM_ENABLE_AVX
+
+	Float3	transformed[ MAX_BATCH_SIZE ];
+
+	UINT start = 0;
+	while( start < _count )
+	{
+		const UINT batchSize = smallest( _count - start, (UINT)MAX_BATCH_SIZE );
+		const Float3* src = _positions + start;
+
+		UINT i = 0;
+#if MM_ENABLE_AVX
+		for( ; i + 8 <= batchSize; i += 8 )
+		{
+			__m256 x, y, z;
+			Float3x8_LoadSoA( src + i, x, y, z );
+			const __m256 tx = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, m00_8 ), _mm256_mul_ps( y, m10_8 ) ), _mm256_add_ps( _mm256_mul_ps( z, m20_8 ), m30_8 ) );
+			const __m256 ty = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, m01_8 ), _mm256_mul_ps( y, m11_8 ) ), _mm256_add_ps( _mm256_mul_ps( z, m21_8 ), m31_8 ) );
+			const __m256 tz = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, m02_8 ), _mm256_mul_ps( y, m12_8 ) ), _mm256_add_ps( _mm256_mul_ps( z, m22_8 ), m32_8 ) );
+			Float3x8_StoreAoS( tx, ty, tz, transformed + i );
+		}
+#endif // MM_ENABLE_AVX
+		for( ; i + 4 <= batchSize; i += 4 )
+		{
+			__m128 x, y, z;
+			Float3x4_LoadSoA( src + i, x, y, z );
+			const __m128 tx = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, m00 ), _mm_mul_ps( y, m10 ) ), _mm_add_ps( _mm_mul_ps( z, m20 ), m30 ) );
+			const __m128 ty = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, m01 ), _mm_mul_ps( y, m11 ) ), _mm_add_ps( _mm_mul_ps( z, m21 ), m31 ) );
+			const __m128 tz = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, m02 ), _mm_mul_ps( y, m12 ) ), _mm_add_ps( _mm_mul_ps( z, m22 ), m32 ) );
+			Float3x4_StoreAoS( tx, ty, tz, transformed + i );
+		}
+		for( ; i < batchSize; i++ )
+		{
+			transformed[i] = Matrix_TransformPoint( xform, src[i] );
+		}
+
+		op->GetDistancesAt( transformed, _distances + start, batchSize );
+
+		start += batchSize;
+	}
+}
+
+void CSGSubtraction::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 signMask = _mm_set1_ps( -0.0f );
+
+	float	distancesB[ MAX_BATCH_SIZE ];
+
+	UINT start = 0;
+	while( start < _count )
+	{
+		const UINT batchSize = smallest( _count - start, (UINT)MAX_BATCH_SIZE );
+		float * distancesA = _distances + start;
+
+		opA->GetDistancesAt( _positions + start, distancesA, batchSize );
+		opB->GetDistancesAt( _positions + start, distancesB, batchSize );
+
+		UINT i = 0;
+#if MM_ENABLE_AVX
+		for( ; i + 8 <= batchSize; i += 8 )
+		{
+			const __m256 dA = _mm256_loadu_ps( distancesA + i );
+			const __m256 dB = _mm256_loadu_ps( distancesB + i );
+			const __m256 outsideB = _mm256_cmp_ps( dB, _mm256_setzero_ps(), _CMP_GT_OQ );
+			_mm256_storeu_ps( distancesA + i, _mm256_blendv_ps( _mm256_xor_ps( dB, _mm256_set1_ps( -0.0f ) ), dA, outsideB ) );
+		}
+#endif // MM_ENABLE_AVX
+		for( ; i + 4 <= batchSize; i += 4 )
+		{
+			const __m128 dA = _mm_loadu_ps( distancesA + i );
+			const __m128 dB = _mm_loadu_ps( distancesB + i );
+			// if point B is outside, return A
+			const __m128 outsideB = _mm_cmpgt_ps( dB, zero );
+			const __m128 result = _mm_or_ps(
+				_mm_and_ps( outsideB, dA ),
+				_mm_andnot_ps( outsideB, _mm_xor_ps( dB, signMask ) )
+			);
+			_mm_storeu_ps( distancesA + i, result );
+		}
+		for( ; i < batchSize; i++ )
+		{
+			const float dB = distancesB[i];
+			distancesA[i] = ( dB > 0.0f ) ? distancesA[i] : -dB;
+		}
+
+		start += batchSize;
+	}
+}
+
+void CSGUnion::GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const
+{
+	float	distancesB[ MAX_BATCH_SIZE ];
+
+	UINT start = 0;
+	while( start < _count )
+	{
+		const UINT batchSize = smallest( _count - start, (UINT)MAX_BATCH_SIZE );
+		float * distancesA = _distances + start;
+
+		opA->GetDistancesAt( _positions + start, distancesA, batchSize );
+		opB->GetDistancesAt( _positions + start, distancesB, batchSize );
+
+		UINT i = 0;
+#if MM_ENABLE_AVX
+		for( ; i + 8 <= batchSize; i += 8 )
+		{
+			_mm256_storeu_ps( distancesA + i, _mm256_min_ps( _mm256_loadu_ps( distancesA + i ), _mm256_loadu_ps( distancesB + i ) ) );
+		}
+#endif // MM_ENABLE_AVX
+		for( ; i + 4 <= batchSize; i += 4 )
+		{
+			const __m128 dA = _mm_loadu_ps( distancesA + i );
+			const __m128 dB = _mm_loadu_ps( distancesB + i );
+			_mm_storeu_ps( distancesA + i, _mm_min_ps( dA, dB ) );
+		}
+		for( ; i < batchSize; i++ )
+		{
+			const float dA = distancesA[i];
+			const float dB = distancesB[i];
+			distancesA[i] = ( dA < dB ) ? dA : dB;
+		}
+
+		start += batchSize;
+	}
+}
+
 // 3D ray / AABox intersection by Jeroen Baert
 // http://gamedev.stackexchange.com/a/24464
 bool intersectRayAABox2(
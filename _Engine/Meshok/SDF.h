@@ -33,6 +33,10 @@ struct AVolume
 
 public:	// The following functions can be overridden for better efficiency:
 
+	// estimates the distances at the given points (can be much faster than calling GetDistanceAt() for each point);
+	// the default implementation simply loops over the points
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const;
+
 	// estimates the gradient at the given point (points outward)
 	virtual Float3 GetNormalAt( const Float3& _position ) const;
 
@@ -43,6 +47,10 @@ public:	// The following functions can be overridden for better efficiency:
 	// estimates the density and gradient at the given point
 	virtual Sample SampleAt( const Float3& _position ) const;
 
+	// estimates the densities and gradients at the given points;
+	// the default implementation simply loops over the points
+	virtual void GetSamplesAt( const Float3* _positions, Sample *_samples, UINT _count ) const;
+
 	virtual bool IntersectsLine(
 		const Float3& start, const Float3& end,
 		Float3 &point, Float3 &normal
@@ -50,6 +58,9 @@ public:	// The following functions can be overridden for better efficiency:
 
 	static inline bool IsSolid( float distance ) { return distance <= 0.0f; }
 
+	// max. number of points processed at once by composite volumes (size of temporary stack buffers)
+	enum { MAX_BATCH_SIZE = 256 };
+
 protected:
 	virtual ~AVolume() {}
 };
@@ -72,6 +83,7 @@ public:
 		float	d = l - radius;
 		return	d;
 	}
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
 	virtual Float3 GetNormalAt( const Float3& _position ) const override
 	{
 		return Float3_Normalized( _position - center );
@@ -109,6 +121,7 @@ public:
 	{
 		return Plane_PointDistance( plane, _position );
 	}
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
 	virtual Float3 GetNormalAt( const Float3& _position ) const override
 	{
 		mxASSERT(Float3_IsNormalized( Float4_As_Float3( plane ) ));
@@ -133,6 +146,7 @@ public:
 		size = Float3_Replicate(1);
 	}
 	virtual float GetDistanceAt( const Float3& _position ) const override;
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
 };
 
 struct TorusSDF : public AVolume
@@ -154,6 +168,7 @@ public:
 		);
 		return Float2_Length(q) - T.y;
 	}
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
 };
 
 struct TransformSDF : public AVolume
@@ -171,6 +186,8 @@ public:
 		Float3 transformedPosition = Matrix_TransformPoint( xform, _position );
 		return op->GetDistanceAt( transformedPosition );
 	}
+	// transforms the points in batches and passes them to the operand
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
 };
 
 
@@ -182,6 +199,7 @@ struct CSGSubtraction : AVolume
 	AVolume *	opB;
 public:
 	virtual float GetDistanceAt( const Float3& _position ) const override;
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
 	virtual Sample SampleAt( const Float3& _position ) const override;
 };
 
@@ -192,6 +210,7 @@ struct CSGUnion : AVolume
 	AVolume *	opB;
 public:
 	virtual float GetDistanceAt( const Float3& _position ) const override;
+	virtual void GetDistancesAt( const Float3* _positions, float *_distances, UINT _count ) const override;
 	virtual Sample SampleAt( const Float3& _position ) const override;
 };
 
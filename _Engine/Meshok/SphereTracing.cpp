@@ -0,0 +1,405 @@
+// Packet ray casting against implicit surfaces.
+#include "stdafx.h"
+#pragma hdrstop
+#include <Meshok/Meshok.h>
+#include <Meshok/ASDF.h>
+#include <Meshok/Parallel.h>
+#include <Meshok/SphereTracing.h>
+
+namespace SphereTracing
+{
+
+Options::Options()
+{
+	epsilon = 1e-3f;
+	maxSteps = 128;
+	stepScale = 1.0f;
+	bounds = nil;
+	boundsMargin = 0.0f;
+}
+
+Stats::Stats()
+{
+	mxZERO_OUT( *this );
+}
+void Stats::Add( const Stats& _other )
+{
+	numRays += _other.numRays;
+	numHits += _other.numHits;
+	numSteps += _other.numSteps;
+	numSkips += _other.numSkips;
+	elapsedTime += _other.elapsedTime;
+}
+void Stats::Print() const
+{
+	DBGOUT( "Sphere tracing: %u rays, %u hits, %u steps (%.2f per ray), %u skips, %u usec\n",
+		numRays, numHits, numSteps, numRays ? (float)numSteps / numRays : 0.0f, numSkips, elapsedTime );
+}
+
+/*
+-----------------------------------------------------------------------------
+	Vectors of PACKET_SIZE floats (SSE: 4, AVX: 8).
+-----------------------------------------------------------------------------
+*/
+#if MM_ENABLE_AVX
+typedef __m256 PacketVec;
+static mxFORCEINLINE PacketVec PV_Zero() { return _mm256_setzero_ps(); }
+static mxFORCEINLINE PacketVec PV_Set1( float x ) { return _mm256_set1_ps( x ); }
+static mxFORCEINLINE PacketVec PV_Load( const float* p ) { return _mm256_loadu_ps( p ); }
+static mxFORCEINLINE void PV_Store( float* p, PacketVec x ) { _mm256_storeu_ps( p, x ); }
+static mxFORCEINLINE PacketVec PV_Add( PacketVec a, PacketVec b ) { return _mm256_add_ps( a, b ); }
+static mxFORCEINLINE PacketVec PV_Mul( PacketVec a, PacketVec b ) { return _mm256_mul_ps( a, b ); }
+static mxFORCEINLINE PacketVec PV_Max( PacketVec a, PacketVec b ) { return _mm256_max_ps( a, b ); }
+static mxFORCEINLINE PacketVec PV_And( PacketVec a, PacketVec b ) { return _mm256_and_ps( a, b ); }
+static mxFORCEINLINE int PV_LessMask( PacketVec a, PacketVec b ) { return _mm256_movemask_ps( _mm256_cmp_ps( a, b, _CMP_LT_OQ ) ); }
+static mxFORCEINLINE int PV_GreaterMask( PacketVec a, PacketVec b ) { return _mm256_movemask_ps( _mm256_cmp_ps( a, b, _CMP_GT_OQ ) ); }
+#else
+typedef __m128 PacketVec;
+static mxFORCEINLINE PacketVec PV_Zero() { return _mm_setzero_ps(); }
+static mxFORCEINLINE PacketVec PV_Set1( float x ) { return _mm_set1_ps( x ); }
+static mxFORCEINLINE PacketVec PV_Load( const float* p ) { return _mm_loadu_ps( p ); }
+static mxFORCEINLINE void PV_Store( float* p, PacketVec x ) { _mm_storeu_ps( p, x ); }
+static mxFORCEINLINE PacketVec PV_Add( PacketVec a, PacketVec b ) { return _mm_add_ps( a, b ); }
+static mxFORCEINLINE PacketVec PV_Mul( PacketVec a, PacketVec b ) { return _mm_mul_ps( a, b ); }
+static mxFORCEINLINE PacketVec PV_Max( PacketVec a, PacketVec b ) { return _mm_max_ps( a, b ); }
+static mxFORCEINLINE PacketVec PV_And( PacketVec a, PacketVec b ) { return _mm_and_ps( a, b ); }
+static mxFORCEINLINE int PV_LessMask( PacketVec a, PacketVec b ) { return _mm_movemask_ps( _mm_cmplt_ps( a, b ) ); }
+static mxFORCEINLINE int PV_GreaterMask( PacketVec a, PacketVec b ) { return _mm_movemask_ps( _mm_cmpgt_ps( a, b ) ); }
+#endif // MM_ENABLE_AVX
+mxSTATIC_ASSERT(sizeof(PacketVec) == sizeof(float) * PACKET_SIZE);
+
+/*
+-----------------------------------------------------------------------------
+	A packet of up to PACKET_SIZE rays in SoA layout.
+-----------------------------------------------------------------------------
+*/
+struct RayPacket
+{
+	PacketVec	ox, oy, oz;	// origins
+	PacketVec	dx, dy, dz;	// directions
+	PacketVec	tMax;
+	int			validMask;	// lanes which contain rays
+public:
+	void Load( const Ray* _rays, UINT _count )
+	{
+		mxASSERT( _count > 0 && _count <= PACKET_SIZE );
+		float	f[7][PACKET_SIZE];
+		for( UINT i = 0; i < PACKET_SIZE; i++ )
+		{
+			// unused lanes duplicate the first ray and are masked out
+			const Ray& ray = _rays[ (i < _count) ? i : 0 ];
+			f[0][i] = ray.origin.x;
+			f[1][i] = ray.origin.y;
+			f[2][i] = ray.origin.z;
+			f[3][i] = ray.direction.x;
+			f[4][i] = ray.direction.y;
+			f[5][i] = ray.direction.z;
+			f[6][i] = ray.maxDistance;
+		}
+		ox = PV_Load( f[0] );
+		oy = PV_Load( f[1] );
+		oz = PV_Load( f[2] );
+		dx = PV_Load( f[3] );
+		dy = PV_Load( f[4] );
+		dz = PV_Load( f[5] );
+		tMax = PV_Load( f[6] );
+		validMask = (1 << _count) - 1;
+	}
+};
+
+// marches the rays until they hit the surface or leave their segments;
+// returns the mask of rays which hit the surface and their distances
+static int TracePacket(
+					   const AVolume* _volume,
+					   const Ray* _rays,
+					   const RayPacket& _packet,
+					   const Options& _options,
+					   float _t[PACKET_SIZE],
+					   Stats & _stats
+					   )
+{
+	const PacketVec epsilon = PV_Set1( _options.epsilon );
+	const PacketVec stepScale = PV_Set1( _options.stepScale );
+
+	PacketVec	t = PV_Zero();
+	int			activeMask = _packet.validMask;
+	int			hitMask = 0;
+
+	for( UINT32 iStep = 0; activeMask && iStep < _options.maxSteps; iStep++ )
+	{
+		float	px[PACKET_SIZE], py[PACKET_SIZE], pz[PACKET_SIZE];
+		PV_Store( px, PV_Add( _packet.ox, PV_Mul( _packet.dx, t ) ) );
+		PV_Store( py, PV_Add( _packet.oy, PV_Mul( _packet.dy, t ) ) );
+		PV_Store( pz, PV_Add( _packet.oz, PV_Mul( _packet.dz, t ) ) );
+
+		// gather the active rays, so that the volume is queried once per step
+		Float3	points[PACKET_SIZE];
+		Float3	directions[PACKET_SIZE];
+		UINT	lanes[PACKET_SIZE];
+		UINT	numActive = 0;
+		for( UINT i = 0; i < PACKET_SIZE; i++ )
+		{
+			if( activeMask & BIT(i) )
+			{
+				points[ numActive ] = Float3_Set( px[i], py[i], pz[i] );
+				directions[ numActive ] = _rays[i].direction;
+				lanes[ numActive ] = i;
+				numActive++;
+			}
+		}
+
+		float	distances[PACKET_SIZE];
+		_volume->GetDistancesAt( points, distances, numActive );
+
+		float	skips[PACKET_SIZE];
+		if( _options.bounds ) {
+			_options.bounds->GetEmptySpaceSkips( points, directions, _options.boundsMargin, skips, numActive );
+		}
+
+		float	laneDistances[PACKET_SIZE] = { 0 };
+		float	laneSkips[PACKET_SIZE] = { 0 };
+		for( UINT i = 0; i < numActive; i++ )
+		{
+			laneDistances[ lanes[i] ] = distances[i];
+			laneSkips[ lanes[i] ] = _options.bounds ? skips[i] : 0.0f;
+		}
+		_stats.numSteps += numActive;
+
+		const PacketVec d = PV_Load( laneDistances );
+		const PacketVec scaledStep = PV_Mul( d, stepScale );
+		const PacketVec skip = PV_Load( laneSkips );
+
+		const int newHits = PV_LessMask( d, epsilon ) & activeMask;
+		const int skipped = PV_GreaterMask( skip, scaledStep ) & activeMask & ~newHits;
+		for( UINT i = 0; i < PACKET_SIZE; i++ ) {
+			_stats.numSkips += (skipped >> i) & 1;
+		}
+
+		hitMask |= newHits;
+		activeMask &= ~newHits;
+
+		// advance the rays which are still marching
+		UINT32	movingLanes[PACKET_SIZE];
+		for( UINT i = 0; i < PACKET_SIZE; i++ ) {
+			movingLanes[i] = (activeMask & BIT(i)) ? ~0u : 0u;
+		}
+		const PacketVec step = PV_Max( scaledStep, skip );
+		t = PV_Add( t, PV_And( step, PV_Load( reinterpret_cast< const float* >( movingLanes ) ) ) );
+
+		activeMask &= ~PV_GreaterMask( t, _packet.tMax );
+	}
+
+	PV_Store( _t, t );
+	return hitMask;
+}
+
+template< class OUTPUT >
+static void TraceRaysImpl(
+						  const AVolume* _volume,
+						  const Ray* _rays, UINT _count,
+						  const Options& _options,
+						  OUTPUT & _output,
+						  Stats *_stats
+						  )
+{
+	const UINT64 startTime = mxGetTimeInMicroseconds();
+
+	Stats	stats;
+	stats.numRays = _count;
+
+	for( UINT start = 0; start < _count; start += PACKET_SIZE )
+	{
+		const UINT packetSize = smallest( _count - start, (UINT)PACKET_SIZE );
+
+		RayPacket	packet;
+		packet.Load( _rays + start, packetSize );
+
+		float	t[PACKET_SIZE];
+		const int hitMask = TracePacket( _volume, _rays + start, packet, _options, t, stats );
+
+		_output( _volume, _rays + start, start, packetSize, hitMask, t );
+
+		for( UINT i = 0; i < packetSize; i++ ) {
+			stats.numHits += (hitMask & BIT(i)) ? 1 : 0;
+		}
+	}
+
+	if( _stats )
+	{
+		stats.elapsedTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+		*_stats = stats;
+	}
+}
+
+// stores hit points and computes normals for all hits of the packet at once
+struct StoreHits
+{
+	Hit *	hits;
+public:
+	void operator () ( const AVolume* _volume, const Ray* _rays, UINT _start, UINT _count, int _hitMask, const float _t[PACKET_SIZE] )
+	{
+		Float3	points[PACKET_SIZE];
+		UINT	indices[PACKET_SIZE];
+		UINT	numHits = 0;
+		for( UINT i = 0; i < _count; i++ )
+		{
+			Hit & hit = hits[ _start + i ];
+			if( _hitMask & BIT(i) )
+			{
+				hit.position = _rays[i].origin + _rays[i].direction * _t[i];
+				hit.distance = _t[i];
+				points[ numHits ] = hit.position;
+				indices[ numHits ] = _start + i;
+				numHits++;
+			}
+			else
+			{
+				hit.position = Float3_Zero();
+				hit.normal = Float3_Zero();
+				hit.distance = -1.0f;
+			}
+		}
+		if( numHits )
+		{
+			AVolume::Sample	samples[PACKET_SIZE];
+			_volume->GetSamplesAt( points, samples, numHits );
+			for( UINT i = 0; i < numHits; i++ ) {
+				hits[ indices[i] ].normal = samples[i].normal;
+			}
+		}
+	}
+};
+
+struct StoreOcclusion
+{
+	bool *	occluded;
+public:
+	void operator () ( const AVolume* _volume, const Ray* _rays, UINT _start, UINT _count, int _hitMask, const float _t[PACKET_SIZE] )
+	{
+		for( UINT i = 0; i < _count; i++ ) {
+			occluded[ _start + i ] = (_hitMask & BIT(i)) != 0;
+		}
+	}
+};
+
+void TraceRays(
+			   const AVolume* _volume,
+			   const Ray* _rays, UINT _count,
+			   Hit *_hits,
+			   const Options& _options,
+			   Stats *_stats
+			   )
+{
+	StoreHits	output;
+	output.hits = _hits;
+	TraceRaysImpl( _volume, _rays, _count, _options, output, _stats );
+}
+
+void OccludedRays(
+				  const AVolume* _volume,
+				  const Ray* _rays, UINT _count,
+				  bool *_occluded,
+				  const Options& _options,
+				  Stats *_stats
+				  )
+{
+	StoreOcclusion	output;
+	output.occluded = _occluded;
+	TraceRaysImpl( _volume, _rays, _count, _options, output, _stats );
+}
+
+namespace
+{
+	// the number of rays processed by a single work item
+	enum { RAYS_PER_TASK = 64 };
+	enum { MAX_THREADS = 16 };
+
+	struct ParallelTraceData
+	{
+		const AVolume *	volume;
+		const Ray *		rays;
+		UINT			count;
+		Hit *			hits;
+		const Options *	options;
+		Stats			threadStats[ MAX_THREADS ];
+	};
+
+	void TraceRaysTask( UINT _index, UINT _threadIndex, void* _userData )
+	{
+		ParallelTraceData & data = *static_cast< ParallelTraceData* >( _userData );
+		const UINT start = _index * RAYS_PER_TASK;
+		const UINT count = smallest( data.count - start, (UINT)RAYS_PER_TASK );
+
+		Stats	stats;
+		TraceRays( data.volume, data.rays + start, count, data.hits + start, *data.options, &stats );
+
+		mxASSERT( _threadIndex < MAX_THREADS );
+		data.threadStats[ _threadIndex ].Add( stats );
+	}
+}//namespace
+
+void TraceRaysParallel(
+					   const AVolume* _volume,
+					   const Ray* _rays, UINT _count,
+					   Hit *_hits,
+					   const Options& _options,
+					   Stats *_stats
+					   )
+{
+	const UINT64 startTime = mxGetTimeInMicroseconds();
+
+	ParallelTraceData	data;
+	data.volume = _volume;
+	data.rays = _rays;
+	data.count = _count;
+	data.hits = _hits;
+	data.options = &_options;
+
+	const UINT numTasks = (_count + RAYS_PER_TASK - 1) / RAYS_PER_TASK;
+	Meshok::ParallelFor( numTasks, &TraceRaysTask, &data, MAX_THREADS );
+
+	if( _stats )
+	{
+		Stats	total;
+		for( UINT i = 0; i < MAX_THREADS; i++ ) {
+			total.Add( data.threadStats[i] );
+		}
+		total.elapsedTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+		*_stats = total;
+	}
+}
+
+bool IntersectsLine(
+					const AVolume* _volume,
+					const Float3& _start, const Float3& _end,
+					Float3 &_point, Float3 &_normal,
+					const Options& _options
+					)
+{
+	const Float3 segment = _end - _start;
+	const float length = Float3_Length( segment );
+	if( length < 1e-6f ) {
+		return false;
+	}
+
+	Ray	ray;
+	ray.origin = _start;
+	ray.direction = segment * (1.0f / length);
+	ray.maxDistance = length;
+
+	Hit	hit;
+	TraceRays( _volume, &ray, 1, &hit, _options );
+	if( hit.IsValid() )
+	{
+		_point = hit.position;
+		_normal = hit.normal;
+		return true;
+	}
+	return false;
+}
+
+}//namespace SphereTracing
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,114 @@
+/*
+=============================================================================
+	File:	SphereTracing.h
+	Desc:	Packet ray casting against implicit surfaces (AVolume).
+	Rays are traced in packets of four (eight with AVX): each step evaluates the distances
+	for all active rays of the packet with a single GetDistancesAt() call
+	and advances the rays by the (conservative) distance to the surface.
+	An ASDF octree can be supplied to skip over leaves which cannot contain the surface.
+	References:
+	"Sphere Tracing: A Geometric Method for the Antialiased Ray Tracing
+	of Implicit Surfaces" [John C. Hart, 1996]
+=============================================================================
+*/
+#pragma once
+
+#include <Meshok/SDF.h>
+
+namespace ASDF
+{
+	struct Volume;
+}
+
+namespace SphereTracing
+{
+	// the number of rays traced together, the width of the SIMD registers (see MM_ENABLE_AVX)
+	enum { PACKET_SIZE = MM_ENABLE_AVX ? 8 : 4 };
+
+	struct Ray
+	{
+		Float3	origin;
+		Float3	direction;	// must be normalized
+		float	maxDistance;// the length of the ray segment
+	};
+
+	struct Hit
+	{
+		Float3	position;
+		Float3	normal;		// points outward (only computed by TraceRays())
+		float	distance;	// along the ray, < 0 if the ray missed
+	public:
+		bool IsValid() const { return distance >= 0.0f; }
+	};
+
+	struct Options
+	{
+		// the ray hits the surface if the distance is less than this value
+		float	epsilon;
+		// the max. number of steps per ray, the ray is considered a miss if exceeded
+		UINT32	maxSteps;
+		// scales each step; values < 1 are needed for volumes which overestimate distances
+		float	stepScale;
+		// (optional) ASDF octree bounding the traced volume:
+		// leaves whose corner distances are all above 'boundsMargin' are skipped in one step
+		const ASDF::Volume *	bounds;
+		// should be >= the max. error of the ASDF (see ASDF::Options::error_threshold)
+		float	boundsMargin;
+	public:
+		Options();
+	};
+
+	struct Stats
+	{
+		UINT32	numRays;
+		UINT32	numHits;
+		UINT32	numSteps;	// total number of steps (i.e. distance evaluations)
+		UINT32	numSkips;	// steps which used empty-space skipping
+		UINT32	elapsedTime;// in microseconds
+	public:
+		Stats();
+		void Add( const Stats& _other );
+		void Print() const;
+	};
+
+	// finds the closest intersection along each ray
+	void TraceRays(
+		const AVolume* _volume,
+		const Ray* _rays, UINT _count,
+		Hit *_hits,
+		const Options& _options = Options(),
+		Stats *_stats = nil
+	);
+
+	// shadow/line-of-sight queries: only checks if each ray hits anything
+	void OccludedRays(
+		const AVolume* _volume,
+		const Ray* _rays, UINT _count,
+		bool *_occluded,
+		const Options& _options = Options(),
+		Stats *_stats = nil
+	);
+
+	// splits the rays into batches and traces them on all CPU cores;
+	// (the above functions are thread-safe and can also be called directly from worker threads)
+	void TraceRaysParallel(
+		const AVolume* _volume,
+		const Ray* _rays, UINT _count,
+		Hit *_hits,
+		const Options& _options = Options(),
+		Stats *_stats = nil
+	);
+
+	// a single ray between the two points
+	bool IntersectsLine(
+		const AVolume* _volume,
+		const Float3& _start, const Float3& _end,
+		Float3 &_point, Float3 &_normal,
+		const Options& _options = Options()
+	);
+
+}//namespace SphereTracing
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
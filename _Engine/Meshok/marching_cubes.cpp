@@ -14,6 +14,7 @@
 #pragma hdrstop
 #include <Meshok/Meshok.h>
 #include <Meshok/marching_cubes.h>
+#include <Meshok/Parallel.h>
 
 namespace MarchingCubes
 {
@@ -407,6 +408,26 @@ namespace MarchingCubes
 		normal = Float3_Normalized(normal);
 	}
 
+	// samples the distance field at all grid points of the XY-slab with the given Z coordinate
+	static void SampleSlab(
+		const AVolume* surface,
+		const Float3& _aabbMin, float stepX, float stepY, float z,
+		int numPointsX, int numPointsY,
+		Float3 *positions, float *distances
+		)
+	{
+		for( int iY = 0; iY < numPointsY; iY++ )
+		{
+			const float y = _aabbMin.y + iY * stepY;
+			Float3 * row = positions + iY * numPointsX;
+			for( int iX = 0; iX < numPointsX; iX++ )
+			{
+				row[iX] = Float3_Set( _aabbMin.x + iX * stepX, y, z );
+			}
+		}
+		surface->GetDistancesAt( positions, distances, numPointsX * numPointsY );
+	}
+
 	void Contour(const AVolume* surface,
 		const Float3& _aabbMin, const Float3& _aabbMax,
 		int gridSize[3],AMeshBuilder& _renderer)
@@ -419,15 +440,43 @@ namespace MarchingCubes
 		float stepY = (_aabbMax.y - _aabbMin.y)/numYSteps;
 		float stepZ = (_aabbMax.z - _aabbMin.z)/numZSteps;
 
-		for( int iX = 0; iX < numXSteps; iX++ )
+		// the grid is sampled slab by slab, each slab is evaluated with a single batched query;
+		// two adjacent slabs of grid points are needed to process a layer of cells
+		const int numPointsX = numXSteps + 1;
+		const int numPointsY = numYSteps + 1;
+		const UINT32 numPointsInSlab = numPointsX * numPointsY;
+
+		TArray< Float3 >	slabPositions;
+		TArray< float >		slabDistances[2];
+		if( mxFAILED(slabPositions.SetNum( numPointsInSlab ))
+			|| mxFAILED(slabDistances[0].SetNum( numPointsInSlab ))
+			|| mxFAILED(slabDistances[1].SetNum( numPointsInSlab )) )
+		{
+			ptERROR("MarchingCubes::Contour(): failed to allocate %u grid points\n", numPointsInSlab);
+			return;
+		}
+
+		SampleSlab( surface, _aabbMin, stepX, stepY, _aabbMin.z,
+			numPointsX, numPointsY, slabPositions.ToPtr(), slabDistances[0].ToPtr() );
+
+		for( int iZ = 0; iZ < numZSteps; iZ++ )
 		{
-			float x = _aabbMin.x + iX * stepX;
-			for( int iY = 0; iY < numXSteps; iY++ )
+			float z = _aabbMin.z + iZ * stepZ;
+
+			const float* bottom = slabDistances[ iZ & 1 ].ToPtr();
+			float* top = slabDistances[ (iZ + 1) & 1 ].ToPtr();
+
+			SampleSlab( surface, _aabbMin, stepX, stepY, z + stepZ,
+				numPointsX, numPointsY, slabPositions.ToPtr(), top );
+
+			const float* slabs[2] = { bottom, top };
+
+			for( int iY = 0; iY < numYSteps; iY++ )
 			{
 				float y = _aabbMin.y + iY * stepY;
-				for( int iZ = 0; iZ < numXSteps; iZ++ )
+				for( int iX = 0; iX < numXSteps; iX++ )
 				{
-					float z = _aabbMin.z + iZ * stepZ;
+					float x = _aabbMin.x + iX * stepX;
 
 					/*
 					Determine the index into the edge table which
@@ -436,24 +485,7 @@ namespace MarchingCubes
 					int cubeindex = 0;
 
 					SurfPoint corners[8];
-#if 0
-					for(int i=0; i<8; i++)
-					{
-						Float3 position;
-						position.x = x + ((i & CHILD_MASK_X) ? stepX : 0.0f);
-						position.y = y + ((i & CHILD_MASK_Y) ? stepY : 0.0f);
-						position.z = z + ((i & CHILD_MASK_Z) ? stepZ : 0.0f);
-
-						ASurface::Point sample = surface->Sample( x, y, z );
-						corners[i].normal = sample.normal;
-						corners[i].density = sample.density;
-						corners[i].position = position;
 
-						if(corners[i].density <= 0) {
-							cubeindex |= (1 << i);
-						}
-					}
-#else
 					Float3 min2, max2;
 					min2 = Float3_Set(x,y,z);
 					max2 = min2 + Float3_Set(stepX,stepY,stepZ);
@@ -462,41 +494,28 @@ namespace MarchingCubes
 					AABB_GetCorners(min2, max2, cube);
 					for(int i=0; i<8; i++)
 					{
-						AVolume::Sample sample = surface->SampleAt( cube[i] );
-						corners[i].normal = sample.normal;
-						corners[i].distance = sample.distance;
+						// corner offsets, see AABB_GetCorners()
+						const int dx = (i ^ (i >> 1)) & 1;
+						const int dy = (i >> 1) & 1;
+						const int dz = (i >> 2) & 1;
+						corners[i].distance = slabs[dz][ (iY + dy) * numPointsX + (iX + dx) ];
 						corners[i].position = cube[i];
 
 						if(corners[i].distance <= 0) {
 							cubeindex |= (1 << i);
 						}
 					}
-#endif
-
-#if 0
-					// bottom side
-					_renderer.DrawLine3D( corners[0].position, corners[1].position );
-					_renderer.DrawLine3D( corners[1].position, corners[3].position );
-					_renderer.DrawLine3D( corners[3].position, corners[2].position );
-					_renderer.DrawLine3D( corners[2].position, corners[0].position );
-
-					// bottom to top
-					_renderer.DrawLine3D( corners[0].position, corners[4].position );
-					_renderer.DrawLine3D( corners[1].position, corners[5].position );
-					_renderer.DrawLine3D( corners[3].position, corners[7].position );
-					_renderer.DrawLine3D( corners[2].position, corners[6].position );
-
-					// top side
-					_renderer.DrawLine3D( corners[4].position, corners[5].position );
-					_renderer.DrawLine3D( corners[5].position, corners[7].position );
-					_renderer.DrawLine3D( corners[7].position, corners[6].position );
-					_renderer.DrawLine3D( corners[6].position, corners[4].position );
-#endif
 
 					int edge = mcEdges[cubeindex];
 
 					if (edge)
 					{
+						// gradients are only needed for cells intersecting the surface
+						for(int i=0; i<8; i++)
+						{
+							corners[i].normal = surface->GetNormalAt( cube[i] );
+						}
+
 						// Find the intersection vertices.
 						Float3 intersectionPoints[12];
 						Float3 intersectionNormals[12];
@@ -555,9 +574,6 @@ namespace MarchingCubes
 							a.N = PackNormal(n1);
 							b.N = PackNormal(n2);
 							c.N = PackNormal(n3);
-							//a.rgba.v = SColor::White;
-							//b.rgba.v = SColor::White;
-							//c.rgba.v = SColor::White;
 							
 							int i1 = _renderer.AddVertex(a);
 							int i2 = _renderer.AddVertex(b);
@@ -572,150 +588,389 @@ namespace MarchingCubes
 			}
 		}
 	}
-#if 0
+	//=====================================================================
+	//	PARALLEL, SLAB-BASED CONTOURING WITH SHARED VERTICES
+	//=====================================================================
+
+	// location of each cube edge (in the same order as used by the tables):
+	// the axis of the edge and the offset of its lower endpoint relative to the cell's min corner
+	struct CubeEdge {
+		UINT8	axis;	// 0 = X, 1 = Y, 2 = Z
+		UINT8	dx, dy, dz;
+	};
+	static const CubeEdge g_cubeEdges[12] = {
+		{ 0,	0, 0, 0 },	// 0: c0 - c1
+		{ 1,	1, 0, 0 },	// 1: c1 - c2
+		{ 0,	0, 1, 0 },	// 2: c3 - c2
+		{ 1,	0, 0, 0 },	// 3: c0 - c3
+		{ 0,	0, 0, 1 },	// 4: c4 - c5
+		{ 1,	1, 0, 1 },	// 5: c5 - c6
+		{ 0,	0, 1, 1 },	// 6: c7 - c6
+		{ 1,	0, 0, 1 },	// 7: c4 - c7
+		{ 2,	0, 0, 0 },	// 8: c0 - c4
+		{ 2,	1, 0, 0 },	// 9: c1 - c5
+		{ 2,	1, 1, 0 },	// 10: c2 - c6
+		{ 2,	0, 1, 0 },	// 11: c3 - c7
+	};
 
-	void Triangulate(
-		const AVolume* surface,
-		const Float3& _min, const Float3& _max,
-		int numStepsX, int numStepsY, int numStepsZ,
-		AMeshBuilder& _mesh
-	)
+	// a single XY-plane of grid points;
+	// owns vertices on X- and Y-edges lying in the plane and on Z-edges going up to the next plane
+	struct MC_Plane
+	{
+		TArray< float >			distances;		// sampled distance values
+		TArray< DrawVertex >	vertices;		// vertices created on this plane
+		TArray< INT32 >			edgeVertex[3];	// local vertex index for X,Y,Z edges starting at each grid point or -1
+		UINT32					firstVertex;	// the index of the first vertex in the resulting mesh
+	};
+
+	// a layer of cells between two adjacent planes
+	struct MC_Slab
+	{
+		TArray< UINT32 >	indices;	// triangle list, indices into the resulting mesh
+	};
+
+	struct MC_Grid
 	{
-		const UINT32 startTimeMSec = mxGetTimeInMilliseconds();
+		const AVolume *	surface;
+		Float3		origin;
+		Float3		cellSize;
+		int			numCells[3];
+		int			numPoints[3];	// numCells + 1
+		TArray< MC_Plane >	planes;	// numPoints[2]
+		TArray< MC_Slab >	slabs;	// numCells[2]
+		AtomicInt	failed;	// non-zero if a worker ran out of memory
+	public:
+		UINT32 PointIndex( int x, int y ) const {
+			return y * numPoints[0] + x;
+		}
+		Float3 PointPosition( int x, int y, int z ) const {
+			return Float3_Set(
+				origin.x + x * cellSize.x,
+				origin.y + y * cellSize.y,
+				origin.z + z * cellSize.z
+			);
+		}
+	};
+
+	// Phase 1: evaluates the distance field at all points of the plane (in batches)
+	static void MC_SamplePlane( UINT _planeIndex, UINT _threadIndex, void* _userData )
+	{
+		MC_Grid & grid = *static_cast< MC_Grid* >( _userData );
+		MC_Plane & plane = grid.planes[ _planeIndex ];
+
+		const UINT32 numPointsInPlane = grid.numPoints[0] * grid.numPoints[1];
+		if( mxFAILED(plane.distances.SetNum( numPointsInPlane )) ) {
+			AtomicExchange( &grid.failed, 1 );
+			return;
+		}
 
-		float stepX = (_max.x - _min.x)/numStepsX;
-		float stepY = (_max.y - _min.y)/numStepsY;
-		float stepZ = (_max.z - _min.z)/numStepsZ;
+		Float3	positions[ AVolume::MAX_BATCH_SIZE ];
 
-		for( int iX = 0; iX < numStepsX; iX++ )
+		UINT32 start = 0;
+		while( start < numPointsInPlane )
 		{
-			float x = _min.x + iX * stepX;
-			for( int iY = 0; iY < numStepsX; iY++ )
+			const UINT32 batchSize = smallest( numPointsInPlane - start, (UINT32)AVolume::MAX_BATCH_SIZE );
+			for( UINT32 i = 0; i < batchSize; i++ )
 			{
-				float y = _min.y + iY * stepY;
-				for( int iZ = 0; iZ < numStepsX; iZ++ )
-				{
-					float z = _min.z + iZ * stepZ;
+				const UINT32 pointIndex = start + i;
+				positions[i] = grid.PointPosition( pointIndex % grid.numPoints[0], pointIndex / grid.numPoints[0], _planeIndex );
+			}
+			grid.surface->GetDistancesAt( positions, plane.distances.ToPtr() + start, batchSize );
+			start += batchSize;
+		}
+	}
 
-					/*
-					Determine the index into the edge table which
-					tells us which vertices are inside of the surface
-					*/
-//					int cubeindex = 0;
+	static inline bool MC_IsInside( float distance ) {
+		return distance <= ISO_LEVEL;
+	}
 
-					UNDONE;
-#if 0
-					AVolume::Sample samples[8];
-					Volume			corners[8];
+	// computes normals for the given vertices using central differences (six samples per vertex in one batch)
+	static void MC_ComputeNormals( const AVolume* surface, DrawVertex* vertices, UINT32 numVertices )
+	{
+		enum { VERTS_PER_BATCH = AVolume::MAX_BATCH_SIZE / 6 };
+		const float D = 1e-3f;
 
-					Float3 min2, max2;
-					min2 = Float3_Set(x,y,z);
-					max2 = min2 + Float3_Set(stepX,stepY,stepZ);
+		Float3	points[ VERTS_PER_BATCH * 6 ];
+		float	d[ VERTS_PER_BATCH * 6 ];
 
-					Float3 cube[8];
-					AABB_GetCorners(min2, max2, cube);
-					for(int i=0; i<8; i++)
-					{
-						AVolume::Sample sample = surface->SampleAt( cube[i] );
-						corners[i].normal = sample.normal;
-						corners[i].density = sample.density;
-						corners[i].position = cube[i];
+		UINT32 start = 0;
+		while( start < numVertices )
+		{
+			const UINT32 batchSize = smallest( numVertices - start, (UINT32)VERTS_PER_BATCH );
+			for( UINT32 i = 0; i < batchSize; i++ )
+			{
+				const Float3& P = vertices[ start + i ].xyz;
+				Float3 * p = points + i * 6;
+				p[0] = P + Float3_Set(D, 0.f, 0.f);
+				p[1] = P - Float3_Set(D, 0.f, 0.f);
+				p[2] = P + Float3_Set(0.f, D, 0.f);
+				p[3] = P - Float3_Set(0.f, D, 0.f);
+				p[4] = P + Float3_Set(0.f, 0.f, D);
+				p[5] = P - Float3_Set(0.f, 0.f, D);
+			}
+			surface->GetDistancesAt( points, d, batchSize * 6 );
+			for( UINT32 i = 0; i < batchSize; i++ )
+			{
+				const float* di = d + i * 6;
+				const Float3 N = Float3_Normalized( Float3_Set( di[0] - di[1], di[2] - di[3], di[4] - di[5] ) );
+				vertices[ start + i ].N = PackNormal( N );
+			}
+			start += batchSize;
+		}
+	}
 
-						if(corners[i].density <= 0) {
-							cubeindex |= (1 << i);
-						}
-					}
+	// Phase 2: creates a vertex on each sign-changing edge owned by the plane
+	static void MC_CreatePlaneVertices( UINT _planeIndex, UINT _threadIndex, void* _userData )
+	{
+		MC_Grid & grid = *static_cast< MC_Grid* >( _userData );
+		MC_Plane & plane = grid.planes[ _planeIndex ];
+		if( !plane.distances.Num() ) {
+			return;	// sampling failed
+		}
 
+		// the next plane is needed for Z-edges
+		const bool hasUpperPlane = ( _planeIndex + 1 < grid.planes.Num() );
+		const float* distances = plane.distances.ToPtr();
+		const float* upperDistances = hasUpperPlane ? grid.planes[ _planeIndex + 1 ].distances.ToPtr() : nil;
+		if( hasUpperPlane && !grid.planes[ _planeIndex + 1 ].distances.Num() ) {
+			return;
+		}
 
+		const UINT32 numPointsInPlane = grid.numPoints[0] * grid.numPoints[1];
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			if( mxFAILED(plane.edgeVertex[axis].SetNum( numPointsInPlane )) ) {
+				AtomicExchange( &grid.failed, 1 );
+				return;
+			}
+			memset( plane.edgeVertex[axis].ToPtr(), -1, numPointsInPlane * sizeof(INT32) );
+		}
 
-					int edge = mcEdges[cubeindex];
+		DrawVertex	vertex;
+		mxZERO_OUT( vertex );
 
-					if (edge)
+		for( int iY = 0; iY < grid.numPoints[1]; iY++ )
+		{
+			for( int iX = 0; iX < grid.numPoints[0]; iX++ )
+			{
+				const UINT32 pointIndex = grid.PointIndex( iX, iY );
+				const float d0 = distances[ pointIndex ];
+				const Float3 p0 = grid.PointPosition( iX, iY, _planeIndex );
+
+				// the other endpoints of X, Y and Z edges
+				float	d1[3];
+				Float3	p1[3];
+				bool	hasEdge[3];
+				hasEdge[0] = ( iX + 1 < grid.numPoints[0] );
+				hasEdge[1] = ( iY + 1 < grid.numPoints[1] );
+				hasEdge[2] = hasUpperPlane;
+				if( hasEdge[0] ) {
+					d1[0] = distances[ pointIndex + 1 ];
+					p1[0] = grid.PointPosition( iX + 1, iY, _planeIndex );
+				}
+				if( hasEdge[1] ) {
+					d1[1] = distances[ pointIndex + grid.numPoints[0] ];
+					p1[1] = grid.PointPosition( iX, iY + 1, _planeIndex );
+				}
+				if( hasEdge[2] ) {
+					d1[2] = upperDistances[ pointIndex ];
+					p1[2] = grid.PointPosition( iX, iY, _planeIndex + 1 );
+				}
+
+				for( int axis = 0; axis < 3; axis++ )
+				{
+					if( hasEdge[axis] && MC_IsInside( d0 ) != MC_IsInside( d1[axis] ) )
 					{
-						// Find the intersection vertices.
-						Float3 intersectionPoints[12];
-						Float3 intersectionNormals[12];
-						if (edge & 1) {
-							interpolate(corners[0], corners[1], intersectionPoints[0], intersectionNormals[0]);
-						}
-						if (edge & 2) {
-							interpolate(corners[1], corners[2], intersectionPoints[1], intersectionNormals[1]);
-						}
-						if (edge & 4) {
-							interpolate(corners[2], corners[3], intersectionPoints[2], intersectionNormals[2]);
-						}
-						if (edge & 8) {
-							interpolate(corners[3], corners[0], intersectionPoints[3], intersectionNormals[3]);
-						}
-						if (edge & 16) {
-							interpolate(corners[4], corners[5], intersectionPoints[4], intersectionNormals[4]);
-						}
-						if (edge & 32) {
-							interpolate(corners[5], corners[6], intersectionPoints[5], intersectionNormals[5]);
-						}
-						if (edge & 64) {
-							interpolate(corners[6], corners[7], intersectionPoints[6], intersectionNormals[6]);
-						}
-						if (edge & 128) {
-							interpolate(corners[7], corners[4], intersectionPoints[7], intersectionNormals[7]);
-						}
-						if (edge & 256) {
-							interpolate(corners[0], corners[4], intersectionPoints[8], intersectionNormals[8]);
-						}
-						if (edge & 512) {
-							interpolate(corners[1], corners[5], intersectionPoints[9], intersectionNormals[9]);
-						}
-						if (edge & 1024) {
-							interpolate(corners[2], corners[6], intersectionPoints[10], intersectionNormals[10]);
-						}
-						if (edge & 2048) {
-							interpolate(corners[3], corners[7], intersectionPoints[11], intersectionNormals[11]);
+						const float mu = (ISO_LEVEL - d0) / (d1[axis] - d0);
+						vertex.xyz = p0 + (p1[axis] - p0) * mu;
+						plane.edgeVertex[axis][ pointIndex ] = plane.vertices.Num();
+						DrawVertex* newVertex = plane.vertices.AddManyUninitialized( 1 );
+						if( !newVertex ) {
+							AtomicExchange( &grid.failed, 1 );
+							return;
 						}
+						*newVertex = vertex;
+					}
+				}
+			}
+		}
 
-						// Create the triangles according to the table.
-						for (int i = 0; mcTriangles[cubeindex][i] != -1; i += 3)
-						{
-							const Float3& p1 = intersectionPoints[mcTriangles[cubeindex][i]];
-							const Float3& p2 = intersectionPoints[mcTriangles[cubeindex][i + 1]];
-							const Float3& p3 = intersectionPoints[mcTriangles[cubeindex][i + 2]];
+		MC_ComputeNormals( grid.surface, plane.vertices.ToPtr(), plane.vertices.Num() );
+	}
 
-							const Float3& n1 = intersectionNormals[mcTriangles[cubeindex][i]];
-							const Float3& n2 = intersectionNormals[mcTriangles[cubeindex][i + 1]];
-							const Float3& n3 = intersectionNormals[mcTriangles[cubeindex][i + 2]];
+	// Phase 3: triangulates a layer of cells, shared vertices are looked up in the lower and the upper planes
+	static void MC_TriangulateSlab( UINT _slabIndex, UINT _threadIndex, void* _userData )
+	{
+		MC_Grid & grid = *static_cast< MC_Grid* >( _userData );
+		MC_Slab & slab = grid.slabs[ _slabIndex ];
+		const MC_Plane* planes[2] = { &grid.planes[ _slabIndex ], &grid.planes[ _slabIndex + 1 ] };
+		if( !planes[0]->edgeVertex[0].Num() || !planes[1]->edgeVertex[0].Num() ) {
+			return;
+		}
 
-							AuxVertex	a, b, c;
-							a.xyz = p1;
-							b.xyz = p2;
-							c.xyz = p3;
-							a.N = PackNormal(n1);
-							b.N = PackNormal(n2);
-							c.N = PackNormal(n3);
-							a.rgba.v = SColor::White;
-							b.rgba.v = SColor::White;
-							c.rgba.v = SColor::White;
+		for( int iY = 0; iY < grid.numCells[1]; iY++ )
+		{
+			for( int iX = 0; iX < grid.numCells[0]; iX++ )
+			{
+				int cubeindex = 0;
+				for( int i = 0; i < 8; i++ )
+				{
+					// corner offsets, see AABB_GetCorners()
+					const int dx = (i ^ (i >> 1)) & 1;
+					const int dy = (i >> 1) & 1;
+					const int dz = (i >> 2) & 1;
+					if( MC_IsInside( planes[dz]->distances[ grid.PointIndex( iX + dx, iY + dy ) ] ) ) {
+						cubeindex |= (1 << i);
+					}
+				}
 
-							_renderer.DrawSolidTriangle3D(a, b, c);
-						}
+				const int edge = mcEdges[cubeindex];
+				if( !edge ) {
+					continue;
+				}
+
+				UINT32	edgeVertices[12];
+				for( int iEdge = 0; iEdge < 12; iEdge++ )
+				{
+					if( edge & (1 << iEdge) )
+					{
+						const CubeEdge& e = g_cubeEdges[ iEdge ];
+						const MC_Plane& plane = *planes[ e.dz ];
+						const INT32 localIndex = plane.edgeVertex[ e.axis ][ grid.PointIndex( iX + e.dx, iY + e.dy ) ];
+						mxASSERT( localIndex >= 0 );
+						edgeVertices[ iEdge ] = plane.firstVertex + localIndex;
 					}
-#endif
 				}
+
+				for( int i = 0; mcTriangles[cubeindex][i] != -1; i += 3 )
+				{
+					UINT32* triangle = slab.indices.AddManyUninitialized( 3 );
+					if( !triangle ) {
+						AtomicExchange( &grid.failed, 1 );
+						return;
+					}
+					//NOTE: change winding order - otherwise, triangles are backfacing
+					triangle[0] = edgeVertices[ mcTriangles[cubeindex][i + 2] ];
+					triangle[1] = edgeVertices[ mcTriangles[cubeindex][i + 1] ];
+					triangle[2] = edgeVertices[ mcTriangles[cubeindex][i] ];
+				}
+			}
+		}
+	}
+
+	void Triangulate(
+		const AVolume* surface,
+		const Float3& _min, const Float3& _max,
+		int gridSizeX, int gridSizeY, int gridSizeZ,
+		AMeshBuilder& _mesh,
+		MC_Stats* _stats
+	)
+	{
+		const UINT64 startTime = mxGetTimeInMicroseconds();
+
+		MC_Grid	grid;
+		grid.surface = surface;
+		grid.origin = _min;
+		grid.numCells[0] = Max( gridSizeX, 1 );
+		grid.numCells[1] = Max( gridSizeY, 1 );
+		grid.numCells[2] = Max( gridSizeZ, 1 );
+		grid.cellSize = Float3_Set(
+			(_max.x - _min.x) / grid.numCells[0],
+			(_max.y - _min.y) / grid.numCells[1],
+			(_max.z - _min.z) / grid.numCells[2]
+		);
+		for( int i = 0; i < 3; i++ ) {
+			grid.numPoints[i] = grid.numCells[i] + 1;
+		}
+		grid.failed = 0;
+
+		if( mxFAILED(grid.planes.SetNum( grid.numPoints[2] )) || mxFAILED(grid.slabs.SetNum( grid.numCells[2] )) ) {
+			ptERROR("MarchingCubes::Triangulate(): out of memory\n");
+			return;
+		}
+
+		// Phase 1: sample the distance field
+		Meshok::ParallelFor( grid.planes.Num(), &MC_SamplePlane, &grid );
+		const UINT64 samplingEndTime = mxGetTimeInMicroseconds();
+
+		// Phase 2: create shared vertices on sign-changing edges
+		Meshok::ParallelFor( grid.planes.Num(), &MC_CreatePlaneVertices, &grid );
+
+		// assign vertex ranges in plane order so that the result doesn't depend on scheduling
+		UINT32 numVertices = 0;
+		for( UINT32 i = 0; i < grid.planes.Num(); i++ )
+		{
+			grid.planes[i].firstVertex = numVertices;
+			numVertices += grid.planes[i].vertices.Num();
+		}
+		const UINT64 verticesEndTime = mxGetTimeInMicroseconds();
+
+		// Phase 3: triangulate cells
+		Meshok::ParallelFor( grid.slabs.Num(), &MC_TriangulateSlab, &grid );
+		const UINT64 trianglesEndTime = mxGetTimeInMicroseconds();
+
+		if( grid.failed ) {
+			ptERROR("MarchingCubes::Triangulate(): out of memory\n");
+			return;
+		}
+
+		// Phase 4: stitch the slabs together (serially, in order)
+		TArray< int >	remap;	// maps vertex indices to indices returned by the mesh builder
+		if( mxFAILED(remap.SetNum( numVertices )) ) {
+			ptERROR("MarchingCubes::Triangulate(): out of memory\n");
+			return;
+		}
+		for( UINT32 iPlane = 0; iPlane < grid.planes.Num(); iPlane++ )
+		{
+			const MC_Plane& plane = grid.planes[ iPlane ];
+			for( UINT32 i = 0; i < plane.vertices.Num(); i++ )
+			{
+				remap[ plane.firstVertex + i ] = _mesh.AddVertex( plane.vertices[i] );
+			}
+		}
+		UINT32 numTriangles = 0;
+		for( UINT32 iSlab = 0; iSlab < grid.slabs.Num(); iSlab++ )
+		{
+			const MC_Slab& slab = grid.slabs[ iSlab ];
+			const UINT32* indices = slab.indices.ToPtr();
+			for( UINT32 i = 0; i < slab.indices.Num(); i += 3 )
+			{
+				_mesh.AddTriangle( remap[ indices[i] ], remap[ indices[i+1] ], remap[ indices[i+2] ] );
 			}
+			numTriangles += slab.indices.Num() / 3;
 		}
+		const UINT64 endTime = mxGetTimeInMicroseconds();
 
-		const UINT32 currentTimeMSec = mxGetTimeInMilliseconds();
-		DBGOUT("Octree::Triangulate(): %u verts, %u indices in %u msec\n",
-			_mesh.vertices.Num(), _mesh.indices.Num(), currentTimeMSec - startTimeMSec);
+		if( _stats )
+		{
+			_stats->m_numPolygons = numTriangles;
+			_stats->m_numVertices = numVertices;
+			_stats->m_numSlabs = grid.slabs.Num();
+			_stats->m_numThreads = Meshok::ParallelFor_GetMaxThreads();
+			_stats->m_samplingTime = (UINT32)( samplingEndTime - startTime );
+			_stats->m_verticesTime = (UINT32)( verticesEndTime - samplingEndTime );
+			_stats->m_trianglesTime = (UINT32)( trianglesEndTime - verticesEndTime );
+			_stats->m_stitchingTime = (UINT32)( endTime - trianglesEndTime );
+		}
 	}
-#endif
 
 MC_Stats::MC_Stats()
 {
 	mxZERO_OUT( *this );
 }
+float MC_Stats::GetVertexReuseRatio() const
+{
+	return m_numVertices ? (m_numPolygons * 3.0f) / m_numVertices : 0.0f;
+}
 void MC_Stats::Print( UINT32 elapsedTimeMSec )
 {
 	DBGOUT( "\n=== Marching Cubes statistics ========\n" );
 	DBGOUT( "Num. Polys: %u\n", m_numPolygons	 );
+	DBGOUT( "Num. Verts: %u (reuse ratio: %.2f)\n", m_numVertices, GetVertexReuseRatio() );
+	DBGOUT( "Slabs: %u, threads: %u\n", m_numSlabs, m_numThreads );
+	DBGOUT( "Sampling: %u usec, vertices: %u usec, triangles: %u usec, stitching: %u usec\n",
+		m_samplingTime, m_verticesTime, m_trianglesTime, m_stitchingTime );
+	DBGOUT( "Total time: %u msec\n", elapsedTimeMSec );
 	DBGOUT( "==== End ====================\n" );
 }
 
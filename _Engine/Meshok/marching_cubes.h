@@ -9,21 +9,36 @@ namespace MarchingCubes
 		const Float3& _aabbMin, const Float3& _aabbMax,
 		int gridSize[3], AMeshBuilder& _renderer);
 
-	void Triangulate(
-		const AVolume* surface,
-		const Float3& _min, const Float3& _max,
-		int gridSizeX, int gridSizeY, int gridSizeZ,
-		AMeshBuilder& _mesh
-	);
-
 	class MC_Stats {
 	public:
 		UINT32		m_numPolygons;	// number of resulting polygons
+		UINT32		m_numVertices;	// number of unique (welded) vertices
+		UINT32		m_numSlabs;		// number of Z-slabs processed in parallel
+		UINT32		m_numThreads;
+		// time spent in each phase, in microseconds
+		UINT32		m_samplingTime;	// evaluating the distance field at grid points
+		UINT32		m_verticesTime;	// creating vertices on sign-changing edges
+		UINT32		m_trianglesTime;// triangulating cells
+		UINT32		m_stitchingTime;// merging slabs and sending the mesh to the builder
 	public:
 		MC_Stats();
+		// vertices referenced by triangles divided by unique vertices (1 means no sharing, ~6 for closed surfaces)
+		float GetVertexReuseRatio() const;
 		void Print( UINT32 elapsedTimeMSec );
 	};
 
+	// Multithreaded version which produces an indexed mesh:
+	// the grid is split into Z-slabs which are processed by worker threads,
+	// each vertex on a sign-changing edge is created only once and shared by all adjacent cells.
+	// The output is deterministic (doesn't depend on the number of threads).
+	void Triangulate(
+		const AVolume* surface,
+		const Float3& _min, const Float3& _max,
+		int gridSizeX, int gridSizeY, int gridSizeZ,
+		AMeshBuilder& _mesh,
+		MC_Stats* _stats = nil
+	);
+
 	void GenerateEdgeTable( UINT16 edgeTable[256] );
 	void GenerateTriangleTable( UINT16 triangleTable[256] );
 
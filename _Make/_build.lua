@@ -35,6 +35,14 @@ newoption {
 	trigger = "with-tools",
 	description = "Enable building tools.",
 }
+newoption {
+	trigger = "with-fpu-math",
+	description = "Use the scalar backend of the math library instead of SSE.",
+}
+newoption {
+	trigger = "with-avx",
+	description = "Enable AVX in the math library (requires VS2010 SP1 or later).",
+}
 
 -- e.g. "vs2010" or ""
 local action = _ACTION or ""
@@ -79,6 +87,15 @@ solution 'SummerTraining'
 
 	language "C++"
 
+	if _OPTIONS["with-fpu-math"] then
+		defines { "MM_ENABLE_INTRINSICS=0" }
+	end
+
+	if _OPTIONS["with-avx"] then
+		defines { "MM_ENABLE_AVX=1" }
+		buildoptions { "/arch:AVX" }
+	end
+
 -- needed for bgfx
 function copyLib()
 end
@@ -444,6 +461,70 @@ function DemoProject(_name)
 	strip()
 end
 
+function ToolProject(_name)
+
+	project (_name)
+		uuid (os.uuid(_name))
+		kind "ConsoleApp"
+
+	defines {
+		"WIN32", "_WIN32",
+		"_HAS_EXCEPTIONS=0",
+		"_HAS_ITERATOR_DEBUGGING=0",
+		"_SCL_SECURE=0", "_SECURE_SCL=0",
+		"_SCL_SECURE_NO_WARNINGS",
+		"_CRT_SECURE_NO_WARNINGS",
+		"_CRT_SECURE_NO_DEPRECATE",
+		"MX_AUTOLINK=0",
+	}
+
+	files {
+		path.join(G_ROOT_DIR, "_Tools", _name, "**.h"),
+		path.join(G_ROOT_DIR, "_Tools", _name, "**.cpp"),
+	}
+
+	includedirs {
+		G_ENGINE_DIR,
+	}
+
+	links {
+		-- Windows
+		"gdi32",
+		"psapi",
+		"winmm",	-- timeGetTime()
+		"Dbghelp",	-- MiniDumpWriteDump(), SymFromAddr()
+		"comctl32", "Imm32",
+
+		-- Engine
+		"Engine",
+	}
+
+	configuration { "Debug" }
+		targetsuffix "-Debug"
+
+	configuration { "Release" }
+		flags {
+			"OptimizeSpeed",
+		}
+		targetsuffix "-Release"
+
+	configuration { "x32", "vs*" }
+		targetdir (path.join(G_BINARIES_DIR, "x86"))
+		objdir (path.join(G_BUILD_DIR, "win32_" .. _ACTION, "obj", _name))
+		libdirs {
+			path.join(G_BUILD_DIR, "win32_" .. _ACTION, "bin"),
+		}
+
+	configuration { "x64", "vs*" }
+		targetdir (path.join(G_BINARIES_DIR, "x64"))
+		objdir (path.join(G_BUILD_DIR, "win64_" .. _ACTION, "obj", _name))
+		libdirs {
+			path.join(G_BUILD_DIR, "win64_" .. _ACTION, "bin"),
+		}
+
+	configuration {} -- reset configuration
+end
+
 configuration {} -- reset configuration
 
 group "libs"
@@ -629,4 +710,19 @@ project ("BSP-CSG")
 	configuration {} -- reset configuration
 
 
+if _OPTIONS["with-tools"] then
+
+group "tools"
+
+ToolProject("PakTool")
+ToolProject("AssetBuild")
+ToolProject("MathBench")
+ToolProject("MemBench")
+ToolProject("MemReport")
+ToolProject("MeshBench")
+ToolProject("CoreBench")
+
+end
+
+
 startproject "BSP-CSG"
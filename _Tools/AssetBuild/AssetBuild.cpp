@@ -0,0 +1,124 @@
+/*
+=============================================================================
+	File:	AssetBuild.cpp
+	Desc:	Command-line tool for incremental building of assets (shaders).
+	Usage:	AssetBuild <source folder> <output folder> [-shaderc <exe>] [-i <include paths>] [-force] [-threads N]
+=============================================================================
+*/
+#include <Base/Base.h>
+#include <Base/Util/LogUtil.h>
+#include <Core/Core.h>
+#include <EditorSupport/AssetBuildCache.h>
+
+static void PrintUsage()
+{
+	printf("Usage: AssetBuild <source folder> <output folder> [-shaderc <exe>] [-i <include paths>] [-force] [-threads N]\n");
+	printf("  -shaderc     path to the shader compiler (default: shaderc.exe)\n");
+	printf("  -i           semicolon-separated include folders (default: bgfx/src;bgfx/examples/common)\n");
+	printf("  -force       rebuild all assets, ignoring the build cache\n");
+	printf("  -threads N   the max. number of assets compiled at the same time (default: all threads)\n");
+}
+
+struct ShaderCompilerSettings
+{
+	const char *	shadercPath;
+	const char *	includePaths;
+};
+
+static ERet CompileShader( const AssetBuildCache::BuildJob& _job )
+{
+	const ShaderCompilerSettings& compiler = *static_cast< const ShaderCompilerSettings* >( _job.rule->userData );
+
+	const char* fileName = Str::GetFileName( _job.sourceFile );
+	const char* shaderType = NULL;
+	const char* shaderProfile = NULL;
+	if( !strnicmp( fileName, "fs_", 3 ) ) {
+		shaderType = "f";
+		shaderProfile = "ps_4_0";
+	} else if( !strnicmp( fileName, "vs_", 3 ) ) {
+		shaderType = "v";
+		shaderProfile = "vs_4_0";
+	} else {
+		ptWARN("'%s': unknown shader type, the file name must start with 'fs_' or 'vs_'.\n", fileName);
+		return ERR_INVALID_PARAMETER;
+	}
+
+	// the varying definitions are in the folder of the source file
+	String256	varyingDef;
+	Str::CopyS( varyingDef, _job.sourceFile );
+	Str::StripFileName( varyingDef );
+	Str::AppendS( varyingDef, _job.rule->implicitDependency );
+
+	String512	commandLine;
+	Str::SPrintF( commandLine, "\"%s\" -f \"%s\" -o \"%s\" --type %s --platform windows --profile %s -O3 -i \"%s\" --varyingdef \"%s\"",
+		compiler.shadercPath, _job.sourceFile, _job.outputFile, shaderType, shaderProfile, compiler.includePaths, varyingDef.c_str() );
+
+	DBGOUT("Compiling '%s'.\n", _job.sourceFile);
+	return AssetBuildCache::RunCommand( commandLine.c_str() );
+}
+
+static ERet MyEntryPoint( int argc, char** argv )
+{
+	SetupBaseUtil	setupBase;
+	FileLogUtil		fileLog;
+	SetupCoreUtil	setupCore;
+
+	if( argc < 3 ) {
+		PrintUsage();
+		return ERR_INVALID_PARAMETER;
+	}
+
+	AssetBuildCache::Settings	settings;
+	settings.sourceFolder = argv[1];
+	settings.outputFolder = argv[2];
+
+	ShaderCompilerSettings	compiler;
+	compiler.shadercPath = "shaderc.exe";
+	compiler.includePaths = "bgfx/src;bgfx/examples/common";
+
+	for( int i = 3; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-shaderc" ) && i + 1 < argc ) {
+			compiler.shadercPath = argv[++i];
+		} else if( !strcmp( argv[i], "-i" ) && i + 1 < argc ) {
+			compiler.includePaths = argv[++i];
+		} else if( !strcmp( argv[i], "-force" ) ) {
+			settings.forceRebuild = true;
+		} else if( !strcmp( argv[i], "-threads" ) && i + 1 < argc ) {
+			settings.maxThreads = atoi( argv[++i] );
+		} else {
+			printf("Unknown option: '%s'\n", argv[i]);
+			PrintUsage();
+			return ERR_INVALID_PARAMETER;
+		}
+	}
+
+	// the compiler options are hashed into the build key, so changing them rebuilds all shaders
+	String256	shaderSettings;
+	Str::SPrintF( shaderSettings, "--platform windows -O3 -i %s", compiler.includePaths );
+
+	AssetBuildCache::Rule	shaderRule;
+	shaderRule.sourceExtension = "sc";
+	shaderRule.outputExtension = "bin";
+	shaderRule.assetType = AssetTypes::SHADER;
+	shaderRule.settings = shaderSettings.c_str();
+	shaderRule.includePaths = compiler.includePaths;
+	shaderRule.implicitDependency = "varying.def.sc";
+	shaderRule.build = &CompileShader;
+	shaderRule.userData = &compiler;
+
+	AssetBuildCache::Stats	stats;
+	mxDO(AssetBuildCache::Build( settings, &shaderRule, 1, &stats ));
+
+	return ALL_OK;
+}
+
+int main( int argc, char** argv )
+{
+	const ERet result = MyEntryPoint( argc, argv );
+	return mxSUCCEDED(result) ? 0 : 1;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
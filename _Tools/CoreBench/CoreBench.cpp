@@ -0,0 +1,123 @@
+/*
+=============================================================================
+	File:	CoreBench.cpp
+	Desc:	Checks the asset loader and measures the speed of the core object model.
+	Usage:	CoreBench [-cancel <package.pak> <clump name>] [-requests N] [-clump <clump file>] [-index N]
+=============================================================================
+*/
+#include <Base/Base.h>
+#include <Base/Util/LogUtil.h>
+#include <Core/Core.h>
+#include <Core/AssetPackage.h>
+#include <Core/Serialization.h>
+
+static void PrintUsage()
+{
+	printf("Usage: CoreBench [-cancel <package.pak> <clump name>] [-requests N] [-clump <clump file>] [-index N]\n");
+	printf("  -cancel      load the clump from the package and cancel the requests while they are in flight\n");
+	printf("  -requests N  the number of cancelled load requests (default: 64)\n");
+	printf("  -clump       compare the relocation tables of the clump image with the legacy format\n");
+	printf("  -index N     compare linear and indexed lookups of N asset exports in a clump\n");
+}
+
+// mounts the package and checks that cancelled load requests release all their memory
+static ERet TestLoadCancellation( const char* _packageFile, const char* _clumpName, UINT32 _numRequests )
+{
+	AssetPackage	package;
+	mxDO(package.Open( _packageFile ));
+	mxDO(Assets::MountPackage( &package ));
+
+	const ERet result = Assets::TestLoadCancellation( MakeAssetID( _clumpName ), _numRequests );
+
+	Assets::UnmountPackage( &package );
+
+	if( package.NumMappedFiles() ) {
+		ptERROR("%u file views haven't been released.\n", package.NumMappedFiles());
+		return ERR_VALIDATION_FAILED;
+	}
+	return result;
+}
+
+// loads the clump image (without bringing it online) and measures the time of patching it
+static ERet BenchmarkClump( const char* _fileName )
+{
+	FileReader	file;
+	mxDO(file.Open( _fileName ));
+
+	Serialization::ImageHeader	header;
+	mxDO(file.Get( header ));
+	chkRET_X_IF_NOT(header.classId == Clump::MetaClass().GetTypeID(), ERR_OBJECT_OF_WRONG_TYPE);
+
+	void* buffer = Clump::Alloc( header.payload );
+	chkRET_X_IF_NIL(buffer, ERR_OUT_OF_MEMORY);
+
+	ERet result = Serialization::LoadClumpImage( file, header.payload, buffer );
+	if( mxSUCCEDED(result) )
+	{
+		Clump* clump = static_cast< Clump* >( buffer );
+		ptPRINT("Benchmarking clump '%s'.\n", _fileName);
+		result = Serialization::BenchmarkClumpImage( *clump );
+		clump->~Clump();
+	}
+	Clump::Free( buffer );
+
+	return result;
+}
+
+static ERet MyEntryPoint( int argc, char** argv )
+{
+	SetupBaseUtil	setupBase;
+	FileLogUtil		fileLog;
+	SetupCoreUtil	setupCore;
+
+	const char* packageFile = nil;
+	const char* clumpName = nil;
+	UINT32 numRequests = 64;
+	const char* clumpToBenchmark = nil;
+	UINT32 numIndexedObjects = 0;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-cancel" ) && i + 2 < argc ) {
+			packageFile = argv[++i];
+			clumpName = argv[++i];
+		} else if( !strcmp( argv[i], "-requests" ) && i + 1 < argc ) {
+			numRequests = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-clump" ) && i + 1 < argc ) {
+			clumpToBenchmark = argv[++i];
+		} else if( !strcmp( argv[i], "-index" ) && i + 1 < argc ) {
+			numIndexedObjects = atoi( argv[++i] );
+		} else {
+			printf("Unknown option: '%s'\n", argv[i]);
+			PrintUsage();
+			return ERR_INVALID_PARAMETER;
+		}
+	}
+
+	if( !packageFile && !clumpToBenchmark && !numIndexedObjects ) {
+		PrintUsage();
+		return ERR_INVALID_PARAMETER;
+	}
+
+	if( packageFile ) {
+		mxDO(TestLoadCancellation( packageFile, clumpName, numRequests ));
+	}
+	if( clumpToBenchmark ) {
+		mxDO(BenchmarkClump( clumpToBenchmark ));
+	}
+	if( numIndexedObjects ) {
+		mxDO(BenchmarkClumpIndex( numIndexedObjects ));
+	}
+
+	return ALL_OK;
+}
+
+int main( int argc, char** argv )
+{
+	const ERet result = MyEntryPoint( argc, argv );
+	return mxSUCCEDED(result) ? 0 : 1;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
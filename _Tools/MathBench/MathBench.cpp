@@ -0,0 +1,69 @@
+/*
+=============================================================================
+	File:	MathBench.cpp
+	Desc:	Checks the precision of the math library backend and measures its speed.
+	Usage:	MathBench [-samples N] [-ulps N] [-iterations N] [-points N] [-volumes N]
+=============================================================================
+*/
+#include <Base/Base.h>
+#include <Base/Util/LogUtil.h>
+
+static void PrintUsage()
+{
+	printf("Usage: MathBench [-samples N] [-ulps N] [-iterations N] [-points N] [-volumes N]\n");
+	printf("  -samples N      the number of random inputs for each tested function (default: 10000)\n");
+	printf("  -ulps N         the max. allowed error in units in the last place (default: 16)\n");
+	printf("  -iterations N   the number of iterations in each benchmark, 0 - skip benchmarks (default: 1000000)\n");
+	printf("  -points N       the number of points transformed by the batch kernels (default: 1048576)\n");
+	printf("  -volumes N      the number of bounding volumes culled by the batch kernels (default: 100000)\n");
+}
+
+static ERet MyEntryPoint( int argc, char** argv )
+{
+	SetupBaseUtil	setupBase;
+	FileLogUtil		fileLog;
+
+	UINT32 numSamples = 10000;
+	UINT32 maxUlps = 16;
+	UINT32 numIterations = 1000000;
+	UINT32 numPoints = 1<<20;
+	UINT32 numVolumes = 100000;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-samples" ) && i + 1 < argc ) {
+			numSamples = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-ulps" ) && i + 1 < argc ) {
+			maxUlps = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-iterations" ) && i + 1 < argc ) {
+			numIterations = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-points" ) && i + 1 < argc ) {
+			numPoints = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-volumes" ) && i + 1 < argc ) {
+			numVolumes = atoi( argv[++i] );
+		} else {
+			printf("Unknown option: '%s'\n", argv[i]);
+			PrintUsage();
+			return ERR_INVALID_PARAMETER;
+		}
+	}
+
+	mxDO(NewMath_VerifyBackend( numSamples, maxUlps ));
+
+	if( numIterations > 0 ) {
+		NewMath_Benchmark( numIterations );
+		mxDO(SoAMath_Benchmark( numPoints, numVolumes ));
+	}
+
+	return ALL_OK;
+}
+
+int main( int argc, char** argv )
+{
+	const ERet result = MyEntryPoint( argc, argv );
+	return mxSUCCEDED(result) ? 0 : 1;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,70 @@
+/*
+=============================================================================
+	File:	MemBench.cpp
+	Desc:	Checks the engine memory heaps and the frame allocator and measures their scalability.
+	Usage:	MemBench [-threads N] [-allocations N] [-frames N] [-track <capture file>]
+=============================================================================
+*/
+#include <Base/Base.h>
+#include <Base/Util/LogUtil.h>
+#include <Base/Memory/Frame/FrameAlloc.h>
+#include <Base/Memory/Tracker/AllocationTracker.h>
+
+static void PrintUsage()
+{
+	printf("Usage: MemBench [-threads N] [-allocations N] [-frames N] [-track <capture file>]\n");
+	printf("  -threads N      the max. number of threads, the benchmark runs with 1, 2, 4, ... N threads (default: 8)\n");
+	printf("  -allocations N  the number of allocations made by each thread (default: 1048576)\n");
+	printf("  -frames N       the number of frames in the frame allocator benchmark, 0 - skip it (default: 100)\n");
+	printf("  -track file     measure the overhead of the allocation tracker, the capture can be viewed with MemReport\n");
+}
+
+static ERet MyEntryPoint( int argc, char** argv )
+{
+	SetupBaseUtil	setupBase;
+	FileLogUtil		fileLog;
+
+	UINT32 numThreads = 8;
+	UINT32 numAllocations = 1<<20;
+	UINT32 numFrames = 100;
+	const char* captureFileName = nil;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-threads" ) && i + 1 < argc ) {
+			numThreads = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-allocations" ) && i + 1 < argc ) {
+			numAllocations = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-frames" ) && i + 1 < argc ) {
+			numFrames = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-track" ) && i + 1 < argc ) {
+			captureFileName = argv[++i];
+		} else {
+			printf("Unknown option: '%s'\n", argv[i]);
+			PrintUsage();
+			return ERR_INVALID_PARAMETER;
+		}
+	}
+
+	mxDO(F_BenchmarkMemoryHeaps( numThreads, numAllocations ));
+
+	if( numFrames > 0 ) {
+		mxDO(FrameAllocator_Benchmark( numThreads, numFrames ));
+	}
+
+	if( captureFileName ) {
+		mxDO(F_BenchmarkAllocationTracker( captureFileName, numThreads, numAllocations ));
+	}
+
+	return ALL_OK;
+}
+
+int main( int argc, char** argv )
+{
+	const ERet result = MyEntryPoint( argc, argv );
+	return mxSUCCEDED(result) ? 0 : 1;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,807 @@
+/*
+=============================================================================
+	File:	MemReport.cpp
+	Desc:	Summarizes the allocation captures written by the allocation tracker:
+			live and peak bytes, churn per frame and lifetimes of blocks per call site.
+	Usage:	MemReport <capture.mtrk> [-top N] [-sort peak|live|count|bytes|transient] [-depth N] [-nosymbols]
+=============================================================================
+*/
+#include <Base/Base.h>
+#include <Base/Util/LogUtil.h>
+#include <Base/Memory/Tracker/AllocationTracker.h>
+
+#include <DbgHelp.h>
+
+static void PrintUsage()
+{
+	printf("Usage: MemReport <capture.mtrk> [-top N] [-sort peak|live|count|bytes|transient] [-depth N] [-nosymbols]\n");
+	printf("  -top N      the number of reported call sites (default: 20)\n");
+	printf("  -sort key   peak - the peak of live bytes (default), live - the bytes not freed at the end,\n");
+	printf("              count - the number of allocations, bytes - the total allocated bytes,\n");
+	printf("              transient - the number of blocks freed in the same frame (candidates for the frame allocator)\n");
+	printf("  -depth N    the number of printed callstack frames (default: 5)\n");
+	printf("  -nosymbols  print the addresses without resolving symbols\n");
+}
+
+namespace
+{
+
+enum
+{
+	MAX_THREADS = 256,
+	MAX_HEAPS = 256,
+
+	// lifetimes in frames: 0, 1, 2-3, 4-7, 8-15, 16-31, 32-63, 64+
+	NUM_LIFETIME_BUCKETS = 8,
+};
+
+enum ESortKey
+{
+	Sort_Peak,
+	Sort_Live,
+	Sort_Count,
+	Sort_Bytes,
+	Sort_Transient,
+};
+
+struct CallSite
+{
+	UINT32	hash;
+	UINT32	firstFrame;	// in Capture::frames
+	UINT32	depth;
+	UINT32	heap;		// of the first allocation
+
+	UINT32	numAllocations;
+	UINT32	numFreed;
+	UINT32	numLiveBlocks;
+	UINT64	totalBytes;
+	UINT64	liveBytes;
+	UINT64	peakLiveBytes;
+	UINT64	totalLifetimeTicks;	// of the freed blocks
+
+	UINT32	lastFrame;	// the frame of the last allocation
+	UINT32	numAllocationsInLastFrame;
+	UINT32	maxAllocationsPerFrame;
+
+	UINT32	lifetimes[ NUM_LIFETIME_BUCKETS ];
+};
+
+struct ThreadStream
+{
+	UINT32	threadId;
+	UINT32	cursor;	// the next event to replay
+	TArray< AllocationEvent >	events;
+
+	UINT32	numAllocations;
+	UINT32	numFrees;
+	UINT32	numRemoteFrees;	// of the blocks allocated by other threads
+	UINT64	totalBytes;
+};
+
+struct HeapStats
+{
+	char	name[ ALLOCATION_CAPTURE_HEAP_NAME_LENGTH ];
+	UINT32	numAllocations;
+	UINT64	totalBytes;
+	UINT64	liveBytes;
+	UINT64	peakLiveBytes;
+};
+
+struct LiveBlock
+{
+	UINT64	address;	// 0 - empty slot
+	UINT64	timestamp;
+	UINT32	size;
+	UINT32	site;
+	UINT32	frameNumber;
+	UINT16	thread;
+	UINT8	heap;
+};
+
+/*
+-----------------------------------------------------------------------------
+	LiveBlockTable - the allocated blocks by address,
+	open addressing with linear probing and backward-shift deletion.
+-----------------------------------------------------------------------------
+*/
+class LiveBlockTable
+{
+	TArray< LiveBlock >	m_slots;
+	UINT32				m_mask;
+	UINT32				m_count;
+
+public:
+	LiveBlockTable()
+	{
+		m_mask = 0;
+		m_count = 0;
+	}
+
+	UINT32 Num() const
+	{
+		return m_count;
+	}
+
+	ERet Insert( const LiveBlock& block )
+	{
+		if( (m_count + 1) * 2 > m_slots.Num() ) {
+			mxDO(this->Grow());
+		}
+		UINT32 index = this->Hash( block.address );
+		while( m_slots[ index ].address ) {
+			if( m_slots[ index ].address == block.address ) {
+				m_slots[ index ] = block;	// the free event was lost
+				return ALL_OK;
+			}
+			index = (index + 1) & m_mask;
+		}
+		m_slots[ index ] = block;
+		m_count++;
+		return ALL_OK;
+	}
+
+	bool Remove( UINT64 address, LiveBlock &outBlock )
+	{
+		if( !m_count ) {
+			return false;
+		}
+		UINT32 index = this->Hash( address );
+		while( m_slots[ index ].address != address ) {
+			if( !m_slots[ index ].address ) {
+				return false;
+			}
+			index = (index + 1) & m_mask;
+		}
+		outBlock = m_slots[ index ];
+		m_count--;
+
+		// move back the entries which can't be reached after the hole
+		UINT32 hole = index;
+		for(;;)
+		{
+			index = (index + 1) & m_mask;
+			const UINT64 nextAddress = m_slots[ index ].address;
+			if( !nextAddress ) {
+				break;
+			}
+			const UINT32 home = this->Hash( nextAddress );
+			if( ((index - home) & m_mask) >= ((index - hole) & m_mask) ) {
+				m_slots[ hole ] = m_slots[ index ];
+				hole = index;
+			}
+		}
+		m_slots[ hole ].address = 0;
+		return true;
+	}
+
+private:
+	UINT32 Hash( UINT64 address ) const
+	{
+		return (UINT32)( ((address >> 4) * 0x9E3779B97F4A7C15ull) >> 32 ) & m_mask;
+	}
+
+	ERet Grow()
+	{
+		TArray< LiveBlock >	oldSlots;
+		oldSlots.Add( m_slots.ToPtr(), m_slots.Num() );
+
+		const UINT32 newSize = largest( m_slots.Num() * 2, 1024u );
+		m_slots.Empty();
+		mxDO(m_slots.AddZeroed( newSize ));
+		m_mask = newSize - 1;
+		m_count = 0;
+
+		for( UINT32 i = 0; i < oldSlots.Num(); i++ ) {
+			if( oldSlots[i].address ) {
+				mxDO(this->Insert( oldSlots[i] ));
+			}
+		}
+		return ALL_OK;
+	}
+};
+
+/*
+-----------------------------------------------------------------------------
+	Capture
+-----------------------------------------------------------------------------
+*/
+struct Capture
+{
+	UINT32		pointerSize;
+	UINT32		numHeaps;
+	HeapStats	heaps[ MAX_HEAPS ];
+
+	ThreadStream	threads[ MAX_THREADS ];
+	UINT32			numThreads;
+
+	TArray< AllocationCaptureModule >	modules;
+
+	// call sites, indexed by the hash of the callstack
+	TArray< CallSite >	sites;
+	TArray< UINT32 >	siteTable;	// indices + 1, 0 - empty slot
+	TArray< UINT64 >	frames;
+
+	AllocationCaptureEnd	end;
+	bool				hasEnd;
+
+	// replay results
+	UINT64		numEvents;
+	UINT32		firstFrame;
+	UINT32		lastFrame;
+	UINT64		firstTimestamp;
+	UINT64		lastTimestamp;
+	UINT64		liveBytes;
+	UINT64		peakLiveBytes;
+	UINT32		peakLiveFrame;
+	UINT32		numUnknownFrees;	// of the blocks allocated before the capture started
+	TArray< UINT32 >	allocationsPerFrame;
+};
+
+Capture	gs_capture;
+
+ERet FindOrAddSite( UINT32 hash, UINT32 &outIndex )
+{
+	Capture & c = gs_capture;
+	if( (c.sites.Num() + 1) * 2 > c.siteTable.Num() )
+	{
+		const UINT32 newSize = largest( c.siteTable.Num() * 2, 1024u );
+		c.siteTable.Empty();
+		mxDO(c.siteTable.AddZeroed( newSize ));
+		for( UINT32 i = 0; i < c.sites.Num(); i++ ) {
+			UINT32 slot = c.sites[i].hash & (newSize - 1);
+			while( c.siteTable[ slot ] ) {
+				slot = (slot + 1) & (newSize - 1);
+			}
+			c.siteTable[ slot ] = i + 1;
+		}
+	}
+
+	const UINT32 mask = c.siteTable.Num() - 1;
+	UINT32 slot = hash & mask;
+	while( c.siteTable[ slot ] )
+	{
+		const UINT32 index = c.siteTable[ slot ] - 1;
+		if( c.sites[ index ].hash == hash ) {
+			outIndex = index;
+			return ALL_OK;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	CallSite & site = c.sites.Add();
+	mxZERO_OUT(site);
+	site.hash = hash;
+	site.lastFrame = ~0u;
+	outIndex = c.sites.Num() - 1;
+	c.siteTable[ slot ] = outIndex + 1;
+	return ALL_OK;
+}
+
+ERet ParseCallstacks( const BYTE* data, UINT32 size )
+{
+	Capture & c = gs_capture;
+	UINT32 offset = 0;
+	while( offset + sizeof(UINT32) * 2 <= size )
+	{
+		const UINT32* header = reinterpret_cast< const UINT32* >( data + offset );
+		const UINT32 hash = header[0];
+		const UINT32 depth = header[1];
+		const UINT32 recordSize = sizeof(UINT32) * 2 + depth * sizeof(UINT64);
+		chkRET_X_IF_NOT(offset + recordSize <= size, ERR_FAILED_TO_PARSE_DATA);
+
+		UINT32 siteIndex;
+		mxDO(FindOrAddSite( hash, siteIndex ));
+		CallSite & site = c.sites[ siteIndex ];
+		site.firstFrame = c.frames.Num();
+		site.depth = depth;
+		mxDO(c.frames.Add( reinterpret_cast< const UINT64* >( header + 2 ), depth ));
+
+		offset += recordSize;
+	}
+	return ALL_OK;
+}
+
+ERet ParseEvents( const BYTE* data, UINT32 size )
+{
+	Capture & c = gs_capture;
+	chkRET_X_IF_NOT(size >= sizeof(AllocationEventsHeader), ERR_FAILED_TO_PARSE_DATA);
+	const AllocationEventsHeader* header = reinterpret_cast< const AllocationEventsHeader* >( data );
+	chkRET_X_IF_NOT(sizeof(*header) + header->numEvents * sizeof(AllocationEvent) <= size, ERR_FAILED_TO_PARSE_DATA);
+
+	UINT32 threadIndex = 0;
+	while( threadIndex < c.numThreads && c.threads[ threadIndex ].threadId != header->threadId ) {
+		threadIndex++;
+	}
+	if( threadIndex == c.numThreads )
+	{
+		chkRET_X_IF_NOT(c.numThreads < MAX_THREADS, ERR_TOO_MANY_OBJECTS);
+		c.threads[ threadIndex ].threadId = header->threadId;
+		c.numThreads++;
+	}
+
+	return c.threads[ threadIndex ].events.Add( reinterpret_cast< const AllocationEvent* >( header + 1 ), header->numEvents );
+}
+
+ERet LoadCapture( const char* fileName )
+{
+	Capture & c = gs_capture;
+
+	FileReader	file;
+	mxDO(file.Open( fileName ));
+
+	AllocationCaptureHeader	header;
+	mxDO(file.Get( header ));
+	chkRET_X_IF_NOT(header.fourCC == ALLOCATION_CAPTURE_FOURCC, ERR_OBJECT_OF_WRONG_TYPE);
+	chkRET_X_IF_NOT(header.version == ALLOCATION_CAPTURE_VERSION, ERR_INCOMPATIBLE_VERSION);
+	chkRET_X_IF_NOT(header.numHeaps <= MAX_HEAPS, ERR_FAILED_TO_PARSE_DATA);
+
+	c.pointerSize = header.pointerSize;
+	c.numHeaps = header.numHeaps;
+	for( UINT32 i = 0; i < header.numHeaps; i++ ) {
+		mxDO(file.Read( c.heaps[i].name, sizeof(c.heaps[i].name) ));
+		c.heaps[i].name[ sizeof(c.heaps[i].name) - 1 ] = 0;
+	}
+
+	TArray< BYTE >	data;
+
+	while( !file.AtEnd() )
+	{
+		AllocationChunkHeader	chunk;
+		if( mxFAILED(file.Get( chunk )) ) {
+			break;	// the capture is truncated, e.g. the process crashed
+		}
+		data.Empty();
+		mxDO(data.AddZeroed( chunk.size ));
+		if( chunk.size && mxFAILED(file.Read( data.ToPtr(), chunk.size )) ) {
+			break;
+		}
+
+		switch( chunk.type )
+		{
+		case AllocationChunk_Modules :
+			mxDO(c.modules.Add( reinterpret_cast< const AllocationCaptureModule* >( data.ToPtr() ), chunk.size / sizeof(AllocationCaptureModule) ));
+			break;
+
+		case AllocationChunk_Callstacks :
+			mxDO(ParseCallstacks( data.ToPtr(), chunk.size ));
+			break;
+
+		case AllocationChunk_Events :
+			mxDO(ParseEvents( data.ToPtr(), chunk.size ));
+			break;
+
+		case AllocationChunk_End :
+			chkRET_X_IF_NOT(chunk.size >= sizeof(c.end), ERR_FAILED_TO_PARSE_DATA);
+			memcpy( &c.end, data.ToPtr(), sizeof(c.end) );
+			c.hasEnd = true;
+			break;
+
+		default:
+			ptWARN("Unknown chunk type: %u\n", chunk.type);
+		}
+	}
+
+	if( !c.hasEnd ) {
+		ptWARN("The capture is incomplete (the process has not stopped tracking).\n");
+	}
+	return ALL_OK;
+}
+
+UINT32 LifetimeBucket( UINT32 frames )
+{
+	if( !frames ) {
+		return 0;
+	}
+	return smallest( IntegerLog2( frames ) + 1, (UINT32)NUM_LIFETIME_BUCKETS - 1 );
+}
+
+// replays the events of all threads in the order of time
+ERet ReplayEvents()
+{
+	Capture & c = gs_capture;
+
+	c.firstFrame = ~0u;
+	c.lastFrame = 0;
+	c.firstTimestamp = ~0ull;
+	c.lastTimestamp = 0;
+	for( UINT32 t = 0; t < c.numThreads; t++ )
+	{
+		const TArray< AllocationEvent > & events = c.threads[t].events;
+		for( UINT32 i = 0; i < events.Num(); i++ ) {
+			c.firstFrame = smallest( c.firstFrame, events[i].frameNumber );
+			c.lastFrame = largest( c.lastFrame, events[i].frameNumber );
+		}
+		if( events.Num() ) {
+			c.firstTimestamp = smallest( c.firstTimestamp, events[0].timestamp );
+			c.lastTimestamp = largest( c.lastTimestamp, events[ events.Num() - 1 ].timestamp );
+		}
+	}
+	if( c.firstFrame > c.lastFrame ) {
+		return ALL_OK;	// no events
+	}
+	mxDO(c.allocationsPerFrame.AddZeroed( c.lastFrame - c.firstFrame + 1 ));
+
+	LiveBlockTable	liveBlocks;
+
+	for(;;)
+	{
+		// the thread with the earliest event
+		UINT32 next = MAX_THREADS;
+		UINT64 nextTimestamp = ~0ull;
+		for( UINT32 t = 0; t < c.numThreads; t++ )
+		{
+			const ThreadStream & stream = c.threads[t];
+			if( stream.cursor < stream.events.Num() && stream.events[ stream.cursor ].timestamp < nextTimestamp ) {
+				nextTimestamp = stream.events[ stream.cursor ].timestamp;
+				next = t;
+			}
+		}
+		if( next == MAX_THREADS ) {
+			break;
+		}
+
+		ThreadStream & stream = c.threads[ next ];
+		const AllocationEvent & event = stream.events[ stream.cursor++ ];
+		c.numEvents++;
+
+		if( event.type == AllocationEvent_Alloc )
+		{
+			UINT32 siteIndex;
+			mxDO(FindOrAddSite( event.callstack, siteIndex ));
+			CallSite & site = c.sites[ siteIndex ];
+			if( !site.numAllocations ) {
+				site.heap = event.heap;
+			}
+			site.numAllocations++;
+			site.numLiveBlocks++;
+			site.totalBytes += event.size;
+			site.liveBytes += event.size;
+			site.peakLiveBytes = largest( site.peakLiveBytes, site.liveBytes );
+			if( site.lastFrame != event.frameNumber ) {
+				site.lastFrame = event.frameNumber;
+				site.numAllocationsInLastFrame = 0;
+			}
+			site.numAllocationsInLastFrame++;
+			site.maxAllocationsPerFrame = largest( site.maxAllocationsPerFrame, site.numAllocationsInLastFrame );
+
+			HeapStats & heap = c.heaps[ event.heap ];
+			heap.numAllocations++;
+			heap.totalBytes += event.size;
+			heap.liveBytes += event.size;
+			heap.peakLiveBytes = largest( heap.peakLiveBytes, heap.liveBytes );
+
+			stream.numAllocations++;
+			stream.totalBytes += event.size;
+
+			c.liveBytes += event.size;
+			if( c.liveBytes > c.peakLiveBytes ) {
+				c.peakLiveBytes = c.liveBytes;
+				c.peakLiveFrame = event.frameNumber;
+			}
+			c.allocationsPerFrame[ event.frameNumber - c.firstFrame ]++;
+
+			LiveBlock	block;
+			block.address = event.address;
+			block.timestamp = event.timestamp;
+			block.size = event.size;
+			block.site = siteIndex;
+			block.frameNumber = event.frameNumber;
+			block.thread = (UINT16) next;
+			block.heap = event.heap;
+			mxDO(liveBlocks.Insert( block ));
+		}
+		else
+		{
+			stream.numFrees++;
+
+			LiveBlock	block;
+			if( !liveBlocks.Remove( event.address, block ) ) {
+				c.numUnknownFrees++;
+				continue;
+			}
+
+			CallSite & site = c.sites[ block.site ];
+			site.numFreed++;
+			site.numLiveBlocks--;
+			site.liveBytes -= block.size;
+			site.totalLifetimeTicks += event.timestamp - block.timestamp;
+			site.lifetimes[ LifetimeBucket( event.frameNumber - block.frameNumber ) ]++;
+
+			c.heaps[ block.heap ].liveBytes -= block.size;
+			c.liveBytes -= block.size;
+
+			if( block.thread != next ) {
+				stream.numRemoteFrees++;
+			}
+		}
+	}
+
+	return ALL_OK;
+}
+
+/*
+-----------------------------------------------------------------------------
+	SymbolResolver
+-----------------------------------------------------------------------------
+*/
+class SymbolResolver
+{
+	HANDLE	m_process;	// a unique value, the captured process is not running
+	bool	m_initialized;
+
+public:
+	SymbolResolver()
+	{
+		m_process = (HANDLE) (UINT_PTR) MCHAR4('M','R','E','P');
+		m_initialized = false;
+	}
+	~SymbolResolver()
+	{
+		if( m_initialized ) {
+			::SymCleanup( m_process );
+		}
+	}
+
+	void Initialize( const TArray< AllocationCaptureModule >& modules )
+	{
+		::SymSetOptions( SYMOPT_UNDNAME | SYMOPT_LOAD_LINES | SYMOPT_DEFERRED_LOADS | SYMOPT_FAIL_CRITICAL_ERRORS );
+		if( !::SymInitialize( m_process, nil, FALSE ) ) {
+			ptWARN("SymInitialize() failed, the addresses won't be resolved.\n");
+			return;
+		}
+		m_initialized = true;
+
+		// the modules are written at the start and at the end of the capture
+		for( UINT32 i = 0; i < modules.Num(); i++ ) {
+			::SymLoadModuleEx( m_process, nil, modules[i].path, nil, modules[i].baseAddress, modules[i].size, nil, 0 );
+		}
+	}
+
+	void Resolve( UINT64 address, char* buffer, UINT32 bufferSize )
+	{
+		if( m_initialized )
+		{
+			BYTE	symbolStorage[ sizeof(SYMBOL_INFO) + MAX_SYM_NAME ];
+			SYMBOL_INFO* symbol = reinterpret_cast< SYMBOL_INFO* >( symbolStorage );
+			symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+			symbol->MaxNameLen = MAX_SYM_NAME;
+
+			// the return address points to the instruction after the call
+			DWORD64 displacement = 0;
+			if( ::SymFromAddr( m_process, address - 1, &displacement, symbol ) )
+			{
+				IMAGEHLP_LINE64	line;
+				line.SizeOfStruct = sizeof(line);
+				DWORD lineDisplacement = 0;
+				if( ::SymGetLineFromAddr64( m_process, address - 1, &lineDisplacement, &line ) ) {
+					_snprintf( buffer, bufferSize, "%s (%s:%u)", symbol->Name, line.FileName, (UINT) line.LineNumber );
+				} else {
+					_snprintf( buffer, bufferSize, "%s+0x%x", symbol->Name, (UINT) displacement );
+				}
+				buffer[ bufferSize - 1 ] = 0;
+				return;
+			}
+		}
+		_snprintf( buffer, bufferSize, "0x%08x%08x", (UINT)(address >> 32), (UINT) address );
+		buffer[ bufferSize - 1 ] = 0;
+	}
+};
+
+/*
+-----------------------------------------------------------------------------
+	Report
+-----------------------------------------------------------------------------
+*/
+ESortKey	gs_sortKey = Sort_Peak;
+
+UINT64 GetSortValue( const CallSite& site )
+{
+	switch( gs_sortKey )
+	{
+	case Sort_Live :		return site.liveBytes;
+	case Sort_Count :		return site.numAllocations;
+	case Sort_Bytes :		return site.totalBytes;
+	case Sort_Transient :	return site.lifetimes[0];
+	}
+	return site.peakLiveBytes;
+}
+
+int CompareSites( const void* a, const void* b )
+{
+	const UINT64 valueA = GetSortValue( gs_capture.sites[ *static_cast< const UINT32* >( a ) ] );
+	const UINT64 valueB = GetSortValue( gs_capture.sites[ *static_cast< const UINT32* >( b ) ] );
+	return (valueA < valueB) ? 1 : (valueA > valueB) ? -1 : 0;
+}
+
+const char* FormatBytes( UINT64 bytes, char* buffer, UINT32 bufferSize )
+{
+	if( bytes >= mxMEGABYTE ) {
+		_snprintf( buffer, bufferSize, "%.2f MB", double(bytes) / mxMEGABYTE );
+	} else if( bytes >= mxKILOBYTE ) {
+		_snprintf( buffer, bufferSize, "%.1f KB", double(bytes) / mxKILOBYTE );
+	} else {
+		_snprintf( buffer, bufferSize, "%u B", (UINT) bytes );
+	}
+	buffer[ bufferSize - 1 ] = 0;
+	return buffer;
+}
+
+void PrintReport( UINT32 numTopSites, UINT32 callstackDepth, bool resolveSymbols )
+{
+	Capture & c = gs_capture;
+	char	a[32], b[32], d[32], e[32];
+
+	const double ticksPerSecond = c.hasEnd ? double( largest( c.end.ticksPerSecond, 1ull ) ) : 0.0;
+	const UINT32 numFrames = c.numEvents ? c.lastFrame - c.firstFrame + 1 : 0;
+
+	printf("\n=== Capture ===\n");
+	printf("events: %.0f, threads: %u, call sites: %u, frames: %u (%u..%u)\n",
+		double(c.numEvents), c.numThreads, c.sites.Num(), numFrames, c.firstFrame, c.lastFrame);
+	if( ticksPerSecond > 0.0 ) {
+		printf("duration: %.2f s\n", double(c.lastTimestamp - c.firstTimestamp) / ticksPerSecond);
+		printf("lost events: %u, lost callstacks: %u\n", c.end.numLostEvents, c.end.numLostCallstacks);
+	}
+	printf("peak live: %s (frame %u), live at the end: %s, frees of unknown blocks: %u\n",
+		FormatBytes( c.peakLiveBytes, a, sizeof(a) ), c.peakLiveFrame, FormatBytes( c.liveBytes, b, sizeof(b) ), c.numUnknownFrees);
+
+	if( numFrames )
+	{
+		UINT32 busiestFrame = 0;
+		for( UINT32 i = 1; i < c.allocationsPerFrame.Num(); i++ ) {
+			if( c.allocationsPerFrame[i] > c.allocationsPerFrame[ busiestFrame ] ) {
+				busiestFrame = i;
+			}
+		}
+		UINT64 numAllocations = 0;
+		UINT64 totalBytes = 0;
+		for( UINT32 i = 0; i < c.numThreads; i++ ) {
+			numAllocations += c.threads[i].numAllocations;
+			totalBytes += c.threads[i].totalBytes;
+		}
+		printf("churn: %.1f allocations (%s) per frame, max. %u allocations in frame %u\n",
+			double(numAllocations) / numFrames, FormatBytes( totalBytes / numFrames, a, sizeof(a) ),
+			c.allocationsPerFrame[ busiestFrame ], c.firstFrame + busiestFrame);
+	}
+
+	printf("\n=== Heaps ===\n");
+	printf("%-24s %12s %12s %12s %12s\n", "heap", "allocations", "bytes", "peak live", "live");
+	for( UINT32 i = 0; i < c.numHeaps; i++ )
+	{
+		const HeapStats & heap = c.heaps[i];
+		if( heap.numAllocations ) {
+			printf("%-24s %12u %12s %12s %12s\n", heap.name, heap.numAllocations,
+				FormatBytes( heap.totalBytes, a, sizeof(a) ), FormatBytes( heap.peakLiveBytes, b, sizeof(b) ), FormatBytes( heap.liveBytes, d, sizeof(d) ));
+		}
+	}
+
+	printf("\n=== Threads ===\n");
+	printf("%-10s %12s %12s %12s %12s\n", "thread", "allocations", "bytes", "frees", "remote frees");
+	for( UINT32 i = 0; i < c.numThreads; i++ )
+	{
+		const ThreadStream & thread = c.threads[i];
+		printf("%-10u %12u %12s %12u %12u\n", thread.threadId, thread.numAllocations,
+			FormatBytes( thread.totalBytes, a, sizeof(a) ), thread.numFrees, thread.numRemoteFrees);
+	}
+
+	// sort the call sites
+	TArray< UINT32 >	order;
+	for( UINT32 i = 0; i < c.sites.Num(); i++ ) {
+		if( c.sites[i].numAllocations ) {
+			order.Add( i );
+		}
+	}
+	if( order.Num() ) {
+		qsort( order.ToPtr(), order.Num(), sizeof(order[0]), &CompareSites );
+	}
+
+	SymbolResolver	symbols;
+	if( resolveSymbols ) {
+		symbols.Initialize( c.modules );
+	}
+
+	static const char* lifetimeNames[ NUM_LIFETIME_BUCKETS ] = { "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+" };
+
+	printf("\n=== Top %u call sites ===\n", smallest( numTopSites, order.Num() ));
+	for( UINT32 i = 0; i < order.Num() && i < numTopSites; i++ )
+	{
+		const CallSite & site = c.sites[ order[i] ];
+
+		printf("\n#%u  peak live %s, live %s (%u blocks), %u allocations, %s total, %s avg, heap %s\n",
+			i + 1, FormatBytes( site.peakLiveBytes, a, sizeof(a) ), FormatBytes( site.liveBytes, b, sizeof(b) ), site.numLiveBlocks,
+			site.numAllocations, FormatBytes( site.totalBytes, d, sizeof(d) ),
+			FormatBytes( site.totalBytes / site.numAllocations, e, sizeof(e) ), site.heap < c.numHeaps ? c.heaps[ site.heap ].name : "?");
+
+		if( numFrames ) {
+			printf("    churn: %.2f allocations per frame, max. %u in a frame\n",
+				double(site.numAllocations) / numFrames, site.maxAllocationsPerFrame);
+		}
+
+		printf("    lifetime in frames:");
+		for( UINT32 bucket = 0; bucket < NUM_LIFETIME_BUCKETS; bucket++ ) {
+			printf(" %s:%.0f%%", lifetimeNames[ bucket ], 100.0 * site.lifetimes[ bucket ] / site.numAllocations);
+		}
+		printf(" never freed:%.0f%%", 100.0 * site.numLiveBlocks / site.numAllocations);
+		if( ticksPerSecond > 0.0 && site.numFreed ) {
+			printf(", avg. %.3f ms", 1000.0 * double(site.totalLifetimeTicks) / site.numFreed / ticksPerSecond);
+		}
+		printf("\n");
+
+		if( !site.depth ) {
+			printf("    <unknown callstack %08x>\n", site.hash);
+		}
+		for( UINT32 frame = 0; frame < site.depth && frame < callstackDepth; frame++ )
+		{
+			char	symbol[ 1024 ];
+			symbols.Resolve( c.frames[ site.firstFrame + frame ], symbol, sizeof(symbol) );
+			printf("    %s %s\n", frame ? "  " : "at", symbol);
+		}
+	}
+}
+
+}//namespace
+
+static ERet MyEntryPoint( int argc, char** argv )
+{
+	SetupBaseUtil	setupBase;
+	FileLogUtil		fileLog;
+
+	const char* captureFileName = nil;
+	UINT32 numTopSites = 20;
+	UINT32 callstackDepth = 5;
+	bool resolveSymbols = true;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-top" ) && i + 1 < argc ) {
+			numTopSites = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-depth" ) && i + 1 < argc ) {
+			callstackDepth = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-sort" ) && i + 1 < argc ) {
+			const char* key = argv[++i];
+			if( !strcmp( key, "peak" ) ) {
+				gs_sortKey = Sort_Peak;
+			} else if( !strcmp( key, "live" ) ) {
+				gs_sortKey = Sort_Live;
+			} else if( !strcmp( key, "count" ) ) {
+				gs_sortKey = Sort_Count;
+			} else if( !strcmp( key, "bytes" ) ) {
+				gs_sortKey = Sort_Bytes;
+			} else if( !strcmp( key, "transient" ) ) {
+				gs_sortKey = Sort_Transient;
+			} else {
+				printf("Unknown sort key: '%s'\n", key);
+				PrintUsage();
+				return ERR_INVALID_PARAMETER;
+			}
+		} else if( !strcmp( argv[i], "-nosymbols" ) ) {
+			resolveSymbols = false;
+		} else if( argv[i][0] != '-' && !captureFileName ) {
+			captureFileName = argv[i];
+		} else {
+			printf("Unknown option: '%s'\n", argv[i]);
+			PrintUsage();
+			return ERR_INVALID_PARAMETER;
+		}
+	}
+
+	if( !captureFileName ) {
+		PrintUsage();
+		return ERR_INVALID_PARAMETER;
+	}
+
+	mxDO(LoadCapture( captureFileName ));
+	mxDO(ReplayEvents());
+	PrintReport( numTopSites, callstackDepth, resolveSymbols );
+
+	return ALL_OK;
+}
+
+int main( int argc, char** argv )
+{
+	const ERet result = MyEntryPoint( argc, argv );
+	return mxSUCCEDED(result) ? 0 : 1;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,166 @@
+/*
+=============================================================================
+	File:	MeshBench.cpp
+	Desc:	Measures the speed of the mesh processing code:
+			dual contouring vs marching cubes, incremental BSP CSG and BSP queries.
+	Usage:	MeshBench [-depth N] [-brushes N] [-points N]
+=============================================================================
+*/
+#include <Base/Base.h>
+#include <Base/Util/LogUtil.h>
+#include <Meshok/Meshok.h>
+#include <Meshok/BSP.h>
+#include <Meshok/DualContouring.h>
+
+static void PrintUsage()
+{
+	printf("Usage: MeshBench [-depth N] [-brushes N] [-points N]\n");
+	printf("  -depth N        the max. octree depth in the contouring benchmark (1..8), 0 - skip it (default: 6)\n");
+	printf("  -brushes N      the number of boxes carved out of the BSP tree (default: 64)\n");
+	printf("  -points N       the number of random points in the BSP query benchmark, 0 - skip it (default: 65536)\n");
+}
+
+// an axis-aligned box with outward-facing triangles
+struct BoxTriangleMesh : ATriangleMeshInterface
+{
+	Float3	m_min;
+	Float3	m_max;
+public:
+	BoxTriangleMesh( const Float3& _min, const Float3& _max )
+		: m_min( _min ), m_max( _max )
+	{}
+	virtual void ProcessAllTriangles( ATriangleIndexCallback* callback ) override
+	{
+		Float3 corners[8];
+		for( int i = 0; i < 8; i++ ) {
+			corners[i] = Float3_Set(
+				(i & 1) ? m_max.x : m_min.x,
+				(i & 2) ? m_max.y : m_min.y,
+				(i & 4) ? m_max.z : m_min.z
+			);
+		}
+		// counter-clockwise when looking at the face from outside
+		static const int faces[6][4] = {
+			{ 0, 2, 3, 1 },	// -Z
+			{ 4, 5, 7, 6 },	// +Z
+			{ 0, 1, 5, 4 },	// -Y
+			{ 2, 6, 7, 3 },	// +Y
+			{ 0, 4, 6, 2 },	// -X
+			{ 1, 3, 7, 5 },	// +X
+		};
+		for( int iFace = 0; iFace < 6; iFace++ )
+		{
+			ATriangleIndexCallback::Vertex quad[4];
+			for( int k = 0; k < 4; k++ ) {
+				quad[k].xyz = corners[ faces[iFace][k] ];
+				quad[k].st = Float2_Set( 0, 0 );
+			}
+			callback->ProcessTriangle( quad[0], quad[1], quad[2] );
+			callback->ProcessTriangle( quad[0], quad[2], quad[3] );
+		}
+	}
+};
+
+// carves boxes of random sizes out of a solid cube, the brushes overlap each other and the cube's surface
+static ERet BenchmarkSubtraction( BspTree & tree, UINT32 numBrushes )
+{
+	const float worldSize = 10.0f;
+
+	BoxTriangleMesh	world( Float3_Replicate( -worldSize ), Float3_Replicate( worldSize ) );
+	mxDO(tree.Build( &world ));
+
+	BspDirtyRegions	dirty;
+	UINT32 numVisitedNodes = 0;
+	UINT32 numSkippedNodes = 0;
+	UINT32 numClippedPolys = 0;
+	UINT32 numDirtyRegions = 0;
+
+	UINT32 seed = 12345;	// fixed seed for reproducible results
+
+	const UINT64 startTime = mxGetTimeInMicroseconds();
+	for( UINT32 iBrush = 0; iBrush < numBrushes; iBrush++ )
+	{
+		float random[6];
+		for( int k = 0; k < 6; k++ ) {
+			seed = seed * 1664525 + 1013904223;
+			random[k] = (seed >> 8) * (1.0f / 16777216.0f);
+		}
+		const Float3 center = Float3_Set( random[0], random[1], random[2] ) * (worldSize * 2.0f) - Float3_Replicate( worldSize );
+		const Float3 halfSize = Float3_Set( random[3], random[4], random[5] ) * 1.5f + Float3_Replicate( 0.5f );
+
+		BoxTriangleMesh	brush( center - halfSize, center + halfSize );
+		dirty.Reset();
+		mxDO(tree.Subtract( &brush, dirty ));
+
+		numVisitedNodes += dirty.m_numVisitedNodes;
+		numSkippedNodes += dirty.m_numSkippedNodes;
+		numClippedPolys += dirty.m_numClippedPolys;
+		numDirtyRegions += dirty.regions.Num();
+	}
+	const UINT32 elapsedTime = (UINT32)( mxGetTimeInMicroseconds() - startTime );
+
+	ptPRINT( "=== BSP subtraction benchmark (%u brushes) ===\n", numBrushes );
+	ptPRINT( "Tree: %u nodes, %u planes, %u polygons (%u unused)\n",
+		tree.m_nodes.Num(), tree.m_planes.Num(), tree.m_polys.Num(), tree.m_numUnusedPolys );
+	ptPRINT( "Per brush: %u usec, %u nodes visited, %u subtrees skipped, %u polygons clipped, %u dirty regions\n",
+		elapsedTime / largest( numBrushes, 1U ),
+		numVisitedNodes / largest( numBrushes, 1U ),
+		numSkippedNodes / largest( numBrushes, 1U ),
+		numClippedPolys / largest( numBrushes, 1U ),
+		numDirtyRegions / largest( numBrushes, 1U ) );
+
+	return ALL_OK;
+}
+
+static ERet MyEntryPoint( int argc, char** argv )
+{
+	SetupBaseUtil	setupBase;
+	FileLogUtil		fileLog;
+
+	int maxDepth = 6;
+	UINT32 numBrushes = 64;
+	UINT32 numPoints = 1<<16;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-depth" ) && i + 1 < argc ) {
+			maxDepth = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-brushes" ) && i + 1 < argc ) {
+			numBrushes = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-points" ) && i + 1 < argc ) {
+			numPoints = atoi( argv[++i] );
+		} else {
+			printf("Unknown option: '%s'\n", argv[i]);
+			PrintUsage();
+			return ERR_INVALID_PARAMETER;
+		}
+	}
+	if( maxDepth < 0 || maxDepth > 8 ) {
+		printf("Invalid octree depth: %d\n", maxDepth);
+		PrintUsage();
+		return ERR_INVALID_PARAMETER;
+	}
+
+	if( maxDepth > 0 ) {
+		mxDO(DualContouring::RunBenchmark( maxDepth ));
+	}
+
+	BspTree	tree;
+	mxDO(BenchmarkSubtraction( tree, numBrushes ));
+
+	if( numPoints > 0 ) {
+		BSP::RunQueryBenchmark( tree, numPoints );
+	}
+
+	return ALL_OK;
+}
+
+int main( int argc, char** argv )
+{
+	const ERet result = MyEntryPoint( argc, argv );
+	return mxSUCCEDED(result) ? 0 : 1;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//
@@ -0,0 +1,71 @@
+/*
+=============================================================================
+	File:	PakTool.cpp
+	Desc:	Command-line tool for building asset packages.
+	Usage:	PakTool <asset folder> <output.pak> [-align N] [-nocompress] [-bench]
+=============================================================================
+*/
+#include <Base/Base.h>
+#include <Base/Util/LogUtil.h>
+#include <Core/Core.h>
+#include <EditorSupport/AssetPackager.h>
+
+static void PrintUsage()
+{
+	printf("Usage: PakTool <asset folder> <output.pak> [-align N] [-nocompress] [-bench]\n");
+	printf("  -align N     alignment of file data, power of two (default: 16)\n");
+	printf("  -nocompress  store all files uncompressed\n");
+	printf("  -bench       compare load times of the package and the asset folder\n");
+}
+
+static ERet MyEntryPoint( int argc, char** argv )
+{
+	SetupBaseUtil	setupBase;
+	FileLogUtil		fileLog;
+	SetupCoreUtil	setupCore;
+
+	if( argc < 3 ) {
+		PrintUsage();
+		return ERR_INVALID_PARAMETER;
+	}
+
+	const char* sourceFolder = argv[1];
+	const char* packageFile = argv[2];
+
+	AssetPackager::Settings	settings;
+	bool runBenchmark = false;
+
+	for( int i = 3; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-align" ) && i + 1 < argc ) {
+			settings.alignment = atoi( argv[++i] );
+		} else if( !strcmp( argv[i], "-nocompress" ) ) {
+			settings.compress = false;
+		} else if( !strcmp( argv[i], "-bench" ) ) {
+			runBenchmark = true;
+		} else {
+			printf("Unknown option: '%s'\n", argv[i]);
+			PrintUsage();
+			return ERR_INVALID_PARAMETER;
+		}
+	}
+
+	AssetPackager::Stats	stats;
+	mxDO(AssetPackager::BuildPackage( sourceFolder, packageFile, settings, &stats ));
+
+	if( runBenchmark ) {
+		mxDO(AssetPackager::BenchmarkPackage( sourceFolder, packageFile ));
+	}
+
+	return ALL_OK;
+}
+
+int main( int argc, char** argv )
+{
+	const ERet result = MyEntryPoint( argc, argv );
+	return mxSUCCEDED(result) ? 0 : 1;
+}
+
+//--------------------------------------------------------------//
+//				End Of File.									//
+//--------------------------------------------------------------//